@@ -16,6 +16,7 @@
 
 #define LOG_TAG "atrace"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -26,12 +27,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -50,6 +59,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -269,6 +279,8 @@ static const char* g_categoriesFile = nullptr;
 static const char* g_kernelTraceFuncs = nullptr;
 static const char* g_debugAppCmdLine = "";
 static const char* g_outputFile = nullptr;
+static bool g_overheadReport = false;
+static int g_maxEventRate = 0;
 
 /* Global state */
 static bool g_tracePdx = false;
@@ -330,6 +342,9 @@ static const char* k_traceStreamPath =
 static const char* k_traceMarkerPath =
     "trace_marker";
 
+static const char* k_perCpuStatsPathTemplate =
+    "per_cpu/cpu%d/stats";
+
 // Check whether a file exists.
 static bool fileExists(const char* filename) {
     return access((g_traceFolder + filename).c_str(), F_OK) != -1;
@@ -891,122 +906,442 @@ static void stopTrace()
     setTracingEnabled(false);
 }
 
-// Read data from the tracing pipe and forward to stdout
-static void streamTrace()
-{
-    char trace_data[4096];
-    int traceFD = open((g_traceFolder + k_traceStreamPath).c_str(), O_RDWR);
-    if (traceFD == -1) {
-        fprintf(stderr, "error opening %s: %s (%d)\n", k_traceStreamPath,
-                strerror(errno), errno);
-        return;
+// Event that is never throttled, since the CPU scheduling tracks cannot be drawn without it.
+static const char* k_unthrottledEvent = "sched_switch";
+
+// Counts the events of a text trace by event name, to tell which categories cost the most.
+class EventCounter {
+public:
+    struct Event {
+        // The category that enables the event, and the file that enables it alone.
+        const char* category = nullptr;
+        std::string enablePath;
+        uint64_t count = 0;
+    };
+
+    EventCounter() {
+        for (size_t i = 0; i < arraysize(k_categories); i++) {
+            const TracingCategory& c = k_categories[i];
+            for (int j = 0; j < MAX_SYS_FILES && c.sysfiles[j].path != nullptr; j++) {
+                addEnableFile(c.name, c.sysfiles[j].path);
+            }
+        }
     }
-    while (!g_traceAborted) {
-        ssize_t bytes_read = read(traceFD, trace_data, 4096);
-        if (bytes_read > 0) {
-            write(STDOUT_FILENO, trace_data, bytes_read);
-            fflush(stdout);
-        } else {
-            if (!g_traceAborted) {
-                fprintf(stderr, "read returned %zd bytes err %d (%s)\n",
-                        bytes_read, errno, strerror(errno));
+
+    // Counts the events in size bytes of trace, which can end in the middle of a line.
+    void count(const char* data, size_t size) {
+        const char* end = data + size;
+        while (data < end) {
+            const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+            if (newline == nullptr) {
+                mPartialLine.append(data, end);
+                return;
+            }
+            if (mPartialLine.empty()) {
+                countLine(data, newline);
+            } else {
+                mPartialLine.append(data, newline);
+                countLine(mPartialLine.data(), mPartialLine.data() + mPartialLine.size());
+                mPartialLine.clear();
             }
+            data = newline + 1;
+        }
+    }
+
+    const std::map<std::string, Event>& events() const { return mEvents; }
+
+    uint64_t total() const { return mTotal; }
+
+    // Seconds between the first and the last event counted.
+    double duration() const { return mLastTimestamp - mFirstTimestamp; }
+
+    // Events per second, or 0 if the trace is too short to tell.
+    double rate(uint64_t count) const { return duration() > 0 ? count / duration() : 0; }
+
+private:
+    // Maps the events enabled by path, either events/<group>/<event>/enable or
+    // events/<group>/enable, to category.
+    void addEnableFile(const char* category, const std::string& path) {
+        std::vector<std::string> parts = android::base::Split(path, "/");
+        if (parts.size() == 4 && parts[0] == "events") {
+            Event& event = mEvents[parts[2]];
+            event.category = category;
+            event.enablePath = path;
+        } else if (parts.size() == 3 && parts[0] == "events") {
+            std::string group = "events/" + parts[1];
+            std::unique_ptr<DIR, decltype(&closedir)> dir(
+                    opendir((g_traceFolder + group).c_str()), closedir);
+            if (dir == nullptr) {
+                return;
+            }
+            while (struct dirent* entry = readdir(dir.get())) {
+                if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+                    addEnableFile(category, group + "/" + entry->d_name + "/enable");
+                }
+            }
+        }
+    }
+
+    // Lines look like "<task>-<pid> [<cpu>] <flags> <timestamp>: <event>: <fields>".
+    void countLine(const char* line, const char* end) {
+        if (line == end || *line == '#') {
+            return;
+        }
+        const char* cpu = static_cast<const char*>(memchr(line, ']', end - line));
+        if (cpu == nullptr) {
+            return;
+        }
+        const char* separator = strstr(cpu, ": ");
+        if (separator == nullptr || separator >= end) {
+            return;
+        }
+        const char* name = separator + 2;
+        const char* nameEnd = static_cast<const char*>(memchr(name, ':', end - name));
+        if (nameEnd == nullptr) {
+            return;
+        }
+
+        const char* timestamp = separator;
+        while (timestamp > cpu && timestamp[-1] != ' ') {
+            timestamp--;
+        }
+        double seconds = strtod(timestamp, nullptr);
+        if (mTotal == 0) {
+            mFirstTimestamp = seconds;
+        }
+        mLastTimestamp = seconds;
+
+        mEvents[std::string(name, nameEnd)].count++;
+        mTotal++;
+    }
+
+    std::map<std::string, Event> mEvents;
+    std::string mPartialLine;
+    uint64_t mTotal = 0;
+    double mFirstTimestamp = 0;
+    double mLastTimestamp = 0;
+};
+
+// Sum the value of a field of per_cpu/cpu*/stats, such as "overrun", over all CPUs.
+static uint64_t sumPerCpuStat(const char* field)
+{
+    uint64_t total = 0;
+    for (int cpu = 0;; cpu++) {
+        std::string path =
+                g_traceFolder + android::base::StringPrintf(k_perCpuStatsPathTemplate, cpu);
+        std::string stats;
+        if (!android::base::ReadFileToString(path, &stats)) {
             break;
         }
+        for (const std::string& line : android::base::Split(stats, "\n")) {
+            if (android::base::StartsWith(line, std::string(field) + ":")) {
+                total += strtoull(line.c_str() + strlen(field) + 1, nullptr, 10);
+            }
+        }
     }
+    return total;
 }
 
-// Read the current kernel trace and write it to stdout.
-static void dumpTrace(int outFd)
+// Print to stderr how many events each category produced, and how full the buffers got.
+static void reportOverhead(const EventCounter& counter)
 {
-    ALOGI("Dumping trace");
-    int traceFD = open((g_traceFolder + k_tracePath).c_str(), O_RDWR);
-    if (traceFD == -1) {
-        fprintf(stderr, "error opening %s: %s (%d)\n", k_tracePath,
-                strerror(errno), errno);
-        return;
+    std::map<std::string, uint64_t> categories;
+    std::vector<std::pair<uint64_t, std::string>> noisiest;
+    for (const auto& it : counter.events()) {
+        if (it.second.count > 0) {
+            categories[it.second.category ? it.second.category : "other"] += it.second.count;
+            noisiest.emplace_back(it.second.count, it.first);
+        }
     }
+    std::sort(noisiest.rbegin(), noisiest.rend());
 
-    if (g_compress) {
-        z_stream zs;
-        memset(&zs, 0, sizeof(zs));
+    fprintf(stderr, "%" PRIu64 " events over %.3fs (%.0f/s)\n", counter.total(),
+            counter.duration(), counter.rate(counter.total()));
+    for (const auto& it : categories) {
+        fprintf(stderr, "  %15s %10" PRIu64 " events %10.1f/s\n", it.first.c_str(), it.second,
+                counter.rate(it.second));
+    }
+    fprintf(stderr, "noisiest events:\n");
+    for (size_t i = 0; i < noisiest.size() && i < 10; i++) {
+        fprintf(stderr, "  %30s %10.1f/s\n", noisiest[i].second.c_str(),
+                counter.rate(noisiest[i].first));
+    }
+    fprintf(stderr, "buffer: %" PRIu64 " entries, %" PRIu64 " overrun, %" PRIu64 " dropped\n",
+            sumPerCpuStat("entries"), sumPerCpuStat("overrun"), sumPerCpuStat("dropped events"));
+}
+
+// Disable the noisiest kernel events until the rate of the remaining ones is within
+// g_maxEventRate, so that tracing can keep running with a bounded overhead.
+static void throttleEvents(const EventCounter& counter)
+{
+    std::vector<std::pair<uint64_t, const EventCounter::Event*>> candidates;
+    for (const auto& it : counter.events()) {
+        if (it.second.count > 0 && !it.second.enablePath.empty() &&
+                it.first != k_unthrottledEvent) {
+            candidates.emplace_back(it.second.count, &it.second);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    uint64_t remaining = counter.total();
+    for (const auto& candidate : candidates) {
+        if (counter.rate(remaining) <= g_maxEventRate) {
+            break;
+        }
+        const EventCounter::Event* event = candidate.second;
+        if (fileIsWritable(event->enablePath.c_str()) &&
+                setKernelOptionEnable(event->enablePath.c_str(), false)) {
+            fprintf(stderr, "throttled %s (%s): %.0f events/s\n", event->enablePath.c_str(),
+                    event->category, counter.rate(candidate.first));
+            remaining -= candidate.first;
+        }
+    }
+}
+
+// Size of the buffers the trace is read and compressed in.
+static constexpr size_t k_traceBufferSize = 64 * 1024;
+
+// How much of the trace can wait for the compression thread before reading blocks on it.
+static constexpr size_t k_maxQueuedTraceBuffers = 256;
+
+// Size of the pipe the trace is spliced through when streaming.
+static constexpr int k_streamPipeSize = 1024 * 1024;
 
-        int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+// Compresses the trace on a thread of its own and writes it to a file descriptor, so that
+// reading the trace out of the kernel never waits for zlib.
+class TraceCompressor {
+public:
+    explicit TraceCompressor(int outFd) : mOutFd(outFd) {}
+
+    ~TraceCompressor() { finish(); }
+
+    // Starts the compression thread. Returns false if zlib could not be set up.
+    bool start() {
+        memset(&mStream, 0, sizeof(mStream));
+        int result = deflateInit(&mStream, Z_DEFAULT_COMPRESSION);
         if (result != Z_OK) {
             fprintf(stderr, "error initializing zlib: %d\n", result);
-            close(traceFD);
-            return;
+            return false;
         }
+        mThread = std::thread(&TraceCompressor::compressLoop, this);
+        return true;
+    }
 
-        constexpr size_t bufSize = 64*1024;
-        std::unique_ptr<uint8_t> in(new uint8_t[bufSize]);
-        std::unique_ptr<uint8_t> out(new uint8_t[bufSize]);
-        if (!in || !out) {
-            fprintf(stderr, "couldn't allocate buffers\n");
-            close(traceFD);
-            return;
+    // Queues size bytes of trace for compression. Blocks while too much trace is queued.
+    void write(const uint8_t* data, size_t size) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mChanged.wait(lock, [this] { return mQueue.size() < k_maxQueuedTraceBuffers; });
+        mQueue.emplace_back(data, data + size);
+        mChanged.notify_all();
+    }
+
+    // Compresses what is still queued, ends the stream and waits for it to be written.
+    // Returns false if anything could not be compressed or written.
+    bool finish() {
+        if (!mThread.joinable()) {
+            return mOk;
         }
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mFinishing = true;
+        }
+        mChanged.notify_all();
+        mThread.join();
 
-        int flush = Z_NO_FLUSH;
+        int result = deflateEnd(&mStream);
+        if (result != Z_OK && result != Z_DATA_ERROR) {
+            fprintf(stderr, "error cleaning up zlib: %d\n", result);
+        }
+        return mOk;
+    }
 
-        zs.next_out = reinterpret_cast<Bytef*>(out.get());
-        zs.avail_out = bufSize;
+private:
+    void compressLoop() {
+        std::vector<uint8_t> out(k_traceBufferSize);
+        bool ok = true;
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mChanged.wait(lock, [this] { return mFinishing || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                break;
+            }
+            std::vector<uint8_t> in = std::move(mQueue.front());
+            mQueue.pop_front();
+            mChanged.notify_all();
+
+            lock.unlock();
+            // Once writing failed, keep draining the queue so that the reader does not block.
+            ok = ok && deflateBuffer(in.data(), in.size(), Z_NO_FLUSH, out);
+            lock.lock();
+        }
+        lock.unlock();
+        mOk = ok && deflateBuffer(nullptr, 0, Z_FINISH, out);
+    }
 
+    bool deflateBuffer(const uint8_t* data, size_t size, int flush, std::vector<uint8_t>& out) {
+        mStream.next_in = const_cast<Bytef*>(data);
+        mStream.avail_in = size;
         do {
-
-            if (zs.avail_in == 0) {
-                // More input is needed.
-                result = read(traceFD, in.get(), bufSize);
-                if (result < 0) {
-                    fprintf(stderr, "error reading trace: %s (%d)\n",
-                            strerror(errno), errno);
-                    result = Z_STREAM_END;
-                    break;
-                } else if (result == 0) {
-                    flush = Z_FINISH;
-                } else {
-                    zs.next_in = reinterpret_cast<Bytef*>(in.get());
-                    zs.avail_in = result;
-                }
+            mStream.next_out = out.data();
+            mStream.avail_out = out.size();
+            if (deflate(&mStream, flush) == Z_STREAM_ERROR) {
+                fprintf(stderr, "error deflating trace: %s\n", mStream.msg ? mStream.msg : "");
+                return false;
             }
-
-            if (zs.avail_out == 0) {
-                // Need to write the output.
-                result = write(outFd, out.get(), bufSize);
-                if ((size_t)result < bufSize) {
-                    fprintf(stderr, "error writing deflated trace: %s (%d)\n",
-                            strerror(errno), errno);
-                    result = Z_STREAM_END; // skip deflate error message
-                    zs.avail_out = bufSize; // skip the final write
-                    break;
-                }
-                zs.next_out = reinterpret_cast<Bytef*>(out.get());
-                zs.avail_out = bufSize;
+            size_t bytes = out.size() - mStream.avail_out;
+            if (bytes > 0 && !android::base::WriteFully(mOutFd, out.data(), bytes)) {
+                fprintf(stderr, "error writing deflated trace: %s (%d)\n",
+                        strerror(errno), errno);
+                return false;
             }
+        } while (mStream.avail_out == 0);
+        return true;
+    }
 
-        } while ((result = deflate(&zs, flush)) == Z_OK);
+    const int mOutFd;
+    z_stream mStream;
+    std::thread mThread;
+    std::mutex mLock;
+    std::condition_variable mChanged;
+    std::deque<std::vector<uint8_t>> mQueue;
+    bool mFinishing = false;
+    bool mOk = true;
+};
 
-        if (result != Z_STREAM_END) {
-            fprintf(stderr, "error deflating trace: %s\n", zs.msg);
+// Read the trace from traceFD until it ends or tracing is aborted, and compress it into outFd.
+// Counts the events in counter too, unless it is null.
+static void compressTrace(int traceFD, int outFd, EventCounter* counter)
+{
+    TraceCompressor compressor(outFd);
+    if (!compressor.start()) {
+        return;
+    }
+
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[k_traceBufferSize]);
+    ssize_t rc;
+    while ((rc = read(traceFD, buf.get(), k_traceBufferSize)) > 0) {
+        if (counter != nullptr) {
+            counter->count(reinterpret_cast<const char*>(buf.get()), rc);
         }
+        compressor.write(buf.get(), rc);
+    }
+    if (rc == -1 && !g_traceAborted) {
+        fprintf(stderr, "error reading trace: %s (%d)\n", strerror(errno), errno);
+    }
+    compressor.finish();
+}
 
-        if (zs.avail_out < bufSize) {
-            size_t bytes = bufSize - zs.avail_out;
-            result = write(outFd, out.get(), bytes);
-            if ((size_t)result < bytes) {
-                fprintf(stderr, "error writing deflated trace: %s (%d)\n",
-                        strerror(errno), errno);
+// Move the trace from trace_pipe to outFd without copying it through atrace, until tracing is
+// aborted. Returns false, before anything is moved, if outFd cannot be spliced to.
+static bool spliceTrace(int traceFD, int outFd)
+{
+    struct stat st;
+    if (fstat(outFd, &st) == -1 || !(S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode))) {
+        return false;
+    }
+
+    // splice needs a pipe on one side, so go through one unless the output already is.
+    int pipeFds[2] = {-1, -1};
+    int pipeIn = outFd;
+    if (!S_ISFIFO(st.st_mode)) {
+        if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+            return false;
+        }
+        pipeIn = pipeFds[1];
+    }
+    fcntl(pipeIn, F_SETPIPE_SZ, k_streamPipeSize);
+
+    bool moved = false;
+    while (!g_traceAborted) {
+        ssize_t bytes = splice(traceFD, nullptr, pipeIn, nullptr, k_streamPipeSize, SPLICE_F_MOVE);
+        if (bytes <= 0) {
+            if (bytes == -1 && errno == EINVAL && !moved) {
+                break;
+            }
+            if (!g_traceAborted) {
+                fprintf(stderr, "splice returned %zd bytes err %d (%s)\n",
+                        bytes, errno, strerror(errno));
+            }
+            moved = true;
+            break;
+        }
+        moved = true;
+        while (pipeIn != outFd && bytes > 0) {
+            ssize_t written = TEMP_FAILURE_RETRY(
+                    splice(pipeFds[0], nullptr, outFd, nullptr, bytes, SPLICE_F_MOVE));
+            if (written <= 0) {
+                fprintf(stderr, "error writing trace: %s\n", strerror(errno));
+                g_traceAborted = true;
+                break;
             }
+            bytes -= written;
         }
+    }
 
-        result = deflateEnd(&zs);
-        if (result != Z_OK) {
-            fprintf(stderr, "error cleaning up zlib: %d\n", result);
+    if (pipeFds[0] != -1) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
+    return moved;
+}
+
+// Read data from the tracing pipe and forward to outFd
+static void streamTrace(int outFd, EventCounter* counter)
+{
+    int traceFD = open((g_traceFolder + k_traceStreamPath).c_str(), O_RDWR);
+    if (traceFD == -1) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", k_traceStreamPath,
+                strerror(errno), errno);
+        return;
+    }
+    if (g_compress) {
+        compressTrace(traceFD, outFd, counter);
+    } else if (counter != nullptr || !spliceTrace(traceFD, outFd)) {
+        std::unique_ptr<char[]> trace_data(new char[k_traceBufferSize]);
+        while (!g_traceAborted) {
+            ssize_t bytes_read = read(traceFD, trace_data.get(), k_traceBufferSize);
+            if (bytes_read > 0) {
+                if (counter != nullptr) {
+                    counter->count(trace_data.get(), bytes_read);
+                }
+                if (!android::base::WriteFully(outFd, trace_data.get(), bytes_read)) {
+                    fprintf(stderr, "error writing trace: %s\n", strerror(errno));
+                    break;
+                }
+            } else {
+                if (!g_traceAborted) {
+                    fprintf(stderr, "read returned %zd bytes err %d (%s)\n",
+                            bytes_read, errno, strerror(errno));
+                }
+                break;
+            }
         }
+    }
+    close(traceFD);
+}
+
+// Read the current kernel trace and write it to stdout. Counts the events in counter too,
+// unless it is null.
+static void dumpTrace(int outFd, EventCounter* counter)
+{
+    ALOGI("Dumping trace");
+    int traceFD = open((g_traceFolder + k_tracePath).c_str(), O_RDWR);
+    if (traceFD == -1) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", k_tracePath,
+                strerror(errno), errno);
+        return;
+    }
+
+    if (g_compress) {
+        compressTrace(traceFD, outFd, counter);
     } else {
         char buf[4096];
         ssize_t rc;
         while ((rc = TEMP_FAILURE_RETRY(read(traceFD, buf, sizeof(buf)))) > 0) {
+            if (counter != nullptr) {
+                counter->count(buf, rc);
+            }
             if (!android::base::WriteFully(outFd, buf, rc)) {
                 fprintf(stderr, "error writing trace: %s\n", strerror(errno));
                 break;
@@ -1073,9 +1408,16 @@ static void showHelp(const char *cmd)
                     "  --async_stop    stop tracing and dump the current contents of circular\n"
                     "                    trace buffer\n"
                     "  --stream        stream trace to stdout as it enters the trace buffer\n"
+                    "                    (or to the -o file, compressed with -z)\n"
                     "                    Note: this can take significant CPU time, and is best\n"
                     "                    used for measuring things that are not affected by\n"
                     "                    CPU performance, like pagecache usage.\n"
+                    "  --overhead_report\n"
+                    "                  report to stderr the event rate of each category and\n"
+                    "                    how full the trace buffers got\n"
+                    "  --max_event_rate N\n"
+                    "                  with --async_dump, disable the noisiest kernel events\n"
+                    "                    until tracing produces at most N events per second\n"
                     "  --list_categories\n"
                     "                  list the available tracing categories\n"
                     " -o filename      write the trace to the specified file instead\n"
@@ -1083,6 +1425,19 @@ static void showHelp(const char *cmd)
             );
 }
 
+// Open the file given with -o, or return stdout if there is none.
+static int openOutputFile()
+{
+    if (!g_outputFile) {
+        return STDOUT_FILENO;
+    }
+    int outFd = open(g_outputFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (outFd == -1) {
+        printf("Failed to open '%s', err=%d", g_outputFile, errno);
+    }
+    return outFd;
+}
+
 bool findTraceFiles()
 {
     static const std::string debugfs_path = "/sys/kernel/debug/tracing/";
@@ -1210,6 +1565,8 @@ int main(int argc, char **argv)
             {"only_userspace",    no_argument, nullptr,  0 },
             {"list_categories",   no_argument, nullptr,  0 },
             {"stream",            no_argument, nullptr,  0 },
+            {"overhead_report",   no_argument, nullptr,  0 },
+            {"max_event_rate",    required_argument, nullptr,  0 },
             {nullptr,                       0, nullptr,  0 }
         };
 
@@ -1285,6 +1642,10 @@ int main(int argc, char **argv)
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
                     traceStream = true;
                     traceDump = false;
+                } else if (!strcmp(long_options[option_index].name, "overhead_report")) {
+                    g_overheadReport = true;
+                } else if (!strcmp(long_options[option_index].name, "max_event_rate")) {
+                    g_maxEventRate = atoi(optarg);
                 } else if (!strcmp(long_options[option_index].name, "list_categories")) {
                     listSupportedCategories();
                     exit(0);
@@ -1307,6 +1668,17 @@ int main(int argc, char **argv)
         }
     }
 
+    if (g_maxEventRate > 0 && traceStop) {
+        fprintf(stderr, "--max_event_rate can only be used with --async_dump\n");
+        exit(1);
+    }
+
+    // Counting events costs some CPU, so only do it when asked to.
+    std::unique_ptr<EventCounter> eventCounter;
+    if (g_overheadReport || g_maxEventRate > 0) {
+        eventCounter = std::make_unique<EventCounter>();
+    }
+
     registerSigHandler();
 
     if (g_initialSleepSecs > 0) {
@@ -1354,7 +1726,16 @@ int main(int argc, char **argv)
         }
 
         if (traceStream) {
-            streamTrace();
+            int outFd = openOutputFile();
+            if (outFd != -1) {
+                streamTrace(outFd, eventCounter.get());
+                if (g_outputFile) {
+                    close(outFd);
+                }
+                if (eventCounter != nullptr) {
+                    reportOverhead(*eventCounter);
+                }
+            }
         }
     }
 
@@ -1366,18 +1747,19 @@ int main(int argc, char **argv)
         if (!g_traceAborted) {
             printf(" done\n");
             fflush(stdout);
-            int outFd = STDOUT_FILENO;
-            if (g_outputFile) {
-                outFd = open(g_outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            }
-            if (outFd == -1) {
-                printf("Failed to open '%s', err=%d", g_outputFile, errno);
-            } else {
+            int outFd = openOutputFile();
+            if (outFd != -1) {
                 dprintf(outFd, "TRACE:\n");
-                dumpTrace(outFd);
+                dumpTrace(outFd, eventCounter.get());
                 if (g_outputFile) {
                     close(outFd);
                 }
+                if (eventCounter != nullptr && g_overheadReport) {
+                    reportOverhead(*eventCounter);
+                }
+                if (eventCounter != nullptr && g_maxEventRate > 0) {
+                    throttleEvents(*eventCounter);
+                }
             }
         } else {
             printf("\ntrace aborted.\n");
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpPool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <android-base/file.h>
+#include <log/log.h>
+
+#include "DumpstateInternal.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+DumpPool::DumpPool(const std::string& tmp_root, size_t thread_count) : tmp_root_(tmp_root) {
+    for (size_t i = 0; i < thread_count; i++) {
+        threads_.emplace_back(&DumpPool::loop, this);
+    }
+}
+
+DumpPool::~DumpPool() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutdown_ = true;
+    }
+    queue_changed_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void DumpPool::enqueueTaskWithFd(const std::string& name, std::function<void(int)> task) {
+    auto entry = std::make_shared<Task>();
+    entry->func = std::move(task);
+
+    // The file is unlinked right away; only the fd is needed to read the output back.
+    std::string path = tmp_root_ + "/dump-pool-XXXXXX";
+    entry->fd.reset(mkostemp(&path[0], O_CLOEXEC));
+    if (entry->fd == -1) {
+        MYLOGE("Could not create a temporary file for %s in %s: %s\n", name.c_str(),
+               tmp_root_.c_str(), strerror(errno));
+    } else {
+        unlink(path.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    tasks_[name] = std::make_pair(entry, entry->done.get_future());
+    if (entry->fd != -1 && !threads_.empty()) {
+        queue_.push_back(entry);
+        queue_changed_.notify_one();
+    }
+}
+
+bool DumpPool::waitForTask(const std::string& name, int out_fd) {
+    std::shared_ptr<Task> task;
+    std::future<void> done;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = tasks_.find(name);
+        if (it == tasks_.end()) {
+            MYLOGE("No dump task named %s\n", name.c_str());
+            return false;
+        }
+        task = std::move(it->second.first);
+        done = std::move(it->second.second);
+        tasks_.erase(it);
+    }
+
+    if (task->fd == -1 || threads_.empty()) {
+        // The task was never queued.
+        task->func(out_fd);
+        return true;
+    }
+
+    done.wait();
+
+    // Anything printed but not flushed yet comes before this section.
+    if (out_fd == STDOUT_FILENO) {
+        fflush(stdout);
+    }
+    if (lseek(task->fd.get(), 0, SEEK_SET) == -1) {
+        MYLOGE("Could not rewind the output of %s: %s\n", name.c_str(), strerror(errno));
+        return true;
+    }
+    char buffer[65536];
+    ssize_t bytes_read;
+    while ((bytes_read = TEMP_FAILURE_RETRY(read(task->fd.get(), buffer, sizeof(buffer)))) > 0) {
+        if (!android::base::WriteFully(out_fd, buffer, bytes_read)) {
+            MYLOGE("Could not copy the output of %s: %s\n", name.c_str(), strerror(errno));
+            break;
+        }
+    }
+    return true;
+}
+
+void DumpPool::loop() {
+    while (true) {
+        std::shared_ptr<Task> task;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            queue_changed_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+            if (shutdown_) {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task->func(task->fd.get());
+        task->done.set_value();
+    }
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_DUMPSTATE_DUMPPOOL_H_
+#define ANDROID_OS_DUMPSTATE_DUMPPOOL_H_
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * Runs sections of the bugreport on worker threads while the main thread dumps the rest.
+ *
+ * Each task writes its section into a temporary file of its own. The main thread copies that
+ * output into the report when it waits for the task, at the place where the section used to be
+ * dumped, so the report keeps the same order as when every section runs sequentially.
+ *
+ * Tasks must only write to the fd they are given, and must not touch anything else the main
+ * thread writes to, such as stdout or the zip file.
+ *
+ * Typical usage:
+ *
+ *    DumpPool pool(tmp_dir, 2);
+ *    pool.enqueueTaskWithFd("CHECKINS", [](int out_fd) { ... });
+ *    ...
+ *    pool.waitForTask("CHECKINS");
+ *
+ */
+class DumpPool {
+  public:
+    DumpPool(const std::string& tmp_root, size_t thread_count);
+
+    /*
+     * Waits for the running tasks to finish. Tasks that have not started are dropped.
+     */
+    ~DumpPool();
+
+    /*
+     * Queues |task|, identified by |name|, to run on a worker thread. |task| receives the fd it
+     * should write its output to.
+     */
+    void enqueueTaskWithFd(const std::string& name, std::function<void(int)> task);
+
+    /*
+     * Waits for the task identified by |name| and appends its output to |out_fd|. If the task
+     * could not get a temporary file, it runs now on the calling thread and writes directly to
+     * |out_fd|. Returns false if there is no such task.
+     */
+    bool waitForTask(const std::string& name, int out_fd = STDOUT_FILENO);
+
+  private:
+    struct Task {
+        std::function<void(int)> func;
+        android::base::unique_fd fd;
+        std::promise<void> done;
+    };
+
+    void loop();
+
+    const std::string tmp_root_;
+
+    std::mutex lock_;
+    std::condition_variable queue_changed_;
+    std::deque<std::shared_ptr<Task>> queue_;
+    std::map<std::string, std::pair<std::shared_ptr<Task>, std::future<void>>> tasks_;
+    bool shutdown_ = false;
+
+    std::vector<std::thread> threads_;
+
+    DISALLOW_COPY_AND_ASSIGN(DumpPool);
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // ANDROID_OS_DUMPSTATE_DUMPPOOL_H_
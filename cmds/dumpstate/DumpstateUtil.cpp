@@ -20,10 +20,13 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/file.h>
@@ -43,40 +46,40 @@ namespace {
 
 static constexpr const char* kSuPath = "/system/xbin/su";
 
-static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
-    sigset_t child_mask, old_mask;
-    sigemptyset(&child_mask);
-    sigaddset(&child_mask, SIGCHLD);
-
-    if (sigprocmask(SIG_BLOCK, &child_mask, &old_mask) == -1) {
-        printf("*** sigprocmask failed: %s\n", strerror(errno));
-        return false;
-    }
+static constexpr useconds_t kMaxWaitpidDelayUs = 50000;
 
-    timespec ts;
-    ts.tv_sec = MSEC_TO_SEC(timeout_ms);
-    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
-    int ret = TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts));
-    int saved_errno = errno;
-
-    // Set the signals back the way they were.
-    if (sigprocmask(SIG_SETMASK, &old_mask, nullptr) == -1) {
-        printf("*** sigprocmask failed: %s\n", strerror(errno));
+// Waits on a pidfd when the kernel supports them, and polls waitpid with a growing delay
+// otherwise. Unlike sigtimedwait on SIGCHLD, neither can pick up the exit of a child forked by
+// another thread, so commands may run on several threads at once.
+static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
+    android::base::unique_fd pidfd;
+#ifdef __NR_pidfd_open
+    pidfd.reset(static_cast<int>(syscall(__NR_pidfd_open, pid, 0)));
+#endif
+    if (pidfd != -1) {
+        pollfd pfd = {pidfd.get(), POLLIN, 0};
+        int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeout_ms));
+        if (ret == -1) {
+            printf("*** poll failed: %s\n", strerror(errno));
+            return false;
+        }
         if (ret == 0) {
+            errno = ETIMEDOUT;
             return false;
         }
     }
-    if (ret == -1) {
-        errno = saved_errno;
-        if (errno == EAGAIN) {
+
+    const uint64_t deadline = Nanotime() + timeout_ms * NANOS_PER_MILLI;
+    useconds_t delay_us = 1000;
+    pid_t child_pid;
+    while ((child_pid = waitpid(pid, status, WNOHANG)) == 0) {
+        if (Nanotime() >= deadline) {
             errno = ETIMEDOUT;
-        } else {
-            printf("*** sigtimedwait failed: %s\n", strerror(errno));
+            return false;
         }
-        return false;
+        usleep(delay_us);
+        delay_us = std::min(delay_us * 2, kMaxWaitpidDelayUs);
     }
-
-    pid_t child_pid = waitpid(pid, status, WNOHANG);
     if (child_pid != pid) {
         if (child_pid != -1) {
             printf("*** Waiting for pid %d, got pid %d instead\n", pid, child_pid);
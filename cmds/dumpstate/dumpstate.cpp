@@ -83,6 +83,7 @@
 #include <private/android_logger.h>
 #include <serviceutils/PriorityDumper.h>
 #include <utils/StrongPointer.h>
+#include "DumpPool.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
 #include "dumpstate.h"
@@ -112,6 +113,7 @@ using android::base::StringPrintf;
 using android::os::IDumpstateListener;
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
+using android::os::dumpstate::DumpPool;
 using android::os::dumpstate::PropertiesHelper;
 
 // Keep in sync with
@@ -195,6 +197,15 @@ static const std::string ANR_FILE_PREFIX = "anr_";
     func_ptr(__VA_ARGS__);                                  \
     RETURN_IF_USER_DENIED_CONSENT();
 
+// Same as RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK, for sections that can be left out: they are skipped
+// once the bugreport is over its time budget.
+#define RUN_OPTIONAL_SLOW_FUNCTION_WITH_CONSENT_CHECK(title, func_ptr, ...) \
+    if (ds.IsOverTimeBudget()) {                                            \
+        ds.SkipSection(title);                                              \
+    } else {                                                                \
+        RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(func_ptr, __VA_ARGS__);        \
+    }
+
 static const char* WAKE_LOCK_NAME = "dumpstate_wakelock";
 
 namespace android {
@@ -305,8 +316,8 @@ static bool CopyFileToFile(const std::string& input_file, const std::string& out
 
 static void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsysArgs,
                        const CommandOptions& options = Dumpstate::DEFAULT_DUMPSYS,
-                       long dumpsysTimeoutMs = 0) {
-    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs);
+                       long dumpsysTimeoutMs = 0, int out_fd = STDOUT_FILENO) {
+    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs, out_fd);
 }
 static int DumpFile(const std::string& title, const std::string& path) {
     return ds.DumpFile(title, path);
@@ -764,6 +775,12 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// List of file extensions whose contents are already compressed. Deflating them again takes a lot
+// of time for almost no gain, so they are stored as is.
+static const std::set<std::string> COMPRESSED_FILE_EXTENSIONS = {
+      ".7z", ".br", ".bz2", ".gz", ".jpeg", ".jpg", ".lz4", ".png", ".webp", ".xz", ".zip", ".zst"
+};
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     if (!IsZipping()) {
@@ -772,6 +789,7 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
         return INVALID_OPERATION;
     }
     std::string valid_name = entry_name;
+    size_t flags = ZipWriter::kCompress;
 
     // Rename extension if necessary.
     size_t idx = entry_name.rfind('.');
@@ -782,11 +800,14 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
             valid_name = entry_name + ".renamed";
             MYLOGI("Renaming entry %s to %s\n", entry_name.c_str(), valid_name.c_str());
         }
+        if (COMPRESSED_FILE_EXTENSIONS.count(extension) != 0) {
+            flags &= ~ZipWriter::kCompress;
+        }
     }
 
     // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
     // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
-    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), ZipWriter::kCompress,
+    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), flags,
                                                   get_mtime(fd, ds.now_));
     if (err != 0) {
         MYLOGE("zip_writer_->StartEntryWithTime(%s): %s\n", valid_name.c_str(),
@@ -1432,6 +1453,67 @@ static void DumpstateLimitedOnly() {
     printf("========================================================\n");
 }
 
+static const char* DUMP_CHECKINS_TASK = "DUMP CHECKINS";
+static const char* DUMP_APP_INFOS_TASK = "DUMP APP INFOS";
+static const size_t DUMP_POOL_THREADS = 2;
+
+static void PrintSectionHeader(int out_fd, const char* header) {
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== %s\n", header);
+    dprintf(out_fd, "========================================================\n");
+}
+
+// Runs on a DumpPool thread, so everything goes to out_fd rather than stdout.
+static void DumpCheckins(int out_fd) {
+    PrintSectionHeader(out_fd, "Checkins");
+
+    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+
+    if (ds.IsUserConsentDenied()) {
+        return;
+    }
+    RunDumpsys("CHECKIN MEMINFO", {"meminfo", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    if (ds.IsUserConsentDenied()) {
+        return;
+    }
+
+    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+}
+
+// Runs on a DumpPool thread, so everything goes to out_fd rather than stdout.
+static void DumpAppInfos(int out_fd) {
+    // The following dumpsys internally collects output from running apps, so it can take a long
+    // time. So let's extend the timeout.
+
+    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
+
+    PrintSectionHeader(out_fd, "Running Application Activities");
+    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS, 0,
+               out_fd);
+
+    PrintSectionHeader(out_fd, "Running Application Services (platform)");
+    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    PrintSectionHeader(out_fd, "Running Application Services (non-platform)");
+    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    PrintSectionHeader(out_fd, "Running Application Providers (platform)");
+    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    PrintSectionHeader(out_fd, "Running Application Providers (non-platform)");
+    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+}
+
 // Dumps various things. Returns early with status USER_CONSENT_DENIED if user denies consent
 // via the consent they are shown. Ignores other errors that occur while running various
 // commands. The consent checking is currently done around long running tasks, which happen to
@@ -1439,6 +1521,12 @@ static void DumpstateLimitedOnly() {
 static Dumpstate::RunStatus dumpstate() {
     DurationReporter duration_reporter("DUMPSTATE");
 
+    // The checkins and the app dumps only go through dumpsys, so they can run while the rest is
+    // dumped. Their output is copied into the report where they used to be dumped.
+    DumpPool dump_pool(ds.bugreport_internal_dir_, DUMP_POOL_THREADS);
+    dump_pool.enqueueTaskWithFd(DUMP_CHECKINS_TASK, DumpCheckins);
+    dump_pool.enqueueTaskWithFd(DUMP_APP_INFOS_TASK, DumpAppInfos);
+
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
     // check intermittently (if it's intrerruptable like a foreach on pids) and/or should be wrapped
     // in a consent check (via RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK).
@@ -1449,9 +1537,10 @@ static Dumpstate::RunStatus dumpstate() {
     RunCommand("CPU INFO", {"top", "-b", "-n", "1", "-H", "-s", "6", "-o",
                             "pid,tid,user,pr,ni,%cpu,s,virt,res,pcy,cmd,name"});
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunCommand, "PROCRANK", {"procrank"}, AS_ROOT_20);
+    RUN_OPTIONAL_SLOW_FUNCTION_WITH_CONSENT_CHECK("PROCRANK", RunCommand, "PROCRANK", {"procrank"},
+                                                  AS_ROOT_20);
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(DumpVisibleWindowViews);
+    RUN_OPTIONAL_SLOW_FUNCTION_WITH_CONSENT_CHECK("VISIBLE WINDOW VIEWS", DumpVisibleWindowViews);
 
     DumpFile("VIRTUAL MEMORY STATS", "/proc/vmstat");
     DumpFile("VMALLOC INFO", "/proc/vmallocinfo");
@@ -1467,8 +1556,8 @@ static Dumpstate::RunStatus dumpstate() {
     RunCommand("PROCESSES AND THREADS",
                {"ps", "-A", "-T", "-Z", "-O", "pri,nice,rtprio,sched,pcy,time"});
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunCommand, "LIBRANK", {"librank"},
-                                         CommandOptions::AS_ROOT);
+    RUN_OPTIONAL_SLOW_FUNCTION_WITH_CONSENT_CHECK("LIBRANK", RunCommand, "LIBRANK", {"librank"},
+                                                  CommandOptions::AS_ROOT);
 
     DumpHals();
 
@@ -1490,7 +1579,8 @@ static Dumpstate::RunStatus dumpstate() {
 
     RunCommand("LIST OF OPEN FILES", {"lsof"}, CommandOptions::AS_ROOT);
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(for_each_pid, do_showmap, "SMAPS OF ALL PROCESSES");
+    RUN_OPTIONAL_SLOW_FUNCTION_WITH_CONSENT_CHECK("SMAPS OF ALL PROCESSES", for_each_pid,
+                                                  do_showmap, "SMAPS OF ALL PROCESSES");
 
     for_each_tid(show_wchan, "BLOCKED PROCESS WAIT-CHANNELS");
     for_each_pid(show_showtime, "PROCESS TIMES (pid cmd user system iowait+percentage)");
@@ -1574,57 +1664,11 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
 
-    printf("========================================================\n");
-    printf("== Checkins\n");
-    printf("========================================================\n");
-
-    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"});
-
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsys, "CHECKIN MEMINFO", {"meminfo", "--checkin"});
-
-    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"});
-    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"});
-    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"});
-    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"});
-
-    printf("========================================================\n");
-    printf("== Running Application Activities\n");
-    printf("========================================================\n");
-
-    // The following dumpsys internally collects output from running apps, so it can take a long
-    // time. So let's extend the timeout.
-
-    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
-
-    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (non-platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (non-platform)\n");
-    printf("========================================================\n");
+    dump_pool.waitForTask(DUMP_CHECKINS_TASK);
+    RETURN_IF_USER_DENIED_CONSENT();
 
-    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    dump_pool.waitForTask(DUMP_APP_INFOS_TASK);
+    RETURN_IF_USER_DENIED_CONSENT();
 
     printf("========================================================\n");
     printf("== Dropbox crashes\n");
@@ -2160,6 +2204,21 @@ bool Dumpstate::FinishZipFile() {
         return false;
     }
 
+    // One line per section, tab separated since titles can contain commas.
+    std::string profile = "section\twall_sec\tcpu_sec\tbytes\ttimed_out\tskipped\n";
+    {
+        std::lock_guard<std::mutex> lock(section_profiles_lock_);
+        for (const SectionProfile& section : section_profiles_) {
+            profile += android::base::StringPrintf("%s\t%.3f\t%.3f\t%" PRId64 "\t%d\t%d\n",
+                                                   section.title.c_str(), section.wall_sec,
+                                                   section.cpu_sec, section.bytes,
+                                                   section.timed_out, section.skipped);
+        }
+    }
+    if (!AddTextZipEntry("dumpstate_profile.txt", profile)) {
+        MYLOGE("Failed to add dumpstate_profile.txt to .zip file\n");
+    }
+
     // Add log file (which contains stderr output) to zip...
     fprintf(stderr, "dumpstate_log.txt entry on zip file logged up to here\n");
     if (!ds.AddZipEntry("dumpstate_log.txt", ds.log_path_.c_str())) {
@@ -2594,6 +2653,9 @@ Dumpstate::RunStatus Dumpstate::RunInternal(int32_t calling_uid,
             : "";
     progress_.reset(new Progress(stats_path));
 
+    start_time_ns_ = Nanotime();
+    time_budget_ms_ = android::base::GetIntProperty("dumpstate.time_budget_sec", 0) * 1000LL;
+
     if (acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_NAME) < 0) {
         MYLOGE("Failed to acquire wake lock: %s\n", strerror(errno));
     } else {
@@ -2989,22 +3051,59 @@ Dumpstate& Dumpstate::GetInstance() {
     return singleton_;
 }
 
-DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose)
-    : title_(title), logcat_only_(logcat_only), verbose_(verbose) {
+// CPU time used so far by the calling thread and by the commands it waited for.
+static uint64_t CpuTimeNs() {
+    uint64_t total = 0;
+    struct rusage usage;
+    for (int who : {RUSAGE_THREAD, RUSAGE_CHILDREN}) {
+        if (getrusage(who, &usage) == 0) {
+            total += (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NANOS_PER_SEC +
+                     (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+        }
+    }
+    return total;
+}
+
+// Current offset of |fd|, or -1 if it cannot seek.
+static off_t OutputOffset(int fd) {
+    if (fd == STDOUT_FILENO) {
+        fflush(stdout);
+    }
+    return lseek(fd, 0, SEEK_CUR);
+}
+
+DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose,
+                                   int out_fd)
+    : title_(title), logcat_only_(logcat_only), verbose_(verbose), out_fd_(out_fd) {
     if (!title_.empty()) {
         started_ = Nanotime();
+        started_cpu_ = CpuTimeNs();
+        started_offset_ = logcat_only_ ? -1 : OutputOffset(out_fd_);
     }
 }
 
+void DurationReporter::SetTimedOut() {
+    timed_out_ = true;
+}
+
 DurationReporter::~DurationReporter() {
     if (!title_.empty()) {
         float elapsed = (float)(Nanotime() - started_) / NANOS_PER_SEC;
+        float cpu = (float)(CpuTimeNs() - started_cpu_) / NANOS_PER_SEC;
+        off_t offset = started_offset_ == -1 ? -1 : OutputOffset(out_fd_);
+        int64_t bytes = offset == -1 ? -1 : offset - started_offset_;
+        ds.AddSectionProfile({title_, elapsed, cpu, bytes, timed_out_, false /* skipped */});
         if (elapsed >= .5f || verbose_) {
             MYLOGD("Duration of '%s': %.2fs\n", title_.c_str(), elapsed);
         }
         if (!logcat_only_) {
             // Use "Yoda grammar" to make it easier to grep|sort sections.
-            printf("------ %.3fs was the duration of '%s' ------\n", elapsed, title_.c_str());
+            if (out_fd_ == STDOUT_FILENO) {
+                printf("------ %.3fs was the duration of '%s' ------\n", elapsed, title_.c_str());
+            } else {
+                dprintf(out_fd_, "------ %.3fs was the duration of '%s' ------\n", elapsed,
+                        title_.c_str());
+            }
         }
     }
 }
@@ -3590,10 +3689,14 @@ int dump_file_from_fd(const char *title, const char *path, int fd) {
 }
 
 int Dumpstate::RunCommand(const std::string& title, const std::vector<std::string>& full_command,
-                          const CommandOptions& options, bool verbose_duration) {
-    DurationReporter duration_reporter(title, false /* logcat_only */, verbose_duration);
+                          const CommandOptions& options, bool verbose_duration, int out_fd) {
+    DurationReporter duration_reporter(title, false /* logcat_only */, verbose_duration, out_fd);
 
-    int status = RunCommandToFd(STDOUT_FILENO, title, full_command, options);
+    uint64_t start = Nanotime();
+    int status = RunCommandToFd(out_fd, title, full_command, options);
+    if (status == -1 && Nanotime() - start >= options.TimeoutInMs() * 1000000ULL) {
+        duration_reporter.SetTimedOut();
+    }
 
     /* TODO: for now we're simplifying the progress calculation by using the
      * timeout as the weight. It's a good approximation for most cases, except when calling dumpsys,
@@ -3605,11 +3708,11 @@ int Dumpstate::RunCommand(const std::string& title, const std::vector<std::strin
 }
 
 void Dumpstate::RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
-                           const CommandOptions& options, long dumpsysTimeoutMs) {
+                           const CommandOptions& options, long dumpsysTimeoutMs, int out_fd) {
     long timeout_ms = dumpsysTimeoutMs > 0 ? dumpsysTimeoutMs : options.TimeoutInMs();
     std::vector<std::string> dumpsys = {"/system/bin/dumpsys", "-T", std::to_string(timeout_ms)};
     dumpsys.insert(dumpsys.end(), dumpsys_args.begin(), dumpsys_args.end());
-    RunCommand(title, dumpsys, options);
+    RunCommand(title, dumpsys, options, false /* verbose_duration */, out_fd);
 }
 
 int open_socket(const char *service) {
@@ -3739,6 +3842,8 @@ void Dumpstate::UpdateProgress(int32_t delta_sec) {
         return;
     }
 
+    std::lock_guard<std::mutex> lock(progress_lock_);
+
     // Always update progess so stats can be tuned...
     progress_->Inc(delta_sec);
 
@@ -3773,6 +3878,23 @@ void Dumpstate::UpdateProgress(int32_t delta_sec) {
     }
 }
 
+void Dumpstate::AddSectionProfile(SectionProfile profile) {
+    std::lock_guard<std::mutex> lock(section_profiles_lock_);
+    section_profiles_.push_back(std::move(profile));
+}
+
+bool Dumpstate::IsOverTimeBudget() const {
+    return time_budget_ms_ > 0 &&
+           (Nanotime() - start_time_ns_) / NANOS_PER_MILLI > static_cast<uint64_t>(time_budget_ms_);
+}
+
+void Dumpstate::SkipSection(const std::string& title) {
+    printf("*** %s: skipped, bugreport is over its time budget of %" PRId64 "s\n", title.c_str(),
+           time_budget_ms_ / 1000);
+    MYLOGD("Skipping '%s', over the time budget\n", title.c_str());
+    AddSectionProfile({title, 0, 0, 0, false /* timed_out */, true /* skipped */});
+}
+
 void Dumpstate::TakeScreenshot(const std::string& path) {
     const std::string& real_path = path.empty() ? screenshot_path_ : path;
     int status =
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -75,15 +76,22 @@ extern "C" {
 class DurationReporter {
   public:
     explicit DurationReporter(const std::string& title, bool logcat_only = false,
-                              bool verbose = false);
+                              bool verbose = false, int out_fd = STDOUT_FILENO);
 
     ~DurationReporter();
 
+    /* Marks the section as having hit its timeout, for the section profile. */
+    void SetTimedOut();
+
   private:
     std::string title_;
     bool logcat_only_;
     bool verbose_;
+    int out_fd_;
     uint64_t started_;
+    uint64_t started_cpu_;
+    off_t started_offset_;
+    bool timed_out_ = false;
 
     DISALLOW_COPY_AND_ASSIGN(DurationReporter);
 };
@@ -227,11 +235,12 @@ class Dumpstate {
      * |full_command| array containing the command (first entry) and its arguments.
      * Must contain at least one element.
      * |options| optional argument defining the command's behavior.
+     * |out_fd| where the output goes, for sections dumped in parallel.
      */
     int RunCommand(const std::string& title, const std::vector<std::string>& fullCommand,
                    const android::os::dumpstate::CommandOptions& options =
                        android::os::dumpstate::CommandOptions::DEFAULT,
-                   bool verbose_duration = false);
+                   bool verbose_duration = false, int out_fd = STDOUT_FILENO);
 
     /*
      * Runs `dumpsys` with the given arguments, automatically setting its timeout
@@ -244,10 +253,11 @@ class Dumpstate {
      * |options| optional argument defining the command's behavior.
      * |dumpsys_timeout| when > 0, defines the value passed to `dumpsys -T` (otherwise it uses the
      * timeout from `options`)
+     * |out_fd| where the output goes, for sections dumped in parallel.
      */
     void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
                     const android::os::dumpstate::CommandOptions& options = DEFAULT_DUMPSYS,
-                    long dumpsys_timeout_ms = 0);
+                    long dumpsys_timeout_ms = 0, int out_fd = STDOUT_FILENO);
 
     /*
      * Prints the contents of a file.
@@ -311,6 +321,31 @@ class Dumpstate {
      */
     void UpdateProgress(int32_t delta);
 
+    /*
+     * How long one section took and how much it wrote, as reported in dumpstate_profile.txt.
+     */
+    struct SectionProfile {
+        std::string title;
+        float wall_sec;
+        // CPU time of dumpstate and of the commands the section ran.
+        float cpu_sec;
+        // -1 when the section wrote to something that cannot tell its size, like a pipe.
+        int64_t bytes;
+        bool timed_out;
+        bool skipped;
+    };
+
+    void AddSectionProfile(SectionProfile profile);
+
+    /*
+     * Returns true once the bugreport has run for longer than the budget set by the
+     * dumpstate.time_budget_sec property. Sections that are only nice to have are skipped then.
+     */
+    bool IsOverTimeBudget() const;
+
+    /* Records that |title| was skipped because the bugreport went over its time budget. */
+    void SkipSection(const std::string& title);
+
     /* Prints the dumpstate header on `stdout`. */
     void PrintHeader() const;
 
@@ -435,6 +470,19 @@ class Dumpstate {
     // Runtime options.
     std::unique_ptr<DumpOptions> options_;
 
+    // Guards progress updates, which can come from the sections dumped in parallel.
+    std::mutex progress_lock_;
+
+    // Guards section_profiles_, which are added by the sections dumped in parallel.
+    std::mutex section_profiles_lock_;
+
+    // Sections in the order they finished, written to dumpstate_profile.txt in the zip.
+    std::vector<SectionProfile> section_profiles_;
+
+    // When the bugreport started, and after how long sections are skipped (0 for never).
+    uint64_t start_time_ns_ = 0;
+    int64_t time_budget_ms_ = 0;
+
     // Last progress that was sent to the listener [0-100].
     int last_reported_percent_progress_ = 0;
 
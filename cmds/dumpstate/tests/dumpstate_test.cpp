@@ -17,6 +17,7 @@
 #define LOG_TAG "dumpstate"
 #include <cutils/log.h>
 
+#include "DumpPool.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
 #include "android/os/BnDumpstate.h"
@@ -1618,6 +1619,60 @@ TEST_F(DumpstateUtilTest, DumpFileOnDryRun) {
     EXPECT_THAT(out, EndsWith("skipped on dry run\n"));
 }
 
+class DumpPoolTest : public DumpstateBaseTest {
+  public:
+    void SetUp() {
+        DumpstateBaseTest::SetUp();
+        path_ = kTestDataPath + "DumpPoolTest.txt";
+        fd_.reset(TEMP_FAILURE_RETRY(open(path_.c_str(),
+                                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
+                                          S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)));
+        ASSERT_GE(fd_.get(), 0) << "could not create FD for path " << path_;
+    }
+
+    std::string ReadOutput() {
+        std::string out;
+        fd_.reset();
+        android::base::ReadFileToString(path_, &out);
+        return out;
+    }
+
+    std::string path_;
+    android::base::unique_fd fd_;
+};
+
+TEST_F(DumpPoolTest, OutputFollowsWaitOrder) {
+    DumpPool pool(kTestDataPath, 2);
+    pool.enqueueTaskWithFd("first", [](int out_fd) {
+        // Finishes after the second task.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        dprintf(out_fd, "first\n");
+    });
+    pool.enqueueTaskWithFd("second", [](int out_fd) { dprintf(out_fd, "second\n"); });
+
+    EXPECT_TRUE(pool.waitForTask("first", fd_.get()));
+    EXPECT_TRUE(pool.waitForTask("second", fd_.get()));
+    EXPECT_THAT(ReadOutput(), StrEq("first\nsecond\n"));
+}
+
+TEST_F(DumpPoolTest, WaitForUnknownTask) {
+    DumpPool pool(kTestDataPath, 1);
+    EXPECT_FALSE(pool.waitForTask("unknown", fd_.get()));
+}
+
+TEST_F(DumpPoolTest, RunCommandsInParallel) {
+    DumpPool pool(kTestDataPath, 2);
+    for (const char* name : {"first", "second"}) {
+        pool.enqueueTaskWithFd(name, [this](int out_fd) {
+            RunCommandToFd(out_fd, "", {kSimpleCommand});
+        });
+    }
+
+    EXPECT_TRUE(pool.waitForTask("first", fd_.get()));
+    EXPECT_TRUE(pool.waitForTask("second", fd_.get()));
+    EXPECT_THAT(ReadOutput(), StrEq("stdout\nstdout\n"));
+}
+
 }  // namespace dumpstate
 }  // namespace os
 }  // namespace android
@@ -15,8 +15,12 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 #include <android-base/file.h>
@@ -35,6 +39,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -60,8 +65,8 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--help | -l | --skip SERVICES "
-            "| SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--parallel N] [--help | -l | "
+            "--skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
@@ -71,10 +76,43 @@ static void usage() {
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
             "               LEVEL must be one of CRITICAL | HIGH | NORMAL\n"
+            "         --parallel N: dump up to N services at a time. Their output is still\n"
+            "               written in order.\n"
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
 
+namespace {
+
+// The dump of a service taken ahead of its turn by --parallel.
+struct BufferedDump {
+    std::mutex lock;
+    std::condition_variable finished;
+    bool done = false;
+    // Holds the output, or -1 if the service has to be dumped in turn instead.
+    unique_fd fd;
+    // Whether the dump thread could be started.
+    bool started = false;
+    status_t status = OK;
+    std::chrono::duration<double> elapsedDuration;
+};
+
+}  // namespace
+
+static bool CopyDump(int from, int to) {
+    if (lseek(from, 0, SEEK_SET) == -1) {
+        return false;
+    }
+    char buf[4096];
+    ssize_t rc;
+    while ((rc = TEMP_FAILURE_RETRY(read(from, buf, sizeof(buf)))) > 0) {
+        if (!WriteFully(to, buf, rc)) {
+            return false;
+        }
+    }
+    return rc == 0;
+}
+
 static bool IsSkipped(const Vector<String16>& skipped, const String16& service) {
     for (const auto& candidate : skipped) {
         if (candidate == service) {
@@ -124,8 +162,10 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool asProto = false;
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
+    size_t parallelism = 1;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"pid", no_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
@@ -163,6 +203,14 @@ int Dumpsys::main(int argc, char* const argv[]) {
                 }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                long parallelArg = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || parallelArg <= 0) {
+                    fprintf(stderr, "Error: invalid parallel number: '%s'\n", optarg);
+                    return -1;
+                }
+                parallelism = parallelArg;
             }
             break;
 
@@ -248,10 +296,74 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    // With --parallel, workers dump the services into memory files ahead of their turn, and the
+    // loop below writes out each one once it is done.
+    std::vector<std::unique_ptr<BufferedDump>> bufferedDumps;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextService(0);
+    if (parallelism > 1 && N > 1) {
+        for (size_t i = 0; i < N; i++) {
+            bufferedDumps.push_back(std::make_unique<BufferedDump>());
+        }
+        for (size_t t = 0; t < std::min(parallelism, N); t++) {
+            workers.emplace_back([&]() {
+                size_t i;
+                while ((i = nextService++) < N) {
+                    BufferedDump& dump = *bufferedDumps[i];
+                    if (!IsSkipped(skippedServices, services[i])) {
+                        dump.fd.reset(memfd_create("dumpsys", MFD_CLOEXEC));
+                    }
+                    if (dump.fd != -1) {
+                        Dumpsys worker(sm_);
+                        if (worker.startDumpThread(type, services[i], args) == OK) {
+                            size_t bytesWritten = 0;
+                            dump.status = worker.writeDump(dump.fd.get(), services[i],
+                                                           std::chrono::milliseconds(timeoutArgMs),
+                                                           asProto, dump.elapsedDuration,
+                                                           bytesWritten);
+                            worker.stopDumpThread(dump.status == OK);
+                            dump.started = true;
+                        }
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(dump.lock);
+                        dump.done = true;
+                    }
+                    dump.finished.notify_one();
+                }
+            });
+        }
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
 
+        if (!bufferedDumps.empty()) {
+            BufferedDump& dump = *bufferedDumps[i];
+            {
+                std::unique_lock<std::mutex> lock(dump.lock);
+                dump.finished.wait(lock, [&dump]() { return dump.done; });
+            }
+            if (dump.fd != -1) {
+                if (dump.started) {
+                    writeDumpHeader(STDOUT_FILENO, serviceName, priorityFlags);
+                    if (!CopyDump(dump.fd.get(), STDOUT_FILENO)) {
+                        std::cerr << "Failed to write the dump of service " << serviceName
+                                  << ": " << strerror(errno) << std::endl;
+                    }
+                    if (dump.status == TIMED_OUT) {
+                        std::cout << std::endl
+                             << "*** SERVICE '" << serviceName << "' DUMP TIMEOUT ("
+                             << timeoutArgMs << "ms) EXPIRED ***" << std::endl
+                             << std::endl;
+                    }
+                    writeDumpFooter(STDOUT_FILENO, serviceName, dump.elapsedDuration);
+                }
+                continue;
+            }
+        }
+
         if (startDumpThread(type, serviceName, args) == OK) {
             bool addSeparator = (N > 1);
             if (addSeparator) {
@@ -278,6 +390,10 @@ int Dumpsys::main(int argc, char* const argv[]) {
         }
     }
 
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
     return 0;
 }
 
@@ -426,6 +426,28 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel 2 --skip skipped4' with services that are not all running
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3", "skipped4", "running5"});
+    ExpectDump("running1", "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+    ExpectDump("skipped4", "dump4");
+    ExpectDump("running5", "dump5");
+
+    CallMain({"--parallel", "2", "--skip", "skipped4"});
+
+    AssertRunningServices({"running1", "running3", "skipped4 (skipped)", "running5"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertNotDumped("dump4");
+    AssertDumped("running5", "dump5");
+    // The dumps are written in the order of the services.
+    EXPECT_LT(stdout_.find("dump1"), stdout_.find("dump3"));
+    EXPECT_LT(stdout_.find("dump3"), stdout_.find("dump5"));
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
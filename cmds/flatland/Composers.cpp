@@ -17,6 +17,8 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <algorithm>
+
 #include "Flatland.h"
 #include "GLHelper.h"
 
@@ -25,13 +27,18 @@ namespace android {
 class Blitter {
 public:
 
-    bool setUp(GLHelper* helper) {
+    // Blits with the named shader program, which samples a texture of the
+    // given target through the same attributes and uniforms as "Blit". The
+    // program may declare more uniforms, set through program().
+    bool setUp(GLHelper* helper, const char* pgmName = "Blit",
+            GLenum texTarget = GL_TEXTURE_EXTERNAL_OES) {
         bool result;
 
-        result = helper->getShaderProgram("Blit", &mBlitPgm);
+        result = helper->getShaderProgram(pgmName, &mBlitPgm);
         if (!result) {
             return false;
         }
+        mTexTarget = texTarget;
 
         mPosAttribLoc = glGetAttribLocation(mBlitPgm, "position");
         mUVAttribLoc = glGetAttribLocation(mBlitPgm, "uv");
@@ -84,7 +91,7 @@ public:
         glUniform4fv(mModColorUniformLoc, 1, modColor);
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, texName);
+        glBindTexture(mTexTarget, texName);
         glUniform1i(mBlitSrcSamplerLoc, 0);
 
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -99,8 +106,13 @@ public:
         return true;
     }
 
+    GLuint program() const {
+        return mBlitPgm;
+    }
+
 private:
     GLuint mBlitPgm;
+    GLenum mTexTarget;
     GLint mPosAttribLoc;
     GLint mUVAttribLoc;
     GLint mUVToTexUniformLoc;
@@ -282,4 +294,238 @@ Composer* blendShrink() {
     return new BlendShrinkComp();
 }
 
+// The corner radius and shadow length of a layer, in proportion to its size
+// since layers are scaled with the resolution of the run.
+static int32_t cornerRadius(const LayerDesc& desc) {
+    return int32_t(std::min(desc.width, desc.height) / 24);
+}
+
+static int32_t shadowLength(const LayerDesc& desc) {
+    return int32_t(std::min(desc.width, desc.height) / 32);
+}
+
+// Sets the uniforms describing the rounded rectangle of a layer, used by the
+// "RoundedBlit" and "Shadow" programs.
+static void setRoundedRectUniforms(GLuint pgm, float w, float h,
+        float cornerRadius) {
+    glUseProgram(pgm);
+    glUniform2f(glGetUniformLocation(pgm, "size"), w, h);
+    glUniform1f(glGetUniformLocation(pgm, "cornerRadius"), cornerRadius);
+}
+
+// Window corners are rounded by the shader, like SurfaceFlinger's
+// RenderEngine does for layers with a corner radius, so the layer is blended
+// even though its content is opaque.
+Composer* roundedCorners() {
+    class RoundedCornersComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            bool result = mBlitter.setUp(helper, "RoundedBlit");
+            if (!result) {
+                return false;
+            }
+            setRoundedRectUniforms(mBlitter.program(), mLayerDesc.width,
+                    mLayerDesc.height, cornerRadius(mLayerDesc));
+            return true;
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+            bool result = mBlitter.blit(texName, texMatrix, mLayerDesc.x,
+                    mLayerDesc.y, mLayerDesc.width, mLayerDesc.height);
+
+            glDisable(GL_BLEND);
+
+            return result;
+        }
+
+        Blitter mBlitter;
+    };
+    return new RoundedCornersComp();
+}
+
+// An elevated window: a soft shadow is drawn around and under the window,
+// which is then drawn with rounded corners on top of it.
+Composer* shadow() {
+    class ShadowComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            mShadowLength = shadowLength(mLayerDesc);
+
+            bool result = mShadowBlitter.setUp(helper, "Shadow");
+            if (!result) {
+                return false;
+            }
+            setRoundedRectUniforms(mShadowBlitter.program(),
+                    mLayerDesc.width + 2 * mShadowLength,
+                    mLayerDesc.height + 2 * mShadowLength,
+                    cornerRadius(mLayerDesc) + mShadowLength);
+            glUniform1f(glGetUniformLocation(mShadowBlitter.program(),
+                    "shadowLength"), mShadowLength);
+
+            result = mBlitter.setUp(helper, "RoundedBlit");
+            if (!result) {
+                return false;
+            }
+            setRoundedRectUniforms(mBlitter.program(), mLayerDesc.width,
+                    mLayerDesc.height, cornerRadius(mLayerDesc));
+            return true;
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            bool result;
+
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            float shadowColor[4] = { 0.0f, 0.0f, 0.0f, 0.4f };
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+            // The shadow is offset down a bit, as if lit from above.
+            result = mShadowBlitter.modBlit(texName, texMatrix, shadowColor,
+                    mLayerDesc.x - mShadowLength,
+                    mLayerDesc.y - mShadowLength / 2,
+                    mLayerDesc.width + 2 * mShadowLength,
+                    mLayerDesc.height + 2 * mShadowLength);
+            if (!result) {
+                return false;
+            }
+
+            result = mBlitter.blit(texName, texMatrix, mLayerDesc.x,
+                    mLayerDesc.y, mLayerDesc.width, mLayerDesc.height);
+
+            glDisable(GL_BLEND);
+
+            return result;
+        }
+
+        Blitter mShadowBlitter;
+        Blitter mBlitter;
+        int32_t mShadowLength;
+    };
+    return new ShadowComp();
+}
+
+// A translucent window over a blurred copy of what is behind it. Like
+// RenderEngine, the area behind the window is read back from the target and
+// drawn back blurred before the window is blended over it. The blur samples
+// taps spread as widely as those of the downsampled passes of RenderEngine's
+// blur, in a single pass.
+Composer* backgroundBlur() {
+    class BackgroundBlurComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            bool result = mBlurBlitter.setUp(helper, "Blur", GL_TEXTURE_2D);
+            if (!result) {
+                return false;
+            }
+
+            result = mBlitter.setUp(helper);
+            if (!result) {
+                return false;
+            }
+
+            glGenTextures(1, &mBackgroundTexName);
+            glBindTexture(GL_TEXTURE_2D, mBackgroundTexName);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mLayerDesc.width,
+                    mLayerDesc.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+            glUseProgram(mBlurBlitter.program());
+            glUniform2f(glGetUniformLocation(mBlurBlitter.program(),
+                    "texelSize"), 4.0f / float(mLayerDesc.width),
+                    4.0f / float(mLayerDesc.height));
+            return true;
+        }
+
+        virtual void tearDown() {
+            glDeleteTextures(1, &mBackgroundTexName);
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            bool result;
+
+            // Read back what was composed behind the window. GL window
+            // coordinates start at the bottom.
+            GLint vp[4];
+            glGetIntegerv(GL_VIEWPORT, vp);
+            glBindTexture(GL_TEXTURE_2D, mBackgroundTexName);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mLayerDesc.x,
+                    vp[3] - mLayerDesc.y - int32_t(mLayerDesc.height),
+                    mLayerDesc.width, mLayerDesc.height);
+
+            // Flip the copy, since the blit starts at the top.
+            const float flipMatrix[16] = {
+                1.0f, 0.0f,  0.0f, 0.0f,
+                0.0f, -1.0f, 0.0f, 0.0f,
+                0.0f, 0.0f,  1.0f, 0.0f,
+                0.0f, 1.0f,  0.0f, 1.0f,
+            };
+            result = mBlurBlitter.blit(mBackgroundTexName, flipMatrix,
+                    mLayerDesc.x, mLayerDesc.y, mLayerDesc.width,
+                    mLayerDesc.height);
+            if (!result) {
+                return false;
+            }
+
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            float modColor[4] = { .5f, .5f, .5f, .5f };
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+            result = mBlitter.modBlit(texName, texMatrix, modColor,
+                    mLayerDesc.x, mLayerDesc.y, mLayerDesc.width,
+                    mLayerDesc.height);
+
+            glDisable(GL_BLEND);
+
+            return result;
+        }
+
+        Blitter mBlurBlitter;
+        Blitter mBlitter;
+        GLuint mBackgroundTexName;
+    };
+    return new BackgroundBlurComp();
+}
+
+// An HDR10 video layer: the content is decoded from PQ to linear light, tone
+// mapped to the display's luminance, and encoded to sRGB, the way
+// RenderEngine composes HDR layers on an SDR display.
+Composer* hdrToneMap() {
+    class HdrToneMapComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            bool result = mBlitter.setUp(helper, "ToneMapBlit");
+            if (!result) {
+                return false;
+            }
+            glUseProgram(mBlitter.program());
+            glUniform1f(glGetUniformLocation(mBlitter.program(),
+                    "displayMaxLuminance"), 500.0f);
+            return true;
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            return mBlitter.blit(texName, texMatrix, mLayerDesc.x,
+                    mLayerDesc.y, mLayerDesc.width, mLayerDesc.height);
+        }
+
+        Blitter mBlitter;
+    };
+    return new HdrToneMapComp();
+}
+
 } // namespace android
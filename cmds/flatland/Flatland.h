@@ -57,6 +57,10 @@ Composer* opaque();
 Composer* opaqueShrink();
 Composer* blend();
 Composer* blendShrink();
+Composer* roundedCorners();
+Composer* shadow();
+Composer* backgroundBlur();
+Composer* hdrToneMap();
 
 class Renderer {
 public:
@@ -242,7 +242,8 @@ bool GLHelper::computeWindowScale(uint32_t w, uint32_t h, float* scale) {
 }
 
 bool GLHelper::createWindowSurface(uint32_t w, uint32_t h,
-        sp<SurfaceControl>* surfaceControl, EGLSurface* surface) {
+        sp<SurfaceControl>* surfaceControl, EGLSurface* surface,
+        sp<BLASTBufferQueue>* blastBufferQueue) {
     bool result;
     status_t err;
 
@@ -255,8 +256,10 @@ bool GLHelper::createWindowSurface(uint32_t w, uint32_t h,
         return false;
     }
 
+    uint32_t flags = blastBufferQueue != nullptr ?
+            ISurfaceComposerClient::eFXSurfaceBufferState : 0;
     sp<SurfaceControl> sc = mSurfaceComposerClient->createSurface(
-            String8("Benchmark"), w, h, PIXEL_FORMAT_RGBA_8888, 0);
+            String8("Benchmark"), w, h, PIXEL_FORMAT_RGBA_8888, flags);
     if (sc == nullptr || !sc->isValid()) {
         fprintf(stderr, "Failed to create SurfaceControl.\n");
         return false;
@@ -268,12 +271,28 @@ bool GLHelper::createWindowSurface(uint32_t w, uint32_t h,
         return false;
     }
 
-    SurfaceComposerClient::Transaction{}.setLayer(sc, 0x7FFFFFFF)
-            .setMatrix(sc, scale, 0.0f, 0.0f, scale)
-            .show(sc)
-            .apply();
+    sp<ANativeWindow> anw;
+    if (blastBufferQueue != nullptr) {
+        // Buffer state layers are scaled to their frame rather than by a
+        // matrix.
+        SurfaceComposerClient::Transaction{}.setLayer(sc, 0x7FFFFFFF)
+                .setFrame(sc, Rect(uint32_t(scale * float(w)),
+                        uint32_t(scale * float(h))))
+                .show(sc)
+                .apply();
+
+        *blastBufferQueue = new BLASTBufferQueue(sc, w, h);
+        anw = new Surface((*blastBufferQueue)->getIGraphicBufferProducer(),
+                true);
+    } else {
+        SurfaceComposerClient::Transaction{}.setLayer(sc, 0x7FFFFFFF)
+                .setMatrix(sc, scale, 0.0f, 0.0f, scale)
+                .show(sc)
+                .apply();
+
+        anw = sc->getSurface();
+    }
 
-    sp<ANativeWindow> anw = sc->getSurface();
     EGLSurface s = eglCreateWindowSurface(mDisplay, mConfig, anw.get(), nullptr);
     if (s == EGL_NO_SURFACE) {
         fprintf(stderr, "eglCreateWindowSurface error: %#x\n", eglGetError());
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <gui/BLASTBufferQueue.h>
 #include <gui/GLConsumer.h>
 #include <gui/Surface.h>
 #include <gui/SurfaceControl.h>
@@ -54,8 +55,13 @@ public:
             sp<GLConsumer>* surfaceTexture, EGLSurface* surface,
             GLuint* name);
 
+    // Creates a window showing the surface on the display. When
+    // blastBufferQueue is not null, the window is a buffer state layer fed
+    // through a BLASTBufferQueue, which is returned there and must be kept
+    // alive with the window.
     bool createWindowSurface(uint32_t w, uint32_t h,
-            sp<SurfaceControl>* surfaceControl, EGLSurface* surface);
+            sp<SurfaceControl>* surfaceControl, EGLSurface* surface,
+            sp<BLASTBufferQueue>* blastBufferQueue = nullptr);
 
     void destroySurface(EGLSurface* surface);
 
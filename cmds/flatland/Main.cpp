@@ -36,6 +36,8 @@ using namespace ::android;
 
 static uint32_t g_SleepBetweenSamplesMs = 0;
 static bool     g_PresentToWindow       = false;
+static bool     g_UseBlast              = false;
+static bool     g_CsvOutput             = false;
 static size_t   g_BenchmarkNameLen      = 0;
 
 struct BenchmarkDesc {
@@ -201,6 +203,98 @@ static const BenchmarkDesc benchmarks[] = {
             },
         },
     },
+
+    { "16:10 Recents",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Wallpaper
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Task
+                0, staticGradient, roundedCorners,
+                80,   250,    760,    1100,
+            },
+            {   // Task
+                0, staticGradient, roundedCorners,
+                900,  250,    760,    1100,
+            },
+            {   // Task
+                0, staticGradient, roundedCorners,
+                1720, 250,    760,    1100,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 Floating Window With Shadow",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Wallpaper
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Launcher
+                0, staticGradient, blend,
+                0,    50,     2560,   1454,
+            },
+            {   // Floating window
+                0, staticGradient, shadow,
+                320,  250,    1920,   1100,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 Dialog With Background Blur",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // Activity
+                0, staticGradient, opaque,
+                0,    50,     2560,   1454,
+            },
+            {   // Dialog
+                0, staticGradient, backgroundBlur,
+                640,  400,    1280,   800,
+            },
+            {   // Status bar
+                0, staticGradient, opaque,
+                0,    0,      2560,   50,
+            },
+            {   // Navigation bar
+                0, staticGradient, opaque,
+                0,    1504,   2560,   96,
+            },
+        },
+    },
+
+    { "16:10 HDR Video Playback",
+        2560, 1600, { 800, 1200, 1600, 2400 },
+        {
+            {   // HDR SurfaceView
+                0, staticGradient, hdrToneMap,
+                0,    0,      2560,   1600,
+            },
+            {   // Playback controls
+                0, staticGradient, blend,
+                0,    1300,   2560,   300,
+            },
+        },
+    },
 };
 
 static const ShaderDesc shaders[] = {
@@ -277,6 +371,205 @@ static const ShaderDesc shaders[] = {
             "}",
         },
     },
+
+    {
+        .name="RoundedBlit",
+        .vertexShader={
+            "precision highp float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH",
+            "precision highp float;",
+            "#else",
+            "precision mediump float;",
+            "#endif",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform vec2 size;",
+            "uniform float cornerRadius;",
+            "",
+            "void main() {",
+            "    vec2 halfSize = size * 0.5;",
+            "    vec2 d = max(abs(layerCoords * size - halfSize) - halfSize +",
+            "            cornerRadius, 0.0);",
+            "    float coverage = clamp(cornerRadius - length(d) + 0.5, 0.0, 1.0);",
+            "    gl_FragColor = texture2D(blitSrc, texCoords.xy);",
+            "    gl_FragColor *= modColor * coverage;",
+            "}",
+        },
+    },
+
+    {
+        .name="Shadow",
+        .vertexShader={
+            "precision highp float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy;",
+            "}",
+        },
+        .fragmentShader={
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH",
+            "precision highp float;",
+            "#else",
+            "precision mediump float;",
+            "#endif",
+            "",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform vec4 modColor;",
+            "uniform vec2 size;",
+            "uniform float cornerRadius;",
+            "uniform float shadowLength;",
+            "",
+            "void main() {",
+            "    vec2 halfSize = size * 0.5;",
+            "    vec2 d = max(abs(layerCoords * size - halfSize) - halfSize +",
+            "            cornerRadius, 0.0);",
+            "    float dist = length(d) - cornerRadius;",
+            "    gl_FragColor = modColor * (1.0 - smoothstep(-shadowLength, 0.0, dist));",
+            "}",
+        },
+    },
+
+    {
+        .name="Blur",
+        .vertexShader={
+            "precision highp float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy;",
+            "}",
+        },
+        .fragmentShader={
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform sampler2D blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform vec2 texelSize;",
+            "",
+            "vec4 tap(float x, float y) {",
+            "    return texture2D(blitSrc, texCoords.xy + vec2(x, y) * texelSize);",
+            "}",
+            "",
+            "void main() {",
+            "    vec4 sum = tap(0.0, 0.0) * 4.0;",
+            "    sum += (tap(-1.0, 0.0) + tap(1.0, 0.0) + tap(0.0, -1.0) +",
+            "            tap(0.0, 1.0)) * 2.0;",
+            "    sum += tap(-1.0, -1.0) + tap(1.0, -1.0) + tap(-1.0, 1.0) +",
+            "            tap(1.0, 1.0);",
+            "    gl_FragColor = sum / 16.0 * modColor;",
+            "}",
+        },
+    },
+
+    {
+        .name="ToneMapBlit",
+        .vertexShader={
+            "precision highp float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH",
+            "precision highp float;",
+            "#else",
+            "precision mediump float;",
+            "#endif",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform float displayMaxLuminance;",
+            "",
+            "// SMPTE ST 2084 EOTF, in nits.",
+            "vec3 pqToNits(vec3 color) {",
+            "    const float m1 = 2610.0 / 16384.0;",
+            "    const float m2 = (2523.0 / 4096.0) * 128.0;",
+            "    const float c1 = 3424.0 / 4096.0;",
+            "    const float c2 = (2413.0 / 4096.0) * 32.0;",
+            "    const float c3 = (2392.0 / 4096.0) * 32.0;",
+            "    vec3 p = pow(clamp(color, 0.0, 1.0), vec3(1.0 / m2));",
+            "    p = max(p - c1, 0.0) / (c2 - c3 * p);",
+            "    return pow(p, vec3(1.0 / m1)) * 10000.0;",
+            "}",
+            "",
+            "void main() {",
+            "    vec4 color = texture2D(blitSrc, texCoords.xy);",
+            "    vec3 nits = pqToNits(color.rgb);",
+            "    // Extended Reinhard on the BT.2020 luminance, mapping the",
+            "    // 10000 nit range of the content to the display.",
+            "    float y = dot(nits, vec3(0.2627, 0.6780, 0.0593));",
+            "    float ratio = y / displayMaxLuminance;",
+            "    float maxRatio = 10000.0 / displayMaxLuminance;",
+            "    float mapped = ratio * (1.0 + ratio / (maxRatio * maxRatio)) /",
+            "            (1.0 + ratio);",
+            "    vec3 linear = nits / displayMaxLuminance *",
+            "            (mapped / max(ratio, 0.0001));",
+            "    gl_FragColor = vec4(pow(clamp(linear, 0.0, 1.0),",
+            "            vec3(1.0 / 2.2)), color.a) * modColor;",
+            "}",
+        },
+    },
 };
 
 class Layer {
@@ -422,7 +715,8 @@ public:
 
         if (g_PresentToWindow) {
             result = mGLHelper->createWindowSurface(w, h, &mSurfaceControl,
-                    &mWindowSurface);
+                    &mWindowSurface,
+                    g_UseBlast ? &mBlastBufferQueue : nullptr);
             if (!result) {
                 return false;
             }
@@ -450,6 +744,7 @@ public:
             mGLHelper->destroySurface(&mSurface);
             mGLConsumer->abandon();
             mGLConsumer.clear();
+            mBlastBufferQueue.clear();
             mSurfaceControl.clear();
             mGLHelper->tearDown();
             delete mGLHelper;
@@ -573,6 +868,7 @@ private:
     // Used for displaying the surface to a window.
     EGLSurface mWindowSurface;
     sp<SurfaceControl> mSurfaceControl;
+    sp<BLASTBufferQueue> mBlastBufferQueue;
 
     Layer mLayers[MAX_NUM_LAYERS];
 };
@@ -586,17 +882,27 @@ static int cmpDouble(const double* lhs, const double* rhs) {
     return 0;
 }
 
+// Return the sample at the given fraction of the sorted samples.
+static double percentile(const Vector<double>& samples, double fraction) {
+    size_t elem = size_t(fraction * double(samples.size()));
+    return samples[elem < samples.size() ? elem : samples.size() - 1];
+}
+
 // Run a single benchmark and print the result.
 static bool runTest(const BenchmarkDesc b, size_t run) {
     bool success = true;
     double prevResult = 0.0, result = 0.0;
     Vector<double> samples;
+    const char* status = nullptr;
+    double frameTime = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0;
 
     uint32_t runHeight = b.runHeights[run];
     uint32_t runWidth = b.width * runHeight / b.height;
-    printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen), b.name,
-            runWidth, runHeight);
-    fflush(stdout);
+    if (!g_CsvOutput) {
+        printf(" %-*s | %4d x %4d | ", static_cast<int>(g_BenchmarkNameLen),
+                b.name, runWidth, runHeight);
+        fflush(stdout);
+    }
 
     BenchmarkRunner r(b, run);
     if (!r.setUp()) {
@@ -627,11 +933,11 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
     if (totalFrames - warmUpFrames > 16) {
         // The test runs too fast to get a stable result.  Skip it.
-        printf("  fast");
+        status = "fast";
         goto done;
     } else if (totalFrames == 5 && runTime > 200e6) {
         // The test runs too slow to be very useful.  Skip it.
-        printf("  slow");
+        status = "slow";
         goto done;
     }
 
@@ -642,7 +948,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         }
 
         if (newSamples > 512) {
-            printf("varies");
+            status = "varies";
             goto done;
         }
 
@@ -655,6 +961,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
             if (sample < 0.0) {
                 success = false;
+                status = "error";
                 goto done;
             }
 
@@ -668,11 +975,24 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         result = (samples[elem-1] + samples[elem]) * 0.5;
     } while (fabs(result - prevResult) > threshold * result);
 
-    printf("%6.3f", result / double(totalFrames - warmUpFrames) / 1e6);
+    // Each sample is the time of a run of frames, so the percentiles are
+    // those of the average frame time of a run.
+    frameTime = 1e6 * double(totalFrames - warmUpFrames);
+    p50 = percentile(samples, .50) / frameTime;
+    p90 = percentile(samples, .90) / frameTime;
+    p99 = percentile(samples, .99) / frameTime;
+    frameTime = result / frameTime;
 
 done:
 
-    printf("\n");
+    if (g_CsvOutput) {
+        printf("\"%s\",%u,%u,%.3f,%.3f,%.3f,%.3f,%s\n", b.name, runWidth,
+                runHeight, frameTime, p50, p90, p99, status ? status : "ok");
+    } else if (status != nullptr) {
+        printf("%9s |        |        |\n", status);
+    } else {
+        printf("%9.3f | %6.3f | %6.3f | %6.3f\n", frameTime, p50, p90, p99);
+    }
     fflush(stdout);
     r.tearDown();
 
@@ -680,11 +1000,16 @@ done:
 }
 
 static void printResultsTableHeader() {
+    if (g_CsvOutput) {
+        printf("scenario,width,height,time_ms,p50_ms,p90_ms,p99_ms,status\n");
+        return;
+    }
+
     const char* scenario = "Scenario";
     size_t len = strlen(scenario);
     size_t leftPad = (g_BenchmarkNameLen - len) / 2;
     size_t rightPad = g_BenchmarkNameLen - len - leftPad;
-    printf(" %*s%s%*s | Resolution  | Time (ms)\n",
+    printf(" %*s%s%*s | Resolution  | Time (ms) |  p50   |  p90   |  p99\n",
             static_cast<int>(leftPad), "",
             "Scenario", static_cast<int>(rightPad), "");
 }
@@ -723,6 +1048,8 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -b              display the window through a BLASTBufferQueue\n"
+                    "  -c              print the results as CSV, with times in ms\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -741,7 +1068,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "bcds:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -749,6 +1076,14 @@ int main(int argc, char** argv) {
         }
 
         switch(ret) {
+            case 'b':
+                g_UseBlast = true;
+            break;
+
+            case 'c':
+                g_CsvOutput = true;
+            break;
+
             case 'd':
                 g_PresentToWindow = true;
             break;
@@ -772,11 +1107,13 @@ int main(int argc, char** argv) {
 
     g_BenchmarkNameLen = maxBenchmarkNameLen();
 
-    printf(" cmdline:");
-    for (int i = 0; i < argc; i++) {
-        printf(" %s", argv[i]);
+    if (!g_CsvOutput) {
+        printf(" cmdline:");
+        for (int i = 0; i < argc; i++) {
+            printf(" %s", argv[i]);
+        }
+        printf("\n");
     }
-    printf("\n");
 
     if (!runTests()) {
         fprintf(stderr, "exiting due to error.\n");
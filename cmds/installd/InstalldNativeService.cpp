@@ -19,11 +19,13 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
 #include <functional>
 #include <inttypes.h>
+#include <list>
 #include <regex>
 #include <stdlib.h>
 #include <string.h>
@@ -38,7 +40,9 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
+#include <unordered_map>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -53,7 +57,6 @@
 #include <cutils/properties.h>
 #include <cutils/sched_policy.h>
 #include <log/log.h>               // TODO: Move everything to base/logging.
-#include <logwrap/logwrap.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_projectid_config.h>
 #include <selinux/android.h>
@@ -88,7 +91,6 @@ static constexpr const char* kTestUuid = "TEST";
 
 static constexpr const mode_t kRollbackFolderMode = 0700;
 
-static constexpr const char* kCpPath = "/system/bin/cp";
 static constexpr const char* kXattrDefault = "user.default";
 
 static constexpr const char* kDataMirrorCePath = "/data_mirror/data_ce";
@@ -96,6 +98,9 @@ static constexpr const char* kDataMirrorDePath = "/data_mirror/data_de";
 
 static constexpr const int MIN_RESTRICTED_HOME_SDK_VERSION = 24; // > M
 
+// The number of threads that batch operations spread independent work over.
+static constexpr const size_t kMaxWorkerThreads = 4;
+
 static constexpr const char* PKG_LIB_POSTFIX = "/lib";
 static constexpr const char* CACHE_DIR_POSTFIX = "/cache";
 static constexpr const char* CODE_CACHE_DIR_POSTFIX = "/code_cache";
@@ -264,8 +269,125 @@ binder::Status checkArgumentPath(const std::unique_ptr<std::string>& path) {
     }                                                       \
 }
 
+// Set while a binder call holds its locks, see InstalldNativeService::ScopedLock.
+thread_local bool sHoldsLocks = false;
+
+// Returns the lock for key, creating it if no binder call is using it. mLocksLock must be held.
+template <typename Key, typename Mutex>
+std::shared_ptr<Mutex> findLock(std::unordered_map<Key, std::weak_ptr<Mutex>>& locks,
+        const Key& key) {
+    std::weak_ptr<Mutex>& entry = locks[key];
+    std::shared_ptr<Mutex> lock = entry.lock();
+    if (lock == nullptr) {
+        lock = std::make_shared<Mutex>();
+        entry = lock;
+    }
+    return lock;
+}
+
+// Runs task(i) for every i below count, on up to maxThreads threads including the calling one.
+// Each thread picks the next index when it is done with its previous one. No new task is started
+// once a task returns false.
+void forEachInParallel(size_t count, size_t maxThreads, const std::function<bool(size_t)>& task) {
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto runNext = [&]() {
+        for (size_t i = next++; i < count && !failed; i = next++) {
+            if (!task(i)) {
+                failed = true;
+            }
+        }
+    };
+    size_t threadCount = std::min<size_t>({std::thread::hardware_concurrency(), maxThreads, count});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(runNext);
+    }
+    runNext();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 }  // namespace
 
+InstalldNativeService::ScopedLock::ScopedLock(std::shared_mutex& lock, bool exclusive)
+        : mOutermost(!sHoldsLocks) {
+    if (!mOutermost) {
+        return;
+    }
+    if (exclusive) {
+        mExclusiveLock = std::unique_lock<std::shared_mutex>(lock);
+    } else {
+        mSharedLock = std::shared_lock<std::shared_mutex>(lock);
+    }
+    sHoldsLocks = true;
+}
+
+InstalldNativeService::ScopedLock::ScopedLock(std::shared_mutex& lock,
+        std::shared_ptr<std::shared_mutex> userLock, bool userExclusive,
+        std::shared_ptr<std::mutex> packageLock)
+        : ScopedLock(lock, false /* exclusive */) {
+    if (!mOutermost) {
+        return;
+    }
+    // Always user then package, so that calls on the same user and package cannot deadlock.
+    mUserMutex = std::move(userLock);
+    if (mUserMutex != nullptr && userExclusive) {
+        mUserExclusiveLock = std::unique_lock<std::shared_mutex>(*mUserMutex);
+    } else if (mUserMutex != nullptr) {
+        mUserSharedLock = std::shared_lock<std::shared_mutex>(*mUserMutex);
+    }
+    mPackageMutex = std::move(packageLock);
+    if (mPackageMutex != nullptr) {
+        mPackageLock = std::unique_lock<std::mutex>(*mPackageMutex);
+    }
+}
+
+InstalldNativeService::ScopedLock::~ScopedLock() {
+    if (mOutermost) {
+        sHoldsLocks = false;
+    }
+}
+
+InstalldNativeService::ScopedLock InstalldNativeService::lockAll() {
+    return ScopedLock(mLock, true /* exclusive */);
+}
+
+InstalldNativeService::ScopedLock InstalldNativeService::lockUser(int32_t userId) {
+    std::shared_ptr<std::shared_mutex> userLock;
+    {
+        std::lock_guard<std::mutex> lock(mLocksLock);
+        userLock = findLock(mUserLocks, userId);
+    }
+    return ScopedLock(mLock, std::move(userLock), true /* userExclusive */, nullptr);
+}
+
+// Calls on a package that are not tied to a user, like the profile operations, cover the package
+// in every user. They only exclude the calls on the same package.
+InstalldNativeService::ScopedLock InstalldNativeService::lockPackage(
+        const std::string& packageName) {
+    std::shared_ptr<std::mutex> packageLock;
+    {
+        std::lock_guard<std::mutex> lock(mLocksLock);
+        packageLock = findLock(mPackageLocks, packageName);
+    }
+    return ScopedLock(mLock, nullptr, false /* userExclusive */, std::move(packageLock));
+}
+
+InstalldNativeService::ScopedLock InstalldNativeService::lockPackageUser(
+        const std::string& packageName, int32_t userId) {
+    std::shared_ptr<std::shared_mutex> userLock;
+    std::shared_ptr<std::mutex> packageLock;
+    {
+        std::lock_guard<std::mutex> lock(mLocksLock);
+        userLock = findLock(mUserLocks, userId);
+        packageLock = findLock(mPackageLocks, packageName);
+    }
+    return ScopedLock(mLock, std::move(userLock), false /* userExclusive */,
+            std::move(packageLock));
+}
+
 status_t InstalldNativeService::start() {
     IPCThreadState::self()->disableBackgroundScheduling(true);
     status_t ret = BinderService<InstalldNativeService>::publish();
@@ -287,7 +409,7 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         out << dump_permission.toString8() << endl;
         return PERMISSION_DENIED;
     }
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     out << "installd is happy!" << endl;
 
@@ -313,6 +435,64 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
     return NO_ERROR;
 }
 
+/**
+ * Remembers the label that restorecon left on app data directories, keyed by
+ * path, for the seInfo and uid it was computed for. A directory that still
+ * carries that label would not be touched by restorecon, so the seapp_contexts
+ * and file_contexts lookups can be skipped when app data is prepared again.
+ * The least recently used entries are dropped beyond kMaxEntries.
+ */
+class RestoreconCache {
+public:
+    bool isLabeled(const std::string& path, const std::string& seInfo, uid_t uid,
+            const char* context) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mEntries.find(path);
+        if (it == mEntries.end()) {
+            return false;
+        }
+        const Entry& entry = *it->second;
+        if (entry.uid != uid || entry.seInfo != seInfo || entry.context != context) {
+            return false;
+        }
+        mLru.splice(mLru.begin(), mLru, it->second);
+        return true;
+    }
+
+    void put(const std::string& path, const std::string& seInfo, uid_t uid,
+            const char* context) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mEntries.find(path);
+        if (it != mEntries.end()) {
+            mLru.erase(it->second);
+            mEntries.erase(it);
+        } else if (mEntries.size() >= kMaxEntries) {
+            mEntries.erase(mLru.back().path);
+            mLru.pop_back();
+        }
+        mLru.push_front(Entry{path, seInfo, uid, context});
+        mEntries[path] = mLru.begin();
+    }
+
+private:
+    struct Entry {
+        std::string path;
+        std::string seInfo;
+        uid_t uid;
+        std::string context;
+    };
+
+    // Enough for the CE, DE, cache and code_cache directories of a few
+    // hundred packages.
+    static constexpr const size_t kMaxEntries = 2048;
+
+    std::mutex mLock;
+    std::list<Entry> mLru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mEntries;
+};
+
+static RestoreconCache sRestoreconCache;
+
 /**
  * Perform restorecon of the given path, but only perform recursive restorecon
  * if the label of that top-level file actually changed.  This can save us
@@ -331,6 +511,9 @@ static int restorecon_app_data_lazy(const std::string& path, const std::string&
         PLOG(ERROR) << "Failed before getfilecon for " << path;
         goto fail;
     }
+    if (sRestoreconCache.isLabeled(path, seInfo, uid, before)) {
+        goto done;
+    }
     if (selinux_android_restorecon_pkgdir(path.c_str(), seInfo.c_str(), uid, 0) < 0) {
         PLOG(ERROR) << "Failed top-level restorecon for " << path;
         goto fail;
@@ -353,6 +536,7 @@ static int restorecon_app_data_lazy(const std::string& path, const std::string&
             goto fail;
         }
     }
+    sRestoreconCache.put(path, seInfo, uid, after);
 
     goto done;
 fail:
@@ -427,22 +611,31 @@ binder::Status InstalldNativeService::createAppDataBatched(
         const std::vector<std::string>& seInfos, const std::vector<int32_t>& targetSdkVersions,
         int64_t* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
 
+    // The packages are independent and createAppData locks each of them, so they are prepared
+    // in parallel. The worker threads pass ENFORCE_UID since they run as installd itself.
     ATRACE_BEGIN("createAppDataBatched");
-    binder::Status ret;
-    for (size_t i = 0; i < uuids->size(); i++) {
+    const size_t count = uuids->size();
+    std::vector<binder::Status> results(count);
+    std::vector<int64_t> ceDataInodes(count, -1);
+    forEachInParallel(count, kMaxWorkerThreads, [&](size_t i) {
         if (!packageNames->at(i)) {
-            continue;
+            return true;
         }
-        ret = createAppData(uuids->at(i), *packageNames->at(i), userId, flags, appIds[i],
-                seInfos[i], targetSdkVersions[i], _aidl_return);
-        if (!ret.isOk()) {
-            ATRACE_END();
-            return ret;
+        results[i] = createAppData(uuids->at(i), *packageNames->at(i), userId, flags, appIds[i],
+                seInfos[i], targetSdkVersions[i], &ceDataInodes[i]);
+        return results[i].isOk();
+    });
+    ATRACE_END();
+
+    for (size_t i = 0; i < count; i++) {
+        if (!results[i].isOk()) {
+            return results[i];
+        }
+        if (packageNames->at(i) && _aidl_return != nullptr) {
+            *_aidl_return = ceDataInodes[i];
         }
     }
-    ATRACE_END();
     return ok();
 }
 
@@ -452,7 +645,7 @@ binder::Status InstalldNativeService::createAppData(const std::unique_ptr<std::s
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -532,7 +725,7 @@ binder::Status InstalldNativeService::migrateAppData(const std::unique_ptr<std::
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -576,7 +769,7 @@ binder::Status InstalldNativeService::clearAppProfiles(const std::string& packag
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     binder::Status res = ok();
     if (!clear_primary_reference_profile(packageName, profileName)) {
@@ -593,7 +786,7 @@ binder::Status InstalldNativeService::clearAppData(const std::unique_ptr<std::st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -693,7 +886,7 @@ static int destroy_app_current_profiles(const std::string& pkgname, userid_t use
 binder::Status InstalldNativeService::destroyAppProfiles(const std::string& packageName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     binder::Status res = ok();
     std::vector<userid_t> users = get_known_users(/*volume_uuid*/ nullptr);
@@ -713,7 +906,7 @@ binder::Status InstalldNativeService::destroyAppData(const std::unique_ptr<std::
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -784,7 +977,7 @@ binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::st
         int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     for (auto user : get_known_users(uuid_)) {
@@ -883,22 +1076,6 @@ binder::Status InstalldNativeService::fixupAppData(const std::unique_ptr<std::st
     return ok();
 }
 
-static int32_t copy_directory_recursive(const char* from, const char* to) {
-    char *argv[] = {
-        (char*) kCpPath,
-        (char*) "-F", /* delete any existing destination file first (--remove-destination) */
-        (char*) "-p", /* preserve timestamps, ownership, and permissions */
-        (char*) "-R", /* recurse into subdirectories (DEST must be a directory) */
-        (char*) "-P", /* Do not follow symlinks [default] */
-        (char*) "-d", /* don't dereference symlinks */
-        (char*) from,
-        (char*) to
-    };
-
-    LOG(DEBUG) << "Copying " << from << " to " << to;
-    return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
-}
-
 binder::Status InstalldNativeService::snapshotAppData(
         const std::unique_ptr<std::string>& volumeUuid,
         const std::string& packageName, int32_t user, int32_t snapshotId,
@@ -906,7 +1083,7 @@ binder::Status InstalldNativeService::snapshotAppData(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1033,7 +1210,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1105,7 +1282,7 @@ binder::Status InstalldNativeService::destroyAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1136,7 +1313,7 @@ binder::Status InstalldNativeService::destroyCeSnapshotsNotSpecified(
         const std::vector<int32_t>& retainSnapshotIds) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockUser(userId);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
 
@@ -1177,7 +1354,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
     CHECK_ARGUMENT_UUID(fromUuid);
     CHECK_ARGUMENT_UUID(toUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* from_uuid = fromUuid ? fromUuid->c_str() : nullptr;
     const char* to_uuid = toUuid ? toUuid->c_str() : nullptr;
@@ -1281,7 +1458,7 @@ binder::Status InstalldNativeService::createUserData(const std::unique_ptr<std::
         int32_t userId, int32_t userSerial ATTRIBUTE_UNUSED, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockUser(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     if (flags & FLAG_STORAGE_DE) {
@@ -1299,7 +1476,7 @@ binder::Status InstalldNativeService::destroyUserData(const std::unique_ptr<std:
         int32_t userId, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockUser(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     binder::Status res = ok();
@@ -1332,11 +1509,27 @@ binder::Status InstalldNativeService::destroyUserData(const std::unique_ptr<std:
     return res;
 }
 
+// Without quotas, the cache usage of every app is measured by walking its cache directories.
+// The walks only read the file system and are independent, so they are spread over a few threads.
+static void loadTrackerStats(
+        const std::unordered_map<uid_t, std::shared_ptr<CacheTracker>>& trackers,
+        bool quotaSupported) {
+    std::vector<std::shared_ptr<CacheTracker>> pending;
+    pending.reserve(trackers.size());
+    for (const auto& it : trackers) {
+        pending.push_back(it.second);
+    }
+    forEachInParallel(pending.size(), quotaSupported ? 1 : kMaxWorkerThreads, [&](size_t i) {
+        pending[i]->loadStats();
+        return true;
+    });
+}
+
 binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::string>& uuid,
         int64_t targetFreeBytes, int64_t cacheReservedBytes, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     auto uuidString = uuid ? *uuid : "";
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
@@ -1416,8 +1609,8 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         };
         std::priority_queue<std::shared_ptr<CacheTracker>,
                 std::vector<std::shared_ptr<CacheTracker>>, decltype(cmp)> queue(cmp);
+        loadTrackerStats(trackers, IsQuotaSupported(uuidString));
         for (const auto& it : trackers) {
-            it.second->loadStats();
             queue.push(it.second);
             cacheTotal += it.second->cacheUsed;
         }
@@ -1505,7 +1698,7 @@ binder::Status InstalldNativeService::rmdex(const std::string& codePath,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     char dex_path[PKG_PATH_MAX];
 
@@ -2011,6 +2204,11 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
             ATRACE_END();
         }
 
+        // Every app of the user is measured below, so read all quotas at once
+        ATRACE_BEGIN("snapshot");
+        ScopedQuotaSnapshot quotaSnapshot(uuidString);
+        ATRACE_END();
+
         ATRACE_BEGIN("external");
         auto sizes = getExternalSizesForUserWithQuota(uuidString, userId, appIds);
         extStats.dataSize += sizes.totalSize;
@@ -2125,6 +2323,10 @@ binder::Status InstalldNativeService::getExternalSize(const std::unique_ptr<std:
     }
 
     if (flags & FLAG_USE_QUOTA) {
+        ATRACE_BEGIN("snapshot");
+        ScopedQuotaSnapshot quotaSnapshot(uuidString);
+        ATRACE_END();
+
         ATRACE_BEGIN("quota");
         auto sizes = getExternalSizesForUserWithQuota(uuidString, userId, appIds);
         totalSize = sizes.totalSize;
@@ -2221,7 +2423,7 @@ binder::Status InstalldNativeService::getAppCrates(
         CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     }
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockUser(userId);
 
     auto retVector = std::make_unique<std::vector<std::unique_ptr<CrateMetadata>>>();
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
@@ -2267,7 +2469,7 @@ binder::Status InstalldNativeService::getUserCrates(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockUser(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     auto retVector = std::make_unique<std::vector<std::unique_ptr<CrateMetadata>>>();
@@ -2324,7 +2526,7 @@ binder::Status InstalldNativeService::dumpProfiles(int32_t uid, const std::strin
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     *_aidl_return = dump_profiles(uid, packageName, profileName, codePath);
     return ok();
@@ -2336,7 +2538,7 @@ binder::Status InstalldNativeService::copySystemProfile(const std::string& syste
         bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
     *_aidl_return = copy_system_profile(systemProfile, packageUid, packageName, profileName);
     return ok();
 }
@@ -2346,7 +2548,7 @@ binder::Status InstalldNativeService::mergeProfiles(int32_t uid, const std::stri
         const std::string& profileName, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     *_aidl_return = analyze_primary_profiles(uid, packageName, profileName);
     return ok();
@@ -2357,7 +2559,7 @@ binder::Status InstalldNativeService::createProfileSnapshot(int32_t appId,
         const std::string& classpath, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     *_aidl_return = create_profile_snapshot(appId, packageName, profileName, classpath);
     return ok();
@@ -2367,7 +2569,7 @@ binder::Status InstalldNativeService::destroyProfileSnapshot(const std::string&
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     std::string snapshot = create_snapshot_profile_path(packageName, profileName);
     if ((unlink(snapshot.c_str()) != 0) && (errno != ENOENT)) {
@@ -2397,7 +2599,7 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = packageName && *packageName != "*" ? lockPackage(*packageName) : lockAll();
 
     const char* oat_dir = getCStr(outputPath);
     const char* instruction_set = instructionSet.c_str();
@@ -2440,7 +2642,7 @@ binder::Status InstalldNativeService::linkNativeLibraryDirectory(
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(nativeLibPath32);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -2531,7 +2733,7 @@ binder::Status InstalldNativeService::restoreconAppData(const std::unique_ptr<st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     binder::Status res = ok();
 
@@ -2561,7 +2763,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(oatDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* oat_dir = oatDir.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2586,7 +2788,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
 binder::Status InstalldNativeService::rmPackageDir(const std::string& packageDir) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(packageDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     if (validate_apk_path(packageDir.c_str())) {
         return error("Invalid path " + packageDir);
@@ -2602,7 +2804,7 @@ binder::Status InstalldNativeService::linkFile(const std::string& relativePath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(fromBase);
     CHECK_ARGUMENT_PATH(toBase);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* relative_path = relativePath.c_str();
     const char* from_base = fromBase.c_str();
@@ -2632,7 +2834,7 @@ binder::Status InstalldNativeService::moveAb(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2647,7 +2849,7 @@ binder::Status InstalldNativeService::deleteOdex(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2680,7 +2882,7 @@ binder::Status InstalldNativeService::installApkVerity(const std::string& filePa
         android::base::unique_fd verityInputAshmem, int32_t contentSize) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2762,7 +2964,7 @@ binder::Status InstalldNativeService::assertFsverityRootHashMatches(const std::s
         const std::vector<uint8_t>& expectedHash) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2801,7 +3003,7 @@ binder::Status InstalldNativeService::reconcileSecondaryDexFile(
     CHECK_ARGUMENT_UUID(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(dexPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackage(packageName);
 
     bool result = android::installd::reconcile_secondary_dex_file(
             dexPath, packageName, uid, isas, volumeUuid, storage_flag, _aidl_return);
@@ -2882,7 +3084,7 @@ binder::Status InstalldNativeService::tryMountDataMirror(
     const char* uuid_ = uuid->c_str();
 
     std::string mirrorVolCePath(StringPrintf("%s/%s", kDataMirrorCePath, uuid_));
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
     if (fs_prepare_dir(mirrorVolCePath.c_str(), 0711, AID_SYSTEM, AID_SYSTEM) != 0) {
         return error("Failed to create CE mirror");
     }
@@ -2952,7 +3154,7 @@ binder::Status InstalldNativeService::onPrivateVolumeRemoved(
     std::string mirrorDeVolPath(StringPrintf("%s/%s", kDataMirrorDePath, uuid_));
 
     // Unmount CE storage
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockAll();
     if (TEMP_FAILURE_RETRY(umount(mirrorCeVolPath.c_str())) != 0) {
         if (errno != ENOENT) {
             res = error(StringPrintf("Failed to umount %s %s", mirrorCeVolPath.c_str(),
@@ -3002,7 +3204,7 @@ binder::Status InstalldNativeService::prepareAppProfile(const std::string& packa
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    auto lock = lockPackageUser(packageName, userId);
 
     *_aidl_return = prepare_app_profile(packageName, userId, appId, profileName, codePath,
         dexMetadata);
@@ -21,6 +21,9 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -173,7 +176,46 @@ public:
     binder::Status migrateLegacyObbData();
 
 private:
-    std::recursive_mutex mLock;
+    /**
+     * The locks held for the duration of one binder call. Calls on a single package or user hold
+     * mLock shared, so that calls on unrelated packages run in parallel on the binder pool, and
+     * hold the lock of that user and package. Calls that walk every package of a volume, or that
+     * are not tied to a package, hold mLock exclusively.
+     *
+     * Binder calls also call each other. The nested call runs under the locks taken by the
+     * outermost one, which always covers it.
+     */
+    class ScopedLock {
+    public:
+        ScopedLock(std::shared_mutex& lock, bool exclusive);
+        ScopedLock(std::shared_mutex& lock, std::shared_ptr<std::shared_mutex> userLock,
+                bool userExclusive, std::shared_ptr<std::mutex> packageLock);
+        ~ScopedLock();
+
+    private:
+        const bool mOutermost;
+        std::unique_lock<std::shared_mutex> mExclusiveLock;
+        std::shared_lock<std::shared_mutex> mSharedLock;
+        std::shared_ptr<std::shared_mutex> mUserMutex;
+        std::unique_lock<std::shared_mutex> mUserExclusiveLock;
+        std::shared_lock<std::shared_mutex> mUserSharedLock;
+        std::shared_ptr<std::mutex> mPackageMutex;
+        std::unique_lock<std::mutex> mPackageLock;
+
+        DISALLOW_COPY_AND_ASSIGN(ScopedLock);
+    };
+
+    ScopedLock lockAll();
+    ScopedLock lockUser(int32_t userId);
+    ScopedLock lockPackage(const std::string& packageName);
+    ScopedLock lockPackageUser(const std::string& packageName, int32_t userId);
+
+    std::shared_mutex mLock;
+
+    /* Locks of the users and packages that binder calls are working on, guarded by mLocksLock */
+    std::mutex mLocksLock;
+    std::unordered_map<int32_t, std::weak_ptr<std::shared_mutex>> mUserLocks;
+    std::unordered_map<std::string, std::weak_ptr<std::mutex>> mPackageLocks;
 
     std::recursive_mutex mMountsLock;
     std::recursive_mutex mQuotasLock;
@@ -43,6 +43,71 @@ std::string& FindQuotaDeviceForUuid(const std::string& uuid) {
 
 } // namespace
 
+struct QuotaSnapshot {
+    std::string device;
+    /* Occupied space by id for each quota type, if that type could be swept */
+    std::unique_ptr<std::unordered_map<uint32_t, int64_t>> usage[MAXQUOTAS];
+};
+
+namespace {
+
+/* Snapshot installed by the innermost ScopedQuotaSnapshot on this thread */
+thread_local QuotaSnapshot* sQuotaSnapshot = nullptr;
+
+std::unique_ptr<std::unordered_map<uint32_t, int64_t>> SweepQuota(const std::string& device,
+        int type) {
+    auto usage = std::make_unique<std::unordered_map<uint32_t, int64_t>>();
+    struct if_nextdqblk dq;
+    uint32_t id = 0;
+    while (quotactl(QCMD(Q_GETNEXTQUOTA, type), device.c_str(), id,
+            reinterpret_cast<char*>(&dq)) == 0) {
+        (*usage)[dq.dqb_id] = dq.dqb_curspace;
+        if (dq.dqb_id == UINT32_MAX) {
+            return usage;
+        }
+        id = dq.dqb_id + 1;
+    }
+    if (errno != ESRCH) {
+        // Older kernels don't support Q_GETNEXTQUOTA; fall back to one query per id
+        PLOG(DEBUG) << "Failed to sweep quota type " << type << " on " << device;
+        return nullptr;
+    }
+    return usage;
+}
+
+/*
+ * Looks up the occupied space of the given id in the snapshot of this thread. Returns false when
+ * there is no snapshot of that device and quota type.
+ */
+bool FindSnapshotSpace(const std::string& device, int type, uint32_t id, int64_t* space) {
+    if (sQuotaSnapshot == nullptr || sQuotaSnapshot->device != device
+            || sQuotaSnapshot->usage[type] == nullptr) {
+        return false;
+    }
+    const auto& usage = *sQuotaSnapshot->usage[type];
+    auto it = usage.find(id);
+    // Ids without a quota entry don't occupy any space
+    *space = it == usage.end() ? 0 : it->second;
+    return true;
+}
+
+} // namespace
+
+ScopedQuotaSnapshot::ScopedQuotaSnapshot(const std::string& uuid)
+        : mSnapshot(std::make_unique<QuotaSnapshot>()), mPrevious(sQuotaSnapshot) {
+    mSnapshot->device = FindQuotaDeviceForUuid(uuid);
+    if (!mSnapshot->device.empty()) {
+        for (int type : {USRQUOTA, GRPQUOTA, PRJQUOTA}) {
+            mSnapshot->usage[type] = SweepQuota(mSnapshot->device, type);
+        }
+    }
+    sQuotaSnapshot = mSnapshot.get();
+}
+
+ScopedQuotaSnapshot::~ScopedQuotaSnapshot() {
+    sQuotaSnapshot = mPrevious;
+}
+
 bool InvalidateQuotaMounts() {
     std::lock_guard<std::recursive_mutex> lock(mMountsLock);
 
@@ -86,6 +151,10 @@ int64_t GetOccupiedSpaceForUid(const std::string& uuid, uid_t uid) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindSnapshotSpace(device, USRQUOTA, uid, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, USRQUOTA), device.c_str(), uid,
             reinterpret_cast<char*>(&dq)) != 0) {
@@ -106,6 +175,10 @@ int64_t GetOccupiedSpaceForProjectId(const std::string& uuid, int projectId) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindSnapshotSpace(device, PRJQUOTA, projectId, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, PRJQUOTA), device.c_str(), projectId,
             reinterpret_cast<char*>(&dq)) != 0) {
@@ -126,6 +199,10 @@ int64_t GetOccupiedSpaceForGid(const std::string& uuid, gid_t gid) {
     if (device == "") {
         return -1;
     }
+    int64_t space;
+    if (FindSnapshotSpace(device, GRPQUOTA, gid, &space)) {
+        return space;
+    }
     struct dqblk dq;
     if (quotactl(QCMD(Q_GETQUOTA, GRPQUOTA), device.c_str(), gid,
             reinterpret_cast<char*>(&dq)) != 0) {
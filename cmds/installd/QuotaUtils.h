@@ -37,6 +37,27 @@ int64_t GetOccupiedSpaceForGid(const std::string& uuid, gid_t gid);
 
 /* Get the current occupied space in bytes for a project id or -1 if fails */
 int64_t GetOccupiedSpaceForProjectId(const std::string& uuid, int projectId);
+
+struct QuotaSnapshot;
+
+/*
+ * Reads the occupied space of every uid, gid and project id on the device with the given uuid,
+ * with one Q_GETNEXTQUOTA sweep per quota type. Until it is destroyed, the GetOccupiedSpaceFor*
+ * calls made on the same thread for that device are answered from the snapshot instead of one
+ * quotactl each. Quota types that cannot be swept are still queried directly.
+ */
+class ScopedQuotaSnapshot {
+  public:
+    explicit ScopedQuotaSnapshot(const std::string& uuid);
+    ~ScopedQuotaSnapshot();
+
+    ScopedQuotaSnapshot(const ScopedQuotaSnapshot&) = delete;
+    ScopedQuotaSnapshot& operator=(const ScopedQuotaSnapshot&) = delete;
+
+  private:
+    std::unique_ptr<QuotaSnapshot> mSnapshot;
+    QuotaSnapshot* mPrevious;
+};
 }  // namespace installd
 }  // namespace android
 
@@ -15,12 +15,14 @@
  */
 #define LOG_TAG "installd"
 
+#include <algorithm>
 #include <array>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/capability.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -28,10 +30,17 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/macros.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
@@ -57,8 +66,10 @@
 
 using android::base::EndsWith;
 using android::base::GetBoolProperty;
+using android::base::GetIntProperty;
 using android::base::GetProperty;
 using android::base::ReadFdToString;
+using android::base::ReadFileToString;
 using android::base::ReadFully;
 using android::base::StringPrintf;
 using android::base::WriteFully;
@@ -665,6 +676,72 @@ static void SetDex2OatScheduling(bool set_to_bg) {
     }
 }
 
+// Returns MemAvailable from /proc/meminfo in bytes, or 0 if it cannot be read.
+static uint64_t get_available_memory() {
+    std::string meminfo;
+    if (!ReadFileToString("/proc/meminfo", &meminfo)) {
+        return 0;
+    }
+    const std::string key = "MemAvailable:";
+    size_t pos = meminfo.find(key);
+    if (pos == std::string::npos) {
+        return 0;
+    }
+    return strtoull(meminfo.c_str() + pos + key.size(), nullptr, 10) * 1024;
+}
+
+// Bounds the number of dex2oat processes that run at the same time. dexopt calls for different
+// packages run in parallel on the binder pool, and at most dalvik.vm.dex2oat-max-concurrent of
+// them compile at once (one by default, as before). A dex2oat is only started next to others
+// while the available memory covers its heap limit, so that compiling many apps after an OTA
+// does not push the device into low memory kills.
+class ScopedDex2oatSlot {
+  public:
+    ScopedDex2oatSlot() {
+        std::unique_lock<std::mutex> lock(slots_lock_);
+        while (!CanStartLocked()) {
+            // Memory is polled, since it is not only freed by the dex2oat processes we run.
+            slots_changed_.wait_for(lock, std::chrono::seconds(1));
+        }
+        running_++;
+    }
+
+    ~ScopedDex2oatSlot() {
+        {
+            std::lock_guard<std::mutex> lock(slots_lock_);
+            running_--;
+        }
+        slots_changed_.notify_one();
+    }
+
+  private:
+    static bool CanStartLocked() {
+        if (running_ == 0) {
+            return true;
+        }
+        const int max_concurrent = GetIntProperty("dalvik.vm.dex2oat-max-concurrent", 1);
+        if (running_ >= max_concurrent) {
+            return false;
+        }
+        uint64_t heap_limit = 0;
+        const std::string xmx = GetProperty("dalvik.vm.dex2oat-Xmx", "");
+        if (xmx.empty() || !android::base::ParseByteCount(xmx.c_str(), &heap_limit)) {
+            return true;
+        }
+        return get_available_memory() >= heap_limit;
+    }
+
+    static std::mutex slots_lock_;
+    static std::condition_variable slots_changed_;
+    static int running_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedDex2oatSlot);
+};
+
+std::mutex ScopedDex2oatSlot::slots_lock_;
+std::condition_variable ScopedDex2oatSlot::slots_changed_;
+int ScopedDex2oatSlot::running_ = 0;
+
 static unique_fd create_profile(uid_t uid, const std::string& profile, int32_t flags) {
     unique_fd fd(TEMP_FAILURE_RETRY(open(profile.c_str(), flags, 0600)));
     if (fd.get() < 0) {
@@ -886,6 +963,11 @@ class RunProfman : public ExecVHelper {
 // worth to recompile the given location.
 // If the return value is true all the current profiles would have been merged into
 // the reference profiles accessible with open_reference_profile().
+static bool is_empty_file(const unique_fd& fd) {
+    struct stat st;
+    return fstat(fd.get(), &st) == 0 && st.st_size == 0;
+}
+
 static bool analyze_profiles(uid_t uid, const std::string& package_name,
         const std::string& location, bool is_secondary_dex) {
     std::vector<unique_fd> profiles_fd;
@@ -897,6 +979,11 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         // Or if the reference profile info couldn't be opened.
         return false;
     }
+    if (std::all_of(profiles_fd.begin(), profiles_fd.end(), is_empty_file)) {
+        // Nothing was recorded since the last merge, which is the case for most packages in a
+        // background dexopt pass. profman would only report that there is nothing to compile.
+        return false;
+    }
 
     RunProfman profman_merge;
     const std::vector<unique_fd>& apk_fds = std::vector<unique_fd>();
@@ -2245,6 +2332,7 @@ int dexopt(const char* dex_path, uid_t uid, const char* pkgname, const char* ins
                       dex_metadata_fd.get(),
                       compilation_reason);
 
+    ScopedDex2oatSlot dex2oat_slot;
     pid_t pid = fork();
     if (pid == 0) {
         /* child -- drop privileges before continuing */
@@ -2440,6 +2528,63 @@ bool reconcile_secondary_dex_file(const std::string& dex_path,
     }
 }
 
+// Identifies the contents of a secondary dex file by what fstat reports about it. The ctime
+// cannot be set from user space and changes on every write, so a file that was modified no longer
+// matches its previous id.
+struct SecondaryDexFileId {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    timespec mtime;
+    timespec ctime;
+
+    bool operator<(const SecondaryDexFileId& other) const {
+        return std::tie(dev, ino, size, mtime.tv_sec, mtime.tv_nsec, ctime.tv_sec, ctime.tv_nsec)
+                < std::tie(other.dev, other.ino, other.size, other.mtime.tv_sec,
+                        other.mtime.tv_nsec, other.ctime.tv_sec, other.ctime.tv_nsec);
+    }
+};
+
+using SecondaryDexHash = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+// Hashes of the secondary dex files hashed recently, so that asking again for an unchanged file
+// does not read it again. The map is cleared once it holds kMaxSecondaryDexHashes entries.
+static constexpr size_t kMaxSecondaryDexHashes = 256;
+static std::mutex secondary_dex_hashes_lock;
+static std::map<SecondaryDexFileId, SecondaryDexHash> secondary_dex_hashes;
+
+// Computes the SHA-256 of the size bytes of the file open at fd. The file is mapped and hashed in
+// place when possible, and read through a buffer otherwise.
+static bool hash_file_contents(int fd, off_t size, SecondaryDexHash* hash) {
+    if (size > 0) {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, size, MADV_SEQUENTIAL);
+            SHA256(static_cast<const uint8_t*>(data), size, hash->data());
+            munmap(data, size);
+            return true;
+        }
+    }
+
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+
+    std::vector<uint8_t> buffer(65536);
+    while (true) {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        if (bytes_read == 0) {
+            break;
+        } else if (bytes_read == -1) {
+            return false;
+        }
+
+        SHA256_Update(&ctx, buffer.data(), bytes_read);
+    }
+
+    SHA256_Final(hash->data(), &ctx);
+    return true;
+}
+
 // Compute and return the hash (SHA-256) of the secondary dex file at dex_path.
 // Returns true if all parameters are valid and the hash successfully computed and stored in
 // out_secondary_dex_hash.
@@ -2467,7 +2612,9 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     }
 
     // Fork so that actual access to the files is done in the app's own UID, to ensure we only
-    // access data the app itself can access.
+    // access data the app itself can access. The hash cache stays locked across the fork, so that
+    // the child gets a consistent copy of it which it can read without locking.
+    std::unique_lock<std::mutex> hashes_lock(secondary_dex_hashes_lock);
     pid_t pid = fork();
     if (pid == 0) {
         // child -- drop privileges before continuing
@@ -2489,25 +2636,29 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
             _exit(DexoptReturnCodes::kHashOpenPath);
         }
 
-        SHA256_CTX ctx;
-        SHA256_Init(&ctx);
-
-        std::vector<uint8_t> buffer(65536);
-        while (true) {
-            ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
-            if (bytes_read == 0) {
-                break;
-            } else if (bytes_read == -1) {
-                PLOG(ERROR) << "Failed to read secondary dex " << dex_path;
-                _exit(DexoptReturnCodes::kHashReadDex);
-            }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            PLOG(ERROR) << "Failed to stat secondary dex " << dex_path;
+            _exit(DexoptReturnCodes::kHashReadDex);
+        }
+        SecondaryDexFileId id = {};
+        id.dev = st.st_dev;
+        id.ino = st.st_ino;
+        id.size = st.st_size;
+        id.mtime = st.st_mtim;
+        id.ctime = st.st_ctim;
 
-            SHA256_Update(&ctx, buffer.data(), bytes_read);
+        SecondaryDexHash hash;
+        auto cached = secondary_dex_hashes.find(id);
+        if (cached != secondary_dex_hashes.end()) {
+            hash = cached->second;
+        } else if (!hash_file_contents(fd, st.st_size, &hash)) {
+            PLOG(ERROR) << "Failed to read secondary dex " << dex_path;
+            _exit(DexoptReturnCodes::kHashReadDex);
         }
 
-        std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
-        SHA256_Final(hash.data(), &ctx);
-        if (!WriteFully(pipe_write, hash.data(), hash.size())) {
+        if (!WriteFully(pipe_write, hash.data(), hash.size())
+                || !WriteFully(pipe_write, &id, sizeof(id))) {
             _exit(DexoptReturnCodes::kHashWrite);
         }
 
@@ -2515,13 +2666,28 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     }
 
     // parent
+    hashes_lock.unlock();
     pipe_write.reset();
 
-    out_secondary_dex_hash->resize(SHA256_DIGEST_LENGTH);
-    if (!ReadFully(pipe_read, out_secondary_dex_hash->data(), out_secondary_dex_hash->size())) {
-        out_secondary_dex_hash->clear();
+    SecondaryDexHash hash;
+    SecondaryDexFileId id;
+    bool hashed = ReadFully(pipe_read, hash.data(), hash.size());
+    bool identified = hashed && ReadFully(pipe_read, &id, sizeof(id));
+    if (wait_child(pid) != 0) {
+        return false;
+    }
+
+    if (hashed) {
+        out_secondary_dex_hash->assign(hash.begin(), hash.end());
     }
-    return wait_child(pid) == 0;
+    if (identified) {
+        std::lock_guard<std::mutex> lock(secondary_dex_hashes_lock);
+        if (secondary_dex_hashes.size() >= kMaxSecondaryDexHashes) {
+            secondary_dex_hashes.clear();
+        }
+        secondary_dex_hashes[id] = hash;
+    }
+    return true;
 }
 
 // Helper for move_ab, so that we can have common failure-case cleanup.
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -598,6 +599,28 @@ TEST_F(DexoptTest, DexoptSecondaryDeWithContext) {
         /*binder_ok*/ true, /*compile_ok*/ true, nullptr, -1, class_loader_context.c_str());
 }
 
+TEST_F(DexoptTest, HashSecondaryDex) {
+    LOG(INFO) << "HashSecondaryDex";
+    std::vector<uint8_t> hash;
+    ASSERT_BINDER_SUCCESS(service_->hashSecondaryDexFile(secondary_dex_ce_, package_name_,
+            kTestAppUid, volume_uuid_, FLAG_STORAGE_CE, &hash));
+    ASSERT_EQ(32u, hash.size());
+
+    // An unchanged file hashes the same, whether or not it is read again.
+    std::vector<uint8_t> same_hash;
+    ASSERT_BINDER_SUCCESS(service_->hashSecondaryDexFile(secondary_dex_ce_, package_name_,
+            kTestAppUid, volume_uuid_, FLAG_STORAGE_CE, &same_hash));
+    ASSERT_EQ(hash, same_hash);
+
+    // A modified file is hashed again.
+    run_cmd("echo >> " + secondary_dex_ce_);
+    std::vector<uint8_t> new_hash;
+    ASSERT_BINDER_SUCCESS(service_->hashSecondaryDexFile(secondary_dex_ce_, package_name_,
+            kTestAppUid, volume_uuid_, FLAG_STORAGE_CE, &new_hash));
+    ASSERT_EQ(32u, new_hash.size());
+    ASSERT_NE(hash, new_hash);
+}
+
 TEST_F(DexoptTest, DexoptSecondaryDoesNotExist) {
     LOG(INFO) << "DexoptSecondaryDoesNotExist";
     // If the file validates but does not exist we do not treat it as an error.
@@ -1099,6 +1122,19 @@ TEST_F(ProfileTest, ProfileMergeOkNoReference) {
     mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ true);
 }
 
+// Nothing is merged, and nothing needs compiling, when no new profile data was recorded.
+TEST_F(ProfileTest, ProfileMergeSkipEmptyCurrentProfile) {
+    LOG(INFO) << "ProfileMergeSkipEmptyCurrentProfile";
+
+    SetupProfiles(/*setup_ref*/ true);
+    ASSERT_EQ(0, ::truncate(cur_profile_.c_str(), 0));
+    std::string ref_profile_before = ref_profile_ + ".before";
+    run_cmd("cp " + ref_profile_ + " " + ref_profile_before);
+
+    mergePackageProfiles(package_name_, "primary.prof", /*expected_result*/ false);
+    ASSERT_TRUE(AreFilesEqual(ref_profile_before, ref_profile_));
+}
+
 TEST_F(ProfileTest, ProfileMergeFailWrongPackage) {
     LOG(INFO) << "ProfileMergeFailWrongPackage";
 
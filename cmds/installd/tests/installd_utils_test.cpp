@@ -16,10 +16,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
+#include <private/android_filesystem_config.h>
 
 #include "InstalldNativeService.h"
 #include "MatchExtensionGen.h"
@@ -638,5 +642,83 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, CalculateTreeSize) {
+    const std::string root = "/data/local/tmp/calculate_tree_size";
+    std::vector<std::string> nodes = {root, root + "/file", root + "/link"};
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    auto deleter = [&root]() { delete_dir_contents_and_dir(root); };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    ASSERT_TRUE(android::base::WriteStringToFile(std::string(10000, 'a'), nodes[1]));
+    ASSERT_EQ(0, symlink("/data", nodes[2].c_str()));
+    // Deep enough to also measure the levels that are not walked through descriptors.
+    std::string dir = root;
+    for (int i = 0; i < 40; i++) {
+        dir += "/d";
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        nodes.push_back(dir);
+    }
+    ASSERT_TRUE(android::base::WriteStringToFile(std::string(5000, 'b'), dir + "/file"));
+    nodes.push_back(dir + "/file");
+
+    int64_t expected = 0;
+    for (const std::string& node : nodes) {
+        struct stat st;
+        ASSERT_EQ(0, lstat(node.c_str(), &st));
+        expected += st.st_blocks * 512;
+    }
+
+    int64_t size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size));
+    EXPECT_EQ(expected, size);
+
+    // Nothing matches a gid that owns none of the files.
+    size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size, AID_NOBODY));
+    EXPECT_EQ(0, size);
+
+    size = 0;
+    EXPECT_EQ(-1, calculate_tree_size(root + "/missing", &size));
+    EXPECT_EQ(0, size);
+}
+
+TEST_F(UtilsTest, CopyDirectoryRecursive) {
+    const std::string root = "/data/local/tmp/copy_directory_recursive";
+    const std::string from = root + "/from/package";
+    const std::string to = root + "/to";
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    auto deleter = [&root]() { delete_dir_contents_and_dir(root); };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    ASSERT_EQ(0, mkdir((root + "/from").c_str(), 0700));
+    ASSERT_EQ(0, mkdir(from.c_str(), 0751));
+    ASSERT_EQ(0, mkdir((from + "/dir").c_str(), 0700));
+    ASSERT_TRUE(android::base::WriteStringToFile("data", from + "/dir/file"));
+    ASSERT_EQ(0, chmod((from + "/dir/file").c_str(), 0640));
+    ASSERT_EQ(0, symlink("dir/file", (from + "/link").c_str()));
+    // Existing destination files are replaced.
+    ASSERT_EQ(0, mkdir(to.c_str(), 0700));
+    ASSERT_EQ(0, mkdir((to + "/package").c_str(), 0700));
+    ASSERT_TRUE(android::base::WriteStringToFile("old", to + "/package/link"));
+
+    ASSERT_EQ(0, copy_directory_recursive(from.c_str(), to.c_str()));
+
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(to + "/package/dir/file", &content));
+    EXPECT_EQ("data", content);
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink(to + "/package/link", &target));
+    EXPECT_EQ("dir/file", target);
+
+    struct stat from_st;
+    struct stat to_st;
+    ASSERT_EQ(0, stat(from.c_str(), &from_st));
+    ASSERT_EQ(0, stat((to + "/package").c_str(), &to_st));
+    EXPECT_EQ(0751, to_st.st_mode & ALLPERMS);
+    EXPECT_EQ(from_st.st_mtime, to_st.st_mtime);
+    ASSERT_EQ(0, stat((to + "/package/dir/file").c_str(), &to_st));
+    EXPECT_EQ(0640, to_st.st_mode & ALLPERMS);
+}
+
 }  // namespace installd
 }  // namespace android
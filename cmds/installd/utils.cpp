@@ -16,16 +16,24 @@
 
 #include "utils.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <fts.h>
+#include <limits.h>
+#include <linux/fs.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/capability.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
 
+#include <memory>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -55,6 +63,10 @@ using android::base::unique_fd;
 namespace android {
 namespace installd {
 
+// The sizes used by copy_directory_recursive when the kernel can't copy files by itself.
+static constexpr size_t kCopyChunkSize = 1u << 30;
+static constexpr size_t kCopyBufferSize = 256 * 1024;
+
 /**
  * Check that given string is valid filename, and that it attempts no
  * parent or child directory traversal.
@@ -376,7 +388,9 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
     return users;
 }
 
-int calculate_tree_size(const std::string& path, int64_t* size,
+// Measures path with fts. Only used below kMaxTreeSizeFdDepth, where keeping one descriptor open
+// per level would risk running out of them.
+static int calculate_tree_size_fts(const std::string& path, int64_t* size,
         int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
     FTS *fts;
     FTSENT *p;
@@ -417,6 +431,95 @@ int calculate_tree_size(const std::string& path, int64_t* size,
         }
     }
     fts_close(fts);
+    *size += matchedSize;
+    return 0;
+}
+
+// Directories deeper than this are measured with fts.
+static constexpr int kMaxTreeSizeFdDepth = 32;
+
+static bool is_app_owned(const struct stat& st) {
+    int32_t user_uid = multiuser_get_app_id(st.st_uid);
+    int32_t user_gid = multiuser_get_app_id(st.st_gid);
+    return (user_uid >= AID_APP_START && user_uid <= AID_APP_END)
+            || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
+            || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END);
+}
+
+static int64_t matched_node_size(const struct stat& st, int32_t include_gid,
+        int32_t exclude_gid) {
+    if (include_gid != -1 && static_cast<int32_t>(st.st_gid) != include_gid) {
+        return 0;
+    }
+    if (exclude_gid != -1 && static_cast<int32_t>(st.st_gid) == exclude_gid) {
+        return 0;
+    }
+    return st.st_blocks * 512;
+}
+
+// Adds the size of the children of the directory open as dir_fd, which is closed on return.
+// Children are stat-ed relative to their parent instead of through their full path.
+static void add_children_size(int dir_fd, const std::string& path, dev_t dev, int depth,
+        int32_t include_gid, int32_t exclude_gid, bool exclude_apps, int64_t* size) {
+    DIR* dir = fdopendir(dir_fd);
+    if (dir == nullptr) {
+        close(dir_fd);
+        return;
+    }
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr) {
+        const char* name = de->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (exclude_apps && is_app_owned(st)) {
+            // Don't traverse inside or measure
+            continue;
+        }
+        // Like fts with FTS_XDEV, measure mount points but don't cross them.
+        if (!S_ISDIR(st.st_mode) || st.st_dev != dev) {
+            *size += matched_node_size(st, include_gid, exclude_gid);
+            continue;
+        }
+        std::string child_path = path + "/" + name;
+        if (depth >= kMaxTreeSizeFdDepth) {
+            calculate_tree_size_fts(child_path, size, include_gid, exclude_gid, exclude_apps);
+            continue;
+        }
+        *size += matched_node_size(st, include_gid, exclude_gid);
+        int child_fd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (child_fd >= 0) {
+            add_children_size(child_fd, child_path, dev, depth + 1, include_gid, exclude_gid,
+                    exclude_apps, size);
+        }
+    }
+    closedir(dir);
+}
+
+int calculate_tree_size(const std::string& path, int64_t* size,
+        int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        if (errno != ENOENT) {
+            PLOG(ERROR) << "Failed to stat " << path;
+        }
+        return -1;
+    }
+    int64_t matchedSize = 0;
+    if (!exclude_apps || !is_app_owned(st)) {
+        matchedSize += matched_node_size(st, include_gid, exclude_gid);
+        if (S_ISDIR(st.st_mode)) {
+            int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd >= 0) {
+                add_children_size(fd, path, st.st_dev, 1, include_gid, exclude_gid,
+                        exclude_apps, &matchedSize);
+            }
+        }
+    }
 #if MEASURE_DEBUG
     if ((include_gid == -1) && (exclude_gid == -1)) {
         LOG(DEBUG) << "Measured " << path << " size " << matchedSize;
@@ -616,6 +719,164 @@ int delete_dir_contents_fd(int dfd, const char *name)
     return res;
 }
 
+// Copies the data of the regular file open as from_fd into the empty file to_fd. The data is
+// shared with a reflink when the file system supports it, and otherwise copied by the kernel,
+// falling back to read and write where copy_file_range is not available.
+static int copy_file_data(int from_fd, int to_fd) {
+    if (ioctl(to_fd, FICLONE, from_fd) == 0) {
+        return 0;
+    }
+    ssize_t copied;
+    while ((copied = syscall(__NR_copy_file_range, from_fd, nullptr, to_fd, nullptr,
+            kCopyChunkSize, 0)) > 0) {
+    }
+    if (copied == 0) {
+        return 0;
+    }
+    // copy_file_range moved both offsets past what it copied, so carry on from there.
+    std::unique_ptr<char[]> buffer(new char[kCopyBufferSize]);
+    ssize_t read_size;
+    while ((read_size = TEMP_FAILURE_RETRY(read(from_fd, buffer.get(), kCopyBufferSize))) > 0) {
+        if (!android::base::WriteFully(to_fd, buffer.get(), read_size)) {
+            return -1;
+        }
+    }
+    return read_size == 0 ? 0 : -1;
+}
+
+static int copy_node_at(int from_dfd, int to_dfd, const char* name);
+
+// Copies the children of the directory open as from_fd, which is closed on return, into the
+// directory to_fd. Keeps going after errors, like cp does.
+static int copy_dir_contents(int from_fd, int to_fd) {
+    DIR* d = fdopendir(from_fd);
+    if (d == nullptr) {
+        PLOG(ERROR) << "Failed to fdopendir";
+        close(from_fd);
+        return -1;
+    }
+    int result = 0;
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        const char* name = de->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+        if (copy_node_at(dirfd(d), to_fd, name) != 0) {
+            result = -1;
+        }
+    }
+    closedir(d);
+    return result;
+}
+
+// Copies name from from_dfd to to_dfd the way cp -F -p -R -P -d does: existing non directory
+// destinations are replaced, symlinks are copied as links, and the owner, mode and timestamps of
+// every node are preserved.
+static int copy_node_at(int from_dfd, int to_dfd, const char* name) {
+    struct stat st;
+    if (fstatat(from_dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to stat " << name;
+        return -1;
+    }
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    const mode_t mode = st.st_mode & 07777;
+
+    if (S_ISDIR(st.st_mode)) {
+        if (mkdirat(to_dfd, name, 0700) != 0 && errno != EEXIST) {
+            PLOG(ERROR) << "Failed to mkdir " << name;
+            return -1;
+        }
+        unique_fd from_fd(openat(from_dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        unique_fd to_fd(openat(to_dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        if (from_fd < 0 || to_fd < 0) {
+            PLOG(ERROR) << "Failed to open directory " << name;
+            return -1;
+        }
+        int result = copy_dir_contents(from_fd.release(), to_fd.get());
+        // The timestamps are set last, since copying the children modifies the directory.
+        if (fchown(to_fd.get(), st.st_uid, st.st_gid) != 0 || fchmod(to_fd.get(), mode) != 0
+                || futimens(to_fd.get(), times) != 0) {
+            PLOG(ERROR) << "Failed to set attributes of " << name;
+            result = -1;
+        }
+        return result;
+    }
+
+    if (unlinkat(to_dfd, name, 0) != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "Failed to remove existing " << name;
+        return -1;
+    }
+    if (S_ISREG(st.st_mode)) {
+        unique_fd from_fd(openat(from_dfd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+        unique_fd to_fd(openat(to_dfd, name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                0600));
+        if (from_fd < 0 || to_fd < 0) {
+            PLOG(ERROR) << "Failed to open " << name;
+            return -1;
+        }
+        if (copy_file_data(from_fd.get(), to_fd.get()) != 0) {
+            PLOG(ERROR) << "Failed to copy " << name;
+            return -1;
+        }
+        if (fchown(to_fd.get(), st.st_uid, st.st_gid) != 0 || fchmod(to_fd.get(), mode) != 0
+                || futimens(to_fd.get(), times) != 0) {
+            PLOG(ERROR) << "Failed to set attributes of " << name;
+            return -1;
+        }
+        return 0;
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+        char target[PATH_MAX];
+        ssize_t length = readlinkat(from_dfd, name, target, sizeof(target) - 1);
+        if (length < 0) {
+            PLOG(ERROR) << "Failed to readlink " << name;
+            return -1;
+        }
+        target[length] = '\0';
+        if (symlinkat(target, to_dfd, name) != 0) {
+            PLOG(ERROR) << "Failed to symlink " << name;
+            return -1;
+        }
+    } else if (mknodat(to_dfd, name, st.st_mode, st.st_rdev) != 0
+            || fchmodat(to_dfd, name, mode, 0) != 0) {
+        PLOG(ERROR) << "Failed to mknod " << name;
+        return -1;
+    }
+    if (fchownat(to_dfd, name, st.st_uid, st.st_gid, AT_SYMLINK_NOFOLLOW) != 0
+            || utimensat(to_dfd, name, times, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to set attributes of " << name;
+        return -1;
+    }
+    return 0;
+}
+
+int copy_directory_recursive(const char* from, const char* to) {
+    LOG(DEBUG) << "Copying " << from << " to " << to;
+
+    std::string from_path(from);
+    while (from_path.size() > 1 && from_path.back() == '/') {
+        from_path.pop_back();
+    }
+    size_t slash = from_path.rfind('/');
+    std::string from_parent = slash == std::string::npos ? "."
+            : (slash == 0 ? "/" : from_path.substr(0, slash));
+    std::string from_name = from_path.substr(slash == std::string::npos ? 0 : slash + 1);
+
+    unique_fd from_dfd(open(from_parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (from_dfd < 0) {
+        PLOG(ERROR) << "Failed to open " << from_parent;
+        return -1;
+    }
+    unique_fd to_dfd(open(to, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (to_dfd < 0) {
+        PLOG(ERROR) << "Failed to open " << to;
+        return -1;
+    }
+    return copy_node_at(from_dfd.get(), to_dfd.get(), from_name.c_str());
+}
+
 static int _copy_owner_permissions(int srcfd, int dstfd)
 {
     struct stat st;
@@ -127,6 +127,9 @@ int delete_dir_contents(const char *pathname,
 
 int delete_dir_contents_fd(int dfd, const char *name);
 
+// Copies from into the existing directory to, like cp -F -p -R -P -d.
+int copy_directory_recursive(const char* from, const char* to);
+
 int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
@@ -19,13 +19,16 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -53,6 +56,28 @@ using ::android::hidl::manager::V1_0::IServiceManager;
 namespace android {
 namespace lshal {
 
+// How many HALs are queried at the same time. Most of the time is spent waiting for the HALs
+// to answer, or for the IPC timeouts of those that do not.
+static constexpr size_t kQueryThreads = 8;
+
+// Calls func(i) for each i in [0, count), on up to kQueryThreads threads.
+static void forEachIndexInParallel(size_t count, const std::function<void(size_t)>& func) {
+    std::atomic<size_t> next{0};
+    auto loop = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(count, kQueryThreads); i++) {
+        threads.emplace_back(loop);
+    }
+    loop();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
 vintf::SchemaType toSchemaType(Partition p) {
     return (p == Partition::SYSTEM) ? vintf::SchemaType::FRAMEWORK : vintf::SchemaType::DEVICE;
 }
@@ -293,13 +318,13 @@ bool ListCommand::getPidInfo(
 }
 
 const PidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
-    auto pair = mCachedPidInfos.insert({serverPid, PidInfo{}});
-    if (pair.second /* did insertion take place? */) {
-        if (!getPidInfo(serverPid, &pair.first->second)) {
-            return nullptr;
-        }
+    CachedPidInfo* cached;
+    {
+        std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
+        cached = &mCachedPidInfos[serverPid];
     }
-    return &pair.first->second;
+    std::call_once(cached->once, [&] { cached->valid = getPidInfo(serverPid, &cached->info); });
+    return cached->valid ? &cached->info : nullptr;
 }
 
 bool ListCommand::shouldFetchHalType(const HalType &type) const {
@@ -543,21 +568,38 @@ void ListCommand::dumpTable(const NullableOStream<std::ostream>& out) const {
         return;
     }
 
-    forEachTable([this, &out](const Table &table) {
+    // We're only interested in dumping debug info for already
+    // instantiated services. There's little value in dumping the
+    // debug info for a service we create on the fly, so we only operate
+    // on the "mServicesTable".
+    // Each HAL can take a while to dump, so they all dump at once before the table is printed.
+    std::map<std::string, std::string> debugInfos;
+    if (mEmitDebugInfo && std::find(mListTypes.begin(), mListTypes.end(),
+                                    HalType::BINDERIZED_SERVICES) != mListTypes.end()) {
+        std::vector<std::string> interfaceNames;
+        for (const TableEntry& entry : mServicesTable) {
+            interfaceNames.push_back(entry.interfaceName);
+        }
+        std::vector<std::string> dumps(interfaceNames.size());
+        forEachIndexInParallel(interfaceNames.size(), [&](size_t i) {
+            std::stringstream ss;
+            auto pair = splitFirst(interfaceNames[i], '/');
+            mLshal.emitDebugInfo(pair.first, pair.second, {},
+                                 false /* excludesParentInstances */, ss,
+                                 NullableOStream<std::ostream>(nullptr));
+            dumps[i] = ss.str();
+        });
+        for (size_t i = 0; i < interfaceNames.size(); i++) {
+            debugInfos[interfaceNames[i]] = std::move(dumps[i]);
+        }
+    }
 
-        // We're only interested in dumping debug info for already
-        // instantiated services. There's little value in dumping the
-        // debug info for a service we create on the fly, so we only operate
-        // on the "mServicesTable".
+    forEachTable([this, &out, &debugInfos](const Table &table) {
         std::function<std::string(const std::string&)> emitDebugInfo = nullptr;
         if (mEmitDebugInfo && &table == &mServicesTable) {
-            emitDebugInfo = [this](const auto& iName) {
-                std::stringstream ss;
-                auto pair = splitFirst(iName, '/');
-                mLshal.emitDebugInfo(pair.first, pair.second, {},
-                                     false /* excludesParentInstances */, ss,
-                                     NullableOStream<std::ostream>(nullptr));
-                return ss.str();
+            emitDebugInfo = [&debugInfos](const auto& iName) {
+                auto it = debugInfos.find(iName);
+                return it == debugInfos.end() ? std::string() : it->second;
             };
         }
         table.createTextTable(mNeat, emitDebugInfo).dump(out.buf());
@@ -669,16 +711,28 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
-    Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
         entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+        entries.push_back(&entry);
+    }
+
+    // Query all of the HALs at once, then report the warnings in the order of the entries.
+    std::vector<Status> statuses(entries.size(), OK);
+    std::vector<std::stringstream> errors(entries.size());
+    forEachIndexInParallel(entries.size(), [&](size_t i) {
+        statuses[i] = fetchBinderizedEntry(manager, entries[i], errors[i]);
+    });
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    Status status = OK;
+    for (size_t i = 0; i < entries.size(); i++) {
+        err() << errors[i].str();
+        status |= statuses[i];
     }
 
     for (auto& pair : allTableEntries) {
@@ -688,10 +742,10 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 }
 
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::ostream &errors) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        errors << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -451,6 +451,58 @@ TEST_F(ListTest, Fetch) {
 
 }
 
+// Fake service that shares its process with the services whose ids have the same last digit.
+class SharedProcessTestService : public TestService {
+public:
+    explicit SharedProcessTestService(pid_t id) : TestService(id), mId(id) {}
+    hardware::Return<void> getDebugInfo(getDebugInfo_cb cb) override {
+        cb({ getSharedPid(mId), getPtr(mId), DebugInfo::Architecture::IS_64BIT });
+        return hardware::Void();
+    }
+    static pid_t getSharedPid(pid_t id) { return id % 10 + 1; }
+private:
+    pid_t mId;
+};
+
+TEST_F(ListTest, FetchManyBinderized) {
+    // More services than query threads, with several services per process.
+    const pid_t serviceCount = 40;
+    ON_CALL(*serviceManager, list(_)).WillByDefault(Invoke(
+        [&](IServiceManager::list_cb cb) {
+            std::vector<hidl_string> names;
+            for (pid_t id = 1; id <= serviceCount; id++) {
+                names.push_back(getFqInstanceName(id));
+            }
+            cb(names);
+            return hardware::Void();
+        }));
+    ON_CALL(*serviceManager, get(_, _)).WillByDefault(Invoke(
+        [&](const hidl_string&, const hidl_string& instance) {
+            return sp<IBase>(new SharedProcessTestService(getIdFromInstanceName(instance)));
+        }));
+    for (pid_t pid = 1; pid <= 10; pid++) {
+        EXPECT_CALL(*mockList, getPidInfo(pid, _)).Times(1);
+    }
+
+    optind = 1; // mimic Lshal::parseArg()
+    ASSERT_EQ(0u, mockList->parseArgs(createArg({"lshal", "--types=b"})));
+    ASSERT_EQ(0u, mockList->fetch());
+
+    pid_t count = 0;
+    mockList->forEachTable([&](const Table& table) {
+        for (const auto& entry : table) {
+            pid_t id = getIdFromInstanceName(splitFirst(entry.interfaceName, '/').second);
+            pid_t pid = SharedProcessTestService::getSharedPid(id);
+            EXPECT_EQ(getFqInstanceName(id), entry.interfaceName);
+            EXPECT_EQ(pid, entry.serverPid);
+            EXPECT_EQ(getPtr(id), entry.serverObjectAddress);
+            EXPECT_EQ(getPidInfoFromId(pid).threadCount, entry.threadCount);
+            ++count;
+        }
+    });
+    EXPECT_EQ(serviceCount, count) << "Not all entries are tested.";
+}
+
 TEST_F(ListTest, DumpVintf) {
     const std::string expected = "<manifest version=\"2.0\" type=\"device\">\n"
                                  "    <hal format=\"hidl\">\n"
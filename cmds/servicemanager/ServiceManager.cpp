@@ -128,9 +128,26 @@ Status ServiceManager::checkService(const std::string& name, sp<IBinder>* outBin
     return Status::ok();
 }
 
-sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
+Status ServiceManager::checkServices(const std::vector<std::string>& names,
+                                     std::unique_ptr<std::vector<sp<IBinder>>>* outBinders) {
+    // The calling context (including the SELinux context lookup) is the
+    // same for every name, so only compute it once.
     auto ctx = mAccess->getCallingContext();
 
+    *outBinders = std::make_unique<std::vector<sp<IBinder>>>();
+    (*outBinders)->reserve(names.size());
+    for (const std::string& name : names) {
+        (*outBinders)->push_back(tryGetService(ctx, name, false));
+    }
+    return Status::ok();
+}
+
+sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
+    return tryGetService(mAccess->getCallingContext(), name, startIfNotFound);
+}
+
+sp<IBinder> ServiceManager::tryGetService(const Access::CallingContext& ctx,
+                                          const std::string& name, bool startIfNotFound) {
     sp<IBinder> out;
     Service* service = nullptr;
     if (auto it = mNameToService.find(name); it != mNameToService.end()) {
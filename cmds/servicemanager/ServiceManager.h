@@ -35,6 +35,8 @@ public:
     // getService will try to start any services it cannot find
     binder::Status getService(const std::string& name, sp<IBinder>* outBinder) override;
     binder::Status checkService(const std::string& name, sp<IBinder>* outBinder) override;
+    binder::Status checkServices(const std::vector<std::string>& names,
+                                 std::unique_ptr<std::vector<sp<IBinder>>>* outBinders) override;
     binder::Status addService(const std::string& name, const sp<IBinder>& binder,
                               bool allowIsolated, int32_t dumpPriority) override;
     binder::Status listServices(int32_t dumpPriority, std::vector<std::string>* outList) override;
@@ -83,6 +85,8 @@ private:
     void removeClientCallback(const wp<IBinder>& who, ClientCallbackMap::iterator* it);
 
     sp<IBinder> tryGetService(const std::string& name, bool startIfNotFound);
+    sp<IBinder> tryGetService(const Access::CallingContext& ctx, const std::string& name,
+                              bool startIfNotFound);
 
     ServiceMap mNameToService;
     ServiceCallbackMap mNameToRegistrationCallback;
@@ -235,6 +235,44 @@ TEST(GetService, NotAllowedFromIsolated) {
     EXPECT_EQ(nullptr, out.get());
 }
 
+TEST(CheckServices, Batched) {
+    auto sm = getPermissiveServiceManager();
+    sp<IBinder> foo = getBinder();
+    sp<IBinder> bar = getBinder();
+
+    EXPECT_TRUE(sm->addService("foo", foo, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->addService("bar", bar, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::unique_ptr<std::vector<sp<IBinder>>> out;
+    EXPECT_TRUE(sm->checkServices({"bar", "missing", "foo"}, &out).isOk());
+    ASSERT_NE(nullptr, out);
+    EXPECT_THAT(*out, ElementsAre(bar, nullptr, foo));
+}
+
+TEST(CheckServices, NoPermissionsForOneService) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    ON_CALL(*access, getCallingContext()).WillByDefault(Return(Access::CallingContext{}));
+    ON_CALL(*access, canAdd(_, _)).WillByDefault(Return(true));
+    EXPECT_CALL(*access, canFind(_, "foo")).WillOnce(Return(true));
+    EXPECT_CALL(*access, canFind(_, "bar")).WillOnce(Return(false));
+
+    sp<ServiceManager> sm = new NiceMock<MockServiceManager>(std::move(access));
+    sp<IBinder> foo = getBinder();
+
+    EXPECT_TRUE(sm->addService("foo", foo, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->addService("bar", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::unique_ptr<std::vector<sp<IBinder>>> out;
+    EXPECT_TRUE(sm->checkServices({"foo", "bar"}, &out).isOk());
+    ASSERT_NE(nullptr, out);
+    EXPECT_THAT(*out, ElementsAre(foo, nullptr));
+}
+
 TEST(ListServices, NoPermissions) {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
@@ -22,9 +22,13 @@
 
 using namespace android;
 
-BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+BufferQueueScheduler::BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl,
+        const HSV& color, int id, const std::shared_ptr<ReplayStats>& stats)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mContinueScheduling(true),
+        mStats(stats) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -81,6 +85,11 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
     ANativeWindow_Buffer outBuffer;
     sp<Surface> s = mSurfaceControl->getSurface();
 
+    const nsecs_t fillStart = systemTime();
+    if (mStats != nullptr) {
+        s->enableFrameTimestamps(true);
+    }
+
     status_t status = s->lock(&outBuffer, nullptr);
 
     if (status != NO_ERROR) {
@@ -101,9 +110,64 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
         }
     }
 
+    if (mStats != nullptr) {
+        mStats->addSample(ReplayStats::Phase::BufferFill, systemTime() - fillStart);
+    }
+
     event->readyToExecute();
 
+    const uint64_t frameNumber = s->getNextFrameNumber();
+    const nsecs_t queueTime = systemTime();
     status = s->unlockAndPost();
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
+
+    if (mStats != nullptr && status == NO_ERROR) {
+        mStats->addSample(ReplayStats::Phase::BufferPost, systemTime() - queueTime);
+        mStats->increment(ReplayStats::Counter::FramesPosted);
+        {
+            std::lock_guard<std::mutex> lock(mFramesMutex);
+            mPostedFrames.push_back({s, frameNumber, queueTime});
+        }
+        collectFrameTimestamps(false);
+    }
+}
+
+void BufferQueueScheduler::collectFrameTimestamps(bool drain) {
+    if (mStats == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mFramesMutex);
+    while (!mPostedFrames.empty()) {
+        const PostedFrame& frame = mPostedFrames.front();
+        nsecs_t latchTime = NATIVE_WINDOW_TIMESTAMP_PENDING;
+        nsecs_t presentTime = NATIVE_WINDOW_TIMESTAMP_PENDING;
+        status_t status = frame.surface->getFrameTimestamps(frame.frameNumber, nullptr, nullptr,
+                &latchTime, nullptr, nullptr, nullptr, &presentTime, nullptr, nullptr);
+
+        const bool pending = latchTime == NATIVE_WINDOW_TIMESTAMP_PENDING ||
+                presentTime == NATIVE_WINDOW_TIMESTAMP_PENDING;
+        if (status == NO_ERROR && pending && !drain) {
+            // Frames are presented in order, so the ones after this are pending too.
+            break;
+        }
+
+        if (status != NO_ERROR || latchTime < 0 || presentTime < 0) {
+            mStats->increment(ReplayStats::Counter::FramesUntimed);
+        } else {
+            nsecs_t refreshPeriod = 0;
+            frame.surface->getCompositorTiming(nullptr, &refreshPeriod, nullptr);
+
+            const nsecs_t latency = presentTime - frame.queueTime;
+            mStats->addSample(ReplayStats::Phase::QueueToLatch, latchTime - frame.queueTime);
+            mStats->addSample(ReplayStats::Phase::LatchToPresent, presentTime - latchTime);
+            mStats->addSample(ReplayStats::Phase::QueueToPresent, latency);
+            mStats->increment(ReplayStats::Counter::FramesPresented);
+            if (refreshPeriod > 0 && latency > 2 * refreshPeriod) {
+                mStats->increment(ReplayStats::Counter::FramesMissed);
+            }
+        }
+        mPostedFrames.pop_front();
+    }
 }
@@ -19,13 +19,17 @@
 
 #include "Color.h"
 #include "Event.h"
+#include "ReplayStats.h"
 
+#include <gui/Surface.h>
 #include <gui/SurfaceControl.h>
 
 #include <utils/StrongPointer.h>
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <utility>
@@ -52,7 +56,8 @@ struct BufferEvent {
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            const std::shared_ptr<ReplayStats>& stats = nullptr);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -60,7 +65,17 @@ class BufferQueueScheduler {
 
     void setSurfaceControl(const sp<SurfaceControl>& surfaceControl, const HSV& color);
 
+    // Records the timestamps of every posted frame that SurfaceFlinger has presented. Frames
+    // still in flight are kept for the next call, unless drain is set.
+    void collectFrameTimestamps(bool drain);
+
   private:
+    struct PostedFrame {
+        sp<Surface> surface;
+        uint64_t frameNumber;
+        nsecs_t queueTime;
+    };
+
     void bufferUpdate(const Dimensions& dimensions);
 
     // Lock and fill the surface, block until the event is signaled by the main loop,
@@ -76,6 +91,11 @@ class BufferQueueScheduler {
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
+
+    // Only set in benchmark mode.
+    const std::shared_ptr<ReplayStats> mStats;
+    std::mutex mFramesMutex;
+    std::deque<PostedFrame> mPostedFrames;
 };
 
 }  // namespace android
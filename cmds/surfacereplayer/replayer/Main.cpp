@@ -51,6 +51,9 @@ void printHelpMenu() {
 
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
+    std::cout << "  -b  Benchmark mode: leave VSync to the display and print frame latency, "
+                 "missed frames and per-phase timings at the end of the trace\n";
+
     std::cout << "  -h  Display help menu\n";
 
     std::cout << std::endl;
@@ -61,11 +64,12 @@ int main(int argc, char** argv) {
     bool loop = false;
     bool wait = true;
     bool pauseBeginning = false;
+    bool benchmark = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nlbh?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -82,6 +86,9 @@ int main(int argc, char** argv) {
             case 'l':
                 loop = true;
                 break;
+            case 'b':
+                benchmark = true;
+                break;
             case 'h':
             case '?':
                 printHelpMenu();
@@ -102,7 +109,7 @@ int main(int argc, char** argv) {
 
     status_t status = NO_ERROR;
     do {
-        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
+        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere, benchmark);
         status = r.replay();
     } while(loop);
 
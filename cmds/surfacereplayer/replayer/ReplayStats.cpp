@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReplayStats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace android;
+
+static const char* const PHASE_NAMES[] = {
+        "dispatch lateness", "transaction apply", "buffer fill",     "buffer post",
+        "queue to latch",    "latch to present",  "queue to present",
+};
+
+static const char* const COUNTER_NAMES[] = {
+        "frames posted",
+        "frames presented",
+        "frames missed",
+        "frames without timestamps",
+};
+
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) ==
+                      static_cast<size_t>(ReplayStats::Phase::Count),
+              "Every phase needs a name");
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) ==
+                      static_cast<size_t>(ReplayStats::Counter::Count),
+              "Every counter needs a name");
+
+void ReplayStats::addSample(Phase phase, nsecs_t duration) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSamples[static_cast<size_t>(phase)].push_back(duration);
+}
+
+void ReplayStats::increment(Counter counter) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mCounters[static_cast<size_t>(counter)]++;
+}
+
+static double percentileMs(const std::vector<nsecs_t>& sorted, double fraction) {
+    const size_t index = std::min(static_cast<size_t>(fraction * sorted.size()), sorted.size() - 1);
+    return sorted[index] / 1e6;
+}
+
+void ReplayStats::dump(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    out << std::left << std::setw(20) << "phase (ms)" << std::right << std::setw(8) << "count"
+        << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+        << std::setw(10) << "max" << "\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < mSamples.size(); i++) {
+        if (mSamples[i].empty()) {
+            continue;
+        }
+        std::vector<nsecs_t> sorted = mSamples[i];
+        std::sort(sorted.begin(), sorted.end());
+        out << std::left << std::setw(20) << PHASE_NAMES[i] << std::right << std::setw(8)
+            << sorted.size() << std::setw(10) << percentileMs(sorted, 0.50) << std::setw(10)
+            << percentileMs(sorted, 0.90) << std::setw(10) << percentileMs(sorted, 0.99)
+            << std::setw(10) << sorted.back() / 1e6 << "\n";
+    }
+
+    out << "\n";
+    for (size_t i = 0; i < mCounters.size(); i++) {
+        out << std::left << std::setw(28) << COUNTER_NAMES[i] << mCounters[i] << "\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SURFACEREPLAYER_REPLAYSTATS_H
+#define ANDROID_SURFACEREPLAYER_REPLAYSTATS_H
+
+#include <utils/Timers.h>
+
+#include <array>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace android {
+
+// Timings collected while replaying a trace in benchmark mode. Every method may be called from
+// any of the replayer threads.
+class ReplayStats {
+  public:
+    enum class Phase {
+        DispatchLateness,  // How late the main loop released an increment, against the trace
+        TransactionApply,  // Time spent in Transaction::apply
+        BufferFill,        // Dequeuing and filling a buffer, before its increment is due
+        BufferPost,        // Time spent in Surface::unlockAndPost
+        QueueToLatch,      // From queueing a buffer to SurfaceFlinger latching it
+        LatchToPresent,    // From latching a buffer to the display presenting it
+        QueueToPresent,    // The full latency of a frame
+        Count
+    };
+
+    enum class Counter {
+        FramesPosted,
+        FramesPresented,
+        FramesMissed,       // Presented more than two refresh periods after being queued
+        FramesUntimed,      // Dropped from the frame history before all timestamps were known
+        Count
+    };
+
+    void addSample(Phase phase, nsecs_t duration);
+    void increment(Counter counter);
+
+    // Prints the percentiles of every phase that has samples, then the frame counters.
+    void dump(std::ostream& out) const;
+
+  private:
+    mutable std::mutex mLock;
+    std::array<std::vector<nsecs_t>, static_cast<size_t>(Phase::Count)> mSamples;
+    std::array<size_t, static_cast<size_t>(Counter::Count)> mCounters{};
+};
+
+}  // namespace android
+#endif
@@ -51,14 +51,15 @@ using namespace android;
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool benchmark)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mStats(benchmark ? std::make_shared<ReplayStats>() : nullptr) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -74,6 +75,7 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 
     mCurrentTime = mTrace.increment(0).time_stamp();
+    mTraceStartTime = mCurrentTime;
 
     sReplayingManually.store(replayManually);
 
@@ -82,16 +84,19 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool benchmark)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mStats(benchmark ? std::make_shared<ReplayStats>() : nullptr) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
+    mTraceStartTime = mCurrentTime;
 
     sReplayingManually.store(replayManually);
 
@@ -112,11 +117,16 @@ status_t Replayer::replay() {
         return status;
     }
 
-    SurfaceComposerClient::enableVSyncInjections(true);
+    // In benchmark mode SurfaceFlinger keeps following the display's own vsync, so that the
+    // latencies measured are the ones the device would show.
+    if (mStats == nullptr) {
+        SurfaceComposerClient::enableVSyncInjections(true);
+    }
 
     initReplay();
 
     ALOGV("Starting actual Replay!");
+    mReplayStartTime = systemTime();
     while (!mPendingIncrements.empty()) {
         mCurrentIncrement = mTrace.increment(mIncrementIndex);
 
@@ -125,7 +135,10 @@ status_t Replayer::replay() {
             sReplayingManually.store(true);
         }
 
-        waitForConsoleCommmand();
+        if (waitForConsoleCommmand()) {
+            // Resume the schedule from this increment rather than catching up on the pause.
+            mReplayStartTime = systemTime() - (mCurrentIncrement.time_stamp() - mTraceStartTime);
+        }
 
         if (mWaitForTimeStamps) {
             waitUntilTimestamp(mCurrentIncrement.time_stamp());
@@ -136,6 +149,11 @@ status_t Replayer::replay() {
 
         event->complete();
 
+        if (mStats != nullptr && mWaitForTimeStamps) {
+            mStats->addSample(ReplayStats::Phase::DispatchLateness,
+                    systemTime() - scheduledTime(mCurrentIncrement.time_stamp()));
+        }
+
         if (event->getIncrementType() == Increment::kVsyncEvent) {
             mWaitingForNextVSync = false;
         }
@@ -155,9 +173,28 @@ status_t Replayer::replay() {
 
     SurfaceComposerClient::enableVSyncInjections(false);
 
+    if (mStats != nullptr) {
+        reportBenchmark();
+    }
+
     return status;
 }
 
+void Replayer::reportBenchmark() {
+    // Give SurfaceFlinger a few refreshes to present the last buffers.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        std::lock_guard<std::mutex> lock(mBufferQueueSchedulerLock);
+        for (auto& scheduler : mBufferQueueSchedulers) {
+            scheduler.second->collectFrameTimestamps(true);
+        }
+    }
+
+    std::cout << "\nBenchmark results:\n";
+    mStats->dump(std::cout);
+}
+
 status_t Replayer::initReplay() {
     for (int i = 0; i < mNumThreads && i < mTrace.increment_size(); i++) {
         status_t status = dispatchEvent(i);
@@ -195,9 +232,9 @@ bool isNumber(const std::string& s) {
            std::find_if(s.begin(), s.end(), [](char c) { return !std::isdigit(c); }) == s.end();
 }
 
-void Replayer::waitForConsoleCommmand() {
+bool Replayer::waitForConsoleCommmand() {
     if (!sReplayingManually || mWaitingForNextVSync) {
-        return;
+        return false;
     }
 
     while (true) {
@@ -270,6 +307,8 @@ void Replayer::waitForConsoleCommmand() {
 
         std::cout << "Invalid Command" << std::endl;
     }
+
+    return true;
 }
 
 status_t Replayer::dispatchEvent(int index) {
@@ -296,7 +335,7 @@ status_t Replayer::dispatchEvent(int index) {
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId, mStats);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -347,7 +386,11 @@ status_t Replayer::doTransaction(const Transaction& t, const std::shared_ptr<Eve
 
     event->readyToExecute();
 
+    const nsecs_t applyStart = systemTime();
     liveTransaction.apply(t.synchronous());
+    if (mStats != nullptr) {
+        mStats->addSample(ReplayStats::Phase::TransactionApply, systemTime() - applyStart);
+    }
 
     ALOGV("Ended Transaction");
 
@@ -653,7 +696,9 @@ status_t Replayer::injectVSyncEvent(
 
     event->readyToExecute();
 
-    SurfaceComposerClient::injectVSync(vSyncEvent.when());
+    if (mStats == nullptr) {
+        SurfaceComposerClient::injectVSync(vSyncEvent.when());
+    }
 
     return NO_ERROR;
 }
@@ -687,9 +732,18 @@ void Replayer::updatePowerMode(const PowerModeUpdate& pmu, const std::shared_ptr
     SurfaceComposerClient::setDisplayPowerMode(mDisplays[pmu.id()], pmu.mode());
 }
 
+nsecs_t Replayer::scheduledTime(int64_t timestamp) const {
+    return mReplayStartTime + (timestamp - mTraceStartTime);
+}
+
 void Replayer::waitUntilTimestamp(int64_t timestamp) {
-    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(timestamp - mCurrentTime));
-    std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
+    // Sleep until the increment's offset from the start of the trace rather than for the gap
+    // since the previous increment, so that dispatch overhead does not accumulate as drift.
+    const nsecs_t delay = scheduledTime(timestamp) - systemTime();
+    ALOGV("Waiting for %lld nanoseconds...", static_cast<long long>(delay));
+    if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+    }
 }
 
 void Replayer::waitUntilDeferredTransactionLayerExists(
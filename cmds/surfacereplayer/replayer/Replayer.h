@@ -20,6 +20,7 @@
 #include "BufferQueueScheduler.h"
 #include "Color.h"
 #include "Event.h"
+#include "ReplayStats.h"
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
@@ -55,16 +56,18 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool benchmark = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool benchmark = false);
 
     status_t replay();
 
   private:
     status_t initReplay();
 
-    void waitForConsoleCommmand();
+    // Returns true if the replay was paused at the console.
+    bool waitForConsoleCommmand();
     static void stopAutoReplayHandler(int signal);
 
     status_t dispatchEvent(int index);
@@ -132,15 +135,20 @@ class Replayer {
     void setDisplayProjection(SurfaceComposerClient::Transaction& t,
             display_id id, const ProjectionChange& pc);
 
+    // The time at which the increment with the given trace timestamp is due.
+    nsecs_t scheduledTime(int64_t timestamp) const;
     void waitUntilTimestamp(int64_t timestamp);
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
+    void reportBenchmark();
 
     Trace mTrace;
     bool mLoaded = false;
     int32_t mIncrementIndex = 0;
     int64_t mCurrentTime = 0;
+    int64_t mTraceStartTime = 0;
+    nsecs_t mReplayStartTime = 0;
     int32_t mNumThreads = DEFAULT_THREADS;
 
     Increment mCurrentIncrement;
@@ -168,6 +176,9 @@ class Replayer {
     std::condition_variable mDisplayCond;
     std::unordered_map<display_id, sp<IBinder>> mDisplays;
 
+    // Only set in benchmark mode.
+    std::shared_ptr<ReplayStats> mStats;
+
     sp<SurfaceComposerClient> mComposerClient;
     std::queue<std::shared_ptr<Event>> mPendingIncrements;
 };
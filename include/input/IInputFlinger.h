@@ -37,6 +37,15 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& inputHandles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
+    /*
+     * Incremental form of setInputWindows. windowIds lists every input window in the same
+     * order setInputWindows would receive them, and changedInfos holds the info of only the
+     * windows that were added or modified since the previous call. Windows that are no longer
+     * listed in windowIds are removed.
+     */
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedInfos,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
     virtual void registerInputChannel(const sp<InputChannel>& channel) = 0;
     virtual void unregisterInputChannel(const sp<InputChannel>& channel) = 0;
 };
@@ -50,7 +59,8 @@ public:
     enum {
         SET_INPUT_WINDOWS_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
         REGISTER_INPUT_CHANNEL_TRANSACTION,
-        UNREGISTER_INPUT_CHANNEL_TRANSACTION
+        UNREGISTER_INPUT_CHANNEL_TRANSACTION,
+        UPDATE_INPUT_WINDOWS_TRANSACTION
     };
 
     virtual status_t onTransact(uint32_t code, const Parcel& data,
@@ -697,6 +697,13 @@ public:
             nsecs_t eventTime,
             const PointerCoords* pointerCoords);
 
+    // Appends a sample and returns its pointer coordinates, which the caller must fill in.
+    // This avoids copying the coordinates through a temporary array.
+    PointerCoords* appendSample(nsecs_t eventTime);
+
+    // Makes room for sampleCount samples in total, so that adding them does not reallocate.
+    void reserveSamples(size_t sampleCount);
+
     void offsetLocation(float xOffset, float yOffset);
 
     void scale(float globalScaleFactor);
@@ -30,6 +30,7 @@
  */
 
 #include <string>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 
@@ -171,6 +172,8 @@ struct InputMessage {
 
     bool isValid(size_t actualSize) const;
     size_t size() const;
+    // Copies the message to |msg|, with padding zeroed. Only the first size() bytes of |msg|
+    // are written.
     void getSanitizedCopy(InputMessage* msg) const;
 };
 
@@ -216,6 +219,17 @@ public:
      */
     status_t sendMessage(const InputMessage* msg);
 
+    /* Send several messages to the other endpoint, with as few system calls as possible.
+     * The messages are sanitized in place before they are sent.
+     *
+     * The messages are sent in order. *outSentCount is set to the number of messages that were
+     * sent; if the channel fills up part way, the remaining messages have not been sent at all.
+     *
+     * Return OK if all the messages were sent.
+     * Otherwise return the error for the first message that was not sent, as for sendMessage.
+     */
+    status_t sendMessages(InputMessage* msgs, size_t count, size_t* outSentCount);
+
     /* Receive a message sent by the other endpoint.
      *
      * If there is no message present, try again after poll() indicates that the fd
@@ -311,6 +325,26 @@ public:
      */
     status_t publishFocusEvent(uint32_t seq, int32_t eventId, bool hasFocus, bool inTouchMode);
 
+    /* Starts a batch of motion events. Until flushMotionBatch() is called, publishMotionEvent
+     * validates and queues each event instead of sending it, and returns OK.
+     *
+     * Used by the dispatcher when several motion events are pending for a consumer, so that
+     * they are written to the channel with a single system call. Key and focus events must not
+     * be published while a batch is open.
+     */
+    void beginMotionBatch();
+
+    /* Sends the motion events queued since beginMotionBatch() and closes the batch.
+     * *outPublishedCount is set to the number of events that were sent, in publish order.
+     * The events that were not sent are dropped from the publisher and may be published again.
+     *
+     * Returns OK if all the events were sent.
+     * Returns WOULD_BLOCK if the channel filled up before all the events were sent.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Other errors probably indicate that the channel is broken.
+     */
+    status_t flushMotionBatch(size_t* outPublishedCount);
+
     /* Receives the finished signal from the consumer in reply to the original dispatch signal.
      * If a signal was received, returns the message sequence number,
      * and whether the consumer handled the message.
@@ -327,6 +361,10 @@ public:
 private:
 
     sp<InputChannel> mChannel;
+
+    bool mBatchingMotionEvents = false;
+    // Kept across batches to avoid reallocating.
+    std::vector<InputMessage> mBatchedMotionMessages;
 };
 
 /*
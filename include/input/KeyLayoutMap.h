@@ -23,6 +23,8 @@
 #include <utils/Tokenizer.h>
 #include <utils/RefBase.h>
 
+#include <vector>
+
 namespace android {
 
 struct AxisInfo {
@@ -92,8 +94,14 @@ private:
     KeyedVector<int32_t, Led> mLedsByScanCode;
     KeyedVector<int32_t, Led> mLedsByUsageCode;
 
+    // Copy of mKeysByScanCode indexed directly by the low scan codes, which is where nearly all
+    // keyboard and gamepad keys are, so that mapping them does not need a binary search.
+    // Unmapped entries have a key code of AKEYCODE_UNKNOWN.
+    std::vector<Key> mKeysByScanCodeTable;
+
     KeyLayoutMap();
 
+    void buildScanCodeTable();
     const Key* getKey(int32_t scanCode, int32_t usageCode) const;
 
     class Parser {
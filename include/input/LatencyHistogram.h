@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_LATENCY_HISTOGRAM_H
+#define _UI_INPUT_LATENCY_HISTOGRAM_H
+
+#include <utils/Timers.h>
+
+#include <array>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * Fixed-bucket histogram of latencies. Unlike LatencyStatistics, it can estimate percentiles,
+ * while using a constant amount of memory and constant time per sample.
+ * The buckets are finer at the low latencies that matter for input.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void addValue(nsecs_t latency);
+    void reset();
+
+    size_t getCount() const;
+    nsecs_t getMax() const;
+    /* Estimates the latency below which the given fraction of the samples lie. Returns 0 if no
+     * samples have been added. */
+    nsecs_t getPercentile(float fraction) const;
+
+    /* Returns a one line summary with the count, median, p90, p99 and maximum. */
+    std::string dump() const;
+
+private:
+    // One bucket per upper bound in LatencyHistogram.cpp, plus one for everything above.
+    static constexpr size_t BUCKET_COUNT = 25;
+
+    std::array<uint32_t, BUCKET_COUNT> mBuckets;
+    size_t mCount;
+    nsecs_t mMax;
+};
+
+} // namespace android
+
+#endif // _UI_INPUT_LATENCY_HISTOGRAM_H
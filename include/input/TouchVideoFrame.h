@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,11 +28,20 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ *
+ * Copies of a frame share its data, so that frames can be passed along without
+ * copying the heatmap. The data is only copied if a shared frame gets rotated.
  */
 class TouchVideoFrame {
 public:
     TouchVideoFrame(uint32_t height, uint32_t width, std::vector<int16_t> data,
             const struct timeval& timestamp);
+    /**
+     * Create a frame around existing data, e.g. a buffer from a pool.
+     * The data must not be null, and must not be modified while the frame exists.
+     */
+    static TouchVideoFrame fromSharedData(uint32_t height, uint32_t width,
+            std::shared_ptr<std::vector<int16_t>> data, const struct timeval& timestamp);
 
     bool operator==(const TouchVideoFrame& rhs) const;
 
@@ -64,14 +74,20 @@ public:
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
+    TouchVideoFrame() = default;
+
     /**
      * Common method for 90 degree and 270 degree rotation
      */
     void rotateQuarterTurn(bool clockwise);
     void rotate180();
+    /**
+     * Whether no other frame shares the data, so that it can be modified in place.
+     */
+    bool hasExclusiveData() const;
 };
 
 } // namespace android
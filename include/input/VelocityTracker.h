@@ -191,6 +191,77 @@ private:
 };
 
 
+/*
+ * Velocity tracker algorithm that produces the same unweighted second-order least-squares fit as
+ * LeastSquaresVelocityTrackerStrategy(2), but keeps running sums of the normal equations for each
+ * pointer. Samples are added to and removed from the sums as they enter and leave the history, so
+ * both addMovement and getEstimator take constant time per pointer.
+ */
+class IncrementalLeastSquaresVelocityTrackerStrategy : public VelocityTrackerStrategy {
+public:
+    IncrementalLeastSquaresVelocityTrackerStrategy();
+    virtual ~IncrementalLeastSquaresVelocityTrackerStrategy();
+
+    virtual void clear();
+    virtual void clearPointers(BitSet32 idBits);
+    virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
+            const VelocityTracker::Position* positions);
+    virtual bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const;
+
+private:
+    // Sample horizon and number of samples to keep, matching LeastSquaresVelocityTrackerStrategy.
+    static constexpr nsecs_t HORIZON = 100 * 1000000; // 100 ms
+    static constexpr size_t HISTORY_SIZE = 20;
+
+    // Once the newest sample is this far from the time base of the sums, the sums are
+    // accumulated again from the retained samples. This bounds both the magnitude of the
+    // powers of time and the rounding error left behind by removed samples.
+    static constexpr nsecs_t REBASE_INTERVAL = 2 * HORIZON;
+
+    struct Sample {
+        nsecs_t eventTime;
+        VelocityTracker::Position position;
+    };
+
+    // Sums of t^k, x * t^k and y * t^k over the retained samples, where t is the time of a
+    // sample in seconds relative to baseTime.
+    struct Sums {
+        double t[5];
+        double xt[3];
+        double yt[3];
+
+        void clear();
+        void add(double time, const VelocityTracker::Position& position, double sign);
+    };
+
+    struct PointerState {
+        nsecs_t baseTime;
+        size_t oldestIndex;
+        size_t count;
+        Sample samples[HISTORY_SIZE];
+        Sums sums;
+
+        void clear();
+        const Sample& oldest() const;
+        const Sample& newest() const;
+        void pushNewest(const Sample& sample);
+        void popNewest();
+        void popOldest();
+        void rebase(nsecs_t newBaseTime);
+
+    private:
+        void accumulate(const Sample& sample, double sign);
+    };
+
+    // Time of the newest movement and of the one before it.
+    nsecs_t mLastEventTime;
+    nsecs_t mPreviousEventTime;
+    // Pointers present in the newest movement.
+    BitSet32 mLastIdBits;
+    PointerState mPointerState[MAX_POINTER_ID + 1];
+};
+
+
 /*
  * Velocity tracker algorithm that uses an IIR filter.
  */
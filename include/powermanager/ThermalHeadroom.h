@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_POWERMANAGER_THERMAL_HEADROOM_H
+#define ANDROID_POWERMANAGER_THERMAL_HEADROOM_H
+
+#include <mutex>
+
+#include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+namespace os {
+class IThermalService;
+} // namespace os
+
+/**
+ * Cached access to the thermal headroom forecast of the thermal service, for native services
+ * that want to scale back background work before the device is throttled.
+ *
+ * The headroom is 0 when the device is cool and reaches 1 when it would be throttled at
+ * THERMAL_STATUS_SEVERE. Forecasts are cached for CACHE_DURATION, so querying is cheap enough for
+ * per-frame or per-job decisions. Safe to call from any thread.
+ */
+class ThermalHeadroom {
+public:
+    // Forecasts are only queried from the thermal service this often.
+    static constexpr nsecs_t CACHE_DURATION = s2ns(1);
+    static constexpr int DEFAULT_FORECAST_SECONDS = 10;
+    // Background work should back off above this headroom.
+    static constexpr float BACKGROUND_WORK_THRESHOLD = 0.8f;
+
+    static ThermalHeadroom& getInstance();
+
+    /**
+     * Returns the forecast headroom in forecastSeconds, or NaN if it is unknown, e.g. if the
+     * thermal service is not running or the device has no thermal HAL.
+     */
+    float getHeadroom(int forecastSeconds = DEFAULT_FORECAST_SECONDS);
+
+    /**
+     * Returns whether expensive background work should be deferred. False if the headroom is
+     * unknown.
+     */
+    bool shouldDeferBackgroundWork(int forecastSeconds = DEFAULT_FORECAST_SECONDS);
+
+private:
+    ThermalHeadroom() = default;
+
+    sp<os::IThermalService> getThermalServiceLocked();
+
+    std::mutex mLock;
+    sp<os::IThermalService> mThermalService; // guarded by mLock
+    int mForecastSeconds = -1;               // guarded by mLock
+    float mHeadroom = 0.f;                   // guarded by mLock
+    nsecs_t mUpdateTime = 0;                 // guarded by mLock
+};
+
+}; // namespace android
+
+#endif // ANDROID_POWERMANAGER_THERMAL_HEADROOM_H
@@ -43,6 +43,7 @@
 #include <unistd.h>
 
 #include "Static.h"
+#include "TransactionStats.h"
 
 #if LOG_NDEBUG
 
@@ -466,6 +467,9 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD < 0)
         return;
+    if (mOnewayBatchPending > 0) {
+        flushOnewayBatch();
+    }
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -478,6 +482,45 @@ void IPCThreadState::flushCommands()
     }
 }
 
+void IPCThreadState::beginOnewayBatch(size_t maxTransactions, nsecs_t maxDelay)
+{
+    mOnewayBatchLimit = maxTransactions > 0 ? maxTransactions : 1;
+    mOnewayBatchMaxDelay = maxDelay;
+}
+
+status_t IPCThreadState::endOnewayBatch()
+{
+    mOnewayBatchLimit = 0;
+    return flushOnewayBatch();
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    if (mOnewayBatchFlushing) return NO_ERROR;
+    mOnewayBatchFlushing = true;
+
+    // Writes out the whole batch with the first call, then consumes one
+    // completion per transaction; those are normally returned by a single
+    // read.
+    status_t result = NO_ERROR;
+    while (mOnewayBatchPending > 0) {
+        mOnewayBatchPending--;
+        status_t err = waitForResponse(nullptr, nullptr);
+        if (err != NO_ERROR && result == NO_ERROR) {
+            result = err;
+        }
+        if (err != NO_ERROR && err != DEAD_OBJECT && err != FAILED_TRANSACTION) {
+            // The driver connection itself failed; there is nothing left
+            // to consume for the remaining transactions.
+            mOnewayBatchPending = 0;
+        }
+    }
+    mOnewayBatchParcels.clear();
+
+    mOnewayBatchFlushing = false;
+    return result;
+}
+
 void IPCThreadState::blockUntilThreadAvailable()
 {
     pthread_mutex_lock(&mProcess->mThreadCountLock);
@@ -495,6 +538,12 @@ status_t IPCThreadState::getAndExecuteCommand()
     status_t result;
     int32_t cmd;
 
+    if (mOnewayBatchPending > 0) {
+        // A handler left a batch open; its completions must not be mistaken
+        // for incoming commands.
+        flushOnewayBatch();
+    }
+
     result = talkWithDriver();
     if (result >= NO_ERROR) {
         size_t IN = mIn.dataAvail();
@@ -507,6 +556,9 @@ status_t IPCThreadState::getAndExecuteCommand()
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
+        if (mProcess->mMaxThreadsCeiling != 0) {
+            mProcess->maybeGrowThreadPoolLocked();
+        }
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
@@ -665,6 +717,40 @@ status_t IPCThreadState::transact(int32_t handle,
 
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
+    const nsecs_t startTime = TransactionStats::isEnabled() ? systemTime() : 0;
+
+    if ((flags & TF_ONE_WAY) != 0 && mOnewayBatchLimit > 0 && !mOnewayBatchFlushing) {
+        // The caller's Parcel may go away as soon as we return, so the
+        // batch refers to a copy that lives until mOut is written.
+        std::unique_ptr<Parcel> copy = std::make_unique<Parcel>();
+        err = data.errorCheck();
+        if (err == NO_ERROR) {
+            err = copy->appendFrom(&data, 0, data.dataSize());
+        }
+        if (err == NO_ERROR) {
+            err = writeTransactionData(BC_TRANSACTION, flags, handle, code, *copy, nullptr);
+        }
+        if (err != NO_ERROR) {
+            return (mLastError = err);
+        }
+        mOnewayBatchParcels.push_back(std::move(copy));
+        const nsecs_t now = systemTime();
+        if (mOnewayBatchPending++ == 0) {
+            mOnewayBatchStartTime = now;
+        }
+        if (mOnewayBatchPending >= mOnewayBatchLimit ||
+                now - mOnewayBatchStartTime >= mOnewayBatchMaxDelay) {
+            err = flushOnewayBatch();
+        }
+        return err;
+    }
+
+    if (mOnewayBatchPending > 0) {
+        // Completions for the batch must be consumed before this call's,
+        // so hand the batch to the driver first.
+        flushOnewayBatch();
+    }
+
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
 
     if (err != NO_ERROR) {
@@ -715,6 +801,11 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(nullptr, nullptr);
     }
 
+    if (startTime != 0) {
+        TransactionStats::record(TransactionStats::CLIENT_ROUND_TRIP, code,
+                                 systemTime() - startTime);
+    }
+
     return err;
 }
 
@@ -807,6 +898,12 @@ IPCThreadState::IPCThreadState()
       mPropagateWorkSource(false),
       mStrictModePolicy(0),
       mLastTransactionBinderFlags(0),
+      mLastDriverReadTime(0),
+      mOnewayBatchLimit(0),
+      mOnewayBatchMaxDelay(0),
+      mOnewayBatchStartTime(0),
+      mOnewayBatchPending(0),
+      mOnewayBatchFlushing(false),
       mCallRestriction(mProcess->mCallRestriction)
 {
     pthread_setspecific(gTLS, this);
@@ -823,6 +920,13 @@ status_t IPCThreadState::sendReply(const Parcel& reply, uint32_t flags)
 {
     status_t err;
     status_t statusBuffer;
+
+    if (mOnewayBatchPending > 0) {
+        // Transactions batched by the handler go out before its reply, and
+        // their completions are consumed before waiting for the reply's.
+        flushOnewayBatch();
+    }
+
     err = writeTransactionData(BC_REPLY, flags, -1, 0, reply, &statusBuffer);
     if (err < NO_ERROR) return err;
 
@@ -1010,6 +1114,9 @@ status_t IPCThreadState::talkWithDriver(bool doReceive)
         if (bwr.read_consumed > 0) {
             mIn.setDataSize(bwr.read_consumed);
             mIn.setDataPosition(0);
+            if (TransactionStats::isEnabled()) {
+                mLastDriverReadTime = systemTime();
+            }
         }
         IF_LOG_COMMANDS() {
             TextOutput::Bundle _b(alog);
@@ -1210,6 +1317,14 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                     << ", offsets addr="
                     << reinterpret_cast<const size_t*>(tr.data.ptr.offsets) << endl;
             }
+            nsecs_t execStartTime = 0;
+            if (TransactionStats::isEnabled()) {
+                execStartTime = systemTime();
+                if (mLastDriverReadTime != 0) {
+                    TransactionStats::record(TransactionStats::SERVER_DISPATCH, tr.code,
+                                             execStartTime - mLastDriverReadTime);
+                }
+            }
             if (tr.target.ptr) {
                 // We only have a weak reference on the target object, so we must first try to
                 // safely acquire a strong reference before doing anything else with it.
@@ -1226,6 +1341,11 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
             }
 
+            if (execStartTime != 0) {
+                TransactionStats::record(TransactionStats::SERVER_EXECUTION, tr.code,
+                                         systemTime() - execStartTime);
+            }
+
             //ALOGI("<<<< TRANSACT from pid %d restore pid %d sid %s uid %d\n",
             //     mCallingPid, origPid, (origSid ? origSid : "<N/A>"), origUid);
 
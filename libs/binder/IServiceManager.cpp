@@ -38,6 +38,9 @@
 
 #include <unistd.h>
 
+#include <map>
+#include <mutex>
+
 namespace android {
 
 using AidlServiceManager = android::os::IServiceManager;
@@ -68,6 +71,7 @@ public:
 
     sp<IBinder> getService(const String16& name) const override;
     sp<IBinder> checkService(const String16& name) const override;
+    Vector<sp<IBinder>> checkServices(const Vector<String16>& names) const override;
     status_t addService(const String16& name, const sp<IBinder>& service,
                         bool allowIsolated, int dumpsysPriority) override;
     Vector<String16> listServices(int dumpsysPriority) override;
@@ -82,7 +86,32 @@ public:
         return IInterface::asBinder(mTheRealServiceManager).get();
     }
 private:
+    // Caches remote services by name so repeated lookups don't go back to
+    // servicemanager. Entries only hold weak references, so caching doesn't
+    // keep services (lazy ones in particular) alive, and are dropped when the
+    // service dies. Each cached name is also registered for notifications,
+    // so a service that is added again under the same name replaces the
+    // entry even if the old binder is still alive.
+    class LookupCache : public IBinder::DeathRecipient {
+    public:
+        explicit LookupCache(const sp<AidlServiceManager>& sm) : mServiceManager(sm) {}
+        sp<IBinder> get(const std::string& name);
+        void put(const std::string& name, const sp<IBinder>& binder);
+        void binderDied(const wp<IBinder>& who) override;
+    private:
+        class RegistrationCallback;
+        struct Entry {
+            wp<IBinder> binder;
+            sp<RegistrationCallback> callback;
+        };
+
+        const sp<AidlServiceManager> mServiceManager;
+        std::mutex mMutex;
+        std::map<std::string, Entry> mEntries;
+    };
+
     sp<AidlServiceManager> mTheRealServiceManager;
+    sp<LookupCache> mLookupCache;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -203,9 +232,82 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 // ----------------------------------------------------------------------
 
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
- : mTheRealServiceManager(impl)
+ : mTheRealServiceManager(impl),
+   mLookupCache(new LookupCache(impl))
 {}
 
+class ServiceManagerShim::LookupCache::RegistrationCallback
+      : public android::os::BnServiceCallback {
+public:
+    explicit RegistrationCallback(const wp<LookupCache>& cache) : mCache(cache) {}
+
+    Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+        sp<LookupCache> cache = mCache.promote();
+        if (cache != nullptr) cache->put(name, binder);
+        return Status::ok();
+    }
+private:
+    const wp<LookupCache> mCache;
+};
+
+sp<IBinder> ServiceManagerShim::LookupCache::get(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(name);
+    if (it == mEntries.end()) return nullptr;
+    sp<IBinder> binder = it->second.binder.promote();
+    if (binder == nullptr || !binder->isBinderAlive()) {
+        // Keep the entry's callback registered so a restarted service is
+        // picked up again.
+        it->second.binder = nullptr;
+        return nullptr;
+    }
+    return binder;
+}
+
+void ServiceManagerShim::LookupCache::put(const std::string& name, const sp<IBinder>& binder)
+{
+    // Invalidation relies on death notifications, which are only delivered
+    // to processes with a binder thread pool. Local binders can't die.
+    if (binder == nullptr || binder->remoteBinder() == nullptr ||
+            !ProcessState::self()->isThreadPoolStarted()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(name);
+        if (it != mEntries.end() && it->second.binder == binder) return;
+    }
+    // Not done under mMutex: linkToDeath() reports an already dead binder
+    // synchronously, which would call back into binderDied().
+    if (binder->linkToDeath(this) != OK) return;
+
+    sp<RegistrationCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Entry& entry = mEntries[name];
+        entry.binder = binder;
+        if (entry.callback != nullptr) return;
+        callback = new RegistrationCallback(this);
+        entry.callback = callback;
+    }
+    // Without notifications a re-registered service would never replace the
+    // entry, so don't cache names servicemanager won't report on.
+    if (!mServiceManager->registerForNotifications(name, callback).isOk()) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(name);
+        if (it != mEntries.end() && it->second.callback == callback) mEntries.erase(it);
+    }
+}
+
+void ServiceManagerShim::LookupCache::binderDied(const wp<IBinder>& who)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& [name, entry] : mEntries) {
+        if (entry.binder == who) entry.binder = nullptr;
+    }
+}
+
 sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 {
     static bool gSystemBootCompleted = false;
@@ -245,13 +347,49 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
-    sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    const std::string name8 = String8(name).c_str();
+    sp<IBinder> ret = mLookupCache->get(name8);
+    if (ret != nullptr) return ret;
+
+    if (!mTheRealServiceManager->checkService(name8, &ret).isOk()) {
         return nullptr;
     }
+    mLookupCache->put(name8, ret);
     return ret;
 }
 
+Vector<sp<IBinder>> ServiceManagerShim::checkServices(const Vector<String16>& names) const
+{
+    Vector<sp<IBinder>> res;
+    res.insertAt(nullptr, 0, names.size());
+
+    // Only ask servicemanager for what isn't cached.
+    std::vector<std::string> missing;
+    std::vector<size_t> missingIndex;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string name8 = String8(names[i]).c_str();
+        sp<IBinder> cached = mLookupCache->get(name8);
+        if (cached != nullptr) {
+            res.editItemAt(i) = cached;
+        } else {
+            missing.push_back(std::move(name8));
+            missingIndex.push_back(i);
+        }
+    }
+    if (missing.empty()) return res;
+
+    std::unique_ptr<std::vector<sp<IBinder>>> ret;
+    if (!mTheRealServiceManager->checkServices(missing, &ret).isOk() || ret == nullptr ||
+            ret->size() != missing.size()) {
+        return res;
+    }
+    for (size_t i = 0; i < missing.size(); i++) {
+        mLookupCache->put(missing[i], (*ret)[i]);
+        res.editItemAt(missingIndex[i]) = (*ret)[i];
+    }
+    return res;
+}
+
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
                                         bool allowIsolated, int dumpsysPriority)
 {
@@ -305,11 +443,16 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 
     const std::string name = String8(name16).c_str();
 
-    sp<IBinder> out;
+    sp<IBinder> out = mLookupCache->get(name);
+    if (out != nullptr) return out;
+
     if (!mTheRealServiceManager->getService(name, &out).isOk()) {
         return nullptr;
     }
-    if (out != nullptr) return out;
+    if (out != nullptr) {
+        mLookupCache->put(name, out);
+        return out;
+    }
 
     sp<Waiter> waiter = new Waiter;
     if (!mTheRealServiceManager->registerForNotifications(
@@ -327,7 +470,10 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
             waiter->mCv.wait_for(lock, 1s, [&] {
                 return waiter->mBinder != nullptr;
             });
-            if (waiter->mBinder != nullptr) return waiter->mBinder;
+            if (waiter->mBinder != nullptr) {
+                mLookupCache->put(name, waiter->mBinder);
+                return waiter->mBinder;
+            }
         }
 
         // Handle race condition for lazy services. Here is what can happen:
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_BINDER_LAZY_SERVICE_LINGER_H
+#define ANDROID_BINDER_LAZY_SERVICE_LINGER_H
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <optional>
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace binder {
+namespace internal {
+
+// Decides how long a lazy service process lingers without clients before it shuts down, from
+// how long clients recently stayed away. Not thread safe; LazyServiceRegistrar guards it with its
+// own lock. Times are passed in so that the policy can be tested without waiting.
+class LazyServiceLinger
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void setPolicy(std::chrono::milliseconds minLinger, std::chrono::milliseconds maxLinger) {
+        mMinLinger = minLinger;
+        mMaxLinger = std::max(minLinger, maxLinger);
+    }
+
+    // How long to linger for, given how long clients recently stayed away. Lingers for twice the
+    // longest recent absence, so that clients coming back with the same pattern are caught again
+    // even with some jitter.
+    Clock::duration linger() const {
+        Clock::duration longest = Clock::duration::zero();
+        for (const auto& idleTime : mRecentIdleTimes) {
+            longest = std::max(longest, idleTime);
+        }
+        return std::clamp<Clock::duration>(2 * longest, mMinLinger, mMaxLinger);
+    }
+
+    // The process has no clients left at |now|. Returns when it should shut down, which is |now|
+    // when it should not linger. While it already lingers, the deadline stays relative to when
+    // the last client left.
+    Clock::time_point onIdle(Clock::time_point now) {
+        const Clock::duration duration = linger();
+        if (duration == Clock::duration::zero()) {
+            return now;
+        }
+        if (!mIdleSince) {
+            mIdleSince = now;
+        }
+        return *mIdleSince + duration;
+    }
+
+    bool isIdle() const { return mIdleSince.has_value(); }
+
+    // A client came back at |now| while the process lingered.
+    void onClientsBack(Clock::time_point now) {
+        if (!mIdleSince) return;
+        mRecentIdleTimes.push_back(now - *mIdleSince);
+        if (mRecentIdleTimes.size() > kMaxRecentIdleTimes) {
+            mRecentIdleTimes.pop_front();
+        }
+        mIdleSince.reset();
+    }
+
+    // Lingering ended without clients coming back in time; it starts over the next time they
+    // leave.
+    void reset() { mIdleSince.reset(); }
+
+    static constexpr size_t kMaxRecentIdleTimes = 8;
+
+private:
+    std::chrono::milliseconds mMinLinger{0};
+    std::chrono::milliseconds mMaxLinger{0};
+
+    // When the last client left, while the process lingers.
+    std::optional<Clock::time_point> mIdleSince;
+    // How long clients stayed away the last few times they came back while the process lingered.
+    std::deque<Clock::duration> mRecentIdleTimes;
+};
+
+} // namespace internal
+} // namespace binder
+} // namespace android
+
+// ---------------------------------------------------------------------------
+
+#endif // ANDROID_BINDER_LAZY_SERVICE_LINGER_H
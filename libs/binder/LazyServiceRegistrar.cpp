@@ -23,6 +23,13 @@
 #include <android/os/IServiceManager.h>
 #include <utils/Log.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "LazyServiceLinger.h"
+
 namespace android {
 namespace binder {
 namespace internal {
@@ -31,7 +38,10 @@ using AidlServiceManager = android::os::IServiceManager;
 
 class ClientCounterCallback : public ::android::os::BnClientCallback {
 public:
+    using Clock = LazyServiceLinger::Clock;
+
     ClientCounterCallback() : mNumConnectedServices(0), mForcePersist(false) {}
+    ~ClientCounterCallback();
 
     bool registerService(const sp<IBinder>& service, const std::string& name,
                          bool allowIsolated, int dumpFlags);
@@ -41,15 +51,30 @@ public:
      */
     void forcePersist(bool persist);
 
+    void setLingerPolicy(std::chrono::milliseconds minLinger, std::chrono::milliseconds maxLinger);
+    void setShutdownCallback(std::function<void()> callback);
+
 protected:
     Status onClients(const sp<IBinder>& service, bool clients) override;
 
 private:
+    bool registerServiceLocked(const sp<IBinder>& service, const std::string& name,
+                               bool allowIsolated, int dumpFlags);
+
+    /**
+     * Shuts down right away, or once the process lingered without clients, if there are none.
+     */
+    void maybeShutdownLocked();
+
+    void lingerThreadMain();
+
     /**
      * Unregisters all services that we can. If we can't unregister all, re-register other
-     * services.
+     * services. Once all are unregistered, releases mMutex, runs the shutdown callback and exits.
      */
-    void tryShutdown();
+    void tryShutdownLocked();
+
+    std::mutex mMutex;
 
     /**
      * Counter of the number of services that currently have at least one client.
@@ -67,10 +92,44 @@ private:
     std::map<std::string, Service> mRegisteredServices;
 
     bool mForcePersist;
+
+    LazyServiceLinger mLinger;
+    std::function<void()> mShutdownCallback;
+
+    /**
+     * Set once all services are unregistered, while the shutdown callback runs without mMutex.
+     */
+    bool mShuttingDown = false;
+
+    /**
+     * Shuts the process down once mShutdownDeadline passes, unless clients came back meanwhile.
+     */
+    std::thread mLingerThread;
+    std::condition_variable mLingerCondition;
+    std::optional<Clock::time_point> mShutdownDeadline;
+    bool mQuit = false;
 };
 
+ClientCounterCallback::~ClientCounterCallback() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mLingerCondition.notify_all();
+    if (mLingerThread.joinable()) {
+        mLingerThread.join();
+    }
+}
+
 bool ClientCounterCallback::registerService(const sp<IBinder>& service, const std::string& name,
                                             bool allowIsolated, int dumpFlags) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return registerServiceLocked(service, name, allowIsolated, dumpFlags);
+}
+
+bool ClientCounterCallback::registerServiceLocked(const sp<IBinder>& service,
+                                                  const std::string& name, bool allowIsolated,
+                                                  int dumpFlags) {
     auto manager = interface_cast<AidlServiceManager>(asBinder(defaultServiceManager()));
 
     bool reRegister = mRegisteredServices.count(name) > 0;
@@ -96,18 +155,31 @@ bool ClientCounterCallback::registerService(const sp<IBinder>& service, const st
 }
 
 void ClientCounterCallback::forcePersist(bool persist) {
+    std::lock_guard<std::mutex> lock(mMutex);
     mForcePersist = persist;
     if(!mForcePersist) {
         // Attempt a shutdown in case the number of clients hit 0 while the flag was on
-        tryShutdown();
+        maybeShutdownLocked();
     }
 }
 
+void ClientCounterCallback::setLingerPolicy(std::chrono::milliseconds minLinger,
+                                            std::chrono::milliseconds maxLinger) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLinger.setPolicy(minLinger, maxLinger);
+}
+
+void ClientCounterCallback::setShutdownCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mShutdownCallback = std::move(callback);
+}
+
 /**
- * onClients is oneway, so no need to worry about multi-threading. Note that this means multiple
- * invocations could occur on different threads however.
+ * onClients is oneway, but multiple invocations could occur on different threads, and the linger
+ * thread shuts down concurrently, so all the state is guarded by mMutex.
  */
 Status ClientCounterCallback::onClients(const sp<IBinder>& service, bool clients) {
+    std::lock_guard<std::mutex> lock(mMutex);
     if (clients) {
         mNumConnectedServices++;
     } else {
@@ -118,11 +190,21 @@ Status ClientCounterCallback::onClients(const sp<IBinder>& service, bool clients
           mNumConnectedServices, mRegisteredServices.size(),
           String8(service->getInterfaceDescriptor()).string(), clients);
 
-    tryShutdown();
+    if (mNumConnectedServices > 0 && mLinger.isIdle()) {
+        // A client came back while lingering: remember how long they stayed away.
+        mLinger.onClientsBack(Clock::now());
+        mShutdownDeadline.reset();
+    }
+
+    maybeShutdownLocked();
     return Status::ok();
 }
 
-void ClientCounterCallback::tryShutdown() {
+void ClientCounterCallback::maybeShutdownLocked() {
+    if (mShuttingDown) {
+        return;
+    }
+
     if(mNumConnectedServices > 0) {
         // Should only shut down if there are no clients
         return;
@@ -133,6 +215,48 @@ void ClientCounterCallback::tryShutdown() {
         return;
     }
 
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point deadline = mLinger.onIdle(now);
+    if (deadline <= now) {
+        tryShutdownLocked();
+        return;
+    }
+
+    mShutdownDeadline = deadline;
+    ALOGI("No clients in use for any service in process, lingering for %lld ms.",
+          static_cast<long long>(
+                  std::chrono::duration_cast<std::chrono::milliseconds>(mLinger.linger())
+                          .count()));
+
+    if (!mLingerThread.joinable()) {
+        mLingerThread = std::thread(&ClientCounterCallback::lingerThreadMain, this);
+    }
+    mLingerCondition.notify_all();
+}
+
+void ClientCounterCallback::lingerThreadMain() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mQuit) {
+        if (!mShutdownDeadline) {
+            mLingerCondition.wait(lock);
+            continue;
+        }
+        if (Clock::now() < *mShutdownDeadline) {
+            mLingerCondition.wait_until(lock, *mShutdownDeadline);
+            continue;
+        }
+
+        mShutdownDeadline.reset();
+        if (mNumConnectedServices == 0 && !mForcePersist && !mShuttingDown) {
+            tryShutdownLocked();
+        }
+        // Clients are back, or got hold of a service while it was being unregistered. Either way,
+        // lingering starts over the next time they leave.
+        mLinger.reset();
+    }
+}
+
+void ClientCounterCallback::tryShutdownLocked() {
     ALOGI("Trying to shut down the service. No clients in use for any service in process.");
 
     auto manager = interface_cast<AidlServiceManager>(asBinder(defaultServiceManager()));
@@ -151,6 +275,15 @@ void ClientCounterCallback::tryShutdown() {
     }
 
     if (unRegisterIt == mRegisteredServices.end()) {
+        // The callback may call back into the registrar, so it runs without mMutex. Nothing is
+        // re-registered meanwhile, since the process is going away. This never returns, so the
+        // caller's lock is not released a second time.
+        mShuttingDown = true;
+        std::function<void()> callback = mShutdownCallback;
+        mMutex.unlock();
+        if (callback) {
+            callback();
+        }
         ALOGI("Unregistered all clients and exiting");
         exit(EXIT_SUCCESS);
     }
@@ -160,8 +293,8 @@ void ClientCounterCallback::tryShutdown() {
         auto& entry = (*reRegisterIt);
 
         // re-register entry
-        if (!registerService(entry.second.service, entry.first, entry.second.allowIsolated,
-                             entry.second.dumpFlags)) {
+        if (!registerServiceLocked(entry.second.service, entry.first, entry.second.allowIsolated,
+                                   entry.second.dumpFlags)) {
             // Must restart. Otherwise, clients will never be able to get a hold of this service.
             ALOGE("Bad state: could not re-register services");
         }
@@ -191,5 +324,14 @@ void LazyServiceRegistrar::forcePersist(bool persist) {
     mClientCC->forcePersist(persist);
 }
 
+void LazyServiceRegistrar::setLingerPolicy(std::chrono::milliseconds minLinger,
+                                           std::chrono::milliseconds maxLinger) {
+    mClientCC->setLingerPolicy(minLinger, maxLinger);
+}
+
+void LazyServiceRegistrar::setShutdownCallback(std::function<void()> callback) {
+    mClientCC->setShutdownCallback(std::move(callback));
+}
+
 }  // namespace hardware
 }  // namespace android
\ No newline at end of file
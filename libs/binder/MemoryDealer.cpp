@@ -38,75 +38,11 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
-/*
- * A simple templatized doubly linked-list implementation
- */
-
-template <typename NODE>
-class LinkedList
-{
-    NODE*  mFirst;
-    NODE*  mLast;
-
-public:
-                LinkedList() : mFirst(nullptr), mLast(nullptr) { }
-    bool        isEmpty() const { return mFirst == nullptr; }
-    NODE const* head() const { return mFirst; }
-    NODE*       head() { return mFirst; }
-    NODE const* tail() const { return mLast; }
-    NODE*       tail() { return mLast; }
-
-    void insertAfter(NODE* node, NODE* newNode) {
-        newNode->prev = node;
-        newNode->next = node->next;
-        if (node->next == nullptr) mLast = newNode;
-        else                 node->next->prev = newNode;
-        node->next = newNode;
-    }
-
-    void insertBefore(NODE* node, NODE* newNode) {
-         newNode->prev = node->prev;
-         newNode->next = node;
-         if (node->prev == nullptr)   mFirst = newNode;
-         else                   node->prev->next = newNode;
-         node->prev = newNode;
-    }
-
-    void insertHead(NODE* newNode) {
-        if (mFirst == nullptr) {
-            mFirst = mLast = newNode;
-            newNode->prev = newNode->next = nullptr;
-        } else {
-            newNode->prev = nullptr;
-            newNode->next = mFirst;
-            mFirst->prev = newNode;
-            mFirst = newNode;
-        }
-    }
-
-    void insertTail(NODE* newNode) {
-        if (mLast == 0) {
-            insertHead(newNode);
-        } else {
-            newNode->prev = mLast;
-            newNode->next = 0;
-            mLast->next = newNode;
-            mLast = newNode;
-        }
-    }
-
-    NODE* remove(NODE* node) {
-        if (node->prev == nullptr)    mFirst = node->next;
-        else                    node->prev->next = node->next;
-        if (node->next == nullptr)    mLast = node->prev;
-        else                    node->next->prev = node->prev;
-        return node;
-    }
-};
-
 // ----------------------------------------------------------------------------
 
 class Allocation : public MemoryBase {
@@ -120,6 +56,14 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Despite its name, this is a segregated-fit allocator: free chunks are kept
+ * in one list per power-of-two size class, with a bitmap of the non-empty
+ * classes, so that allocating typically takes the head of the first large
+ * enough class rather than scanning every chunk. Chunks also stay linked in
+ * address order, so that a freed chunk merges with its free neighbours in
+ * constant time, and allocated chunks are indexed by offset for deallocate.
+ */
 class SimpleBestFitAllocator
 {
     enum {
@@ -139,25 +83,44 @@ public:
 
 private:
 
+    // Offsets and sizes are in units of kMemoryAlign.
     struct chunk_t {
         chunk_t(size_t start, size_t size)
-        : start(start), size(size), free(1), prev(nullptr), next(nullptr) {
+        : start(start), size(size), free(true) {
         }
-        size_t              start;
-        size_t              size : 28;
-        int                 free : 4;
-        mutable chunk_t*    prev;
-        mutable chunk_t*    next;
+        size_t      start;
+        size_t      size;
+        bool        free;
+        // Neighbours in address order.
+        chunk_t*    prev = nullptr;
+        chunk_t*    next = nullptr;
+        // Neighbours in the free list of the size class, while free.
+        chunk_t*    freePrev = nullptr;
+        chunk_t*    freeNext = nullptr;
     };
 
+    // One size class per bit of the chunk size.
+    static constexpr size_t kNumClasses = sizeof(size_t) * 8;
+
+    static size_t sizeClass(size_t size) {
+        return kNumClasses - 1 - __builtin_clzl(size);
+    }
+
     ssize_t  alloc(size_t size, uint32_t flags);
     chunk_t* dealloc(size_t start);
+    chunk_t* findFree(size_t size) const;
+    void     insertFree(chunk_t* chunk);
+    void     removeFree(chunk_t* chunk);
+    chunk_t* split(chunk_t* chunk, size_t size);
     void     dump_l(const char* what) const;
     void     dump_l(String8& res, const char* what) const;
 
     static const int    kMemoryAlign;
     mutable Mutex       mLock;
-    LinkedList<chunk_t> mList;
+    chunk_t*            mFirst;
+    chunk_t*            mFreeLists[kNumClasses] = {};
+    uint64_t            mNonEmptyClasses = 0;
+    std::unordered_map<size_t, chunk_t*> mAllocated;
     size_t              mHeapSize;
 };
 
@@ -282,22 +245,18 @@ SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
     size_t pagesize = getpagesize();
     mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
 
-    chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
-    mList.insertHead(node);
+    mFirst = new chunk_t(0, mHeapSize / kMemoryAlign);
+    if (mFirst->size) {
+        insertFree(mFirst);
+    }
 }
 
 SimpleBestFitAllocator::~SimpleBestFitAllocator()
 {
-    while(!mList.isEmpty()) {
-        chunk_t* removed = mList.remove(mList.head());
-#ifdef __clang_analyzer__
-        // Clang static analyzer gets confused in this loop
-        // and generates a false positive warning about accessing
-        // memory that is already freed.
-        // Add an "assert" to avoid the confusion.
-        LOG_ALWAYS_FATAL_IF(mList.head() == removed);
-#endif
-        delete removed;
+    while (mFirst) {
+        chunk_t* const next = mFirst->next;
+        delete mFirst;
+        mFirst = next;
     }
 }
 
@@ -323,102 +282,162 @@ status_t SimpleBestFitAllocator::deallocate(size_t offset)
     return NAME_NOT_FOUND;
 }
 
-ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
+void SimpleBestFitAllocator::insertFree(chunk_t* chunk)
 {
-    if (size == 0) {
-        return 0;
+    const size_t c = sizeClass(chunk->size);
+    chunk->free = true;
+    chunk->freePrev = nullptr;
+    chunk->freeNext = mFreeLists[c];
+    if (mFreeLists[c]) {
+        mFreeLists[c]->freePrev = chunk;
     }
-    size = (size + kMemoryAlign-1) / kMemoryAlign;
-    chunk_t* free_chunk = nullptr;
-    chunk_t* cur = mList.head();
+    mFreeLists[c] = chunk;
+    mNonEmptyClasses |= uint64_t(1) << c;
+}
 
-    size_t pagesize = getpagesize();
-    while (cur) {
-        int extra = 0;
-        if (flags & PAGE_ALIGNED)
-            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
-
-        // best fit
-        if (cur->free && (cur->size >= (size+extra))) {
-            if ((!free_chunk) || (cur->size < free_chunk->size)) {
-                free_chunk = cur;
-            }
+void SimpleBestFitAllocator::removeFree(chunk_t* chunk)
+{
+    const size_t c = sizeClass(chunk->size);
+    if (chunk->freePrev) {
+        chunk->freePrev->freeNext = chunk->freeNext;
+    } else {
+        mFreeLists[c] = chunk->freeNext;
+        if (!mFreeLists[c]) {
+            mNonEmptyClasses &= ~(uint64_t(1) << c);
+        }
+    }
+    if (chunk->freeNext) {
+        chunk->freeNext->freePrev = chunk->freePrev;
+    }
+    chunk->free = false;
+    chunk->freePrev = chunk->freeNext = nullptr;
+}
+
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::findFree(size_t size) const
+{
+    // Chunks of the class of 'size' may be too small, so look for the best fit
+    // there, with a bounded scan so that a long list can't make this linear.
+    constexpr int kMaxScan = 8;
+    const size_t c = sizeClass(size);
+    chunk_t* best = nullptr;
+    int scanned = 0;
+    for (chunk_t* cur = mFreeLists[c]; cur && scanned < kMaxScan;
+            cur = cur->freeNext, scanned++) {
+        if (cur->size >= size && (!best || cur->size < best->size)) {
+            best = cur;
             if (cur->size == size) {
                 break;
             }
         }
-        cur = cur->next;
+    }
+    if (best) {
+        return best;
     }
 
-    if (free_chunk) {
-        const size_t free_size = free_chunk->size;
-        free_chunk->free = 0;
-        free_chunk->size = size;
-        if (free_size > size) {
-            int extra = 0;
-            if (flags & PAGE_ALIGNED)
-                extra = ( -free_chunk->start & ((pagesize/kMemoryAlign)-1) ) ;
-            if (extra) {
-                chunk_t* split = new chunk_t(free_chunk->start, extra);
-                free_chunk->start += extra;
-                mList.insertBefore(free_chunk, split);
-            }
+    // Any chunk of a larger class fits; take one from the smallest.
+    const uint64_t larger = c + 1 < kNumClasses ? mNonEmptyClasses >> (c + 1) : 0;
+    if (larger) {
+        return mFreeLists[c + 1 + __builtin_ctzll(larger)];
+    }
 
-            ALOGE_IF((flags&PAGE_ALIGNED) && 
-                    ((free_chunk->start*kMemoryAlign)&(pagesize-1)),
-                    "PAGE_ALIGNED requested, but page is not aligned!!!");
+    // Whatever the scan above didn't reach in the class of 'size'.
+    for (chunk_t* cur = mFreeLists[c]; cur; cur = cur->freeNext) {
+        if (cur->size >= size && (!best || cur->size < best->size)) {
+            best = cur;
+        }
+    }
+    return best;
+}
 
-            const ssize_t tail_free = free_size - (size+extra);
-            if (tail_free > 0) {
-                chunk_t* split = new chunk_t(
-                        free_chunk->start + free_chunk->size, tail_free);
-                mList.insertAfter(free_chunk, split);
-            }
+// Splits the free, but unlisted, 'chunk' after its first 'size' units and
+// returns the tail, which is put back on the free lists.
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::split(chunk_t* chunk, size_t size)
+{
+    chunk_t* tail = new chunk_t(chunk->start + size, chunk->size - size);
+    chunk->size = size;
+    tail->prev = chunk;
+    tail->next = chunk->next;
+    if (chunk->next) {
+        chunk->next->prev = tail;
+    }
+    chunk->next = tail;
+    insertFree(tail);
+    return tail;
+}
+
+ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
+{
+    if (size == 0) {
+        return 0;
+    }
+    size = (size + kMemoryAlign-1) / kMemoryAlign;
+
+    // Page aligned requests reserve enough to align whichever chunk they get.
+    const size_t pageUnits = getpagesize() / kMemoryAlign;
+    const size_t maxExtra = (flags & PAGE_ALIGNED) ? pageUnits - 1 : 0;
+
+    chunk_t* chunk = findFree(size + maxExtra);
+    if (!chunk) {
+        return NO_MEMORY;
+    }
+    removeFree(chunk);
+
+    if (flags & PAGE_ALIGNED) {
+        const size_t extra = -chunk->start & (pageUnits - 1);
+        if (extra) {
+            // Give the unaligned head back and allocate from the aligned rest.
+            chunk_t* const head = chunk;
+            chunk = split(head, extra);
+            removeFree(chunk);
+            insertFree(head);
         }
-        return (free_chunk->start)*kMemoryAlign;
+        ALOGE_IF((chunk->start*kMemoryAlign) & (pageUnits*kMemoryAlign - 1),
+                "PAGE_ALIGNED requested, but page is not aligned!!!");
+    }
+
+    if (chunk->size > size) {
+        split(chunk, size);
     }
-    return NO_MEMORY;
+    chunk->free = false;
+    mAllocated.emplace(chunk->start, chunk);
+    return (chunk->start)*kMemoryAlign;
 }
 
 SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
 {
     start = start / kMemoryAlign;
-    chunk_t* cur = mList.head();
-    while (cur) {
-        if (cur->start == start) {
-            LOG_FATAL_IF(cur->free,
-                "block at offset 0x%08lX of size 0x%08lX already freed",
-                cur->start*kMemoryAlign, cur->size*kMemoryAlign);
-
-            // merge freed blocks together
-            chunk_t* freed = cur;
-            cur->free = 1;
-            do {
-                chunk_t* const p = cur->prev;
-                chunk_t* const n = cur->next;
-                if (p && (p->free || !cur->size)) {
-                    freed = p;
-                    p->size += cur->size;
-                    mList.remove(cur);
-                    delete cur;
-                }
-                cur = n;
-            } while (cur && cur->free);
-
-            #ifndef NDEBUG
-                if (!freed->free) {
-                    dump_l("dealloc (!freed->free)");
-                }
-            #endif
-            LOG_FATAL_IF(!freed->free,
-                "freed block at offset 0x%08lX of size 0x%08lX is not free!",
-                freed->start * kMemoryAlign, freed->size * kMemoryAlign);
-
-            return freed;
+    auto it = mAllocated.find(start);
+    if (it == mAllocated.end()) {
+        return nullptr;
+    }
+    chunk_t* freed = it->second;
+    mAllocated.erase(it);
+    LOG_FATAL_IF(freed->free,
+            "block at offset 0x%08lX of size 0x%08lX already freed",
+            freed->start*kMemoryAlign, freed->size*kMemoryAlign);
+
+    // merge freed blocks together
+    if (chunk_t* const n = freed->next; n && n->free) {
+        removeFree(n);
+        freed->size += n->size;
+        freed->next = n->next;
+        if (n->next) {
+            n->next->prev = freed;
         }
-        cur = cur->next;
+        delete n;
+    }
+    if (chunk_t* const p = freed->prev; p && p->free) {
+        removeFree(p);
+        p->size += freed->size;
+        p->next = freed->next;
+        if (freed->next) {
+            freed->next->prev = p;
+        }
+        delete freed;
+        freed = p;
     }
-    return nullptr;
+    insertFree(freed);
+    return freed;
 }
 
 void SimpleBestFitAllocator::dump(const char* what) const
@@ -446,7 +465,7 @@ void SimpleBestFitAllocator::dump_l(String8& result,
 {
     size_t size = 0;
     int32_t i = 0;
-    chunk_t const* cur = mList.head();
+    chunk_t const* cur = mFirst;
     
     const size_t SIZE = 256;
     char buffer[SIZE];
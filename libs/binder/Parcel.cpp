@@ -80,12 +80,104 @@ static_assert(sizeof(Parcel) == 60 || sizeof(Parcel) == 120);
 
 static std::atomic<size_t> gParcelGlobalAllocCount;
 static std::atomic<size_t> gParcelGlobalAllocSize;
+static std::atomic<size_t> gParcelGlobalPoolHitCount;
+static std::atomic<size_t> gParcelGlobalPoolMissCount;
 
 static size_t gMaxFds = 0;
 
 // Maximum size of a blob to transfer in-place.
 static const size_t BLOB_INPLACE_LIMIT = 16 * 1024;
 
+// Writes at least this large are treated as bulk segments: the buffer is
+// grown once to fit them exactly instead of scaling the payload by the usual
+// growth factor, which would otherwise over-allocate (and later realloc-move)
+// large byte arrays and in-place blobs.
+static const size_t BULK_SEGMENT_THRESHOLD = 4 * 1024;
+
+// Per-thread cache of Parcel data buffers. Binder threads construct and
+// destroy a reply Parcel for every transaction they handle or issue; keeping
+// a few recently freed buffers around lets steady-state calls reuse them
+// instead of going back to malloc/free.
+class ParcelBufferPool {
+public:
+    static constexpr size_t kMaxBuffers = 4;
+    // Buffers larger than this are returned to the allocator.
+    static constexpr size_t kMaxPooledCapacity = 64 * 1024;
+
+    ~ParcelBufferPool() {
+        for (size_t i = 0; i < mCount; i++) {
+            free(mBuffers[i].data);
+        }
+        mCount = 0;
+        sDestroyed = true;
+    }
+
+    static ParcelBufferPool* self() {
+        if (sDestroyed) return nullptr;
+        static thread_local ParcelBufferPool pool;
+        return &pool;
+    }
+
+    // Returns a buffer of at least 'desired' bytes, or nullptr if the
+    // caller should allocate one itself. When nullptr is returned,
+    // *outCapacity holds the size worth allocating so that the buffer is
+    // reusable by the next calls of similar size.
+    uint8_t* acquire(size_t desired, size_t* outCapacity) {
+        // Decay the watermark so that one large transaction doesn't pin
+        // oversized allocations forever.
+        mHighWater = std::max(desired, mHighWater - mHighWater / 8);
+        for (size_t i = mCount; i > 0; i--) {
+            if (mBuffers[i-1].capacity >= desired) {
+                uint8_t* data = mBuffers[i-1].data;
+                *outCapacity = mBuffers[i-1].capacity;
+                mBuffers[i-1] = mBuffers[--mCount];
+                gParcelGlobalPoolHitCount++;
+                return data;
+            }
+        }
+        gParcelGlobalPoolMissCount++;
+        *outCapacity = desired <= kMaxPooledCapacity
+                ? std::min(std::max(desired, mHighWater), kMaxPooledCapacity)
+                : desired;
+        return nullptr;
+    }
+
+    // Takes ownership of 'data' if it can be cached; returns false if the
+    // caller must free it.
+    bool release(uint8_t* data, size_t capacity) {
+        if (capacity > kMaxPooledCapacity || capacity < mHighWater / 4) return false;
+        if (mCount == kMaxBuffers) {
+            // Replace the smallest cached buffer if this one is bigger.
+            size_t smallest = 0;
+            for (size_t i = 1; i < mCount; i++) {
+                if (mBuffers[i].capacity < mBuffers[smallest].capacity) smallest = i;
+            }
+            if (mBuffers[smallest].capacity >= capacity) return false;
+            free(mBuffers[smallest].data);
+            mBuffers[smallest] = {data, capacity};
+            return true;
+        }
+        mBuffers[mCount++] = {data, capacity};
+        return true;
+    }
+
+private:
+    struct Buffer {
+        uint8_t* data;
+        size_t capacity;
+    };
+
+    Buffer mBuffers[kMaxBuffers] = {};
+    size_t mCount = 0;
+    size_t mHighWater = 0;
+
+    // Set once this thread's pool is torn down, so Parcels destroyed later
+    // during thread exit fall back to plain free().
+    static thread_local bool sDestroyed;
+};
+
+thread_local bool ParcelBufferPool::sDestroyed = false;
+
 enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
@@ -282,6 +374,14 @@ size_t Parcel::getGlobalAllocCount() {
     return gParcelGlobalAllocCount.load();
 }
 
+size_t Parcel::getGlobalPoolHitCount() {
+    return gParcelGlobalPoolHitCount.load();
+}
+
+size_t Parcel::getGlobalPoolMissCount() {
+    return gParcelGlobalPoolMissCount.load();
+}
+
 const uint8_t* Parcel::data() const
 {
     return mData;
@@ -522,13 +622,32 @@ constexpr int32_t kHeader = B_PACK_CHARS('S', 'Y', 'S', 'T');
 status_t Parcel::writeInterfaceToken(const String16& interface)
 {
     const IPCThreadState* threadState = IPCThreadState::self();
-    writeInt32(threadState->getStrictModePolicy() | STRICT_MODE_PENALTY_GATHER);
-    updateWorkSourceRequestHeaderPosition();
-    writeInt32(threadState->shouldPropagateWorkSource() ?
-            threadState->getCallingWorkSourceUid() : IPCThreadState::kUnsetWorkSource);
-    writeInt32(kHeader);
-    // currently the interface identification token is just its name as a string
-    return writeString16(interface);
+    // The request header and the descriptor are written with a single
+    // reservation; this is on the path of every AIDL call.
+    const size_t len = interface.size();
+    const size_t headerSize = 4 * sizeof(int32_t);
+    const size_t stringSize = (len + 1) * sizeof(char16_t);
+    const size_t start = dataPosition();
+    uint8_t* data = reinterpret_cast<uint8_t*>(writeInplace(headerSize + stringSize));
+    if (!data) return mError != NO_ERROR ? mError : NO_MEMORY;
+    if (!mRequestHeaderPresent) {
+        // See updateWorkSourceRequestHeaderPosition(); the work source
+        // follows the strict mode policy.
+        mWorkSourceRequestHeaderPosition = start + sizeof(int32_t);
+        mRequestHeaderPresent = true;
+    }
+    const int32_t header[4] = {
+        threadState->getStrictModePolicy() | STRICT_MODE_PENALTY_GATHER,
+        threadState->shouldPropagateWorkSource() ?
+                threadState->getCallingWorkSourceUid() : IPCThreadState::kUnsetWorkSource,
+        kHeader,
+        // currently the interface identification token is just its name as a string
+        static_cast<int32_t>(len),
+    };
+    memcpy(data, header, headerSize);
+    memcpy(data + headerSize, interface.string(), len * sizeof(char16_t));
+    *reinterpret_cast<char16_t*>(data + headerSize + len * sizeof(char16_t)) = 0;
+    return NO_ERROR;
 }
 
 bool Parcel::replaceCallingWorkSourceUid(uid_t uid)
@@ -768,7 +887,14 @@ status_t Parcel::writeByteVectorInternal(const int8_t* data, size_t size) {
         return BAD_VALUE;
     }
 
-    status_t status = writeInt32(size);
+    // Reserve the length prefix and the padded payload in a single step so
+    // that large vectors cause at most one reallocation of mData.
+    status_t status = reserveBulkSegment(sizeof(int32_t) + pad_size(size));
+    if (status != OK) {
+        return status;
+    }
+
+    status = writeInt32(size);
     if (status != OK) {
         return status;
     }
@@ -1172,6 +1298,9 @@ status_t Parcel::writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
     status_t status;
     if (!mAllowFds || len <= BLOB_INPLACE_LIMIT) {
         ALOGV("writeBlob: write in place");
+        status = reserveBulkSegment(sizeof(int32_t) + pad_size(len));
+        if (status) return status;
+
         status = writeInt32(BLOB_INPLACE);
         if (status) return status;
 
@@ -1800,6 +1929,22 @@ status_t Parcel::readUtf8FromUtf16(std::string* str) const {
        return NO_ERROR;
     }
 
+    // Package names, interface descriptors and most other strings sent over
+    // binder are ASCII, which converts to UTF-8 by plain narrowing. Both
+    // loops are branch free so the compiler can vectorize them.
+    char16_t bits = 0;
+    for (size_t i = 0; i < utf16Size; i++) {
+        bits |= src[i];
+    }
+    if (bits < 0x80) {
+        str->resize(utf16Size);
+        char* dst = &((*str)[0]);
+        for (size_t i = 0; i < utf16Size; i++) {
+            dst[i] = static_cast<char>(src[i]);
+        }
+        return NO_ERROR;
+    }
+
     // Allow for closing '\0'
     ssize_t utf8Size = utf16_to_utf8_length(src, utf16Size) + 1;
     if (utf8Size < 1) {
@@ -1942,6 +2087,18 @@ const char16_t* Parcel::readString16Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString16View(std::u16string_view* str) const
+{
+    size_t len;
+    const char16_t* data = readString16Inplace(&len);
+    if (!data) {
+        *str = std::u16string_view();
+        return UNEXPECTED_NULL;
+    }
+    *str = std::u16string_view(data, len);
+    return NO_ERROR;
+}
+
 status_t Parcel::readStrongBinder(sp<IBinder>* val) const
 {
     status_t status = readNullableStrongBinder(val);
@@ -2414,7 +2571,10 @@ void Parcel::freeDataNoInit()
             LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, mDataCapacity);
             gParcelGlobalAllocSize -= mDataCapacity;
             gParcelGlobalAllocCount--;
-            free(mData);
+            ParcelBufferPool* pool = ParcelBufferPool::self();
+            if (!pool || !pool->release(mData, mDataCapacity)) {
+                free(mData);
+            }
         }
         if (mObjects) free(mObjects);
     }
@@ -2430,12 +2590,30 @@ status_t Parcel::growData(size_t len)
 
     if (len > SIZE_MAX - mDataSize) return NO_MEMORY; // overflow
     if (mDataSize + len > SIZE_MAX / 3) return NO_MEMORY; // overflow
-    size_t newSize = ((mDataSize+len)*3)/2;
+    size_t newSize;
+    if (len >= BULK_SEGMENT_THRESHOLD) {
+        // Keep the amortized headroom for the existing data, but don't scale
+        // a bulk segment by the growth factor.
+        newSize = (mDataSize*3)/2 + len;
+    } else {
+        newSize = ((mDataSize+len)*3)/2;
+    }
     return (newSize <= mDataSize)
             ? (status_t) NO_MEMORY
             : continueWrite(newSize);
 }
 
+status_t Parcel::reserveBulkSegment(size_t len)
+{
+    if (len < BULK_SEGMENT_THRESHOLD) return NO_ERROR;
+    if (len > INT32_MAX) return BAD_VALUE;
+    if (len > SIZE_MAX - mDataPos) return NO_MEMORY; // overflow
+    if (mDataPos + len <= mDataCapacity) return NO_ERROR;
+    // growData() sizes the new buffer relative to mDataSize, which may be
+    // ahead of the write position.
+    return growData(mDataPos + len - mDataSize);
+}
+
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2625,11 +2803,21 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        ParcelBufferPool* pool = ParcelBufferPool::self();
+        size_t capacity = desired;
+        uint8_t* data = pool ? pool->acquire(desired, &capacity) : nullptr;
+        if (!data) {
+            data = (uint8_t*)malloc(capacity);
+            if (!data && capacity > desired) {
+                capacity = desired;
+                data = (uint8_t*)malloc(capacity);
+            }
+        }
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
         }
+        desired = capacity;
 
         if(!(mDataCapacity == 0 && mObjects == nullptr
              && mObjectsCapacity == 0)) {
@@ -19,6 +19,7 @@
 #include <binder/PersistableBundle.h>
 
 #include <limits>
+#include <mutex>
 
 #include <binder/IBinder.h>
 #include <binder/Parcel.h>
@@ -87,6 +88,136 @@ namespace os {
          }                                                               \
     }
 
+namespace {
+
+// Moves past one value of |type|, without decoding it. Values that readFromParcelInner() would
+// reject, such as null arrays or null strings in string arrays, are rejected here as well, so
+// that a bundle reads the same lazily and eagerly.
+status_t skipValue(const Parcel& parcel, int32_t type) {
+    const auto skipArray = [&parcel](size_t elementSize) -> status_t {
+        int32_t count;
+        RETURN_IF_FAILED(parcel.readInt32(&count));
+        if (count < 0) return UNEXPECTED_NULL;
+        if (count == 0) return NO_ERROR;
+        if (static_cast<size_t>(count) > parcel.dataAvail() / elementSize) return BAD_VALUE;
+        return parcel.readInplace(count * elementSize) ? NO_ERROR : BAD_VALUE;
+    };
+    size_t length;
+    switch (type) {
+        case VAL_STRING:
+            return parcel.readString16Inplace(&length) ? NO_ERROR : UNEXPECTED_NULL;
+        case VAL_INTEGER:
+        case VAL_BOOLEAN:
+            return parcel.readInplace(sizeof(int32_t)) ? NO_ERROR : BAD_VALUE;
+        case VAL_LONG:
+        case VAL_DOUBLE:
+            return parcel.readInplace(sizeof(int64_t)) ? NO_ERROR : BAD_VALUE;
+        case VAL_INTARRAY:
+        case VAL_BOOLEANARRAY:
+            // Booleans are parceled as int32.
+            return skipArray(sizeof(int32_t));
+        case VAL_LONGARRAY:
+        case VAL_DOUBLEARRAY:
+            return skipArray(sizeof(int64_t));
+        case VAL_STRINGARRAY: {
+            int32_t count;
+            RETURN_IF_FAILED(parcel.readInt32(&count));
+            if (count < 0) return UNEXPECTED_NULL;
+            for (; count > 0; --count) {
+                int32_t stringLength;
+                RETURN_IF_FAILED(parcel.readInt32(&stringLength));
+                if (stringLength == -1) return UNEXPECTED_NULL;
+                if (stringLength < 0 || stringLength == std::numeric_limits<int32_t>::max() ||
+                    !parcel.readInplace((static_cast<size_t>(stringLength) + 1) *
+                                        sizeof(char16_t))) {
+                    return BAD_VALUE;
+                }
+            }
+            return NO_ERROR;
+        }
+        case VAL_PERSISTABLEBUNDLE: {
+            // The length covers the entries, which follow the magic.
+            int32_t bundleLength;
+            RETURN_IF_FAILED(parcel.readInt32(&bundleLength));
+            if (bundleLength < 0) return UNEXPECTED_NULL;
+            if (bundleLength == 0) return NO_ERROR;
+            const size_t skipped = sizeof(int32_t) + static_cast<size_t>(bundleLength);
+            if (skipped > parcel.dataAvail()) return BAD_VALUE;
+            parcel.setDataPosition(parcel.dataPosition() + skipped);
+            return NO_ERROR;
+        }
+        default:
+            ALOGE("Unrecognized type: %d", type);
+            return BAD_TYPE;
+    }
+}
+
+}  // namespace
+
+/*
+ * The bytes of a lazily read bundle, from its magic on, and the index of its entries once it was
+ * built. Reading moves the position of the parcel, so all accesses are serialized by |lock|.
+ */
+struct PersistableBundle::LazyEntries {
+    struct Entry {
+        int32_t type;
+        size_t position;  // of the value
+    };
+
+    std::mutex lock;
+    Parcel parcel;
+    bool indexed = false;
+    std::map<String16, Entry> index;
+
+    const std::map<String16, Entry>& getIndexLocked() {
+        if (indexed) return index;
+        indexed = true;
+
+        parcel.setDataPosition(sizeof(int32_t));  // past the magic
+        int32_t num_entries;
+        status_t status = parcel.readInt32(&num_entries);
+        for (; status == NO_ERROR && num_entries > 0; --num_entries) {
+            String16 key;
+            int32_t value_type;
+            if ((status = parcel.readString16(&key)) != NO_ERROR ||
+                (status = parcel.readInt32(&value_type)) != NO_ERROR) {
+                break;
+            }
+            index[key] = {value_type, parcel.dataPosition()};
+            status = skipValue(parcel, value_type);
+        }
+        if (status != NO_ERROR) {
+            ALOGE("Malformed PersistableBundle, reading it as empty: %d", status);
+            index.clear();
+        }
+        return index;
+    }
+
+    template <typename Read>
+    bool get(const String16& key, int32_t type, Read read) {
+        std::lock_guard<std::mutex> guard(lock);
+        const auto& entries = getIndexLocked();
+        const auto it = entries.find(key);
+        if (it == entries.end() || it->second.type != type) return false;
+        parcel.setDataPosition(it->second.position);
+        return read(parcel) == NO_ERROR;
+    }
+
+    set<String16> getKeys(int32_t type) {
+        std::lock_guard<std::mutex> guard(lock);
+        set<String16> keys;
+        for (const auto& [key, entry] : getIndexLocked()) {
+            if (entry.type == type) keys.emplace(key);
+        }
+        return keys;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> guard(lock);
+        return getIndexLocked().size();
+    }
+};
+
 status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
     /*
      * Keep implementation in sync with writeToParcelInner() in
@@ -99,6 +230,14 @@ status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
         return NO_ERROR;
     }
 
+    if (mLazy) {
+        // Pass the bytes through as they were read.
+        std::lock_guard<std::mutex> guard(mLazy->lock);
+        const size_t length = mLazy->parcel.dataSize() - sizeof(int32_t);  // past the magic
+        RETURN_IF_FAILED(parcel->writeInt32(static_cast<int32_t>(length)));
+        return parcel->appendFrom(&mLazy->parcel, 0, mLazy->parcel.dataSize());
+    }
+
     size_t length_pos = parcel->dataPosition();
     RETURN_IF_FAILED(parcel->writeInt32(1));  // dummy, will hold length
     RETURN_IF_FAILED(parcel->writeInt32(BUNDLE_MAGIC_NATIVE));
@@ -124,6 +263,8 @@ status_t PersistableBundle::readFromParcel(const Parcel* parcel) {
      * Keep implementation in sync with readFromParcelInner() in
      * frameworks/base/core/java/android/os/BaseBundle.java.
      */
+    unparcel();
+
     int32_t length = parcel->readInt32();
     if (length < 0) {
         ALOGE("Bad length in parcel: %d", length);
@@ -133,11 +274,62 @@ status_t PersistableBundle::readFromParcel(const Parcel* parcel) {
     return readFromParcelInner(parcel, static_cast<size_t>(length));
 }
 
+status_t PersistableBundle::readFromParcelLazily(const Parcel* parcel) {
+    *this = PersistableBundle();
+
+    int32_t length = parcel->readInt32();
+    if (length < 0) {
+        ALOGE("Bad length in parcel: %d", length);
+        return UNEXPECTED_NULL;
+    }
+    if (length == 0) {
+        // Empty PersistableBundle or end of data.
+        return NO_ERROR;
+    }
+
+    // The length covers the entries, which follow the magic.
+    const size_t start = parcel->dataPosition();
+    const size_t size = sizeof(int32_t) + static_cast<size_t>(length);
+    auto lazy = std::make_shared<LazyEntries>();
+    RETURN_IF_FAILED(lazy->parcel.appendFrom(parcel, start, size));
+
+    lazy->parcel.setDataPosition(0);
+    int32_t magic;
+    RETURN_IF_FAILED(lazy->parcel.readInt32(&magic));
+    if (magic != BUNDLE_MAGIC && magic != BUNDLE_MAGIC_NATIVE) {
+        ALOGE("Bad magic number for PersistableBundle: 0x%08x", magic);
+        return BAD_VALUE;
+    }
+
+    parcel->setDataPosition(start + size);
+    mLazy = std::move(lazy);
+    return NO_ERROR;
+}
+
+void PersistableBundle::unparcel() {
+    if (!mLazy) return;
+    std::shared_ptr<LazyEntries> lazy = std::move(mLazy);
+
+    std::lock_guard<std::mutex> guard(lazy->lock);
+    lazy->parcel.setDataPosition(0);
+    if (readFromParcelInner(&lazy->parcel, lazy->parcel.dataSize()) != NO_ERROR) {
+        ALOGE("Malformed PersistableBundle, reading it as empty");
+        *this = PersistableBundle();
+    }
+}
+
+PersistableBundle PersistableBundle::decoded() const {
+    PersistableBundle bundle(*this);
+    bundle.unparcel();
+    return bundle;
+}
+
 bool PersistableBundle::empty() const {
     return size() == 0u;
 }
 
 size_t PersistableBundle::size() const {
+    if (mLazy) return mLazy->size();
     return (mBoolMap.size() +
             mIntMap.size() +
             mLongMap.size() +
@@ -152,6 +344,7 @@ size_t PersistableBundle::size() const {
 }
 
 size_t PersistableBundle::erase(const String16& key) {
+    unparcel();
     RETURN_IF_ENTRY_ERASED(mBoolMap, key);
     RETURN_IF_ENTRY_ERASED(mIntMap, key);
     RETURN_IF_ENTRY_ERASED(mLongMap, key);
@@ -221,90 +414,134 @@ void PersistableBundle::putPersistableBundle(const String16& key, const Persista
 }
 
 bool PersistableBundle::getBoolean(const String16& key, bool* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_BOOLEAN, [out](const Parcel& p) { return p.readBool(out); });
+    }
     return getValue(key, out, mBoolMap);
 }
 
 bool PersistableBundle::getInt(const String16& key, int32_t* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_INTEGER, [out](const Parcel& p) { return p.readInt32(out); });
+    }
     return getValue(key, out, mIntMap);
 }
 
 bool PersistableBundle::getLong(const String16& key, int64_t* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_LONG, [out](const Parcel& p) { return p.readInt64(out); });
+    }
     return getValue(key, out, mLongMap);
 }
 
 bool PersistableBundle::getDouble(const String16& key, double* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_DOUBLE, [out](const Parcel& p) { return p.readDouble(out); });
+    }
     return getValue(key, out, mDoubleMap);
 }
 
 bool PersistableBundle::getString(const String16& key, String16* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_STRING, [out](const Parcel& p) { return p.readString16(out); });
+    }
     return getValue(key, out, mStringMap);
 }
 
 bool PersistableBundle::getBooleanVector(const String16& key, vector<bool>* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_BOOLEANARRAY, [out](const Parcel& p) { return p.readBoolVector(out); });
+    }
     return getValue(key, out, mBoolVectorMap);
 }
 
 bool PersistableBundle::getIntVector(const String16& key, vector<int32_t>* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_INTARRAY, [out](const Parcel& p) { return p.readInt32Vector(out); });
+    }
     return getValue(key, out, mIntVectorMap);
 }
 
 bool PersistableBundle::getLongVector(const String16& key, vector<int64_t>* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_LONGARRAY, [out](const Parcel& p) { return p.readInt64Vector(out); });
+    }
     return getValue(key, out, mLongVectorMap);
 }
 
 bool PersistableBundle::getDoubleVector(const String16& key, vector<double>* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_DOUBLEARRAY, [out](const Parcel& p) { return p.readDoubleVector(out); });
+    }
     return getValue(key, out, mDoubleVectorMap);
 }
 
 bool PersistableBundle::getStringVector(const String16& key, vector<String16>* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_STRINGARRAY, [out](const Parcel& p) { return p.readString16Vector(out); });
+    }
     return getValue(key, out, mStringVectorMap);
 }
 
 bool PersistableBundle::getPersistableBundle(const String16& key, PersistableBundle* out) const {
+    if (mLazy) {
+        return mLazy->get(key, VAL_PERSISTABLEBUNDLE, [out](const Parcel& p) { return out->readFromParcelLazily(&p); });
+    }
     return getValue(key, out, mPersistableBundleMap);
 }
 
 set<String16> PersistableBundle::getBooleanKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_BOOLEAN);
     return getKeys(mBoolMap);
 }
 
 set<String16> PersistableBundle::getIntKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_INTEGER);
     return getKeys(mIntMap);
 }
 
 set<String16> PersistableBundle::getLongKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_LONG);
     return getKeys(mLongMap);
 }
 
 set<String16> PersistableBundle::getDoubleKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_DOUBLE);
     return getKeys(mDoubleMap);
 }
 
 set<String16> PersistableBundle::getStringKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_STRING);
     return getKeys(mStringMap);
 }
 
 set<String16> PersistableBundle::getBooleanVectorKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_BOOLEANARRAY);
     return getKeys(mBoolVectorMap);
 }
 
 set<String16> PersistableBundle::getIntVectorKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_INTARRAY);
     return getKeys(mIntVectorMap);
 }
 
 set<String16> PersistableBundle::getLongVectorKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_LONGARRAY);
     return getKeys(mLongVectorMap);
 }
 
 set<String16> PersistableBundle::getDoubleVectorKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_DOUBLEARRAY);
     return getKeys(mDoubleVectorMap);
 }
 
 set<String16> PersistableBundle::getStringVectorKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_STRINGARRAY);
     return getKeys(mStringVectorMap);
 }
 
 set<String16> PersistableBundle::getPersistableBundleKeys() const {
+    if (mLazy) return mLazy->getKeys(VAL_PERSISTABLEBUNDLE);
     return getKeys(mPersistableBundleMap);
 }
 
@@ -29,7 +29,9 @@
 
 #include <private/binder/binder_module.h>
 #include "Static.h"
+#include "TransactionStats.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -132,6 +134,12 @@ void ProcessState::startThreadPool()
     }
 }
 
+bool ProcessState::isThreadPoolStarted() const
+{
+    AutoMutex _l(mLock);
+    return mThreadPoolStarted;
+}
+
 bool ProcessState::becomeContextManager(context_check_func checkFunc, void* userData)
 {
     AutoMutex _l(mLock);
@@ -223,32 +231,51 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
-ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
+void ProcessState::setTransactionStatsEnabled(bool enabled) {
+    TransactionStats::setEnabled(enabled);
+}
+
+void ProcessState::resetTransactionStats() {
+    TransactionStats::reset();
+}
+
+String8 ProcessState::dumpTransactionStats() {
+    return TransactionStats::dump();
+}
+
+ProcessState::handle_shard& ProcessState::shardForHandle(int32_t handle)
+{
+    return mHandleShards[(size_t)handle % kHandleShards];
+}
+
+ProcessState::handle_entry* ProcessState::lookupHandleLocked(handle_shard& shard, int32_t handle)
 {
-    const size_t N=mHandleToObject.size();
-    if (N <= (size_t)handle) {
+    const size_t index = (size_t)handle / kHandleShards;
+    const size_t N=shard.entries.size();
+    if (N <= index) {
         handle_entry e;
         e.binder = nullptr;
         e.refs = nullptr;
-        status_t err = mHandleToObject.insertAt(e, N, handle+1-N);
+        status_t err = shard.entries.insertAt(e, N, index+1-N);
         if (err < NO_ERROR) return nullptr;
     }
-    return &mHandleToObject.editItemAt(handle);
+    return &shard.entries.editItemAt(index);
 }
 
 sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 {
     sp<IBinder> result;
 
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     if (e != nullptr) {
         // We need to create a new BpBinder if there isn't currently one, OR we
         // are unable to acquire a weak reference on this current one.  The
         // attemptIncWeak() is safe because we know the BpBinder destructor will always
-        // call expungeHandle(), which acquires the same lock we are holding now.
+        // call expungeHandle(), which acquires the same shard lock we are holding now.
         // We need to do this because there is a race condition between someone
         // releasing a reference on this BpBinder, and a new reference on its handle
         // arriving from the driver.
@@ -299,9 +326,10 @@ sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 
 void ProcessState::expungeHandle(int32_t handle, IBinder* binder)
 {
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     // This handle may have already been replaced with a new BpBinder
     // (if someone failed the AttemptIncWeak() above); we don't want
@@ -329,15 +357,47 @@ void ProcessState::spawnPooledThread(bool isMain)
 
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     status_t result = NO_ERROR;
+    pthread_mutex_lock(&mThreadCountLock);
     if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
         mMaxThreads = maxThreads;
+        mMaxThreadsCeiling = 0;
     } else {
         result = -errno;
         ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+status_t ProcessState::setThreadPoolAdaptiveMaxThreadCount(size_t initialThreads,
+                                                           size_t ceilingThreads) {
+    if (initialThreads > ceilingThreads) return BAD_VALUE;
+    status_t result = setThreadPoolMaxThreadCount(initialThreads);
+    if (result == NO_ERROR) {
+        pthread_mutex_lock(&mThreadCountLock);
+        mMaxThreadsCeiling = ceilingThreads;
+        pthread_mutex_unlock(&mThreadCountLock);
+    }
+    return result;
+}
+
+void ProcessState::maybeGrowThreadPoolLocked() {
+    if (mMaxThreads >= mMaxThreadsCeiling) return;
+    // Keep one thread in reserve for the next incoming command.
+    if (mExecutingThreadsCount + 1 < mMaxThreads) return;
+
+    size_t maxThreads = std::min(mMaxThreadsCeiling,
+                                 mMaxThreads + std::max<size_t>(1, mMaxThreads / 2));
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+        ALOGV("Growing binder thread pool from %zu to %zu threads", mMaxThreads, maxThreads);
+        mMaxThreads = maxThreads;
+    } else {
+        ALOGE("Binder ioctl to grow max threads failed: %s", strerror(errno));
+        // Don't retry on every transaction.
+        mMaxThreadsCeiling = mMaxThreads;
+    }
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -383,6 +443,7 @@ ProcessState::ProcessState(const char *driver)
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mMaxThreadsCeiling(0)
     , mBinderContextCheckFunc(nullptr)
     , mBinderContextUserData(nullptr)
     , mThreadPoolStarted(false)
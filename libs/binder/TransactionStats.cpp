@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include "TransactionStats.h"
+
+#include <utils/Log.h>
+
+#include <inttypes.h>
+
+namespace android {
+
+namespace {
+
+// Buckets are powers of two in microseconds: [0,1), [1,2), [2,4), ... with
+// the last bucket collecting everything from ~0.5s up.
+constexpr size_t kNumBuckets = 20;
+// Distinct transaction codes tracked per kind; further codes are folded into
+// a shared overflow slot.
+constexpr size_t kNumSlots = 64;
+constexpr uint32_t kEmptyCode = UINT32_MAX;
+constexpr uint32_t kOverflowCode = UINT32_MAX - 1;
+
+struct Histogram {
+    std::atomic<uint32_t> code{kEmptyCode};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::atomic<uint64_t> buckets[kNumBuckets] = {};
+};
+
+struct KindStats {
+    Histogram slots[kNumSlots];
+    Histogram overflow;
+};
+
+KindStats gStats[TransactionStats::KIND_COUNT];
+
+const char* const kKindNames[TransactionStats::KIND_COUNT] = {
+    "client round-trip",
+    "server execution",
+    "server dispatch",
+};
+
+size_t bucketFor(nsecs_t duration) {
+    uint64_t us = static_cast<uint64_t>(duration) / 1000;
+    size_t bucket = 0;
+    while (us != 0 && bucket < kNumBuckets - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+Histogram& histogramFor(KindStats& stats, uint32_t code) {
+    // Open addressing; slots are claimed once and never released (other
+    // than by reset()), so lookups only ever race with claims.
+    const size_t start = (code * 2654435761u) % kNumSlots;
+    for (size_t i = 0; i < kNumSlots; i++) {
+        Histogram& h = stats.slots[(start + i) % kNumSlots];
+        uint32_t current = h.code.load(std::memory_order_acquire);
+        if (current == code) return h;
+        if (current == kEmptyCode) {
+            if (h.code.compare_exchange_strong(current, code, std::memory_order_acq_rel) ||
+                current == code) {
+                return h;
+            }
+        }
+    }
+    stats.overflow.code.store(kOverflowCode, std::memory_order_relaxed);
+    return stats.overflow;
+}
+
+void dumpHistogram(String8& out, const Histogram& h) {
+    const uint64_t count = h.count.load(std::memory_order_relaxed);
+    if (count == 0) return;
+    const uint32_t code = h.code.load(std::memory_order_relaxed);
+    if (code == kOverflowCode) {
+        out.append("    code (other):");
+    } else {
+        out.appendFormat("    code %" PRIu32 ":", code);
+    }
+    out.appendFormat(" count=%" PRIu64 " avg=%" PRIu64 "us max=%" PRIu64 "us\n      ", count,
+                     h.totalNs.load(std::memory_order_relaxed) / count / 1000,
+                     h.maxNs.load(std::memory_order_relaxed) / 1000);
+    for (size_t b = 0; b < kNumBuckets; b++) {
+        const uint64_t n = h.buckets[b].load(std::memory_order_relaxed);
+        if (n == 0) continue;
+        if (b == 0) {
+            out.appendFormat(" <1us:%" PRIu64, n);
+        } else {
+            out.appendFormat(" >=%" PRIu64 "us:%" PRIu64, uint64_t(1) << (b - 1), n);
+        }
+    }
+    out.append("\n");
+}
+
+void resetHistogram(Histogram& h) {
+    h.count.store(0, std::memory_order_relaxed);
+    h.totalNs.store(0, std::memory_order_relaxed);
+    h.maxNs.store(0, std::memory_order_relaxed);
+    for (auto& bucket : h.buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    h.code.store(kEmptyCode, std::memory_order_release);
+}
+
+} // namespace
+
+std::atomic<bool> TransactionStats::sEnabled(false);
+
+void TransactionStats::setEnabled(bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TransactionStats::record(Kind kind, uint32_t code, nsecs_t duration)
+{
+    if (kind >= KIND_COUNT) return;
+    if (duration < 0) duration = 0;
+    Histogram& h = histogramFor(gStats[kind], code);
+    const uint64_t ns = static_cast<uint64_t>(duration);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    h.buckets[bucketFor(duration)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = h.maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !h.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void TransactionStats::reset()
+{
+    // Not synchronized with concurrent record() calls; a transaction racing
+    // with a reset may be attributed to a freshly cleared slot.
+    for (auto& stats : gStats) {
+        for (auto& h : stats.slots) {
+            resetHistogram(h);
+        }
+        resetHistogram(stats.overflow);
+    }
+}
+
+String8 TransactionStats::dump()
+{
+    String8 out;
+    out.appendFormat("Binder transaction stats (%s):\n", isEnabled() ? "enabled" : "disabled");
+    for (size_t kind = 0; kind < KIND_COUNT; kind++) {
+        out.appendFormat("  %s:\n", kKindNames[kind]);
+        for (const auto& h : gStats[kind].slots) {
+            dumpHistogram(out, h);
+        }
+        dumpHistogram(out, gStats[kind].overflow);
+    }
+    return out;
+}
+
+} // namespace android
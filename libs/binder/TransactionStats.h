@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_BINDER_TRANSACTION_STATS_H
+#define ANDROID_BINDER_TRANSACTION_STATS_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <stdint.h>
+
+// ---------------------------------------------------------------------------
+namespace android {
+
+// Process-wide latency histograms for binder transactions, keyed by
+// transaction code. Recording is lock free and costs a single relaxed load
+// when disabled, so it can be left compiled into the transaction paths.
+class TransactionStats
+{
+public:
+    enum Kind {
+        // Time spent in IPCThreadState::transact() waiting for the reply.
+        CLIENT_ROUND_TRIP = 0,
+        // Time spent in BBinder::transact() handling an incoming call.
+        SERVER_EXECUTION,
+        // Time from reading BR_TRANSACTION out of the driver until the
+        // incoming call is dispatched to its BBinder.
+        SERVER_DISPATCH,
+        KIND_COUNT,
+    };
+
+    static  void        setEnabled(bool enabled);
+    static  inline bool isEnabled() {
+        return sEnabled.load(std::memory_order_relaxed);
+    }
+
+    static  void        record(Kind kind, uint32_t code, nsecs_t duration);
+    static  void        reset();
+    static  String8     dump();
+
+private:
+    static  std::atomic<bool> sEnabled;
+};
+
+} // namespace android
+
+// ---------------------------------------------------------------------------
+
+#endif // ANDROID_BINDER_TRANSACTION_STATS_H
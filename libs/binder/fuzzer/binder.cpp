@@ -150,6 +150,13 @@ std::vector<ParcelRead<::android::Parcel>> BINDER_PARCEL_READ_FUNCTIONS {
         FUZZ_LOG() << "readString16Inplace: " << hexString(str, sizeof(char16_t) * outLen)
                    << " size: " << outLen;
     },
+    [] (const ::android::Parcel& p, uint8_t /*data*/) {
+        FUZZ_LOG() << "about to readString16View";
+        std::u16string_view view;
+        status_t status = p.readString16View(&view);
+        FUZZ_LOG() << "readString16View: " << hexString(view.data(), sizeof(char16_t) * view.size())
+                   << " status: " << status;
+    },
     PARCEL_READ_WITH_STATUS(android::sp<android::IBinder>, readStrongBinder),
     PARCEL_READ_WITH_STATUS(android::sp<android::IBinder>, readNullableStrongBinder),
 
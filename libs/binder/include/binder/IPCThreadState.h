@@ -18,10 +18,14 @@
 #define ANDROID_IPC_THREAD_STATE_H
 
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
 #include <utils/Vector.h>
 
+#include <memory>
+#include <vector>
+
 #if defined(_WIN32)
 typedef  int  uid_t;
 #endif
@@ -74,6 +78,22 @@ public:
             status_t            handlePolledCommands();
             void                flushCommands();
 
+            // Starts buffering oneway transactions issued from this thread.
+            // Their commands accumulate in mOut and are handed to the driver
+            // together, in order, when the batch reaches maxTransactions, when a
+            // transaction is issued after maxDelay has elapsed since the first
+            // buffered one, on any synchronous transaction, or on
+            // flushCommands()/endOnewayBatch(). There is no timer: callers must
+            // end or flush the batch once they're done issuing calls. On a
+            // binder thread, a batch still pending is also flushed before the
+            // handler's reply is sent and before the next command is read.
+            //
+            // Errors for batched transactions (e.g. DEAD_OBJECT) are reported
+            // by endOnewayBatch() rather than by transact().
+            void                beginOnewayBatch(size_t maxTransactions = 32,
+                                                 nsecs_t maxDelay = 2000000 /* 2ms */);
+            status_t            endOnewayBatch();
+
             void                joinThreadPool(bool isMain = true);
             
             // Stop the local process.
@@ -143,6 +163,7 @@ private:
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
             void                processPostWriteDerefs();
+            status_t            flushOnewayBatch();
 
             void                clearCaller();
 
@@ -171,6 +192,21 @@ private:
             bool                mPropagateWorkSource;
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
+            // When commands were last read from the driver; only maintained
+            // while transaction stats are enabled.
+            nsecs_t             mLastDriverReadTime;
+
+            // Oneway batching state, see beginOnewayBatch().
+            size_t              mOnewayBatchLimit;
+            nsecs_t             mOnewayBatchMaxDelay;
+            nsecs_t             mOnewayBatchStartTime;
+            // Transactions written to mOut whose BR_TRANSACTION_COMPLETE
+            // has not been consumed yet.
+            size_t              mOnewayBatchPending;
+            bool                mOnewayBatchFlushing;
+            // Copies of batched transaction data, which must stay valid until
+            // mOut has been written to the driver.
+            std::vector<std::unique_ptr<Parcel>> mOnewayBatchParcels;
 
             ProcessState::CallRestriction mCallRestriction;
 };
@@ -68,6 +68,12 @@ public:
      */
     virtual sp<IBinder>         checkService( const String16& name) const = 0;
 
+    /**
+     * Retrieve several existing services with a single call, non-blocking.
+     * Returns one entry per name, null where checkService would return null.
+     */
+    virtual Vector<sp<IBinder>> checkServices(const Vector<String16>& names) const = 0;
+
     /**
      * Register a service.
      */
@@ -20,6 +20,9 @@
 #include <binder/Status.h>
 #include <utils/StrongPointer.h>
 
+#include <chrono>
+#include <functional>
+
 namespace android {
 namespace binder {
 namespace internal {
@@ -41,6 +44,26 @@ class LazyServiceRegistrar {
       */
      void forcePersist(bool persist);
 
+     /**
+      * Keep the process up for a while after its last client left, rather than exiting right
+      * away, so that clients coming back in bursts don't pay a cold start every time.
+      *
+      * The process lingers for at least minLinger. When clients recently came back after being
+      * gone for a while, it lingers long enough to have caught those returns again, up to
+      * maxLinger. Both default to 0, which shuts down as soon as there are no clients.
+      */
+     void setLingerPolicy(std::chrono::milliseconds minLinger,
+                          std::chrono::milliseconds maxLinger);
+
+     /**
+      * Set a callback run right before the process exits for lack of clients, e.g. to save
+      * cached state that the next instance can load to restart warm. It runs once all the
+      * services were unregistered, so no client can reach the process anymore. It runs without
+      * the registrar's lock, so it may call into the registrar, though it can no longer keep the
+      * process from exiting.
+      */
+     void setShutdownCallback(std::function<void()> callback);
+
    private:
      std::shared_ptr<internal::ClientCounterCallback> mClientCC;
      LazyServiceRegistrar();
@@ -19,6 +19,7 @@
 
 #include <map> // for legacy reasons
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -289,6 +290,10 @@ public:
     status_t            readString16(String16* pArg) const;
     status_t            readString16(std::unique_ptr<String16>* pArg) const;
     const char16_t*     readString16Inplace(size_t* outLen) const;
+    // Returns a view of a UTF-16 string directly in the Parcel's buffer,
+    // without copying. The view is only valid as long as the Parcel's data
+    // is not modified or freed. Returns UNEXPECTED_NULL for a null string.
+    status_t            readString16View(std::u16string_view* str) const;
     sp<IBinder>         readStrongBinder() const;
     status_t            readStrongBinder(sp<IBinder>* val) const;
     status_t            readNullableStrongBinder(sp<IBinder>* val) const;
@@ -415,6 +420,10 @@ public:
     // Debugging: get metrics on current allocations.
     static size_t       getGlobalAllocSize();
     static size_t       getGlobalAllocCount();
+    // Debugging: number of data buffers served from / missed by the
+    // per-thread buffer pool.
+    static size_t       getGlobalPoolHitCount();
+    static size_t       getGlobalPoolMissCount();
 
     bool                replaceCallingWorkSourceUid(uid_t uid);
     // Returns the work source provided by the caller. This can only be trusted for trusted calling
@@ -446,6 +455,7 @@ private:
     void                releaseObjects();
     void                acquireObjects();
     status_t            growData(size_t len);
+    status_t            reserveBulkSegment(size_t len);
     status_t            restartWrite(size_t desired);
     status_t            continueWrite(size_t desired);
     status_t            writePointer(uintptr_t val);
@@ -18,6 +18,7 @@
 #define ANDROID_PERSISTABLE_BUNDLE_H
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -42,6 +43,17 @@ public:
     status_t writeToParcel(Parcel* parcel) const override;
     status_t readFromParcel(const Parcel* parcel) override;
 
+    /*
+     * Like readFromParcel(), but only copies the bytes of the bundle out of |parcel|. The entries
+     * are indexed on the first access, and each value is decoded when it is read, so that a large
+     * bundle of which only a few entries are inspected isn't decoded as a whole. Writing the
+     * bundle to a parcel again copies the bytes as they are. Modifying the bundle decodes it.
+     *
+     * Since entries are only checked when the bundle is indexed, a malformed bundle reads as
+     * empty rather than failing here.
+     */
+    status_t readFromParcelLazily(const Parcel* parcel);
+
     bool empty() const;
     size_t size() const;
     size_t erase(const String16& key);
@@ -94,6 +106,9 @@ public:
     std::set<String16> getPersistableBundleKeys() const;
 
     friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
+        if (lhs.mLazy || rhs.mLazy) {
+            return lhs.decoded() == rhs.decoded();
+        }
         return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
                 lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
                 lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
@@ -109,9 +124,19 @@ public:
     }
 
 private:
+    struct LazyEntries;
+
     status_t writeToParcelInner(Parcel* parcel) const;
     status_t readFromParcelInner(const Parcel* parcel, size_t length);
 
+    // Decodes the entries of a lazily read bundle into the maps below.
+    void unparcel();
+    PersistableBundle decoded() const;
+
+    // Set while the bundle holds the undecoded bytes of its entries, in which case the maps
+    // below are empty. Copies of the bundle share the bytes.
+    std::shared_ptr<LazyEntries> mLazy;
+
     std::map<String16, bool> mBoolMap;
     std::map<String16, int32_t> mIntMap;
     std::map<String16, int64_t> mLongMap;
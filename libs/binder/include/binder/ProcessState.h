@@ -48,6 +48,9 @@ public:
             sp<IBinder>         getContextObject(const sp<IBinder>& caller);
 
             void                startThreadPool();
+            // Whether startThreadPool() has been called, i.e. whether this
+            // process can receive callbacks such as death notifications.
+            bool                isThreadPoolStarted() const;
                         
     typedef bool (*context_check_func)(const String16& name,
                                        const sp<IBinder>& caller,
@@ -63,6 +66,14 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+            // Starts the pool with a cap of initialThreads and lets it grow
+            // towards ceilingThreads while busy: whenever all but one of the
+            // allowed threads are executing commands, the cap is raised so the
+            // driver can request another looper before incoming work has to
+            // queue. The cap is never lowered again automatically, as the
+            // driver does not support giving back threads it has spawned.
+            status_t            setThreadPoolAdaptiveMaxThreadCount(size_t initialThreads,
+                                                                    size_t ceilingThreads);
             void                giveThreadPoolName();
 
             String8             getDriverName();
@@ -89,6 +100,15 @@ public:
             // before any threads are spawned.
             void setCallRestriction(CallRestriction restriction);
 
+            // Enables or disables per-transaction-code latency histograms for
+            // outgoing calls, incoming call execution and incoming call dispatch.
+            // Off by default; the disabled cost is one relaxed atomic load per
+            // transaction.
+            void                setTransactionStatsEnabled(bool enabled);
+            void                resetTransactionStats();
+            // Returns a human-readable dump of the collected histograms.
+            String8             dumpTransactionStats();
+
 private:
     friend class IPCThreadState;
     
@@ -98,13 +118,26 @@ private:
                                 ProcessState(const ProcessState& o);
             ProcessState&       operator=(const ProcessState& o);
             String8             makeBinderThreadName();
+            // Must be called with mThreadCountLock held.
+            void                maybeGrowThreadPoolLocked();
 
             struct handle_entry {
                 IBinder* binder;
                 RefBase::weakref_type* refs;
             };
 
-            handle_entry*       lookupHandleLocked(int32_t handle);
+            // The handle table is split into shards by handle value, each with
+            // its own lock, so that threads unflattening different proxies don't
+            // serialize on a single mutex. Within a shard, handle h is stored at
+            // index h / kHandleShards.
+            static constexpr size_t kHandleShards = 16;
+            struct handle_shard {
+                Mutex lock; // protects entries
+                Vector<handle_entry> entries;
+            };
+
+            handle_shard&       shardForHandle(int32_t handle);
+            handle_entry*       lookupHandleLocked(handle_shard& shard, int32_t handle);
 
             String8             mDriverName;
             int                 mDriverFD;
@@ -119,10 +152,12 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Upper bound for mMaxThreads in adaptive mode, or 0 if disabled.
+            size_t              mMaxThreadsCeiling;
 
-    mutable Mutex               mLock;  // protects everything below.
+            handle_shard        mHandleShards[kHandleShards];
 
-            Vector<handle_entry>mHandleToObject;
+    mutable Mutex               mLock;  // protects everything below.
 
             context_check_func  mBinderContextCheckFunc;
             void*               mBinderContextUserData;
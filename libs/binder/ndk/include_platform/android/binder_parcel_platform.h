@@ -29,4 +29,30 @@ __BEGIN_DECLS
  */
 bool AParcel_getAllowFds(const AParcel*);
 
+/**
+ * Writes a byte array as a blob, using the same format as android.os.Parcel#writeBlob. Small
+ * arrays, or any array in a parcel which doesn't allow FDs, are stored inline. Larger ones are
+ * copied once into an ashmem region which is sent as an FD, so they don't count towards the
+ * binder transaction buffer limit.
+ *
+ * \param parcel the parcel to write to.
+ * \param data an array of size 'length' (or null if length is -1, may be null if length is 0).
+ * \param length the length of data or -1 to represent a null array.
+ *
+ * \return STATUS_OK on successful write.
+ */
+binder_status_t AParcel_writeBlob(AParcel* parcel, const void* data, int32_t length);
+
+/**
+ * Reads a blob written by AParcel_writeBlob or android.os.Parcel#writeBlob.
+ *
+ * \param parcel the parcel to read from.
+ * \param arrayData some external representation of an array.
+ * \param allocator the callback that will be called to allocate the array.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readBlob(const AParcel* parcel, void* arrayData,
+                                 AParcel_byteArrayAllocator allocator);
+
 __END_DECLS
\ No newline at end of file
@@ -465,6 +465,51 @@ binder_status_t AParcel_readParcelableArray(const AParcel* parcel, void* arrayDa
     return STATUS_OK;
 }
 
+binder_status_t AParcel_writeBlob(AParcel* parcel, const void* data, int32_t length) {
+    Parcel* rawParcel = parcel->get();
+
+    if (length < -1) return STATUS_BAD_VALUE;
+    if (length > 0 && data == nullptr) return STATUS_UNEXPECTED_NULL;
+
+    // Same layout as android.os.Parcel#writeBlob: a length, then the blob.
+    status_t status = rawParcel->writeInt32(length);
+    if (status != STATUS_OK) return PruneStatusT(status);
+    if (length <= 0) return STATUS_OK;
+
+    Parcel::WritableBlob blob;
+    status = rawParcel->writeBlob(length, false /*mutableCopy*/, &blob);
+    if (status != STATUS_OK) return PruneStatusT(status);
+
+    memcpy(blob.data(), data, length);
+    blob.release();
+    return STATUS_OK;
+}
+
+binder_status_t AParcel_readBlob(const AParcel* parcel, void* arrayData,
+                                 AParcel_byteArrayAllocator allocator) {
+    const Parcel* rawParcel = parcel->get();
+
+    int32_t length;
+    status_t status = rawParcel->readInt32(&length);
+
+    if (status != STATUS_OK) return PruneStatusT(status);
+    if (length < -1) return STATUS_BAD_VALUE;
+
+    int8_t* array;
+    if (!allocator(arrayData, length, &array)) return STATUS_NO_MEMORY;
+
+    if (length <= 0) return STATUS_OK;
+    if (array == nullptr) return STATUS_NO_MEMORY;
+
+    Parcel::ReadableBlob blob;
+    status = rawParcel->readBlob(length, &blob);
+    if (status != STATUS_OK) return PruneStatusT(status);
+
+    memcpy(array, blob.data(), length);
+    blob.release();
+    return STATUS_OK;
+}
+
 // See gen_parcel_helper.py. These auto-generated read/write methods use the same types for
 // libbinder and this library.
 // @START
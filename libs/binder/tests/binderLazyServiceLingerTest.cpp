@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "../LazyServiceLinger.h"
+
+using android::binder::internal::LazyServiceLinger;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Drives the linger policy the way ClientCounterCallback::onClients does: the last client
+// leaving makes the process idle, and a client coming back before the deadline records how long
+// clients stayed away.
+class LazyServiceLingerTest : public testing::Test {
+protected:
+    using Clock = LazyServiceLinger::Clock;
+
+    // Clients leave at mNow and come back |away| later. Returns the shutdown deadline, relative
+    // to when they left, that was in effect meanwhile.
+    Clock::duration leaveAndComeBack(Clock::duration away) {
+        const Clock::time_point deadline = mLinger.onIdle(mNow);
+        EXPECT_LT(mNow + away, deadline) << "the process would have shut down";
+        const Clock::duration linger = deadline - mNow;
+        mNow += away;
+        mLinger.onClientsBack(mNow);
+        mNow += 1s;
+        return linger;
+    }
+
+    LazyServiceLinger mLinger;
+    Clock::time_point mNow = Clock::time_point() + 1h;
+};
+
+TEST_F(LazyServiceLingerTest, NoLingerByDefault) {
+    EXPECT_EQ(mNow, mLinger.onIdle(mNow));
+    EXPECT_FALSE(mLinger.isIdle());
+}
+
+TEST_F(LazyServiceLingerTest, LingersForMinLingerAtFirst) {
+    mLinger.setPolicy(100ms, 10s);
+    EXPECT_EQ(mNow + 100ms, mLinger.onIdle(mNow));
+    EXPECT_TRUE(mLinger.isIdle());
+
+    // Later notifications while idle keep the deadline relative to when clients left.
+    EXPECT_EQ(mNow + 100ms, mLinger.onIdle(mNow + 50ms));
+}
+
+TEST_F(LazyServiceLingerTest, ReturningClientExtendsLinger) {
+    mLinger.setPolicy(100ms, 10s);
+
+    EXPECT_EQ(Clock::duration(100ms), leaveAndComeBack(30ms));
+    // Twice 30ms is below the minimum.
+    EXPECT_EQ(Clock::duration(100ms), leaveAndComeBack(80ms));
+    // Twice the longest recent absence.
+    EXPECT_EQ(Clock::duration(160ms), mLinger.linger());
+    EXPECT_EQ(Clock::duration(160ms), leaveAndComeBack(150ms));
+    EXPECT_EQ(Clock::duration(300ms), mLinger.linger());
+}
+
+TEST_F(LazyServiceLingerTest, LingerIsCappedAtMaxLinger) {
+    mLinger.setPolicy(100ms, 1s);
+
+    EXPECT_EQ(Clock::duration(100ms), leaveAndComeBack(90ms));
+    EXPECT_EQ(Clock::duration(180ms), leaveAndComeBack(170ms));
+    EXPECT_EQ(Clock::duration(340ms), leaveAndComeBack(300ms));
+    EXPECT_EQ(Clock::duration(600ms), leaveAndComeBack(590ms));
+    EXPECT_EQ(Clock::duration(1s), mLinger.linger());
+
+    // The next time clients leave, the process lingers for maxLinger only.
+    EXPECT_EQ(mNow + 1s, mLinger.onIdle(mNow));
+}
+
+TEST_F(LazyServiceLingerTest, OldAbsencesAreForgotten) {
+    mLinger.setPolicy(100ms, 10s);
+
+    leaveAndComeBack(90ms);
+    leaveAndComeBack(170ms);
+    EXPECT_EQ(Clock::duration(340ms), mLinger.linger());
+    for (size_t i = 0; i < LazyServiceLinger::kMaxRecentIdleTimes; i++) {
+        leaveAndComeBack(10ms);
+    }
+    EXPECT_EQ(Clock::duration(100ms), mLinger.linger());
+}
+
+TEST_F(LazyServiceLingerTest, ResetStartsLingeringOver) {
+    mLinger.setPolicy(100ms, 10s);
+    EXPECT_EQ(mNow + 100ms, mLinger.onIdle(mNow));
+
+    // The deadline passed but the process could not shut down.
+    mNow += 200ms;
+    mLinger.reset();
+    EXPECT_FALSE(mLinger.isIdle());
+    EXPECT_EQ(mNow + 100ms, mLinger.onIdle(mNow));
+}
+
+} // namespace
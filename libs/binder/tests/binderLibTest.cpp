@@ -81,6 +81,7 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_GET_SCHEDULING_POLICY,
     BINDER_LIB_TEST_ECHO_VECTOR,
     BINDER_LIB_TEST_REJECT_BUF,
+    BINDER_LIB_TEST_BATCHED_CALL_BACK,
 };
 
 pid_t start_server_process(int arg2, bool usePoll = false)
@@ -1050,6 +1051,22 @@ TEST_F(BinderLibTest, VectorSent) {
     EXPECT_EQ(readValue, testValue);
 }
 
+TEST_F(BinderLibTest, TransactionStatsRecorded) {
+    sp<ProcessState> proc = ProcessState::self();
+    proc->resetTransactionStats();
+    proc->setTransactionStatsEnabled(true);
+
+    Parcel data, reply;
+    status_t ret = m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply);
+    EXPECT_EQ(NO_ERROR, ret);
+
+    proc->setTransactionStatsEnabled(false);
+    String8 dump = proc->dumpTransactionStats();
+    String8 expected;
+    expected.appendFormat("code %d: count=1 ", BINDER_LIB_TEST_NOP_TRANSACTION);
+    EXPECT_NE(-1, dump.find(expected.string())) << dump.string();
+}
+
 TEST_F(BinderLibTest, BufRejected) {
     Parcel data, reply;
     uint32_t buf;
@@ -1078,6 +1095,27 @@ TEST_F(BinderLibTest, BufRejected) {
     EXPECT_NE(NO_ERROR, ret);
 }
 
+TEST_F(BinderLibTest, OnewayBatchLeftOpenInHandler) {
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != nullptr);
+
+    // The handler opens a oneway batch, queues a callback into it and
+    // returns without ending it; the callback must still be delivered and
+    // the reply must not be confused by the batch's completion.
+    sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+    Parcel data, reply;
+    data.writeStrongBinder(callBack);
+    status_t ret = server->transact(BINDER_LIB_TEST_BATCHED_CALL_BACK, data, &reply);
+    EXPECT_EQ(NO_ERROR, ret);
+    EXPECT_EQ(NO_ERROR, callBack->waitEvent(5));
+    EXPECT_EQ(NO_ERROR, callBack->getResult());
+
+    // Later calls on the same server thread still work.
+    Parcel data2, reply2;
+    ret = server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data2, &reply2);
+    EXPECT_EQ(NO_ERROR, ret);
+}
+
 class BinderLibTestService : public BBinder
 {
     public:
@@ -1227,6 +1265,18 @@ class BinderLibTestService : public BBinder
                 binder->transact(BINDER_LIB_TEST_CALL_BACK, data2, &reply2);
                 return NO_ERROR;
             }
+            case BINDER_LIB_TEST_BATCHED_CALL_BACK: {
+                sp<IBinder> binder = data.readStrongBinder();
+                if (binder == nullptr) {
+                    return BAD_VALUE;
+                }
+                Parcel data2;
+                data2.writeInt32(NO_ERROR);
+                IPCThreadState::self()->beginOnewayBatch();
+                binder->transact(BINDER_LIB_TEST_CALL_BACK, data2, nullptr, TF_ONE_WAY);
+                // Deliberately not ending the batch.
+                return NO_ERROR;
+            }
             case BINDER_LIB_TEST_GET_SELF_TRANSACTION:
                 reply->writeStrongBinder(this);
                 return NO_ERROR;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/IMemory.h>
+#include <binder/MemoryDealer.h>
+
+#include <random>
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+constexpr size_t kHeapSize = 16 << 20;
+
+// Allocates and frees one region from a heap that already holds state.range(0)
+// live regions of mixed sizes, with the holes that freeing every other one of
+// them leaves behind. That's the steady state of media and audio clients.
+void BM_MemoryDealerAllocateFree(benchmark::State& state) {
+    sp<MemoryDealer> dealer = new MemoryDealer(kHeapSize, "BM_MemoryDealerAllocateFree");
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> sizes(64, 16 << 10);
+
+    std::vector<sp<IMemory>> live;
+    for (int64_t i = 0; i < state.range(0) * 2; i++) {
+        live.push_back(dealer->allocate(sizes(rng)));
+    }
+    for (size_t i = 0; i < live.size(); i += 2) {
+        live[i].clear();
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        sp<IMemory> memory = dealer->allocate(sizes(rng));
+        benchmark::DoNotOptimize(memory);
+        if (memory == nullptr) {
+            state.SkipWithError("heap exhausted");
+            break;
+        }
+        // Replace a live region, so that the layout of the heap keeps changing.
+        live[(i++ * 2 + 1) % live.size()] = memory;
+    }
+}
+BENCHMARK(BM_MemoryDealerAllocateFree)->RangeMultiplier(8)->Range(8, 512);
+
+// Allocation and release from several threads sharing one dealer.
+void BM_MemoryDealerAllocateFreeThreaded(benchmark::State& state) {
+    static sp<MemoryDealer> dealer;
+    if (state.thread_index == 0) {
+        dealer = new MemoryDealer(kHeapSize, "BM_MemoryDealerAllocateFreeThreaded");
+    }
+    std::mt19937 rng(state.thread_index);
+    std::uniform_int_distribution<size_t> sizes(64, 4 << 10);
+
+    for (auto _ : state) {
+        sp<IMemory> memory = dealer->allocate(sizes(rng));
+        benchmark::DoNotOptimize(memory);
+    }
+
+    if (state.thread_index == 0) {
+        dealer.clear();
+    }
+}
+BENCHMARK(BM_MemoryDealerAllocateFreeThreaded)->ThreadRange(1, 4);
+
+} // namespace
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <binder/IBinder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+#include <binder/PersistableBundle.h>
+#include <binder/ProcessState.h>
+#include <utils/String16.h>
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+const String16 kServiceName("binderParcelBenchmark");
+
+enum BenchmarkCode {
+    BENCH_ECHO = IBinder::FIRST_CALL_TRANSACTION,
+    BENCH_NOP,
+};
+
+class EchoService : public BBinder {
+public:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case BENCH_ECHO:
+                return reply->appendFrom(&data, 0, data.dataSize());
+            case BENCH_NOP:
+                return NO_ERROR;
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+};
+
+// A small Parcelable with a nested child, to exercise the
+// writeParcelable/readParcelable paths used by AIDL structured types.
+class Leaf : public Parcelable {
+public:
+    status_t writeToParcel(Parcel* parcel) const override {
+        status_t status = parcel->writeInt32(id);
+        if (status != OK) return status;
+        return parcel->writeUtf8AsUtf16(name);
+    }
+    status_t readFromParcel(const Parcel* parcel) override {
+        status_t status = parcel->readInt32(&id);
+        if (status != OK) return status;
+        return parcel->readUtf8FromUtf16(&name);
+    }
+
+    int32_t id = 42;
+    std::string name = "com.example.leaf";
+};
+
+class Node : public Parcelable {
+public:
+    status_t writeToParcel(Parcel* parcel) const override {
+        status_t status = parcel->writeInt64(timestamp);
+        if (status != OK) return status;
+        status = parcel->writeParcelable(leaf);
+        if (status != OK) return status;
+        return parcel->writeParcelableVector(children);
+    }
+    status_t readFromParcel(const Parcel* parcel) override {
+        status_t status = parcel->readInt64(&timestamp);
+        if (status != OK) return status;
+        status = parcel->readParcelable(&leaf);
+        if (status != OK) return status;
+        return parcel->readParcelableVector(&children);
+    }
+
+    int64_t timestamp = 123456789;
+    Leaf leaf;
+    std::vector<Leaf> children = std::vector<Leaf>(8);
+};
+
+PersistableBundle makeBundle() {
+    PersistableBundle bundle;
+    bundle.putBoolean(String16("bool"), true);
+    bundle.putInt(String16("int"), 7);
+    bundle.putLong(String16("long"), 1ll << 40);
+    bundle.putDouble(String16("double"), 3.5);
+    bundle.putString(String16("string"), String16("a moderately long string value"));
+    bundle.putIntVector(String16("intVector"), std::vector<int32_t>(32, 1));
+    bundle.putStringVector(String16("stringVector"),
+                           std::vector<String16>(8, String16("element")));
+    return bundle;
+}
+
+// --- Parcel marshalling ---
+
+void BM_ParcelWriteReadInt32(benchmark::State& state) {
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        for (int i = 0; i < 64; i++) p.writeInt32(i);
+        p.setDataPosition(0);
+        int32_t v;
+        for (int i = 0; i < 64; i++) p.readInt32(&v);
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_ParcelWriteReadInt32);
+
+void BM_ParcelWriteReadString16(benchmark::State& state) {
+    const String16 str(std::string(state.range(0), 'a').c_str());
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeString16(str);
+        p.setDataPosition(0);
+        String16 out;
+        p.readString16(&out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(char16_t));
+}
+BENCHMARK(BM_ParcelWriteReadString16)->RangeMultiplier(8)->Range(8, 8 << 10);
+
+void BM_ParcelWriteReadUtf8(benchmark::State& state) {
+    const std::string str(state.range(0), 'a');
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeUtf8AsUtf16(str);
+        p.setDataPosition(0);
+        std::string out;
+        p.readUtf8FromUtf16(&out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelWriteReadUtf8)->RangeMultiplier(8)->Range(8, 8 << 10);
+
+void BM_ParcelWriteReadByteVector(benchmark::State& state) {
+    const std::vector<uint8_t> bytes(state.range(0), 0x5a);
+    for (auto _ : state) {
+        // A fresh Parcel each time, so buffer growth is part of the cost.
+        Parcel p;
+        p.writeByteVector(bytes);
+        p.setDataPosition(0);
+        std::vector<uint8_t> out;
+        p.readByteVector(&out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelWriteReadByteVector)->RangeMultiplier(8)->Range(64, 1 << 20);
+
+void BM_ParcelWriteReadInt64Vector(benchmark::State& state) {
+    const std::vector<int64_t> values(state.range(0), 1);
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeInt64Vector(values);
+        p.setDataPosition(0);
+        std::vector<int64_t> out;
+        p.readInt64Vector(&out);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelWriteReadInt64Vector)->RangeMultiplier(8)->Range(8, 8 << 10);
+
+void BM_ParcelWriteReadParcelable(benchmark::State& state) {
+    const Node node;
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeParcelable(node);
+        p.setDataPosition(0);
+        Node out;
+        p.readParcelable(&out);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_ParcelWriteReadParcelable);
+
+void BM_ParcelWriteReadPersistableBundle(benchmark::State& state) {
+    const PersistableBundle bundle = makeBundle();
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeParcelable(bundle);
+        p.setDataPosition(0);
+        PersistableBundle out;
+        p.readParcelable(&out);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_ParcelWriteReadPersistableBundle);
+
+// Reading a bundle of which only one entry is inspected, eagerly and lazily.
+void BM_ParcelReadPersistableBundleEntry(benchmark::State& state) {
+    const bool lazily = state.range(0);
+    Parcel p;
+    makeBundle().writeToParcel(&p);
+    for (auto _ : state) {
+        p.setDataPosition(0);
+        PersistableBundle out;
+        if (lazily) {
+            out.readFromParcelLazily(&p);
+        } else {
+            out.readFromParcel(&p);
+        }
+        int32_t value;
+        benchmark::DoNotOptimize(out.getInt(String16("int"), &value));
+    }
+}
+BENCHMARK(BM_ParcelReadPersistableBundleEntry)->Arg(0)->Arg(1);
+
+void BM_ParcelWriteReadLocalBinder(benchmark::State& state) {
+    const sp<IBinder> binder = new BBinder();
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        p.writeStrongBinder(binder);
+        p.setDataPosition(0);
+        sp<IBinder> out;
+        p.readStrongBinder(&out);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_ParcelWriteReadLocalBinder);
+
+// --- Round trips ---
+
+void transactEcho(benchmark::State& state, const sp<IBinder>& binder) {
+    const std::vector<uint8_t> bytes(state.range(0), 0x5a);
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.writeByteVector(bytes);
+        status_t status = binder->transact(BENCH_ECHO, data, &reply);
+        if (status != OK) {
+            state.SkipWithError("transact failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_InProcessTransact(benchmark::State& state) {
+    static const sp<IBinder> binder = new EchoService();
+    transactEcho(state, binder);
+}
+BENCHMARK(BM_InProcessTransact)->Arg(0)->RangeMultiplier(8)->Range(8, 64 << 10);
+
+void BM_CrossProcessTransact(benchmark::State& state) {
+    static const sp<IBinder> binder = defaultServiceManager()->getService(kServiceName);
+    if (binder == nullptr) {
+        state.SkipWithError("benchmark service not available");
+        return;
+    }
+    transactEcho(state, binder);
+}
+BENCHMARK(BM_CrossProcessTransact)->Arg(0)->RangeMultiplier(8)->Range(8, 64 << 10);
+
+void BM_CrossProcessOneway(benchmark::State& state) {
+    static const sp<IBinder> binder = defaultServiceManager()->getService(kServiceName);
+    if (binder == nullptr) {
+        state.SkipWithError("benchmark service not available");
+        return;
+    }
+    for (auto _ : state) {
+        Parcel data;
+        binder->transact(BENCH_NOP, data, nullptr, IBinder::FLAG_ONEWAY);
+    }
+    // Make sure the last transactions were delivered before tearing down.
+    Parcel data, reply;
+    binder->transact(BENCH_NOP, data, &reply);
+}
+BENCHMARK(BM_CrossProcessOneway);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child: host the echo service until the parent goes away.
+        prctl(PR_SET_PDEATHSIG, SIGHUP);
+        defaultServiceManager()->addService(kServiceName, new EchoService());
+        ProcessState::self()->startThreadPool();
+        IPCThreadState::self()->joinThreadPool();
+        return 0;
+    }
+
+    ProcessState::self()->startThreadPool();
+    // Wait for the child to register before measuring.
+    defaultServiceManager()->waitForService(kServiceName);
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    return 0;
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <functional>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/PersistableBundle.h>
+#include <gtest/gtest.h>
+
+#include "../ParcelValTypes.h"
+
+using android::Parcel;
+using android::String16;
+using android::os::PersistableBundle;
+using namespace android::binder;
+
+namespace {
+
+constexpr int32_t kBundleMagic = 0x4C444E42;
+
+PersistableBundle makeBundle() {
+    PersistableBundle nested;
+    nested.putInt(String16("nestedInt"), 7);
+    nested.putString(String16("nestedString"), String16("inner"));
+
+    PersistableBundle bundle;
+    bundle.putBoolean(String16("bool"), true);
+    bundle.putInt(String16("int"), -42);
+    bundle.putLong(String16("long"), 1LL << 40);
+    bundle.putDouble(String16("double"), 2.5);
+    bundle.putString(String16("string"), String16("value"));
+    bundle.putString(String16("emptyString"), String16());
+    bundle.putBooleanVector(String16("boolVector"), {true, false, true});
+    bundle.putIntVector(String16("intVector"), {1, 2, 3});
+    bundle.putIntVector(String16("emptyIntVector"), {});
+    bundle.putLongVector(String16("longVector"), {1LL << 33, -1});
+    bundle.putDoubleVector(String16("doubleVector"), {0.5, -0.25});
+    bundle.putStringVector(String16("stringVector"), {String16("a"), String16(), String16("c")});
+    bundle.putPersistableBundle(String16("bundle"), nested);
+    bundle.putPersistableBundle(String16("emptyBundle"), PersistableBundle());
+    return bundle;
+}
+
+void writeBundle(const PersistableBundle& bundle, Parcel* parcel) {
+    ASSERT_EQ(android::NO_ERROR, bundle.writeToParcel(parcel));
+    parcel->setDataPosition(0);
+}
+
+// Writes a bundle whose entries are written by |writeEntries|, which need not be well formed.
+void writeRawBundle(int32_t numEntries, const std::function<void(Parcel*)>& writeEntries,
+                    Parcel* parcel) {
+    parcel->writeInt32(0);  // length, patched below
+    parcel->writeInt32(kBundleMagic);
+    const size_t start = parcel->dataPosition();
+    parcel->writeInt32(numEntries);
+    writeEntries(parcel);
+    const size_t end = parcel->dataPosition();
+    parcel->setDataPosition(0);
+    parcel->writeInt32(static_cast<int32_t>(end - start));
+    parcel->setDataPosition(0);
+}
+
+void expectReadsAsEmpty(const Parcel& parcel) {
+    PersistableBundle lazy;
+    parcel.setDataPosition(0);
+    ASSERT_EQ(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+    EXPECT_TRUE(lazy.empty());
+    int32_t intValue;
+    EXPECT_FALSE(lazy.getInt(String16("int"), &intValue));
+    EXPECT_TRUE(lazy.getIntKeys().empty());
+    EXPECT_EQ(PersistableBundle(), lazy);
+
+    Parcel out;
+    ASSERT_EQ(android::NO_ERROR, lazy.writeToParcel(&out));
+    out.setDataPosition(0);
+    EXPECT_EQ(0, out.readInt32());
+}
+
+} // namespace
+
+TEST(PersistableBundle, LazyReadMatchesEagerRead) {
+    const PersistableBundle expected = makeBundle();
+    Parcel parcel;
+    writeBundle(expected, &parcel);
+
+    PersistableBundle eager;
+    ASSERT_EQ(android::NO_ERROR, eager.readFromParcel(&parcel));
+    parcel.setDataPosition(0);
+    PersistableBundle lazy;
+    ASSERT_EQ(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+
+    EXPECT_EQ(expected, eager);
+    EXPECT_EQ(expected.size(), lazy.size());
+
+    bool boolValue;
+    ASSERT_TRUE(lazy.getBoolean(String16("bool"), &boolValue));
+    EXPECT_TRUE(boolValue);
+    int32_t intValue;
+    ASSERT_TRUE(lazy.getInt(String16("int"), &intValue));
+    EXPECT_EQ(-42, intValue);
+    int64_t longValue;
+    ASSERT_TRUE(lazy.getLong(String16("long"), &longValue));
+    EXPECT_EQ(1LL << 40, longValue);
+    double doubleValue;
+    ASSERT_TRUE(lazy.getDouble(String16("double"), &doubleValue));
+    EXPECT_EQ(2.5, doubleValue);
+    String16 stringValue;
+    ASSERT_TRUE(lazy.getString(String16("string"), &stringValue));
+    EXPECT_EQ(String16("value"), stringValue);
+    ASSERT_TRUE(lazy.getString(String16("emptyString"), &stringValue));
+    EXPECT_EQ(String16(), stringValue);
+    std::vector<bool> boolVector;
+    ASSERT_TRUE(lazy.getBooleanVector(String16("boolVector"), &boolVector));
+    EXPECT_EQ((std::vector<bool>{true, false, true}), boolVector);
+    std::vector<int32_t> intVector;
+    ASSERT_TRUE(lazy.getIntVector(String16("intVector"), &intVector));
+    EXPECT_EQ((std::vector<int32_t>{1, 2, 3}), intVector);
+    ASSERT_TRUE(lazy.getIntVector(String16("emptyIntVector"), &intVector));
+    EXPECT_TRUE(intVector.empty());
+    std::vector<int64_t> longVector;
+    ASSERT_TRUE(lazy.getLongVector(String16("longVector"), &longVector));
+    EXPECT_EQ((std::vector<int64_t>{1LL << 33, -1}), longVector);
+    std::vector<double> doubleVector;
+    ASSERT_TRUE(lazy.getDoubleVector(String16("doubleVector"), &doubleVector));
+    EXPECT_EQ((std::vector<double>{0.5, -0.25}), doubleVector);
+    std::vector<String16> stringVector;
+    ASSERT_TRUE(lazy.getStringVector(String16("stringVector"), &stringVector));
+    EXPECT_EQ((std::vector<String16>{String16("a"), String16(), String16("c")}), stringVector);
+
+    // A key is only found with its own type.
+    EXPECT_FALSE(lazy.getLong(String16("int"), &longValue));
+    EXPECT_FALSE(lazy.getInt(String16("missing"), &intValue));
+
+    EXPECT_EQ(eager.getBooleanKeys(), lazy.getBooleanKeys());
+    EXPECT_EQ(eager.getIntKeys(), lazy.getIntKeys());
+    EXPECT_EQ(eager.getLongKeys(), lazy.getLongKeys());
+    EXPECT_EQ(eager.getDoubleKeys(), lazy.getDoubleKeys());
+    EXPECT_EQ(eager.getStringKeys(), lazy.getStringKeys());
+    EXPECT_EQ(eager.getBooleanVectorKeys(), lazy.getBooleanVectorKeys());
+    EXPECT_EQ(eager.getIntVectorKeys(), lazy.getIntVectorKeys());
+    EXPECT_EQ(eager.getLongVectorKeys(), lazy.getLongVectorKeys());
+    EXPECT_EQ(eager.getDoubleVectorKeys(), lazy.getDoubleVectorKeys());
+    EXPECT_EQ(eager.getStringVectorKeys(), lazy.getStringVectorKeys());
+    EXPECT_EQ(eager.getPersistableBundleKeys(), lazy.getPersistableBundleKeys());
+
+    EXPECT_EQ(eager, lazy);
+    EXPECT_EQ(lazy, eager);
+}
+
+TEST(PersistableBundle, NestedBundleIsReadLazily) {
+    Parcel parcel;
+    writeBundle(makeBundle(), &parcel);
+    PersistableBundle lazy;
+    ASSERT_EQ(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+
+    PersistableBundle nested;
+    ASSERT_TRUE(lazy.getPersistableBundle(String16("bundle"), &nested));
+    EXPECT_EQ(2u, nested.size());
+    int32_t intValue;
+    ASSERT_TRUE(nested.getInt(String16("nestedInt"), &intValue));
+    EXPECT_EQ(7, intValue);
+    String16 stringValue;
+    ASSERT_TRUE(nested.getString(String16("nestedString"), &stringValue));
+    EXPECT_EQ(String16("inner"), stringValue);
+
+    PersistableBundle expected;
+    ASSERT_TRUE(makeBundle().getPersistableBundle(String16("bundle"), &expected));
+    EXPECT_EQ(expected, nested);
+
+    PersistableBundle empty;
+    ASSERT_TRUE(lazy.getPersistableBundle(String16("emptyBundle"), &empty));
+    EXPECT_TRUE(empty.empty());
+}
+
+TEST(PersistableBundle, UntouchedLazyBundleIsWrittenUnchanged) {
+    Parcel parcel;
+    writeBundle(makeBundle(), &parcel);
+    PersistableBundle lazy;
+    ASSERT_EQ(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+
+    Parcel out;
+    ASSERT_EQ(android::NO_ERROR, lazy.writeToParcel(&out));
+    ASSERT_EQ(parcel.dataSize(), out.dataSize());
+    EXPECT_EQ(0, memcmp(parcel.data(), out.data(), parcel.dataSize()));
+
+    // Reading values only indexes the bundle, which is still written as it was read.
+    int32_t intValue;
+    ASSERT_TRUE(lazy.getInt(String16("int"), &intValue));
+    Parcel outAfterRead;
+    ASSERT_EQ(android::NO_ERROR, lazy.writeToParcel(&outAfterRead));
+    ASSERT_EQ(parcel.dataSize(), outAfterRead.dataSize());
+    EXPECT_EQ(0, memcmp(parcel.data(), outAfterRead.data(), parcel.dataSize()));
+}
+
+TEST(PersistableBundle, PutAfterLazyRead) {
+    Parcel parcel;
+    writeBundle(makeBundle(), &parcel);
+    PersistableBundle lazy;
+    ASSERT_EQ(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+    PersistableBundle copy = lazy;
+
+    lazy.putInt(String16("int"), 1);
+    lazy.putInt(String16("newInt"), 2);
+
+    PersistableBundle expected = makeBundle();
+    expected.putInt(String16("int"), 1);
+    expected.putInt(String16("newInt"), 2);
+    EXPECT_EQ(expected, lazy);
+
+    // Copies taken before the put share the bytes but not the change.
+    EXPECT_EQ(makeBundle(), copy);
+
+    Parcel out;
+    writeBundle(lazy, &out);
+    PersistableBundle reread;
+    ASSERT_EQ(android::NO_ERROR, reread.readFromParcel(&out));
+    EXPECT_EQ(expected, reread);
+}
+
+TEST(PersistableBundle, NullStringInStringArrayIsRejectedLikeEagerRead) {
+    Parcel parcel;
+    writeRawBundle(2, [](Parcel* p) {
+        p->writeString16(String16("int"));
+        p->writeInt32(VAL_INTEGER);
+        p->writeInt32(1);
+        p->writeString16(String16("stringVector"));
+        p->writeInt32(VAL_STRINGARRAY);
+        p->writeInt32(2);
+        p->writeString16(String16("a"));
+        p->writeString16(nullptr, 0);
+    }, &parcel);
+
+    PersistableBundle eager;
+    EXPECT_NE(android::NO_ERROR, eager.readFromParcel(&parcel));
+    expectReadsAsEmpty(parcel);
+}
+
+TEST(PersistableBundle, TruncatedBundleReadsAsEmpty) {
+    Parcel parcel;
+    writeBundle(makeBundle(), &parcel);
+    const int32_t length = parcel.readInt32();
+
+    // Claim, and copy, less than the whole bundle.
+    for (int32_t cut : {4, 8, length / 2}) {
+        Parcel truncated;
+        truncated.writeInt32(length - cut);
+        ASSERT_EQ(android::NO_ERROR,
+                  truncated.appendFrom(&parcel, sizeof(int32_t),
+                                       sizeof(int32_t) + static_cast<size_t>(length - cut)));
+        SCOPED_TRACE(cut);
+        expectReadsAsEmpty(truncated);
+    }
+}
+
+TEST(PersistableBundle, MalformedEntriesReadAsEmpty) {
+    const std::vector<std::pair<int32_t, std::function<void(Parcel*)>>> malformed = {
+            // More entries than written.
+            {3,
+             [](Parcel* p) {
+                 p->writeString16(String16("int"));
+                 p->writeInt32(VAL_INTEGER);
+                 p->writeInt32(1);
+             }},
+            // Unknown value type.
+            {1,
+             [](Parcel* p) {
+                 p->writeString16(String16("int"));
+                 p->writeInt32(1234);
+                 p->writeInt32(1);
+             }},
+            // Array longer than the data.
+            {1,
+             [](Parcel* p) {
+                 p->writeString16(String16("intVector"));
+                 p->writeInt32(VAL_INTARRAY);
+                 p->writeInt32(1 << 30);
+                 p->writeInt32(1);
+             }},
+            // Null array.
+            {1,
+             [](Parcel* p) {
+                 p->writeString16(String16("longVector"));
+                 p->writeInt32(VAL_LONGARRAY);
+                 p->writeInt32(-1);
+             }},
+            // Null string.
+            {1,
+             [](Parcel* p) {
+                 p->writeString16(String16("string"));
+                 p->writeInt32(VAL_STRING);
+                 p->writeString16(nullptr, 0);
+             }},
+            // Nested bundle longer than the data.
+            {1,
+             [](Parcel* p) {
+                 p->writeString16(String16("bundle"));
+                 p->writeInt32(VAL_PERSISTABLEBUNDLE);
+                 p->writeInt32(1 << 20);
+                 p->writeInt32(kBundleMagic);
+             }},
+    };
+
+    for (size_t i = 0; i < malformed.size(); i++) {
+        Parcel parcel;
+        writeRawBundle(malformed[i].first, malformed[i].second, &parcel);
+        SCOPED_TRACE(i);
+        expectReadsAsEmpty(parcel);
+    }
+}
+
+TEST(PersistableBundle, BadMagicIsRejected) {
+    Parcel parcel;
+    parcel.writeInt32(4);
+    parcel.writeInt32(0x12345678);
+    parcel.writeInt32(0);
+    parcel.setDataPosition(0);
+
+    PersistableBundle lazy;
+    EXPECT_NE(android::NO_ERROR, lazy.readFromParcelLazily(&parcel));
+    EXPECT_TRUE(lazy.empty());
+}
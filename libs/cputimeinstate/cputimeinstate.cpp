@@ -22,8 +22,13 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <optional>
@@ -59,6 +64,24 @@ static std::set<uint32_t> gAllFreqs;
 static unique_fd gTisMapFd;
 static unique_fd gConcurrentMapFd;
 static unique_fd gUidLastUpdateMapFd;
+static std::atomic<bool> gBatchLookupSupported{true};
+
+// BPF_MAP_LOOKUP_BATCH and its attributes, from Linux 5.6. They are spelled out here because the
+// kernel headers we build against predate them.
+static constexpr int kBpfMapLookupBatch = 24;
+struct bpf_map_batch_attr {
+    uint64_t in_batch;
+    uint64_t out_batch;
+    uint64_t keys;
+    uint64_t values;
+    uint32_t count;
+    uint32_t map_fd;
+    uint64_t elem_flags;
+    uint64_t flags;
+};
+
+// Number of entries read with each BPF_MAP_LOOKUP_BATCH call.
+static constexpr uint32_t kLookupBatchSize = 256;
 
 static std::optional<std::vector<uint32_t>> readNumbersFromFile(const std::string &path) {
     std::string data;
@@ -76,6 +99,84 @@ static std::optional<std::vector<uint32_t>> readNumbersFromFile(const std::strin
     return ret;
 }
 
+// Read all the entries of a map with BPF_MAP_LOOKUP_BATCH, which takes one syscall per batch of
+// entries where iterating over the keys takes two per entry. valsPerKey is the number of Val per
+// entry, which is the number of CPUs for per-CPU maps.
+// Returns false if the kernel cannot do batched lookups or on error; callers should then iterate
+// over the keys instead.
+template <class Key, class Val>
+static bool lookupMapBatch(int mapFd, uint32_t valsPerKey, std::vector<Key> *keys,
+                           std::vector<Val> *vals) {
+    if (!gBatchLookupSupported) return false;
+
+    keys->clear();
+    vals->clear();
+    std::vector<Key> batchKeys(kLookupBatchSize);
+    std::vector<Val> batchVals(kLookupBatchSize * valsPerKey);
+    // The batch token of hash maps is a bucket index, which fits in 8 bytes.
+    uint64_t inBatch = 0, outBatch = 0;
+    for (bool first = true;; first = false) {
+        bpf_map_batch_attr attr = {
+                .in_batch = first ? 0 : reinterpret_cast<uint64_t>(&inBatch),
+                .out_batch = reinterpret_cast<uint64_t>(&outBatch),
+                .keys = reinterpret_cast<uint64_t>(batchKeys.data()),
+                .values = reinterpret_cast<uint64_t>(batchVals.data()),
+                .count = kLookupBatchSize,
+                .map_fd = static_cast<uint32_t>(mapFd),
+                .elem_flags = 0,
+                .flags = 0,
+        };
+        int ret = syscall(__NR_bpf, kBpfMapLookupBatch, &attr, sizeof(attr));
+        if (ret && errno != ENOENT) {
+            if (errno == EINVAL || errno == ENOTSUP || errno == ENOSYS) {
+                gBatchLookupSupported = false;
+            }
+            return false;
+        }
+        keys->insert(keys->end(), batchKeys.begin(), batchKeys.begin() + attr.count);
+        vals->insert(vals->end(), batchVals.begin(), batchVals.begin() + attr.count * valsPerKey);
+        // ENOENT means that this was the last batch.
+        if (ret) return true;
+        inBatch = outBatch;
+    }
+}
+
+// Call func with each entry of a per-CPU map keyed by time_key_t, skipping the UIDs for which
+// wanted returns false, if wanted is set. Returns false on error, including when func or wanted
+// return false or no value.
+template <class Val>
+static bool forEachTimeMapEntry(int mapFd,
+                                const std::function<std::optional<bool>(uint32_t)> &wanted,
+                                const std::function<void(const time_key_t &, const Val *)> &func) {
+    std::vector<time_key_t> keys;
+    std::vector<Val> vals;
+    if (lookupMapBatch(mapFd, gNCpus, &keys, &vals)) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (wanted) {
+                auto keep = wanted(keys[i].uid);
+                if (!keep.has_value()) return false;
+                if (!*keep) continue;
+            }
+            func(keys[i], &vals[i * gNCpus]);
+        }
+        return true;
+    }
+
+    time_key_t key, prevKey;
+    if (getFirstMapKey(mapFd, &key)) return errno == ENOENT;
+    vals.resize(gNCpus);
+    do {
+        if (wanted) {
+            auto keep = wanted(key.uid);
+            if (!keep.has_value()) return false;
+            if (!*keep) continue;
+        }
+        if (findMapEntry(mapFd, &key, vals.data())) return false;
+        func(key, vals.data());
+    } while (prevKey = key, !getNextMapKey(mapFd, &prevKey, &key));
+    return errno == ENOENT;
+}
+
 static int isPolicyFile(const struct dirent *d) {
     return android::base::StartsWith(d->d_name, "policy");
 }
@@ -272,9 +373,16 @@ std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t ui
 }
 
 static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
-                                           uint64_t *newLastUpdate) {
+                                           uint64_t *newLastUpdate,
+                                           const std::unordered_map<uint32_t, uint64_t> *cache) {
     uint64_t uidLastUpdate;
-    if (findMapEntry(gUidLastUpdateMapFd, &uid, &uidLastUpdate)) return {};
+    if (cache) {
+        auto it = cache->find(uid);
+        if (it == cache->end()) return {};
+        uidLastUpdate = it->second;
+    } else if (findMapEntry(gUidLastUpdateMapFd, &uid, &uidLastUpdate)) {
+        return {};
+    }
     // Updates that occurred during the previous read may have been missed. To mitigate
     // this, don't ignore entries updated up to 1s before *lastUpdate
     constexpr uint64_t NSEC_PER_SEC = 1000000000;
@@ -283,6 +391,24 @@ static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
     return true;
 }
 
+// Return a filter for forEachTimeMapEntry that keeps the UIDs updated since lastUpdate, and sets
+// *newLastUpdate to the latest update among them. The last update times are read in batches
+// into *cache when the kernel allows it, instead of being looked up for every entry.
+static std::function<std::optional<bool>(uint32_t)> updatedSinceFilter(
+        const uint64_t *lastUpdate, uint64_t *newLastUpdate,
+        std::unordered_map<uint32_t, uint64_t> *cache) {
+    if (!lastUpdate) return nullptr;
+
+    std::vector<uint32_t> uids;
+    std::vector<uint64_t> updates;
+    const std::unordered_map<uint32_t, uint64_t> *cachePtr = nullptr;
+    if (lookupMapBatch(gUidLastUpdateMapFd, 1, &uids, &updates)) {
+        for (size_t i = 0; i < uids.size(); ++i) cache->emplace(uids[i], updates[i]);
+        cachePtr = cache;
+    }
+    return [=](uint32_t uid) { return uidUpdatedSince(uid, *lastUpdate, newLastUpdate, cachePtr); };
+}
+
 // Retrieve the times in ns that each uid spent running at each CPU freq.
 // Return contains no value on error, otherwise it contains a map from uids to vectors of vectors
 // using the format:
@@ -300,25 +426,15 @@ getUidsCpuFreqTimes() {
 std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
 getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> map;
-    if (getFirstMapKey(gTisMapFd, &key)) {
-        if (errno == ENOENT) return map;
-        return std::nullopt;
-    }
 
     std::vector<std::vector<uint64_t>> mapFormat;
     for (const auto &freqList : gPolicyFreqs) mapFormat.emplace_back(freqList.size(), 0);
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    std::vector<tis_val_t> vals(gNCpus);
-    do {
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gTisMapFd, &key, vals.data())) return {};
+    std::unordered_map<uint32_t, uint64_t> lastUpdates;
+    auto wanted = updatedSinceFilter(lastUpdate, &newLastUpdate, &lastUpdates);
+    auto addEntry = [&](const time_key_t &key, const tis_val_t *vals) {
         if (map.find(key.uid) == map.end()) map.emplace(key.uid, mapFormat);
 
         auto offset = key.bucket * FREQS_PER_ENTRY;
@@ -332,9 +448,8 @@ getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
                 std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
             }
         }
-        prevKey = key;
-    } while (prevKey = key, !getNextMapKey(gTisMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    };
+    if (!forEachTimeMapEntry<tis_val_t>(gTisMapFd, wanted, addEntry)) return {};
     if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
     return map;
 }
@@ -410,27 +525,17 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsConcurrent
 std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedConcurrentTimes(
         uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, concurrent_time_t> ret;
-    if (getFirstMapKey(gConcurrentMapFd, &key)) {
-        if (errno == ENOENT) return ret;
-        return {};
-    }
 
     concurrent_time_t retFormat = {.active = std::vector<uint64_t>(gNCpus, 0)};
     for (const auto &cpuList : gPolicyCpus) retFormat.policy.emplace_back(cpuList.size(), 0);
 
-    std::vector<concurrent_val_t> vals(gNCpus);
     std::vector<uint64_t>::iterator activeBegin, activeEnd, policyBegin, policyEnd;
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    do {
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) return {};
+    std::unordered_map<uint32_t, uint64_t> lastUpdates;
+    auto wanted = updatedSinceFilter(lastUpdate, &newLastUpdate, &lastUpdates);
+    auto addEntry = [&](const time_key_t &key, const concurrent_val_t *vals) {
         if (ret.find(key.uid) == ret.end()) ret.emplace(key.uid, retFormat);
 
         auto offset = key.bucket * CPUS_PER_ENTRY;
@@ -455,8 +560,8 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
                                std::plus<uint64_t>());
             }
         }
-    } while (prevKey = key, !getNextMapKey(gConcurrentMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    };
+    if (!forEachTimeMapEntry<concurrent_val_t>(gConcurrentMapFd, wanted, addEntry)) return {};
     for (const auto &[key, value] : ret) {
         if (!verifyConcurrentTimes(value)) {
             auto val = getUidConcurrentTimes(key, false);
@@ -467,6 +572,80 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
     return ret;
 }
 
+// Parse a /proc/<pid>/task/<tid>/time_in_state file, which lists for each policy, under a
+// "cpu<first cpu of the policy>" line, "<freq> <clock ticks>" lines.
+// Return format is the same as getUidCpuFreqTimes().
+static std::optional<std::vector<std::vector<uint64_t>>> readTaskTimeInState(
+        const std::string &path) {
+    std::string data;
+    if (!android::base::ReadFileToString(path, &data)) return {};
+
+    static const uint64_t nsPerTick = 1000000000 / sysconf(_SC_CLK_TCK);
+    std::vector<std::vector<uint64_t>> out;
+    for (const auto &freqList : gPolicyFreqs) out.emplace_back(freqList.size(), 0);
+
+    std::optional<uint32_t> policy;
+    for (const auto &line : android::base::Split(data, "\n")) {
+        if (line.empty()) continue;
+        uint32_t cpu;
+        if (sscanf(line.c_str(), "cpu%" SCNu32, &cpu) == 1) {
+            policy.reset();
+            for (uint32_t i = 0; i < gNPolicies; ++i) {
+                const auto &cpus = gPolicyCpus[i];
+                if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) policy = i;
+            }
+            continue;
+        }
+        uint32_t freq;
+        uint64_t ticks;
+        if (sscanf(line.c_str(), "%" SCNu32 " %" SCNu64, &freq, &ticks) != 2) return {};
+        if (!policy.has_value()) continue;
+        const auto &freqs = gPolicyFreqs[*policy];
+        auto it = std::lower_bound(freqs.begin(), freqs.end(), freq);
+        if (it == freqs.end() || *it != freq) continue;
+        out[*policy][it - freqs.begin()] += ticks * nsPerTick;
+    }
+    return out;
+}
+
+// Retrieve the times in ns that thread tid of process pid spent running at each CPU frequency.
+// Unlike the uid times, these are read from /proc rather than from BPF maps, so they need no
+// tracking, and have the resolution of the scheduler clock tick.
+// Return contains no value on error, including when the kernel does not report per-thread times.
+// Otherwise the format is the same as getUidCpuFreqTimes().
+std::optional<std::vector<std::vector<uint64_t>>> getTidCpuFreqTimes(pid_t pid, pid_t tid) {
+    if (!gInitialized && !initGlobals()) return {};
+    return readTaskTimeInState(StringPrintf("/proc/%d/task/%d/time_in_state", pid, tid));
+}
+
+// Retrieve the times in ns that each thread of process pid spent running at each CPU frequency,
+// to measure selected processes, such as the threads of a compositor, without tracing them.
+// Return contains no value on error, otherwise it contains a map from tids to vectors of vectors
+// in the format of getUidCpuFreqTimes(). Threads that exit while the process is read are left out.
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>> getPidCpuFreqTimes(
+        pid_t pid) {
+    if (!gInitialized && !initGlobals()) return {};
+
+    std::string taskDir = StringPrintf("/proc/%d/task", pid);
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(taskDir.c_str()), closedir);
+    if (!dir) return {};
+
+    std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>> ret;
+    while (struct dirent *entry = readdir(dir.get())) {
+        pid_t tid;
+        if (!android::base::ParseInt(entry->d_name, &tid)) continue;
+        auto times = readTaskTimeInState(taskDir + "/" + entry->d_name + "/time_in_state");
+        if (!times.has_value()) {
+            // The thread exited, or the kernel does not report per-thread times.
+            if (errno == ENOENT || errno == ESRCH) continue;
+            return {};
+        }
+        ret.emplace(tid, std::move(*times));
+    }
+    if (ret.empty()) return {};
+    return ret;
+}
+
 // Clear all time in state data for a given uid. Returns false on error, true otherwise.
 // This is only suitable for clearing data when an app is uninstalled; if called on a UID with
 // running tasks it will cause time in state vs. concurrent time totals to be inconsistent for that
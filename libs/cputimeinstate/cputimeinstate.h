@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 #include <unordered_map>
 #include <vector>
 
@@ -29,6 +31,9 @@ std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
 std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
     getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate);
 std::optional<std::vector<std::vector<uint32_t>>> getCpuFreqs();
+std::optional<std::vector<std::vector<uint64_t>>> getTidCpuFreqTimes(pid_t pid, pid_t tid);
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>>
+    getPidCpuFreqTimes(pid_t pid);
 
 struct concurrent_time_t {
     std::vector<uint64_t> active;
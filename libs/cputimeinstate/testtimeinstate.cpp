@@ -18,8 +18,10 @@
 #include <bpf_timeinstate.h>
 
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
 #include <numeric>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -482,5 +484,32 @@ TEST(TimeInStateTest, GetCpuFreqs) {
     for (size_t i = 0; i < freqs->size(); ++i) EXPECT_EQ((*freqs)[i].size(), (*times)[i].size());
 }
 
+TEST(TimeInStateTest, SingleTidTimeInState) {
+    auto freqs = getCpuFreqs();
+    ASSERT_TRUE(freqs.has_value());
+
+    auto times = getTidCpuFreqTimes(getpid(), gettid());
+    ASSERT_TRUE(times.has_value());
+    ASSERT_EQ(freqs->size(), times->size());
+    uint64_t total = 0;
+    for (size_t i = 0; i < freqs->size(); ++i) {
+        EXPECT_EQ((*freqs)[i].size(), (*times)[i].size());
+        total += std::accumulate((*times)[i].begin(), (*times)[i].end(), (uint64_t)0);
+    }
+    EXPECT_LT(total, NSEC_PER_YEAR);
+}
+
+TEST(TimeInStateTest, PidTimeInStateHasAllThreads) {
+    std::thread thread([] {
+        auto times = getPidCpuFreqTimes(getpid());
+        ASSERT_TRUE(times.has_value());
+        EXPECT_NE(times->find(getpid()), times->end());
+        EXPECT_NE(times->find(gettid()), times->end());
+    });
+    thread.join();
+
+    EXPECT_FALSE(getPidCpuFreqTimes(-1).has_value());
+}
+
 } // namespace bpf
 } // namespace android
@@ -110,22 +110,27 @@ bool should_dump_hal_interface(const std::string& interface) {
     return extra_hal_interfaces_to_dump.find(interface) != extra_hal_interfaces_to_dump.end();
 }
 
-bool should_dump_native_traces(const char* path) {
-    for (const char** p = native_processes_to_dump; *p; p++) {
-        if (!strcmp(*p, path)) {
-            return true;
+// Called for every process on the device, so the lists are only matched after being copied into
+// a set on first use, together with the ro.debuggable check.
+static const std::set<std::string>& get_native_processes_to_dump() {
+    static const std::set<std::string> processes = [] {
+        std::set<std::string> processes;
+        for (const char** p = native_processes_to_dump; *p; p++) {
+            processes.insert(*p);
         }
-    }
-
-    if (android::base::GetBoolProperty("ro.debuggable", false)) {
-        for (const char** p = debuggable_native_processes_to_dump; *p; p++) {
-            if (!strcmp(*p, path)) {
-                return true;
+        if (android::base::GetBoolProperty("ro.debuggable", false)) {
+            for (const char** p = debuggable_native_processes_to_dump; *p; p++) {
+                processes.insert(*p);
             }
         }
-    }
+        return processes;
+    }();
+    return processes;
+}
 
-    return false;
+bool should_dump_native_traces(const char* path) {
+    const std::set<std::string>& processes = get_native_processes_to_dump();
+    return processes.find(path) != processes.end();
 }
 
 std::set<int> get_interesting_hal_pids() {
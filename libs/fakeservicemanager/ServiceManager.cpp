@@ -33,6 +33,15 @@ sp<IBinder> ServiceManager::checkService( const String16& name) const {
     return it->second;
 }
 
+Vector<sp<IBinder>> ServiceManager::checkServices(const Vector<String16>& names) const {
+    Vector<sp<IBinder>> out;
+    out.setCapacity(names.size());
+    for (const String16& name : names) {
+        out.push(checkService(name));
+    }
+    return out;
+}
+
 status_t ServiceManager::addService(const String16& name, const sp<IBinder>& service,
                                 bool /*allowIsolated*/,
                                 int /*dumpsysFlags*/) {
@@ -40,6 +40,11 @@ public:
      */
     sp<IBinder> checkService( const String16& name) const override;
 
+    /**
+     * Retrieve several existing services, non-blocking.
+     */
+    Vector<sp<IBinder>> checkServices(const Vector<String16>& names) const override;
+
     /**
      * Register a service.
      */
@@ -22,10 +22,15 @@
 #include <graphicsenv/GraphicsEnv.h>
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <android-base/file.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android/dlext.h>
 #include <binder/IServiceManager.h>
@@ -453,20 +458,82 @@ void GraphicsEnv::updateUseAngle() {
         ALOGV("User set \"Developer Options\" to force the use of Native");
         mUseAngle = NO;
     } else {
-        // The "Developer Options" value wasn't set to force the use of ANGLE.  Need to temporarily
-        // load ANGLE and call the updatable opt-in/out logic:
+        // The "Developer Options" value wasn't set to force the use of ANGLE.  Reuse the answer
+        // of a previous launch if nothing it depends on changed, otherwise temporarily load ANGLE
+        // and call the updatable opt-in/out logic:
+        const std::string cacheKey = angleRulesCacheKey();
+        bool useAngle = false;
+        if (readAngleRulesCache(cacheKey, &useAngle)) {
+            ALOGV("Using the cached ANGLE opt-in/out decision");
+            mUseAngle = useAngle ? YES : NO;
+            return;
+        }
+
         void* featureSo = loadLibrary("feature_support");
         if (featureSo) {
             ALOGV("loaded ANGLE's opt-in/out logic from namespace");
             mUseAngle = checkAngleRules(featureSo) ? YES : NO;
             dlclose(featureSo);
             featureSo = nullptr;
+            writeAngleRulesCache(cacheKey, mUseAngle == YES);
         } else {
             ALOGV("Could not load the ANGLE opt-in/out logic, cannot use ANGLE.");
         }
     }
 }
 
+std::string GraphicsEnv::angleRulesCacheKey() {
+    char manufacturer[PROPERTY_VALUE_MAX];
+    char model[PROPERTY_VALUE_MAX];
+    property_get("ro.product.manufacturer", manufacturer, "UNSET");
+    property_get("ro.product.model", model, "UNSET");
+
+    // FNV-1a, which unlike std::hash is the same from one build of the platform to the next.
+    uint64_t rulesHash = 0xcbf29ce484222325ULL;
+    for (char c : mRulesBuffer) {
+        rulesHash = (rulesHash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+
+    // The ANGLE path changes whenever the ANGLE package is updated, which may change how the
+    // rules are evaluated.
+    return android::base::StringPrintf("%d\n%s\n%s\n%s\n%s\n%016" PRIx64 "\n",
+                                       CURRENT_ANGLE_API_VERSION, mAnglePath.c_str(),
+                                       mAngleAppName.c_str(), manufacturer, model, rulesHash);
+}
+
+bool GraphicsEnv::readAngleRulesCache(const std::string& key, bool* useAngle) {
+    if (mAngleRulesCachePath.empty()) {
+        return false;
+    }
+
+    std::string contents;
+    if (!android::base::ReadFileToString(mAngleRulesCachePath, &contents) ||
+        contents.size() != key.size() + 1 || contents.compare(0, key.size(), key) != 0) {
+        return false;
+    }
+    *useAngle = contents.back() == '1';
+    return true;
+}
+
+void GraphicsEnv::writeAngleRulesCache(const std::string& key, bool useAngle) {
+    if (mAngleRulesCachePath.empty()) {
+        return;
+    }
+
+    // Go through a temporary file so that a process dying halfway never leaves a partial entry.
+    const std::string tmpPath = mAngleRulesCachePath + ".tmp";
+    if (!android::base::WriteStringToFile(key + (useAngle ? '1' : '0'), tmpPath) ||
+        rename(tmpPath.c_str(), mAngleRulesCachePath.c_str()) != 0) {
+        ALOGW("Failed to write the ANGLE rules cache '%s': %s", mAngleRulesCachePath.c_str(),
+              strerror(errno));
+        unlink(tmpPath.c_str());
+    }
+}
+
+void GraphicsEnv::setAngleRulesCachePath(const std::string path) {
+    mAngleRulesCachePath = path;
+}
+
 void GraphicsEnv::setAngleInfo(const std::string path, const std::string appName,
                                const std::string developerOptIn, const int rulesFd,
                                const long rulesOffset, const long rulesLength) {
@@ -526,6 +593,14 @@ const std::string& GraphicsEnv::getLayerPaths() {
     return mLayerPaths;
 }
 
+void GraphicsEnv::setLayerIndexPath(const std::string path) {
+    mLayerIndexPath = path;
+}
+
+const std::string& GraphicsEnv::getLayerIndexPath() {
+    return mLayerIndexPath;
+}
+
 const std::string& GraphicsEnv::getDebugLayers() {
     return mDebugLayers;
 }
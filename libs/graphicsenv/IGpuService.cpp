@@ -81,6 +81,19 @@ public:
         }
         return driverPath;
     }
+
+    uint64_t getGpuMemoryTotal(int32_t pid) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        data.writeInt32(pid);
+
+        status_t error = remote()->transact(BnGpuService::GET_GPU_MEMORY_TOTAL, data, &reply);
+        uint64_t total = 0;
+        if (error == OK) {
+            error = reply.readUint64(&total);
+        }
+        return total;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.graphicsenv.IGpuService");
@@ -162,6 +175,14 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
             std::string driverPath = getUpdatableDriverPath();
             return reply->writeUtf8AsUtf16(driverPath);
         }
+        case GET_GPU_MEMORY_TOTAL: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            int32_t pid;
+            if ((status = data.readInt32(&pid)) != OK) return status;
+
+            return reply->writeUint64(getGpuMemoryTotal(pid));
+        }
         case SHELL_COMMAND_TRANSACTION: {
             int in = data.readFileDescriptor();
             int out = data.readFileDescriptor();
@@ -98,6 +98,10 @@ public:
     //     /system/app/ANGLEPrebuilt/ANGLEPrebuilt.apk!/lib/arm64-v8a
     void setAngleInfo(const std::string path, const std::string appName, std::string devOptIn,
                       const int rulesFd, const long rulesOffset, const long rulesLength);
+    // Set the file the result of evaluating the ANGLE rules is kept in, so that later launches
+    // of the app with the same rules and ANGLE package skip loading ANGLE to evaluate them.
+    // Must be called before setAngleInfo().
+    void setAngleRulesCachePath(const std::string path);
     // Get the ANGLE driver namespace.
     android_namespace_t* getAngleNamespace();
     // Get the app name for ANGLE debug message.
@@ -112,6 +116,10 @@ public:
     NativeLoaderNamespace* getAppNamespace();
     // Get additional layer search paths.
     const std::string& getLayerPaths();
+    // Set the file the Vulkan loader keeps its index of layer libraries in.
+    void setLayerIndexPath(const std::string path);
+    // Get the file the Vulkan loader keeps its index of layer libraries in.
+    const std::string& getLayerIndexPath();
     // Set the Vulkan debug layers.
     void setDebugLayers(const std::string layers);
     // Set the GL debug layers.
@@ -130,6 +138,12 @@ private:
     bool checkAngleRules(void* so);
     // Update whether ANGLE should be used.
     void updateUseAngle();
+    // Key of the ANGLE rules decision, covering everything the rules are evaluated against.
+    std::string angleRulesCacheKey();
+    // Read the cached ANGLE rules decision for key, if there is one.
+    bool readAngleRulesCache(const std::string& key, bool* useAngle);
+    // Cache the ANGLE rules decision for key.
+    void writeAngleRulesCache(const std::string& key, bool useAngle);
     // Link updatable driver namespace with llndk and vndk-sp libs.
     bool linkDriverNamespaceLocked(android_namespace_t* vndkNamespace);
     // Check whether this process is ready to send stats.
@@ -158,12 +172,16 @@ private:
     std::vector<char> mRulesBuffer;
     // Use ANGLE flag.
     UseAngle mUseAngle = UNKNOWN;
+    // File caching the result of the ANGLE rules.
+    std::string mAngleRulesCachePath;
     // Vulkan debug layers libs.
     std::string mDebugLayers;
     // GL debug layers libs.
     std::string mDebugLayersGLES;
     // Additional debug layers search path.
     std::string mLayerPaths;
+    // Index of the layers found in the search paths, kept across app starts.
+    std::string mLayerIndexPath;
     // This mutex protects the namespace creation.
     std::mutex mNamespaceMutex;
     // Updatable driver namespace.
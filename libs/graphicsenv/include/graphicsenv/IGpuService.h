@@ -46,6 +46,9 @@ public:
     // setter and getter for updatable driver path.
     virtual void setUpdatableDriverPath(const std::string& driverPath) = 0;
     virtual std::string getUpdatableDriverPath() = 0;
+
+    // get the GPU memory of a process in bytes, summed over all GPUs.
+    virtual uint64_t getGpuMemoryTotal(int32_t pid) = 0;
 };
 
 class BnGpuService : public BnInterface<IGpuService> {
@@ -55,6 +58,7 @@ public:
         SET_TARGET_STATS,
         SET_UPDATABLE_DRIVER_PATH,
         GET_UPDATABLE_DRIVER_PATH,
+        GET_GPU_MEMORY_TOTAL,
         // Always append new enum to the end.
     };
 
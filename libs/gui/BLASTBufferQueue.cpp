@@ -138,6 +138,33 @@ void BLASTBufferQueue::update(const sp<SurfaceControl>& surface, int width, int
     }
 }
 
+status_t BLASTBufferQueue::setMaxInFlightTransactions(int32_t count) {
+    std::unique_lock _lock{mMutex};
+    if (count < 1) {
+        return BAD_VALUE;
+    }
+
+    // One buffer more than the limit stays acquired until the next callback returns its release
+    // fence, which BufferQueue already accounts for.
+    status_t status = mBufferItemConsumer->setMaxAcquiredBufferCount(count);
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    const int32_t previousCount = mMaxAcquiredBuffers;
+    mMaxAcquiredBuffers = count;
+    // Frames held back by the previous limit can be submitted right away.
+    for (int32_t i = previousCount; i < count; i++) {
+        processNextBufferLocked(false);
+    }
+    mCallbackCV.notify_all();
+    return NO_ERROR;
+}
+
+bool BLASTBufferQueue::maxBuffersAcquired() const {
+    return mNumAcquired >= mMaxAcquiredBuffers + 1;
+}
+
 static void transactionCallbackThunk(void* context, nsecs_t latchTime,
                                      const sp<Fence>& presentFence,
                                      const std::vector<SurfaceControlStats>& stats) {
@@ -195,7 +222,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
 
 void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
     ATRACE_CALL();
-    if (mNumFrameAvailable == 0 || mNumAcquired == MAX_ACQUIRED_BUFFERS + 1) {
+    if (mNumFrameAvailable == 0 || maxBuffersAcquired()) {
         return;
     }
 
@@ -269,7 +296,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& /*item*/) {
     std::unique_lock _lock{mMutex};
 
     if (mNextTransaction != nullptr) {
-        while (mNumFrameAvailable > 0 || mNumAcquired == MAX_ACQUIRED_BUFFERS + 1) {
+        while (mNumFrameAvailable > 0 || maxBuffersAcquired()) {
             mCallbackCV.wait(_lock);
         }
     }
@@ -17,12 +17,18 @@
 #include <private/gui/BitTube.h>
 
 #include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
+
+#include <cutils/ashmem.h>
 #include <utils/Errors.h>
 
 #include <binder/Parcel.h>
@@ -40,10 +46,22 @@ BitTube::BitTube(size_t bufsize) {
 
 BitTube::BitTube(DefaultSizeType) : BitTube(DEFAULT_SOCKET_BUFFER_SIZE) {}
 
+BitTube::BitTube(Type type, size_t bufsize) : mType(type) {
+    if (type == Type::SharedRing) {
+        initRing(bufsize);
+    } else {
+        init(bufsize, bufsize);
+    }
+}
+
 BitTube::BitTube(const Parcel& data) {
     readFromParcel(&data);
 }
 
+BitTube::~BitTube() {
+    unmapRing();
+}
+
 void BitTube::init(size_t rcvbuf, size_t sndbuf) {
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) == 0) {
@@ -63,6 +81,62 @@ void BitTube::init(size_t rcvbuf, size_t sndbuf) {
     }
 }
 
+void BitTube::initRing(size_t capacity) {
+    uint32_t ringCapacity = kRecordAlignment;
+    while (ringCapacity < capacity && ringCapacity < (1u << 30)) {
+        ringCapacity <<= 1;
+    }
+
+    base::unique_fd ringFd(ashmem_create_region("BitTube ring", sizeof(RingHeader) + ringCapacity));
+    base::unique_fd eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (ringFd < 0 || eventFd < 0) {
+        mReceiveFd.reset();
+        ALOGE("BitTube: ring creation failed (%s)", strerror(errno));
+        return;
+    }
+    mRingFd = std::move(ringFd);
+    mSendFd.reset(dup(eventFd));
+    mReceiveFd = std::move(eventFd);
+    if (!mapRing()) {
+        mReceiveFd.reset();
+    }
+}
+
+bool BitTube::mapRing() {
+    if (mRing) {
+        return true;
+    }
+    // The size is taken from the region rather than from the other process.
+    const int size = ashmem_get_size_region(mRingFd);
+    const size_t capacity = size > 0 ? static_cast<size_t>(size) - sizeof(RingHeader) : 0;
+    if (size <= static_cast<int>(sizeof(RingHeader)) || (capacity & (capacity - 1)) != 0 ||
+        capacity % kRecordAlignment != 0) {
+        ALOGE("BitTube: invalid ring size %d", size);
+        return false;
+    }
+    void* ring = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mRingFd, 0);
+    if (ring == MAP_FAILED) {
+        ALOGE("BitTube: can't map ring (%s)", strerror(errno));
+        return false;
+    }
+    mRing = static_cast<RingHeader*>(ring);
+    mRingCapacity = static_cast<uint32_t>(capacity);
+    // Pick up where the ring is, in case messages were sent before the receive end was moved
+    // here. The offsets are checked against each other before they are used.
+    mRingHead = mRing->head.load(std::memory_order_relaxed);
+    mRingTail = mRing->tail.load(std::memory_order_relaxed);
+    return true;
+}
+
+void BitTube::unmapRing() {
+    if (mRing) {
+        munmap(mRing, sizeof(RingHeader) + mRingCapacity);
+        mRing = nullptr;
+        mRingCapacity = 0;
+    }
+}
+
 status_t BitTube::initCheck() const {
     if (mReceiveFd < 0) {
         return status_t(mReceiveFd);
@@ -90,7 +164,21 @@ void BitTube::setSendFd(base::unique_fd&& sendFd) {
     mSendFd = std::move(sendFd);
 }
 
+status_t BitTube::moveReceiveEnd(BitTube* outTube) {
+    outTube->mType = mType;
+    outTube->setReceiveFd(moveReceiveFd());
+    if (mType == Type::Socket) {
+        outTube->setSendFd(base::unique_fd(dup(mSendFd)));
+        return NO_ERROR;
+    }
+    outTube->mRingFd.reset(dup(mRingFd));
+    return outTube->mRingFd < 0 ? -errno : NO_ERROR;
+}
+
 ssize_t BitTube::write(void const* vaddr, size_t size) {
+    if (mType == Type::SharedRing) {
+        return writeRing(vaddr, size);
+    }
     ssize_t err, len;
     do {
         len = ::send(mSendFd, vaddr, size, MSG_DONTWAIT | MSG_NOSIGNAL);
@@ -101,6 +189,9 @@ ssize_t BitTube::write(void const* vaddr, size_t size) {
 }
 
 ssize_t BitTube::read(void* vaddr, size_t size) {
+    if (mType == Type::SharedRing) {
+        return readRing(vaddr, size);
+    }
     ssize_t err, len;
     do {
         len = ::recv(mReceiveFd, vaddr, size, MSG_DONTWAIT);
@@ -114,10 +205,126 @@ ssize_t BitTube::read(void* vaddr, size_t size) {
     return err == 0 ? len : -err;
 }
 
+ssize_t BitTube::writeRing(void const* vaddr, size_t size) {
+    if (!mapRing()) {
+        return -EPIPE;
+    }
+    const uint32_t recordSize = static_cast<uint32_t>(
+            (sizeof(RecordHeader) + size + kRecordAlignment - 1) & ~(kRecordAlignment - 1));
+    if (size > mRingCapacity || recordSize > mRingCapacity) {
+        return -EMSGSIZE;
+    }
+
+    const uint32_t used = mRingHead - mRing->tail.load(std::memory_order_acquire);
+    if (used > mRingCapacity || used % kRecordAlignment != 0) {
+        ALOGE("BitTube: ring corrupted by the receiver");
+        return -EPIPE;
+    }
+    // A message that does not fit before the end of the ring goes to its start, behind a record
+    // that fills the rest.
+    const uint32_t offset = mRingHead & (mRingCapacity - 1);
+    const uint32_t untilEnd = mRingCapacity - offset;
+    const uint32_t wrapSize = recordSize > untilEnd ? untilEnd : 0;
+    if (mRingCapacity - used < wrapSize + recordSize) {
+        return -EAGAIN;
+    }
+
+    uint8_t* const ring = reinterpret_cast<uint8_t*>(mRing + 1);
+    uint32_t head = mRingHead;
+    if (wrapSize > 0) {
+        RecordHeader wrap{.size = kWrapRecordSize};
+        memcpy(ring + offset, &wrap, sizeof(wrap));
+        head += wrapSize;
+    }
+    RecordHeader record{.size = static_cast<uint32_t>(size)};
+    uint8_t* const dest = ring + (head & (mRingCapacity - 1));
+    memcpy(dest, &record, sizeof(record));
+    memcpy(dest + sizeof(record), vaddr, size);
+    mRingHead = head + recordSize;
+    mRing->head.store(mRingHead, std::memory_order_release);
+
+    const uint64_t signal = 1;
+    TEMP_FAILURE_RETRY(::write(mSendFd, &signal, sizeof(signal)));
+    return static_cast<ssize_t>(size);
+}
+
+ssize_t BitTube::popRing(void* vaddr, size_t size) {
+    const uint8_t* const ring = reinterpret_cast<const uint8_t*>(mRing + 1);
+    while (true) {
+        const uint32_t available = mRing->head.load(std::memory_order_acquire) - mRingTail;
+        if (available == 0) {
+            return 0;
+        }
+        if (available > mRingCapacity || available < sizeof(RecordHeader)) {
+            ALOGE("BitTube: ring corrupted by the sender");
+            return -EPIPE;
+        }
+
+        const uint32_t offset = mRingTail & (mRingCapacity - 1);
+        RecordHeader record;
+        memcpy(&record, ring + offset, sizeof(record));
+        if (record.size == kWrapRecordSize) {
+            mRingTail += mRingCapacity - offset;
+            continue;
+        }
+
+        const uint32_t recordSize = static_cast<uint32_t>(
+                (sizeof(RecordHeader) + record.size + kRecordAlignment - 1) &
+                ~(kRecordAlignment - 1));
+        if (record.size > mRingCapacity || recordSize > available ||
+            recordSize > mRingCapacity - offset) {
+            ALOGE("BitTube: ring corrupted by the sender");
+            return -EPIPE;
+        }
+        // As with a SOCK_SEQPACKET socket, the excess of a message larger than the buffer is
+        // discarded.
+        const size_t copied = std::min<size_t>(record.size, size);
+        memcpy(vaddr, ring + offset + sizeof(record), copied);
+        mRingTail += recordSize;
+        mRing->tail.store(mRingTail, std::memory_order_release);
+        return static_cast<ssize_t>(copied);
+    }
+}
+
+ssize_t BitTube::readRing(void* vaddr, size_t size) {
+    if (!mapRing()) {
+        return -EPIPE;
+    }
+    ssize_t len = popRing(vaddr, size);
+    if (len != 0) {
+        return len;
+    }
+
+    // The ring is empty, so clear the eventfd to stop polling from waking up the receiver. The
+    // sender may have written just before that, so look again, and keep the eventfd signalled if
+    // there is something to read after all.
+    uint64_t signals;
+    TEMP_FAILURE_RETRY(::read(mReceiveFd, &signals, sizeof(signals)));
+    len = popRing(vaddr, size);
+    if (len > 0) {
+        const uint64_t signal = 1;
+        TEMP_FAILURE_RETRY(::write(mReceiveFd, &signal, sizeof(signal)));
+    }
+    return len;
+}
+
 status_t BitTube::writeToParcel(Parcel* reply) const {
     if (mReceiveFd < 0) return -EINVAL;
 
-    status_t result = reply->writeDupFileDescriptor(mReceiveFd);
+    status_t result = reply->writeInt32(static_cast<int32_t>(mType));
+    if (result != NO_ERROR) {
+        return result;
+    }
+    if (mType == Type::SharedRing) {
+        result = reply->writeDupFileDescriptor(mReceiveFd);
+        mReceiveFd.reset();
+        if (result != NO_ERROR) {
+            return result;
+        }
+        return reply->writeDupFileDescriptor(mRingFd);
+    }
+
+    result = reply->writeDupFileDescriptor(mReceiveFd);
     mReceiveFd.reset();
     if (result != NO_ERROR) {
         return result;
@@ -128,6 +335,19 @@ status_t BitTube::writeToParcel(Parcel* reply) const {
 }
 
 status_t BitTube::readFromParcel(const Parcel* parcel) {
+    int32_t type;
+    status_t result = parcel->readInt32(&type);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    if (type != static_cast<int32_t>(Type::Socket) &&
+        type != static_cast<int32_t>(Type::SharedRing)) {
+        ALOGE("BitTube::readFromParcel: unknown type %d", type);
+        return BAD_VALUE;
+    }
+    mType = static_cast<Type>(type);
+    unmapRing();
+
     mReceiveFd.reset(dup(parcel->readFileDescriptor()));
     if (mReceiveFd < 0) {
         mReceiveFd.reset();
@@ -135,6 +355,16 @@ status_t BitTube::readFromParcel(const Parcel* parcel) {
         ALOGE("BitTube::readFromParcel: can't dup file descriptor (%s)", strerror(error));
         return -error;
     }
+    if (mType == Type::SharedRing) {
+        mRingFd.reset(dup(parcel->readFileDescriptor()));
+        if (mRingFd < 0) {
+            mRingFd.reset();
+            int error = errno;
+            ALOGE("BitTube::readFromParcel: can't dup file descriptor (%s)", strerror(error));
+            return -error;
+        }
+        return mapRing() ? NO_ERROR : BAD_VALUE;
+    }
     mSendFd.reset(dup(parcel->readFileDescriptor()));
     if (mSendFd < 0) {
         mSendFd.reset();
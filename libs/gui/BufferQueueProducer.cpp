@@ -1004,6 +1004,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
         output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
         output->nextFrameNumber = mCore->mFrameCounter + 1;
+        output->minUndequeuedBufferCount = mCore->getMinUndequeuedBufferCountLocked();
 
         ATRACE_INT(mCore->mConsumerName.string(),
                 static_cast<int32_t>(mCore->mQueue.size()));
@@ -1285,6 +1286,9 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
         mCore->mDequeueBufferCannotBlock = mDequeueTimeout < 0;
         mCore->mQueueBufferCanDrop = mDequeueTimeout <= 0;
     }
+    if (status == NO_ERROR) {
+        output->minUndequeuedBufferCount = mCore->getMinUndequeuedBufferCountLocked();
+    }
 
     mCore->mAllowAllocation = true;
     VALIDATE_CONSISTENCY();
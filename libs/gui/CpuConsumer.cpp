@@ -149,18 +149,28 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
 }
 
 status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
-    status_t err;
-
     if (!nativeBuffer) return BAD_VALUE;
 
     Mutex::Autolock _l(mMutex);
 
+    if (mHasPrelockedBuffer) {
+        *nativeBuffer = mPrelockedBuffer;
+        mHasPrelockedBuffer = false;
+        return OK;
+    }
+
     if (mCurrentLockedBuffers == mMaxLockedBuffers) {
         CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
                 mMaxLockedBuffers);
         return NOT_ENOUGH_DATA;
     }
 
+    return acquireAndLockLocked(nativeBuffer);
+}
+
+status_t CpuConsumer::acquireAndLockLocked(LockedBuffer* nativeBuffer) {
+    status_t err;
+
     BufferItem b;
     err = acquireBufferLocked(&b, 0);
     if (err != OK) {
@@ -197,7 +207,10 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
 
 status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     Mutex::Autolock _l(mMutex);
+    return unlockBufferLocked(nativeBuffer);
+}
 
+status_t CpuConsumer::unlockBufferLocked(const LockedBuffer& nativeBuffer) {
     uintptr_t id = getLockedBufferId(nativeBuffer);
     size_t lockedIdx =
         (id != AcquiredBuffer::kUnusedId) ? findAcquiredBufferLocked(id) : mMaxLockedBuffers;
@@ -227,4 +240,35 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     return OK;
 }
 
+void CpuConsumer::setPrelockEnabled(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+    mPrelockEnabled = enabled;
+    if (!enabled) {
+        releasePrelockedBufferLocked();
+    }
+}
+
+void CpuConsumer::releasePrelockedBufferLocked() {
+    if (mHasPrelockedBuffer) {
+        mHasPrelockedBuffer = false;
+        unlockBufferLocked(mPrelockedBuffer);
+    }
+}
+
+void CpuConsumer::onFrameAvailable(const BufferItem& item) {
+    {
+        Mutex::Autolock _l(mMutex);
+        if (mPrelockEnabled && !mHasPrelockedBuffer && !mAbandoned &&
+            mCurrentLockedBuffers < mMaxLockedBuffers) {
+            mHasPrelockedBuffer = acquireAndLockLocked(&mPrelockedBuffer) == OK;
+        }
+    }
+    ConsumerBase::onFrameAvailable(item);
+}
+
+void CpuConsumer::abandonLocked() {
+    releasePrelockedBufferLocked();
+    ConsumerBase::abandonLocked();
+}
+
 } // namespace android
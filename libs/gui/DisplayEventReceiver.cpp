@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include <utils/Errors.h>
 
@@ -25,6 +27,7 @@
 #include <private/gui/ComposerService.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimestamps.h>
 
 // ---------------------------------------------------------------------------
 
@@ -45,6 +48,9 @@ DisplayEventReceiver::DisplayEventReceiver(ISurfaceComposer::VsyncSource vsyncSo
 }
 
 DisplayEventReceiver::~DisplayEventReceiver() {
+    if (mVsyncTimestamps != nullptr) {
+        munmap(const_cast<gui::VsyncTimestamps*>(mVsyncTimestamps), sizeof(gui::VsyncTimestamps));
+    }
 }
 
 status_t DisplayEventReceiver::initCheck() const {
@@ -79,6 +85,49 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::getLatestVsync(nsecs_t* outTimestamp,
+                                              nsecs_t* outExpectedVSyncTimestamp,
+                                              uint32_t* outCount) {
+    if (mVsyncTimestamps == nullptr) {
+        status_t err = mapVsyncTimestamps();
+        if (err != NO_ERROR) {
+            return err;
+        }
+    }
+    if (!mVsyncTimestamps->read(outCount, outTimestamp, outExpectedVSyncTimestamp)) {
+        return NOT_ENOUGH_DATA;
+    }
+    return NO_ERROR;
+}
+
+status_t DisplayEventReceiver::setTimestampOnly(bool timestampOnly) {
+    if (mEventConnection != nullptr) {
+        return mEventConnection->setTimestampOnly(timestampOnly);
+    }
+    return NO_INIT;
+}
+
+status_t DisplayEventReceiver::mapVsyncTimestamps() {
+    if (mEventConnection == nullptr) {
+        return NO_INIT;
+    }
+    sp<NativeHandle> handle;
+    status_t err = mEventConnection->getVsyncTimestamps(&handle);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (handle == nullptr || handle->handle() == nullptr || handle->handle()->numFds != 1) {
+        return BAD_VALUE;
+    }
+    void* data = mmap(nullptr, sizeof(gui::VsyncTimestamps), PROT_READ, MAP_SHARED,
+                      handle->handle()->data[0], 0);
+    if (data == MAP_FAILED) {
+        return -errno;
+    }
+    mVsyncTimestamps = static_cast<const gui::VsyncTimestamps*>(data);
+    return NO_ERROR;
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
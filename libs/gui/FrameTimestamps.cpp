@@ -498,6 +498,18 @@ void ConsumerFrameEventHistory::getAndResetDelta(
 // FrameEventsDelta
 // ============================================================================
 
+namespace {
+
+// Polls the fence before taking the snapshot, so that a fence which has
+// already signaled is sent as its signal time. This saves duplicating and
+// transferring its fd over binder, and tracking a new Fence producer side.
+FenceTime::Snapshot getPolledSnapshot(const std::shared_ptr<FenceTime>& fence) {
+    fence->getSignalTime();
+    return fence->getSnapshot();
+}
+
+} // namespace
+
 FrameEventsDelta::FrameEventsDelta(
         size_t index,
         const FrameEvents& frameTimestamps,
@@ -514,14 +526,14 @@ FrameEventsDelta::FrameEventsDelta(
       mDequeueReadyTime(frameTimestamps.dequeueReadyTime) {
     if (dirtyFields.isDirty<FrameEvent::GPU_COMPOSITION_DONE>()) {
         mGpuCompositionDoneFence =
-                frameTimestamps.gpuCompositionDoneFence->getSnapshot();
+                getPolledSnapshot(frameTimestamps.gpuCompositionDoneFence);
     }
     if (dirtyFields.isDirty<FrameEvent::DISPLAY_PRESENT>()) {
         mDisplayPresentFence =
-                frameTimestamps.displayPresentFence->getSnapshot();
+                getPolledSnapshot(frameTimestamps.displayPresentFence);
     }
     if (dirtyFields.isDirty<FrameEvent::RELEASE>()) {
-        mReleaseFence = frameTimestamps.releaseFence->getSnapshot();
+        mReleaseFence = getPolledSnapshot(frameTimestamps.releaseFence);
     }
 }
 
@@ -26,7 +26,9 @@ enum class Tag : uint32_t {
     STEAL_RECEIVE_CHANNEL = IBinder::FIRST_CALL_TRANSACTION,
     SET_VSYNC_RATE,
     REQUEST_NEXT_VSYNC,
-    LAST = REQUEST_NEXT_VSYNC,
+    GET_VSYNC_TIMESTAMPS,
+    SET_TIMESTAMP_ONLY,
+    LAST = SET_TIMESTAMP_ONLY,
 };
 
 } // Anonymous namespace
@@ -53,6 +55,18 @@ public:
         callRemoteAsync<decltype(&IDisplayEventConnection::requestNextVsync)>(
                 Tag::REQUEST_NEXT_VSYNC);
     }
+
+    status_t getVsyncTimestamps(sp<NativeHandle>* outHandle) override {
+        return callRemote<decltype(
+                &IDisplayEventConnection::getVsyncTimestamps)>(Tag::GET_VSYNC_TIMESTAMPS,
+                                                               outHandle);
+    }
+
+    status_t setTimestampOnly(bool timestampOnly) override {
+        return callRemote<decltype(
+                &IDisplayEventConnection::setTimestampOnly)>(Tag::SET_TIMESTAMP_ONLY,
+                                                             timestampOnly);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit (see
@@ -74,6 +88,10 @@ status_t BnDisplayEventConnection::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &IDisplayEventConnection::setVsyncRate);
         case Tag::REQUEST_NEXT_VSYNC:
             return callLocalAsync(data, reply, &IDisplayEventConnection::requestNextVsync);
+        case Tag::GET_VSYNC_TIMESTAMPS:
+            return callLocal(data, reply, &IDisplayEventConnection::getVsyncTimestamps);
+        case Tag::SET_TIMESTAMP_ONLY:
+            return callLocal(data, reply, &IDisplayEventConnection::setTimestampOnly);
     }
 }
 
@@ -74,6 +74,7 @@ enum {
     GET_CONSUMER_USAGE,
     SET_LEGACY_BUFFER_DROP,
     SET_AUTO_PREROTATION,
+    QUEUE_AND_DEQUEUE_BUFFER,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -278,6 +279,56 @@ public:
         return result;
     }
 
+    virtual status_t queueAndDequeueBuffer(int buf, const QueueBufferInput& input,
+                                           QueueBufferOutput* output,
+                                           const DequeueBufferInput& dequeueInput,
+                                           DequeueBufferOutput* dequeueOutput) {
+        Parcel data, reply;
+
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeInt32(buf);
+        data.write(input);
+        data.writeUint32(dequeueInput.width);
+        data.writeUint32(dequeueInput.height);
+        data.writeInt32(static_cast<int32_t>(dequeueInput.format));
+        data.writeUint64(dequeueInput.usage);
+
+        status_t result = remote()->transact(QUEUE_AND_DEQUEUE_BUFFER, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        result = reply.read(*output);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        dequeueOutput->result = reply.readInt32();
+        dequeueOutput->slot = reply.readInt32();
+        dequeueOutput->fence = new Fence();
+        status_t readResult = reply.read(*dequeueOutput->fence);
+        if (readResult == NO_ERROR) {
+            readResult = reply.readUint64(&dequeueOutput->bufferAge);
+        }
+        if (readResult == NO_ERROR && reply.readInt32()) {
+            dequeueOutput->buffer = new GraphicBuffer();
+            readResult = reply.read(*dequeueOutput->buffer);
+        }
+        if (readResult != NO_ERROR) {
+            // The buffer was queued, only the dequeued buffer is lost.
+            ALOGE("IGBP::queueAndDequeueBuffer failed to read the dequeued buffer: %d",
+                  readResult);
+            dequeueOutput->result = readResult;
+            dequeueOutput->fence = Fence::NO_FENCE;
+            dequeueOutput->buffer.clear();
+        }
+        return NO_ERROR;
+    }
+
     virtual status_t cancelBuffer(int buf, const sp<Fence>& fence) {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -611,6 +662,13 @@ public:
         return mBase->queueBuffer(slot, input, output);
     }
 
+    status_t queueAndDequeueBuffer(int slot, const QueueBufferInput& input,
+                                   QueueBufferOutput* output,
+                                   const DequeueBufferInput& dequeueInput,
+                                   DequeueBufferOutput* dequeueOutput) override {
+        return mBase->queueAndDequeueBuffer(slot, input, output, dequeueInput, dequeueOutput);
+    }
+
     status_t cancelBuffer(int slot, const sp<Fence>& fence) override {
         return mBase->cancelBuffer(slot, fence);
     }
@@ -710,6 +768,28 @@ status_t IGraphicBufferProducer::setAutoPrerotation(bool autoPrerotation) {
     return INVALID_OPERATION;
 }
 
+status_t IGraphicBufferProducer::queueAndDequeueBuffer(int slot, const QueueBufferInput& input,
+                                                       QueueBufferOutput* output,
+                                                       const DequeueBufferInput& dequeueInput,
+                                                       DequeueBufferOutput* dequeueOutput) {
+    status_t result = queueBuffer(slot, input, output);
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    dequeueOutput->result =
+            dequeueBuffer(&dequeueOutput->slot, &dequeueOutput->fence, dequeueInput.width,
+                          dequeueInput.height, dequeueInput.format, dequeueInput.usage,
+                          &dequeueOutput->bufferAge, nullptr);
+    if (dequeueOutput->result >= 0 && (dequeueOutput->result & BUFFER_NEEDS_REALLOCATION)) {
+        // On failure, leave it to the caller's own requestBuffer call to report the error.
+        if (requestBuffer(dequeueOutput->slot, &dequeueOutput->buffer) != NO_ERROR) {
+            dequeueOutput->buffer.clear();
+        }
+    }
+    return NO_ERROR;
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -890,6 +970,41 @@ status_t BnGraphicBufferProducer::onTransact(
 
             return NO_ERROR;
         }
+        case QUEUE_AND_DEQUEUE_BUFFER: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+
+            int buf = data.readInt32();
+            QueueBufferInput input(data);
+            DequeueBufferInput dequeueInput;
+            dequeueInput.width = data.readUint32();
+            dequeueInput.height = data.readUint32();
+            dequeueInput.format = static_cast<PixelFormat>(data.readInt32());
+            dequeueInput.usage = data.readUint64();
+
+            QueueBufferOutput output;
+            DequeueBufferOutput dequeueOutput;
+            status_t result =
+                    queueAndDequeueBuffer(buf, input, &output, dequeueInput, &dequeueOutput);
+            reply->write(output);
+            reply->writeInt32(result);
+            if (result == NO_ERROR) {
+                if (dequeueOutput.fence == nullptr) {
+                    ALOGE("queueAndDequeueBuffer returned a NULL fence, setting to "
+                          "Fence::NO_FENCE");
+                    dequeueOutput.fence = Fence::NO_FENCE;
+                }
+                reply->writeInt32(dequeueOutput.result);
+                reply->writeInt32(dequeueOutput.slot);
+                reply->write(*dequeueOutput.fence);
+                reply->writeUint64(dequeueOutput.bufferAge);
+                reply->writeInt32(dequeueOutput.buffer != nullptr);
+                if (dequeueOutput.buffer != nullptr) {
+                    reply->write(*dequeueOutput.buffer);
+                }
+            }
+
+            return NO_ERROR;
+        }
         case CANCEL_BUFFER: {
             CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
             int buf = data.readInt32();
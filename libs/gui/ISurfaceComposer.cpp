@@ -70,10 +70,16 @@ public:
                                      const Vector<DisplayState>& displays, uint32_t flags,
                                      const sp<IBinder>& applyToken,
                                      const InputWindowCommands& commands,
-                                     int64_t desiredPresentTime,
+                                     int64_t desiredPresentTime, int64_t applyTime,
                                      const client_cache_t& uncacheBuffer, bool hasListenerCallbacks,
                                      const std::vector<ListenerCallbacks>& listenerCallbacks) {
+        // Threads applying a transaction every frame send transactions of about the same size,
+        // so reserve what the last one needed up front. The buffer then comes from the
+        // per-thread Parcel buffer pool in one piece instead of growing while it is written.
+        static thread_local size_t sLastDataSize = 0;
+
         Parcel data, reply;
+        data.setDataCapacity(sLastDataSize);
         data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
 
         data.writeUint32(static_cast<uint32_t>(state.size()));
@@ -90,6 +96,7 @@ public:
         data.writeStrongBinder(applyToken);
         commands.write(data);
         data.writeInt64(desiredPresentTime);
+        data.writeInt64(applyTime);
         data.writeStrongBinder(uncacheBuffer.token.promote());
         data.writeUint64(uncacheBuffer.id);
         data.writeBool(hasListenerCallbacks);
@@ -101,6 +108,7 @@ public:
             }
         }
 
+        sLastDataSize = data.dataSize();
         remote()->transact(BnSurfaceComposer::SET_TRANSACTION_STATE, data, &reply);
     }
 
@@ -145,6 +153,44 @@ public:
         return result;
     }
 
+    virtual status_t captureScreenAsync(const sp<IBinder>& display, sp<GraphicBuffer>* outBuffer,
+                                        sp<Fence>* outFence, bool& outCapturedSecureLayers,
+                                        ui::Dataspace reqDataspace, ui::PixelFormat reqPixelFormat,
+                                        const Rect& sourceCrop, uint32_t reqWidth,
+                                        uint32_t reqHeight, bool useIdentityTransform,
+                                        ui::Rotation rotation, bool captureSecureLayers) {
+        Parcel data, reply;
+        data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
+        data.writeStrongBinder(display);
+        data.writeInt32(static_cast<int32_t>(reqDataspace));
+        data.writeInt32(static_cast<int32_t>(reqPixelFormat));
+        data.write(sourceCrop);
+        data.writeUint32(reqWidth);
+        data.writeUint32(reqHeight);
+        data.writeInt32(static_cast<int32_t>(useIdentityTransform));
+        data.writeInt32(static_cast<int32_t>(rotation));
+        data.writeInt32(static_cast<int32_t>(captureSecureLayers));
+        status_t result =
+                remote()->transact(BnSurfaceComposer::CAPTURE_SCREEN_ASYNC, data, &reply);
+        if (result != NO_ERROR) {
+            ALOGE("captureScreenAsync failed to transact: %d", result);
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            ALOGE("captureScreenAsync failed to readInt32: %d", result);
+            return result;
+        }
+
+        *outBuffer = new GraphicBuffer();
+        reply.read(**outBuffer);
+        *outFence = new Fence();
+        reply.read(**outFence);
+        outCapturedSecureLayers = reply.readBool();
+
+        return result;
+    }
+
     virtual status_t captureScreen(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                                    sp<GraphicBuffer>* outBuffer) {
         Parcel data, reply;
@@ -1270,6 +1316,7 @@ status_t BnSurfaceComposer::onTransact(
             inputWindowCommands.read(data);
 
             int64_t desiredPresentTime = data.readInt64();
+            int64_t applyTime = data.readInt64();
 
             client_cache_t uncachedBuffer;
             uncachedBuffer.token = data.readStrongBinder();
@@ -1286,8 +1333,8 @@ status_t BnSurfaceComposer::onTransact(
                 listenerCallbacks.emplace_back(listener, callbackIds);
             }
             setTransactionState(state, displays, stateFlags, applyToken, inputWindowCommands,
-                                desiredPresentTime, uncachedBuffer, hasListenerCallbacks,
-                                listenerCallbacks);
+                                desiredPresentTime, applyTime, uncachedBuffer,
+                                hasListenerCallbacks, listenerCallbacks);
             return NO_ERROR;
         }
         case BOOT_FINISHED: {
@@ -1322,6 +1369,35 @@ status_t BnSurfaceComposer::onTransact(
             }
             return NO_ERROR;
         }
+        case CAPTURE_SCREEN_ASYNC: {
+            CHECK_INTERFACE(ISurfaceComposer, data, reply);
+            sp<IBinder> display = data.readStrongBinder();
+            ui::Dataspace reqDataspace = static_cast<ui::Dataspace>(data.readInt32());
+            ui::PixelFormat reqPixelFormat = static_cast<ui::PixelFormat>(data.readInt32());
+            sp<GraphicBuffer> outBuffer;
+            sp<Fence> outFence = Fence::NO_FENCE;
+            Rect sourceCrop(Rect::EMPTY_RECT);
+            data.read(sourceCrop);
+            uint32_t reqWidth = data.readUint32();
+            uint32_t reqHeight = data.readUint32();
+            bool useIdentityTransform = static_cast<bool>(data.readInt32());
+            int32_t rotation = data.readInt32();
+            bool captureSecureLayers = static_cast<bool>(data.readInt32());
+
+            bool capturedSecureLayers = false;
+            status_t res = captureScreenAsync(display, &outBuffer, &outFence, capturedSecureLayers,
+                                              reqDataspace, reqPixelFormat, sourceCrop, reqWidth,
+                                              reqHeight, useIdentityTransform,
+                                              ui::toRotation(rotation), captureSecureLayers);
+
+            reply->writeInt32(res);
+            if (res == NO_ERROR) {
+                reply->write(*outBuffer);
+                reply->write(*outFence);
+                reply->writeBool(capturedSecureLayers);
+            }
+            return NO_ERROR;
+        }
         case CAPTURE_SCREEN_BY_ID: {
             CHECK_INTERFACE(ISurfaceComposer, data, reply);
             uint64_t displayOrLayerStack = data.readUint64();
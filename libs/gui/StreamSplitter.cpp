@@ -58,13 +58,13 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mOutstandingBuffers(0), mMaxOutstandingBuffers(MAX_OUTSTANDING_BUFFERS),
+        mInput(inputQueue), mOutputs(), mBuffers() {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+    for (const Output& output : mOutputs) {
+        output.queue->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -74,6 +74,11 @@ StreamSplitter::~StreamSplitter() {
 
 status_t StreamSplitter::addOutput(
         const sp<IGraphicBufferProducer>& outputQueue) {
+    return addOutput(outputQueue, /* allowFrameSkipping */ false);
+}
+
+status_t StreamSplitter::addOutput(
+        const sp<IGraphicBufferProducer>& outputQueue, bool allowFrameSkipping) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -91,7 +96,10 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    mOutputs.push_back({outputQueue, allowFrameSkipping, /* heldBuffers */ 0});
+    if (allowFrameSkipping) {
+        mMaxOutstandingBuffers += MAX_SKIPPING_OUTPUT_BUFFERS;
+    }
 
     return NO_ERROR;
 }
@@ -103,44 +111,64 @@ void StreamSplitter::setName(const String8 &name) {
 
 void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
-
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
-        mReleaseCondition.wait(mMutex);
-
-        // If the splitter is abandoned while we are waiting, the release
-        // condition variable will be broadcast, and we should just return
-        // without attempting to do anything more (since the input queue will
-        // also be abandoned).
-        if (mIsAbandoned) {
-            return;
-        }
-    }
-    ++mOutstandingBuffers;
-
-    // Acquire and detach the buffer from the input
     BufferItem bufferItem;
-    status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "acquiring buffer from input failed (%d)", status);
+    sp<BufferTracker> tracker;
+    std::vector<sp<IGraphicBufferProducer>> outputs;
+    {
+        Mutex::Autolock lock(mMutex);
+
+        // The current policy is that if any one consumer is consuming buffers
+        // too slowly, the splitter will stall the rest of the outputs by not
+        // acquiring any more buffers from the input. This will cause back
+        // pressure on the input queue, slowing down its producer. Outputs that
+        // allow frame skipping are exempt, see addOutput.
+
+        // If there are too many outstanding buffers, we block until a buffer is
+        // released back to the input in onBufferReleased
+        while (mOutstandingBuffers >= mMaxOutstandingBuffers) {
+            mReleaseCondition.wait(mMutex);
+
+            // If the splitter is abandoned while we are waiting, the release
+            // condition variable will be broadcast, and we should just return
+            // without attempting to do anything more (since the input queue
+            // will also be abandoned).
+            if (mIsAbandoned) {
+                return;
+            }
+        }
+        ++mOutstandingBuffers;
 
-    ALOGV("acquired buffer %#" PRIx64 " from input",
-            bufferItem.mGraphicBuffer->getId());
+        // Acquire and detach the buffer from the input
+        status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "acquiring buffer from input failed (%d)", status);
 
-    status = mInput->detachBuffer(bufferItem.mSlot);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "detaching buffer from input failed (%d)", status);
+        ALOGV("acquired buffer %#" PRIx64 " from input",
+                bufferItem.mGraphicBuffer->getId());
 
-    // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+        status = mInput->detachBuffer(bufferItem.mSlot);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "detaching buffer from input failed (%d)", status);
+
+        // Initialize our reference count for this buffer. Each output takes
+        // its reference before the buffer is queued to it, since it may
+        // release the buffer before we are done queueing to the others.
+        tracker = new BufferTracker(bufferItem.mGraphicBuffer);
+        mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
+
+        for (Output& output : mOutputs) {
+            if (output.allowFrameSkipping &&
+                    output.heldBuffers >= MAX_SKIPPING_OUTPUT_BUFFERS) {
+                ALOGV("skipping buffer %#" PRIx64 " for output %p",
+                        bufferItem.mGraphicBuffer->getId(), output.queue.get());
+                continue;
+            }
+            tracker->incrementReferenceCountLocked();
+            ++output.heldBuffers;
+            outputs.push_back(output.queue);
+        }
+    }
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,41 +177,48 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+    for (const sp<IGraphicBufferProducer>& output : outputs) {
+        if (queueToOutput(output, bufferItem.mGraphicBuffer, queueInput)) {
+            ALOGV("queued buffer %#" PRIx64 " to output %p",
+                    bufferItem.mGraphicBuffer->getId(), output.get());
             continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "attaching buffer to output failed (%d)", status);
         }
 
-        IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
-            continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "queueing buffer to output failed (%d)", status);
+        // If we just discovered that this output has been abandoned, note
+        // that, drop its reference so that we still release this buffer
+        // eventually, and move on to the next output
+        Mutex::Autolock lock(mMutex);
+        onAbandonedLocked();
+        if (Output* abandoned = findOutputLocked(output)) {
+            --abandoned->heldBuffers;
         }
+        releaseReferenceLocked(tracker);
+    }
 
-        ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+    // Drop the reference held while queueing
+    Mutex::Autolock lock(mMutex);
+    releaseReferenceLocked(tracker);
+}
+
+bool StreamSplitter::queueToOutput(const sp<IGraphicBufferProducer>& outputQueue,
+        const sp<GraphicBuffer>& buffer,
+        const IGraphicBufferProducer::QueueBufferInput& queueInput) {
+    int slot;
+    status_t status = outputQueue->attachBuffer(&slot, buffer);
+    if (status == NO_INIT) {
+        return false;
     }
+    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+            "attaching buffer to output failed (%d)", status);
+
+    IGraphicBufferProducer::QueueBufferOutput queueOutput;
+    status = outputQueue->queueBuffer(slot, queueInput, &queueOutput);
+    if (status == NO_INIT) {
+        return false;
+    }
+    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+            "queueing buffer to output failed (%d)", status);
+    return true;
 }
 
 void StreamSplitter::onBufferReleasedByOutput(
@@ -207,30 +242,50 @@ void StreamSplitter::onBufferReleasedByOutput(
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    if (Output* output = findOutputLocked(from)) {
+        --output->heldBuffers;
+    }
+
+    sp<BufferTracker> tracker = mBuffers.editValueFor(buffer->getId());
 
     // Merge the release fence of the incoming buffer so that the fence we send
     // back to the input includes all of the outputs' fences
     tracker->mergeFence(fence);
 
+    releaseReferenceLocked(tracker);
+}
+
+StreamSplitter::Output* StreamSplitter::findOutputLocked(
+        const sp<IGraphicBufferProducer>& queue) {
+    for (Output& output : mOutputs) {
+        if (output.queue == queue) {
+            return &output;
+        }
+    }
+    return nullptr;
+}
+
+void StreamSplitter::releaseReferenceLocked(const sp<BufferTracker>& tracker) {
     // Check to see if this is the last outstanding reference to this buffer
-    size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
-            releaseCount, mOutputs.size());
-    if (releaseCount < mOutputs.size()) {
+    size_t referenceCount = tracker->decrementReferenceCountLocked();
+    ALOGV("buffer %#" PRIx64 " reference count %zu", tracker->getBuffer()->getId(),
+            referenceCount);
+    if (referenceCount > 0) {
         return;
     }
 
+    const uint64_t bufferId = tracker->getBuffer()->getId();
+
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
     if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
+        mBuffers.removeItem(bufferId);
         return;
     }
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -239,11 +294,11 @@ void StreamSplitter::onBufferReleasedByOutput(
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
 
     // Notify any waiting onFrameAvailable calls
     --mOutstandingBuffers;
@@ -276,7 +331,7 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
 }
 
 StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReferenceCount(1) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
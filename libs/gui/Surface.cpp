@@ -24,6 +24,7 @@
 #include <deque>
 #include <mutex>
 #include <thread>
+#include <utility>
 
 #include <inttypes.h>
 
@@ -170,7 +171,19 @@ String8 Surface::getConsumerName() const {
 }
 
 status_t Surface::setDequeueTimeout(nsecs_t timeout) {
-    return mGraphicBufferProducer->setDequeueTimeout(timeout);
+    status_t err = mGraphicBufferProducer->setDequeueTimeout(timeout);
+    Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
+    mMinUndequeuedBufferCount = 0;
+    return err;
+}
+
+void Surface::setQueueAndDequeueEnabled(bool enabled) {
+    Mutex::Autolock lock(mMutex);
+    mQueueAndDequeueEnabled = enabled;
+    if (!enabled) {
+        cancelPrefetchedBufferLocked();
+    }
 }
 
 status_t Surface::getLastQueuedBuffer(sp<GraphicBuffer>* outBuffer,
@@ -545,6 +558,8 @@ int Surface::setSwapInterval(int interval) {
 
     if (mSwapIntervalZero != wasSwapIntervalZero) {
         mGraphicBufferProducer->setAsyncMode(mSwapIntervalZero);
+        Mutex::Autolock lock(mMutex);
+        mMinUndequeuedBufferCount = 0;
     }
 
     return NO_ERROR;
@@ -635,6 +650,7 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     PixelFormat reqFormat;
     uint64_t reqUsage;
     bool enableFrameTimestamps;
+    std::optional<IGraphicBufferProducer::DequeueBufferOutput> prefetched;
 
     {
         Mutex::Autolock lock(mMutex);
@@ -659,17 +675,38 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
                 return OK;
             }
         }
+
+        if (mPrefetchedBuffer &&
+            (mPrefetchedBufferInput.width != reqWidth ||
+             mPrefetchedBufferInput.height != reqHeight ||
+             mPrefetchedBufferInput.format != reqFormat ||
+             mPrefetchedBufferInput.usage != reqUsage)) {
+            cancelPrefetchedBufferLocked();
+        }
+        prefetched = std::exchange(mPrefetchedBuffer, std::nullopt);
     } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffer
 
     int buf = -1;
     sp<Fence> fence;
+    sp<GraphicBuffer> reallocatedBuffer;
     nsecs_t startTime = systemTime();
 
     FrameEventHistoryDelta frameTimestamps;
-    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight,
-                                                            reqFormat, reqUsage, &mBufferAge,
-                                                            enableFrameTimestamps ? &frameTimestamps
-                                                                                  : nullptr);
+    status_t result;
+    if (prefetched) {
+        // The frame timestamps were already received by queueBuffer.
+        enableFrameTimestamps = false;
+        buf = prefetched->slot;
+        fence = prefetched->fence;
+        mBufferAge = prefetched->bufferAge;
+        reallocatedBuffer = prefetched->buffer;
+        result = prefetched->result;
+    } else {
+        result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight,
+                                                       reqFormat, reqUsage, &mBufferAge,
+                                                       enableFrameTimestamps ? &frameTimestamps
+                                                                             : nullptr);
+    }
     mLastDequeueDuration = systemTime() - startTime;
 
     if (result < 0) {
@@ -712,11 +749,15 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         if (mReportRemovedBuffers && (gbuf != nullptr)) {
             mRemovedBuffers.push_back(gbuf);
         }
-        result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
-        if (result != NO_ERROR) {
-            ALOGE("dequeueBuffer: IGraphicBufferProducer::requestBuffer failed: %d", result);
-            mGraphicBufferProducer->cancelBuffer(buf, fence);
-            return result;
+        if (reallocatedBuffer != nullptr) {
+            gbuf = reallocatedBuffer;
+        } else {
+            result = mGraphicBufferProducer->requestBuffer(buf, &gbuf);
+            if (result != NO_ERROR) {
+                ALOGE("dequeueBuffer: IGraphicBufferProducer::requestBuffer failed: %d", result);
+                mGraphicBufferProducer->cancelBuffer(buf, fence);
+                return result;
+            }
         }
     }
 
@@ -779,6 +820,12 @@ int Surface::cancelBuffer(android_native_buffer_t* buffer,
 
 int Surface::getSlotFromBufferLocked(
         android_native_buffer_t* buffer) const {
+    // The buffer is almost always one of the few that are dequeued, so look there first.
+    for (int i : mDequeuedSlots) {
+        if (mSlots[i].buffer != nullptr && mSlots[i].buffer->handle == buffer->handle) {
+            return i;
+        }
+    }
     for (int i = 0; i < NUM_BUFFER_SLOTS; i++) {
         if (mSlots[i].buffer != nullptr &&
                 mSlots[i].buffer->handle == buffer->handle) {
@@ -789,6 +836,33 @@ int Surface::getSlotFromBufferLocked(
     return BAD_VALUE;
 }
 
+void Surface::cancelPrefetchedBufferLocked() {
+    mPrefetchGeneration++;
+    if (!mPrefetchedBuffer) {
+        return;
+    }
+    const IGraphicBufferProducer::DequeueBufferOutput prefetched = *mPrefetchedBuffer;
+    mPrefetchedBuffer.reset();
+    cancelDequeueOutputLocked(prefetched);
+}
+
+void Surface::cancelDequeueOutputLocked(
+        const IGraphicBufferProducer::DequeueBufferOutput& prefetched) {
+    // Apply the results of the dequeue, so that the slots stay in sync with the producer.
+    if (prefetched.result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+        freeAllBuffers();
+    }
+    if (prefetched.result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+        sp<GraphicBuffer>& gbuf(mSlots[prefetched.slot].buffer);
+        if (mReportRemovedBuffers && gbuf != nullptr) {
+            mRemovedBuffers.push_back(gbuf);
+        }
+        // Without the new buffer, the next dequeue of the slot requests it.
+        gbuf = prefetched.buffer;
+    }
+    mGraphicBufferProducer->cancelBuffer(prefetched.slot, prefetched.fence);
+}
+
 int Surface::lockBuffer_DEPRECATED(android_native_buffer_t* buffer __attribute__((unused))) {
     ALOGV("Surface::lockBuffer");
     Mutex::Autolock lock(mMutex);
@@ -903,7 +977,38 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     }
 
     nsecs_t now = systemTime();
-    status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
+    status_t err;
+    if (mQueueAndDequeueEnabled && !mSharedBufferMode && !mPrefetchedBuffer) {
+        IGraphicBufferProducer::DequeueBufferInput dequeueInput;
+        dequeueInput.width = mReqWidth ? mReqWidth : mUserWidth;
+        dequeueInput.height = mReqHeight ? mReqHeight : mUserHeight;
+        dequeueInput.format = mReqFormat;
+        dequeueInput.usage = mReqUsage;
+        IGraphicBufferProducer::DequeueBufferOutput dequeueOutput;
+        const uint64_t prefetchGeneration = mPrefetchGeneration;
+
+        // Like dequeueBuffer, drop the lock while the dequeue half may block, so that the
+        // Surface can still be used from other threads.
+        mMutex.unlock();
+        err = mGraphicBufferProducer->queueAndDequeueBuffer(i, input, &output, dequeueInput,
+                                                            &dequeueOutput);
+        mMutex.lock();
+
+        // On failure, the next dequeueBuffer call reports the error.
+        if (err == OK && dequeueOutput.result >= 0 && dequeueOutput.slot >= 0 &&
+            dequeueOutput.slot < NUM_BUFFER_SLOTS) {
+            if (mPrefetchedBuffer || prefetchGeneration != mPrefetchGeneration) {
+                // Another queueBuffer prefetched first, or the Surface was reconfigured while
+                // the lock was dropped.
+                cancelDequeueOutputLocked(dequeueOutput);
+            } else {
+                mPrefetchedBufferInput = dequeueInput;
+                mPrefetchedBuffer = std::move(dequeueOutput);
+            }
+        }
+    } else {
+        err = mGraphicBufferProducer->queueBuffer(i, input, &output);
+    }
     mLastQueueDuration = systemTime() - now;
     if (err != OK)  {
         ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
@@ -938,6 +1043,7 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
 
     mConsumerRunningBehind = (output.numPendingBuffers >= 2);
     mIsBufferAccumulated = mConsumerRunningBehind;
+    mMinUndequeuedBufferCount = output.minUndequeuedBufferCount;
 
     if (!mConnectedToCpu) {
         // Clear surface damage back to full-buffer
@@ -997,14 +1103,21 @@ int Surface::query(int what, int* value) const {
                 }
                 break;
             case NATIVE_WINDOW_QUEUES_TO_WINDOW_COMPOSER: {
-                if (composerService()->authenticateSurfaceTexture(
-                        mGraphicBufferProducer)) {
-                    *value = 1;
-                } else {
-                    *value = 0;
+                if (mQueuesToWindowComposer < 0) {
+                    mQueuesToWindowComposer =
+                            composerService()->authenticateSurfaceTexture(mGraphicBufferProducer)
+                            ? 1
+                            : 0;
                 }
+                *value = mQueuesToWindowComposer;
                 return NO_ERROR;
             }
+            case NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS:
+                if (mMinUndequeuedBufferCount > 0) {
+                    *value = mMinUndequeuedBufferCount;
+                    return NO_ERROR;
+                }
+                break;
             case NATIVE_WINDOW_CONCRETE_TYPE:
                 *value = NATIVE_WINDOW_SURFACE;
                 return NO_ERROR;
@@ -1221,6 +1334,9 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER:
         res = dispatchGetLastQueuedBuffer(args);
         break;
+    case NATIVE_WINDOW_SET_BUFFERS_PROPERTIES:
+        res = dispatchSetBuffersProperties(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1527,6 +1643,15 @@ int Surface::dispatchGetLastQueuedBuffer(va_list args) {
     return result;
 }
 
+int Surface::dispatchSetBuffersProperties(va_list args) {
+    const native_window_buffers_properties_t* properties =
+            va_arg(args, const native_window_buffers_properties_t*);
+    if (properties == nullptr) {
+        return BAD_VALUE;
+    }
+    return setBuffersProperties(*properties);
+}
+
 bool Surface::transformToDisplayInverse() {
     return (mTransform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) ==
             NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY;
@@ -1554,6 +1679,7 @@ int Surface::connect(
     ATRACE_CALL();
     ALOGV("Surface::connect");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
     IGraphicBufferProducer::QueueBufferOutput output;
     mReportRemovedBuffers = reportBufferRemoval;
     int err = mGraphicBufferProducer->connect(listener, api, mProducerControlledByApp, &output);
@@ -1562,6 +1688,7 @@ int Surface::connect(
         mDefaultHeight = output.height;
         mNextFrameNumber = output.nextFrameNumber;
         mMaxBufferCount = output.maxBufferCount;
+        mMinUndequeuedBufferCount = output.minUndequeuedBufferCount;
 
         // Ignore transform hint if sticky transform is set or transform to display inverse flag is
         // set. Transform hint should be ignored if the client is expected to always submit buffers
@@ -1592,6 +1719,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
     mRemovedBuffers.clear();
     mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
     mSharedBufferHasBeenQueued = false;
+    cancelPrefetchedBufferLocked();
     freeAllBuffers();
     int err = mGraphicBufferProducer->disconnect(api, mode);
     if (!err) {
@@ -1606,6 +1734,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
         mAutoPrerotation = false;
         mEnableFrameTimestamps = false;
         mMaxBufferCount = NUM_BUFFER_SLOTS;
+        mMinUndequeuedBufferCount = 0;
 
         if (api == NATIVE_WINDOW_API_CPU) {
             mConnectedToCpu = false;
@@ -1720,6 +1849,7 @@ int Surface::setBufferCount(int bufferCount)
     ATRACE_CALL();
     ALOGV("Surface::setBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
 
     status_t err = NO_ERROR;
     if (bufferCount == 0) {
@@ -1744,6 +1874,7 @@ int Surface::setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
     ATRACE_CALL();
     ALOGV("Surface::setMaxDequeuedBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
 
     status_t err = mGraphicBufferProducer->setMaxDequeuedBufferCount(
             maxDequeuedBuffers);
@@ -1757,8 +1888,10 @@ int Surface::setAsyncMode(bool async) {
     ATRACE_CALL();
     ALOGV("Surface::setAsyncMode");
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
 
     status_t err = mGraphicBufferProducer->setAsyncMode(async);
+    mMinUndequeuedBufferCount = 0;
     ALOGE_IF(err, "IGraphicBufferProducer::setAsyncMode(%d) returned %s",
             async, strerror(-err));
 
@@ -1769,6 +1902,7 @@ int Surface::setSharedBufferMode(bool sharedBufferMode) {
     ATRACE_CALL();
     ALOGV("Surface::setSharedBufferMode (%d)", sharedBufferMode);
     Mutex::Autolock lock(mMutex);
+    cancelPrefetchedBufferLocked();
 
     status_t err = mGraphicBufferProducer->setSharedBufferMode(
             sharedBufferMode);
@@ -1903,6 +2037,44 @@ int Surface::setBuffersDataSpace(Dataspace dataSpace)
     return NO_ERROR;
 }
 
+int Surface::setBuffersProperties(const native_window_buffers_properties_t& properties) {
+    ATRACE_CALL();
+    ALOGV("Surface::setBuffersProperties");
+
+    if ((properties.width && !properties.height) || (!properties.width && properties.height)) {
+        return BAD_VALUE;
+    }
+
+    switch (properties.scalingMode) {
+        case NATIVE_WINDOW_SCALING_MODE_FREEZE:
+        case NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW:
+        case NATIVE_WINDOW_SCALING_MODE_SCALE_CROP:
+        case NATIVE_WINDOW_SCALING_MODE_NO_SCALE_CROP:
+            break;
+        default:
+            ALOGE("unknown scaling mode: %d", properties.scalingMode);
+            return BAD_VALUE;
+    }
+
+    Mutex::Autolock lock(mMutex);
+    if (properties.width != mReqWidth || properties.height != mReqHeight ||
+        static_cast<PixelFormat>(properties.format) != mReqFormat) {
+        mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+    }
+    mReqWidth = properties.width;
+    mReqHeight = properties.height;
+    mReqFormat = static_cast<PixelFormat>(properties.format);
+    mDataSpace = static_cast<Dataspace>(properties.dataSpace);
+    // NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY is sticky, see setBuffersTransform.
+    uint32_t transform = properties.transform;
+    if (transformToDisplayInverse()) {
+        transform |= NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY;
+    }
+    mTransform = transform;
+    mScalingMode = properties.scalingMode;
+    return NO_ERROR;
+}
+
 int Surface::setBuffersSmpte2086Metadata(const android_smpte2086_metadata* metadata) {
     ALOGV("Surface::setBuffersSmpte2086Metadata");
     Mutex::Autolock lock(mMutex);
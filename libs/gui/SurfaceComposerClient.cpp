@@ -582,7 +582,7 @@ void SurfaceComposerClient::doUncacheBufferTransaction(uint64_t cacheId) {
     uncacheBuffer.id = cacheId;
 
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
-    sf->setTransactionState({}, {}, 0, applyToken, {}, -1, uncacheBuffer, false, {});
+    sf->setTransactionState({}, {}, 0, applyToken, {}, -1, systemTime(), uncacheBuffer, false, {});
 }
 
 void SurfaceComposerClient::Transaction::cacheBuffers() {
@@ -636,6 +636,7 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
         return mStatus;
     }
 
+    const int64_t applyTime = systemTime();
     sp<ISurfaceComposer> sf(ComposerService::getComposerService());
 
     bool hasListenerCallbacks = !mListenerCallbacks.empty();
@@ -711,7 +712,7 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
 
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
     sf->setTransactionState(composerStates, displayStates, flags, applyToken, mInputWindowCommands,
-                            mDesiredPresentTime,
+                            mDesiredPresentTime, applyTime,
                             {} /*uncacheBuffer - only set in doUncacheBufferTransaction*/,
                             hasListenerCallbacks, listenerCallbacks);
     mInputWindowCommands.clear();
@@ -1932,6 +1933,19 @@ status_t ScreenshotClient::capture(const sp<IBinder>& display, ui::Dataspace req
                    useIdentityTransform, rotation, false, outBuffer, ignored);
 }
 
+status_t ScreenshotClient::captureAsync(const sp<IBinder>& display, ui::Dataspace reqDataSpace,
+                                        ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
+                                        uint32_t reqWidth, uint32_t reqHeight,
+                                        bool useIdentityTransform, ui::Rotation rotation,
+                                        bool captureSecureLayers, sp<GraphicBuffer>* outBuffer,
+                                        sp<Fence>* outFence, bool& outCapturedSecureLayers) {
+    sp<ISurfaceComposer> s(ComposerService::getComposerService());
+    if (s == nullptr) return NO_INIT;
+    return s->captureScreenAsync(display, outBuffer, outFence, outCapturedSecureLayers,
+                                 reqDataSpace, reqPixelFormat, sourceCrop, reqWidth, reqHeight,
+                                 useIdentityTransform, rotation, captureSecureLayers);
+}
+
 status_t ScreenshotClient::capture(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                                    sp<GraphicBuffer>* outBuffer) {
     sp<ISurfaceComposer> s(ComposerService::getComposerService());
@@ -83,6 +83,13 @@ public:
 
     void update(const sp<SurfaceControl>& surface, int width, int height);
 
+    // Sets how many transactions carrying a buffer may be waiting for their transaction
+    // completed callback at once. With the default of one, a buffer queued while SurfaceFlinger
+    // is slow to latch the previous one is held back until that callback arrives. A deeper
+    // pipeline lets the producer run ahead through latency spikes, at the cost of holding more
+    // buffers on the consumer side.
+    status_t setMaxInFlightTransactions(int32_t count);
+
     virtual ~BLASTBufferQueue() = default;
 
 private:
@@ -93,6 +100,7 @@ private:
     BLASTBufferQueue(const BLASTBufferQueue& rhs);
 
     void processNextBufferLocked(bool useNextTransaction) REQUIRES(mMutex);
+    bool maxBuffersAcquired() const REQUIRES(mMutex);
     Rect computeCrop(const BufferItem& item);
 
     sp<SurfaceControl> mSurfaceControl;
@@ -104,6 +112,8 @@ private:
     // the max to be acquired
     static const int MAX_ACQUIRED_BUFFERS = 1;
 
+    // Number of submitted transactions allowed in flight, see setMaxInFlightTransactions.
+    int32_t mMaxAcquiredBuffers GUARDED_BY(mMutex) = MAX_ACQUIRED_BUFFERS;
     int32_t mNumFrameAvailable GUARDED_BY(mMutex);
     int32_t mNumAcquired GUARDED_BY(mMutex);
 
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERSLOTSET_H
+#define ANDROID_GUI_BUFFERSLOTSET_H
+
+#include <ui/BufferQueueDefs.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace android {
+
+// Fixed-capacity containers of BufferQueue slot indices. They replace std::set
+// and std::list in BufferQueueCore so that moving a slot between states under
+// the BufferQueue mutex never allocates. Their interfaces mirror the subset of
+// the standard containers used by BufferQueueCore.
+
+// A set of slots, iterated in ascending slot order like std::set<int>.
+class BufferSlotSet {
+public:
+    static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64, "Slots must fit in a 64-bit mask");
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        int operator*() const { return __builtin_ctzll(mRemaining); }
+        const_iterator& operator++() {
+            mRemaining &= mRemaining - 1;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const const_iterator& other) const {
+            return mRemaining == other.mRemaining;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BufferSlotSet;
+        explicit const_iterator(uint64_t remaining) : mRemaining(remaining) {}
+
+        // Slots that have not been visited yet.
+        uint64_t mRemaining;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return const_iterator(mMask); }
+    const_iterator end() const { return const_iterator(0); }
+
+    bool empty() const { return mMask == 0; }
+    size_t size() const { return static_cast<size_t>(__builtin_popcountll(mMask)); }
+    size_t count(int slot) const { return (mMask & bit(slot)) != 0 ? 1 : 0; }
+
+    void insert(int slot) { mMask |= bit(slot); }
+    void erase(int slot) { mMask &= ~bit(slot); }
+    void erase(const_iterator it) { erase(*it); }
+    void clear() { mMask = 0; }
+
+private:
+    static uint64_t bit(int slot) { return uint64_t{1} << slot; }
+
+    uint64_t mMask = 0;
+};
+
+// An ordered list of distinct slots, stored in a ring buffer. This is used
+// where the order matters, e.g. to reuse the least recently released buffer.
+class BufferSlotList {
+public:
+    static constexpr size_t CAPACITY = static_cast<size_t>(BufferQueueDefs::NUM_BUFFER_SLOTS);
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        const int& operator*() const { return mList->at(mIndex); }
+        const_iterator& operator++() {
+            mIndex++;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const const_iterator& other) const {
+            return mList == other.mList && mIndex == other.mIndex;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BufferSlotList;
+        const_iterator(const BufferSlotList* list, size_t index) : mList(list), mIndex(index) {}
+
+        const BufferSlotList* mList;
+        size_t mIndex;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, mSize); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+
+    int front() const { return at(0); }
+    int back() const { return at(mSize - 1); }
+
+    void push_front(int slot) {
+        mHead = (mHead + CAPACITY - 1) & (CAPACITY - 1);
+        mSlots[mHead] = slot;
+        mSize++;
+    }
+    void push_back(int slot) {
+        mSlots[(mHead + mSize) & (CAPACITY - 1)] = slot;
+        mSize++;
+    }
+    void pop_front() {
+        mHead = (mHead + 1) & (CAPACITY - 1);
+        mSize--;
+    }
+    void pop_back() { mSize--; }
+
+    // Removes |slot| from the list, if present.
+    void remove(int slot) {
+        size_t index = 0;
+        while (index < mSize && at(index) != slot) {
+            index++;
+        }
+        if (index == mSize) {
+            return;
+        }
+        if (index == 0) {
+            pop_front();
+            return;
+        }
+        for (; index + 1 < mSize; index++) {
+            mSlots[physicalIndex(index)] = at(index + 1);
+        }
+        mSize--;
+    }
+
+    void clear() {
+        mHead = 0;
+        mSize = 0;
+    }
+
+private:
+    size_t physicalIndex(size_t index) const { return (mHead + index) & (CAPACITY - 1); }
+    const int& at(size_t index) const { return mSlots[physicalIndex(index)]; }
+
+    std::array<int, CAPACITY> mSlots{};
+    size_t mHead = 0;
+    size_t mSize = 0;
+};
+
+} // namespace android
+
+#endif
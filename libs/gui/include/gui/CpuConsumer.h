@@ -111,6 +111,19 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // Enables or disables pre-locking. When enabled, a buffer that becomes
+    // available while fewer than maxLockedBuffers are locked is acquired and
+    // locked right away, on the thread queueing it. The wait for its acquire
+    // fence and the mapping then overlap with the client's processing of the
+    // previous buffer, and the next lockNextBuffer returns without blocking.
+    // Disabling pre-locking returns a pre-locked buffer to the queue.
+    void setPrelockEnabled(bool enabled);
+
+  protected:
+    // From ConsumerBase
+    void onFrameAvailable(const BufferItem& item) override;
+    void abandonLocked() override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -142,10 +155,21 @@ class CpuConsumer : public ConsumerBase
 
     status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
 
+    // Acquires the next buffer and locks it into outBuffer. The caller checks
+    // that fewer than mMaxLockedBuffers are locked.
+    status_t acquireAndLockLocked(LockedBuffer* outBuffer);
+    status_t unlockBufferLocked(const LockedBuffer& nativeBuffer);
+    void releasePrelockedBufferLocked();
+
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
-    // Count of currently locked buffers
+    // Count of currently locked buffers, including a pre-locked one
     size_t mCurrentLockedBuffers;
+
+    bool mPrelockEnabled = false;
+    // Set when mPrelockedBuffer holds a buffer not yet handed to the client
+    bool mHasPrelockedBuffer = false;
+    LockedBuffer mPrelockedBuffer;
 };
 
 } // namespace android
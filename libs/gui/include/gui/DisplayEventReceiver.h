@@ -37,6 +37,7 @@ class IDisplayEventConnection;
 
 namespace gui {
 class BitTube;
+struct VsyncTimestamps;
 } // namespace gui
 
 static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
@@ -148,9 +149,27 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * getLatestVsync() returns the timestamp, expected presentation time and count of the latest
+     * vsync, read from memory shared with SurfaceFlinger rather than from the queue. Vsync only
+     * runs while it is requested, so the latest vsync can be old unless setVsyncRate or
+     * requestNextVsync was called. Returns NOT_ENOUGH_DATA if no vsync happened yet.
+     */
+    status_t getLatestVsync(nsecs_t* outTimestamp, nsecs_t* outExpectedVSyncTimestamp,
+                            uint32_t* outCount);
+
+    /*
+     * setTimestampOnly() stops posting Event::VSync to the queue, for clients that only poll
+     * getLatestVsync. Vsync keeps running at the requested rate. Other events are still posted.
+     */
+    status_t setTimestampOnly(bool timestampOnly);
+
 private:
+    status_t mapVsyncTimestamps();
+
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
+    const gui::VsyncTimestamps* mVsyncTimestamps = nullptr;
 };
 
 // ----------------------------------------------------------------------------
@@ -20,6 +20,7 @@
 #include <binder/SafeInterface.h>
 #include <gui/ISurfaceComposer.h>
 #include <utils/Errors.h>
+#include <utils/NativeHandle.h>
 
 #include <cstdint>
 
@@ -51,6 +52,19 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * getVsyncTimestamps() returns a handle holding the file descriptor of the read-only shared
+     * memory in which the latest vsync is published, see gui::VsyncTimestamps.
+     */
+    virtual status_t getVsyncTimestamps(sp<NativeHandle>* outHandle) = 0;
+
+    /*
+     * setTimestampOnly() stops, or resumes, posting vsync events to the receive channel. The
+     * vsync rate and requests still keep vsync running, so that the latest vsync in the shared
+     * memory returned by getVsyncTimestamps() stays current. Other events are still posted.
+     */
+    virtual status_t setTimestampOnly(bool timestampOnly) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
@@ -385,6 +385,8 @@ public:
         FrameEventHistoryDelta frameTimestamps;
         bool bufferReplaced{false};
         int maxBufferCount{0};
+        // As queried by NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, or 0 if unknown.
+        int minUndequeuedBufferCount{0};
     };
 
     // queueBuffer indicates that the client has finished filling in the
@@ -419,6 +421,43 @@ public:
     virtual status_t queueBuffer(int slot, const QueueBufferInput& input,
             QueueBufferOutput* output) = 0;
 
+    // Arguments of the dequeueBuffer half of queueAndDequeueBuffer.
+    struct DequeueBufferInput {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        PixelFormat format = 0;
+        uint64_t usage = 0;
+    };
+
+    // Results of the dequeueBuffer half of queueAndDequeueBuffer.
+    struct DequeueBufferOutput {
+        // The value returned by dequeueBuffer, i.e. a bitmask of
+        // BUFFER_NEEDS_REALLOCATION and RELEASE_ALL_BUFFERS, or an error.
+        status_t result = NO_INIT;
+        int slot = BufferQueueDefs::NUM_BUFFER_SLOTS;
+        sp<Fence> fence = Fence::NO_FENCE;
+        uint64_t bufferAge = 0;
+        // The buffer of the slot if result has BUFFER_NEEDS_REALLOCATION set,
+        // in which case requestBuffer does not need to be called.
+        sp<GraphicBuffer> buffer;
+    };
+
+    // queueAndDequeueBuffer queues a buffer like queueBuffer and, if that
+    // succeeds, dequeues the next buffer like dequeueBuffer. A remote producer
+    // does both in a single transaction, and also receives a reallocated
+    // buffer without a separate requestBuffer transaction, so a steady-state
+    // frame costs one round trip instead of two or three.
+    //
+    // Like dequeueBuffer, the dequeue may block until a buffer is free. The
+    // frame timestamps are returned in output as for queueBuffer.
+    //
+    // Returns the result of queueBuffer. The result of dequeueBuffer is only
+    // set in dequeueOutput if queueBuffer returned NO_ERROR.
+    virtual status_t queueAndDequeueBuffer(int slot, const QueueBufferInput& input,
+                                           QueueBufferOutput* output,
+                                           const DequeueBufferInput& dequeueInput,
+                                           DequeueBufferOutput* dequeueOutput);
+
     // cancelBuffer indicates that the client does not wish to fill in the
     // buffer associated with slot and transfers ownership of the slot back to
     // the server.
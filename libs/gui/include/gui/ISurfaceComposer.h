@@ -28,6 +28,7 @@
 
 #include <ui/ConfigStoreTypes.h>
 #include <ui/DisplayedFrameStats.h>
+#include <ui/Fence.h>
 #include <ui/FrameStats.h>
 #include <ui/GraphicBuffer.h>
 #include <ui/GraphicTypes.h>
@@ -146,12 +147,14 @@ public:
         return displayId ? getPhysicalDisplayToken(*displayId) : nullptr;
     }
 
-    /* open/close transactions. requires ACCESS_SURFACE_FLINGER permission */
+    /* open/close transactions. requires ACCESS_SURFACE_FLINGER permission
+     * applyTime is the systemTime() at which the client applied the transaction, or 0 if unknown.
+     * It is only used to measure transaction latency. */
     virtual void setTransactionState(const Vector<ComposerState>& state,
                                      const Vector<DisplayState>& displays, uint32_t flags,
                                      const sp<IBinder>& applyToken,
                                      const InputWindowCommands& inputWindowCommands,
-                                     int64_t desiredPresentTime,
+                                     int64_t desiredPresentTime, int64_t applyTime,
                                      const client_cache_t& uncacheBuffer, bool hasListenerCallbacks,
                                      const std::vector<ListenerCallbacks>& listenerCallbacks) = 0;
 
@@ -272,6 +275,19 @@ public:
                                    uint32_t reqWidth, uint32_t reqHeight, bool useIdentityTransform,
                                    ui::Rotation rotation = ui::ROTATION_0,
                                    bool captureSecureLayers = false) = 0;
+
+    /**
+     * Like captureScreen, but returns as soon as the capture has been queued
+     * to the GPU rather than once it has completed. outFence signals when
+     * outBuffer holds the capture, and must be waited on before reading it.
+     */
+    virtual status_t captureScreenAsync(const sp<IBinder>& display, sp<GraphicBuffer>* outBuffer,
+                                        sp<Fence>* outFence, bool& outCapturedSecureLayers,
+                                        ui::Dataspace reqDataspace, ui::PixelFormat reqPixelFormat,
+                                        const Rect& sourceCrop, uint32_t reqWidth,
+                                        uint32_t reqHeight, bool useIdentityTransform,
+                                        ui::Rotation rotation = ui::ROTATION_0,
+                                        bool captureSecureLayers = false) = 0;
     /**
      * Capture the specified screen. This requires READ_FRAME_BUFFER
      * permission.  This function will fail if there is a secure window on
@@ -599,6 +615,7 @@ public:
         SET_GAME_CONTENT_TYPE,
         SET_FRAME_RATE,
         ACQUIRE_FRAME_RATE_FLEXIBILITY_TOKEN,
+        CAPTURE_SCREEN_ASYNC,
         // Always append new enum to the end.
     };
 
@@ -18,6 +18,7 @@
 #define ANDROID_GUI_STREAMSPLITTER_H
 
 #include <gui/IConsumerListener.h>
+#include <gui/IGraphicBufferProducer.h>
 #include <gui/IProducerListener.h>
 
 #include <utils/Condition.h>
@@ -25,11 +26,12 @@
 #include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
 
+#include <vector>
+
 namespace android {
 
 class GraphicBuffer;
 class IGraphicBufferConsumer;
-class IGraphicBufferProducer;
 
 // StreamSplitter is an autonomous class that manages one input BufferQueue
 // and multiple output BufferQueues. By using the buffer attach and detach logic
@@ -63,6 +65,16 @@ public:
     // of other error codes.
     status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
 
+    // Like addOutput above. If allowFrameSkipping is true, a buffer queued to
+    // the input is not queued to this output while the output still holds
+    // MAX_SKIPPING_OUTPUT_BUFFERS buffers from the splitter, i.e. while the
+    // buffer it has acquired is followed by one it has not acquired yet.
+    // Consumers that keep their current buffer until they acquire the next
+    // one still receive new frames, and a slow consumer on the output does
+    // not hold back the other outputs or the input.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            bool allowFrameSkipping);
+
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
 
@@ -73,7 +85,8 @@ private:
     // buffer from the input, and attach it to each of the outputs. This call
     // can block if there are too many outstanding buffers. If it blocks, it
     // will resume when onBufferReleasedByOutput releases a buffer back to the
-    // input.
+    // input. mMutex is not held while the buffer is queued to the outputs, so
+    // outputs can release their buffers in the meantime.
     virtual void onFrameAvailable(const BufferItem& item);
 
     // From IConsumerListener
@@ -104,6 +117,29 @@ private:
     // acquire. This must be called with mMutex locked.
     void onAbandonedLocked();
 
+    class BufferTracker;
+
+    struct Output {
+        sp<IGraphicBufferProducer> queue;
+        bool allowFrameSkipping;
+        // Number of buffers queued to this output that it has not released
+        size_t heldBuffers;
+    };
+
+    // Returns the entry for the given output queue, or nullptr. This must be
+    // called with mMutex locked.
+    Output* findOutputLocked(const sp<IGraphicBufferProducer>& queue);
+
+    // Attaches and queues the buffer to outputQueue. Returns false if the
+    // output has been abandoned.
+    static bool queueToOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            const sp<GraphicBuffer>& buffer,
+            const IGraphicBufferProducer::QueueBufferInput& queueInput);
+
+    // Drops one reference to the buffer, and once no output holds it, returns
+    // it to the input. This must be called with mMutex locked.
+    void releaseReferenceLocked(const sp<BufferTracker>& tracker);
+
     // This is a thin wrapper class that lets us determine which BufferQueue
     // the IProducerListener::onBufferReleased callback is associated with. We
     // create one of these per output BufferQueue, and then pass the producer
@@ -137,7 +173,8 @@ private:
 
         // Returns the new value
         // Only called while mMutex is held
-        size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        size_t incrementReferenceCountLocked() { return ++mReferenceCount; }
+        size_t decrementReferenceCountLocked() { return --mReferenceCount; }
 
     private:
         // Only destroy through LightRefBase
@@ -150,7 +187,9 @@ private:
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
         sp<Fence> mMergedFence;
-        size_t mReleaseCount;
+        // One reference for each output holding the buffer, plus one held
+        // by onFrameAvailable while it queues the buffer to the outputs.
+        size_t mReferenceCount;
     };
 
     // Only called from createSplitter
@@ -160,6 +199,9 @@ private:
     virtual ~StreamSplitter();
 
     static const int MAX_OUTSTANDING_BUFFERS = 2;
+    // The most buffers a frame skipping output holds at a time: the one its
+    // consumer has acquired and the next one.
+    static const size_t MAX_SKIPPING_OUTPUT_BUFFERS = 2;
 
     // mIsAbandoned is set to true when an output dies. Once the StreamSplitter
     // has been abandoned, it will continue to detach buffers from other
@@ -170,11 +212,14 @@ private:
     Mutex mMutex;
     Condition mReleaseCondition;
     int mOutstandingBuffers;
+    // MAX_OUTSTANDING_BUFFERS, plus the buffers that frame skipping outputs
+    // may hold without stalling the other outputs
+    int mMaxOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    std::vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
-    // objects (which are mostly for counting how many outputs have released the
+    // objects (which are mostly for counting how many outputs still hold the
     // buffer, but also contain merged release fences).
     KeyedVector<uint64_t, sp<BufferTracker> > mBuffers;
 };
@@ -18,6 +18,7 @@
 #define ANDROID_GUI_SURFACE_H
 
 #include <gui/BufferQueueDefs.h>
+#include <gui/BufferSlotSet.h>
 #include <gui/HdrMetadata.h>
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/IProducerListener.h>
@@ -29,8 +30,8 @@
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
+#include <optional>
 #include <shared_mutex>
-#include <unordered_set>
 
 namespace android {
 
@@ -144,6 +145,15 @@ public:
     // See IGraphicBufferProducer::setDequeueTimeout
     status_t setDequeueTimeout(nsecs_t timeout);
 
+    // Makes queueBuffer also dequeue the next buffer, in a single call to
+    // IGraphicBufferProducer::queueAndDequeueBuffer. The next dequeueBuffer
+    // then returns that buffer, unless the requested size, format or usage
+    // changed in between. This saves a binder round trip per frame for
+    // producers that dequeue again right after queueing, such as camera and
+    // codec output. Disabled by default, since queueBuffer may then block
+    // until a buffer is free.
+    void setQueueAndDequeueEnabled(bool enabled);
+
     /*
      * Wait for frame number to increase past lastFrame for at most
      * timeoutNs. Useful for one thread to wait for another unknown
@@ -268,6 +278,7 @@ private:
     int dispatchAddQueueInterceptor(va_list args);
     int dispatchAddQueryInterceptor(va_list args);
     int dispatchGetLastQueuedBuffer(va_list args);
+    int dispatchSetBuffersProperties(va_list args);
     bool transformToDisplayInverse();
 
 protected:
@@ -287,6 +298,7 @@ protected:
     virtual int setBuffersStickyTransform(uint32_t transform);
     virtual int setBuffersTimestamp(int64_t timestamp);
     virtual int setBuffersDataSpace(ui::Dataspace dataSpace);
+    virtual int setBuffersProperties(const native_window_buffers_properties_t& properties);
     virtual int setBuffersSmpte2086Metadata(const android_smpte2086_metadata* metadata);
     virtual int setBuffersCta8613Metadata(const android_cta861_3_metadata* metadata);
     virtual int setBuffersHdr10PlusMetadata(const size_t size, const uint8_t* metadata);
@@ -366,6 +378,10 @@ protected:
 
     void freeAllBuffers();
     int getSlotFromBufferLocked(android_native_buffer_t* buffer) const;
+    // Returns the buffer dequeued by the last queueBuffer to the producer.
+    void cancelPrefetchedBufferLocked();
+    // Returns a buffer dequeued from the producer without handing it out.
+    void cancelDequeueOutputLocked(const IGraphicBufferProducer::DequeueBufferOutput& output);
 
     struct BufferSlot {
         sp<GraphicBuffer> buffer;
@@ -549,6 +565,15 @@ protected:
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
     int mMaxBufferCount;
 
+    // The NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS reported by the last connect or
+    // queueBuffer, or 0 if it has to be queried from the producer. Cleared by
+    // the calls that change it, i.e. setAsyncMode and setDequeueTimeout.
+    int mMinUndequeuedBufferCount = 0;
+
+    // The NATIVE_WINDOW_QUEUES_TO_WINDOW_COMPOSER, which does not change for a
+    // given producer, or -1 until it is queried.
+    mutable int mQueuesToWindowComposer = -1;
+
     sp<IProducerListener> mListenerProxy;
 
     // Get and flush the buffers of given slots, if the buffer in the slot
@@ -557,8 +582,20 @@ protected:
     status_t getAndFlushBuffersFromSlots(const std::vector<int32_t>& slots,
             std::vector<sp<GraphicBuffer>>* outBuffers);
 
-    // Buffers that are successfully dequeued/attached and handed to clients
-    std::unordered_set<int> mDequeuedSlots;
+    // Buffers that are successfully dequeued/attached and handed to clients. This is a fixed
+    // size set so that dequeueBuffer and queueBuffer don't allocate.
+    BufferSlotSet mDequeuedSlots;
+
+    // See setQueueAndDequeueEnabled. mPrefetchedBuffer holds the buffer
+    // dequeued by the last queueBuffer until the next dequeueBuffer, and
+    // mPrefetchedBufferInput the arguments it was dequeued with.
+    bool mQueueAndDequeueEnabled = false;
+    IGraphicBufferProducer::DequeueBufferInput mPrefetchedBufferInput;
+    std::optional<IGraphicBufferProducer::DequeueBufferOutput> mPrefetchedBuffer;
+    // Incremented whenever a prefetched buffer must not be kept, so that a
+    // queueBuffer that dequeued one without holding mMutex can tell whether
+    // to keep it.
+    uint64_t mPrefetchGeneration = 0;
 };
 
 } // namespace android
@@ -603,6 +603,13 @@ public:
                             ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
                             uint32_t reqWidth, uint32_t reqHeight, bool useIdentityTransform,
                             ui::Rotation rotation, sp<GraphicBuffer>* outBuffer);
+    // Returns once the capture is queued; outFence signals when outBuffer holds it.
+    static status_t captureAsync(const sp<IBinder>& display, ui::Dataspace reqDataSpace,
+                                 ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
+                                 uint32_t reqWidth, uint32_t reqHeight, bool useIdentityTransform,
+                                 ui::Rotation rotation, bool captureSecureLayers,
+                                 sp<GraphicBuffer>* outBuffer, sp<Fence>* outFence,
+                                 bool& outCapturedSecureLayers);
     static status_t capture(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                             sp<GraphicBuffer>* outBuffer);
     static status_t captureLayers(const sp<IBinder>& layerHandle, ui::Dataspace reqDataSpace,
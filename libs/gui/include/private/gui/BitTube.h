@@ -20,6 +20,8 @@
 #include <binder/Parcelable.h>
 #include <utils/Errors.h>
 
+#include <atomic>
+
 namespace android {
 
 class Parcel;
@@ -28,12 +30,25 @@ namespace gui {
 
 class BitTube : public Parcelable {
 public:
+    // The transport used to pass messages.
+    enum class Type : int32_t {
+        // A SOCK_SEQPACKET socket pair. Every message is copied into and out of the kernel.
+        Socket,
+        // A ring buffer in shared memory, with an eventfd to wake up the receiver. Messages are
+        // written straight into the memory the receiver reads them from. Only supports one sender
+        // and one receiver, and no messages in the other direction.
+        SharedRing,
+    };
+
     // creates an uninitialized BitTube (to unparcel into)
     BitTube() = default;
 
     // creates a BitTube with a a specified send and receive buffer size
     explicit BitTube(size_t bufsize);
 
+    // creates a BitTube of the given type. For a SharedRing, bufsize is the size of the ring.
+    BitTube(Type type, size_t bufsize);
+
     // creates a BitTube with a default (4KB) send buffer
     struct DefaultSizeType {};
     static constexpr DefaultSizeType DefaultSize{};
@@ -41,7 +56,9 @@ public:
 
     explicit BitTube(const Parcel& data);
 
-    virtual ~BitTube() = default;
+    virtual ~BitTube();
+
+    Type getType() const { return mType; }
 
     // check state after construction
     status_t initCheck() const;
@@ -61,6 +78,10 @@ public:
     // resets this BitTube's send file descriptor to sendFd
     void setSendFd(base::unique_fd&& sendFd);
 
+    // moves the receive end of this BitTube to outTube, e.g. to parcel it for the receiving
+    // process. This BitTube keeps its send end.
+    status_t moveReceiveEnd(BitTube* outTube);
+
     // send objects (sized blobs). All objects are guaranteed to be written or the call fails.
     template <typename T>
     static ssize_t sendObjects(BitTube* tube, T const* events, size_t count) {
@@ -79,7 +100,36 @@ public:
     status_t readFromParcel(const Parcel* parcel);
 
 private:
+    // Lives at the start of the shared memory of a SharedRing, followed by the ring itself,
+    // whose size is a power of two. The offsets increase monotonically and wrap around; their
+    // difference is the number of bytes in use. Each message is stored as a RecordHeader followed
+    // by the message, padded to kRecordAlignment.
+    struct RingHeader {
+        // Only written by the sender.
+        std::atomic<uint32_t> head;
+        // Only written by the receiver.
+        std::atomic<uint32_t> tail;
+    };
+
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    static constexpr uint32_t kRecordAlignment = 8;
+    // A record that fills the end of the ring, where the next message did not fit.
+    static constexpr uint32_t kWrapRecordSize = UINT32_MAX;
+
     void init(size_t rcvbuf, size_t sndbuf);
+    void initRing(size_t capacity);
+    // Maps the ring on first use. Returns false if it cannot be mapped.
+    bool mapRing();
+    void unmapRing();
+
+    ssize_t writeRing(void const* vaddr, size_t size);
+    ssize_t readRing(void* vaddr, size_t size);
+    // Copies out the next message, or returns 0 if the ring is empty.
+    ssize_t popRing(void* vaddr, size_t size);
 
     // send a message. The write is guaranteed to send the whole message or fail.
     ssize_t write(void const* vaddr, size_t size);
@@ -88,9 +138,20 @@ private:
     // the message, excess data is silently discarded.
     ssize_t read(void* vaddr, size_t size);
 
+    Type mType = Type::Socket;
     mutable base::unique_fd mSendFd;
+    // For a SharedRing, the eventfd that is signalled when the ring is written.
     mutable base::unique_fd mReceiveFd;
 
+    // For a SharedRing: the shared memory and its mapping.
+    base::unique_fd mRingFd;
+    RingHeader* mRing = nullptr;
+    uint32_t mRingCapacity = 0;
+    // The offsets this end owns. The shared copies are only written from these, never read back,
+    // as the other process can write to the shared memory too.
+    uint32_t mRingHead = 0;
+    uint32_t mRingTail = 0;
+
     static ssize_t sendObjects(BitTube* tube, void const* events, size_t count, size_t objSize);
 
     static ssize_t recvObjects(BitTube* tube, void* events, size_t count, size_t objSize);
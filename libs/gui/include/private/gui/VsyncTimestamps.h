@@ -0,0 +1,84 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace android {
+namespace gui {
+
+// Layout of the shared memory through which an EventThread publishes its latest vsync, so that
+// clients can read it without reading events from their BitTube. The EventThread is the only
+// writer and maps the memory read-write; clients map it read-only.
+//
+// The record is guarded by a sequence counter, which is odd while a write is in progress.
+// Readers retry until they see the same even value before and after reading the fields.
+struct VsyncTimestamps {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> count;
+    std::atomic<int64_t> timestamp;
+    std::atomic<int64_t> expectedVSyncTimestamp;
+
+    // Called by the EventThread only.
+    void publish(uint32_t vsyncCount, nsecs_t vsyncTimestamp, nsecs_t expectedTimestamp) {
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        count.store(vsyncCount, std::memory_order_relaxed);
+        timestamp.store(vsyncTimestamp, std::memory_order_relaxed);
+        expectedVSyncTimestamp.store(expectedTimestamp, std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Returns false if no vsync was published yet, or if the record kept changing under the
+    // reader, which would take a writer stalled in the middle of publish().
+    bool read(uint32_t* outCount, nsecs_t* outTimestamp, nsecs_t* outExpectedTimestamp) const {
+        constexpr int kMaxAttempts = 16;
+        for (int attempt = 0; attempt < kMaxAttempts; attempt++) {
+            const uint32_t seq = sequence.load(std::memory_order_acquire);
+            if (seq & 1) {
+                continue;
+            }
+            const uint32_t vsyncCount = count.load(std::memory_order_relaxed);
+            const nsecs_t vsyncTimestamp = timestamp.load(std::memory_order_relaxed);
+            const nsecs_t expectedTimestamp = expectedVSyncTimestamp.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            if (seq == 0) {
+                return false;
+            }
+            *outCount = vsyncCount;
+            *outTimestamp = vsyncTimestamp;
+            *outExpectedTimestamp = expectedTimestamp;
+            return true;
+        }
+        return false;
+    }
+};
+
+// The memory is shared between 32 and 64 bit processes, so the layout must not depend on the ABI
+// and the atomics must not fall back to locks.
+static_assert(sizeof(VsyncTimestamps) == 24);
+static_assert(std::atomic<int64_t>::is_always_lock_free);
+
+} // namespace gui
+} // namespace android
@@ -54,6 +54,10 @@ public:
         mBlastBufferQueueAdapter->setNextTransaction(next);
     }
 
+    status_t setMaxInFlightTransactions(int32_t count) {
+        return mBlastBufferQueueAdapter->setMaxInFlightTransactions(count);
+    }
+
     int getWidth() { return mBlastBufferQueueAdapter->mWidth; }
 
     int getHeight() { return mBlastBufferQueueAdapter->mHeight; }
@@ -350,6 +354,37 @@ TEST_F(BLASTBufferQueueTest, TripleBuffering) {
     adapter.waitForCallbacks();
 }
 
+TEST_F(BLASTBufferQueueTest, PipelinedTransactions) {
+    BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    ASSERT_EQ(BAD_VALUE, adapter.setMaxInFlightTransactions(0));
+    ASSERT_EQ(NO_ERROR, adapter.setMaxInFlightTransactions(2));
+
+    sp<IGraphicBufferProducer> igbProducer;
+    setUpProducer(adapter, igbProducer);
+
+    for (int i = 0; i < 100; i++) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buf;
+        auto ret = igbProducer->dequeueBuffer(&slot, &fence, mDisplayWidth, mDisplayHeight,
+                                              PIXEL_FORMAT_RGBA_8888, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                              nullptr, nullptr);
+        if (ret & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, igbProducer->requestBuffer(slot, &buf));
+        }
+        IGraphicBufferProducer::QueueBufferOutput qbOutput;
+        IGraphicBufferProducer::QueueBufferInput input(systemTime(), false, HAL_DATASPACE_UNKNOWN,
+                                                       Rect(mDisplayWidth, mDisplayHeight),
+                                                       NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                       Fence::NO_FENCE);
+        ASSERT_EQ(NO_ERROR, igbProducer->queueBuffer(slot, input, &qbOutput));
+    }
+    adapter.waitForCallbacks();
+
+    // Returning to a single transaction in flight is allowed once the pipeline has drained.
+    ASSERT_EQ(NO_ERROR, adapter.setMaxInFlightTransactions(1));
+}
+
 TEST_F(BLASTBufferQueueTest, SetCrop_Item) {
     uint8_t r = 255;
     uint8_t g = 0;
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <poll.h>
+
+#include <binder/Parcel.h>
+#include <private/gui/BitTube.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+using gui::BitTube;
+
+namespace {
+
+struct Message {
+    uint64_t id;
+    uint8_t payload[56];
+};
+
+bool isReadable(int fd) {
+    pollfd pfd{.fd = fd, .events = POLLIN};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+// Moves the receive end of a tube through a parcel, as it would be sent to another process.
+void moveReceiveEnd(BitTube* sender, BitTube* receiver) {
+    ASSERT_EQ(NO_ERROR, sender->initCheck());
+    BitTube receiveEnd;
+    ASSERT_EQ(NO_ERROR, sender->moveReceiveEnd(&receiveEnd));
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, receiveEnd.writeToParcel(&parcel));
+    parcel.setDataPosition(0);
+    ASSERT_EQ(NO_ERROR, receiver->readFromParcel(&parcel));
+    EXPECT_EQ(sender->getType(), receiver->getType());
+}
+
+class BitTubeTest : public testing::TestWithParam<BitTube::Type> {};
+
+TEST_P(BitTubeTest, SendsAndReceivesObjects) {
+    BitTube sender(GetParam(), 4096);
+    BitTube receiver;
+    ASSERT_NO_FATAL_FAILURE(moveReceiveEnd(&sender, &receiver));
+
+    Message out[2] = {{.id = 1}, {.id = 2}};
+    ASSERT_EQ(2, BitTube::sendObjects(&sender, out, 2));
+    ASSERT_EQ(1, BitTube::sendObjects(&sender, &out[0], 1));
+    EXPECT_TRUE(isReadable(receiver.getFd()));
+
+    // Each call receives one message, like a SOCK_SEQPACKET socket.
+    Message in[4] = {};
+    ASSERT_EQ(2, BitTube::recvObjects(&receiver, in, 4));
+    EXPECT_EQ(1u, in[0].id);
+    EXPECT_EQ(2u, in[1].id);
+    ASSERT_EQ(1, BitTube::recvObjects(&receiver, in, 4));
+    EXPECT_EQ(1u, in[0].id);
+
+    EXPECT_EQ(0, BitTube::recvObjects(&receiver, in, 4));
+    EXPECT_FALSE(isReadable(receiver.getFd()));
+}
+
+INSTANTIATE_TEST_CASE_P(BitTubeTypes, BitTubeTest,
+                        testing::Values(BitTube::Type::Socket, BitTube::Type::SharedRing));
+
+TEST(BitTubeSharedRingTest, WrapsAroundTheRing) {
+    BitTube sender(BitTube::Type::SharedRing, 1024);
+    BitTube receiver;
+    ASSERT_NO_FATAL_FAILURE(moveReceiveEnd(&sender, &receiver));
+
+    // 1024 is not a multiple of the record size, so messages keep wrapping at different offsets.
+    for (uint64_t id = 0; id < 100; id++) {
+        Message out[3] = {{.id = id}, {.id = id + 1}, {.id = id + 2}};
+        const size_t count = id % 3 + 1;
+        ASSERT_EQ(static_cast<ssize_t>(count), BitTube::sendObjects(&sender, out, count));
+
+        Message in[3] = {};
+        ASSERT_EQ(static_cast<ssize_t>(count), BitTube::recvObjects(&receiver, in, 3));
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(id + i, in[i].id);
+        }
+    }
+}
+
+TEST(BitTubeSharedRingTest, FailsWithEagainWhenFull) {
+    BitTube sender(BitTube::Type::SharedRing, 1024);
+    BitTube receiver;
+    ASSERT_NO_FATAL_FAILURE(moveReceiveEnd(&sender, &receiver));
+
+    // Each message takes 72 bytes of the ring with its header.
+    Message message{};
+    for (int i = 0; i < 1024 / 72; i++) {
+        ASSERT_EQ(1, BitTube::sendObjects(&sender, &message, 1));
+    }
+    EXPECT_EQ(-EAGAIN, BitTube::sendObjects(&sender, &message, 1));
+
+    Message in;
+    ASSERT_EQ(1, BitTube::recvObjects(&receiver, &in, 1));
+    EXPECT_EQ(1, BitTube::sendObjects(&sender, &message, 1));
+}
+
+TEST(BitTubeSharedRingTest, DiscardsExcessOfLargerMessages) {
+    BitTube sender(BitTube::Type::SharedRing, 1024);
+    BitTube receiver;
+    ASSERT_NO_FATAL_FAILURE(moveReceiveEnd(&sender, &receiver));
+
+    Message out[2] = {{.id = 1}, {.id = 2}};
+    ASSERT_EQ(2, BitTube::sendObjects(&sender, out, 2));
+    ASSERT_EQ(1, BitTube::sendObjects(&sender, &out[1], 1));
+
+    Message in;
+    ASSERT_EQ(1, BitTube::recvObjects(&receiver, &in, 1));
+    EXPECT_EQ(1u, in.id);
+    ASSERT_EQ(1, BitTube::recvObjects(&receiver, &in, 1));
+    EXPECT_EQ(2u, in.id);
+}
+
+} // namespace
+} // namespace android
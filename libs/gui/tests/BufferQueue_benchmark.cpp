@@ -0,0 +1,200 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "DummyConsumer.h"
+#include "FrameLatencyRecorder.h"
+
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <log/log.h>
+#include <system/window.h>
+#include <ui/GraphicBuffer.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace android {
+namespace {
+
+const String16 kRemoteProducerName("BQBenchmarkProducer");
+const String16 kRemoteConsumerName("BQBenchmarkConsumer");
+
+// A connected BufferQueue whose buffers have all been allocated, so that the
+// benchmarks measure the slot bookkeeping rather than gralloc.
+class BufferQueueHarness {
+public:
+    explicit BufferQueueHarness(int maxDequeuedBuffers) {
+        BufferQueue::createBufferQueue(&mProducer, &mConsumer);
+        connect(maxDequeuedBuffers);
+    }
+
+    // Uses the BufferQueue hosted by the service process, so that every
+    // producer and consumer call is a binder transaction.
+    BufferQueueHarness(int maxDequeuedBuffers, const sp<IGraphicBufferProducer>& producer,
+                       const sp<IGraphicBufferConsumer>& consumer)
+          : mProducer(producer), mConsumer(consumer) {
+        connect(maxDequeuedBuffers);
+    }
+
+    // Disconnecting the consumer would abandon the queue, so only the
+    // producer is disconnected. This frees the buffers of a shared queue.
+    ~BufferQueueHarness() { mProducer->disconnect(NATIVE_WINDOW_API_CPU); }
+
+    // Sends one frame from the producer to the consumer and back.
+    void runFrame() {
+        int slot;
+        sp<Fence> fence;
+        const status_t result = mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0,
+                                                         GRALLOC_USAGE_SW_READ_OFTEN, nullptr,
+                                                         nullptr);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            mProducer->requestBuffer(slot, &buffer);
+        }
+        queueAndRelease(slot);
+    }
+
+    void queueAndRelease(int slot) {
+        IGraphicBufferProducer::QueueBufferOutput output;
+        mProducer->queueBuffer(slot, mInput, &output);
+
+        BufferItem item;
+        mConsumer->acquireBuffer(&item, 0);
+        mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                                 Fence::NO_FENCE);
+    }
+
+    const sp<IGraphicBufferProducer>& producer() const { return mProducer; }
+
+private:
+    void connect(int maxDequeuedBuffers) {
+        mConsumer->consumerConnect(new DummyConsumer, false);
+        IGraphicBufferProducer::QueueBufferOutput output;
+        mProducer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU, false, &output);
+        mProducer->setMaxDequeuedBufferCount(maxDequeuedBuffers);
+        mProducer->allowAllocation(true);
+
+        // Cycle through every slot once to attach the buffers.
+        for (int i = 0; i < maxDequeuedBuffers + 1; i++) {
+            runFrame();
+        }
+    }
+
+    sp<IGraphicBufferProducer> mProducer;
+    sp<IGraphicBufferConsumer> mConsumer;
+    const IGraphicBufferProducer::QueueBufferInput mInput{0,
+                                                          false,
+                                                          HAL_DATASPACE_UNKNOWN,
+                                                          Rect(0, 0, 1, 1),
+                                                          NATIVE_WINDOW_SCALING_MODE_FREEZE,
+                                                          0,
+                                                          Fence::NO_FENCE};
+};
+
+// Full dequeue/queue/acquire/release cycle, as done once per app frame.
+void BM_FrameCycle(benchmark::State& state) {
+    BufferQueueHarness harness(static_cast<int>(state.range(0)));
+    FrameLatencyRecorder latency(state);
+    for (auto _ : state) {
+        latency.start();
+        harness.runFrame();
+        latency.stop();
+    }
+}
+BENCHMARK(BM_FrameCycle)->Arg(1)->Arg(2)->Arg(3);
+
+// The same cycle against a BufferQueue living in another process, like an app
+// producing into a SurfaceFlinger-owned queue.
+void BM_RemoteFrameCycle(benchmark::State& state) {
+    sp<IServiceManager> serviceManager = defaultServiceManager();
+    sp<IGraphicBufferProducer> producer = interface_cast<IGraphicBufferProducer>(
+            serviceManager->getService(kRemoteProducerName));
+    sp<IGraphicBufferConsumer> consumer = interface_cast<IGraphicBufferConsumer>(
+            serviceManager->getService(kRemoteConsumerName));
+    if (producer == nullptr || consumer == nullptr) {
+        state.SkipWithError("BufferQueue service is not running");
+        return;
+    }
+
+    BufferQueueHarness harness(static_cast<int>(state.range(0)), producer, consumer);
+    FrameLatencyRecorder latency(state);
+    for (auto _ : state) {
+        latency.start();
+        harness.runFrame();
+        latency.stop();
+    }
+}
+BENCHMARK(BM_RemoteFrameCycle)->Arg(1)->Arg(2)->Arg(3);
+
+// dequeueBuffer alone. The buffer is returned outside of the timed region.
+void BM_DequeueBuffer(benchmark::State& state) {
+    BufferQueueHarness harness(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        int slot;
+        sp<Fence> fence;
+        benchmark::DoNotOptimize(harness.producer()->dequeueBuffer(&slot, &fence, 1, 1, 0,
+                                                                   GRALLOC_USAGE_SW_READ_OFTEN,
+                                                                   nullptr, nullptr));
+        state.PauseTiming();
+        harness.producer()->cancelBuffer(slot, Fence::NO_FENCE);
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_DequeueBuffer)->Arg(1)->Arg(3);
+
+// Hosts the BufferQueue used by BM_RemoteFrameCycle. Never returns.
+[[noreturn]] void runBufferQueueService() {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<IServiceManager> serviceManager = defaultServiceManager();
+    serviceManager->addService(kRemoteProducerName, IInterface::asBinder(producer));
+    serviceManager->addService(kRemoteConsumerName, IInterface::asBinder(consumer));
+    ProcessState::self()->startThreadPool();
+    IPCThreadState::self()->joinThreadPool();
+    LOG_ALWAYS_FATAL("BufferQueue service exited");
+}
+
+} // namespace
+} // namespace android
+
+// The BufferQueue for the cross-process benchmarks is hosted by a child
+// process, which has to be forked before this process starts binder threads.
+int main(int argc, char** argv) {
+    const pid_t servicePid = fork();
+    if (servicePid == 0) {
+        android::runBufferQueueService();
+    }
+
+    // The consumer listener is called back from the service process.
+    android::ProcessState::self()->startThreadPool();
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+
+    if (servicePid > 0) {
+        kill(servicePid, SIGKILL);
+        waitpid(servicePid, nullptr, 0);
+    }
+    return 0;
+}
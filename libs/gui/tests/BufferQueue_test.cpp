@@ -169,6 +169,49 @@ TEST_F(BufferQueueTest, DISABLED_BufferQueueInAnotherProcess) {
     ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
 }
 
+TEST_F(BufferQueueTest, QueueAndDequeueBuffer_ReturnsNextBuffer) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_READ_OFTEN,
+                                       nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+
+    IGraphicBufferProducer::QueueBufferInput input(0, false, HAL_DATASPACE_UNKNOWN,
+                                                   Rect(0, 0, 1, 1),
+                                                   NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                   Fence::NO_FENCE);
+    IGraphicBufferProducer::DequeueBufferInput dequeueInput;
+    dequeueInput.width = 1;
+    dequeueInput.height = 1;
+    dequeueInput.usage = GRALLOC_USAGE_SW_READ_OFTEN;
+    IGraphicBufferProducer::DequeueBufferOutput dequeueOutput;
+    ASSERT_EQ(OK,
+              mProducer->queueAndDequeueBuffer(slot, input, &output, dequeueInput,
+                                               &dequeueOutput));
+
+    // The first slot is still queued, so a new buffer was allocated and returned.
+    EXPECT_NE(slot, dequeueOutput.slot);
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION, dequeueOutput.result);
+    ASSERT_NE(nullptr, dequeueOutput.buffer.get());
+
+    BufferItem item;
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    EXPECT_EQ(slot, item.mSlot);
+
+    // The returned buffer can be queued without calling requestBuffer.
+    ASSERT_EQ(OK, mProducer->queueBuffer(dequeueOutput.slot, input, &output));
+}
+
 TEST_F(BufferQueueTest, GetMaxBufferCountInQueueBufferOutput_Succeeds) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
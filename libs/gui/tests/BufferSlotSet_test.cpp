@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/BufferSlotSet.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace android {
+
+using BufferQueueDefs::NUM_BUFFER_SLOTS;
+
+TEST(BufferSlotSetTest, IteratesInAscendingOrder) {
+    BufferSlotSet set;
+    EXPECT_TRUE(set.empty());
+
+    set.insert(NUM_BUFFER_SLOTS - 1);
+    set.insert(5);
+    set.insert(0);
+    set.insert(5);
+
+    EXPECT_EQ(3u, set.size());
+    EXPECT_EQ(1u, set.count(5));
+    EXPECT_EQ(0u, set.count(4));
+    EXPECT_EQ((std::vector<int>{0, 5, NUM_BUFFER_SLOTS - 1}),
+              std::vector<int>(set.begin(), set.end()));
+}
+
+TEST(BufferSlotSetTest, EraseRemovesSlot) {
+    BufferSlotSet set;
+    set.insert(2);
+    set.insert(7);
+
+    set.erase(set.begin());
+    EXPECT_EQ(7, *set.begin());
+    set.erase(7);
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(BufferSlotListTest, KeepsInsertionOrder) {
+    BufferSlotList list;
+    EXPECT_TRUE(list.empty());
+
+    list.push_back(3);
+    list.push_back(1);
+    list.push_front(9);
+
+    EXPECT_EQ(3u, list.size());
+    EXPECT_EQ(9, list.front());
+    EXPECT_EQ(1, list.back());
+    EXPECT_EQ((std::vector<int>{9, 3, 1}), std::vector<int>(list.begin(), list.end()));
+
+    list.pop_front();
+    list.pop_back();
+    EXPECT_EQ((std::vector<int>{3}), std::vector<int>(list.begin(), list.end()));
+}
+
+TEST(BufferSlotListTest, HoldsEverySlotAcrossWraparound) {
+    BufferSlotList list;
+    for (int slot = 0; slot < NUM_BUFFER_SLOTS; slot++) {
+        list.push_front(slot);
+    }
+
+    EXPECT_EQ(static_cast<size_t>(NUM_BUFFER_SLOTS), list.size());
+    EXPECT_EQ(NUM_BUFFER_SLOTS - 1, list.front());
+    EXPECT_EQ(0, list.back());
+}
+
+TEST(BufferSlotListTest, RemoveKeepsOrderOfOtherSlots) {
+    BufferSlotList list;
+    for (int slot : {4, 8, 15, 16, 23}) {
+        list.push_back(slot);
+    }
+
+    list.remove(15);
+    list.remove(4);
+    list.remove(42);
+
+    EXPECT_EQ((std::vector<int>{8, 16, 23}), std::vector<int>(list.begin(), list.end()));
+    EXPECT_EQ(list.cend(), std::find(list.cbegin(), list.cend(), 15));
+}
+
+} // namespace android
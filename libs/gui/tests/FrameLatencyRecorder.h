@@ -0,0 +1,71 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace android {
+
+// Records the duration of every benchmark iteration and reports the latency
+// percentiles as counters. The mean reported by the benchmark library hides
+// the occasional slow frame, which is what shows up as jank.
+class FrameLatencyRecorder {
+public:
+    explicit FrameLatencyRecorder(benchmark::State& state) : mState(state) {
+        mSamples.reserve(static_cast<size_t>(std::min<benchmark::IterationCount>(
+                state.max_iterations, kMaxReservedSamples)));
+    }
+
+    ~FrameLatencyRecorder() {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        mState.counters["p50_ns"] = percentile(0.50);
+        mState.counters["p90_ns"] = percentile(0.90);
+        mState.counters["p99_ns"] = percentile(0.99);
+        mState.counters["max_ns"] = static_cast<double>(mSamples.back());
+    }
+
+    void start() { mStart = Clock::now(); }
+
+    void stop() {
+        mSamples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                                mStart)
+                                   .count());
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr benchmark::IterationCount kMaxReservedSamples = 1 << 20;
+
+    double percentile(double fraction) const {
+        const size_t index = static_cast<size_t>(fraction * static_cast<double>(mSamples.size()));
+        return static_cast<double>(mSamples[std::min(index, mSamples.size() - 1)]);
+    }
+
+    benchmark::State& mState;
+    std::vector<int64_t> mSamples;
+    Clock::time_point mStart;
+};
+
+} // namespace android
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+TEST(LayerStateTest, WritesOnlyChangedFields) {
+    layer_state_t full;
+    full.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged |
+            layer_state_t::eMatrixChanged | layer_state_t::eCropChanged |
+            layer_state_t::eColorTransformChanged | layer_state_t::eMetadataChanged;
+    layer_state_t delta;
+    delta.what = layer_state_t::ePositionChanged;
+
+    Parcel fullParcel;
+    Parcel deltaParcel;
+    ASSERT_EQ(NO_ERROR, full.write(fullParcel));
+    ASSERT_EQ(NO_ERROR, delta.write(deltaParcel));
+    EXPECT_LT(deltaParcel.dataSize(), fullParcel.dataSize());
+}
+
+TEST(LayerStateTest, ReadsBackChangedFields) {
+    layer_state_t in;
+    in.what = layer_state_t::ePositionChanged | layer_state_t::eLayerChanged |
+            layer_state_t::eFlagsChanged | layer_state_t::eColorChanged |
+            layer_state_t::eCropChanged | layer_state_t::eFrameRateChanged;
+    in.x = 10.f;
+    in.y = 20.f;
+    in.z = 3;
+    in.flags = layer_state_t::eLayerHidden;
+    in.mask = layer_state_t::eLayerHidden;
+    in.color = half3(0.25f, 0.5f, 0.75f);
+    in.crop = Rect(1, 2, 3, 4);
+    in.frameRate = 60.f;
+    in.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+    // Not selected by 'what', so not sent.
+    in.alpha = 0.5f;
+    in.cornerRadius = 8.f;
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, in.write(parcel));
+    parcel.setDataPosition(0);
+
+    layer_state_t out;
+    ASSERT_EQ(NO_ERROR, out.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    EXPECT_EQ(in.what, out.what);
+    EXPECT_EQ(10.f, out.x);
+    EXPECT_EQ(20.f, out.y);
+    EXPECT_EQ(3, out.z);
+    EXPECT_EQ(layer_state_t::eLayerHidden, out.flags);
+    EXPECT_EQ(layer_state_t::eLayerHidden, out.mask);
+    EXPECT_EQ(0.25f, static_cast<float>(out.color.r));
+    EXPECT_EQ(0.5f, static_cast<float>(out.color.g));
+    EXPECT_EQ(0.75f, static_cast<float>(out.color.b));
+    EXPECT_EQ(Rect(1, 2, 3, 4), out.crop);
+    EXPECT_EQ(60.f, out.frameRate);
+    EXPECT_EQ(ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE, out.frameRateCompatibility);
+    EXPECT_EQ(layer_state_t().alpha, out.alpha);
+    EXPECT_EQ(layer_state_t().cornerRadius, out.cornerRadius);
+}
+
+TEST(LayerStateTest, ReadsBackListenersWithoutOtherChanges) {
+    layer_state_t in;
+    in.listeners.emplace_back(new BBinder(), std::vector<CallbackId>{1, 2});
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, in.write(parcel));
+    parcel.setDataPosition(0);
+
+    layer_state_t out;
+    ASSERT_EQ(NO_ERROR, out.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    ASSERT_EQ(1u, out.listeners.size());
+    EXPECT_EQ((std::vector<CallbackId>{1, 2}), out.listeners[0].callbackIds);
+}
+
+} // namespace android
@@ -195,6 +195,100 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, FrameSkippingOutputDoesNotStallOthers) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> fastProducer;
+    sp<IGraphicBufferConsumer> fastConsumer;
+    BufferQueue::createBufferQueue(&fastProducer, &fastConsumer);
+    ASSERT_EQ(OK, fastConsumer->consumerConnect(new DummyListener, false));
+
+    sp<IGraphicBufferProducer> slowProducer;
+    sp<IGraphicBufferConsumer> slowConsumer;
+    BufferQueue::createBufferQueue(&slowProducer, &slowConsumer);
+    ASSERT_EQ(OK, slowConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(fastProducer));
+    ASSERT_EQ(OK, splitter->addOutput(slowProducer, /* allowFrameSkipping */ true));
+    ASSERT_EQ(OK, fastProducer->allowAllocation(false));
+    ASSERT_EQ(OK, slowProducer->allowAllocation(false));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+
+    // The first buffer goes to both outputs, and the slow one keeps it
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+    BufferItem slowItem;
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&slowItem, 0));
+    BufferItem item;
+    ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // The second buffer goes to both outputs too, since the slow output only
+    // holds the buffer its consumer acquired
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+    ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // The third buffer is only queued to the fast output, since the slow
+    // output has not acquired the second one yet
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+    ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // Like GLConsumer, the slow consumer acquires the next buffer before it
+    // releases its current one
+    BufferItem nextSlowItem;
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&nextSlowItem, 0));
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+              slowConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(slowItem.mSlot, slowItem.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // Every output released the first buffer, so it is back in the input
+    // even though the slow output still holds the second one
+    ASSERT_EQ(OK, inputProducer->allowAllocation(false));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+
+    // The slow output keeps receiving frames while it holds its current buffer
+    ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(nextSlowItem.mSlot, nextSlowItem.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
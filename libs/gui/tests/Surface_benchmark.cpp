@@ -0,0 +1,181 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "DummyConsumer.h"
+#include "FrameLatencyRecorder.h"
+
+#include <gui/BLASTBufferQueue.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <system/window.h>
+#include <ui/DisplayConfig.h>
+
+#include <limits>
+
+namespace android {
+namespace {
+
+enum class SurfaceMode {
+    SwapInterval1,
+    SwapInterval0,
+    AsyncMode,
+    SharedBufferMode,
+};
+
+// A Surface connected to an in-process BufferQueue. The consumer side acquires
+// and releases every queued frame synchronously, so the benchmarks measure the
+// ANativeWindow path taken by apps rather than a consumer's pace.
+class SurfaceHarness {
+public:
+    explicit SurfaceHarness(SurfaceMode mode) {
+        sp<IGraphicBufferProducer> producer;
+        BufferQueue::createBufferQueue(&producer, &mConsumer);
+        mConsumer->consumerConnect(new DummyConsumer, false);
+        mSurface = new Surface(producer, /*controlledByApp=*/false);
+        mWindow = mSurface.get();
+
+        native_window_api_connect(mWindow, NATIVE_WINDOW_API_CPU);
+        native_window_set_buffers_dimensions(mWindow, 1, 1);
+        native_window_set_usage(mWindow, GRALLOC_USAGE_SW_READ_OFTEN);
+        switch (mode) {
+            case SurfaceMode::SwapInterval1:
+                mWindow->setSwapInterval(mWindow, 1);
+                break;
+            case SurfaceMode::SwapInterval0:
+                mWindow->setSwapInterval(mWindow, 0);
+                break;
+            case SurfaceMode::AsyncMode:
+                mSurface->setAsyncMode(true);
+                break;
+            case SurfaceMode::SharedBufferMode:
+                native_window_set_shared_buffer_mode(mWindow, true);
+                native_window_set_auto_refresh(mWindow, true);
+                break;
+        }
+
+        // Allocate the buffers outside of the measured frames.
+        for (int i = 0; i < BufferQueueDefs::NUM_BUFFER_SLOTS; i++) {
+            runFrame();
+        }
+    }
+
+    ~SurfaceHarness() { native_window_api_disconnect(mWindow, NATIVE_WINDOW_API_CPU); }
+
+    void runFrame() {
+        ANativeWindowBuffer* buffer;
+        int fenceFd;
+        mWindow->dequeueBuffer(mWindow, &buffer, &fenceFd);
+        mWindow->queueBuffer(mWindow, buffer, fenceFd);
+
+        BufferItem item;
+        if (mConsumer->acquireBuffer(&item, 0) == NO_ERROR) {
+            mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                     EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+        }
+    }
+
+private:
+    sp<IGraphicBufferConsumer> mConsumer;
+    sp<Surface> mSurface;
+    ANativeWindow* mWindow;
+};
+
+void BM_SurfaceFrameCycle(benchmark::State& state, SurfaceMode mode) {
+    SurfaceHarness harness(mode);
+    FrameLatencyRecorder latency(state);
+    for (auto _ : state) {
+        latency.start();
+        harness.runFrame();
+        latency.stop();
+    }
+}
+BENCHMARK_CAPTURE(BM_SurfaceFrameCycle, SwapInterval1, SurfaceMode::SwapInterval1);
+BENCHMARK_CAPTURE(BM_SurfaceFrameCycle, SwapInterval0, SurfaceMode::SwapInterval0);
+BENCHMARK_CAPTURE(BM_SurfaceFrameCycle, AsyncMode, SurfaceMode::AsyncMode);
+BENCHMARK_CAPTURE(BM_SurfaceFrameCycle, SharedBufferMode, SurfaceMode::SharedBufferMode);
+
+// dequeueBuffer/queueBuffer into a BLASTBufferQueue shown on the internal
+// display. Buffers come back through SurfaceFlinger's transaction callbacks,
+// so this includes the composition round-trip and needs a running system.
+void BM_BLASTFrameCycle(benchmark::State& state) {
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+    sp<IBinder> displayToken = client->getInternalDisplayToken();
+    DisplayConfig config;
+    if (displayToken == nullptr ||
+        SurfaceComposerClient::getActiveDisplayConfig(displayToken, &config) != NO_ERROR) {
+        state.SkipWithError("No internal display");
+        return;
+    }
+
+    const ui::Size& resolution = config.resolution;
+    sp<SurfaceControl> surfaceControl =
+            client->createSurface(String8("BLASTBenchmarkSurface"), resolution.getWidth(),
+                                  resolution.getHeight(), PIXEL_FORMAT_RGBA_8888,
+                                  ISurfaceComposerClient::eFXSurfaceBufferState,
+                                  /*parent*/ nullptr);
+    SurfaceComposerClient::Transaction()
+            .setLayer(surfaceControl, std::numeric_limits<int32_t>::max())
+            .setFrame(surfaceControl, Rect(resolution))
+            .show(surfaceControl)
+            .apply(/*synchronous=*/true);
+
+    sp<BLASTBufferQueue> blastBufferQueue =
+            new BLASTBufferQueue(surfaceControl, resolution.getWidth(), resolution.getHeight());
+    sp<IGraphicBufferProducer> producer = blastBufferQueue->getIGraphicBufferProducer();
+    IGraphicBufferProducer::QueueBufferOutput output;
+    producer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU, false, &output);
+    producer->setMaxDequeuedBufferCount(2);
+
+    const IGraphicBufferProducer::QueueBufferInput input(0, false, HAL_DATASPACE_UNKNOWN,
+                                                         Rect(resolution),
+                                                         NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                         Fence::NO_FENCE);
+    auto runFrame = [&] {
+        int slot;
+        sp<Fence> fence;
+        const status_t result =
+                producer->dequeueBuffer(&slot, &fence, resolution.getWidth(),
+                                        resolution.getHeight(), PIXEL_FORMAT_RGBA_8888,
+                                        GRALLOC_USAGE_HW_COMPOSER, nullptr, nullptr);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            producer->requestBuffer(slot, &buffer);
+        }
+        producer->queueBuffer(slot, input, &output);
+    };
+
+    for (int i = 0; i < 3; i++) {
+        runFrame();
+    }
+
+    FrameLatencyRecorder latency(state);
+    for (auto _ : state) {
+        latency.start();
+        runFrame();
+        latency.stop();
+    }
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+}
+BENCHMARK(BM_BLASTFrameCycle)->UseRealTime();
+
+} // namespace
+} // namespace android
@@ -34,6 +34,7 @@
 #include <ui/Rect.h>
 #include <utils/String8.h>
 
+#include <future>
 #include <limits>
 #include <thread>
 
@@ -319,6 +320,54 @@ TEST_F(SurfaceTest, QueryConsumerUsage) {
     ASSERT_EQ(TEST_USAGE_FLAGS, flags);
 }
 
+TEST_F(SurfaceTest, QueueAndDequeueDoesNotBlockOtherCalls) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    ASSERT_EQ(OK, consumer->consumerConnect(dummyConsumer, false));
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    // Three buffers: one for the consumer and two for the producer.
+    ASSERT_EQ(NO_ERROR, surface->setMaxDequeuedBufferCount(2));
+
+    ANativeWindowBuffer* buffers[3];
+    int fenceFd;
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffers[0], &fenceFd));
+    ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffers[0], fenceFd));
+    BufferItem item;
+    ASSERT_EQ(NO_ERROR, consumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffers[1], &fenceFd));
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffers[2], &fenceFd));
+
+    // With every buffer in use, the dequeue half of queueBuffer waits for a free one.
+    surface->setQueueAndDequeueEnabled(true);
+    auto queued = std::async(std::launch::async, [&] {
+        return window->queueBuffer(window.get(), buffers[1], -1);
+    });
+    ASSERT_EQ(std::future_status::timeout, queued.wait_for(100ms));
+
+    int width;
+    auto queried = std::async(std::launch::async, [&] {
+        return window->query(window.get(), NATIVE_WINDOW_WIDTH, &width);
+    });
+    EXPECT_EQ(std::future_status::ready, queried.wait_for(1s));
+    // Returning a buffer frees a slot for the blocked dequeue.
+    auto canceled = std::async(std::launch::async, [&] {
+        return window->cancelBuffer(window.get(), buffers[2], -1);
+    });
+    EXPECT_EQ(std::future_status::ready, canceled.wait_for(1s));
+
+    // Unblock everything in case the calls above were stuck.
+    ASSERT_EQ(NO_ERROR,
+              consumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                      EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    EXPECT_EQ(NO_ERROR, queried.get());
+    EXPECT_EQ(NO_ERROR, canceled.get());
+    EXPECT_EQ(NO_ERROR, queued.get());
+}
+
 TEST_F(SurfaceTest, QueryDefaultBuffersDataSpace) {
     const android_dataspace TEST_DATASPACE = HAL_DATASPACE_V0_SRGB;
     sp<IGraphicBufferProducer> producer;
@@ -686,7 +735,8 @@ public:
                              const Vector<DisplayState>& /*displays*/, uint32_t /*flags*/,
                              const sp<IBinder>& /*applyToken*/,
                              const InputWindowCommands& /*inputWindowCommands*/,
-                             int64_t /*desiredPresentTime*/, const client_cache_t& /*cachedBuffer*/,
+                             int64_t /*desiredPresentTime*/, int64_t /*applyTime*/,
+                             const client_cache_t& /*cachedBuffer*/,
                              bool /*hasListenerCallbacks*/,
                              const std::vector<ListenerCallbacks>& /*listenerCallbacks*/) override {
     }
@@ -751,6 +801,14 @@ public:
                            bool /*captureSecureLayers*/) override {
         return NO_ERROR;
     }
+    status_t captureScreenAsync(const sp<IBinder>& /*display*/, sp<GraphicBuffer>* /*outBuffer*/,
+                                sp<Fence>* /*outFence*/, bool& /*outCapturedSecureLayers*/,
+                                ui::Dataspace /*reqDataspace*/, ui::PixelFormat /*reqPixelFormat*/,
+                                const Rect& /*sourceCrop*/, uint32_t /*reqWidth*/,
+                                uint32_t /*reqHeight*/, bool /*useIdentityTransform*/,
+                                ui::Rotation, bool /*captureSecureLayers*/) override {
+        return NO_ERROR;
+    }
     status_t getAutoLowLatencyModeSupport(const sp<IBinder>& /*display*/,
                                           bool* /*outSupport*/) const override {
         return NO_ERROR;
@@ -2000,4 +2058,73 @@ TEST_F(SurfaceTest, DefaultMaxBufferCountSetAndUpdated) {
     EXPECT_EQ(BufferQueueDefs::NUM_BUFFER_SLOTS, count);
 }
 
+TEST_F(SurfaceTest, MinUndequeuedBufferCountSetAndUpdated) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+
+    int count = -1;
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &count));
+    EXPECT_EQ(1, count);
+
+    // Async mode needs one more buffer.
+    ASSERT_EQ(NO_ERROR, window->setSwapInterval(window.get(), 0));
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &count));
+    EXPECT_EQ(2, count);
+
+    ASSERT_EQ(NO_ERROR, window->setSwapInterval(window.get(), 1));
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &count));
+    EXPECT_EQ(1, count);
+}
+
+TEST_F(SurfaceTest, SetBuffersProperties) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    native_window_buffers_properties_t properties{
+            .width = 16,
+            .height = 8,
+            .format = HAL_PIXEL_FORMAT_RGBA_8888,
+            .dataSpace = HAL_DATASPACE_V0_SRGB,
+            .transform = NATIVE_WINDOW_TRANSFORM_ROT_90,
+            .scalingMode = NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW,
+    };
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_properties(window.get(), &properties));
+
+    int value = -1;
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_FORMAT, &value));
+    EXPECT_EQ(HAL_PIXEL_FORMAT_RGBA_8888, value);
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_DATASPACE, &value));
+    EXPECT_EQ(HAL_DATASPACE_V0_SRGB, value);
+
+    ANativeWindowBuffer* buffer;
+    int fenceFd;
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffer, &fenceFd));
+    EXPECT_EQ(16, buffer->width);
+    EXPECT_EQ(8, buffer->height);
+    ASSERT_EQ(NO_ERROR, window->cancelBuffer(window.get(), buffer, fenceFd));
+
+    // Nothing is set if any property is invalid.
+    properties.format = HAL_PIXEL_FORMAT_RGB_565;
+    properties.scalingMode = -1;
+    EXPECT_EQ(BAD_VALUE, native_window_set_buffers_properties(window.get(), &properties));
+    EXPECT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_FORMAT, &value));
+    EXPECT_EQ(HAL_PIXEL_FORMAT_RGBA_8888, value);
+}
+
 } // namespace android
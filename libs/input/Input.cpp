@@ -392,6 +392,23 @@ void MotionEvent::addSample(
     mSamplePointerCoords.appendArray(pointerCoords, getPointerCount());
 }
 
+PointerCoords* MotionEvent::appendSample(nsecs_t eventTime) {
+    mSampleEventTimes.push(eventTime);
+    const size_t index = mSamplePointerCoords.size();
+    mSamplePointerCoords.insertAt(index, getPointerCount());
+    return mSamplePointerCoords.editArray() + index;
+}
+
+void MotionEvent::reserveSamples(size_t sampleCount) {
+    if (sampleCount > mSampleEventTimes.capacity()) {
+        mSampleEventTimes.setCapacity(sampleCount);
+    }
+    const size_t pointerCoordsCount = sampleCount * getPointerCount();
+    if (pointerCoordsCount > mSamplePointerCoords.capacity()) {
+        mSamplePointerCoords.setCapacity(pointerCoordsCount);
+    }
+}
+
 float MotionEvent::getXCursorPosition() const {
     const float rawX = getRawXCursorPosition();
     return rawX * mXScale + mXOffset;
@@ -26,6 +26,7 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
@@ -125,11 +126,14 @@ size_t InputMessage::size() const {
 }
 
 /**
- * There could be non-zero bytes in-between InputMessage fields. Force-initialize the entire
- * memory to zero, then only copy the valid bytes on a per-field basis.
+ * There could be non-zero bytes in-between InputMessage fields. Force-initialize the memory to
+ * zero, then only copy the valid bytes on a per-field basis.
+ *
+ * Only the first size() bytes are sent, so only those are initialized. A motion event with few
+ * pointers is much smaller than the full message, which is sized for MAX_POINTERS.
  */
 void InputMessage::getSanitizedCopy(InputMessage* msg) const {
-    memset(msg, 0, sizeof(*msg));
+    memset(msg, 0, size());
 
     // Write the header
     msg->header.type = header.type;
@@ -340,6 +344,70 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendMessages(InputMessage* msgs, size_t count, size_t* outSentCount) {
+    // Bounds the stack space used for the message headers.
+    static constexpr size_t MAX_MESSAGES_PER_SEND = 16;
+
+    *outSentCount = 0;
+    while (*outSentCount < count) {
+        const size_t chunkSize = std::min(count - *outSentCount, MAX_MESSAGES_PER_SEND);
+        struct iovec iovecs[MAX_MESSAGES_PER_SEND];
+        struct mmsghdr headers[MAX_MESSAGES_PER_SEND] = {};
+        for (size_t i = 0; i < chunkSize; i++) {
+            InputMessage& msg = msgs[*outSentCount + i];
+            InputMessage cleanMsg;
+            msg.getSanitizedCopy(&cleanMsg);
+            memcpy(&msg, &cleanMsg, cleanMsg.size());
+            iovecs[i].iov_base = &msg;
+            iovecs[i].iov_len = msg.size();
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int nSent;
+        do {
+            nSent = ::sendmmsg(mFd.get(), headers, static_cast<unsigned int>(chunkSize),
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nSent == -1 && errno == EINTR);
+
+        if (nSent < 0) {
+            int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending %zu messages, %s", mName.c_str(), chunkSize,
+                  strerror(error));
+#endif
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+
+        for (int i = 0; i < nSent; i++) {
+            if (headers[i].msg_len != iovecs[i].iov_len) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ error sending messages, send was incomplete",
+                      mName.c_str());
+#endif
+                return DEAD_OBJECT;
+            }
+            *outSentCount += 1;
+        }
+
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ sent %d messages", mName.c_str(), nSent);
+#endif
+        if (static_cast<size_t>(nSent) < chunkSize) {
+            // The socket filled up. The next send would fail with EAGAIN.
+            return WOULD_BLOCK;
+        }
+    }
+    return OK;
+}
+
 status_t InputChannel::receiveMessage(InputMessage* msg) {
     ssize_t nRead;
     do {
@@ -550,9 +618,36 @@ status_t InputPublisher::publishMotionEvent(
         msg.body.motion.pointers[i].coords.copyFrom(pointerCoords[i]);
     }
 
+    if (mBatchingMotionEvents) {
+        mBatchedMotionMessages.push_back(msg);
+        return OK;
+    }
     return mChannel->sendMessage(&msg);
 }
 
+void InputPublisher::beginMotionBatch() {
+    mBatchingMotionEvents = true;
+}
+
+status_t InputPublisher::flushMotionBatch(size_t* outPublishedCount) {
+    mBatchingMotionEvents = false;
+    *outPublishedCount = 0;
+    if (mBatchedMotionMessages.empty()) {
+        return OK;
+    }
+    if (ATRACE_ENABLED()) {
+        std::string message =
+                StringPrintf("flushMotionBatch(inputChannel=%s, count=%zu)",
+                             mChannel->getName().c_str(), mBatchedMotionMessages.size());
+        ATRACE_NAME(message.c_str());
+    }
+    const status_t status = mChannel->sendMessages(mBatchedMotionMessages.data(),
+                                                   mBatchedMotionMessages.size(),
+                                                   outPublishedCount);
+    mBatchedMotionMessages.clear();
+    return status;
+}
+
 status_t InputPublisher::publishFocusEvent(uint32_t seq, int32_t eventId, bool hasFocus,
                                            bool inTouchMode) {
     if (ATRACE_ENABLED()) {
@@ -813,6 +908,8 @@ status_t InputConsumer::consumeSamples(InputEventFactoryInterface* factory,
             addSample(motionEvent, &msg);
         } else {
             initializeMotionEvent(motionEvent, &msg);
+            // One more sample may be appended by resampleTouchState.
+            motionEvent->reserveSamples(count + (mResampleTouch ? 1 : 0));
         }
         chain = msg.body.motion.seq;
     }
@@ -1207,14 +1304,14 @@ void InputConsumer::initializeMotionEvent(MotionEvent* event, const InputMessage
 }
 
 void InputConsumer::addSample(MotionEvent* event, const InputMessage* msg) {
+    // canAddSample guarantees that the message has the pointers of the event.
     uint32_t pointerCount = msg->body.motion.pointerCount;
-    PointerCoords pointerCoords[pointerCount];
+    PointerCoords* pointerCoords = event->appendSample(msg->body.motion.eventTime);
     for (uint32_t i = 0; i < pointerCount; i++) {
         pointerCoords[i].copyFrom(msg->body.motion.pointers[i].coords);
     }
 
     event->setMetaState(event->getMetaState() | msg->body.motion.metaState);
-    event->addSample(msg->body.motion.eventTime, pointerCoords);
 }
 
 bool InputConsumer::canAddSample(const Batch& batch, const InputMessage *msg) {
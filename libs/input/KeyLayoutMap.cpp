@@ -18,6 +18,8 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <android/keycodes.h>
 #include <input/InputEventLabels.h>
 #include <input/Keyboard.h>
@@ -36,6 +38,8 @@
 // Enables debug output for mapping.
 #define DEBUG_MAPPING 0
 
+// Scan codes below this are looked up in a flat table. Matches KEY_CNT from linux/input.h.
+static constexpr int32_t SCAN_CODE_TABLE_SIZE = 0x300;
 
 namespace android {
 
@@ -74,6 +78,7 @@ status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMa
                     elapsedTime / 1000000.0);
 #endif
             if (!status) {
+                map->buildScanCodeTable();
                 *outMap = map;
             }
         }
@@ -111,6 +116,10 @@ const KeyLayoutMap::Key* KeyLayoutMap::getKey(int32_t scanCode, int32_t usageCod
             return &mKeysByUsageCode.valueAt(index);
         }
     }
+    if (scanCode > 0 && scanCode < static_cast<int32_t>(mKeysByScanCodeTable.size())) {
+        const Key& key = mKeysByScanCodeTable[scanCode];
+        return key.keyCode != AKEYCODE_UNKNOWN ? &key : nullptr;
+    }
     if (scanCode) {
         ssize_t index = mKeysByScanCode.indexOfKey(scanCode);
         if (index >= 0) {
@@ -120,6 +129,30 @@ const KeyLayoutMap::Key* KeyLayoutMap::getKey(int32_t scanCode, int32_t usageCod
     return nullptr;
 }
 
+void KeyLayoutMap::buildScanCodeTable() {
+    mKeysByScanCodeTable.clear();
+    const size_t N = mKeysByScanCode.size();
+    if (N == 0) {
+        return;
+    }
+    // Keys are sorted by scan code, so the last one bounds the table.
+    const int32_t maxScanCode =
+            std::min(mKeysByScanCode.keyAt(N - 1), SCAN_CODE_TABLE_SIZE - 1);
+    if (maxScanCode <= 0) {
+        return;
+    }
+    mKeysByScanCodeTable.resize(maxScanCode + 1, Key{AKEYCODE_UNKNOWN, 0});
+    for (size_t i = 0; i < N; i++) {
+        const int32_t scanCode = mKeysByScanCode.keyAt(i);
+        if (scanCode > maxScanCode) {
+            break;
+        }
+        if (scanCode > 0) {
+            mKeysByScanCodeTable[scanCode] = mKeysByScanCode.valueAt(i);
+        }
+    }
+}
+
 status_t KeyLayoutMap::findScanCodesForKey(
         int32_t keyCode, std::vector<int32_t>* outScanCodes) const {
     const size_t N = mKeysByScanCode.size();
@@ -19,6 +19,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <unordered_map>
 
 #include <input/Keyboard.h>
 #include <input/InputEventLabels.h>
@@ -30,6 +34,78 @@
 
 namespace android {
 
+// --- KeyMapFileCache ---
+
+/*
+ * Key layout and key character maps are immutable once loaded, so the devices that use the same
+ * file share one parsed map instead of parsing it again on every hotplug. Only weak references
+ * are kept, so a map is freed with the last device using it, and a file is parsed again if it
+ * changed on disk since it was cached.
+ */
+template <typename T>
+class KeyMapFileCache {
+public:
+    template <typename Loader>
+    status_t load(const std::string& path, Loader loader, sp<T>* outMap) {
+        struct stat fileStat;
+        const bool haveStat = stat(path.c_str(), &fileStat) == 0;
+        if (haveStat) {
+            std::scoped_lock lock(mLock);
+            auto it = mEntries.find(path);
+            if (it != mEntries.end() && it->second.matches(fileStat)) {
+                *outMap = it->second.map.promote();
+                if (*outMap != nullptr) {
+                    return OK;
+                }
+            }
+        }
+
+        status_t status = loader(path, outMap);
+        if (status || !haveStat) {
+            return status;
+        }
+
+        std::scoped_lock lock(mLock);
+        // Drop the maps that are no longer used by any device.
+        for (auto it = mEntries.begin(); it != mEntries.end();) {
+            if (it->second.map.promote() == nullptr) {
+                it = mEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        mEntries[path] = {*outMap, fileStat};
+        return OK;
+    }
+
+private:
+    struct Entry {
+        wp<T> map;
+        struct stat fileStat;
+
+        bool matches(const struct stat& other) const {
+            return fileStat.st_dev == other.st_dev && fileStat.st_ino == other.st_ino &&
+                    fileStat.st_size == other.st_size &&
+                    fileStat.st_mtim.tv_sec == other.st_mtim.tv_sec &&
+                    fileStat.st_mtim.tv_nsec == other.st_mtim.tv_nsec;
+        }
+    };
+
+    std::mutex mLock;
+    std::unordered_map<std::string, Entry> mEntries;
+};
+
+// The caches are never destroyed, so that they outlive any static KeyMap.
+static KeyMapFileCache<KeyLayoutMap>& getKeyLayoutMapCache() {
+    static KeyMapFileCache<KeyLayoutMap>* cache = new KeyMapFileCache<KeyLayoutMap>();
+    return *cache;
+}
+
+static KeyMapFileCache<KeyCharacterMap>& getKeyCharacterMapCache() {
+    static KeyMapFileCache<KeyCharacterMap>* cache = new KeyMapFileCache<KeyCharacterMap>();
+    return *cache;
+}
+
 // --- KeyMap ---
 
 KeyMap::KeyMap() {
@@ -111,7 +187,7 @@ status_t KeyMap::loadKeyLayout(const InputDeviceIdentifier& deviceIdentifier,
         return NAME_NOT_FOUND;
     }
 
-    status_t status = KeyLayoutMap::load(path, &keyLayoutMap);
+    status_t status = getKeyLayoutMapCache().load(path, KeyLayoutMap::load, &keyLayoutMap);
     if (status) {
         return status;
     }
@@ -128,8 +204,11 @@ status_t KeyMap::loadKeyCharacterMap(const InputDeviceIdentifier& deviceIdentifi
         return NAME_NOT_FOUND;
     }
 
-    status_t status = KeyCharacterMap::load(path,
-            KeyCharacterMap::FORMAT_BASE, &keyCharacterMap);
+    status_t status = getKeyCharacterMapCache().load(path,
+            [](const std::string& filename, sp<KeyCharacterMap>* outMap) {
+                return KeyCharacterMap::load(filename, KeyCharacterMap::FORMAT_BASE, outMap);
+            },
+            &keyCharacterMap);
     if (status) {
         return status;
     }
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <input/LatencyHistogram.h>
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <iterator>
+
+using android::base::StringPrintf;
+
+namespace android {
+
+// Exclusive upper bound of each bucket, in microseconds.
+static constexpr nsecs_t BUCKET_UPPER_BOUNDS_US[] = {
+        500,   1000,  1500,  2000,  3000,  4000,   5000,   6000,   7000,   8000,   10000,  12000,
+        14000, 16000, 20000, 25000, 33000, 50000,  75000,  100000, 150000, 250000, 500000, 1000000,
+};
+
+LatencyHistogram::LatencyHistogram() {
+    static_assert(std::size(BUCKET_UPPER_BOUNDS_US) + 1 == BUCKET_COUNT);
+    reset();
+}
+
+void LatencyHistogram::addValue(nsecs_t latency) {
+    latency = std::max(latency, nsecs_t(0));
+    const nsecs_t latencyUs = ns2us(latency);
+    const size_t bucket = std::upper_bound(std::begin(BUCKET_UPPER_BOUNDS_US),
+                                           std::end(BUCKET_UPPER_BOUNDS_US), latencyUs) -
+            std::begin(BUCKET_UPPER_BOUNDS_US);
+    mBuckets[bucket]++;
+    mCount++;
+    mMax = std::max(mMax, latency);
+}
+
+void LatencyHistogram::reset() {
+    mBuckets.fill(0);
+    mCount = 0;
+    mMax = 0;
+}
+
+size_t LatencyHistogram::getCount() const {
+    return mCount;
+}
+
+nsecs_t LatencyHistogram::getMax() const {
+    return mMax;
+}
+
+/**
+ * Finds the bucket that holds the sample of the requested rank, and interpolates linearly
+ * between the bounds of that bucket. The estimate never exceeds the largest sample, which is
+ * also what is returned for samples in the last, unbounded bucket.
+ */
+nsecs_t LatencyHistogram::getPercentile(float fraction) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    const double rank = std::clamp(double(fraction), 0.0, 1.0) * mCount;
+    size_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT - 1; bucket++) {
+        const uint32_t count = mBuckets[bucket];
+        if (count != 0 && seen + count >= rank) {
+            const nsecs_t lower = bucket == 0 ? 0 : us2ns(BUCKET_UPPER_BOUNDS_US[bucket - 1]);
+            const nsecs_t upper = us2ns(BUCKET_UPPER_BOUNDS_US[bucket]);
+            const double position = (rank - seen) / count;
+            return std::min(mMax, lower + nsecs_t((upper - lower) * position));
+        }
+        seen += count;
+    }
+    return mMax;
+}
+
+std::string LatencyHistogram::dump() const {
+    return StringPrintf("count=%zu, p50=%.1fms, p90=%.1fms, p99=%.1fms, max=%.1fms", mCount,
+                        getPercentile(0.50) * 1E-6, getPercentile(0.90) * 1E-6,
+                        getPercentile(0.99) * 1E-6, mMax * 1E-6);
+}
+
+} // namespace android
@@ -17,17 +17,32 @@
 #include <input/DisplayViewport.h>
 #include <input/TouchVideoFrame.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
 namespace android {
 
 TouchVideoFrame::TouchVideoFrame(uint32_t height, uint32_t width, std::vector<int16_t> data,
         const struct timeval& timestamp) :
-         mHeight(height), mWidth(width),mData(std::move(data)), mTimestamp(timestamp) {
+         mHeight(height), mWidth(width),
+         mData(std::make_shared<std::vector<int16_t>>(std::move(data))), mTimestamp(timestamp) {
+}
+
+TouchVideoFrame TouchVideoFrame::fromSharedData(uint32_t height, uint32_t width,
+        std::shared_ptr<std::vector<int16_t>> data, const struct timeval& timestamp) {
+    TouchVideoFrame frame;
+    frame.mHeight = height;
+    frame.mWidth = width;
+    frame.mData = std::move(data);
+    frame.mTimestamp = timestamp;
+    return frame;
 }
 
 bool TouchVideoFrame::operator==(const TouchVideoFrame& rhs) const {
     return mHeight == rhs.mHeight
             && mWidth == rhs.mWidth
-            && mData == rhs.mData
+            && (mData == rhs.mData || *mData == *rhs.mData)
             && mTimestamp.tv_sec == rhs.mTimestamp.tv_sec
             && mTimestamp.tv_usec == rhs.mTimestamp.tv_usec;
 }
@@ -36,7 +51,7 @@ uint32_t TouchVideoFrame::getHeight() const { return mHeight; }
 
 uint32_t TouchVideoFrame::getWidth() const { return mWidth; }
 
-const std::vector<int16_t>& TouchVideoFrame::getData() const { return mData; }
+const std::vector<int16_t>& TouchVideoFrame::getData() const { return *mData; }
 
 const struct timeval& TouchVideoFrame::getTimestamp() const { return mTimestamp; }
 
@@ -54,6 +69,43 @@ void TouchVideoFrame::rotate(int32_t orientation) {
     }
 }
 
+bool TouchVideoFrame::hasExclusiveData() const {
+    if (mData.use_count() != 1) {
+        return false;
+    }
+    // Pairs with the release by the frame that dropped the last other reference, so that its
+    // reads of the data happen before our writes.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+/**
+ * Writes the rotated frame one output row at a time, so that the writes are
+ * contiguous and the inner loop can be vectorized. Heatmaps are small enough
+ * for the strided reads to stay in cache.
+ * For a clockwise rotation:
+ *     Output row r is input column r, read from the bottom up
+ * For a counterclockwise rotation:
+ *     Output row r is input column (width - r - 1), read from the top down
+ */
+static void rotateQuarterTurnInto(const int16_t* in, int16_t* out, size_t height, size_t width,
+        bool clockwise) {
+    for (size_t r = 0; r < width; r++) {
+        int16_t* outRow = out + r * height;
+        if (clockwise) {
+            const int16_t* inColumn = in + (height - 1) * width + r;
+            for (size_t c = 0; c < height; c++) {
+                outRow[c] = inColumn[-static_cast<ptrdiff_t>(c * width)];
+            }
+        } else {
+            const int16_t* inColumn = in + (width - r - 1);
+            for (size_t c = 0; c < height; c++) {
+                outRow[c] = inColumn[c * width];
+            }
+        }
+    }
+}
+
 /**
  * Rotate once clockwise by a quarter turn === rotate 90 degrees
  * Rotate once counterclockwise by a quarter turn === rotate 270 degrees
@@ -61,40 +113,43 @@ void TouchVideoFrame::rotate(int32_t orientation) {
  *     An element at position (i, j) is rotated to (j, height - i - 1)
  * For a counterclockwise rotation:
  *     An element at position (i, j) is rotated to (width - j - 1, i)
+ *
+ * A quarter turn can't be done in place unless the frame is square, so the frame
+ * is rotated into a per-thread scratch buffer, which then trades storage with the
+ * frame data. This doesn't allocate once the scratch buffer has grown to the frame size.
  */
 void TouchVideoFrame::rotateQuarterTurn(bool clockwise) {
-    std::vector<int16_t> rotated(mData.size());
-    for (size_t i = 0; i < mHeight; i++) {
-        for (size_t j = 0; j < mWidth; j++) {
-            size_t iRotated, jRotated;
-            if (clockwise) {
-                iRotated = j;
-                jRotated = mHeight - i - 1;
-            } else {
-                iRotated = mWidth - j - 1;
-                jRotated = i;
-            }
-            size_t indexRotated = iRotated * mHeight + jRotated;
-            rotated[indexRotated] = mData[i * mWidth + j];
-        }
+    const size_t size = static_cast<size_t>(mHeight) * mWidth;
+    if (size == 0) {
+        std::swap(mHeight, mWidth);
+        return;
+    }
+    if (hasExclusiveData()) {
+        static thread_local std::vector<int16_t> sScratch;
+        sScratch.resize(size);
+        rotateQuarterTurnInto(mData->data(), sScratch.data(), mHeight, mWidth, clockwise);
+        mData->swap(sScratch);
+    } else {
+        auto rotated = std::make_shared<std::vector<int16_t>>(size);
+        rotateQuarterTurnInto(mData->data(), rotated->data(), mHeight, mWidth, clockwise);
+        mData = std::move(rotated);
     }
-    mData = std::move(rotated);
     std::swap(mHeight, mWidth);
 }
 
 /**
  * An element at position (i, j) is rotated to (height - i - 1, width - j - 1)
- * This is equivalent to moving element [i] to position [height * width - i - 1]
- * Since element at [height * width - i - 1] would move to position [i],
- * we can just swap elements [i] and [height * width - i - 1].
+ * This is equivalent to moving element [i] to position [height * width - i - 1],
+ * i.e. reversing the data.
  */
 void TouchVideoFrame::rotate180() {
-    if (mData.size() == 0) {
+    if (mData->empty()) {
         return;
     }
-    // Just need to swap elements i and (height * width - 1 - i)
-    for (size_t i = 0; i < mData.size() / 2; i++) {
-        std::swap(mData[i], mData[mHeight * mWidth - 1 - i]);
+    if (hasExclusiveData()) {
+        std::reverse(mData->begin(), mData->end());
+    } else {
+        mData = std::make_shared<std::vector<int16_t>>(mData->rbegin(), mData->rend());
     }
 }
 
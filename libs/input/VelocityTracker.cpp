@@ -23,8 +23,10 @@
 // Log debug messages about the progress of the algorithm itself.
 #define DEBUG_STRATEGY 0
 
+#include <algorithm>
 #include <array>
 #include <inttypes.h>
+#include <iterator>
 #include <limits.h>
 #include <math.h>
 #include <optional>
@@ -170,6 +172,12 @@ VelocityTrackerStrategy* VelocityTracker::createStrategy(const char* strategy) {
         // of the velocity when the finger is released.
         return new LeastSquaresVelocityTrackerStrategy(3);
     }
+    if (!strcmp("ilsq2", strategy)) {
+        // 2nd order least squares computed from running sums.  Quality: VERY GOOD.
+        // Same fit as 'lsq2', but each query takes constant time instead of a pass
+        // over the history.
+        return new IncrementalLeastSquaresVelocityTrackerStrategy();
+    }
     if (!strcmp("wlsq2-delta", strategy)) {
         // 2nd order weighted least squares, delta weighting.  Quality: EXPERIMENTAL
         return new LeastSquaresVelocityTrackerStrategy(2,
@@ -775,6 +783,245 @@ float LeastSquaresVelocityTrackerStrategy::chooseWeight(uint32_t index) const {
 }
 
 
+// --- IncrementalLeastSquaresVelocityTrackerStrategy ---
+
+IncrementalLeastSquaresVelocityTrackerStrategy::IncrementalLeastSquaresVelocityTrackerStrategy() {
+    clear();
+}
+
+IncrementalLeastSquaresVelocityTrackerStrategy::~IncrementalLeastSquaresVelocityTrackerStrategy() {
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clear() {
+    mLastEventTime = LLONG_MIN;
+    mPreviousEventTime = LLONG_MIN;
+    mLastIdBits.clear();
+    for (PointerState& state : mPointerState) {
+        state.clear();
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clearPointers(BitSet32 idBits) {
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        mPointerState[iterBits.clearFirstMarkedBit()].clear();
+    }
+    mLastIdBits.value &= ~idBits.value;
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::addMovement(nsecs_t eventTime,
+        BitSet32 idBits, const VelocityTracker::Position* positions) {
+    if (eventTime == mLastEventTime) {
+        // A movement with the same event time replaces the newest one, as it does in
+        // LeastSquaresVelocityTrackerStrategy.
+        for (BitSet32 iterBits(mLastIdBits); !iterBits.isEmpty(); ) {
+            mPointerState[iterBits.clearFirstMarkedBit()].popNewest();
+        }
+    } else {
+        mPreviousEventTime = mLastEventTime;
+        mLastEventTime = eventTime;
+    }
+    mLastIdBits = idBits;
+
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        PointerState& state = mPointerState[id];
+
+        // The history of a pointer ends at the first movement that does not include it.
+        if (state.count != 0 && state.newest().eventTime != mPreviousEventTime) {
+            state.clear();
+        }
+        state.pushNewest({eventTime, positions[idBits.getIndexOfBit(id)]});
+        while (eventTime - state.oldest().eventTime > HORIZON) {
+            state.popOldest();
+        }
+        if (eventTime - state.baseTime > REBASE_INTERVAL) {
+            state.rebase(state.oldest().eventTime);
+        }
+    }
+}
+
+/**
+ * Replaces the sums of y * t^k with the sums of y * (t - d)^k, for k = 0..n-1, using the
+ * binomial expansion of (t - d)^k.
+ */
+static void shiftPowerSums(const double* sums, uint32_t n, double d, double* outSums) {
+    for (uint32_t k = 0; k < n; k++) {
+        // coefficient = C(k, j) * (-d)^(k - j)
+        double coefficient = 1;
+        double sum = 0;
+        for (uint32_t j = k; ; j--) {
+            sum += coefficient * sums[j];
+            if (j == 0) {
+                break;
+            }
+            coefficient *= -d * j / (k - j + 1);
+        }
+        outSums[k] = sum;
+    }
+}
+
+/**
+ * Solves the unweighted least squares fit of y = B[0] + B[1] t (+ B[2] t^2) from the sums of
+ * t^k (k = 0..2 * degree) and y * t^k (k = 0..degree), the same way as
+ * solveUnweightedLeastSquaresDeg2.
+ *
+ * Returns true if a solution is found, false otherwise.
+ */
+static bool solveLeastSquaresFromSums(const double* t, const double* yt, uint32_t degree,
+        float* outB) {
+    const double count = t[0];
+    const double Sxx = t[2] - t[1] * t[1] / count;
+    const double Sxy = yt[1] - t[1] * yt[0] / count;
+    if (degree == 1) {
+        if (Sxx <= 0) {
+            return false;
+        }
+        const double b = Sxy / Sxx;
+        outB[0] = yt[0] / count - b * t[1] / count;
+        outB[1] = b;
+        return true;
+    }
+
+    const double Sxx2 = t[3] - t[1] * t[2] / count;
+    const double Sx2y = yt[2] - t[2] * yt[0] / count;
+    const double Sx2x2 = t[4] - t[2] * t[2] / count;
+    const double denominator = Sxx * Sx2x2 - Sxx2 * Sxx2;
+    if (denominator <= 0) {
+        return false;
+    }
+    const double a = (Sx2y * Sxx - Sxy * Sxx2) / denominator;
+    const double b = (Sxy * Sx2x2 - Sx2y * Sxx2) / denominator;
+    outB[0] = yt[0] / count - b * t[1] / count - a * t[2] / count;
+    outB[1] = b;
+    outB[2] = a;
+    return true;
+}
+
+bool IncrementalLeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
+        VelocityTracker::Estimator* outEstimator) const {
+    outEstimator->clear();
+
+    const PointerState& state = mPointerState[id];
+    if (!mLastIdBits.hasBit(id) || state.count == 0) {
+        return false; // no data
+    }
+
+    const Sample& newest = state.newest();
+    outEstimator->time = newest.eventTime;
+    outEstimator->confidence = 1;
+
+    if (state.count > 1) {
+        // Like LeastSquaresVelocityTrackerStrategy, fit the samples with the time of the newest
+        // sample as the origin.
+        const uint32_t degree = state.count > 2 ? 2 : 1;
+        const double d = (newest.eventTime - state.baseTime) * 0.000000001;
+        double t[5], xt[3], yt[3];
+        shiftPowerSums(state.sums.t, 2 * degree + 1, d, t);
+        shiftPowerSums(state.sums.xt, degree + 1, d, xt);
+        shiftPowerSums(state.sums.yt, degree + 1, d, yt);
+        if (solveLeastSquaresFromSums(t, xt, degree, outEstimator->xCoeff)
+                && solveLeastSquaresFromSums(t, yt, degree, outEstimator->yCoeff)) {
+            outEstimator->degree = degree;
+#if DEBUG_STRATEGY
+            ALOGD("estimate: degree=%d, xCoeff=%s, yCoeff=%s", int(outEstimator->degree),
+                    vectorToString(outEstimator->xCoeff, degree + 1).c_str(),
+                    vectorToString(outEstimator->yCoeff, degree + 1).c_str());
+#endif
+            return true;
+        }
+    }
+
+    // No velocity data available for this pointer, but we do have its current position.
+    for (size_t i = 0; i <= VelocityTracker::Estimator::MAX_DEGREE; i++) {
+        outEstimator->xCoeff[i] = 0;
+        outEstimator->yCoeff[i] = 0;
+    }
+    outEstimator->xCoeff[0] = newest.position.x;
+    outEstimator->yCoeff[0] = newest.position.y;
+    outEstimator->degree = 0;
+    return true;
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::Sums::clear() {
+    std::fill(std::begin(t), std::end(t), 0);
+    std::fill(std::begin(xt), std::end(xt), 0);
+    std::fill(std::begin(yt), std::end(yt), 0);
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::Sums::add(double time,
+        const VelocityTracker::Position& position, double sign) {
+    double power = sign;
+    for (size_t k = 0; k < std::size(t); k++) {
+        t[k] += power;
+        if (k < std::size(xt)) {
+            xt[k] += power * position.x;
+            yt[k] += power * position.y;
+        }
+        power *= time;
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::clear() {
+    baseTime = 0;
+    oldestIndex = 0;
+    count = 0;
+    sums.clear();
+}
+
+const IncrementalLeastSquaresVelocityTrackerStrategy::Sample&
+IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::oldest() const {
+    return samples[oldestIndex];
+}
+
+const IncrementalLeastSquaresVelocityTrackerStrategy::Sample&
+IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::newest() const {
+    return samples[(oldestIndex + count - 1) % HISTORY_SIZE];
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::pushNewest(
+        const Sample& sample) {
+    if (count == HISTORY_SIZE) {
+        popOldest();
+    }
+    if (count == 0) {
+        baseTime = sample.eventTime;
+    }
+    samples[(oldestIndex + count) % HISTORY_SIZE] = sample;
+    count++;
+    accumulate(sample, 1);
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::popNewest() {
+    accumulate(newest(), -1);
+    count--;
+    if (count == 0) {
+        clear();
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::popOldest() {
+    accumulate(oldest(), -1);
+    oldestIndex = (oldestIndex + 1) % HISTORY_SIZE;
+    count--;
+    if (count == 0) {
+        clear();
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::rebase(nsecs_t newBaseTime) {
+    baseTime = newBaseTime;
+    sums.clear();
+    for (size_t i = 0; i < count; i++) {
+        accumulate(samples[(oldestIndex + i) % HISTORY_SIZE], 1);
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::PointerState::accumulate(
+        const Sample& sample, double sign) {
+    sums.add((sample.eventTime - baseTime) * 0.000000001, sample.position, sign);
+}
+
+
 // --- IntegratingVelocityTrackerStrategy ---
 
 IntegratingVelocityTrackerStrategy::IntegratingVelocityTrackerStrategy(uint32_t degree) :
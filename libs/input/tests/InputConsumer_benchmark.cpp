@@ -0,0 +1,152 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/InputTransport.h>
+#include <utils/Timers.h>
+
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace {
+
+// A stylus reporting at 480 Hz.
+constexpr nsecs_t SAMPLE_INTERVAL = 1000000000LL / 480;
+
+// A publisher and consumer connected by an input channel, delivering a gesture in progress.
+class ConsumerHarness {
+public:
+    explicit ConsumerHarness(size_t pointerCount) : mPointerCount(pointerCount) {
+        InputChannel::openInputChannelPair("InputConsumer benchmark", mServerChannel,
+                                           mClientChannel);
+        mPublisher = std::make_unique<InputPublisher>(mServerChannel);
+        mConsumer = std::make_unique<InputConsumer>(mClientChannel);
+
+        for (size_t i = 0; i < mPointerCount; i++) {
+            mPointerProperties[i].clear();
+            mPointerProperties[i].id = static_cast<int32_t>(i);
+            mPointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        }
+
+        // Put the pointers down, so that the moves are batched and resampled.
+        publish(AMOTION_EVENT_ACTION_DOWN);
+        consume(false /*consumeBatches*/, -1);
+    }
+
+    // Publishes sampleCount moves, and lets the consumer batch them without returning an event.
+    void publishMoves(size_t sampleCount) {
+        for (size_t i = 0; i < sampleCount; i++) {
+            publish(AMOTION_EVENT_ACTION_MOVE);
+        }
+        consume(false /*consumeBatches*/, -1);
+    }
+
+    // Consumes the batched moves as one event for a frame at the time of the last sample, like
+    // the UI thread does once per vsync. Samples that are too recent stay in the batch.
+    MotionEvent* consumeBatch() { return consume(true /*consumeBatches*/, mEventTime); }
+
+    // Returns the finished signals to the publisher, so that the channel does not fill up.
+    void finish() {
+        for (uint32_t seq : mConsumedSeqs) {
+            mConsumer->sendFinishedSignal(seq, true);
+        }
+        mConsumedSeqs.clear();
+
+        uint32_t seq;
+        bool handled;
+        while (mPublisher->receiveFinishedSignal(&seq, &handled) == OK) {
+        }
+    }
+
+private:
+    void publish(int32_t action) {
+        mEventTime += SAMPLE_INTERVAL;
+        if (action == AMOTION_EVENT_ACTION_DOWN) {
+            mDownTime = mEventTime;
+        }
+        for (size_t i = 0; i < mPointerCount; i++) {
+            mPointerCoords[i].clear();
+            mPointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 + i * 100 + mSeq);
+            mPointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 500 + mSeq);
+            mPointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5);
+            mPointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, 10);
+        }
+        mPublisher->publishMotionEvent(++mSeq, InputEvent::nextId(), 1 /*deviceId*/,
+                                       AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                       INVALID_HMAC, action, 0 /*actionButton*/, 0 /*flags*/,
+                                       0 /*edgeFlags*/, 0 /*metaState*/, 0 /*buttonState*/,
+                                       MotionClassification::NONE, 1 /*xScale*/, 1 /*yScale*/,
+                                       0 /*xOffset*/, 0 /*yOffset*/, 0 /*xPrecision*/,
+                                       0 /*yPrecision*/, AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                       AMOTION_EVENT_INVALID_CURSOR_POSITION, mDownTime,
+                                       mEventTime, mPointerCount, mPointerProperties,
+                                       mPointerCoords);
+    }
+
+    MotionEvent* consume(bool consumeBatches, nsecs_t frameTime) {
+        uint32_t seq;
+        InputEvent* event;
+        int motionEventType;
+        int touchMoveNumber;
+        bool flag;
+        while (mConsumer->consume(&mEventFactory, consumeBatches, frameTime, &seq, &event,
+                                  &motionEventType, &touchMoveNumber, &flag) == OK) {
+            mConsumedSeqs.push_back(seq);
+            if (consumeBatches) {
+                return static_cast<MotionEvent*>(event);
+            }
+        }
+        return nullptr;
+    }
+
+    const size_t mPointerCount;
+    sp<InputChannel> mServerChannel;
+    sp<InputChannel> mClientChannel;
+    std::unique_ptr<InputPublisher> mPublisher;
+    std::unique_ptr<InputConsumer> mConsumer;
+    PreallocatedInputEventFactory mEventFactory;
+    PointerProperties mPointerProperties[MAX_POINTERS];
+    PointerCoords mPointerCoords[MAX_POINTERS];
+    std::vector<uint32_t> mConsumedSeqs;
+    uint32_t mSeq = 0;
+    nsecs_t mDownTime = 0;
+    nsecs_t mEventTime = 0;
+};
+
+// consumeBatch for the samples received during one 60 Hz frame, for range(0) pointers.
+void BM_ConsumeBatch(benchmark::State& state) {
+    ConsumerHarness harness(static_cast<size_t>(state.range(0)));
+    const size_t samplesPerFrame = static_cast<size_t>(state.range(1));
+    for (auto _ : state) {
+        state.PauseTiming();
+        harness.publishMoves(samplesPerFrame);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(harness.consumeBatch());
+
+        state.PauseTiming();
+        harness.finish();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_ConsumeBatch)->Args({1, 8})->Args({2, 8})->Args({10, 8})->Args({1, 2});
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
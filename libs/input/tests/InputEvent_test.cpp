@@ -692,4 +692,28 @@ TEST_F(MotionEventTest, SetCursorPosition) {
     ASSERT_EQ(4, event.getYCursorPosition());
 }
 
+TEST_F(MotionEventTest, AppendSample) {
+    MotionEvent event;
+    initializeEventWithHistory(&event);
+    event.reserveSamples(event.getHistorySize() + 2);
+
+    PointerCoords* pointerCoords = event.appendSample(ARBITRARY_EVENT_TIME + 3);
+    for (size_t i = 0; i < event.getPointerCount(); i++) {
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 310 + i * 10);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 311 + i * 10);
+    }
+
+    ASSERT_EQ(3U, event.getHistorySize());
+    ASSERT_EQ(ARBITRARY_EVENT_TIME + 3, event.getEventTime());
+    ASSERT_EQ(310, event.getRawX(0));
+    ASSERT_EQ(311, event.getRawY(0));
+    ASSERT_EQ(320, event.getRawX(1));
+    ASSERT_EQ(321, event.getRawY(1));
+    // The samples added before are unchanged.
+    ASSERT_EQ(ARBITRARY_EVENT_TIME + 2, event.getHistoricalEventTime(2));
+    ASSERT_EQ(220, event.getHistoricalRawX(1, 2));
+    ASSERT_EQ(221, event.getHistoricalRawY(1, 2));
+}
+
 } // namespace android
@@ -397,6 +397,43 @@ TEST_F(InputPublisherAndConsumerTest,
             << "publisher publishMotionEvent should return BAD_VALUE";
 }
 
+TEST_F(InputPublisherAndConsumerTest, PublishMotionBatch_SendsEventsInOrderOnFlush) {
+    const size_t pointerCount = 1;
+    PointerProperties pointerProperties[pointerCount];
+    PointerCoords pointerCoords[pointerCount];
+    pointerProperties[0].clear();
+    pointerCoords[0].clear();
+
+    mPublisher->beginMotionBatch();
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        status_t status =
+                mPublisher->publishMotionEvent(seq, InputEvent::nextId(), 0, 0, 0, INVALID_HMAC,
+                                               AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, 0, 0,
+                                               MotionClassification::NONE, 1 /* xScale */,
+                                               1 /* yScale */, 0, 0, 0, 0,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION, 0, seq,
+                                               pointerCount, pointerProperties, pointerCoords);
+        ASSERT_EQ(OK, status) << "publisher publishMotionEvent should queue the event";
+    }
+
+    InputMessage msg;
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg))
+            << "batched events should not be sent before the batch is flushed";
+
+    size_t publishedCount;
+    ASSERT_EQ(OK, mPublisher->flushMotionBatch(&publishedCount));
+    ASSERT_EQ(3u, publishedCount);
+
+    for (uint32_t seq = 1; seq <= 3; seq++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+        EXPECT_EQ(InputMessage::Type::MOTION, msg.header.type);
+        EXPECT_EQ(seq, msg.body.motion.seq);
+        EXPECT_EQ(static_cast<nsecs_t>(seq), msg.body.motion.eventTime);
+    }
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+}
+
 TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
@@ -97,6 +97,31 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.portalToDisplayId, i2.portalToDisplayId);
     ASSERT_EQ(i.replaceTouchableRegionWithCrop, i2.replaceTouchableRegionWithCrop);
     ASSERT_EQ(i.touchableRegionCropHandle, i2.touchableRegionCropHandle);
+    ASSERT_EQ(i, i2);
+}
+
+TEST(InputWindowInfo, Equality) {
+    InputWindowInfo i;
+    i.token = new BBinder();
+    i.id = 1;
+    i.name = "Foobar";
+    i.frameRight = 10;
+    i.frameBottom = 10;
+    i.addTouchableRegion(Rect(0, 0, 10, 10));
+
+    InputWindowInfo i2 = i;
+    ASSERT_EQ(i, i2);
+
+    i2.frameLeft = 5;
+    ASSERT_NE(i, i2);
+
+    i2 = i;
+    i2.addTouchableRegion(Rect(10, 10, 20, 20));
+    ASSERT_NE(i, i2);
+
+    i2 = i;
+    i2.applicationInfo.name = "Application";
+    ASSERT_NE(i, i2);
 }
 
 } // namespace test
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <input/LatencyHistogram.h>
+
+namespace android {
+namespace test {
+
+TEST(LatencyHistogramTest, EmptyHistogram) {
+    LatencyHistogram histogram;
+
+    ASSERT_EQ(0u, histogram.getCount());
+    ASSERT_EQ(0, histogram.getMax());
+    ASSERT_EQ(0, histogram.getPercentile(0.5));
+}
+
+TEST(LatencyHistogramTest, ResetHistogram) {
+    LatencyHistogram histogram;
+    histogram.addValue(ms2ns(3));
+    histogram.addValue(ms2ns(7));
+    histogram.reset();
+
+    ASSERT_EQ(0u, histogram.getCount());
+    ASSERT_EQ(0, histogram.getMax());
+    ASSERT_EQ(0, histogram.getPercentile(0.99));
+}
+
+TEST(LatencyHistogramTest, PercentilesFallInTheBucketsOfTheSamples) {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 90; i++) {
+        histogram.addValue(us2ns(700));
+    }
+    for (int i = 0; i < 10; i++) {
+        histogram.addValue(ms2ns(40));
+    }
+
+    ASSERT_EQ(100u, histogram.getCount());
+    ASSERT_EQ(ms2ns(40), histogram.getMax());
+
+    // The 700us samples are in the 500us to 1ms bucket.
+    const nsecs_t p50 = histogram.getPercentile(0.5);
+    ASSERT_GE(p50, us2ns(500));
+    ASSERT_LE(p50, ms2ns(1));
+
+    // The 40ms samples are in the 33ms to 50ms bucket, but no estimate exceeds the maximum.
+    const nsecs_t p99 = histogram.getPercentile(0.99);
+    ASSERT_GE(p99, ms2ns(33));
+    ASSERT_LE(p99, ms2ns(40));
+    ASSERT_EQ(ms2ns(40), histogram.getPercentile(1));
+}
+
+TEST(LatencyHistogramTest, LatenciesAboveTheLastBucketReportTheMaximum) {
+    LatencyHistogram histogram;
+    histogram.addValue(ms2ns(5000));
+
+    ASSERT_EQ(ms2ns(5000), histogram.getPercentile(0.5));
+}
+
+TEST(LatencyHistogramTest, NegativeLatenciesAreCountedAsZero) {
+    LatencyHistogram histogram;
+    histogram.addValue(-ms2ns(1));
+
+    ASSERT_EQ(1u, histogram.getCount());
+    ASSERT_EQ(0, histogram.getMax());
+    ASSERT_EQ(0, histogram.getPercentile(0.5));
+}
+
+} // namespace test
+} // namespace android
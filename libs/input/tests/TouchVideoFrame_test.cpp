@@ -68,6 +68,29 @@ TEST(TouchVideoFrame, Equality) {
     ASSERT_FALSE(frame == changedTimestampFrame);
 }
 
+TEST(TouchVideoFrame, CopiesShareDataUntilRotated) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+    ASSERT_EQ(frame.getData().data(), copy.getData().data());
+
+    copy.rotate(DISPLAY_ORIENTATION_90);
+    ASSERT_EQ(TouchVideoFrame(2, 3, {2, 4, 6, 1, 3, 5}, TIMESTAMP), copy);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP), frame);
+
+    copy = frame;
+    copy.rotate(DISPLAY_ORIENTATION_180);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {6, 5, 4, 3, 2, 1}, TIMESTAMP), copy);
+    ASSERT_EQ(TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP), frame);
+}
+
+TEST(TouchVideoFrame, FromSharedDataDoesNotModifyData) {
+    auto data = std::make_shared<std::vector<int16_t>>(std::vector<int16_t>{1, 2, 3, 4});
+    TouchVideoFrame frame = TouchVideoFrame::fromSharedData(2, 2, data, TIMESTAMP);
+    frame.rotate(DISPLAY_ORIENTATION_270);
+    ASSERT_EQ(TouchVideoFrame(2, 2, {3, 1, 4, 2}, TIMESTAMP), frame);
+    ASSERT_EQ((std::vector<int16_t>{1, 2, 3, 4}), *data);
+}
+
 // --- Rotate 90 degrees ---
 
 TEST(TouchVideoFrame, Rotate90_0x0) {
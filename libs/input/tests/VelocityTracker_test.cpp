@@ -215,9 +215,9 @@ static void computeAndCheckVelocity(const char* strategy,
     }
 }
 
-static void computeAndCheckQuadraticEstimate(const std::vector<MotionEventEntry>& motions,
-        const std::array<float, 3>& coefficients) {
-    VelocityTracker vt("lsq2");
+static void computeAndCheckQuadraticEstimate(const char* strategy,
+        const std::vector<MotionEventEntry>& motions, const std::array<float, 3>& coefficients) {
+    VelocityTracker vt(strategy);
     std::vector<MotionEvent> events = createMotionEventStream(motions);
     for (MotionEvent event : events) {
         vt.addMovement(&event);
@@ -256,6 +256,7 @@ TEST_F(VelocityTrackerTest, ThreePointsZeroVelocityTest) {
     };
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_X, 0);
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, 0);
+    computeAndCheckVelocity("ilsq2", motions, AMOTION_EVENT_AXIS_X, 0);
 }
 
 TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
@@ -268,6 +269,7 @@ TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
     };
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_X, 500);
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, 500);
+    computeAndCheckVelocity("ilsq2", motions, AMOTION_EVENT_AXIS_X, 500);
 }
 
 
@@ -791,6 +793,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_ThreeFi
     // This is close enough to zero, and is likely caused by division by a very small number.
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, -0.016);
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_Y, -0.016);
+    computeAndCheckVelocity("ilsq2", motions, AMOTION_EVENT_AXIS_X, 0);
+    computeAndCheckVelocity("ilsq2", motions, AMOTION_EVENT_AXIS_Y, 0);
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_X, 0);
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_Y, 0);
 }
@@ -832,7 +836,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Constan
     // -0.002, 1
     // -0.001, 1
     // -0.ms, 1
-    computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({1, 0, 0}));
+    computeAndCheckQuadraticEstimate("lsq2", motions, std::array<float, 3>({1, 0, 0}));
+    computeAndCheckQuadraticEstimate("ilsq2", motions, std::array<float, 3>({1, 0, 0}));
 }
 
 /*
@@ -850,7 +855,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Linear)
     // -0.002, -2
     // -0.001, -1
     // -0.000,  0
-    computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 1E3, 0}));
+    computeAndCheckQuadraticEstimate("lsq2", motions, std::array<float, 3>({0, 1E3, 0}));
+    computeAndCheckQuadraticEstimate("ilsq2", motions, std::array<float, 3>({0, 1E3, 0}));
 }
 
 /*
@@ -868,7 +874,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     // -0.002, 1
     // -0.001, 4
     // -0.000, 8
-    computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({8, 4.5E3, 0.5E6}));
+    computeAndCheckQuadraticEstimate("lsq2", motions, std::array<float, 3>({8, 4.5E3, 0.5E6}));
+    computeAndCheckQuadraticEstimate("ilsq2", motions, std::array<float, 3>({8, 4.5E3, 0.5E6}));
 }
 
 /*
@@ -886,7 +893,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     // -0.002, 1
     // -0.001, 4
     // -0.000, 9
-    computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({9, 6E3, 1E6}));
+    computeAndCheckQuadraticEstimate("lsq2", motions, std::array<float, 3>({9, 6E3, 1E6}));
+    computeAndCheckQuadraticEstimate("ilsq2", motions, std::array<float, 3>({9, 6E3, 1E6}));
 }
 
 /*
@@ -904,7 +912,36 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     // -0.002, 4
     // -0.001, 1
     // -0.000, 0
-    computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 0E3, 1E6}));
+    computeAndCheckQuadraticEstimate("lsq2", motions, std::array<float, 3>({0, 0E3, 1E6}));
+    computeAndCheckQuadraticEstimate("ilsq2", motions, std::array<float, 3>({0, 0E3, 1E6}));
+}
+
+/*
+ * A long gesture at 120Hz, so that samples leave the history of the incremental strategy through
+ * both the HISTORY_SIZE limit and the horizon, and its sums get rebased several times.
+ * The incremental strategy computes the same fit as lsq2, in double precision.
+ */
+TEST_F(VelocityTrackerTest, IncrementalLeastSquaresVelocityTrackerStrategy_MatchesLeastSquares) {
+    std::vector<MotionEventEntry> motions;
+    for (int i = 0; i < 120; i++) {
+        const float x = 100 + 5 * i + 0.05f * i * i;
+        const float y = 1500 - 8 * i;
+        motions.push_back({i * 8333333ns, {{x, y}}});
+    }
+    motions.push_back({motions.back().eventTime, motions.back().positions}); // ACTION_UP
+
+    VelocityTracker lsq2("lsq2");
+    VelocityTracker ilsq2("ilsq2");
+    for (MotionEvent event : createMotionEventStream(motions)) {
+        lsq2.addMovement(&event);
+        ilsq2.addMovement(&event);
+
+        float expectedVx, expectedVy, Vx, Vy;
+        EXPECT_EQ(lsq2.getVelocity(DEFAULT_POINTER_ID, &expectedVx, &expectedVy),
+                  ilsq2.getVelocity(DEFAULT_POINTER_ID, &Vx, &Vy));
+        EXPECT_NEAR_BY_FRACTION(Vx, expectedVx, 0.001);
+        EXPECT_NEAR_BY_FRACTION(Vy, expectedVy, 0.001);
+    }
 }
 
 } // namespace android
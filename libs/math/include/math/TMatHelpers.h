@@ -224,6 +224,58 @@ CONSTEXPR MATRIX PURE fastInverse3(const MATRIX& x) {
     return inverted;
 }
 
+// 4x4 inverse by cofactors, computed from the 2x2 minors of the upper two and
+// lower two rows (Laplace expansion). This is much cheaper than Gauss-Jordan
+// elimination and has no data-dependent branches.
+template <typename MATRIX>
+CONSTEXPR MATRIX PURE fastInverse4(const MATRIX& x) {
+    typedef typename MATRIX::value_type T;
+
+    // Importantly, our matrices are column-major: mRC below is x[C][R].
+    const T m00 = x[0][0], m01 = x[1][0], m02 = x[2][0], m03 = x[3][0];
+    const T m10 = x[0][1], m11 = x[1][1], m12 = x[2][1], m13 = x[3][1];
+    const T m20 = x[0][2], m21 = x[1][2], m22 = x[2][2], m23 = x[3][2];
+    const T m30 = x[0][3], m31 = x[1][3], m32 = x[2][3], m33 = x[3][3];
+
+    // 2x2 minors of the upper two rows
+    const T s0 = m00 * m11 - m10 * m01;
+    const T s1 = m00 * m12 - m10 * m02;
+    const T s2 = m00 * m13 - m10 * m03;
+    const T s3 = m01 * m12 - m11 * m02;
+    const T s4 = m01 * m13 - m11 * m03;
+    const T s5 = m02 * m13 - m12 * m03;
+
+    // 2x2 minors of the lower two rows
+    const T c0 = m20 * m31 - m30 * m21;
+    const T c1 = m20 * m32 - m30 * m22;
+    const T c2 = m20 * m33 - m30 * m23;
+    const T c3 = m21 * m32 - m31 * m22;
+    const T c4 = m21 * m33 - m31 * m23;
+    const T c5 = m22 * m33 - m32 * m23;
+
+    const T det(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+    MATRIX inverted(MATRIX::NO_INIT);
+    inverted[0][0] = ( m11 * c5 - m12 * c4 + m13 * c3) / det;
+    inverted[1][0] = (-m01 * c5 + m02 * c4 - m03 * c3) / det;
+    inverted[2][0] = ( m31 * s5 - m32 * s4 + m33 * s3) / det;
+    inverted[3][0] = (-m21 * s5 + m22 * s4 - m23 * s3) / det;
+    inverted[0][1] = (-m10 * c5 + m12 * c2 - m13 * c1) / det;
+    inverted[1][1] = ( m00 * c5 - m02 * c2 + m03 * c1) / det;
+    inverted[2][1] = (-m30 * s5 + m32 * s2 - m33 * s1) / det;
+    inverted[3][1] = ( m20 * s5 - m22 * s2 + m23 * s1) / det;
+    inverted[0][2] = ( m10 * c4 - m11 * c2 + m13 * c0) / det;
+    inverted[1][2] = (-m00 * c4 + m01 * c2 - m03 * c0) / det;
+    inverted[2][2] = ( m30 * s4 - m31 * s2 + m33 * s0) / det;
+    inverted[3][2] = (-m20 * s4 + m21 * s2 - m23 * s0) / det;
+    inverted[0][3] = (-m10 * c3 + m11 * c1 - m12 * c0) / det;
+    inverted[1][3] = ( m00 * c3 - m01 * c1 + m02 * c0) / det;
+    inverted[2][3] = (-m30 * s3 + m31 * s1 - m32 * s0) / det;
+    inverted[3][3] = ( m20 * s3 - m21 * s1 + m22 * s0) / det;
+
+    return inverted;
+}
+
 /**
  * Inversion function which switches on the matrix size.
  * @warning This function assumes the matrix is invertible. The result is
@@ -235,7 +287,8 @@ inline constexpr MATRIX PURE inverse(const MATRIX& matrix) {
     static_assert(MATRIX::NUM_ROWS == MATRIX::NUM_COLS, "only square matrices can be inverted");
     return (MATRIX::NUM_ROWS == 2) ? fastInverse2<MATRIX>(matrix) :
           ((MATRIX::NUM_ROWS == 3) ? fastInverse3<MATRIX>(matrix) :
-                    gaussJordanInverse<MATRIX>(matrix));
+          ((MATRIX::NUM_ROWS == 4) ? fastInverse4<MATRIX>(matrix) :
+                    gaussJordanInverse<MATRIX>(matrix)));
 }
 
 template<typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
@@ -381,6 +381,19 @@ CONSTEXPR typename TMat33<U>::col_type PURE operator *(const TMat33<T>& lhs, con
     return result;
 }
 
+// float matrix * column-vector. This is preferred over the template above, and
+// is also what matrix * matrix uses for each column of the result. Three lanes
+// don't map well onto NEON or SSE registers, so this is written out as scalar
+// code the compiler can schedule freely.
+inline CONSTEXPR TVec3<float> PURE operator *(const TMat33<float>& lhs, const TVec3<float>& rhs) {
+    const TVec3<float>& c0 = lhs[0];
+    const TVec3<float>& c1 = lhs[1];
+    const TVec3<float>& c2 = lhs[2];
+    return TVec3<float>(c0.x * rhs.x + c1.x * rhs.y + c2.x * rhs.z,
+                        c0.y * rhs.x + c1.y * rhs.y + c2.y * rhs.z,
+                        c0.z * rhs.x + c1.z * rhs.y + c2.z * rhs.z);
+}
+
 // row-vector * matrix, result is a vector of the same type than the input vector
 template <typename T, typename U>
 CONSTEXPR typename TMat33<U>::row_type PURE operator *(const TVec3<U>& lhs, const TMat33<T>& rhs) {
@@ -26,6 +26,21 @@
 #include <sys/types.h>
 #include <limits>
 
+// The float matrix * vector product below uses NEON or SSE when available. The
+// intrinsics can't be evaluated at compile time, so they are only used when the
+// compiler can tell whether it is in a constant expression.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated) && (defined(__ARM_NEON) || defined(__SSE__))
+#define MATH_MAT4_SIMD 1
+#endif
+#endif
+
+#if defined(MATH_MAT4_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(MATH_MAT4_SIMD)
+#include <xmmintrin.h>
+#endif
+
 #define PURE __attribute__((pure))
 
 #if __cplusplus >= 201402L
@@ -530,6 +545,35 @@ CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, con
     return result;
 }
 
+// float matrix * column-vector. This is preferred over the template above, and
+// is also what matrix * matrix uses for each column of the result.
+inline CONSTEXPR TVec4<float> PURE operator *(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+#if defined(MATH_MAT4_SIMD)
+    if (!__builtin_is_constant_evaluated()) {
+        TVec4<float> result(TVec4<float>::NO_INIT);
+#if defined(__ARM_NEON)
+        float32x4_t r = vmulq_n_f32(vld1q_f32(&lhs[0][0]), rhs[0]);
+        r = vmlaq_n_f32(r, vld1q_f32(&lhs[1][0]), rhs[1]);
+        r = vmlaq_n_f32(r, vld1q_f32(&lhs[2][0]), rhs[2]);
+        r = vmlaq_n_f32(r, vld1q_f32(&lhs[3][0]), rhs[3]);
+        vst1q_f32(&result[0], r);
+#else
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(&lhs[0][0]), _mm_set1_ps(rhs[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&lhs[1][0]), _mm_set1_ps(rhs[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&lhs[2][0]), _mm_set1_ps(rhs[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&lhs[3][0]), _mm_set1_ps(rhs[3])));
+        _mm_storeu_ps(&result[0], r);
+#endif
+        return result;
+    }
+#endif
+    TVec4<float> result;
+    for (size_t col = 0; col < TMat44<float>::NUM_COLS; ++col) {
+        result += lhs[col] * rhs[col];
+    }
+    return result;
+}
+
 // mat44 * vec3, result is vec3( mat44 * {vec3, 1} )
 template <typename T, typename U>
 CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec3<U>& rhs) {
@@ -584,3 +628,4 @@ typedef details::TMat44<float> mat4f;
 
 #undef PURE
 #undef CONSTEXPR
+#undef MATH_MAT4_SIMD
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <math/mat3.h>
+#include <math/mat4.h>
+
+namespace android {
+namespace {
+
+// A layer transform: rotation, scale and translation, as built per layer by
+// RenderEngine and CompositionEngine.
+mat4 makeTransform(float angle) {
+    return mat4::translate(vec4(100, 200, 0, 1)) * mat4::rotate(angle, vec3(0, 0, 1)) *
+            mat4::scale(vec4(1.5f, 1.5f, 1, 1));
+}
+
+void BM_Mat4MulVec4(benchmark::State& state) {
+    const mat4 m = makeTransform(0.5f);
+    vec4 v(1, 2, 3, 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        v = m * v;
+        benchmark::DoNotOptimize(v);
+    }
+}
+BENCHMARK(BM_Mat4MulVec4);
+
+void BM_Mat4MulMat4(benchmark::State& state) {
+    const mat4 lhs = makeTransform(0.5f);
+    const mat4 rhs = makeTransform(1.0f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs);
+        mat4 result = lhs * rhs;
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_Mat4MulMat4);
+
+void BM_Mat4Inverse(benchmark::State& state) {
+    const mat4 m = makeTransform(0.5f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 result = inverse(m);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_Mat4Inverse);
+
+void BM_Mat3MulMat3(benchmark::State& state) {
+    const mat3 lhs = mat3::rotate(0.5f, vec3(0, 0, 1));
+    const mat3 rhs = mat3::rotate(1.0f, vec3(0, 1, 0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs);
+        mat3 result = lhs * rhs;
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_Mat3MulMat3);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -150,6 +150,30 @@ TEST_F(MatTest, MiscOps) {
     }
 }
 
+TEST_F(MatTest, FloatProductsMatchDouble) {
+    const mat4 m(vec4(1, 2, 3, 4), vec4(-5, 6, 7, 8), vec4(9, 10, -11, 12),
+                 vec4(13, 14, 15, 16));
+    const mat4 n(vec4(0.5f, 0, 1, 0), vec4(0, 2, 0, 0), vec4(0, 0.25f, 1, 0), vec4(3, 4, 5, 1));
+    const vec4 v(1.5f, -2, 0.5f, 1);
+
+    // The float products may take a SIMD path, the double ones never do.
+    const double4 dv = mat4d(m) * double4(v);
+    const vec4 fv = m * v;
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_FLOAT_EQ(dv[i], fv[i]);
+    }
+
+    const mat4d dmn = mat4d(m) * mat4d(n);
+    const mat4 fmn = m * n;
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t r = 0; r < 4; r++) {
+            EXPECT_FLOAT_EQ(dmn[c][r], fmn[c][r]);
+        }
+    }
+
+    EXPECT_EQ(vec3(9, 22, 25), (m * vec3(1, 1, 0)).xyz);
+}
+
 TEST_F(MatTest, ElementAccess) {
     mat4 m(vec4(1, 2, 3, 4), vec4(5, 6, 7, 8), vec4(9, 10, 11, 12), vec4(13, 14, 15, 16));
     for (size_t c=0 ; c<4 ; c++) {
@@ -25,6 +25,7 @@
 #include <cutils/native_handle.h>
 #include <log/log.h>
 #include <utils/StrongPointer.h>
+#include <ui/Fence.h>
 #include <ui/GraphicBuffer.h>
 #include <system/graphics.h>
 
@@ -439,6 +440,59 @@ int AHardwareBuffer_createFromHandle(const AHardwareBuffer_Desc* desc,
     return NO_ERROR;
 }
 
+int AHardwareBuffer_lockPersistent(AHardwareBuffer* buffer, uint64_t usage, int32_t fence,
+                                   void** outVirtualAddress) {
+    if (!buffer) return BAD_VALUE;
+
+    if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                  AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)) {
+        ALOGE("Invalid usage flags passed to AHardwareBuffer_lockPersistent; only "
+                "AHARDWAREBUFFER_USAGE_CPU_* flags are allowed");
+        return BAD_VALUE;
+    }
+
+    usage = AHardwareBuffer_convertToGrallocUsageBits(usage);
+    GraphicBuffer* gbuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+
+    // Mapper implementations before 4.0 only maintain the CPU caches when the
+    // buffer is locked and unlocked.
+    if (gbuffer->getBufferMapperVersion() != GraphicBufferMapper::Version::GRALLOC_4) {
+        ALOGE("Mapper versions before 4.0 cannot flush or reread locked buffers");
+        return INVALID_OPERATION;
+    }
+
+    if (gbuffer->getLayerCount() > 1) {
+        ALOGE("Buffer with multiple layers passed to AHardwareBuffer_lockPersistent; "
+                "only buffers with one layer are allowed");
+        return INVALID_OPERATION;
+    }
+
+    const Rect bounds(gbuffer->getWidth(), gbuffer->getHeight());
+    return gbuffer->lockAsync(usage, usage, bounds, outVirtualAddress, fence);
+}
+
+int AHardwareBuffer_flushLocked(AHardwareBuffer* buffer, int32_t* fence) {
+    if (!buffer) return BAD_VALUE;
+
+    GraphicBuffer* gbuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    int fenceFd = -1;
+    status_t err = GraphicBufferMapper::get().flushLockedBuffer(gbuffer->handle, &fenceFd);
+    if (fence) {
+        *fence = fenceFd;
+    } else {
+        sp<Fence>(new Fence(fenceFd))->waitForever("AHardwareBuffer_flushLocked");
+    }
+    return err;
+}
+
+int AHardwareBuffer_rereadLocked(AHardwareBuffer* buffer, int32_t fence) {
+    sp<Fence>(new Fence(fence))->waitForever("AHardwareBuffer_rereadLocked");
+    if (!buffer) return BAD_VALUE;
+
+    GraphicBuffer* gbuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    return GraphicBufferMapper::get().rereadLockedBuffer(gbuffer->handle);
+}
+
 // ----------------------------------------------------------------------------
 // Helpers implementation
 // ----------------------------------------------------------------------------
@@ -258,6 +258,7 @@ enum {
     NATIVE_WINDOW_ALLOCATE_BUFFERS                = 45,    /* private */
     NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER          = 46,    /* private */
     NATIVE_WINDOW_SET_QUERY_INTERCEPTOR           = 47,    /* private */
+    NATIVE_WINDOW_SET_BUFFERS_PROPERTIES          = 48,    /* private */
     // clang-format on
 };
 
@@ -1100,4 +1101,35 @@ static inline int ANativeWindow_setQueryInterceptor(ANativeWindow* window,
     return window->perform(window, NATIVE_WINDOW_SET_QUERY_INTERCEPTOR, interceptor, data);
 }
 
+/**
+ * Properties of the buffers queued to a window, see
+ * native_window_set_buffers_properties.
+ */
+typedef struct native_window_buffers_properties {
+    /* See native_window_set_buffers_dimensions. */
+    uint32_t width;
+    uint32_t height;
+    /* See native_window_set_buffers_format. */
+    int32_t format;
+    /* See native_window_set_buffers_data_space. */
+    android_dataspace_t dataSpace;
+    /* See native_window_set_buffers_transform. */
+    uint32_t transform;
+    /* See native_window_set_scaling_mode. */
+    int32_t scalingMode;
+} native_window_buffers_properties_t;
+
+/*
+ * native_window_set_buffers_properties(..., const native_window_buffers_properties_t* properties)
+ * Sets all the properties of the buffers at once, which spares the separate
+ * calls made when setting up a window, e.g. by a swapchain. Nothing is set if
+ * any of the properties is invalid.
+ */
+static inline int native_window_set_buffers_properties(
+        struct ANativeWindow* window,
+        const native_window_buffers_properties_t* properties)
+{
+    return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_PROPERTIES, properties);
+}
+
 __END_DECLS
@@ -49,6 +49,49 @@ int AHardwareBuffer_createFromHandle(const AHardwareBuffer_Desc* desc,
                                      const native_handle_t* handle, int32_t method,
                                      AHardwareBuffer** outBuffer);
 
+/**
+ * Lock the whole buffer for CPU access, and keep it locked across frames.
+ *
+ * AHardwareBuffer_lock() maps the buffer, and AHardwareBuffer_unlock() unmaps it, every time.
+ * That is wasteful for buffers the CPU accesses over and over, e.g. NNAPI tensors or camera
+ * post-processing buffers. A buffer locked by this function stays mapped at *outVirtualAddress
+ * until AHardwareBuffer_unlock() is called, and the caller keeps the CPU caches coherent with
+ * the other devices accessing the buffer:
+ *
+ * - AHardwareBuffer_flushLocked() after the CPU wrote data another device reads.
+ * - AHardwareBuffer_rereadLocked() before the CPU reads data another device wrote.
+ *
+ * The usage and fence parameters are those of AHardwareBuffer_lock().
+ *
+ * \return 0 on success. -EINVAL if \a buffer is NULL or the usage flags are not a combination of
+ * AHARDWAREBUFFER_USAGE_CPU_*. INVALID_OPERATION if the buffer has more than one layer, or if the gralloc mapper cannot maintain the caches of a locked
+ * buffer (before 4.0); the caller should fall back to AHardwareBuffer_lock() then.
+ */
+int AHardwareBuffer_lockPersistent(AHardwareBuffer* buffer, uint64_t usage, int32_t fence,
+                                   void** outVirtualAddress);
+
+/**
+ * Write the CPU caches of a buffer locked by AHardwareBuffer_lockPersistent() back to memory,
+ * so that other devices see what the CPU wrote. The buffer stays locked.
+ *
+ * If \a fence is not NULL, it is set to a fence file descriptor (or -1) that signals when the
+ * data is visible to other devices, and is owned by the caller. Otherwise the function waits.
+ *
+ * \return 0 on success, or an error number if \a buffer is NULL or not locked.
+ */
+int AHardwareBuffer_flushLocked(AHardwareBuffer* buffer, int32_t* fence);
+
+/**
+ * Invalidate the CPU caches of a buffer locked by AHardwareBuffer_lockPersistent(), so that the
+ * CPU sees what other devices wrote. The buffer stays locked.
+ *
+ * \a fence is a fence file descriptor, or -1, that signals when the other devices are done
+ * writing. Its ownership is transferred to the callee, even on errors.
+ *
+ * \return 0 on success, or an error number if \a buffer is NULL or not locked.
+ */
+int AHardwareBuffer_rereadLocked(AHardwareBuffer* buffer, int32_t fence);
+
 /**
  * Buffer pixel formats.
  */
@@ -20,6 +20,7 @@
 #include <android/hardware_buffer.h>
 #include <private/android/AHardwareBufferHelpers.h>
 #include <android/hardware/graphics/common/1.0/types.h>
+#include <utils/Errors.h>
 #include <vndk/hardware_buffer.h>
 
 #include <gtest/gtest.h>
@@ -131,3 +132,40 @@ TEST(AHardwareBufferTest, GetCreateHandleTest) {
     AHardwareBuffer_release(buffer);
     AHardwareBuffer_release(otherBuffer);
 }
+
+TEST(AHardwareBufferTest, LockPersistentTest) {
+    AHardwareBuffer_Desc desc{
+            .width = 64,
+            .height = 1,
+            .layers = 1,
+            .format = AHARDWAREBUFFER_FORMAT_BLOB,
+            .usage = AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN | AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN,
+            .stride = 64,
+    };
+
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_allocate(&desc, &buffer));
+
+    void* data = nullptr;
+    const int result = AHardwareBuffer_lockPersistent(buffer, desc.usage, -1, &data);
+    if (result == INVALID_OPERATION) {
+        // The mapper cannot maintain the caches of locked buffers.
+        AHardwareBuffer_release(buffer);
+        return;
+    }
+    ASSERT_EQ(0, result);
+    ASSERT_NE(nullptr, data);
+
+    // The mapping survives any number of cache maintenance calls.
+    for (uint8_t i = 0; i < 3; i++) {
+        static_cast<uint8_t*>(data)[0] = i;
+        EXPECT_EQ(0, AHardwareBuffer_flushLocked(buffer, nullptr));
+        EXPECT_EQ(0, AHardwareBuffer_rereadLocked(buffer, -1));
+        EXPECT_EQ(i, static_cast<uint8_t*>(data)[0]);
+    }
+
+    EXPECT_EQ(0, AHardwareBuffer_unlock(buffer, nullptr));
+    EXPECT_NE(0, AHardwareBuffer_flushLocked(buffer, nullptr));
+
+    AHardwareBuffer_release(buffer);
+}
@@ -31,6 +31,11 @@ std::unique_ptr<impl::RenderEngine> RenderEngine::create(const RenderEngineCreat
         ALOGD("RenderEngine GLES Backend");
         return renderengine::gl::GLESRenderEngine::create(args);
     }
+    if (strcmp(prop, "vulkan") == 0) {
+        // The Vulkan backend is reserved, but not implemented yet.
+        ALOGW("RenderEngine Vulkan Backend is not available, create GLES RenderEngine.");
+        return renderengine::gl::GLESRenderEngine::create(args);
+    }
     ALOGE("UNKNOWN BackendType: %s, create GLES RenderEngine.", prop);
     return renderengine::gl::GLESRenderEngine::create(args);
 }
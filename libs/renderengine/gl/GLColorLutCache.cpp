@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "GLColorLutCache.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <math/vec2.h>
+#include <utils/Trace.h>
+#include "GLExtensions.h"
+#include "Program.h"
+#include "ProgramCache.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+GLColorLutCache::GLColorLutCache() {
+    // GL_RGB10_A2 is renderable and filterable from GLES 3.0 on.
+    int major = 0;
+    if (sscanf(GLExtensions::getInstance().getVersion(), "OpenGL ES %d", &major) == 1) {
+        mUseRgb10A2 = major >= 3;
+    }
+}
+
+GLColorLutCache::~GLColorLutCache() {
+    for (const Entry& entry : mEntries) {
+        glDeleteTextures(1, &entry.texture);
+    }
+}
+
+bool GLColorLutCache::Conversion::operator==(const Conversion& other) const {
+    return inputTransferFunction == other.inputTransferFunction &&
+            outputTransferFunction == other.outputTransferFunction &&
+            inputTransformMatrix == other.inputTransformMatrix &&
+            outputTransformMatrix == other.outputTransformMatrix &&
+            displayMaxLuminance == other.displayMaxLuminance &&
+            maxMasteringLuminance == other.maxMasteringLuminance &&
+            maxContentLuminance == other.maxContentLuminance;
+}
+
+GLColorLutCache::Conversion GLColorLutCache::getConversion(const Description& description) {
+    Conversion conversion;
+    conversion.inputTransferFunction = description.inputTransferFunction;
+    conversion.outputTransferFunction = description.outputTransferFunction;
+    conversion.inputTransformMatrix = description.inputTransformMatrix;
+    conversion.outputTransformMatrix = description.colorMatrix * description.outputTransformMatrix;
+    conversion.displayMaxLuminance = description.displayMaxLuminance;
+    // The content luminance only takes part in tone mapping HDR input, and it varies from
+    // buffer to buffer.
+    const bool isHdrInput =
+            description.inputTransferFunction == Description::TransferFunction::ST2084 ||
+            description.inputTransferFunction == Description::TransferFunction::HLG;
+    conversion.maxMasteringLuminance = isHdrInput ? description.maxMasteringLuminance : 0.0f;
+    conversion.maxContentLuminance = isHdrInput ? description.maxContentLuminance : 0.0f;
+    return conversion;
+}
+
+bool GLColorLutCache::isLutCandidate(const Description& description) {
+    // Transfer functions are only set when there is a conversion to do. Without them, the
+    // conversion is a matrix multiply, which is cheaper than sampling a LUT twice.
+    return description.inputTransferFunction != Description::TransferFunction::LINEAR ||
+            description.outputTransferFunction != Description::TransferFunction::LINEAR;
+}
+
+bool GLColorLutCache::hasSameConversion(const Description& lhs, const Description& rhs) {
+    return getConversion(lhs) == getConversion(rhs);
+}
+
+GLColorLutCache::Entry* GLColorLutCache::find(const Conversion& conversion) {
+    for (Entry& entry : mEntries) {
+        if (entry.conversion == conversion) {
+            entry.lastUse = ++mUseCount;
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+GLuint GLColorLutCache::get(const Description& description) {
+    if (mEntries.empty() || !isLutCandidate(description)) {
+        return 0;
+    }
+    const Entry* entry = find(getConversion(description));
+    return entry ? entry->texture : 0;
+}
+
+void GLColorLutCache::generate(EGLContext context, const Description& description) {
+    const Conversion conversion = getConversion(description);
+    if (find(conversion) != nullptr) {
+        return;
+    }
+    ATRACE_CALL();
+
+    const GLsizei width = LUT_SIZE * LUT_GRID_COLUMNS;
+    const GLsizei height = LUT_SIZE * LUT_GRID_ROWS;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (mUseRgb10A2) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_INT_2_10_10_10_REV, nullptr);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Can't render color LUT, framebuffer status %#x", status);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+        return;
+    }
+
+    // Every fragment converts the lattice point it stands for.
+    Description state;
+    state.isOpaque = true;
+    state.color = half4(0.0f, 0.0f, 0.0f, 1.0f);
+    state.inputTransferFunction = conversion.inputTransferFunction;
+    state.outputTransferFunction = conversion.outputTransferFunction;
+    state.inputTransformMatrix = conversion.inputTransformMatrix;
+    state.outputTransformMatrix = conversion.outputTransformMatrix;
+    state.displayMaxLuminance = conversion.displayMaxLuminance;
+    state.maxMasteringLuminance = conversion.maxMasteringLuminance;
+    state.maxContentLuminance = conversion.maxContentLuminance;
+    state.projectionMatrix = mat4::ortho(0, width, 0, height, 0, 1);
+    state.colorLut = Description::ColorLut::GENERATE;
+
+    glViewport(0, 0, width, height);
+    glDisable(GL_BLEND);
+    ProgramCache::getInstance().useProgram(context, state);
+
+    const vec2 positions[] = {vec2(0, 0), vec2(0, height), vec2(width, height), vec2(width, 0)};
+    glVertexAttribPointer(Program::position, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), positions);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    if (mEntries.size() >= MAX_LUTS) {
+        auto oldest = std::min_element(mEntries.begin(), mEntries.end(),
+                                       [](const Entry& lhs, const Entry& rhs) {
+                                           return lhs.lastUse < rhs.lastUse;
+                                       });
+        glDeleteTextures(1, &oldest->texture);
+        mEntries.erase(oldest);
+    }
+    mEntries.push_back({conversion, texture, ++mUseCount});
+}
+
+void GLColorLutCache::dump(std::string& result) const {
+    base::StringAppendF(&result, "RenderEngine color LUT cache: %zu of %zu LUTs, %dx%dx%d %s\n",
+                        mEntries.size(), MAX_LUTS, LUT_SIZE, LUT_SIZE, LUT_SIZE,
+                        mUseRgb10A2 ? "RGB10_A2" : "RGBA8");
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
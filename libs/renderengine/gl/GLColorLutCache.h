@@ -0,0 +1,101 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <renderengine/private/Description.h>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/*
+ * Caches 3D LUTs holding the result of a color conversion (EOTF, input transform, tone
+ * mapping, output transform and OETF) for every point of a lattice over the input signal.
+ * Layers whose conversion has a LUT sample it instead of running the whole conversion per
+ * pixel.
+ *
+ * The LUTs are rendered by the GPU with the same shader code as the per pixel conversion.
+ * Each one is stored in a 2D texture holding its LUT_SIZE slices along b in a grid, so that
+ * the fragment shaders do not need 3D textures and texel coordinates stay small enough for
+ * mediump precision.
+ */
+class GLColorLutCache {
+public:
+    static constexpr int LUT_SIZE = 33;
+    static constexpr int LUT_GRID_COLUMNS = 6;
+    static constexpr int LUT_GRID_ROWS = 6;
+    static_assert(LUT_GRID_COLUMNS * LUT_GRID_ROWS >= LUT_SIZE);
+
+    GLColorLutCache();
+    ~GLColorLutCache();
+
+    // Returns the texture of the LUT for the conversion of |description|, or 0 when there is
+    // none.
+    GLuint get(const Description& description);
+
+    // Renders the LUT for the conversion of |description| unless it is cached already. Leaves
+    // the default framebuffer bound.
+    void generate(EGLContext context, const Description& description);
+
+    // Whether the conversion of |description| is expensive enough to be worth a LUT.
+    static bool isLutCandidate(const Description& description);
+
+    // Whether |lhs| and |rhs| share a LUT.
+    static bool hasSameConversion(const Description& lhs, const Description& rhs);
+
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t MAX_LUTS = 4;
+
+    struct Conversion {
+        Description::TransferFunction inputTransferFunction;
+        Description::TransferFunction outputTransferFunction;
+        mat4 inputTransformMatrix;
+        // Includes the color matrix, as in the program.
+        mat4 outputTransformMatrix;
+        float displayMaxLuminance;
+        float maxMasteringLuminance;
+        float maxContentLuminance;
+
+        bool operator==(const Conversion& other) const;
+    };
+
+    struct Entry {
+        Conversion conversion;
+        GLuint texture;
+        uint64_t lastUse;
+    };
+
+    static Conversion getConversion(const Description& description);
+    Entry* find(const Conversion& conversion);
+
+    // Most LUT entries only need 8 bits but HDR outputs need 10 bits to avoid banding.
+    bool mUseRgb10A2 = false;
+    std::vector<Entry> mEntries;
+    uint64_t mUseCount = 0;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -20,6 +20,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <sched.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -256,6 +257,18 @@ std::unique_ptr<GLESRenderEngine> GLESRenderEngine::create(const RenderEngineCre
     extensions.initWithGLStrings(glGetString(GL_VENDOR), glGetString(GL_RENDERER),
                                  glGetString(GL_VERSION), glGetString(GL_EXTENSIONS));
 
+    char programCachePath[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_DEBUG_RENDERENGINE_PROGRAM_CACHE_PATH, programCachePath, "");
+    if (programCachePath[0] != '\0' && extensions.hasProgramBinary()) {
+        // Program binaries are only valid for the driver build that produced them.
+        char fingerprint[PROPERTY_VALUE_MAX];
+        property_get("ro.build.fingerprint", fingerprint, "");
+        const std::string driverId = base::StringPrintf("%s|%s|%s|%s", extensions.getVendor(),
+                                                        extensions.getRenderer(),
+                                                        extensions.getVersion(), fingerprint);
+        ProgramCache::getInstance().setPersistentCache(programCachePath, driverId);
+    }
+
     EGLSurface protectedDummy = EGL_NO_SURFACE;
     if (protectedContext != EGL_NO_CONTEXT && !extensions.hasSurfacelessContext()) {
         protectedDummy = createDummyEglPbufferSurface(display, config, args.pixelFormat,
@@ -394,6 +407,8 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         mBt2020ToDisplayP3 = mXyzToDisplayP3 * mBt2020ToXyz;
     }
 
+    mUseColorLut = property_get_bool(PROPERTY_DEBUG_RENDERENGINE_COLOR_LUT, true);
+
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.egl.traceGpuCompletion", value, "0");
     if (atoi(value)) {
@@ -402,7 +417,12 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
     }
 
     if (args.supportsBackgroundBlur) {
-        mBlurFilter = new BlurFilter(*this);
+        const int32_t blurQuality =
+                std::clamp(property_get_int32(PROPERTY_DEBUG_RENDERENGINE_BLUR_QUALITY,
+                                              static_cast<int32_t>(BlurFilter::Quality::HIGH)),
+                           static_cast<int32_t>(BlurFilter::Quality::LOW),
+                           static_cast<int32_t>(BlurFilter::Quality::HIGH));
+        mBlurFilter = new BlurFilter(*this, static_cast<BlurFilter::Quality>(blurQuality));
         checkErrors("BlurFilter creation");
     }
 
@@ -576,11 +596,20 @@ void GLESRenderEngine::fillRegionWithColor(const Region& region, float red, floa
 }
 
 void GLESRenderEngine::setScissor(const Rect& region) {
-    glScissor(region.left, region.top, region.getWidth(), region.getHeight());
+    Rect scissor = region;
+    if (mDamage.isValid() && !mDamage.intersect(region, &scissor)) {
+        scissor = Rect::EMPTY_RECT;
+    }
+    glScissor(scissor.left, scissor.top, scissor.getWidth(), scissor.getHeight());
     glEnable(GL_SCISSOR_TEST);
 }
 
 void GLESRenderEngine::disableScissor() {
+    if (mDamage.isValid()) {
+        // Keep drawing within the damage.
+        glScissor(mDamage.left, mDamage.top, mDamage.getWidth(), mDamage.getHeight());
+        return;
+    }
     glDisable(GL_SCISSOR_TEST);
 }
 
@@ -621,7 +650,8 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
 
     // If we couldn't find the image in the cache at this time, then either
     // SurfaceFlinger messed up registering the buffer ahead of time or we got
-    // backed up creating other EGLImages.
+    // backed up creating other EGLImages. In the latter case the image for this
+    // buffer is created ahead of the ones still being prefetched.
     if (!found) {
         status_t cacheResult = mImageManager->cache(buffer);
         if (cacheResult != NO_ERROR) {
@@ -1005,6 +1035,13 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         return BAD_VALUE;
     }
 
+    // LUTs are rendered before binding the output buffer. A LUT can not be written from the
+    // protected context, but the ones already cached are still used there.
+    if (mUseColorManagement && mUseColorLut && !mInProtectedContext) {
+        setOutputDataSpace(display.outputDataspace);
+        prepareColorLuts(display, layers);
+    }
+
     std::unique_ptr<BindNativeBufferAsFramebuffer> fbo;
     // Gathering layers that requested blur, we'll need them to decide when to render to an
     // offscreen buffer, and when to render to the native buffer.
@@ -1018,7 +1055,20 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
     }
     const auto blurLayersSize = blurLayers.size();
 
-    if (blurLayersSize == 0) {
+    // With a single blur layer, the blur of the previous frame can be drawn again when the
+    // layers beneath it are unchanged. Those layers are then not drawn at all, as the blur
+    // covers them entirely.
+    std::vector<const LayerSettings*> layersBelowBlur;
+    bool reuseBlur = false;
+    if (blurLayersSize == 1) {
+        const auto blurLayer = std::find(layers.begin(), layers.end(), blurLayers.front());
+        layersBelowBlur.assign(layers.begin(), blurLayer);
+        reuseBlur = !mInProtectedContext &&
+                mBlurFilter->hasCachedContent(display, blurLayers.front()->backgroundBlurRadius,
+                                              layersBelowBlur);
+    }
+
+    if (blurLayersSize == 0 || reuseBlur) {
         fbo = std::make_unique<BindNativeBufferAsFramebuffer>(*this, buffer, useFramebufferCache);
         if (fbo->getStatus() != NO_ERROR) {
             ALOGE("Failed to bind framebuffer! Aborting GPU composition for buffer (%p).",
@@ -1039,6 +1089,20 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    // Only the damage needs to be drawn when the rest of the buffer is still current. Blurs
+    // sample around the damage from an offscreen target that does not hold the previous
+    // frame, so they are always drawn whole.
+    mDamage = Rect::INVALID_RECT;
+    Rect damage;
+    if (display.damage.isValid() && blurLayersSize == 0 &&
+        display.damage.intersect(display.physicalDisplay, &damage) &&
+        damage != display.physicalDisplay) {
+        ATRACE_NAME("Partial redraw");
+        mDamage = damage;
+        glScissor(mDamage.left, mDamage.top, mDamage.getWidth(), mDamage.getHeight());
+        glEnable(GL_SCISSOR_TEST);
+    }
+
     // clear the entire buffer, sometimes when we reuse buffers we'd persist
     // ghost images otherwise.
     // we also require a full transparent framebuffer for overlays. This is
@@ -1063,7 +1127,21 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                         .setCropCoords(2 /* size */)
                         .build();
     for (auto const layer : layers) {
-        if (blurLayers.size() > 0 && blurLayers.front() == layer) {
+        if (reuseBlur && blurLayers.size() > 0 && blurLayers.front() != layer) {
+            continue;
+        }
+
+        if (reuseBlur && blurLayers.size() > 0) {
+            ATRACE_NAME("BlurFilter::reuse");
+            blurLayers.pop_front();
+            auto status = mBlurFilter->render(false /* multiPass */);
+            if (status != NO_ERROR) {
+                ALOGE("Failed to render blur effect! Aborting GPU composition for buffer (%p).",
+                      buffer->handle);
+                checkErrors("Can't render blur filter");
+                return status;
+            }
+        } else if (blurLayers.size() > 0 && blurLayers.front() == layer) {
             blurLayers.pop_front();
 
             auto status = mBlurFilter->prepare();
@@ -1073,6 +1151,9 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                 checkErrors("Can't render first blur pass");
                 return status;
             }
+            if (blurLayersSize == 1 && !mInProtectedContext) {
+                mBlurFilter->setCachedContent(display, layersBelowBlur);
+            }
 
             if (blurLayers.size() == 0) {
                 // Done blurring, time to bind the native FBO and render our blur onto it.
@@ -1177,6 +1258,11 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    if (mDamage.isValid()) {
+        mDamage = Rect::INVALID_RECT;
+        glDisable(GL_SCISSOR_TEST);
+    }
+
     if (drawFence != nullptr) {
         *drawFence = flush();
     }
@@ -1318,101 +1404,15 @@ void GLESRenderEngine::drawMesh(const Mesh& mesh) {
     }
 
     Description managedState = mState;
-    // By default, DISPLAY_P3 is the only supported wide color output. However,
-    // when HDR content is present, hardware composer may be able to handle
-    // BT2020 data space, in that case, the output data space is set to be
-    // BT2020_HLG or BT2020_PQ respectively. In GPU fall back we need
-    // to respect this and convert non-HDR content to HDR format.
     if (mUseColorManagement) {
-        Dataspace inputStandard = static_cast<Dataspace>(mDataSpace & Dataspace::STANDARD_MASK);
-        Dataspace inputTransfer = static_cast<Dataspace>(mDataSpace & Dataspace::TRANSFER_MASK);
-        Dataspace outputStandard =
-                static_cast<Dataspace>(mOutputDataSpace & Dataspace::STANDARD_MASK);
-        Dataspace outputTransfer =
-                static_cast<Dataspace>(mOutputDataSpace & Dataspace::TRANSFER_MASK);
-        bool needsXYZConversion = needsXYZTransformMatrix();
-
-        // NOTE: if the input standard of the input dataspace is not STANDARD_DCI_P3 or
-        // STANDARD_BT2020, it will be  treated as STANDARD_BT709
-        if (inputStandard != Dataspace::STANDARD_DCI_P3 &&
-            inputStandard != Dataspace::STANDARD_BT2020) {
-            inputStandard = Dataspace::STANDARD_BT709;
-        }
-
-        if (needsXYZConversion) {
-            // The supported input color spaces are standard RGB, Display P3 and BT2020.
-            switch (inputStandard) {
-                case Dataspace::STANDARD_DCI_P3:
-                    managedState.inputTransformMatrix = mDisplayP3ToXyz;
-                    break;
-                case Dataspace::STANDARD_BT2020:
-                    managedState.inputTransformMatrix = mBt2020ToXyz;
-                    break;
-                default:
-                    managedState.inputTransformMatrix = mSrgbToXyz;
-                    break;
+        setupColorConversion(managedState, mDataSpace);
+        if (canUseColorLut(mDataSpace)) {
+            if (const GLuint lut = mColorLutCache.get(managedState)) {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, lut);
+                glActiveTexture(GL_TEXTURE0);
+                managedState.colorLut = Description::ColorLut::SAMPLE;
             }
-
-            // The supported output color spaces are BT2020, Display P3 and standard RGB.
-            switch (outputStandard) {
-                case Dataspace::STANDARD_BT2020:
-                    managedState.outputTransformMatrix = mXyzToBt2020;
-                    break;
-                case Dataspace::STANDARD_DCI_P3:
-                    managedState.outputTransformMatrix = mXyzToDisplayP3;
-                    break;
-                default:
-                    managedState.outputTransformMatrix = mXyzToSrgb;
-                    break;
-            }
-        } else if (inputStandard != outputStandard) {
-            // At this point, the input data space and output data space could be both
-            // HDR data spaces, but they match each other, we do nothing in this case.
-            // In addition to the case above, the input data space could be
-            // - scRGB linear
-            // - scRGB non-linear
-            // - sRGB
-            // - Display P3
-            // - BT2020
-            // The output data spaces could be
-            // - sRGB
-            // - Display P3
-            // - BT2020
-            switch (outputStandard) {
-                case Dataspace::STANDARD_BT2020:
-                    if (inputStandard == Dataspace::STANDARD_BT709) {
-                        managedState.outputTransformMatrix = mSrgbToBt2020;
-                    } else if (inputStandard == Dataspace::STANDARD_DCI_P3) {
-                        managedState.outputTransformMatrix = mDisplayP3ToBt2020;
-                    }
-                    break;
-                case Dataspace::STANDARD_DCI_P3:
-                    if (inputStandard == Dataspace::STANDARD_BT709) {
-                        managedState.outputTransformMatrix = mSrgbToDisplayP3;
-                    } else if (inputStandard == Dataspace::STANDARD_BT2020) {
-                        managedState.outputTransformMatrix = mBt2020ToDisplayP3;
-                    }
-                    break;
-                default:
-                    if (inputStandard == Dataspace::STANDARD_DCI_P3) {
-                        managedState.outputTransformMatrix = mDisplayP3ToSrgb;
-                    } else if (inputStandard == Dataspace::STANDARD_BT2020) {
-                        managedState.outputTransformMatrix = mBt2020ToSrgb;
-                    }
-                    break;
-            }
-        }
-
-        // we need to convert the RGB value to linear space and convert it back when:
-        // - there is a color matrix that is not an identity matrix, or
-        // - there is an output transform matrix that is not an identity matrix, or
-        // - the input transfer function doesn't match the output transfer function.
-        if (managedState.hasColorMatrix() || managedState.hasOutputTransformMatrix() ||
-            inputTransfer != outputTransfer) {
-            managedState.inputTransferFunction =
-                    Description::dataSpaceToTransferFunction(inputTransfer);
-            managedState.outputTransferFunction =
-                    Description::dataSpaceToTransferFunction(outputTransfer);
         }
     }
 
@@ -1447,6 +1447,143 @@ void GLESRenderEngine::drawMesh(const Mesh& mesh) {
     }
 }
 
+void GLESRenderEngine::setupColorConversion(Description& state, Dataspace source) const {
+    // By default, DISPLAY_P3 is the only supported wide color output. However,
+    // when HDR content is present, hardware composer may be able to handle
+    // BT2020 data space, in that case, the output data space is set to be
+    // BT2020_HLG or BT2020_PQ respectively. In GPU fall back we need
+    // to respect this and convert non-HDR content to HDR format.
+    Dataspace inputStandard = static_cast<Dataspace>(source & Dataspace::STANDARD_MASK);
+    Dataspace inputTransfer = static_cast<Dataspace>(source & Dataspace::TRANSFER_MASK);
+    Dataspace outputStandard =
+            static_cast<Dataspace>(mOutputDataSpace & Dataspace::STANDARD_MASK);
+    Dataspace outputTransfer =
+            static_cast<Dataspace>(mOutputDataSpace & Dataspace::TRANSFER_MASK);
+    bool needsXYZConversion = needsXYZTransformMatrix(source);
+
+    // NOTE: if the input standard of the input dataspace is not STANDARD_DCI_P3 or
+    // STANDARD_BT2020, it will be  treated as STANDARD_BT709
+    if (inputStandard != Dataspace::STANDARD_DCI_P3 &&
+        inputStandard != Dataspace::STANDARD_BT2020) {
+        inputStandard = Dataspace::STANDARD_BT709;
+    }
+
+    if (needsXYZConversion) {
+        // The supported input color spaces are standard RGB, Display P3 and BT2020.
+        switch (inputStandard) {
+            case Dataspace::STANDARD_DCI_P3:
+                state.inputTransformMatrix = mDisplayP3ToXyz;
+                break;
+            case Dataspace::STANDARD_BT2020:
+                state.inputTransformMatrix = mBt2020ToXyz;
+                break;
+            default:
+                state.inputTransformMatrix = mSrgbToXyz;
+                break;
+        }
+
+        // The supported output color spaces are BT2020, Display P3 and standard RGB.
+        switch (outputStandard) {
+            case Dataspace::STANDARD_BT2020:
+                state.outputTransformMatrix = mXyzToBt2020;
+                break;
+            case Dataspace::STANDARD_DCI_P3:
+                state.outputTransformMatrix = mXyzToDisplayP3;
+                break;
+            default:
+                state.outputTransformMatrix = mXyzToSrgb;
+                break;
+        }
+    } else if (inputStandard != outputStandard) {
+        // At this point, the input data space and output data space could be both
+        // HDR data spaces, but they match each other, we do nothing in this case.
+        // In addition to the case above, the input data space could be
+        // - scRGB linear
+        // - scRGB non-linear
+        // - sRGB
+        // - Display P3
+        // - BT2020
+        // The output data spaces could be
+        // - sRGB
+        // - Display P3
+        // - BT2020
+        switch (outputStandard) {
+            case Dataspace::STANDARD_BT2020:
+                if (inputStandard == Dataspace::STANDARD_BT709) {
+                    state.outputTransformMatrix = mSrgbToBt2020;
+                } else if (inputStandard == Dataspace::STANDARD_DCI_P3) {
+                    state.outputTransformMatrix = mDisplayP3ToBt2020;
+                }
+                break;
+            case Dataspace::STANDARD_DCI_P3:
+                if (inputStandard == Dataspace::STANDARD_BT709) {
+                    state.outputTransformMatrix = mSrgbToDisplayP3;
+                } else if (inputStandard == Dataspace::STANDARD_BT2020) {
+                    state.outputTransformMatrix = mBt2020ToDisplayP3;
+                }
+                break;
+            default:
+                if (inputStandard == Dataspace::STANDARD_DCI_P3) {
+                    state.outputTransformMatrix = mDisplayP3ToSrgb;
+                } else if (inputStandard == Dataspace::STANDARD_BT2020) {
+                    state.outputTransformMatrix = mBt2020ToSrgb;
+                }
+                break;
+        }
+    }
+
+    // we need to convert the RGB value to linear space and convert it back when:
+    // - there is a color matrix that is not an identity matrix, or
+    // - there is an output transform matrix that is not an identity matrix, or
+    // - the input transfer function doesn't match the output transfer function.
+    if (state.hasColorMatrix() || state.hasOutputTransformMatrix() ||
+        inputTransfer != outputTransfer) {
+        state.inputTransferFunction =
+                Description::dataSpaceToTransferFunction(inputTransfer);
+        state.outputTransferFunction =
+                Description::dataSpaceToTransferFunction(outputTransfer);
+    }
+}
+
+bool GLESRenderEngine::canUseColorLut(Dataspace source) const {
+    // The LUT only covers signal values in [0, 1].
+    return mUseColorLut && (source & Dataspace::RANGE_MASK) != Dataspace::RANGE_EXTENDED;
+}
+
+void GLESRenderEngine::prepareColorLuts(const DisplaySettings& display,
+                                        const std::vector<const LayerSettings*>& layers) {
+    // Conversions shared by several layers, with the number of layers sharing each.
+    std::vector<std::pair<Description, size_t>> conversions;
+    for (auto const layer : layers) {
+        if (!canUseColorLut(layer->sourceDataspace)) {
+            continue;
+        }
+        Description state;
+        state.colorMatrix = display.colorTransform * layer->colorTransform;
+        state.displayMaxLuminance = display.maxLuminance;
+        state.maxMasteringLuminance = layer->source.buffer.maxMasteringLuminance;
+        state.maxContentLuminance = layer->source.buffer.maxContentLuminance;
+        setupColorConversion(state, layer->sourceDataspace);
+        if (!GLColorLutCache::isLutCandidate(state)) {
+            continue;
+        }
+        auto it = std::find_if(conversions.begin(), conversions.end(), [&](const auto& entry) {
+            return GLColorLutCache::hasSameConversion(entry.first, state);
+        });
+        if (it == conversions.end()) {
+            conversions.emplace_back(state, 1);
+        } else {
+            it->second++;
+        }
+    }
+
+    for (const auto& [state, layerCount] : conversions) {
+        if (layerCount >= kMinLayersPerColorLut) {
+            mColorLutCache.generate(mEGLContext, state);
+        }
+    }
+}
+
 size_t GLESRenderEngine::getMaxTextureSize() const {
     return mMaxTextureSize;
 }
@@ -1474,6 +1611,9 @@ void GLESRenderEngine::dump(std::string& result) {
     StringAppendF(&result, "RenderEngine last dataspace conversion: (%s) to (%s)\n",
                   dataspaceDetails(static_cast<android_dataspace>(mDataSpace)).c_str(),
                   dataspaceDetails(static_cast<android_dataspace>(mOutputDataSpace)).c_str());
+    if (mUseColorLut) {
+        mColorLutCache.dump(result);
+    }
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         StringAppendF(&result, "RenderEngine image cache size: %zu\n", mImageCache.size());
@@ -1600,10 +1740,10 @@ bool GLESRenderEngine::isHdrDataSpace(const Dataspace dataSpace) const {
 // input data space or output data space is HDR data space, and the input transfer function
 // doesn't match the output transfer function, we would enable an intermediate transfrom to
 // XYZ color space.
-bool GLESRenderEngine::needsXYZTransformMatrix() const {
-    const bool isInputHdrDataSpace = isHdrDataSpace(mDataSpace);
+bool GLESRenderEngine::needsXYZTransformMatrix(Dataspace source) const {
+    const bool isInputHdrDataSpace = isHdrDataSpace(source);
     const bool isOutputHdrDataSpace = isHdrDataSpace(mOutputDataSpace);
-    const Dataspace inputTransfer = static_cast<Dataspace>(mDataSpace & Dataspace::TRANSFER_MASK);
+    const Dataspace inputTransfer = static_cast<Dataspace>(source & Dataspace::TRANSFER_MASK);
     const Dataspace outputTransfer =
             static_cast<Dataspace>(mOutputDataSpace & Dataspace::TRANSFER_MASK);
 
@@ -1682,6 +1822,29 @@ void GLESRenderEngine::FlushTracer::loop() {
 void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                                     const ShadowSettings& settings) {
     ATRACE_CALL();
+    const Mesh& mesh = getShadowMesh(casterRect, casterCornerRadius, settings);
+
+    mState.cornerRadius = 0.0f;
+    mState.drawShadows = true;
+    setupLayerTexturing(mShadowTexture.getTexture());
+    drawMesh(mesh);
+    mState.drawShadows = false;
+}
+
+const Mesh& GLESRenderEngine::getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                                            const ShadowSettings& settings) {
+    auto it = std::find_if(mShadowMeshCache.begin(), mShadowMeshCache.end(),
+                           [&](const ShadowMeshCacheEntry& entry) {
+                               return entry.casterRect == casterRect &&
+                                       entry.casterCornerRadius == casterCornerRadius &&
+                                       entry.settings == settings;
+                           });
+    if (it != mShadowMeshCache.end()) {
+        mShadowMeshCache.splice(mShadowMeshCache.begin(), mShadowMeshCache, it);
+        return *mShadowMeshCache.front().mesh;
+    }
+
+    ATRACE_NAME("tessellateShadow");
     const float casterZ = settings.length / 2.0f;
     const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
                                           settings.casterIsTranslucent, settings.ambientColor,
@@ -1689,24 +1852,24 @@ void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCor
                                           settings.lightRadius);
 
     // setup mesh for both shadows
-    Mesh mesh = Mesh::Builder()
-                        .setPrimitive(Mesh::TRIANGLES)
-                        .setVertices(shadows.getVertexCount(), 2 /* size */)
-                        .setShadowAttrs()
-                        .setIndices(shadows.getIndexCount())
-                        .build();
-
-    Mesh::VertexArray<vec2> position = mesh.getPositionArray<vec2>();
-    Mesh::VertexArray<vec4> shadowColor = mesh.getShadowColorArray<vec4>();
-    Mesh::VertexArray<vec3> shadowParams = mesh.getShadowParamsArray<vec3>();
+    std::unique_ptr<Mesh> mesh(new Mesh(Mesh::Builder()
+                                                .setPrimitive(Mesh::TRIANGLES)
+                                                .setVertices(shadows.getVertexCount(), 2 /* size */)
+                                                .setShadowAttrs()
+                                                .setIndices(shadows.getIndexCount())
+                                                .build()));
+
+    Mesh::VertexArray<vec2> position = mesh->getPositionArray<vec2>();
+    Mesh::VertexArray<vec4> shadowColor = mesh->getShadowColorArray<vec4>();
+    Mesh::VertexArray<vec3> shadowParams = mesh->getShadowParamsArray<vec3>();
     shadows.fillVertices(position, shadowColor, shadowParams);
-    shadows.fillIndices(mesh.getIndicesArray());
+    shadows.fillIndices(mesh->getIndicesArray());
 
-    mState.cornerRadius = 0.0f;
-    mState.drawShadows = true;
-    setupLayerTexturing(mShadowTexture.getTexture());
-    drawMesh(mesh);
-    mState.drawShadows = false;
+    mShadowMeshCache.push_front({casterRect, casterCornerRadius, settings, std::move(mesh)});
+    if (mShadowMeshCache.size() > kMaxShadowMeshCacheSize) {
+        mShadowMeshCache.pop_back();
+    }
+    return *mShadowMeshCache.front().mesh;
 }
 
 } // namespace gl
@@ -19,6 +19,7 @@
 
 #include <condition_variable>
 #include <deque>
+#include <list>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -31,6 +32,7 @@
 #include <renderengine/RenderEngine.h>
 #include <renderengine/private/Description.h>
 #include <sys/types.h>
+#include "GLColorLutCache.h"
 #include "GLShadowTexture.h"
 #include "ImageManager.h"
 
@@ -131,7 +133,7 @@ private:
     // A data space is considered HDR data space if it has BT2020 color space
     // with PQ or HLG transfer function.
     bool isHdrDataSpace(const ui::Dataspace dataSpace) const;
-    bool needsXYZTransformMatrix() const;
+    bool needsXYZTransformMatrix(ui::Dataspace source) const;
     // Defines the viewport, and sets the projection matrix to the projection
     // defined by the clip.
     void setViewportAndProjection(Rect viewport, Rect clip);
@@ -154,6 +156,10 @@ private:
     void fillRegionWithColor(const Region& region, float red, float green, float blue, float alpha);
     void handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                       const ShadowSettings& shadowSettings);
+    // Returns the tessellated shadow mesh for a caster, reusing a cached one when the caster
+    // geometry and shadow settings are unchanged.
+    const Mesh& getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                              const ShadowSettings& shadowSettings);
     void setupLayerBlending(bool premultipliedAlpha, bool opaque, bool disableTexture,
                             const half4& color, float cornerRadius);
     void setupLayerTexturing(const Texture& texture);
@@ -169,6 +175,13 @@ private:
     void setOutputDataSpace(ui::Dataspace dataspace);
     void setDisplayMaxLuminance(const float maxLuminance);
 
+    // Sets up |state| to convert colors from |source| to the output data space.
+    void setupColorConversion(Description& state, ui::Dataspace source) const;
+    bool canUseColorLut(ui::Dataspace source) const;
+    // Renders the color LUTs of the conversions that several layers share.
+    void prepareColorLuts(const DisplaySettings& display,
+                          const std::vector<const LayerSettings*>& layers);
+
     // drawing
     void drawMesh(const Mesh& mesh);
 
@@ -182,8 +195,26 @@ private:
     GLint mMaxTextureSize;
     GLuint mVpWidth;
     GLuint mVpHeight;
+    // Part of the output buffer being redrawn by drawLayers, or invalid when
+    // the whole buffer is.
+    Rect mDamage = Rect::INVALID_RECT;
     Description mState;
     GLShadowTexture mShadowTexture;
+    GLColorLutCache mColorLutCache;
+    // Whether color conversions shared by several layers go through a LUT.
+    bool mUseColorLut = false;
+    static constexpr size_t kMinLayersPerColorLut = 2;
+
+    struct ShadowMeshCacheEntry {
+        FloatRect casterRect;
+        float casterCornerRadius;
+        ShadowSettings settings;
+        std::unique_ptr<Mesh> mesh;
+    };
+    // Most recently used first. Only accessed on the render thread.
+    std::list<ShadowMeshCacheEntry> mShadowMeshCache;
+    // Enough for the shadowed windows of a desktop-like layout.
+    static constexpr size_t kMaxShadowMeshCacheSize = 16;
 
     mat4 mSrgbToXyz;
     mat4 mDisplayP3ToXyz;
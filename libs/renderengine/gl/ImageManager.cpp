@@ -21,6 +21,8 @@
 
 #include <pthread.h>
 
+#include <algorithm>
+
 #include <processgroup/sched_policy.h>
 #include <utils/Trace.h>
 #include "GLESRenderEngine.h"
@@ -72,8 +74,11 @@ void ImageManager::cacheAsync(const sp<GraphicBuffer>& buffer,
 
 status_t ImageManager::cache(const sp<GraphicBuffer>& buffer) {
     ATRACE_CALL();
+    if (buffer == nullptr) {
+        return BAD_VALUE;
+    }
     auto barrier = std::make_shared<Barrier>();
-    cacheAsync(buffer, barrier);
+    queueUrgentInsert(buffer, barrier);
     std::lock_guard<std::mutex> lock(barrier->mutex);
     barrier->condition.wait(barrier->mutex,
                             [&]() REQUIRES(barrier->mutex) { return barrier->isOpen; });
@@ -89,7 +94,33 @@ void ImageManager::releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier
 void ImageManager::queueOperation(const QueueEntry&& entry) {
     {
         std::lock_guard<std::mutex> lock(mMutex);
-        mQueue.emplace(entry);
+        mQueue.emplace_back(entry);
+        ATRACE_INT("ImageManagerQueueDepth", mQueue.size());
+    }
+    mCondition.notify_one();
+}
+
+void ImageManager::queueUrgentInsert(const sp<GraphicBuffer>& buffer,
+                                     const std::shared_ptr<Barrier>& barrier) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const uint64_t bufferId = buffer->getId();
+        QueueEntry entry = {QueueEntry::Operation::Insert, buffer, bufferId, barrier};
+
+        auto it = std::find_if(mQueue.begin(), mQueue.end(), [&](const QueueEntry& queued) {
+            return queued.bufferId == bufferId;
+        });
+        if (it != mQueue.end() && it->op == QueueEntry::Operation::Delete) {
+            // Jumping ahead of a pending release of the same buffer would reorder the two, so
+            // wait for everything queued before it instead.
+            mQueue.push_back(std::move(entry));
+        } else {
+            if (it != mQueue.end() && it->barrier == nullptr) {
+                // The buffer is already being prefetched, so promote that insert instead.
+                mQueue.erase(it);
+            }
+            mQueue.push_front(std::move(entry));
+        }
         ATRACE_INT("ImageManagerQueueDepth", mQueue.size());
     }
     mCondition.notify_one();
@@ -117,7 +148,7 @@ void ImageManager::threadMain() {
             }
 
             entry = mQueue.front();
-            mQueue.pop();
+            mQueue.pop_front();
             ATRACE_INT("ImageManagerQueueDepth", mQueue.size());
         }
 
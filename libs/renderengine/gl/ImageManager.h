@@ -17,8 +17,8 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
 #include <mutex>
-#include <queue>
 #include <thread>
 
 #include <ui/GraphicBuffer.h>
@@ -45,7 +45,9 @@ public:
     void initThread();
     void cacheAsync(const sp<GraphicBuffer>& buffer, const std::shared_ptr<Barrier>& barrier)
             EXCLUDES(mMutex);
-    status_t cache(const sp<GraphicBuffer>& buffer);
+    // Creates the image for |buffer| ahead of any other queued work and waits for it. This is
+    // meant for the render path, which needs the image now, while cacheAsync() prefetches it.
+    status_t cache(const sp<GraphicBuffer>& buffer) EXCLUDES(mMutex);
     void releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) EXCLUDES(mMutex);
 
 private:
@@ -59,12 +61,15 @@ private:
     };
 
     void queueOperation(const QueueEntry&& entry);
+    // Moves a pending insert for the buffer to the front of the queue, or queues one there.
+    void queueUrgentInsert(const sp<GraphicBuffer>& buffer,
+                           const std::shared_ptr<Barrier>& barrier) EXCLUDES(mMutex);
     void threadMain();
     GLESRenderEngine* const mEngine;
     std::thread mThread;
     std::condition_variable_any mCondition;
     std::mutex mMutex;
-    std::queue<QueueEntry> mQueue GUARDED_BY(mMutex);
+    std::deque<QueueEntry> mQueue GUARDED_BY(mMutex);
 
     bool mRunning GUARDED_BY(mMutex) = true;
 };
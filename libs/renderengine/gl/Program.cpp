@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 
+#include <GLES2/gl2ext.h>
 #include <log/log.h>
 #include <math/mat4.h>
 #include <utils/String8.h>
@@ -58,29 +59,50 @@ Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const c
         glDeleteShader(fragmentId);
         glDeleteProgram(programId);
     } else {
-        mProgram = programId;
         mVertexShader = vertexId;
         mFragmentShader = fragmentId;
-        mInitialized = true;
-        mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
-        mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
-        mSamplerLoc = glGetUniformLocation(programId, "sampler");
-        mColorLoc = glGetUniformLocation(programId, "color");
-        mDisplayMaxLuminanceLoc = glGetUniformLocation(programId, "displayMaxLuminance");
-        mMaxMasteringLuminanceLoc = glGetUniformLocation(programId, "maxMasteringLuminance");
-        mMaxContentLuminanceLoc = glGetUniformLocation(programId, "maxContentLuminance");
-        mInputTransformMatrixLoc = glGetUniformLocation(programId, "inputTransformMatrix");
-        mOutputTransformMatrixLoc = glGetUniformLocation(programId, "outputTransformMatrix");
-        mCornerRadiusLoc = glGetUniformLocation(programId, "cornerRadius");
-        mCropCenterLoc = glGetUniformLocation(programId, "cropCenter");
-
-        // set-up the default values for our uniforms
-        glUseProgram(programId);
-        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mat4().asArray());
-        glEnableVertexAttribArray(0);
+        initialize(programId);
     }
 }
 
+Program::Program(const ProgramCache::Key& /*needs*/, GLenum binaryFormat,
+                 const std::vector<uint8_t>& binary)
+      : mInitialized(false), mVertexShader(0), mFragmentShader(0) {
+    GLuint programId = glCreateProgram();
+    glProgramBinaryOES(programId, binaryFormat, binary.data(), static_cast<GLint>(binary.size()));
+
+    // The driver rejects binaries it can no longer load, e.g. after a driver update.
+    GLint status;
+    glGetProgramiv(programId, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(programId);
+        return;
+    }
+    initialize(programId);
+}
+
+void Program::initialize(GLuint programId) {
+    mProgram = programId;
+    mInitialized = true;
+    mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
+    mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
+    mSamplerLoc = glGetUniformLocation(programId, "sampler");
+    mColorLoc = glGetUniformLocation(programId, "color");
+    mDisplayMaxLuminanceLoc = glGetUniformLocation(programId, "displayMaxLuminance");
+    mMaxMasteringLuminanceLoc = glGetUniformLocation(programId, "maxMasteringLuminance");
+    mMaxContentLuminanceLoc = glGetUniformLocation(programId, "maxContentLuminance");
+    mInputTransformMatrixLoc = glGetUniformLocation(programId, "inputTransformMatrix");
+    mOutputTransformMatrixLoc = glGetUniformLocation(programId, "outputTransformMatrix");
+    mCornerRadiusLoc = glGetUniformLocation(programId, "cornerRadius");
+    mCropCenterLoc = glGetUniformLocation(programId, "cropCenter");
+    mColorLutLoc = glGetUniformLocation(programId, "colorLut");
+
+    // set-up the default values for our uniforms
+    glUseProgram(programId);
+    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mat4().asArray());
+    glEnableVertexAttribArray(0);
+}
+
 bool Program::isValid() const {
     return mInitialized;
 }
@@ -89,6 +111,27 @@ void Program::use() {
     glUseProgram(mProgram);
 }
 
+bool Program::getBinary(GLenum* outBinaryFormat, std::vector<uint8_t>* outBinary) const {
+    if (!mInitialized) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(mProgram, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) {
+        return false;
+    }
+
+    outBinary->resize(static_cast<size_t>(length));
+    GLsizei written = 0;
+    glGetProgramBinaryOES(mProgram, length, &written, outBinaryFormat, outBinary->data());
+    if (written <= 0) {
+        return false;
+    }
+    outBinary->resize(static_cast<size_t>(written));
+    return true;
+}
+
 GLuint Program::getAttrib(const char* name) const {
     // TODO: maybe use a local cache
     return glGetAttribLocation(mProgram, name);
@@ -117,45 +160,78 @@ GLuint Program::buildShader(const char* source, GLenum type) {
     return shader;
 }
 
+namespace {
+
+// Updates |cached| and returns true when the uniform has to be uploaded.
+template <typename T>
+bool updateUniform(T& cached, const T& value, bool force) {
+    if (!force && cached == value) {
+        return false;
+    }
+    cached = value;
+    return true;
+}
+
+} // namespace
+
 void Program::setUniforms(const Description& desc) {
-    // TODO: we should have a mechanism here to not always reset uniforms that
-    // didn't change for this program.
+    // Uniforms are part of the program object, so only the ones that changed since this
+    // program was last used need to be uploaded. Consecutive layers mostly share them.
+    const bool force = !mHasUniforms;
+    mHasUniforms = true;
+    Uniforms& cache = mUniforms;
 
     if (mSamplerLoc >= 0) {
-        glUniform1i(mSamplerLoc, 0);
-        glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, desc.texture.getMatrix().asArray());
+        if (force) {
+            glUniform1i(mSamplerLoc, 0);
+        }
+        if (updateUniform(cache.textureMatrix, desc.texture.getMatrix(), force)) {
+            glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, cache.textureMatrix.asArray());
+        }
     }
-    if (mColorLoc >= 0) {
+    if (mColorLutLoc >= 0 && force) {
+        glUniform1i(mColorLutLoc, 1);
+    }
+    if (mColorLoc >= 0 && updateUniform(cache.color, desc.color, force)) {
         const float color[4] = {desc.color.r, desc.color.g, desc.color.b, desc.color.a};
         glUniform4fv(mColorLoc, 1, color);
     }
-    if (mInputTransformMatrixLoc >= 0) {
-        mat4 inputTransformMatrix = desc.inputTransformMatrix;
-        glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE, inputTransformMatrix.asArray());
+    if (mInputTransformMatrixLoc >= 0 &&
+        updateUniform(cache.inputTransformMatrix, desc.inputTransformMatrix, force)) {
+        glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE,
+                           cache.inputTransformMatrix.asArray());
     }
     if (mOutputTransformMatrixLoc >= 0) {
         // The output transform matrix and color matrix can be combined as one matrix
         // that is applied right before applying OETF.
         mat4 outputTransformMatrix = desc.colorMatrix * desc.outputTransformMatrix;
-        glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE, outputTransformMatrix.asArray());
+        if (updateUniform(cache.outputTransformMatrix, outputTransformMatrix, force)) {
+            glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE,
+                               outputTransformMatrix.asArray());
+        }
     }
-    if (mDisplayMaxLuminanceLoc >= 0) {
+    if (mDisplayMaxLuminanceLoc >= 0 &&
+        updateUniform(cache.displayMaxLuminance, desc.displayMaxLuminance, force)) {
         glUniform1f(mDisplayMaxLuminanceLoc, desc.displayMaxLuminance);
     }
-    if (mMaxMasteringLuminanceLoc >= 0) {
+    if (mMaxMasteringLuminanceLoc >= 0 &&
+        updateUniform(cache.maxMasteringLuminance, desc.maxMasteringLuminance, force)) {
         glUniform1f(mMaxMasteringLuminanceLoc, desc.maxMasteringLuminance);
     }
-    if (mMaxContentLuminanceLoc >= 0) {
+    if (mMaxContentLuminanceLoc >= 0 &&
+        updateUniform(cache.maxContentLuminance, desc.maxContentLuminance, force)) {
         glUniform1f(mMaxContentLuminanceLoc, desc.maxContentLuminance);
     }
-    if (mCornerRadiusLoc >= 0) {
+    if (mCornerRadiusLoc >= 0 && updateUniform(cache.cornerRadius, desc.cornerRadius, force)) {
         glUniform1f(mCornerRadiusLoc, desc.cornerRadius);
     }
-    if (mCropCenterLoc >= 0) {
+    if (mCropCenterLoc >= 0 && updateUniform(cache.cropSize, desc.cropSize, force)) {
         glUniform2f(mCropCenterLoc, desc.cropSize.x / 2.0f, desc.cropSize.y / 2.0f);
     }
     // these uniforms are always present
-    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, desc.projectionMatrix.asArray());
+    if (updateUniform(cache.projectionMatrix, desc.projectionMatrix, force)) {
+        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, desc.projectionMatrix.asArray());
+    }
 }
 
 } // namespace gl
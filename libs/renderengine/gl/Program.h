@@ -18,6 +18,7 @@
 #define SF_RENDER_ENGINE_PROGRAM_H
 
 #include <stdint.h>
+#include <vector>
 
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
@@ -54,6 +55,9 @@ public:
     };
 
     Program(const ProgramCache::Key& needs, const char* vertex, const char* fragment);
+    /* Loads a program previously retrieved with getBinary(), see GL_OES_get_program_binary */
+    Program(const ProgramCache::Key& needs, GLenum binaryFormat,
+            const std::vector<uint8_t>& binary);
     ~Program() = default;
 
     /* whether this object is usable */
@@ -71,8 +75,13 @@ public:
     /* set-up uniforms from the description */
     void setUniforms(const Description& desc);
 
+    /* Retrieves the linked program in a driver specific format, see GL_OES_get_program_binary */
+    bool getBinary(GLenum* outBinaryFormat, std::vector<uint8_t>* outBinary) const;
+
 private:
     GLuint buildShader(const char* source, GLenum type);
+    /* Looks up the uniforms of a successfully linked program */
+    void initialize(GLuint programId);
 
     // whether the initialization succeeded
     bool mInitialized;
@@ -110,6 +119,25 @@ private:
 
     /* location of surface crop origin uniform, for rounded corner clipping */
     GLint mCropCenterLoc;
+
+    /* location of the color LUT sampler uniform, always bound to texture unit 1 */
+    GLint mColorLutLoc;
+
+    /* values last uploaded by setUniforms */
+    struct Uniforms {
+        mat4 projectionMatrix;
+        mat4 textureMatrix;
+        half4 color;
+        mat4 inputTransformMatrix;
+        mat4 outputTransformMatrix;
+        float displayMaxLuminance = 0.0f;
+        float maxMasteringLuminance = 0.0f;
+        float maxContentLuminance = 0.0f;
+        float cornerRadius = 0.0f;
+        half2 cropSize;
+    };
+    Uniforms mUniforms;
+    bool mHasUniforms = false;
 };
 
 } // namespace gl
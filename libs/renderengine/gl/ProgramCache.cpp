@@ -18,12 +18,18 @@
 
 #include "ProgramCache.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <android-base/file.h>
 #include <log/log.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
+#include "GLColorLutCache.h"
 #include "Program.h"
 
 ANDROID_SINGLETON_STATIC_INSTANCE(android::renderengine::gl::ProgramCache)
@@ -77,11 +83,159 @@ Formatter& dedent(Formatter& f) {
     return f;
 }
 
+namespace {
+
+// Layout of the persisted program cache, all values in native byte order:
+//   uint32_t magic, uint32_t version, uint32_t driverIdLength, char driverId[driverIdLength],
+//   uint32_t count, then count times:
+//   uint32_t key, uint32_t format, uint32_t length, uint8_t binary[length]
+constexpr uint32_t kPersistentCacheMagic = 0x50524743; // 'PRGC'
+constexpr uint32_t kPersistentCacheVersion = 1;
+
+void appendValue(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendBytes(std::string& out, const void* data, size_t size) {
+    appendValue(out, static_cast<uint32_t>(size));
+    out.append(static_cast<const char*>(data), size);
+}
+
+bool readValue(const std::string& in, size_t* offset, uint32_t* outValue) {
+    if (in.size() - *offset < sizeof(*outValue)) {
+        return false;
+    }
+    memcpy(outValue, in.data() + *offset, sizeof(*outValue));
+    *offset += sizeof(*outValue);
+    return true;
+}
+
+bool readBytes(const std::string& in, size_t* offset, size_t* outStart, size_t* outSize) {
+    uint32_t size;
+    if (!readValue(in, offset, &size) || in.size() - *offset < size) {
+        return false;
+    }
+    *outStart = *offset;
+    *outSize = size;
+    *offset += size;
+    return true;
+}
+
+} // namespace
+
+void ProgramCache::setPersistentCache(const std::string& path, const std::string& driverId) {
+    mPersistentCachePath = path;
+    mDriverId = driverId;
+    mBinaries.clear();
+    mBinariesChanged = false;
+    loadPersistentCache();
+}
+
+void ProgramCache::loadPersistentCache() {
+    ATRACE_CALL();
+
+    std::string contents;
+    if (!base::ReadFileToString(mPersistentCachePath, &contents)) {
+        return;
+    }
+
+    size_t offset = 0;
+    uint32_t magic, version;
+    size_t driverIdStart, driverIdSize;
+    if (!readValue(contents, &offset, &magic) || magic != kPersistentCacheMagic ||
+        !readValue(contents, &offset, &version) || version != kPersistentCacheVersion ||
+        !readBytes(contents, &offset, &driverIdStart, &driverIdSize) ||
+        contents.compare(driverIdStart, driverIdSize, mDriverId) != 0) {
+        ALOGI("Discarding persistent program cache %s", mPersistentCachePath.c_str());
+        return;
+    }
+
+    uint32_t count;
+    if (!readValue(contents, &offset, &count)) {
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        Key key;
+        uint32_t format;
+        size_t start, size;
+        if (!readValue(contents, &offset, &key.mKey) || !readValue(contents, &offset, &format) ||
+            !readBytes(contents, &offset, &start, &size)) {
+            ALOGW("Truncated persistent program cache %s", mPersistentCachePath.c_str());
+            break;
+        }
+        const auto data = reinterpret_cast<const uint8_t*>(contents.data()) + start;
+        mBinaries[key] = ProgramBinary{static_cast<GLenum>(format),
+                                       std::vector<uint8_t>(data, data + size)};
+    }
+    ALOGD("loaded %zu program binaries from %s", mBinaries.size(), mPersistentCachePath.c_str());
+}
+
+void ProgramCache::savePersistentCache() {
+    if (mPersistentCachePath.empty() || !mBinariesChanged) {
+        return;
+    }
+    ATRACE_CALL();
+    mBinariesChanged = false;
+
+    std::string contents;
+    appendValue(contents, kPersistentCacheMagic);
+    appendValue(contents, kPersistentCacheVersion);
+    appendBytes(contents, mDriverId.data(), mDriverId.size());
+    appendValue(contents, static_cast<uint32_t>(mBinaries.size()));
+    for (const auto& [key, binary] : mBinaries) {
+        appendValue(contents, key.mKey);
+        appendValue(contents, binary.format);
+        appendBytes(contents, binary.data.data(), binary.data.size());
+    }
+
+    // Write to a temporary file first, so a crash never leaves a truncated cache behind.
+    const std::string tmpPath = mPersistentCachePath + ".tmp";
+    if (!base::WriteStringToFile(contents, tmpPath) ||
+        rename(tmpPath.c_str(), mPersistentCachePath.c_str()) != 0) {
+        ALOGW("Failed to save persistent program cache %s", mPersistentCachePath.c_str());
+        unlink(tmpPath.c_str());
+    }
+}
+
+std::unique_ptr<Program> ProgramCache::createProgram(const Key& needs) {
+    if (const auto it = mBinaries.find(needs); it != mBinaries.end()) {
+        auto program = std::make_unique<Program>(needs, it->second.format, it->second.data);
+        if (program->isValid()) {
+            return program;
+        }
+        mBinaries.erase(it);
+        mBinariesChanged = true;
+    }
+
+    std::unique_ptr<Program> program = generateProgram(needs);
+    if (!mPersistentCachePath.empty()) {
+        ProgramBinary binary;
+        if (program->getBinary(&binary.format, &binary.data)) {
+            mBinaries[needs] = std::move(binary);
+            mBinariesChanged = true;
+        }
+    }
+    return program;
+}
+
 void ProgramCache::primeCache(
         EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
     auto& cache = mCaches[context];
     uint32_t shaderCount = 0;
 
+    // Prime the keys used by previous runs first, their binaries load without compiling.
+    // createProgram() drops binaries the driver rejects, so iterate over a copy of the keys.
+    std::vector<Key> persistedKeys;
+    persistedKeys.reserve(mBinaries.size());
+    for (const auto& [key, binary] : mBinaries) {
+        persistedKeys.push_back(key);
+    }
+    for (const Key& key : persistedKeys) {
+        if (cache.count(key) == 0) {
+            cache.emplace(key, createProgram(key));
+        }
+    }
+
     if (toneMapperShaderOnly) {
         Key shaderKey;
         // base settings used by HDR->SDR tonemap only
@@ -102,10 +256,11 @@ void ProgramCache::primeCache(
             shaderKey.set(Key::Y410_BT2020_MASK, (i & 2) ?
                     Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
             if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+                cache.emplace(shaderKey, createProgram(shaderKey));
                 shaderCount++;
             }
         }
+        savePersistentCache();
         return;
     }
 
@@ -123,7 +278,7 @@ void ProgramCache::primeCache(
             continue;
         }
         if (cache.count(shaderKey) == 0) {
-            cache.emplace(shaderKey, generateProgram(shaderKey));
+            cache.emplace(shaderKey, createProgram(shaderKey));
             shaderCount++;
         }
     }
@@ -147,7 +302,7 @@ void ProgramCache::primeCache(
             // Cache texture off option for window transition
             shaderKey.set(Key::TEXTURE_MASK, (i & 8) ? Key::TEXTURE_EXT : Key::TEXTURE_OFF);
             if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+                cache.emplace(shaderKey, createProgram(shaderKey));
                 shaderCount++;
             }
         }
@@ -156,6 +311,7 @@ void ProgramCache::primeCache(
     nsecs_t timeAfter = systemTime();
     float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
+    savePersistentCache();
 }
 
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
@@ -221,6 +377,22 @@ ProgramCache::Key ProgramCache::computeKey(const Description& description) {
         }
     }
 
+    switch (description.colorLut) {
+        case Description::ColorLut::SAMPLE:
+            // The whole conversion is in the LUT, so a single program serves every conversion.
+            needs.set(Key::INPUT_TRANSFORM_MATRIX_MASK, Key::INPUT_TRANSFORM_MATRIX_OFF)
+                    .set(Key::OUTPUT_TRANSFORM_MATRIX_MASK, Key::OUTPUT_TRANSFORM_MATRIX_OFF)
+                    .set(Key::INPUT_TF_MASK, Key::INPUT_TF_LINEAR)
+                    .set(Key::OUTPUT_TF_MASK, Key::OUTPUT_TF_LINEAR)
+                    .set(Key::COLOR_LUT_MASK, Key::COLOR_LUT_SAMPLE);
+            break;
+        case Description::ColorLut::GENERATE:
+            needs.set(Key::COLOR_LUT_MASK, Key::COLOR_LUT_GENERATE);
+            break;
+        case Description::ColorLut::NONE:
+            break;
+    }
+
     return needs;
 }
 
@@ -661,6 +833,44 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
             )__SHADER__";
     }
 
+    if (needs.generatesColorLut() || needs.samplesColorLut()) {
+        // The slices of the LUT along b are laid out in a grid, see GLColorLutCache.
+        fs << String8::format("const float colorLutSize = %d.0;", GLColorLutCache::LUT_SIZE);
+        fs << String8::format("const vec2 colorLutGrid = vec2(%d.0, %d.0);",
+                              GLColorLutCache::LUT_GRID_COLUMNS, GLColorLutCache::LUT_GRID_ROWS);
+    }
+
+    if (needs.generatesColorLut()) {
+        fs << R"__SHADER__(
+            vec3 latticeColor() {
+                vec2 texel = floor(gl_FragCoord.xy);
+                vec2 tile = floor((texel + 0.5) / colorLutSize);
+                float slice = tile.y * colorLutGrid.x + tile.x;
+                return vec3(texel - tile * colorLutSize, slice) / (colorLutSize - 1.0);
+            }
+            )__SHADER__";
+    }
+
+    if (needs.samplesColorLut()) {
+        fs << "uniform sampler2D colorLut;";
+        fs << R"__SHADER__(
+            highp vec2 colorLutCoords(const highp float slice, const highp vec2 lattice) {
+                highp float row = floor((slice + 0.5) / colorLutGrid.x);
+                highp vec2 tile = vec2(slice - row * colorLutGrid.x, row);
+                return (tile * colorLutSize + lattice + 0.5) / (colorLutGrid * colorLutSize);
+            }
+
+            vec3 ColorLut(const highp vec3 color) {
+                highp vec3 lattice = clamp(color, 0.0, 1.0) * (colorLutSize - 1.0);
+                // Bilinear filtering covers r and g within a slice, b blends two slices.
+                highp float slice = min(floor(lattice.b), colorLutSize - 2.0);
+                vec3 lower = texture2D(colorLut, colorLutCoords(slice, lattice.rg)).rgb;
+                vec3 upper = texture2D(colorLut, colorLutCoords(slice + 1.0, lattice.rg)).rgb;
+                return mix(lower, upper, lattice.b - slice);
+            }
+            )__SHADER__";
+    }
+
     if (needs.hasTransformMatrix() || (needs.getInputTF() != needs.getOutputTF())) {
         if (needs.needsToneMapping()) {
             fs << "uniform float displayMaxLuminance;";
@@ -708,6 +918,8 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
     fs << "void main(void) {" << indent;
     if (needs.drawShadows()) {
         fs << "gl_FragColor = getShadowColor();";
+    } else if (needs.generatesColorLut()) {
+        fs << "gl_FragColor = vec4(latticeColor(), 1.0);";
     } else {
         if (needs.isTexturing()) {
             fs << "gl_FragColor = texture2D(sampler, outTexCoords);";
@@ -732,14 +944,19 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
         }
     }
 
-    if (needs.hasTransformMatrix() || (needs.getInputTF() != needs.getOutputTF())) {
+    if (needs.samplesColorLut() || needs.hasTransformMatrix() ||
+        (needs.getInputTF() != needs.getOutputTF())) {
         if (!needs.isOpaque() && needs.isPremultiplied()) {
             // un-premultiply if needed before linearization
             // avoid divide by 0 by adding 0.5/256 to the alpha channel
             fs << "gl_FragColor.rgb = gl_FragColor.rgb / (gl_FragColor.a + 0.0019);";
         }
-        fs << "gl_FragColor.rgb = "
-              "OETF(OutputTransform(OOTF(InputTransform(EOTF(gl_FragColor.rgb)))));";
+        if (needs.samplesColorLut()) {
+            fs << "gl_FragColor.rgb = ColorLut(gl_FragColor.rgb);";
+        } else {
+            fs << "gl_FragColor.rgb = "
+                  "OETF(OutputTransform(OOTF(InputTransform(EOTF(gl_FragColor.rgb)))));";
+        }
         if (!needs.isOpaque() && needs.isPremultiplied()) {
             // and re-premultiply if needed after gamma correction
             fs << "gl_FragColor.rgb = gl_FragColor.rgb * (gl_FragColor.a + 0.0019);";
@@ -780,11 +997,12 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
     if (it == cache.end()) {
         // we didn't find our program, so generate one...
         nsecs_t time = systemTime();
-        it = cache.emplace(needs, generateProgram(needs)).first;
+        it = cache.emplace(needs, createProgram(needs)).first;
         time = systemTime() - time;
 
         ALOGV(">>> generated new program for context %p: needs=%08X, time=%u ms (%zu programs)",
               context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
+        savePersistentCache();
     }
 
     // here we have a suitable program for this description
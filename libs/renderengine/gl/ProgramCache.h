@@ -18,7 +18,9 @@
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
@@ -117,6 +119,12 @@ public:
             SHADOW_MASK = 1 << SHADOW_SHIFT,
             SHADOW_OFF = 0 << SHADOW_SHIFT,
             SHADOW_ON = 1 << SHADOW_SHIFT,
+
+            COLOR_LUT_SHIFT = 14,
+            COLOR_LUT_MASK = 3 << COLOR_LUT_SHIFT,
+            COLOR_LUT_OFF = 0 << COLOR_LUT_SHIFT,
+            COLOR_LUT_SAMPLE = 1 << COLOR_LUT_SHIFT,
+            COLOR_LUT_GENERATE = 2 << COLOR_LUT_SHIFT,
         };
 
         inline Key() : mKey(0) {}
@@ -172,6 +180,12 @@ public:
             return inputTF != outputTF;
         }
         inline bool isY410BT2020() const { return (mKey & Y410_BT2020_MASK) == Y410_BT2020_ON; }
+        inline bool samplesColorLut() const {
+            return (mKey & COLOR_LUT_MASK) == COLOR_LUT_SAMPLE;
+        }
+        inline bool generatesColorLut() const {
+            return (mKey & COLOR_LUT_MASK) == COLOR_LUT_GENERATE;
+        }
 
         // for use by std::unordered_map
 
@@ -194,7 +208,22 @@ public:
     // if none can be found.
     void useProgram(const EGLContext context, const Description& description);
 
+    // Keeps the binaries of the programs generated for any key in |path|, so that a later run
+    // loads them instead of compiling the shaders again, and primes the cache with every key
+    // used by a previous run. Binaries saved with a different |driverId| are ignored.
+    void setPersistentCache(const std::string& path, const std::string& driverId);
+
 private:
+    struct ProgramBinary {
+        GLenum format;
+        std::vector<uint8_t> data;
+    };
+
+    // creates a program from its persisted binary, or generates it if there is none
+    std::unique_ptr<Program> createProgram(const Key& needs);
+    void loadPersistentCache();
+    void savePersistentCache();
+
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -216,6 +245,13 @@ private:
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
             mCaches;
+
+    // Empty when program binaries are not persisted.
+    std::string mPersistentCachePath;
+    std::string mDriverId;
+    std::unordered_map<Key, ProgramBinary, Key::Hash> mBinaries;
+    // Whether mBinaries changed since it was last saved.
+    bool mBinariesChanged = false;
 };
 
 } // namespace gl
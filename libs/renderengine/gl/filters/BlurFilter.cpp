@@ -30,8 +30,38 @@ namespace android {
 namespace renderengine {
 namespace gl {
 
-BlurFilter::BlurFilter(GLESRenderEngine& engine)
-      : mEngine(engine),
+namespace {
+
+float getFboScale(BlurFilter::Quality quality) {
+    switch (quality) {
+        case BlurFilter::Quality::LOW:
+            return 0.125f;
+        case BlurFilter::Quality::MEDIUM:
+            return 0.2f;
+        case BlurFilter::Quality::HIGH:
+            break;
+    }
+    return 0.25f;
+}
+
+uint32_t getMaxPasses(BlurFilter::Quality quality) {
+    switch (quality) {
+        case BlurFilter::Quality::LOW:
+            return 2;
+        case BlurFilter::Quality::MEDIUM:
+            return 3;
+        case BlurFilter::Quality::HIGH:
+            break;
+    }
+    return 4;
+}
+
+} // namespace
+
+BlurFilter::BlurFilter(GLESRenderEngine& engine, Quality quality)
+      : mFboScale(getFboScale(quality)),
+        mMaxPasses(getMaxPasses(quality)),
+        mEngine(engine),
         mCompositionFbo(engine),
         mPingFbo(engine),
         mPongFbo(engine),
@@ -67,6 +97,9 @@ BlurFilter::BlurFilter(GLESRenderEngine& engine)
 
 status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t radius) {
     ATRACE_NAME("BlurFilter::setAsDrawTarget");
+    // Compositing into the offscreen texture overwrites the cached blur.
+    mHasCachedContent = false;
+    mCachedLayers.clear();
     mRadius = radius;
     mDisplayX = display.physicalDisplay.left;
     mDisplayY = display.physicalDisplay.top;
@@ -79,8 +112,8 @@ status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t ra
         mDisplayHeight = display.physicalDisplay.height();
         mCompositionFbo.allocateBuffers(mDisplayWidth, mDisplayHeight);
 
-        const uint32_t fboWidth = floorf(mDisplayWidth * kFboScale);
-        const uint32_t fboHeight = floorf(mDisplayHeight * kFboScale);
+        const uint32_t fboWidth = floorf(mDisplayWidth * mFboScale);
+        const uint32_t fboHeight = floorf(mDisplayHeight * mFboScale);
         mPingFbo.allocateBuffers(fboWidth, fboHeight);
         mPongFbo.allocateBuffers(fboWidth, fboHeight);
 
@@ -132,7 +165,7 @@ status_t BlurFilter::prepare() {
 
     // Calculate how many passes we'll do, based on the radius.
     // Too many passes will make the operation expensive.
-    const auto passes = min(kMaxPasses, (uint32_t)ceil(radius));
+    const auto passes = min(mMaxPasses, (uint32_t)ceil(radius));
 
     const float radiusByPasses = radius / (float)passes;
     const float stepX = radiusByPasses / (float)mCompositionFbo.getBufferWidth();
@@ -206,6 +239,34 @@ status_t BlurFilter::render(bool multiPass) {
     return NO_ERROR;
 }
 
+void BlurFilter::setCachedContent(const DisplaySettings& display,
+                                  const std::vector<const LayerSettings*>& layers) {
+    mHasCachedContent = true;
+    mCachedDisplay = display;
+    mCachedRadius = mRadius;
+    mCachedLayers.clear();
+    mCachedLayers.reserve(layers.size());
+    for (const LayerSettings* layer : layers) {
+        mCachedLayers.push_back(*layer);
+    }
+}
+
+bool BlurFilter::hasCachedContent(const DisplaySettings& display, uint32_t radius,
+                                  const std::vector<const LayerSettings*>& layers) const {
+    if (!mHasCachedContent || radius != mCachedRadius || !(display == mCachedDisplay) ||
+        layers.size() != mCachedLayers.size()) {
+        return false;
+    }
+    // A layer whose buffer was updated has a new acquire fence, so comparing the settings
+    // also catches content changes.
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (!(*layers[i] == mCachedLayers[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 string BlurFilter::getVertexShader() const {
     return R"SHADER(#version 310 es
         precision mediump float;
@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <vector>
+
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
 #include <ui/GraphicTypes.h>
 #include "../GLESRenderEngine.h"
 #include "../GLFramebuffer.h"
@@ -35,15 +39,18 @@ namespace gl {
  */
 class BlurFilter {
 public:
-    // Downsample FBO to improve performance
-    static constexpr float kFboScale = 0.25f;
-    // Maximum number of render passes
-    static constexpr uint32_t kMaxPasses = 4;
+    // Trades blur quality for GPU time, by downsampling further and doing fewer passes.
+    enum class Quality : int32_t {
+        LOW = 0,
+        MEDIUM = 1,
+        HIGH = 2,
+    };
+
     // To avoid downscaling artifacts, we interpolate the blurred fbo with the full composited
     // image, up to this radius.
     static constexpr float kMaxCrossFadeRadius = 30.0f;
 
-    explicit BlurFilter(GLESRenderEngine& engine);
+    explicit BlurFilter(GLESRenderEngine& engine, Quality quality = Quality::HIGH);
     virtual ~BlurFilter(){};
 
     // Set up render targets, redirecting output to offscreen texture.
@@ -53,8 +60,21 @@ public:
     // Render blur to the bound framebuffer (screen).
     status_t render(bool multiPass);
 
+    // Remembers what the blur computed by the last prepare() was composited from, the layers
+    // drawn beneath the blur layer.
+    void setCachedContent(const DisplaySettings& display,
+                          const std::vector<const LayerSettings*>& layers);
+    // Whether the last blur can be rendered again as is, without setAsDrawTarget() and
+    // prepare(), because the content beneath the blur layer has not changed.
+    bool hasCachedContent(const DisplaySettings& display, uint32_t radius,
+                          const std::vector<const LayerSettings*>& layers) const;
+
 private:
     uint32_t mRadius;
+    // Downsample FBO to improve performance
+    const float mFboScale;
+    // Maximum number of render passes
+    const uint32_t mMaxPasses;
     void drawMesh(GLuint uv, GLuint position);
     string getVertexShader() const;
     string getFragmentShader() const;
@@ -73,6 +93,12 @@ private:
     // Buffer holding the final blur pass.
     GLFramebuffer* mLastDrawTarget;
 
+    // What mCompositionFbo and mLastDrawTarget were rendered from, see setCachedContent().
+    bool mHasCachedContent = false;
+    DisplaySettings mCachedDisplay;
+    uint32_t mCachedRadius = 0;
+    std::vector<LayerSettings> mCachedLayers;
+
     // VBO containing vertex and uv data of a fullscreen triangle.
     GLVertexBuffer mMeshBuffer;
 
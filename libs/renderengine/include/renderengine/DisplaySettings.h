@@ -60,13 +60,20 @@ struct DisplaySettings {
     // capture of a device in landscape while the buffer is in portrait
     // orientation.
     uint32_t orientation = ui::Transform::ROT_0;
+
+    // Part of the physical display that needs to be redrawn, in the same
+    // coordinates as physicalDisplay. When valid, pixels outside of it keep
+    // the contents the output buffer already has, so the caller must only set
+    // it when those are known to be current.
+    Rect damage = Rect::INVALID_RECT;
 };
 
 static inline bool operator==(const DisplaySettings& lhs, const DisplaySettings& rhs) {
     return lhs.physicalDisplay == rhs.physicalDisplay && lhs.clip == rhs.clip &&
             lhs.maxLuminance == rhs.maxLuminance && lhs.outputDataspace == rhs.outputDataspace &&
             lhs.colorTransform == rhs.colorTransform &&
-            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation;
+            lhs.clearRegion.hasSameRects(rhs.clearRegion) && lhs.orientation == rhs.orientation &&
+            lhs.damage == rhs.damage;
 }
 
 // Defining PrintTo helps with Google Tests.
@@ -83,6 +90,8 @@ static inline void PrintTo(const DisplaySettings& settings, ::std::ostream* os)
     *os << "\n    .clearRegion = ";
     PrintTo(settings.clearRegion, os);
     *os << "\n    .orientation = " << settings.orientation;
+    *os << "\n    .damage = ";
+    PrintTo(settings.damage, os);
     *os << "\n}";
 }
 
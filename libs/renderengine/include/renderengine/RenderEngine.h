@@ -32,9 +32,27 @@
 
 /**
  * Allows to set RenderEngine backend to GLES (default) or Vulkan (NOT yet supported).
+ * Selecting "vulkan" falls back to GLES until that backend exists.
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
+/**
+ * File in which the GLES backend persists its linked shader programs across restarts. Program
+ * binaries are not persisted when this is unset.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_PROGRAM_CACHE_PATH "debug.renderengine.program_cache_path"
+
+/**
+ * Quality of the background blur, from 0 (lowest GPU cost) to 2 (default).
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_BLUR_QUALITY "debug.renderengine.blur_quality"
+
+/**
+ * Whether color conversions shared by several layers are read from a cached 3D LUT rather than
+ * computed per pixel (default true).
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_COLOR_LUT "debug.renderengine.color_lut"
+
 struct ANativeWindowBuffer;
 
 namespace android {
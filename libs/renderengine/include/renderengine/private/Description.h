@@ -84,6 +84,15 @@ struct Description {
 
     // True if this layer will draw a shadow.
     bool drawShadows = false;
+
+    // How the color conversion above relates to a color LUT: computed per pixel, read from a
+    // LUT, or computed for the lattice points of a LUT being rendered.
+    enum class ColorLut : int {
+        NONE,
+        SAMPLE,
+        GENERATE,
+    };
+    ColorLut colorLut = ColorLut::NONE;
 };
 
 } // namespace renderengine
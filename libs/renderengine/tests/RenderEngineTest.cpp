@@ -1083,6 +1083,12 @@ TEST_F(RenderEngineTest, drawLayers_fillBufferAndBlurBackground_colorSource) {
     fillBufferAndBlurBackground<ColorSourceVariant>();
 }
 
+TEST_F(RenderEngineTest, drawLayers_fillBufferAndBlurBackground_reusesUnchangedBlur) {
+    fillBufferAndBlurBackground<ColorSourceVariant>();
+    // Nothing beneath the blur layer changed, so the second frame draws the cached blur.
+    fillBufferAndBlurBackground<ColorSourceVariant>();
+}
+
 TEST_F(RenderEngineTest, drawLayers_overlayCorners_colorSource) {
     overlayCorners<ColorSourceVariant>();
 }
@@ -1215,6 +1221,31 @@ TEST_F(RenderEngineTest, drawLayers_clearRegion) {
     clearRegion();
 }
 
+TEST_F(RenderEngineTest, drawLayers_onlyDrawsDamage) {
+    renderengine::DisplaySettings settings;
+    settings.physicalDisplay = fullscreenRect();
+    settings.clip = fullscreenRect();
+
+    std::vector<const renderengine::LayerSettings*> layers;
+    renderengine::LayerSettings layer;
+    layer.geometry.boundaries = fullscreenRect().toFloatRect();
+    ColorSourceVariant::fillColor(layer, 1.0f, 0.0f, 0.0f, this);
+    layer.alpha = 1.0f;
+    layers.push_back(&layer);
+    invokeDraw(settings, layers, mBuffer);
+
+    // Only the left half is redrawn, the right half keeps the previous frame.
+    const Rect leftHalf(DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT);
+    settings.damage = leftHalf;
+    ColorSourceVariant::fillColor(layer, 0.0f, 0.0f, 1.0f, this);
+    invokeDraw(settings, layers, mBuffer);
+
+    expectBufferColor(leftHalf, 0, 0, 255, 255);
+    expectBufferColor(Rect(DEFAULT_DISPLAY_WIDTH / 2, 0, DEFAULT_DISPLAY_WIDTH,
+                           DEFAULT_DISPLAY_HEIGHT),
+                      255, 0, 0, 255);
+}
+
 TEST_F(RenderEngineTest, drawLayers_fillsBufferAndCachesImages) {
     renderengine::DisplaySettings settings;
     settings.physicalDisplay = fullscreenRect();
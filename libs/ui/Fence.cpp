@@ -27,6 +27,7 @@
 #include <sync/sync.h>
 #pragma clang diagnostic pop
 
+#include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utils/Log.h>
@@ -149,6 +150,13 @@ nsecs_t Fence::getSignalTime() const {
         return SIGNAL_TIME_INVALID;
     }
 
+    // Most queries are made before the fence signals. The poll() underlying sync_wait() tells
+    // that apart with a single syscall, while sync_file_info() takes two ioctls and allocates a
+    // copy of every sync point.
+    if (sync_wait(mFenceFd, 0) < 0 && errno == ETIME) {
+        return SIGNAL_TIME_PENDING;
+    }
+
     struct sync_file_info* finfo = sync_file_info(mFenceFd);
     if (finfo == nullptr) {
         ALOGE("sync_file_info returned NULL for fd %d", mFenceFd.get());
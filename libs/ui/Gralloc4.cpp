@@ -154,6 +154,11 @@ status_t Gralloc4Mapper::importBuffer(const hardware::hidl_handle& rawHandle,
 }
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
+    {
+        std::lock_guard lock(mMetadataCacheMutex);
+        mMetadataCache.erase(bufferHandle);
+    }
+
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
     auto ret = mMapper->freeBuffer(buffer);
 
@@ -403,6 +408,53 @@ int Gralloc4Mapper::unlock(buffer_handle_t bufferHandle) const {
     return releaseFence;
 }
 
+status_t Gralloc4Mapper::flushLockedBuffer(buffer_handle_t bufferHandle, int* outFenceFd) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+
+    *outFenceFd = -1;
+    Error error;
+    auto ret = mMapper->flushLockedBuffer(buffer, [&](const auto& tmpError, const auto& tmpFence) {
+        error = tmpError;
+        if (error != Error::NONE) {
+            return;
+        }
+
+        auto fenceHandle = tmpFence.getNativeHandle();
+        if (fenceHandle && fenceHandle->numFds == 1) {
+            int fd = dup(fenceHandle->data[0]);
+            if (fd >= 0) {
+                *outFenceFd = fd;
+            } else {
+                ALOGD("failed to dup flushLockedBuffer release fence");
+                sync_wait(fenceHandle->data[0], -1);
+            }
+        }
+    });
+
+    if (!ret.isOk()) {
+        error = kTransactionError;
+    }
+
+    if (error != Error::NONE) {
+        ALOGE("flushLockedBuffer(%p) failed with %d", buffer, error);
+    }
+
+    return static_cast<status_t>(error);
+}
+
+status_t Gralloc4Mapper::rereadLockedBuffer(buffer_handle_t bufferHandle) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+
+    auto ret = mMapper->rereadLockedBuffer(buffer);
+    const Error error = ret.isOk() ? static_cast<Error>(ret) : kTransactionError;
+
+    if (error != Error::NONE) {
+        ALOGE("rereadLockedBuffer(%p) failed with %d", buffer, error);
+    }
+
+    return static_cast<status_t>(error);
+}
+
 status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelFormat format,
                                      uint32_t layerCount, uint64_t usage,
                                      bool* outSupported) const {
@@ -440,6 +492,18 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return BAD_VALUE;
     }
 
+    const bool cacheable = isImmutableMetadataType(metadataType);
+    if (cacheable) {
+        std::lock_guard lock(mMetadataCacheMutex);
+        const auto buffer = mMetadataCache.find(bufferHandle);
+        if (buffer != mMetadataCache.end()) {
+            const auto entry = buffer->second.find(metadataType.value);
+            if (entry != buffer->second.end()) {
+                return decodeFunction(entry->second, outMetadata);
+            }
+        }
+    }
+
     hidl_vec<uint8_t> vec;
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
@@ -458,7 +522,36 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return static_cast<status_t>(error);
     }
 
-    return decodeFunction(vec, outMetadata);
+    status_t status = decodeFunction(vec, outMetadata);
+    if (status == NO_ERROR && cacheable) {
+        std::lock_guard lock(mMetadataCacheMutex);
+        mMetadataCache[bufferHandle][metadataType.value] = std::move(vec);
+    }
+    return status;
+}
+
+bool Gralloc4Mapper::isImmutableMetadataType(const MetadataType& metadataType) {
+    if (!gralloc4::isStandardMetadataType(metadataType)) {
+        return false;
+    }
+    switch (gralloc4::getStandardMetadataTypeValue(metadataType)) {
+        case StandardMetadataType::BUFFER_ID:
+        case StandardMetadataType::NAME:
+        case StandardMetadataType::WIDTH:
+        case StandardMetadataType::HEIGHT:
+        case StandardMetadataType::LAYER_COUNT:
+        case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+        case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+        case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+        case StandardMetadataType::USAGE:
+        case StandardMetadataType::ALLOCATION_SIZE:
+        case StandardMetadataType::COMPRESSION:
+        case StandardMetadataType::INTERLACED:
+        case StandardMetadataType::PLANE_LAYOUTS:
+            return true;
+        default:
+            return false;
+    }
 }
 
 status_t Gralloc4Mapper::getBufferId(buffer_handle_t bufferHandle, uint64_t* outBufferId) const {
@@ -122,12 +122,20 @@ void GraphicBuffer::free_handle()
     if (mOwner == ownHandle) {
         mBufferMapper.freeBuffer(handle);
     } else if (mOwner == ownData) {
-        GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
-        allocator.free(handle);
+        freeAllocatedHandle();
     }
     handle = nullptr;
 }
 
+void GraphicBuffer::freeAllocatedHandle() {
+    GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
+    if (mShared) {
+        allocator.free(handle);
+    } else {
+        allocator.recycle(handle);
+    }
+}
+
 status_t GraphicBuffer::initCheck() const {
     return static_cast<status_t>(mInitCheck);
 }
@@ -158,9 +166,9 @@ status_t GraphicBuffer::reallocate(uint32_t inWidth, uint32_t inHeight,
         return NO_ERROR;
 
     if (handle) {
-        GraphicBufferAllocator& allocator(GraphicBufferAllocator::get());
-        allocator.free(handle);
+        freeAllocatedHandle();
         handle = nullptr;
+        mShared = false;
     }
     return initWithSize(inWidth, inHeight, inFormat, inLayerCount, inUsage, "[Reallocation]");
 }
@@ -384,6 +392,7 @@ status_t GraphicBuffer::flatten(void*& buffer, size_t& size, int*& fds, size_t&
     buf[12] = int(usage >> 32); // high 32-bits
 
     if (handle) {
+        mShared = true;
         buf[10] = int32_t(mTransportNumFds);
         buf[11] = int32_t(mTransportNumInts);
         memcpy(fds, handle->data, static_cast<size_t>(mTransportNumFds) * sizeof(int));
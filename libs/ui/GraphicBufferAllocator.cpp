@@ -21,8 +21,12 @@
 #include <ui/GraphicBufferAllocator.h>
 
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include <iterator>
+#include <thread>
+
 #include <grallocusage/GrallocUsageConversion.h>
 
 #include <android-base/stringprintf.h>
@@ -67,7 +71,16 @@ GraphicBufferAllocator::GraphicBufferAllocator() : mMapper(GraphicBufferMapper::
     LOG_ALWAYS_FATAL("gralloc-allocator is missing");
 }
 
-GraphicBufferAllocator::~GraphicBufferAllocator() {}
+GraphicBufferAllocator::~GraphicBufferAllocator() {
+    {
+        Mutex::Autolock _l(sLock);
+        mPoolEvictionThreadExit = true;
+        mPoolCondition.signal();
+    }
+    if (mPoolEvictionThread.joinable()) {
+        mPoolEvictionThread.join();
+    }
+}
 
 uint64_t GraphicBufferAllocator::getTotalSize() const {
     Mutex::Autolock _l(sLock);
@@ -101,6 +114,9 @@ void GraphicBufferAllocator::dump(std::string& result, bool less) const {
     }
     StringAppendF(&result, "Total allocated by GraphicBufferAllocator (estimate): %.2f KB\n",
                   static_cast<double>(total) / 1024.0);
+    StringAppendF(&result, "Pooled for reuse: %zu buffers, %.2f KB (capacity %.2f KB)\n",
+                  mPool.size(), static_cast<double>(mPoolSize) / 1024.0,
+                  static_cast<double>(mPoolCapacity) / 1024.0);
 
     result.append(mAllocator->dumpDebugInfo(less));
 }
@@ -137,6 +153,21 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
     // TODO(b/72323293, b/72703005): Remove these invalid bits from callers
     usage &= ~static_cast<uint64_t>((1 << 10) | (1 << 13));
 
+    if (importBuffer) {
+        std::vector<buffer_handle_t> evicted;
+        bool reused;
+        {
+            Mutex::Autolock _l(sLock);
+            evicted = evictFromPoolLocked(systemTime(), mPoolCapacity);
+            reused = takeFromPoolLocked(width, height, format, layerCount, usage, handle, stride,
+                                        requestorName);
+        }
+        freeHandles(evicted);
+        if (reused) {
+            return NO_ERROR;
+        }
+    }
+
     status_t error = mAllocator->allocate(requestorName, width, height, format, layerCount, usage,
                                           1, stride, handle, importBuffer);
     if (error != NO_ERROR) {
@@ -215,5 +246,119 @@ status_t GraphicBufferAllocator::free(buffer_handle_t handle)
     return NO_ERROR;
 }
 
+status_t GraphicBufferAllocator::recycle(buffer_handle_t handle) {
+    ATRACE_CALL();
+
+    std::vector<buffer_handle_t> evicted;
+    bool pooled = false;
+    {
+        Mutex::Autolock _l(sLock);
+        const ssize_t index = sAllocList.indexOfKey(handle);
+        if (index >= 0) {
+            const alloc_rec_t& rec(sAllocList.valueAt(index));
+            constexpr uint64_t kUnpooledUsage = GRALLOC_USAGE_PROTECTED | GRALLOC_USAGE_HW_COMPOSER;
+            if ((rec.usage & kUnpooledUsage) == 0 && rec.size > 0 && rec.size <= mPoolCapacity) {
+                const nsecs_t now = systemTime();
+                mPool.push_back({handle, now});
+                mPoolSize += rec.size;
+                pooled = true;
+                evicted = evictFromPoolLocked(now, mPoolCapacity);
+                if (!mPoolEvictionThread.joinable()) {
+                    mPoolEvictionThread =
+                            std::thread(&GraphicBufferAllocator::poolEvictionLoop, this);
+                }
+                mPoolCondition.signal();
+            }
+        }
+    }
+    freeHandles(evicted);
+
+    return pooled ? NO_ERROR : free(handle);
+}
+
+void GraphicBufferAllocator::setPoolCapacity(size_t bytes) {
+    std::vector<buffer_handle_t> evicted;
+    {
+        Mutex::Autolock _l(sLock);
+        mPoolCapacity = bytes;
+        evicted = evictFromPoolLocked(systemTime(), mPoolCapacity);
+    }
+    freeHandles(evicted);
+}
+
+void GraphicBufferAllocator::trimPool() {
+    ATRACE_CALL();
+    std::vector<buffer_handle_t> evicted;
+    {
+        Mutex::Autolock _l(sLock);
+        evicted = evictFromPoolLocked(systemTime(), 0);
+    }
+    freeHandles(evicted);
+}
+
+bool GraphicBufferAllocator::takeFromPoolLocked(uint32_t width, uint32_t height,
+                                                PixelFormat format, uint32_t layerCount,
+                                                uint64_t usage, buffer_handle_t* handle,
+                                                uint32_t* stride, std::string& requestorName) {
+    // Prefer the most recently recycled buffer, which is the least likely to be evicted soon.
+    for (auto entry = mPool.rbegin(); entry != mPool.rend(); ++entry) {
+        alloc_rec_t& rec(sAllocList.editValueFor(entry->handle));
+        if (rec.width != width || rec.height != height || rec.format != format ||
+            rec.layerCount != layerCount || rec.usage != usage) {
+            continue;
+        }
+
+        ATRACE_NAME("GraphicBufferPool hit");
+        *handle = entry->handle;
+        *stride = rec.stride;
+        rec.requestorName = std::move(requestorName);
+        mPoolSize -= rec.size;
+        mPool.erase(std::next(entry).base());
+        return true;
+    }
+    return false;
+}
+
+std::vector<buffer_handle_t> GraphicBufferAllocator::evictFromPoolLocked(nsecs_t now,
+                                                                         size_t capacity) {
+    std::vector<buffer_handle_t> evicted;
+    while (!mPool.empty() &&
+           (mPoolSize > capacity || now - mPool.front().recycleTime > kPoolEntryMaxAge)) {
+        const buffer_handle_t handle = mPool.front().handle;
+        mPoolSize -= sAllocList.valueFor(handle).size;
+        mPool.pop_front();
+        evicted.push_back(handle);
+    }
+    return evicted;
+}
+
+void GraphicBufferAllocator::poolEvictionLoop() {
+    pthread_setname_np(pthread_self(), "GBAllocPoolEvict");
+    Mutex::Autolock _l(sLock);
+    while (!mPoolEvictionThreadExit) {
+        const nsecs_t now = systemTime();
+        std::vector<buffer_handle_t> evicted = evictFromPoolLocked(now, mPoolCapacity);
+        if (!evicted.empty()) {
+            sLock.unlock();
+            freeHandles(evicted);
+            sLock.lock();
+            continue;
+        }
+        if (mPool.empty()) {
+            mPoolCondition.wait(sLock);
+        } else {
+            // Newer entries age out later, so waking for the oldest one is enough.
+            mPoolCondition.waitRelative(sLock,
+                                        mPool.front().recycleTime + kPoolEntryMaxAge - now + 1);
+        }
+    }
+}
+
+void GraphicBufferAllocator::freeHandles(const std::vector<buffer_handle_t>& handles) {
+    for (buffer_handle_t handle : handles) {
+        free(handle);
+    }
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
@@ -45,6 +45,12 @@
 #include <core/SkRegion.h>
 #endif
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -64,6 +70,75 @@ enum {
 
 const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
+// The helpers below treat a Rect as a vector of four int32_t lanes
+// (left, top, right, bottom).
+static_assert(sizeof(Rect) == 4 * sizeof(int32_t), "Rect must be four packed int32_t");
+
+// Offsets |count| rects by (dx, dy).
+static inline void offsetRects(Rect* rects, size_t count, int dx, int dy) {
+#if defined(__ARM_NEON)
+    const int32_t offsets[4] = {dx, dy, dx, dy};
+    const int32x4_t offset = vld1q_s32(offsets);
+    int32_t* p = reinterpret_cast<int32_t*>(rects);
+    for (size_t i = 0; i < count; i++, p += 4) {
+        vst1q_s32(p, vaddq_s32(vld1q_s32(p), offset));
+    }
+#elif defined(__SSE2__)
+    const __m128i offset = _mm_setr_epi32(dx, dy, dx, dy);
+    __m128i* p = reinterpret_cast<__m128i*>(rects);
+    for (size_t i = 0; i < count; i++, p++) {
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), offset));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        rects[i].offsetBy(dx, dy);
+    }
+#endif
+}
+
+// Returns true if the two runs of |count| rects have the same left and right
+// edges, i.e. the second span can be merged vertically into the first.
+static inline bool sameHorizontalExtents(const Rect* a, const Rect* b, size_t count) {
+#if defined(__ARM_NEON)
+    const uint32_t lanes[4] = {~0u, 0u, ~0u, 0u};
+    const uint32x4_t mask = vld1q_u32(lanes);
+    const int32_t* p = reinterpret_cast<const int32_t*>(a);
+    const int32_t* q = reinterpret_cast<const int32_t*>(b);
+    for (size_t i = 0; i < count; i++, p += 4, q += 4) {
+        const uint32x4_t equal = vceqq_s32(vld1q_s32(p), vld1q_s32(q));
+        // Non-zero in lanes 0 or 2 if left or right differ
+        const uint32x4_t diff = vandq_u32(vmvnq_u32(equal), mask);
+        if (vgetq_lane_u32(diff, 0) | vgetq_lane_u32(diff, 2)) {
+            return false;
+        }
+    }
+    return true;
+#elif defined(__SSE2__)
+    const __m128i* p = reinterpret_cast<const __m128i*>(a);
+    const __m128i* q = reinterpret_cast<const __m128i*>(b);
+    for (size_t i = 0; i < count; i++, p++, q++) {
+        const __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(p), _mm_loadu_si128(q));
+        // Bytes 0-3 hold left, bytes 8-11 hold right
+        if ((_mm_movemask_epi8(equal) & 0x0F0F) != 0x0F0F) {
+            return false;
+        }
+    }
+    return true;
+#else
+    for (size_t i = 0; i < count; i++) {
+        if (a[i].left != b[i].left || a[i].right != b[i].right) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+static inline bool containsRect(const Rect& outer, const Rect& inner) {
+    return outer.left <= inner.left && outer.top <= inner.top &&
+            outer.right >= inner.right && outer.bottom >= inner.bottom;
+}
+
 // ----------------------------------------------------------------------------
 
 Region::Region() {
@@ -329,6 +404,9 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
+    if (isRect() && rect_operation(op, *this, getBounds(), r)) {
+        return *this;
+    }
     Region lhs(*this);
     boolean_operation(op, *this, lhs, r);
     return *this;
@@ -353,6 +431,9 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
+    if (isRect() && rhs.isRect() && rect_operation(op, *this, getBounds(), rhs.getBounds())) {
+        return *this;
+    }
     Region lhs(*this);
     boolean_operation(op, *this, lhs, rhs);
     return *this;
@@ -393,6 +474,9 @@ const Region Region::subtract(const Rect& rhs) const {
 }
 const Region Region::operation(const Rect& rhs, uint32_t op) const {
     Region result;
+    if (isRect() && rect_operation(op, result, getBounds(), rhs)) {
+        return result;
+    }
     boolean_operation(op, result, *this, rhs);
     return result;
 }
@@ -413,6 +497,9 @@ const Region Region::subtract(const Region& rhs) const {
 }
 const Region Region::operation(const Region& rhs, uint32_t op) const {
     Region result;
+    if (isRect() && rhs.isRect() && rect_operation(op, result, getBounds(), rhs.getBounds())) {
+        return result;
+    }
     boolean_operation(op, result, *this, rhs);
     return result;
 }
@@ -535,15 +622,7 @@ void Region::rasterizer::flushSpan()
         Rect const* p = span.data();
         Rect const* q = head;
         if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++;
-                q++;
-            }
+            merge = sameHorizontalExtents(p, q, span.size());
         }
     }
     if (merge) {
@@ -653,6 +732,14 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+#if !VALIDATE_WITH_CORECG
+    Rect rhsBounds = rhs.getBounds();
+    rhsBounds.offsetBy(dx, dy);
+    if (bounds_operation(op, dst, lhs, rhsBounds)) {
+        return;
+    }
+#endif
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -767,6 +854,12 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    Rect rhsBounds = rhs;
+    rhsBounds.offsetBy(dx, dy);
+    if (bounds_operation(op, dst, lhs, rhsBounds)) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -781,6 +874,78 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #endif
 }
 
+bool Region::bounds_operation(uint32_t op, Region& dst, const Region& lhs, const Rect& rhsBounds)
+{
+    // When the operands do not overlap at all, intersecting yields nothing
+    // and subtracting leaves the lhs as is, without visiting any span.
+    const Rect lhsBounds = lhs.getBounds();
+    if (lhsBounds.isEmpty() || !rhsBounds.isValid()) {
+        return false;
+    }
+    Rect ignored;
+    if (lhsBounds.intersect(rhsBounds, &ignored)) {
+        return false;
+    }
+    switch (op) {
+        case op_and:
+            dst.clear();
+            return true;
+        case op_nand:
+            if (&dst != &lhs) {
+                dst = lhs;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Region::rect_operation(uint32_t op, Region& dst, Rect lhs, Rect rhs)
+{
+    // Only the cases where the result is a single rect (or empty) are handled
+    // here, everything else goes through the rasterizer. Empty and invalid
+    // operands are left to boolean_operation() as well.
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+        return false;
+    }
+
+    switch (op) {
+        case op_and: {
+            Rect result;
+            if (lhs.intersect(rhs, &result)) {
+                dst.set(result);
+            } else {
+                dst.clear();
+            }
+            return true;
+        }
+        case op_or:
+            if (containsRect(lhs, rhs)) {
+                dst.set(lhs);
+                return true;
+            }
+            if (containsRect(rhs, lhs)) {
+                dst.set(rhs);
+                return true;
+            }
+            return false;
+        case op_nand: {
+            if (containsRect(rhs, lhs)) {
+                dst.clear();
+                return true;
+            }
+            Rect ignored;
+            if (!lhs.intersect(rhs, &ignored)) {
+                dst.set(lhs);
+                return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs, const Region& rhs)
 {
@@ -799,13 +964,7 @@ void Region::translate(Region& reg, int dx, int dy)
 #if defined(VALIDATE_REGIONS)
         validate(reg, "translate (before)");
 #endif
-        size_t count = reg.mStorage.size();
-        Rect* rects = reg.mStorage.data();
-        while (count) {
-            rects->offsetBy(dx, dy);
-            rects++;
-            count--;
-        }
+        offsetRects(reg.mStorage.data(), reg.mStorage.size(), dx, dy);
 #if defined(VALIDATE_REGIONS)
         validate(reg, "translate (after)");
 #endif
@@ -16,6 +16,8 @@
 
 #include <math.h>
 
+#include <vector>
+
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>
 #include <ui/Region.h>
@@ -49,6 +51,10 @@ bool Transform::absIsOne(float f) {
     return isZero(fabs(f) - 1.0f);
 }
 
+bool Transform::isAxisAligned(uint32_t type) {
+    return !(type & UNKNOWN_TYPE) && !(type & ((ROT_90 | ROT_INVALID) << 8));
+}
+
 bool Transform::operator==(const Transform& other) const {
     return mMatrix[0][0] == other.mMatrix[0][0] && mMatrix[0][1] == other.mMatrix[0][1] &&
             mMatrix[0][2] == other.mMatrix[0][2] && mMatrix[1][0] == other.mMatrix[1][0] &&
@@ -67,7 +73,27 @@ Transform Transform::operator * (const Transform& rhs) const
     if (rhs.mType == IDENTITY)
         return r;
 
-    // TODO: we could use mType to optimize the matrix multiply
+    if (mType <= TRANSLATE && rhs.mType <= TRANSLATE) {
+        // Composing two translations only adds the offsets, and the result
+        // type is known without going through type().
+        r.set(tx() + rhs.tx(), ty() + rhs.ty());
+        return r;
+    }
+
+    if (isAxisAligned(mType) && isAxisAligned(rhs.mType)) {
+        // Neither side rotates or skews, so only the diagonal and the
+        // translation of the product are non-zero.
+        const mat33& A(mMatrix);
+        const mat33& B(rhs.mMatrix);
+              mat33& D(r.mMatrix);
+        D[0][0] = A[0][0]*B[0][0];
+        D[1][1] = A[1][1]*B[1][1];
+        D[2][0] = A[0][0]*B[2][0] + A[2][0];
+        D[2][1] = A[1][1]*B[2][1] + A[2][1];
+        r.mType = UNKNOWN_TYPE;
+        return r;
+    }
+
     const mat33& A(mMatrix);
     const mat33& B(rhs.mMatrix);
           mat33& D(r.mMatrix);
@@ -216,27 +242,19 @@ Rect Transform::makeBounds(int w, int h) const
 
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
 {
-    Rect r;
-    vec2 lt( bounds.left,  bounds.top    );
-    vec2 rt( bounds.right, bounds.top    );
-    vec2 lb( bounds.left,  bounds.bottom );
-    vec2 rb( bounds.right, bounds.bottom );
-
-    lt = transform(lt);
-    rt = transform(rt);
-    lb = transform(lb);
-    rb = transform(rb);
+    const FloatRect f = transform(bounds.toFloatRect());
 
+    Rect r;
     if (roundOutwards) {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]})));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]})));
-        r.right  = static_cast<int32_t>(ceilf(std::max({lt[0], rt[0], lb[0], rb[0]})));
-        r.bottom = static_cast<int32_t>(ceilf(std::max({lt[1], rt[1], lb[1], rb[1]})));
+        r.left   = static_cast<int32_t>(floorf(f.left));
+        r.top    = static_cast<int32_t>(floorf(f.top));
+        r.right  = static_cast<int32_t>(ceilf(f.right));
+        r.bottom = static_cast<int32_t>(ceilf(f.bottom));
     } else {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
-        r.right  = static_cast<int32_t>(floorf(std::max({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.bottom = static_cast<int32_t>(floorf(std::max({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
+        r.left   = static_cast<int32_t>(floorf(f.left + 0.5f));
+        r.top    = static_cast<int32_t>(floorf(f.top + 0.5f));
+        r.right  = static_cast<int32_t>(floorf(f.right + 0.5f));
+        r.bottom = static_cast<int32_t>(floorf(f.bottom + 0.5f));
     }
 
     return r;
@@ -244,6 +262,28 @@ Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
 
 FloatRect Transform::transform(const FloatRect& bounds) const
 {
+    const uint32_t type = this->type();
+    const mat33& M(mMatrix);
+
+    if (type <= TRANSLATE) {
+        // Edges keep their order, only the offset changes.
+        const float x = M[2][0];
+        const float y = M[2][1];
+        return {std::min(bounds.left + x, bounds.right + x),
+                std::min(bounds.top + y, bounds.bottom + y),
+                std::max(bounds.left + x, bounds.right + x),
+                std::max(bounds.top + y, bounds.bottom + y)};
+    }
+
+    if (isAxisAligned(type)) {
+        // x only depends on x and y only on y; a flip swaps the edges.
+        const float l = M[0][0]*bounds.left   + M[2][0];
+        const float r = M[0][0]*bounds.right  + M[2][0];
+        const float t = M[1][1]*bounds.top    + M[2][1];
+        const float b = M[1][1]*bounds.bottom + M[2][1];
+        return {std::min(l, r), std::min(t, b), std::max(l, r), std::max(t, b)};
+    }
+
     vec2 lt(bounds.left, bounds.top);
     vec2 rt(bounds.right, bounds.top);
     vec2 lb(bounds.left, bounds.bottom);
@@ -263,15 +303,75 @@ FloatRect Transform::transform(const FloatRect& bounds) const
     return r;
 }
 
+void Transform::transform(const Rect* src, Rect* dst, size_t count, bool roundOutwards) const
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = transform(src[i], roundOutwards);
+    }
+}
+
+void Transform::transform(const vec2* src, vec2* dst, size_t count) const
+{
+    const uint32_t type = this->type();
+    const mat33& M(mMatrix);
+
+    if (type <= TRANSLATE) {
+        const vec2 t(M[2][0], M[2][1]);
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = src[i] + t;
+        }
+    } else if (isAxisAligned(type)) {
+        const vec2 s(M[0][0], M[1][1]);
+        const vec2 t(M[2][0], M[2][1]);
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = src[i] * s + t;
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = transform(src[i]);
+        }
+    }
+}
+
 Region Transform::transform(const Region& reg) const
 {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
+            size_t count;
+            const Rect* rects = reg.getArray(&count);
+            if (count <= 4) {
+                for (size_t i = 0; i < count; i++) {
+                    out.orSelf(transform(rects[i]));
+                }
+                return out;
+            }
+
+            std::vector<Rect> transformed(count);
+            transform(rects, transformed.data(), count);
+
+            // Union the transformed rects pairwise rather than one at a time
+            // into a single region, which would rasterize a growing output
+            // once per rect.
+            std::vector<Region> parts;
+            parts.reserve(count);
+            for (const Rect& rect : transformed) {
+                if (!rect.isEmpty()) {
+                    parts.emplace_back(rect);
+                }
+            }
+            while (parts.size() > 1) {
+                size_t n = 0;
+                for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+                    parts[n++] = parts[i].merge(parts[i + 1]);
+                }
+                if (parts.size() % 2) {
+                    parts[n++] = parts.back();
+                }
+                parts.resize(n);
+            }
+            if (!parts.empty()) {
+                out = parts.front();
             }
         } else {
             out.set(transform(reg.bounds()));
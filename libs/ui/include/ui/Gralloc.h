@@ -74,6 +74,24 @@ public:
     // owned by the caller
     virtual int unlock(buffer_handle_t bufferHandle) const = 0;
 
+    // flushLockedBuffer writes the CPU caches of a locked buffer back to memory,
+    // so that other devices see what the CPU wrote without unlocking the
+    // buffer. *outFenceFd is set to a fence sync object (or -1) owned by the
+    // caller. Not supported before gralloc 4.0, in which case a status_t of
+    // INVALID_OPERATION is returned.
+    virtual status_t flushLockedBuffer(buffer_handle_t /*bufferHandle*/,
+                                       int* /*outFenceFd*/) const {
+        return INVALID_OPERATION;
+    }
+
+    // rereadLockedBuffer invalidates the CPU caches of a locked buffer, so that
+    // the CPU sees what other devices wrote without locking the buffer again.
+    // Not supported before gralloc 4.0, in which case a status_t of
+    // INVALID_OPERATION is returned.
+    virtual status_t rereadLockedBuffer(buffer_handle_t /*bufferHandle*/) const {
+        return INVALID_OPERATION;
+    }
+
     // isSupported queries whether or not a buffer with the given width, height,
     // format, layer count, and usage can be allocated on the device.  If
     // *outSupported is set to true, a buffer with the given specifications may be successfully
@@ -17,6 +17,7 @@
 #ifndef ANDROID_UI_GRALLOC4_H
 #define ANDROID_UI_GRALLOC4_H
 
+#include <android-base/thread_annotations.h>
 #include <android/hardware/graphics/allocator/4.0/IAllocator.h>
 #include <android/hardware/graphics/common/1.1/types.h>
 #include <android/hardware/graphics/mapper/4.0/IMapper.h>
@@ -26,7 +27,9 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace android {
 
@@ -64,6 +67,10 @@ public:
 
     int unlock(buffer_handle_t bufferHandle) const override;
 
+    status_t flushLockedBuffer(buffer_handle_t bufferHandle, int* outFenceFd) const override;
+
+    status_t rereadLockedBuffer(buffer_handle_t bufferHandle) const override;
+
     status_t isSupported(uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount,
                          uint64_t usage, bool* outSupported) const override;
 
@@ -181,7 +188,19 @@ private:
             const android::hardware::graphics::mapper::V4_0::IMapper::BufferDump& bufferDump,
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
+    // Whether metadataType is fixed when the buffer is allocated, so that it can be cached.
+    static bool isImmutableMetadataType(
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType);
+
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+
+    // Encoded values of immutable standard metadata, per imported buffer and metadata type.
+    // Mutable metadata, e.g. the dataspace, can be set through another process's mapper, so
+    // it is always fetched from IMapper.
+    using MetadataCache = std::unordered_map<int64_t, hardware::hidl_vec<uint8_t>>;
+    mutable std::mutex mMetadataCacheMutex;
+    mutable std::unordered_map<buffer_handle_t, MetadataCache> mMetadataCache
+            GUARDED_BY(mMetadataCacheMutex);
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
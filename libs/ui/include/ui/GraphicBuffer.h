@@ -250,6 +250,7 @@ private:
                             uint32_t inLayerCount, uint64_t inUsage, uint32_t inStride);
 
     void free_handle();
+    void freeAllocatedHandle();
 
     GraphicBufferMapper& mBufferMapper;
     ssize_t mInitCheck;
@@ -265,6 +266,10 @@ private:
     // IGBP::setGenerationNumber), attempts to attach the buffer will fail.
     uint32_t mGenerationNumber;
 
+    // Set once the buffer has been flattened, e.g. to be sent to another process. Such a buffer
+    // may still be in use elsewhere when it is freed here, so it must not be recycled.
+    mutable bool mShared = false;
+
     // Send a callback when a GraphicBuffer dies.
     //
     // This is used for BufferStateLayer caching. GraphicBuffers are refcounted per process. When
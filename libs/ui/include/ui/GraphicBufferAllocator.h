@@ -20,17 +20,22 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
 #include <ui/PixelFormat.h>
 
+#include <utils/Condition.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -72,6 +77,26 @@ public:
 
     status_t free(buffer_handle_t handle);
 
+    /**
+     * Frees a buffer allocated with allocate(), or keeps it in the buffer pool so that a later
+     * allocate() with the same parameters returns it without calling into the allocator HAL.
+     *
+     * The caller must not use the handle after this call, and the buffer must not be in use by
+     * any other process or HAL. Protected and composer buffers are always freed.
+     */
+    status_t recycle(buffer_handle_t handle);
+
+    /**
+     * Sets how many bytes of recycled buffers the pool may hold. The default is 0, which
+     * disables the pool. Reducing the capacity frees the oldest pooled buffers.
+     */
+    void setPoolCapacity(size_t bytes);
+
+    /**
+     * Frees every buffer held in the pool, e.g. when memory is low.
+     */
+    void trimPool();
+
     uint64_t getTotalSize() const;
 
     void dump(std::string& res, bool less = true) const;
@@ -93,9 +118,40 @@ protected:
                             uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
                             std::string requestorName, bool importBuffer);
 
+    struct pool_entry_t {
+        buffer_handle_t handle;
+        nsecs_t recycleTime;
+    };
+
+    // Pooled buffers that have not been reused for this long are freed, by the next pool
+    // operation or by the eviction thread, whichever comes first.
+    static constexpr nsecs_t kPoolEntryMaxAge = s2ns(2);
+
+    bool takeFromPoolLocked(uint32_t width, uint32_t height, PixelFormat format,
+                            uint32_t layerCount, uint64_t usage, buffer_handle_t* handle,
+                            uint32_t* stride, std::string& requestorName);
+    // Removes the pool entries that are too old, or that exceed |capacity|, and returns their
+    // handles. The caller frees them once sLock is released.
+    std::vector<buffer_handle_t> evictFromPoolLocked(nsecs_t now, size_t capacity);
+    void freeHandles(const std::vector<buffer_handle_t>& handles);
+    // Body of mPoolEvictionThread. Frees pool entries as they age out, so that an idle process
+    // does not hold on to them until its next allocation.
+    void poolEvictionLoop();
+
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
 
+    // Recycled buffers, oldest first. Their records stay in sAllocList. Guarded by sLock.
+    std::deque<pool_entry_t> mPool;
+    size_t mPoolSize = 0;
+    size_t mPoolCapacity = 0;
+
+    // Started by the first recycle(); signaled through mPoolCondition when the pool gains an
+    // entry or the allocator is destroyed. Guarded by sLock.
+    std::thread mPoolEvictionThread;
+    Condition mPoolCondition;
+    bool mPoolEvictionThreadExit = false;
+
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
     ~GraphicBufferAllocator();
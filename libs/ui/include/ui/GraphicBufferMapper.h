@@ -86,6 +86,10 @@ public:
 
     status_t unlockAsync(buffer_handle_t handle, int *fenceFd);
 
+    // Cache maintenance of a buffer that stays locked, see GrallocMapper.
+    status_t flushLockedBuffer(buffer_handle_t handle, int* outFenceFd);
+    status_t rereadLockedBuffer(buffer_handle_t handle);
+
     status_t isSupported(uint32_t width, uint32_t height, android::PixelFormat format,
                          uint32_t layerCount, uint64_t usage, bool* outSupported);
 
@@ -167,6 +167,14 @@ private:
 
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Region& rhs);
+
+    // fast path for operations on two single-rect regions, returns false if
+    // the result needs the general boolean_operation()
+    static bool rect_operation(uint32_t op, Region& dst, Rect lhs, Rect rhs);
+    // early out for operations whose operands do not overlap, returns false
+    // if the result needs the general boolean_operation()
+    static bool bounds_operation(uint32_t op, Region& dst, const Region& lhs,
+            const Rect& rhsBounds);
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
 
@@ -85,6 +85,10 @@ public:
     Rect    transform(const Rect& bounds,
                       bool roundOutwards = false) const;
     FloatRect transform(const FloatRect& bounds) const;
+    // batch versions, dst may alias src
+    void    transform(const Rect* src, Rect* dst, size_t count,
+                      bool roundOutwards = false) const;
+    void    transform(const vec2* src, vec2* dst, size_t count) const;
     Transform& operator = (const Transform& other);
     Transform operator * (const Transform& rhs) const;
     // assumes the last row is < 0 , 0 , 1 >
@@ -114,6 +118,7 @@ private:
     uint32_t type() const;
     static bool absIsOne(float f);
     static bool isZero(float f);
+    static bool isAxisAligned(uint32_t type);
 
     mat33               mMatrix;
     mutable uint32_t    mType;
@@ -113,4 +113,25 @@ TEST_F(GraphicBufferAllocatorTest, AllocateLargeStride) {
     ASSERT_EQ(NO_ERROR, err);
     ASSERT_EQ(expectedStride, stride);
 }
+
+TEST_F(GraphicBufferAllocatorTest, RecycledBufferIsReused) {
+    mAllocator.setPoolCapacity(kTestWidth * kTestHeight * 4);
+    mAllocator.setUpAllocateExpectations(NO_ERROR, kTestWidth);
+    android::PixelFormat format = PIXEL_FORMAT_RGBA_8888;
+    uint32_t stride = 0;
+    buffer_handle_t handle = reinterpret_cast<buffer_handle_t>(0x1000);
+    status_t err = mAllocator.allocate(kTestWidth, kTestHeight, format, kTestLayerCount, kTestUsage,
+                                       &handle, &stride, 0, "GraphicBufferAllocatorTest");
+    ASSERT_EQ(NO_ERROR, err);
+    ASSERT_EQ(NO_ERROR, mAllocator.recycle(handle));
+
+    // The second allocation must not reach the allocator HAL.
+    buffer_handle_t reusedHandle = nullptr;
+    uint32_t reusedStride = 0;
+    err = mAllocator.allocate(kTestWidth, kTestHeight, format, kTestLayerCount, kTestUsage,
+                              &reusedHandle, &reusedStride, 0, "GraphicBufferAllocatorTest");
+    ASSERT_EQ(NO_ERROR, err);
+    EXPECT_EQ(handle, reusedHandle);
+    EXPECT_EQ(kTestWidth, reusedStride);
+}
 } // namespace android
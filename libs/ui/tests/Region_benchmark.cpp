@@ -0,0 +1,155 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+namespace android {
+namespace {
+
+// A region made of |count| horizontal bands, similar to what transparent
+// region hints and rounded corner clipping produce.
+Region makeBandedRegion(int count) {
+    Region region;
+    for (int i = 0; i < count; i++) {
+        region.orSelf(Rect(i * 4, i * 20, 1000 - i * 4, i * 20 + 10));
+    }
+    return region;
+}
+
+// Single rect operands. These are the common case in the composition
+// pipeline and do not need the rasterizer.
+void BM_RectOrSelfContained(benchmark::State& state) {
+    for (auto _ : state) {
+        Region region(Rect(0, 0, 1080, 1920));
+        region.orSelf(Rect(100, 100, 500, 500));
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RectOrSelfContained);
+
+void BM_RectOrSelfOverlapping(benchmark::State& state) {
+    for (auto _ : state) {
+        Region region(Rect(0, 0, 600, 600));
+        region.orSelf(Rect(300, 300, 900, 900));
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RectOrSelfOverlapping);
+
+void BM_RectAndSelf(benchmark::State& state) {
+    const Region rhs(Rect(300, 300, 900, 900));
+    for (auto _ : state) {
+        Region region(Rect(0, 0, 600, 600));
+        region.andSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RectAndSelf);
+
+void BM_RectSubtractSelfCovered(benchmark::State& state) {
+    const Region rhs(Rect(0, 0, 1080, 1920));
+    for (auto _ : state) {
+        Region region(Rect(100, 100, 500, 500));
+        region.subtractSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RectSubtractSelfCovered);
+
+void BM_RectSubtractSelfOverlapping(benchmark::State& state) {
+    const Region rhs(Rect(300, 300, 900, 900));
+    for (auto _ : state) {
+        Region region(Rect(0, 0, 600, 600));
+        region.subtractSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RectSubtractSelfOverlapping);
+
+// Multi-rect operands, which always go through the rasterizer.
+void BM_RegionOrSelf(benchmark::State& state) {
+    const Region lhs = makeBandedRegion(state.range(0));
+    const Region rhs = makeBandedRegion(state.range(0)).translate(2, 5);
+    for (auto _ : state) {
+        Region region(lhs);
+        region.orSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionOrSelf)->Arg(2)->Arg(8)->Arg(32);
+
+void BM_RegionAndSelf(benchmark::State& state) {
+    const Region lhs = makeBandedRegion(state.range(0));
+    const Region rhs = makeBandedRegion(state.range(0)).translate(2, 5);
+    for (auto _ : state) {
+        Region region(lhs);
+        region.andSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionAndSelf)->Arg(2)->Arg(8)->Arg(32);
+
+void BM_RegionSubtractSelf(benchmark::State& state) {
+    const Region lhs = makeBandedRegion(state.range(0));
+    const Region rhs = makeBandedRegion(state.range(0)).translate(2, 5);
+    for (auto _ : state) {
+        Region region(lhs);
+        region.subtractSelf(rhs);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionSubtractSelf)->Arg(2)->Arg(8)->Arg(32);
+
+void BM_RegionCopy(benchmark::State& state) {
+    const Region source = makeBandedRegion(state.range(0));
+    for (auto _ : state) {
+        Region copy(source);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_RegionCopy)->Arg(1)->Arg(2)->Arg(8)->Arg(32);
+
+// Transforming a multi-rect region, as done for visible and damage regions
+// of scaled or rotated layers.
+void BM_RegionTransformScale(benchmark::State& state) {
+    const Region source = makeBandedRegion(state.range(0));
+    ui::Transform transform;
+    transform.set(1.5f, 0, 0, 1.5f);
+    for (auto _ : state) {
+        Region region = transform.transform(source);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionTransformScale)->Arg(2)->Arg(8)->Arg(32);
+
+void BM_RegionTransformRotate(benchmark::State& state) {
+    const Region source = makeBandedRegion(state.range(0));
+    const ui::Transform transform(ui::Transform::ROT_90, 1080, 1920);
+    for (auto _ : state) {
+        Region region = transform.transform(source);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionTransformRotate)->Arg(2)->Arg(8)->Arg(32);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
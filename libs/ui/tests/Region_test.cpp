@@ -167,5 +167,77 @@ TEST_F(RegionTest, EqualsToSelf) {
     ASSERT_TRUE(touchableRegion.contains(50, 50));
 }
 
+TEST_F(RegionTest, SingleRectOperations) {
+    const Rect a(10, 10, 50, 50);
+
+    // Contained, overlapping, touching and disjoint rects
+    const Rect others[] = {Rect(20, 20, 30, 30), Rect(0, 0, 60, 60), Rect(30, 30, 70, 70),
+                           Rect(50, 10, 90, 50), Rect(100, 100, 120, 120), Rect(10, 10, 50, 50)};
+
+    const auto inRect = [](const Rect& r, int x, int y) {
+        return x >= r.left && x < r.right && y >= r.top && y < r.bottom;
+    };
+
+    for (const Rect& b : others) {
+        const Region lhs(a);
+        const Region rhs(b);
+        const Region merged = lhs.merge(rhs);
+        const Region intersected = lhs.intersect(rhs);
+        const Region subtracted = lhs.subtract(rhs);
+
+        Region mergedSelf(a);
+        mergedSelf.orSelf(b);
+        Region intersectedSelf(a);
+        intersectedSelf.andSelf(rhs);
+        Region subtractedSelf(a);
+        subtractedSelf.subtractSelf(b);
+
+        for (int y = 0; y < 130; y += 5) {
+            for (int x = 0; x < 130; x += 5) {
+                const bool inA = inRect(a, x, y);
+                const bool inB = inRect(b, x, y);
+                EXPECT_EQ(inA || inB, merged.contains(x, y));
+                EXPECT_EQ(inA || inB, mergedSelf.contains(x, y));
+                EXPECT_EQ(inA && inB, intersected.contains(x, y));
+                EXPECT_EQ(inA && inB, intersectedSelf.contains(x, y));
+                EXPECT_EQ(inA && !inB, subtracted.contains(x, y));
+                EXPECT_EQ(inA && !inB, subtractedSelf.contains(x, y));
+            }
+        }
+    }
+
+    // Empty results are canonical empty regions
+    EXPECT_TRUE(Region(a).intersect(Rect(100, 100, 120, 120)).isEmpty());
+    EXPECT_TRUE(Region(a).subtract(Rect(0, 0, 60, 60)).isEmpty());
+    EXPECT_TRUE(Region(a).subtract(Rect(0, 0, 60, 60)).hasSameRects(Region()));
+}
+
+TEST_F(RegionTest, MultiRectOperations) {
+    Region lhs;
+    lhs.orSelf(Rect(0, 0, 100, 10));
+    lhs.orSelf(Rect(20, 10, 80, 20));
+    lhs.orSelf(Rect(0, 20, 100, 30));
+    ASSERT_FALSE(lhs.isRect());
+
+    // Disjoint operands
+    Region disjoint;
+    disjoint.orSelf(Rect(200, 0, 300, 10));
+    disjoint.orSelf(Rect(220, 10, 280, 20));
+    EXPECT_TRUE(lhs.intersect(disjoint).isEmpty());
+    EXPECT_TRUE(lhs.subtract(disjoint).hasSameRects(lhs));
+    EXPECT_TRUE(lhs.subtract(disjoint, -200, 100).hasSameRects(lhs));
+
+    // Translating keeps the shape
+    const Region moved = lhs.translate(7, -3);
+    EXPECT_EQ(Rect(7, -3, 107, 27), moved.getBounds());
+    EXPECT_TRUE(moved.translate(-7, 3).hasSameRects(lhs));
+
+    // Filling the notch merges all spans back into a single rect
+    Region filled(lhs);
+    filled.orSelf(Rect(0, 10, 100, 20));
+    EXPECT_TRUE(filled.isRect());
+    EXPECT_EQ(Rect(0, 0, 100, 30), filled.getBounds());
+}
+
 }; // namespace android
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransformTest"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace ui {
+namespace {
+
+// Maps the four corners through the general matrix path.
+FloatRect referenceTransform(const Transform& t, const FloatRect& bounds) {
+    const vec2 lt = t.transform(vec2(bounds.left, bounds.top));
+    const vec2 rt = t.transform(vec2(bounds.right, bounds.top));
+    const vec2 lb = t.transform(vec2(bounds.left, bounds.bottom));
+    const vec2 rb = t.transform(vec2(bounds.right, bounds.bottom));
+    return {std::min({lt.x, rt.x, lb.x, rb.x}), std::min({lt.y, rt.y, lb.y, rb.y}),
+            std::max({lt.x, rt.x, lb.x, rb.x}), std::max({lt.y, rt.y, lb.y, rb.y})};
+}
+
+Transform makeTransform(float a, float b, float c, float d, float x, float y) {
+    Transform t;
+    t.set(a, b, c, d);
+    t.set(x, y);
+    return t;
+}
+
+std::vector<Transform> makeTransforms() {
+    return {
+            Transform(),
+            makeTransform(1, 0, 0, 1, 10, -20),
+            makeTransform(2, 0, 0, 0.5f, 3.25f, 7),
+            makeTransform(-1, 0, 0, 1, 1080, 0),
+            makeTransform(1.5f, 0, 0, -2, 0, 1920),
+            Transform(Transform::ROT_90, 1080, 1920),
+            Transform(Transform::ROT_270, 1080, 1920),
+            makeTransform(0.7f, -0.7f, 0.7f, 0.7f, 5, 5),
+    };
+}
+
+Region makeBandedRegion() {
+    Region region;
+    for (int i = 0; i < 16; i++) {
+        region.orSelf(Rect(i * 4, i * 20, 200 - i * 4, i * 20 + 10));
+        region.orSelf(Rect(300 + i, i * 20 + 5, 400, i * 20 + 15));
+    }
+    return region;
+}
+
+} // namespace
+
+TEST(TransformTest, FloatRectMatchesGeneralPath) {
+    const FloatRect bounds(-3.5f, 4.f, 120.25f, 300.f);
+    for (const Transform& t : makeTransforms()) {
+        const FloatRect expected = referenceTransform(t, bounds);
+        const FloatRect actual = t.transform(bounds);
+        EXPECT_EQ(expected.left, actual.left);
+        EXPECT_EQ(expected.top, actual.top);
+        EXPECT_EQ(expected.right, actual.right);
+        EXPECT_EQ(expected.bottom, actual.bottom);
+    }
+}
+
+TEST(TransformTest, RectBatchMatchesSingle) {
+    const Rect rects[] = {Rect(0, 0, 10, 10), Rect(-5, 7, 100, 33), Rect(20, 20, 20, 40)};
+    constexpr size_t count = sizeof(rects) / sizeof(rects[0]);
+    for (const Transform& t : makeTransforms()) {
+        for (bool roundOutwards : {false, true}) {
+            Rect out[count];
+            t.transform(rects, out, count, roundOutwards);
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(t.transform(rects[i], roundOutwards), out[i]);
+            }
+        }
+    }
+}
+
+TEST(TransformTest, PointBatchMatchesSingle) {
+    const vec2 points[] = {{0, 0}, {1.5f, -2}, {1080, 1920}, {-7, 3.25f}};
+    constexpr size_t count = sizeof(points) / sizeof(points[0]);
+    for (const Transform& t : makeTransforms()) {
+        vec2 out[count];
+        t.transform(points, out, count);
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(t.transform(points[i]), out[i]);
+        }
+    }
+}
+
+TEST(TransformTest, RegionMatchesPerRectUnion) {
+    const Region region = makeBandedRegion();
+    for (const Transform& t : makeTransforms()) {
+        if (!t.preserveRects()) {
+            continue;
+        }
+        Region expected;
+        for (const Rect& rect : region) {
+            expected.orSelf(t.transform(rect));
+        }
+        const Region actual = t.transform(region);
+        EXPECT_TRUE(expected.subtract(actual).isEmpty());
+        EXPECT_TRUE(actual.subtract(expected).isEmpty());
+    }
+}
+
+TEST(TransformTest, ComposedTypeMatchesRecomputed) {
+    const std::vector<Transform> transforms = makeTransforms();
+    for (const Transform& lhs : transforms) {
+        for (const Transform& rhs : transforms) {
+            const Transform product = lhs * rhs;
+            Transform reference;
+            reference.set(product[0][0], product[1][0], product[0][1], product[1][1]);
+            reference.set(product.tx(), product.ty());
+            EXPECT_EQ(reference.getType(), product.getType());
+            EXPECT_EQ(reference.getOrientation(), product.getOrientation());
+
+            const vec2 p(13, -29);
+            const vec2 expected = lhs.transform(rhs.transform(p));
+            const vec2 actual = product.transform(p);
+            EXPECT_NEAR(expected.x, actual.x, 1e-3f);
+            EXPECT_NEAR(expected.y, actual.y, 1e-3f);
+        }
+    }
+}
+
+} // namespace ui
+} // namespace android
@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+
+#include "libbroadcastring/broadcast_ring.h"
+#include "libbroadcastring/multi_producer_broadcast_ring.h"
+
+namespace android {
+namespace dvr {
+namespace {
+
+// Roughly the size of a pose sample.
+struct alignas(8) Sample {
+  uint64_t timestamp_ns;
+  float orientation[4];
+  float position[3];
+  float angular_velocity[3];
+  float velocity[3];
+  uint32_t flags;
+};
+
+constexpr uint32_t kRecordCount = 64;
+
+template <typename Ring>
+class RingBenchmark : public ::benchmark::Fixture {
+ public:
+  void SetUp(const ::benchmark::State& state) override {
+    if (state.thread_index == 0) {
+      size_t size = Ring::MemorySize(kRecordCount);
+      data_.reset(new char[size]);
+      ring_ = Ring::Create(data_.get(), size, kRecordCount);
+    }
+  }
+
+  void TearDown(const ::benchmark::State& state) override {
+    if (state.thread_index == 0) {
+      ring_ = Ring();
+      data_.reset();
+    }
+  }
+
+ protected:
+  Ring ring_;
+  std::mutex mutex_;
+
+ private:
+  std::unique_ptr<char[]> data_;
+};
+
+using SingleProducerBenchmark = RingBenchmark<BroadcastRing<Sample>>;
+using MultiProducerBenchmark = RingBenchmark<MultiProducerBroadcastRing<Sample>>;
+
+// The single writer ring shared between threads under a lock.
+BENCHMARK_DEFINE_F(SingleProducerBenchmark, LockedPut)
+(::benchmark::State& state) {
+  Sample sample = {};
+  while (state.KeepRunning()) {
+    sample.timestamp_ns++;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_.Put(sample);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(SingleProducerBenchmark, LockedPut)
+    ->ThreadRange(1, 4)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(MultiProducerBenchmark, Put)(::benchmark::State& state) {
+  Sample sample = {};
+  while (state.KeepRunning()) {
+    sample.timestamp_ns++;
+    ring_.Put(sample);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(MultiProducerBenchmark, Put)
+    ->ThreadRange(1, 4)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace dvr
+}  // namespace android
+
+BENCHMARK_MAIN();
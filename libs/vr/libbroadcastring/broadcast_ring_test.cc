@@ -1,8 +1,10 @@
 #include "libbroadcastring/broadcast_ring.h"
+#include "libbroadcastring/multi_producer_broadcast_ring.h"
 
 #include <stdlib.h>
 #include <memory>
 #include <thread>  // NOLINT
+#include <vector>
 #include <sys/mman.h>
 
 #include <gtest/gtest.h>
@@ -862,5 +864,181 @@ TEST(BroadcastRingTest, ThreadedOverwriteTortureLarge) {
   ThreadedOverwriteTorture<Dynamic_256_NxM_1plus0::Ring>();
 }
 
+namespace {
+
+struct alignas(8) ProducerRecord {
+  uint32_t producer;
+  uint32_t index;
+  uint64_t check;
+
+  ProducerRecord() : producer(0), index(0), check(0) {}
+  ProducerRecord(uint32_t producer, uint32_t index)
+      : producer(producer), index(index), check(Check(producer, index)) {}
+  static uint64_t Check(uint32_t producer, uint32_t index) {
+    return ~((static_cast<uint64_t>(producer) << 32) | index);
+  }
+  bool IsConsistent() const { return check == Check(producer, index); }
+};
+
+using MultiProducerRing = MultiProducerBroadcastRing<Sized<16>>;
+using MultiProducerRing8 = MultiProducerBroadcastRing<Sized<8>>;
+using MultiProducerRecordRing = MultiProducerBroadcastRing<ProducerRecord>;
+
+}  // namespace
+
+TEST(MultiProducerBroadcastRingTest, PutGet) {
+  using Ring = MultiProducerRing;
+  using Record = Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, 4);
+  const uint32_t next_sequence_at_start = ring.GetNextSequence();
+  {
+    uint32_t sequence = ring.GetOldestSequence();
+    Record record;
+    EXPECT_FALSE(ring.Get(&sequence, &record));
+    EXPECT_EQ(next_sequence_at_start, sequence);
+  }
+
+  for (uint32_t i = 0; i < 3; ++i) ring.Put(Record(FillChar(i)));
+
+  uint32_t sequence = ring.GetOldestSequence();
+  EXPECT_EQ(next_sequence_at_start, sequence);
+  for (uint32_t i = 0; i < 3; ++i) {
+    Record record;
+    EXPECT_TRUE(ring.Get(&sequence, &record));
+    EXPECT_EQ(next_sequence_at_start + i, sequence);
+    EXPECT_EQ(Record(FillChar(i)), record);
+    sequence++;
+  }
+  Record record;
+  EXPECT_FALSE(ring.Get(&sequence, &record));
+  EXPECT_EQ(ring.GetNextSequence(), sequence);
+}
+
+TEST(MultiProducerBroadcastRingTest, Overwrite) {
+  using Ring = MultiProducerRing;
+  using Record = Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, 4);
+  const uint32_t next_sequence_at_start = ring.GetNextSequence();
+  for (uint32_t i = 0; i < 10; ++i) ring.Put(Record(FillChar(i)));
+
+  EXPECT_EQ(next_sequence_at_start + 6, ring.GetOldestSequence());
+  EXPECT_EQ(next_sequence_at_start + 9, ring.GetNewestSequence());
+
+  {
+    uint32_t sequence = next_sequence_at_start;
+    Record record;
+    EXPECT_TRUE(ring.Get(&sequence, &record));
+    EXPECT_EQ(next_sequence_at_start + 6, sequence);
+    EXPECT_EQ(Record(FillChar(6)), record);
+  }
+
+  {
+    uint32_t sequence = next_sequence_at_start;
+    Record record;
+    EXPECT_TRUE(ring.GetNewest(&sequence, &record));
+    EXPECT_EQ(next_sequence_at_start + 9, sequence);
+    EXPECT_EQ(Record(FillChar(9)), record);
+    sequence++;
+    EXPECT_FALSE(ring.GetNewest(&sequence, &record));
+  }
+}
+
+TEST(MultiProducerBroadcastRingTest, ShouldImportIfDynamicSizeShrinks) {
+  using OriginalRing = MultiProducerRing;
+  using ImportedRing = MultiProducerRing8;
+  using OriginalRecord = OriginalRing::Record;
+  using ImportedRecord = ImportedRing::Record;
+
+  OriginalRing original_ring;
+  auto mmap = CreateRing(&original_ring, 4);
+  const uint32_t sequence_0 = original_ring.GetNextSequence();
+  const OriginalRecord record_0 = OriginalRecord::Pattern(0x00);
+  const OriginalRecord record_1 = OriginalRecord::Pattern(0x80);
+  original_ring.Put(record_0);
+  original_ring.Put(record_1);
+
+  ImportedRing imported_ring;
+  bool import_ok;
+  std::tie(imported_ring, import_ok) =
+      ImportedRing::Import(mmap.mmap(), mmap.size);
+  ASSERT_TRUE(import_ok);
+  EXPECT_EQ(original_ring.record_size(), imported_ring.record_size());
+  EXPECT_EQ(original_ring.record_count(), imported_ring.record_count());
+
+  uint32_t sequence = sequence_0;
+  ImportedRecord record;
+  EXPECT_TRUE(imported_ring.Get(&sequence, &record));
+  EXPECT_EQ(record_0.Truncate<ImportedRecord>(), record);
+  sequence++;
+  EXPECT_TRUE(imported_ring.Get(&sequence, &record));
+  EXPECT_EQ(record_1.Truncate<ImportedRecord>(), record);
+
+  {
+    using GrownRing = MultiProducerBroadcastRing<Sized<32>>;
+    GrownRing grown_ring;
+    std::tie(grown_ring, import_ok) = GrownRing::Import(mmap.mmap(), mmap.size);
+    EXPECT_FALSE(import_ok);
+  }
+  std::tie(imported_ring, import_ok) =
+      ImportedRing::Import(mmap.mmap(), mmap.size - 1);
+  EXPECT_FALSE(import_ok);
+}
+
+template <typename Ring>
+void ThreadedMultiProducer(uint32_t record_count, uint32_t producer_count) {
+  using Record = typename Ring::Record;
+  Ring ring;
+  auto mmap = CreateRing(&ring, record_count);
+
+  constexpr uint32_t kRecordsPerProducer = 10000;
+  std::atomic<uint32_t> finished(0);
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < producer_count; ++producer) {
+    producers.emplace_back([&ring, &finished, producer]() {
+      for (uint32_t i = 0; i < kRecordsPerProducer; ++i)
+        ring.Put(Record(producer, i));
+      std::atomic_fetch_add_explicit(&finished, 1U, std::memory_order_release);
+    });
+  }
+
+  // Records of each producer must come out consistent and in order.
+  std::vector<uint32_t> next_index(producer_count, 0);
+  uint32_t records_read = 0;
+  uint32_t sequence = ring.GetOldestSequence();
+  for (;;) {
+    bool done = std::atomic_load_explicit(&finished,
+                                          std::memory_order_acquire) ==
+                producer_count;
+    Record record;
+    if (ring.Get(&sequence, &record)) {
+      ASSERT_TRUE(record.IsConsistent());
+      ASSERT_LT(record.producer, producer_count);
+      ASSERT_LE(next_index[record.producer], record.index);
+      next_index[record.producer] = record.index + 1;
+      records_read++;
+      sequence++;
+    } else if (done) {
+      break;
+    }
+  }
+
+  for (auto& producer : producers) producer.join();
+  EXPECT_EQ(ring.record_count(),
+            ring.GetNextSequence() - ring.GetOldestSequence());
+  EXPECT_LT(0U, records_read);
+  EXPECT_GE(producer_count * kRecordsPerProducer, records_read);
+}
+
+TEST(MultiProducerBroadcastRingTest, ThreadedTwoProducers) {
+  ThreadedMultiProducer<MultiProducerRecordRing>(1024, 2);
+}
+
+TEST(MultiProducerBroadcastRingTest, ThreadedOverwriteTorture) {
+  for (uint32_t count = 1; count <= 4; count *= 2)
+    ThreadedMultiProducer<MultiProducerRecordRing>(count, 4);
+}
+
 } // namespace dvr
 } // namespace android
@@ -0,0 +1,499 @@
+#ifndef ANDROID_DVR_MULTI_PRODUCER_BROADCAST_RING_H_
+#define ANDROID_DVR_MULTI_PRODUCER_BROADCAST_RING_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <tuple>
+#include <type_traits>
+
+#include "android-base/logging.h"
+#include "libbroadcastring/broadcast_ring.h"
+
+namespace android {
+namespace dvr {
+
+// Nonblocking ring suitable for concurrent multi-writer, multi-reader access.
+//
+// This is the multi-writer counterpart of BroadcastRing: Put() may be called
+// concurrently from any number of threads or processes that have write access
+// to the mmap area, without external locking. Like BroadcastRing this is a
+// nondeterministically lossy transport; readers never block writers, and
+// writers never block each other.
+//
+// Writers claim a sequence number with a single atomic increment of the ring
+// tail and then fill the slot for that sequence. Every slot carries its own
+// pair of sequence numbers, which act as a per-slot seqlock:
+//
+//   |claimed|   is advanced by a writer before it modifies the slot.
+//   |published| is set to the same value once the record is complete.
+//
+// Records become visible per slot, so a record may be readable before an
+// older record claimed by a slower writer. Get() waits for such a pending
+// record (returns false) rather than skipping it, so that readers see all
+// records in sequence order as long as they keep up.
+//
+// A writer that laps a slot while an older writer is still filling it drops
+// its record instead of waiting; readers wait on a dropped sequence number
+// until it leaves the window. This can only happen if the whole ring is
+// written during one Put(), so size the ring with generous room for the number
+// of concurrent writers.
+//
+// Readers may have a read-only mapping; each reader's state is a single local
+// sequence number. Inconsistent data can only be returned if at least 2^32
+// records are written during the read-side critical section. As with
+// BroadcastRing, neither readers nor writers access memory outside of the mmap
+// area passed in during initialization, even if the header is corrupted.
+//
+// The record size in the ring header is used to index the ring when dynamic
+// record size is enabled, so the record type may be compatibly extended.
+//
+// Usage is the same as for BroadcastRing, see broadcast_ring.h. Each writer
+// thread may share one ring instance or import its own.
+template <typename RecordType, typename BaseTraits = DefaultRingTraits>
+class MultiProducerBroadcastRing {
+ public:
+  using Record = RecordType;
+  struct Traits : public BaseTraits {
+    // There is no fixed reservation for writers; they claim slots in turn.
+    static constexpr int kMinRecordCount = BaseTraits::kMinAvailableRecords;
+
+    // Count of zero means dynamic, non-zero means static.
+    static constexpr bool kUseStaticRecordCount =
+        (BaseTraits::kStaticRecordCount != 0);
+  };
+
+  static constexpr bool IsPowerOfTwo(uint32_t size) {
+    return (size & (size - 1)) == 0;
+  }
+
+  // Sanity check the options provided in Traits.
+  static_assert(Traits::kMinRecordCount >= 1, "Min record count too small");
+  static_assert(!Traits::kUseStaticRecordCount ||
+                    Traits::kStaticRecordCount >= Traits::kMinRecordCount,
+                "Static record count is too small");
+  static_assert(!Traits::kStaticRecordCount ||
+                    IsPowerOfTwo(Traits::kStaticRecordCount),
+                "Static record count is not a power of two");
+  static_assert(std::is_standard_layout<Record>::value,
+                "Record type must be standard layout");
+
+  MultiProducerBroadcastRing() {}
+
+  // Creates a new ring at |mmap| with |record_count| records.
+  //
+  // There must be at least |MemorySize(record_count)| bytes of space already
+  // allocated at |mmap|. The ring does not take ownership.
+  static MultiProducerBroadcastRing Create(void* mmap, size_t mmap_size,
+                                           uint32_t record_count) {
+    MultiProducerBroadcastRing ring(mmap);
+    CHECK(ring.ValidateGeometry(mmap_size, sizeof(Record), record_count));
+    ring.InitializeMmap(sizeof(Record), record_count);
+    return ring;
+  }
+
+  // Creates a new ring at |mmap|.
+  //
+  // There must be at least |MemorySize()| bytes of space already allocated at
+  // |mmap|. The ring does not take ownership.
+  static MultiProducerBroadcastRing Create(void* mmap, size_t mmap_size) {
+    return Create(mmap, mmap_size,
+                  Traits::kUseStaticRecordCount
+                      ? Traits::kStaticRecordCount
+                      : MultiProducerBroadcastRing::GetRecordCount(mmap_size));
+  }
+
+  // Imports an existing ring at |mmap|.
+  //
+  // Import may fail if the ring parameters in the mmap header are not sensible.
+  // In this case the returned boolean is false; make sure to check this value.
+  static std::tuple<MultiProducerBroadcastRing, bool> Import(void* mmap,
+                                                             size_t mmap_size) {
+    MultiProducerBroadcastRing ring(mmap);
+    uint32_t record_size = 0;
+    uint32_t record_count = 0;
+    if (mmap_size >= sizeof(Header)) {
+      record_size = std::atomic_load_explicit(&ring.header_mmap()->record_size,
+                                              std::memory_order_relaxed);
+      record_count = std::atomic_load_explicit(
+          &ring.header_mmap()->record_count, std::memory_order_relaxed);
+    }
+    bool ok = ring.ValidateGeometry(mmap_size, record_size, record_count);
+    return std::make_tuple(ring, ok);
+  }
+
+  ~MultiProducerBroadcastRing() {}
+
+  // Calculates the space necessary for a ring of size |record_count|.
+  //
+  // Use this function for dynamically sized rings.
+  static constexpr size_t MemorySize(uint32_t record_count) {
+    return sizeof(Header) + sizeof(Slot) * record_count;
+  }
+
+  // Calculates the space necessary for a statically sized ring.
+  //
+  // Use this function for statically sized rings.
+  static constexpr size_t MemorySize() {
+    static_assert(
+        Traits::kUseStaticRecordCount,
+        "Wrong MemorySize() function called for dynamic record count");
+    return MemorySize(Traits::kStaticRecordCount);
+  }
+
+  static uint32_t NextPowerOf2(uint32_t n) {
+    return BroadcastRing<Record, BaseTraits>::NextPowerOf2(n);
+  }
+
+  // Gets the biggest power of 2 record count that can fit into this mmap.
+  //
+  // The header size has been taken into account.
+  static uint32_t GetRecordCount(size_t mmap_size) {
+    if (mmap_size <= sizeof(Header)) {
+      return 0;
+    }
+    uint32_t count =
+        static_cast<uint32_t>((mmap_size - sizeof(Header)) / sizeof(Slot));
+    return IsPowerOfTwo(count) ? count : (NextPowerOf2(count) / 2);
+  }
+
+  // Writes a record to the ring.
+  //
+  // Safe to call concurrently with other Put() and Get() calls. The oldest
+  // record is overwritten unless the ring is not already full.
+  //
+  // This function synchronizes with Get() in the same way as Reserve() and
+  // Publish() do for BroadcastRing, except per slot:
+  //
+  //    (1) Release Fence between the update of |claimed| & record access
+  //
+  //        Pairs with the acquire fence in Get(), so that a reader that loads
+  //        any part of this record also sees our |claimed| update and discards
+  //        the older record it was reading.
+  //
+  //    (2) Store-Release of |published|
+  //
+  //        Pairs with the load-acquire in Get(), so that the stores to the
+  //        record happen-before the loads of a reader that sees the sequence.
+  void Put(const Record& record) {
+    uint32_t sequence = std::atomic_fetch_add_explicit(
+        &header_mmap()->tail, 1U, std::memory_order_relaxed);
+    Slot* slot = slot_mmap_writer(SequenceToIndex(sequence, record_count()));
+
+    uint32_t claimed =
+        std::atomic_load_explicit(&slot->claimed, std::memory_order_relaxed);
+    do {
+      uint32_t published = std::atomic_load_explicit(
+          &slot->published, std::memory_order_relaxed);
+      if (claimed != published)
+        return;  // Lapped a slower writer; drop this record.
+      if (!IsNewer(sequence, claimed))
+        return;  // A newer record was already written here.
+    } while (!std::atomic_compare_exchange_weak_explicit(
+        &slot->claimed, &claimed, sequence, std::memory_order_relaxed,
+        std::memory_order_relaxed));
+
+    // NB: It is not sufficient to change the exchange above to a release.
+    std::atomic_thread_fence(std::memory_order_release);
+
+    PutRecordInternal(&record, &slot->record);
+
+    std::atomic_store_explicit(&slot->published, sequence,
+                               std::memory_order_release);
+  }
+
+  // Gets sequence number of the oldest record that may be available.
+  uint32_t GetOldestSequence() const {
+    return GetOldestSequence(GetNextSequence());
+  }
+
+  // Gets sequence number of the first future record.
+  //
+  // Records with lower sequence numbers may still be pending while their
+  // writers fill them.
+  uint32_t GetNextSequence() const {
+    return std::atomic_load_explicit(&header_mmap()->tail,
+                                     std::memory_order_relaxed);
+  }
+
+  // Gets sequence number of the newest record that may be available.
+  uint32_t GetNewestSequence() const { return GetNextSequence() - 1; }
+
+  // Copies the oldest available record with sequence at least |*sequence| to
+  // |record|.
+  //
+  // Returns false if there is no recent enough record available, or if the
+  // next record in sequence is still being written.
+  //
+  // Updates |*sequence| with the sequence number of the record returned. To get
+  // the following record, increment this number by one.
+  bool Get(uint32_t* sequence /*inout*/, Record* record /*out*/) const {
+    for (;; ++*sequence) {
+      uint32_t tail = GetNextSequence();
+      uint32_t oldest = GetOldestSequence(tail);
+
+      if (*sequence - oldest > tail - oldest)
+        *sequence = oldest;  // Out of window, skip forward to first available.
+
+      if (*sequence == tail) return false;  // No new records available.
+
+      const Slot* slot =
+          slot_mmap_reader(SequenceToIndex(*sequence, record_count()));
+
+      uint32_t published = std::atomic_load_explicit(
+          &slot->published, std::memory_order_acquire);
+      if (published != *sequence) {
+        if (IsNewer(published, *sequence)) continue;  // Overwritten; skip.
+        uint32_t claimed = std::atomic_load_explicit(
+            &slot->claimed, std::memory_order_relaxed);
+        if (IsNewer(claimed, *sequence)) continue;  // Being overwritten; skip.
+        return false;  // Not written yet.
+      }
+
+      GetRecordInternal(&slot->record, record);
+
+      // NB: It is not sufficient to change this to a load-acquire of |claimed|.
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      uint32_t claimed =
+          std::atomic_load_explicit(&slot->claimed, std::memory_order_relaxed);
+      if (claimed != *sequence) continue;  // Overwritten while reading; skip.
+
+      return true;
+    }
+  }
+
+  // Copies the newest available record with sequence at least |*sequence| to
+  // |record|.
+  //
+  // Returns false if there is no recent enough record available.
+  //
+  // Updates |*sequence| with the sequence number of the record returned. To get
+  // the following record, increment this number by one.
+  bool GetNewest(uint32_t* sequence, Record* record) const {
+    uint32_t tail = GetNextSequence();
+    uint32_t oldest = GetOldestSequence(tail);
+    if (*sequence - oldest > tail - oldest) *sequence = oldest;
+
+    // Walk back past records that are still pending.
+    for (uint32_t newest = tail; newest != *sequence;) {
+      uint32_t candidate = --newest;
+      if (Get(&candidate, record) && candidate == newest) {
+        *sequence = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns true if this instance has been created or imported.
+  bool is_valid() const { return !!mmap_; }
+
+  uint32_t record_count() const { return record_count_; }
+  uint32_t record_size() const { return record_size_; }
+  static constexpr uint32_t mmap_alignment() { return alignof(Mmap); }
+
+ private:
+  struct Header {
+    // Record size for reading out of the ring. Writers always write the full
+    // length; readers may need to read a prefix of each record.
+    std::atomic<uint32_t> record_size;
+
+    // Number of records in the ring.
+    std::atomic<uint32_t> record_count;
+
+    // Sequence number of the next record to be claimed by a writer.
+    std::atomic<uint32_t> tail;
+
+    // Sequence number of the first record written to the ring. Slots for
+    // earlier sequences were never populated.
+    //
+    // This also keeps the slots 8 byte aligned on 32 and 64 bit builds.
+    std::atomic<uint32_t> start;
+  };
+
+  // Store using the standard word size.
+  using StorageType = long;  // NOLINT
+
+  // Always require 8 byte alignment so that the same record sizes are legal on
+  // 32 and 64 bit builds.
+  static constexpr size_t kRecordAlignment = 8;
+  static_assert(kRecordAlignment % sizeof(StorageType) == 0,
+                "Bad record alignment");
+
+  struct RecordStorage {
+    // This is accessed with relaxed atomics to prevent data races on the
+    // contained data, which would be undefined behavior.
+    std::atomic<StorageType> data[sizeof(Record) / sizeof(StorageType)];
+  };
+
+  static_assert(sizeof(StorageType) *
+                        std::extent<decltype(RecordStorage::data)>() ==
+                    sizeof(Record),
+                "Record length must be a multiple of sizeof(StorageType)");
+
+  struct Slot {
+    // Sequence number of the last writer that started to update this slot.
+    std::atomic<uint32_t> claimed;
+
+    // Sequence number of the record stored in this slot. The slot is being
+    // updated while this differs from |claimed|.
+    std::atomic<uint32_t> published;
+
+    // Readers must use record_size() rather than sizeof(Record) to find the
+    // next slot when dynamic record sizes are used.
+    RecordStorage record;
+  };
+
+  // Mmap area layout.
+  //
+  // Readers should not index directly into |slots| as this is not valid when
+  // dynamic record sizes are used; use slot_mmap_reader() instead.
+  struct Mmap {
+    Header header;
+    Slot slots[];
+  };
+
+  static_assert(std::is_standard_layout<Mmap>::value,
+                "Mmap must be standard layout");
+  static_assert(sizeof(Header) % kRecordAlignment == 0,
+                "Header must keep the slots aligned");
+  static_assert(offsetof(Slot, record) % kRecordAlignment == 0,
+                "Slot must keep the record aligned");
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "Lockless atomics contain extra state");
+  static_assert(sizeof(std::atomic<StorageType>) == sizeof(StorageType),
+                "Lockless atomics contain extra state");
+
+  explicit MultiProducerBroadcastRing(void* mmap) {
+    CHECK_EQ(0U, reinterpret_cast<uintptr_t>(mmap) % alignof(Mmap));
+    mmap_ = reinterpret_cast<Mmap*>(mmap);
+  }
+
+  // Returns true if sequence |a| was claimed after sequence |b|.
+  static bool IsNewer(uint32_t a, uint32_t b) {
+    return a != b && a - b < (1U << 31);
+  }
+
+  // Initializes the mmap area header and slots for a new ring.
+  void InitializeMmap(uint32_t record_size, uint32_t record_count) {
+    constexpr uint32_t kInitialSequence = -256;  // Force an early wrap.
+    std::atomic_store_explicit(&header_mmap()->record_size, record_size,
+                               std::memory_order_relaxed);
+    std::atomic_store_explicit(&header_mmap()->record_count, record_count,
+                               std::memory_order_relaxed);
+    std::atomic_store_explicit(&header_mmap()->tail, kInitialSequence,
+                               std::memory_order_relaxed);
+    std::atomic_store_explicit(&header_mmap()->start, kInitialSequence,
+                               std::memory_order_relaxed);
+
+    // Stamp each slot with a sequence from before the start, which is older
+    // than any sequence a writer will claim.
+    for (uint32_t index = 0; index < record_count; ++index) {
+      uint32_t stamp = kInitialSequence + index - record_count;
+      Slot* slot = slot_mmap_writer(index);
+      std::atomic_store_explicit(&slot->claimed, stamp,
+                                 std::memory_order_relaxed);
+      std::atomic_store_explicit(&slot->published, stamp,
+                                 std::memory_order_relaxed);
+    }
+  }
+
+  // Validates ring geometry.
+  //
+  // Ring geometry is validated carefully on import and then cached. This allows
+  // us to avoid out-of-range accesses even if the parameters in the header are
+  // later changed.
+  bool ValidateGeometry(size_t mmap_size, uint32_t header_record_size,
+                        uint32_t header_record_count) {
+    record_size_ = header_record_size;
+    record_count_ = header_record_count;
+
+    if (Traits::kUseStaticRecordSize && record_size() != sizeof(Record))
+      return false;
+    if (Traits::kUseStaticRecordCount &&
+        record_count() != Traits::kStaticRecordCount)
+      return false;
+    if (record_count() < Traits::kMinRecordCount) return false;
+    if (record_size() < sizeof(Record)) return false;
+    if (record_size() % kRecordAlignment != 0) return false;
+    if (!IsPowerOfTwo(record_count())) return false;
+
+    size_t slot_size = offsetof(Slot, record) + size_t{record_size()};
+    size_t memory_size = record_count() * slot_size;
+    if (memory_size / slot_size != record_count()) return false;
+    if (memory_size + sizeof(Header) < memory_size) return false;
+    if (memory_size + sizeof(Header) > mmap_size) return false;
+
+    return true;
+  }
+
+  // Copies a record into the ring.
+  //
+  // This is done with relaxed atomics because otherwise it is racy according to
+  // the C++ memory model. This is very low overhead once optimized.
+  static inline void PutRecordInternal(const Record* in, RecordStorage* out) {
+    StorageType data[sizeof(Record) / sizeof(StorageType)];
+    memcpy(data, in, sizeof(*in));
+    for (size_t i = 0; i < std::extent<decltype(data)>(); ++i) {
+      std::atomic_store_explicit(&out->data[i], data[i],
+                                 std::memory_order_relaxed);
+    }
+  }
+
+  // Copies a record out of the ring.
+  //
+  // This is done with relaxed atomics because otherwise it is racy according to
+  // the C++ memory model. This is very low overhead once optimized.
+  static inline void GetRecordInternal(const RecordStorage* in, Record* out) {
+    StorageType data[sizeof(Record) / sizeof(StorageType)];
+    for (size_t i = 0; i < std::extent<decltype(data)>(); ++i) {
+      data[i] =
+          std::atomic_load_explicit(&in->data[i], std::memory_order_relaxed);
+    }
+    memcpy(out, &data, sizeof(*out));
+  }
+
+  // Gets the oldest sequence number in the window ending at |tail|.
+  uint32_t GetOldestSequence(uint32_t tail) const {
+    uint32_t start = std::atomic_load_explicit(&header_mmap()->start,
+                                               std::memory_order_relaxed);
+    return tail - start < record_count() ? start : tail - record_count();
+  }
+
+  // Converts a record's sequence number into a storage index.
+  static uint32_t SequenceToIndex(uint32_t sequence, uint32_t record_count) {
+    return sequence & (record_count - 1);
+  }
+
+  // Helpers to compute addresses in mmap area.
+  Header* header_mmap() const { return &mmap_->header; }
+  Slot* slot_mmap_writer(uint32_t index) const {
+    DCHECK_EQ(sizeof(Record), record_size());
+    return &mmap_->slots[index];
+  }
+  const Slot* slot_mmap_reader(uint32_t index) const {
+    if (Traits::kUseStaticRecordSize) {
+      return &mmap_->slots[index];
+    } else {
+      // Calculate the location of a slot in the ring without assuming that
+      // sizeof(Record) == record_size.
+      size_t slot_size = offsetof(Slot, record) + record_size();
+      return reinterpret_cast<const Slot*>(
+          reinterpret_cast<const char*>(mmap_->slots) + index * slot_size);
+    }
+  }
+
+  Mmap* mmap_ = nullptr;
+
+  // These are cached to make sure misbehaving writers cannot cause
+  // out-of-bounds memory accesses by updating the values in the mmap header.
+  uint32_t record_size_ = 0;
+  uint32_t record_count_ = 0;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_MULTI_PRODUCER_BROADCAST_RING_H_
@@ -5,14 +5,20 @@
 #include <binder/IServiceManager.h>
 #include <dvr/dvr_api.h>
 #include <gui/BufferItem.h>
+#include <gui/BLASTBufferQueue.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
 #include <private/dvr/epoll_file_descriptor.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -20,6 +26,7 @@
 #include <poll.h>
 #include <sys/epoll.h>
 #include <sys/wait.h>
+#include <time.h>
 
 // Use ALWAYS at the tag level. Control is performed manually during command
 // line processing.
@@ -32,55 +39,132 @@ using namespace android;
 using ::benchmark::State;
 
 static const String16 kBinderService = String16("bufferTransport");
-static const uint32_t kBufferWidth = 100;
-static const uint32_t kBufferHeight = 1;
-static const uint32_t kBufferFormat = HAL_PIXEL_FORMAT_BLOB;
+static const uint32_t kBufferFormat = HAL_PIXEL_FORMAT_RGBA_8888;
 static const uint64_t kBufferUsage =
     GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN;
 static const uint32_t kBufferLayer = 1;
 static const int kMaxAcquiredImages = 1;
-static const int kQueueDepth = 2;  // We are double buffering for this test.
 static const size_t kMaxQueueCounts = 128;
 static const int kInvalidFence = -1;
 
 enum BufferTransportServiceCode {
   CREATE_BUFFER_QUEUE = IBinder::FIRST_CALL_TRANSACTION,
+  TAKE_CONSUMER_LATENCIES,
 };
 
-// A binder services that minics a compositor that consumes buffers. It provides
-// one Binder interface to create a new Surface for buffer producer to write
-// into; while itself will carry out no-op buffer consuming by acquiring then
-// releasing the buffer immediately.
-class BufferTransportService : public BBinder {
+// Parameters of a benchmark run, shared by all transport backends.
+struct TransportConfig {
+  // Buffers are square RGBA_8888 buffers of this width and height.
+  uint32_t buffer_size = 64;
+
+  // Number of buffers in each queue.
+  int buffer_count = 2;
+
+  // Time the consumer holds on to each buffer it acquires, which mimics the
+  // time a compositor takes to compose it.
+  int64_t consumer_latency_us = 0;
+};
+
+// Queue timestamps are taken from CLOCK_MONOTONIC, as is steady_clock.
+static int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static double CpuTimeUs(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Returns the |percentile| of |samples|, reordering |samples| in the process.
+template <typename T>
+static double Percentile(std::vector<T>* samples, double percentile) {
+  if (samples->empty()) {
+    return 0;
+  }
+  size_t index = std::min(samples->size() - 1,
+                          static_cast<size_t>(samples->size() * percentile));
+  std::nth_element(samples->begin(), samples->begin() + index, samples->end());
+  return (*samples)[index];
+}
+
+// Collects the delay between a buffer being queued and acquired, which may be
+// recorded by a consumer in either process.
+class LatencyRecorder {
  public:
-  BufferTransportService() = default;
-  ~BufferTransportService() = default;
+  void Record(int64_t queue_time_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencies_ns_.push_back(NowNs() - queue_time_ns);
+  }
 
-  virtual status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
-                              uint32_t flags = 0) {
-    (void)flags;
-    (void)data;
-    switch (code) {
-      case CREATE_BUFFER_QUEUE: {
-        auto new_queue = std::make_shared<BufferQueueHolder>(this);
-        reply->writeStrongBinder(
-            IGraphicBufferProducer::asBinder(new_queue->producer));
-        buffer_queues_.push_back(new_queue);
-        return OK;
-      }
-      default:
-        return UNKNOWN_TRANSACTION;
-    };
+  std::vector<int64_t> Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(latencies_ns_);
   }
 
  private:
-  struct FrameListener : public ConsumerBase::FrameAvailableListener {
-   public:
-    FrameListener(BufferTransportService* /*service*/,
-                  sp<BufferItemConsumer> buffer_item_consumer)
-        : buffer_item_consumer_(buffer_item_consumer) {}
+  std::mutex mutex_;
+  std::vector<int64_t> latencies_ns_;
+};
+
+// Consumes the buffers of a BufferQueue on its own thread like a compositor
+// would: each buffer is acquired as soon as it is available and released after
+// the configured consumer latency.
+class BufferQueueConsumer : public ConsumerBase::FrameAvailableListener {
+ public:
+  BufferQueueConsumer(const sp<IGraphicBufferConsumer>& consumer,
+                      const TransportConfig& config, LatencyRecorder* recorder)
+      : latency_(config.consumer_latency_us), recorder_(recorder) {
+    buffer_item_consumer_ =
+        new BufferItemConsumer(consumer, kBufferUsage, kMaxAcquiredImages,
+                               /*controlledByApp=*/true);
+    buffer_item_consumer_->setName(String8("BufferTransportConsumer"));
+    buffer_item_consumer_->setDefaultBufferSize(config.buffer_size,
+                                                config.buffer_size);
+    buffer_item_consumer_->setDefaultBufferFormat(kBufferFormat);
+    thread_ = std::thread([this]() { ConsumeFrames(); });
+  }
+
+  ~BufferQueueConsumer() override { Stop(); }
+
+  // Must be called before the last reference is dropped.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    condition_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  const sp<BufferItemConsumer>& buffer_item_consumer() const {
+    return buffer_item_consumer_;
+  }
+
+  void onFrameAvailable(const BufferItem& /*item*/) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_frames_++;
+    }
+    condition_.notify_one();
+  }
+
+ private:
+  void ConsumeFrames() {
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return stopped_ || pending_frames_; });
+        if (stopped_) {
+          return;
+        }
+        pending_frames_--;
+      }
 
-    void onFrameAvailable(const BufferItem& /*item*/) override {
       BufferItem buffer;
       status_t ret = 0;
       {
@@ -91,7 +175,13 @@ class BufferTransportService : public BBinder {
 
       if (ret != OK) {
         LOG(ERROR) << "Failed to acquire next buffer.";
-        return;
+        continue;
+      }
+      recorder_->Record(buffer.mTimestamp);
+
+      if (latency_.count() > 0) {
+        ATRACE_NAME("ConsumeBuffer");
+        std::this_thread::sleep_for(latency_);
       }
 
       {
@@ -101,33 +191,91 @@ class BufferTransportService : public BBinder {
 
       if (ret != OK) {
         LOG(ERROR) << "Failed to release buffer.";
-        return;
       }
     }
+  }
 
-   private:
-    sp<BufferItemConsumer> buffer_item_consumer_;
-  };
+  const std::chrono::microseconds latency_;
+  LatencyRecorder* recorder_;
+  sp<BufferItemConsumer> buffer_item_consumer_;
 
-  struct BufferQueueHolder {
-    explicit BufferQueueHolder(BufferTransportService* service) {
-      BufferQueue::createBufferQueue(&producer, &consumer);
-
-      sp<BufferItemConsumer> buffer_item_consumer =
-          new BufferItemConsumer(consumer, kBufferUsage, kMaxAcquiredImages,
-                                 /*controlledByApp=*/true);
-      buffer_item_consumer->setName(String8("BinderBufferTransport"));
-      frame_listener_ = new FrameListener(service, buffer_item_consumer);
-      buffer_item_consumer->setFrameAvailableListener(frame_listener_);
-    }
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  int pending_frames_ = 0;
+  bool stopped_ = false;
+  std::thread thread_;
+};
 
-    sp<IGraphicBufferProducer> producer;
-    sp<IGraphicBufferConsumer> consumer;
+// An in-process BufferQueue with a consumer thread.
+struct BufferQueueHolder {
+  BufferQueueHolder(const TransportConfig& config, LatencyRecorder* recorder) {
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    buffer_queue_consumer_ =
+        new BufferQueueConsumer(consumer, config, recorder);
+    buffer_queue_consumer_->buffer_item_consumer()->setFrameAvailableListener(
+        buffer_queue_consumer_);
+  }
 
-   private:
-    sp<FrameListener> frame_listener_;
-  };
+  ~BufferQueueHolder() { buffer_queue_consumer_->Stop(); }
+
+  sp<IGraphicBufferProducer> producer;
+  sp<IGraphicBufferConsumer> consumer;
+
+ private:
+  sp<BufferQueueConsumer> buffer_queue_consumer_;
+};
+
+// Wraps |producer| in a Surface set up for |config|.
+static sp<Surface> CreateBufferQueueSurface(
+    const sp<IGraphicBufferProducer>& producer, const TransportConfig& config) {
+  sp<Surface> surface = new Surface(producer, /*controlledByApp=*/true);
+
+  // Set buffer dimension and count.
+  ANativeWindow* window = static_cast<ANativeWindow*>(surface.get());
+  ANativeWindow_setBuffersGeometry(window, config.buffer_size,
+                                   config.buffer_size, kBufferFormat);
+  int ret = native_window_set_buffer_count(window, config.buffer_count);
+  if (ret != 0) {
+    LOG(ERROR) << "Failed to set buffer count to " << config.buffer_count
+               << ", error: " << ret;
+    return nullptr;
+  }
+  return surface;
+}
+
+// A binder services that minics a compositor that consumes buffers. It provides
+// one Binder interface to create a new Surface for buffer producer to write
+// into, while itself consumes the buffers on a consumer thread per queue; and
+// another to collect the queue to acquire latencies seen by the consumers.
+class BufferTransportService : public BBinder {
+ public:
+  BufferTransportService() = default;
+  ~BufferTransportService() = default;
+
+  virtual status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                              uint32_t flags = 0) {
+    (void)flags;
+    switch (code) {
+      case CREATE_BUFFER_QUEUE: {
+        TransportConfig config;
+        config.buffer_size = data.readUint32();
+        config.buffer_count = data.readInt32();
+        config.consumer_latency_us = data.readInt64();
+        auto new_queue = std::make_shared<BufferQueueHolder>(config, &recorder_);
+        reply->writeStrongBinder(
+            IGraphicBufferProducer::asBinder(new_queue->producer));
+        buffer_queues_.push_back(new_queue);
+        return OK;
+      }
+      case TAKE_CONSUMER_LATENCIES:
+        return reply->writeInt64Vector(recorder_.Take());
+      default:
+        return UNKNOWN_TRANSACTION;
+    };
+  }
 
+ private:
+  LatencyRecorder recorder_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
@@ -136,16 +284,25 @@ class BufferTransportService : public BBinder {
 // transport backends.
 class BufferTransport {
  public:
+  explicit BufferTransport(const TransportConfig& config) : config_(config) {}
   virtual ~BufferTransport() {}
 
   virtual int Start() = 0;
   virtual sp<Surface> CreateSurface() = 0;
+
+  // Returns the queue to acquire latencies recorded by the consumers since the
+  // last call, in nanoseconds. Transports whose consumer is out of our reach
+  // return none.
+  virtual std::vector<int64_t> TakeConsumerLatencies() = 0;
+
+ protected:
+  const TransportConfig config_;
 };
 
 // Binder-based buffer transport backend.
 //
-// On Start() a new process will be swapned to run a Binder server that
-// actually consumes the buffer.
+// The Binder server that actually consumes the buffer runs in the parent
+// process, see runBinderServer().
 // On CreateSurface() a new Binder BufferQueue will be created, which the
 // service holds the concrete binder node of the IGraphicBufferProducer while
 // sending the binder proxy to the client. In another word, the producer side
@@ -153,7 +310,8 @@ class BufferTransport {
 // carried out within the BufferTransportService's own process.
 class BinderBufferTransport : public BufferTransport {
  public:
-  BinderBufferTransport() {}
+  explicit BinderBufferTransport(const TransportConfig& config)
+      : BufferTransport(config) {}
 
   int Start() override {
     sp<IServiceManager> sm = defaultServiceManager();
@@ -170,6 +328,9 @@ class BinderBufferTransport : public BufferTransport {
   sp<Surface> CreateSurface() override {
     Parcel data;
     Parcel reply;
+    data.writeUint32(config_.buffer_size);
+    data.writeInt32(config_.buffer_count);
+    data.writeInt64(config_.consumer_latency_us);
     int error = service_->transact(CREATE_BUFFER_QUEUE, data, &reply);
     if (error != OK) {
       LOG(ERROR) << "Failed to get buffer queue over binder.";
@@ -189,20 +350,117 @@ class BinderBufferTransport : public BufferTransport {
       return nullptr;
     }
 
-    sp<Surface> surface = new Surface(producer, /*controlledByApp=*/true);
-
-    // Set buffer dimension.
-    ANativeWindow* window = static_cast<ANativeWindow*>(surface.get());
-    ANativeWindow_setBuffersGeometry(window, kBufferWidth, kBufferHeight,
-                                     kBufferFormat);
+    return CreateBufferQueueSurface(producer, config_);
+  }
 
-    return surface;
+  std::vector<int64_t> TakeConsumerLatencies() override {
+    Parcel data;
+    Parcel reply;
+    std::vector<int64_t> latencies;
+    int error = service_->transact(TAKE_CONSUMER_LATENCIES, data, &reply);
+    if (error != OK || reply.readInt64Vector(&latencies) != OK) {
+      LOG(ERROR) << "Failed to get consumer latencies over binder.";
+    }
+    return latencies;
   }
 
  private:
   sp<IBinder> service_;
 };
 
+// In-process BufferQueue transport backend.
+//
+// Same as the Binder-based backend, except that the consumer runs in the
+// benchmark process, so that queue operations are plain function calls.
+class LocalBufferTransport : public BufferTransport {
+ public:
+  explicit LocalBufferTransport(const TransportConfig& config)
+      : BufferTransport(config) {}
+
+  int Start() override { return 0; }
+
+  sp<Surface> CreateSurface() override {
+    auto new_queue = std::make_shared<BufferQueueHolder>(config_, &recorder_);
+    buffer_queues_.push_back(new_queue);
+    return CreateBufferQueueSurface(new_queue->producer, config_);
+  }
+
+  std::vector<int64_t> TakeConsumerLatencies() override {
+    return recorder_.Take();
+  }
+
+ private:
+  LatencyRecorder recorder_;
+  std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
+};
+
+// BLASTBufferQueue-based buffer transport backend.
+//
+// Each surface gets its own buffer state layer, which SurfaceFlinger composes
+// onto the internal display. The BLASTBufferQueue adapter consumes buffers in
+// process and hands them to SurfaceFlinger in transactions, so SurfaceFlinger
+// is the actual consumer and the configured consumer latency does not apply.
+class BlastBufferTransport : public BufferTransport {
+ public:
+  explicit BlastBufferTransport(const TransportConfig& config)
+      : BufferTransport(config) {}
+
+  virtual ~BlastBufferTransport() {
+    SurfaceComposerClient::Transaction t;
+    for (const auto& surface_control : surface_controls_) {
+      t.reparent(surface_control, nullptr);
+    }
+    t.apply(/*synchronous=*/true);
+  }
+
+  int Start() override {
+    client_ = new SurfaceComposerClient;
+    if (client_->initCheck() != OK) {
+      LOG(ERROR) << "Failed to connect to SurfaceFlinger.";
+      return -EIO;
+    }
+    display_token_ = SurfaceComposerClient::getInternalDisplayToken();
+    if (display_token_ == nullptr) {
+      LOG(ERROR) << "Failed to get the internal display.";
+      return -ENODEV;
+    }
+    return 0;
+  }
+
+  sp<Surface> CreateSurface() override {
+    sp<SurfaceControl> surface_control = client_->createSurface(
+        String8("BufferTransportBenchmark"), config_.buffer_size,
+        config_.buffer_size, PIXEL_FORMAT_RGBA_8888,
+        ISurfaceComposerClient::eFXSurfaceBufferState, /*parent*/ nullptr);
+    if (surface_control == nullptr) {
+      LOG(ERROR) << "Failed to create surface control.";
+      return nullptr;
+    }
+
+    SurfaceComposerClient::Transaction()
+        .setLayer(surface_control, std::numeric_limits<int32_t>::max())
+        .setFrame(surface_control,
+                  Rect(config_.buffer_size, config_.buffer_size))
+        .show(surface_control)
+        .apply(/*synchronous=*/true);
+
+    sp<BLASTBufferQueue> blast_buffer_queue = new BLASTBufferQueue(
+        surface_control, config_.buffer_size, config_.buffer_size);
+    surface_controls_.push_back(surface_control);
+    blast_buffer_queues_.push_back(blast_buffer_queue);
+    return CreateBufferQueueSurface(
+        blast_buffer_queue->getIGraphicBufferProducer(), config_);
+  }
+
+  std::vector<int64_t> TakeConsumerLatencies() override { return {}; }
+
+ private:
+  sp<SurfaceComposerClient> client_;
+  sp<IBinder> display_token_;
+  std::vector<sp<SurfaceControl>> surface_controls_;
+  std::vector<sp<BLASTBufferQueue>> blast_buffer_queues_;
+};
+
 class DvrApi {
  public:
   DvrApi() {
@@ -229,14 +487,17 @@ class DvrApi {
 //
 // On Start() a new thread will be swapned to run an epoll polling thread which
 // minics the behavior of a compositor. Similar to Binder-based backend, the
-// buffer available handler is also a no-op: Buffer gets acquired and released
-// immediately.
+// buffer available handler acquires the buffer and releases it after the
+// configured consumer latency.
 // On CreateSurface() a pair of dvr::ProducerQueue and dvr::ConsumerQueue will
 // be created. The epoll thread holds on the consumer queue and dequeues buffer
 // from it; while the producer queue will be wrapped in a Surface and returned
 // to test suite.
 class BufferHubTransport : public BufferTransport {
  public:
+  explicit BufferHubTransport(const TransportConfig& config)
+      : BufferTransport(config) {}
+
   virtual ~BufferHubTransport() {
     stopped_.store(true);
     if (reader_thread_.joinable()) {
@@ -291,15 +552,16 @@ class BufferHubTransport : public BufferTransport {
   }
 
   sp<Surface> CreateSurface() override {
-    auto new_queue = std::make_shared<BufferQueueHolder>();
+    auto new_queue = std::make_shared<BufferQueueHolder>(config_, &recorder_);
     if (!new_queue->IsReady()) {
       LOG(ERROR) << "Failed to create BufferHub-based BufferQueue.";
       return nullptr;
     }
 
     // Set buffer dimension.
-    ANativeWindow_setBuffersGeometry(new_queue->GetSurface(), kBufferWidth,
-                                     kBufferHeight, kBufferFormat);
+    ANativeWindow_setBuffersGeometry(new_queue->GetSurface(),
+                                     config_.buffer_size, config_.buffer_size,
+                                     kBufferFormat);
 
     // Use the next position as buffer_queue index.
     uint32_t index = buffer_queues_.size();
@@ -318,13 +580,21 @@ class BufferHubTransport : public BufferTransport {
     return static_cast<Surface*>(new_queue->GetSurface());
   }
 
+  std::vector<int64_t> TakeConsumerLatencies() override {
+    return recorder_.Take();
+  }
+
  private:
   struct BufferQueueHolder {
-    BufferQueueHolder() {
+    BufferQueueHolder(const TransportConfig& config, LatencyRecorder* recorder)
+        : latency_(config.consumer_latency_us), recorder_(recorder) {
       int ret = 0;
+      // The queue capacity is the buffer count, all buffers are allocated
+      // upfront.
       ret = dvr_.Api().WriteBufferQueueCreate(
-          kBufferWidth, kBufferHeight, kBufferFormat, kBufferLayer,
-          kBufferUsage, 0, sizeof(DvrNativeBufferMetadata), &write_queue_);
+          config.buffer_size, config.buffer_size, kBufferFormat, kBufferLayer,
+          kBufferUsage, config.buffer_count, sizeof(DvrNativeBufferMetadata),
+          &write_queue_);
       if (ret < 0) {
         LOG(ERROR) << "Failed to create write buffer queue, ret=" << ret;
         return;
@@ -382,6 +652,12 @@ class BufferHubTransport : public BufferTransport {
         LOG(ERROR) << "Failed to acquire consumer buffer, error: " << ret;
         return;
       }
+      recorder_->Record(metadata.timestamp);
+
+      if (latency_.count() > 0) {
+        ATRACE_NAME("ConsumeBuffer");
+        std::this_thread::sleep_for(latency_);
+      }
 
       if (buffer != nullptr) {
         ATRACE_NAME("ReleaseBuffer");
@@ -394,6 +670,8 @@ class BufferHubTransport : public BufferTransport {
     }
 
    private:
+    const std::chrono::microseconds latency_;
+    LatencyRecorder* recorder_;
     DvrWriteBufferQueue* write_queue_ = nullptr;
     DvrReadBufferQueue* read_queue_ = nullptr;
     ANativeWindow* surface_ = nullptr;
@@ -404,6 +682,7 @@ class BufferHubTransport : public BufferTransport {
   std::thread reader_thread_;
 
   dvr::EpollFileDescriptor epoll_fd_;
+  LatencyRecorder recorder_;
   std::vector<std::shared_ptr<BufferQueueHolder>> buffer_queues_;
 };
 
@@ -412,22 +691,38 @@ DvrApi BufferHubTransport::dvr_ = {};
 enum TransportType {
   kBinderBufferTransport,
   kBufferHubTransport,
+  kLocalBufferTransport,
+  kBlastBufferTransport,
 };
 
-// Main test suite, which supports two transport backend: 1) BinderBufferQueue,
-// 2) BufferHubQueue. The test case drives the producer end of both transport
+// Main test suite, which supports four transport backends: 1) cross-process
+// BinderBufferQueue, 2) BufferHubQueue, 3) in-process BufferQueue and 4)
+// BLASTBufferQueue. The test case drives the producer end of the transport
 // backend by queuing buffers into the buffer queue by using ANativeWindow API.
+//
+// Benchmark arguments are the transport type, the buffer count, the buffer
+// width and height, and the consumer latency in microseconds.
 class BufferTransportBenchmark : public ::benchmark::Fixture {
  public:
   void SetUp(State& state) override {
     if (state.thread_index == 0) {
       const int transport = state.range(0);
+      TransportConfig config;
+      config.buffer_count = state.range(1);
+      config.buffer_size = state.range(2);
+      config.consumer_latency_us = state.range(3);
       switch (transport) {
         case kBinderBufferTransport:
-          transport_.reset(new BinderBufferTransport);
+          transport_.reset(new BinderBufferTransport(config));
           break;
         case kBufferHubTransport:
-          transport_.reset(new BufferHubTransport);
+          transport_.reset(new BufferHubTransport(config));
+          break;
+        case kLocalBufferTransport:
+          transport_.reset(new LocalBufferTransport(config));
+          break;
+        case kBlastBufferTransport:
+          transport_.reset(new BlastBufferTransport(config));
           break;
         default:
           CHECK(false) << "Unknown test case.";
@@ -469,9 +764,11 @@ BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
   ANativeWindow* window = nullptr;
   ANativeWindow_Buffer buffer;
   int32_t error = 0;
-  double total_gain_buffer_us = 0;
-  double total_post_buffer_us = 0;
-  int iterations = 0;
+  std::vector<double> gain_buffer_us;
+  std::vector<double> post_buffer_us;
+  std::vector<double> frame_us;
+  double thread_cpu_start_us = 0;
+  double process_cpu_start_us = 0;
 
   while (state.KeepRunning()) {
     if (window == nullptr) {
@@ -480,15 +777,25 @@ BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
 
       // Lock buffers a couple time from the queue, so that we have the buffer
       // allocated.
-      for (int i = 0; i < kQueueDepth; i++) {
+      for (int i = 0; i < state.range(1); i++) {
         error = ANativeWindow_lock(window, &buffer,
                                    /*inOutDirtyBounds=*/nullptr);
         CHECK_EQ(error, 0);
         error = ANativeWindow_unlockAndPost(window);
         CHECK_EQ(error, 0);
       }
+
+      gain_buffer_us.reserve(state.max_iterations);
+      post_buffer_us.reserve(state.max_iterations);
+      frame_us.reserve(state.max_iterations);
+      if (state.thread_index == 0) {
+        transport_->TakeConsumerLatencies();
+        process_cpu_start_us = CpuTimeUs(CLOCK_PROCESS_CPUTIME_ID);
+      }
+      thread_cpu_start_us = CpuTimeUs(CLOCK_THREAD_CPUTIME_ID);
     }
 
+    double gain_us = 0;
     {
       ATRACE_NAME("GainBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
@@ -496,35 +803,87 @@ BENCHMARK_DEFINE_F(BufferTransportBenchmark, Producers)(State& state) {
                                  /*inOutDirtyBounds=*/nullptr);
       auto t2 = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double, std::micro> delta_us = t2 - t1;
-      total_gain_buffer_us += delta_us.count();
+      gain_us = delta_us.count();
     }
     CHECK_EQ(error, 0);
 
+    double post_us = 0;
     {
       ATRACE_NAME("PostBuffer");
       auto t1 = std::chrono::high_resolution_clock::now();
       error = ANativeWindow_unlockAndPost(window);
       auto t2 = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double, std::micro> delta_us = t2 - t1;
-      total_post_buffer_us += delta_us.count();
+      post_us = delta_us.count();
     }
     CHECK_EQ(error, 0);
 
-    iterations++;
+    gain_buffer_us.push_back(gain_us);
+    post_buffer_us.push_back(post_us);
+    frame_us.push_back(gain_us + post_us);
   }
 
-  state.counters["gain_buffer_us"] = ::benchmark::Counter(
-      total_gain_buffer_us / iterations, ::benchmark::Counter::kAvgThreads);
-  state.counters["post_buffer_us"] = ::benchmark::Counter(
-      total_post_buffer_us / iterations, ::benchmark::Counter::kAvgThreads);
-  state.counters["producer_us"] = ::benchmark::Counter(
-      (total_gain_buffer_us + total_post_buffer_us) / iterations,
-      ::benchmark::Counter::kAvgThreads);
+  const double frames = frame_us.size();
+  const double thread_cpu_us =
+      CpuTimeUs(CLOCK_THREAD_CPUTIME_ID) - thread_cpu_start_us;
+
+  state.counters["gain_buffer_p50_us"] = ::benchmark::Counter(
+      Percentile(&gain_buffer_us, 0.5), ::benchmark::Counter::kAvgThreads);
+  state.counters["post_buffer_p50_us"] = ::benchmark::Counter(
+      Percentile(&post_buffer_us, 0.5), ::benchmark::Counter::kAvgThreads);
+  state.counters["producer_p50_us"] = ::benchmark::Counter(
+      Percentile(&frame_us, 0.5), ::benchmark::Counter::kAvgThreads);
+  state.counters["producer_p90_us"] = ::benchmark::Counter(
+      Percentile(&frame_us, 0.9), ::benchmark::Counter::kAvgThreads);
+  state.counters["producer_p99_us"] = ::benchmark::Counter(
+      Percentile(&frame_us, 0.99), ::benchmark::Counter::kAvgThreads);
+  state.counters["producer_cpu_us"] = ::benchmark::Counter(
+      thread_cpu_us / frames, ::benchmark::Counter::kAvgThreads);
+
+  if (state.thread_index == 0) {
+    // Process CPU time covers all producer threads, as well as the consumer
+    // for in-process transports.
+    const double process_cpu_us =
+        CpuTimeUs(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start_us;
+    state.counters["process_cpu_us"] =
+        process_cpu_us / (frames * state.threads);
+
+    // Queue to acquire latency, over the frames of all threads.
+    std::vector<int64_t> latencies_ns = transport_->TakeConsumerLatencies();
+    if (!latencies_ns.empty()) {
+      state.counters["consumer_p50_us"] =
+          Percentile(&latencies_ns, 0.5) / 1000;
+      state.counters["consumer_p90_us"] =
+          Percentile(&latencies_ns, 0.9) / 1000;
+      state.counters["consumer_p99_us"] =
+          Percentile(&latencies_ns, 0.99) / 1000;
+    }
+  }
+}
+
+// Runs every transport with double and triple buffering, small and display
+// sized buffers, and an idle as well as a busy consumer. The consumer latency
+// is not under our control for BLAST, where SurfaceFlinger is the consumer.
+static void TransportArguments(::benchmark::internal::Benchmark* benchmark) {
+  for (int transport : {kBinderBufferTransport, kBufferHubTransport,
+                        kLocalBufferTransport, kBlastBufferTransport}) {
+    for (int buffer_count : {2, 3}) {
+      for (int buffer_size : {64, 1024}) {
+        for (int consumer_latency_us : {0, 4000}) {
+          if (transport == kBlastBufferTransport && consumer_latency_us != 0) {
+            continue;
+          }
+          benchmark->Args(
+              {transport, buffer_count, buffer_size, consumer_latency_us});
+        }
+      }
+    }
+  }
 }
 
 BENCHMARK_REGISTER_F(BufferTransportBenchmark, Producers)
     ->Unit(::benchmark::kMicrosecond)
-    ->Ranges({{kBinderBufferTransport, kBufferHubTransport}})
+    ->Apply(TransportArguments)
     ->ThreadRange(1, 32);
 
 static void runBinderServer() {
@@ -548,13 +907,18 @@ static void runBinderServer() {
   LOG(INFO) << "Service Exiting...";
 }
 
+// Benchmarks are named by their arguments:
+// BufferTransportBenchmark/Producers/<transport>/<buffer count>/<buffer size>/
+//   <consumer latency us>, where transport is 0 for cross-process binder
+// BufferQueue, 1 for BufferHub, 2 for in-process BufferQueue and 3 for BLAST.
+//
 // To run binder-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/0/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/0/"
 //
 // To run bufferhub-based benchmark, use:
 // adb shell buffer_transport_benchmark \
-//   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/1/"
+//   --benchmark_filter="BufferTransportBenchmark/Producers/1/"
 int main(int argc, char** argv) {
   bool tracing_enabled = false;
 
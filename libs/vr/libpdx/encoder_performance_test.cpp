@@ -11,6 +11,7 @@
 #include <pdx/rpc/argument_encoder.h>
 #include <pdx/rpc/message_buffer.h>
 #include <pdx/rpc/payload.h>
+#include <pdx/rpc/serializable.h>
 #include <pdx/utility.h>
 
 using namespace android::pdx::rpc;
@@ -26,6 +27,19 @@ namespace {
 
 constexpr size_t kMaxStaticBufferSize = 20480;
 
+// Trivially copyable type using the fixed layout encoding, to compare with the
+// element by element encoding of vector<int32_t>.
+struct FixedLayoutPoint {
+  int32_t x;
+  int32_t y;
+
+  bool operator==(const FixedLayoutPoint& other) const {
+    return x == other.x && y == other.y;
+  }
+
+  PDX_SERIALIZABLE_FIXED_LAYOUT(FixedLayoutPoint);
+};
+
 // Provide numpunct facet that formats numbers with ',' as thousands separators.
 class CommaNumPunct : public std::numpunct<char> {
  protected:
@@ -447,6 +461,12 @@ int main(int /*argc*/, char** /*argv*/) {
                         std::move(int_vector));
   }
 
+  for (size_t len : {0, 1, 8, 64, 256}) {
+    std::vector<FixedLayoutPoint> point_vector(len);
+    test_runner.AddTest(GenerateContainerName("vector<FixedLayoutPoint>", len),
+                        std::move(point_vector));
+  }
+
   std::vector<std::string> vector_of_strings = {
       "012345678901234567890123456789", "012345678901234567890123456789",
       "012345678901234567890123456789", "012345678901234567890123456789",
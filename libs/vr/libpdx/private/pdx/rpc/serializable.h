@@ -143,6 +143,25 @@ class SerializableTraits {
   using SerializableMembers = ::android::pdx::rpc::SerializableMembersType< \
       type, PDX_MEMBERS(type, __VA_ARGS__)>
 
+// Opts a trivially copyable type into the fixed layout encoding and befriends
+// HasFixedLayout for the class. Values of the type, and std::vector, std::array
+// and ArrayWrapper of them, are copied to and from the message as a single BIN
+// blob instead of being encoded member by member, which avoids the per-element
+// overhead of large arrays. The layout of the type is the protocol, so it must
+// be identical in clients and services; prefer fixed-width members. A type
+// uses either this macro or PDX_SERIALIZABLE_MEMBERS(...), not both.
+//
+// Example usage:
+//     struct Vertex {
+//       float x;
+//       float y;
+//       PDX_SERIALIZABLE_FIXED_LAYOUT(Vertex);
+//     };
+#define PDX_SERIALIZABLE_FIXED_LAYOUT(type)          \
+  template <typename, typename>                      \
+  friend struct ::android::pdx::rpc::HasFixedLayout; \
+  using SerializableFixedLayout = type
+
 }  // namespace rpc
 }  // namespace pdx
 }  // namespace android
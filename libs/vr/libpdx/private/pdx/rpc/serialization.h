@@ -59,6 +59,10 @@ namespace rpc {
 //   * BufferWrapper of any POD type.
 //   * StringWrapper of any supported char type.
 //   * User types with correctly defined SerializableMembers member type.
+//   * Trivially copyable user types with a SerializableFixedLayout member
+//     type. These, and std::vector, std::array and ArrayWrapper of them, are
+//     encoded as a single BIN blob of their object representation instead of
+//     element by element.
 //
 // Planned support for:
 //   * std::basic_string with all supported char types.
@@ -111,6 +115,25 @@ template <typename T, typename ReturnType = void>
 using EnableIfEnum =
     typename std::enable_if<std::is_enum<T>::value, ReturnType>::type;
 
+// Determines whether type T opted into the fixed layout encoding by defining a
+// member type named SerializableFixedLayout. Such types are copied to and from
+// the message as-is, so they must be trivially copyable and have the same
+// layout in the client and the service.
+template <typename, typename = void>
+struct HasFixedLayout : std::false_type {};
+template <typename T>
+struct HasFixedLayout<
+    T, TrySerializableMembersType<typename T::SerializableFixedLayout>>
+    : std::true_type {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Types with a fixed layout must be trivially copyable.");
+};
+
+// Utility to simplify overload enable expressions for fixed layout types.
+template <typename T, typename ReturnType = void>
+using EnableIfHasFixedLayout =
+    typename std::enable_if<HasFixedLayout<T>::value, ReturnType>::type;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Error Reporting //
 ///////////////////////////////////////////////////////////////////////////////
@@ -245,6 +268,13 @@ inline EnableIfEnum<T, std::size_t> GetSerializedSize(T v) {
   return GetSerializedSize(static_cast<std::underlying_type_t<T>>(v));
 }
 
+// Overload for fixed layout types, which are encoded as a BIN blob.
+template <typename T>
+inline constexpr EnableIfHasFixedLayout<T, std::size_t> GetSerializedSize(
+    const T& /*value*/) {
+  return GetEncodingSize(EncodeBinType(sizeof(T))) + sizeof(T);
+}
+
 // Forward declaration for nested definitions.
 inline std::size_t GetSerializedSize(const EmptyVariant&);
 template <typename... Types>
@@ -343,14 +373,29 @@ inline constexpr std::size_t GetSerializedSize(
   return GetEncodingSize(EncodeType(channel_handle)) + sizeof(std::int32_t);
 }
 
-// Overload for standard vector types.
-template <typename T, typename Allocator>
-inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+// Gets the serialized size of array types. Arrays of fixed layout types are
+// encoded as a single BIN blob of all the elements.
+template <typename ArrayType>
+inline std::size_t GetArraySerializedSize(const ArrayType& v,
+                                          std::false_type /*fixed_layout*/) {
+  using T = typename ArrayType::value_type;
   return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
                          [](const std::size_t& sum, const T& object) {
                            return sum + GetSerializedSize(object);
                          });
 }
+template <typename ArrayType>
+inline std::size_t GetArraySerializedSize(const ArrayType& v,
+                                          std::true_type /*fixed_layout*/) {
+  const std::size_t size = v.size() * sizeof(typename ArrayType::value_type);
+  return GetEncodingSize(EncodeBinType(size)) + size;
+}
+
+// Overload for standard vector types.
+template <typename T, typename Allocator>
+inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+  return GetArraySerializedSize(v, HasFixedLayout<T>{});
+}
 
 // Overload for standard map types.
 template <typename Key, typename T, typename Compare, typename Allocator>
@@ -380,19 +425,13 @@ inline std::size_t GetSerializedSize(
 // Overload for ArrayWrapper types.
 template <typename T>
 inline std::size_t GetSerializedSize(const ArrayWrapper<T>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySerializedSize(v, HasFixedLayout<T>{});
 }
 
 // Overload for std::array types.
 template <typename T, std::size_t Size>
 inline std::size_t GetSerializedSize(const std::array<T, Size>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySerializedSize(v, HasFixedLayout<T>{});
 }
 
 // Overload for std::pair.
@@ -834,6 +873,15 @@ inline EnableIfEnum<T> SerializeObject(const T& value, MessageWriter* writer,
                   buffer);
 }
 
+// Serialize fixed layout types.
+template <typename T>
+inline EnableIfHasFixedLayout<T> SerializeObject(const T& value,
+                                                 MessageWriter* /*writer*/,
+                                                 void*& buffer) {
+  SerializeBinEncoding(EncodeBinType(sizeof(T)), sizeof(T), buffer);
+  WriteRawData(buffer, &value, sizeof(T));
+}
+
 // Forward declaration for nested definitions.
 inline void SerializeObject(const EmptyVariant&, MessageWriter*, void*&);
 template <typename... Types>
@@ -961,14 +1009,28 @@ inline void SerializeObject(const StringWrapper<T>& s,
   SerializeString(s, buffer);
 }
 
-// Serializes the payload of array types.
+// Serializes the payload of array types. Arrays of fixed layout types are
+// copied into a single BIN blob.
 template <typename ArrayType>
 inline void SerializeArray(const ArrayType& v, MessageWriter* writer,
-                           void*& buffer) {
+                           void*& buffer, std::false_type /*fixed_layout*/) {
   SerializeType(v, buffer);
   for (const auto& element : v)
     SerializeObject(element, writer, buffer);
 }
+template <typename ArrayType>
+inline void SerializeArray(const ArrayType& v, MessageWriter* /*writer*/,
+                           void*& buffer, std::true_type /*fixed_layout*/) {
+  const std::size_t size = v.size() * sizeof(typename ArrayType::value_type);
+  SerializeBinEncoding(EncodeBinType(size), size, buffer);
+  WriteRawData(buffer, v.data(), size);
+}
+template <typename ArrayType>
+inline void SerializeArray(const ArrayType& v, MessageWriter* writer,
+                           void*& buffer) {
+  SerializeArray(v, writer, buffer,
+                 HasFixedLayout<typename ArrayType::value_type>{});
+}
 
 // Serializes the payload for map types.
 template <typename MapType>
@@ -1381,6 +1443,11 @@ inline EnableIfEnum<T, ErrorType> DeserializeObject(T* value,
 }
 
 // Forward declarations for nested definitions.
+template <typename T>
+inline EnableIfHasFixedLayout<T, ErrorType> DeserializeObject(T*,
+                                                              MessageReader*,
+                                                              const void*&,
+                                                              const void*&);
 template <typename T, typename Enabled = EnableIfHasSerializableMembers<T>>
 inline ErrorType DeserializeObject(T*, MessageReader*, const void*&,
                                    const void*&);
@@ -1560,6 +1627,24 @@ inline ErrorType DeserializeBinType(EncodingType* encoding, std::size_t* size,
   }
 }
 
+// Deserializes fixed layout types.
+template <typename T>
+inline EnableIfHasFixedLayout<T, ErrorType> DeserializeObject(
+    T* value, MessageReader* reader, const void*& start, const void*& end) {
+  EncodingType encoding;
+  std::size_t size;
+
+  if (const auto error =
+          DeserializeBinType(&encoding, &size, reader, start, end)) {
+    return error;
+  } else if (size != sizeof(T)) {
+    return ErrorType(ErrorCode::UNEXPECTED_TYPE_SIZE, ENCODING_CLASS_BINARY,
+                     encoding);
+  } else {
+    return ReadRawData(value, reader, start, end, size);
+  }
+}
+
 // Overload of DeserializeObject() for BufferWrapper types.
 template <typename T, typename Allocator>
 inline ErrorType DeserializeObject(
@@ -1712,6 +1797,54 @@ inline ErrorType DeserializeMapType(EncodingType* encoding, std::size_t* size,
   }
 }
 
+// Deserializes the type code and element count of array types with element
+// type T. Arrays of fixed layout types are encoded as a single BIN blob.
+template <typename T>
+inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
+                                      MessageReader* reader, const void*& start,
+                                      const void*& end,
+                                      std::false_type /*fixed_layout*/) {
+  return DeserializeArrayType(encoding, size, reader, start, end);
+}
+template <typename T>
+inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
+                                      MessageReader* reader, const void*& start,
+                                      const void*& end,
+                                      std::true_type /*fixed_layout*/) {
+  if (const auto error = DeserializeBinType(encoding, size, reader, start, end))
+    return error;
+
+  if (*size % sizeof(T) != 0)
+    return ErrorType(ErrorCode::UNEXPECTED_TYPE_SIZE, ENCODING_CLASS_BINARY,
+                     *encoding);
+
+  *size /= sizeof(T);
+  return ErrorCode::NO_ERROR;
+}
+
+// Deserializes |size| elements of an array type following the type code.
+template <typename ArrayType>
+inline ErrorType DeserializeArrayElements(ArrayType* value, std::size_t size,
+                                          MessageReader* reader,
+                                          const void*& start, const void*& end,
+                                          std::false_type /*fixed_layout*/) {
+  for (std::size_t i = 0; i < size; i++) {
+    if (const auto error = DeserializeObject(&(*value)[i], reader, start, end))
+      return error;
+  }
+  return ErrorCode::NO_ERROR;
+}
+template <typename ArrayType>
+inline ErrorType DeserializeArrayElements(ArrayType* value, std::size_t size,
+                                          MessageReader* reader,
+                                          const void*& start, const void*& end,
+                                          std::true_type /*fixed_layout*/) {
+  if (size == 0U)
+    return ErrorCode::NO_ERROR;
+  return ReadRawData(value->data(), reader, start, end,
+                     size * sizeof(typename ArrayType::value_type));
+}
+
 // Overload for std::vector types.
 template <typename T, typename Allocator>
 inline ErrorType DeserializeObject(std::vector<T, Allocator>* value,
@@ -1720,15 +1853,14 @@ inline ErrorType DeserializeObject(std::vector<T, Allocator>* value,
   EncodingType encoding;
   std::size_t size;
 
-  if (const auto error =
-          DeserializeArrayType(&encoding, &size, reader, start, end))
+  if (const auto error = DeserializeArrayType<T>(
+          &encoding, &size, reader, start, end, HasFixedLayout<T>{}))
     return error;
 
   std::vector<T, Allocator> result(size);
-  for (std::size_t i = 0; i < size; i++) {
-    if (const auto error = DeserializeObject(&result[i], reader, start, end))
-      return error;
-  }
+  if (const auto error = DeserializeArrayElements(
+          &result, size, reader, start, end, HasFixedLayout<T>{}))
+    return error;
 
   *value = std::move(result);
   return ErrorCode::NO_ERROR;
@@ -1844,8 +1976,8 @@ inline ErrorType DeserializeObject(ArrayWrapper<T>* value,
   EncodingType encoding;
   std::size_t size;
 
-  if (const auto error =
-          DeserializeArrayType(&encoding, &size, reader, start, end)) {
+  if (const auto error = DeserializeArrayType<T>(
+          &encoding, &size, reader, start, end, HasFixedLayout<T>{})) {
     return error;
   }
 
@@ -1857,12 +1989,8 @@ inline ErrorType DeserializeObject(ArrayWrapper<T>* value,
   if (size > value->capacity())
     return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
 
-  for (std::size_t i = 0; i < size; i++) {
-    if (const auto error = DeserializeObject(&(*value)[i], reader, start, end))
-      return error;
-  }
-
-  return ErrorCode::NO_ERROR;
+  return DeserializeArrayElements(value, size, reader, start, end,
+                                  HasFixedLayout<T>{});
 }
 
 // Overload for std::array types.
@@ -1873,20 +2001,16 @@ inline ErrorType DeserializeObject(std::array<T, Size>* value,
   EncodingType encoding;
   std::size_t size;
 
-  if (const auto error =
-          DeserializeArrayType(&encoding, &size, reader, start, end)) {
+  if (const auto error = DeserializeArrayType<T>(
+          &encoding, &size, reader, start, end, HasFixedLayout<T>{})) {
     return error;
   }
 
   if (size != Size)
     return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
 
-  for (std::size_t i = 0; i < size; i++) {
-    if (const auto error = DeserializeObject(&(*value)[i], reader, start, end))
-      return error;
-  }
-
-  return ErrorCode::NO_ERROR;
+  return DeserializeArrayElements(value, size, reader, start, end,
+                                  HasFixedLayout<T>{});
 }
 
 // Deserializes std::pair types.
@@ -80,6 +80,17 @@ struct TestTemplateType {
   PDX_SERIALIZABLE_MEMBERS(TestTemplateType<FileHandleType>, fd);
 };
 
+struct TestFixedLayoutType {
+  std::uint8_t a;
+  std::uint8_t b;
+
+  bool operator==(const TestFixedLayoutType& other) const {
+    return a == other.a && b == other.b;
+  }
+
+  PDX_SERIALIZABLE_FIXED_LAYOUT(TestFixedLayoutType);
+};
+
 // Utilities to generate test maps and payloads.
 template <typename MapType>
 MapType MakeMap(std::size_t size) {
@@ -1233,6 +1244,50 @@ TEST(SerializationTest, Serializable) {
   EXPECT_EQ(expected, result);
 }
 
+TEST(SerializationTest, FixedLayout) {
+  Payload result;
+  Payload expected;
+
+  TestFixedLayoutType t1{1, 2};
+  Serialize(t1, &result);
+  expected = {ENCODING_TYPE_BIN8, 2, 1, 2};
+  EXPECT_EQ(expected, result);
+  result.Clear();
+
+  // Arrays of fixed layout types are encoded as a single BIN blob.
+  std::vector<TestFixedLayoutType> v1{{1, 2}, {3, 4}};
+  Serialize(v1, &result);
+  expected = {ENCODING_TYPE_BIN8, 4, 1, 2, 3, 4};
+  EXPECT_EQ(expected, result);
+  result.Clear();
+
+  std::array<TestFixedLayoutType, 2> a1{{{1, 2}, {3, 4}}};
+  Serialize(a1, &result);
+  EXPECT_EQ(expected, result);
+  result.Clear();
+
+  ArrayWrapper<TestFixedLayoutType> w1(v1.data(), v1.capacity(), v1.size());
+  Serialize(w1, &result);
+  EXPECT_EQ(expected, result);
+  result.Clear();
+
+  std::vector<TestFixedLayoutType> v2;
+  Serialize(v2, &result);
+  expected = {ENCODING_TYPE_BIN8, 0};
+  EXPECT_EQ(expected, result);
+  result.Clear();
+
+  // Min BIN16.
+  std::vector<TestFixedLayoutType> v3(128, {'x', 'y'});
+  Serialize(v3, &result);
+  expected = {ENCODING_TYPE_BIN16, 0x00, 0x01};
+  for (std::size_t i = 0; i < v3.size(); i++) {
+    expected.Append(1, 'x');
+    expected.Append(1, 'y');
+  }
+  EXPECT_EQ(expected, result);
+}
+
 TEST(SerializationTest, Variant) {
   Payload result;
   Payload expected;
@@ -2365,6 +2420,60 @@ TEST(DeserializationTest, Serializable) {
   EXPECT_EQ(TestTemplateType<LocalHandle>(LocalHandle(-1)), tt);
 }
 
+TEST(DeserializationTest, FixedLayout) {
+  Payload buffer;
+  ErrorType error;
+
+  buffer = {ENCODING_TYPE_BIN8, 2, 1, 2};
+  TestFixedLayoutType t1;
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((TestFixedLayoutType{1, 2}), t1);
+
+  buffer = {ENCODING_TYPE_BIN8, 4, 1, 2, 3, 4};
+  std::vector<TestFixedLayoutType> v1;
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((std::vector<TestFixedLayoutType>{{1, 2}, {3, 4}}), v1);
+
+  buffer = {ENCODING_TYPE_BIN8, 4, 1, 2, 3, 4};
+  std::array<TestFixedLayoutType, 2> a1;
+  error = Deserialize(&a1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((std::array<TestFixedLayoutType, 2>{{{1, 2}, {3, 4}}}), a1);
+
+  buffer = {ENCODING_TYPE_BIN8, 4, 1, 2, 3, 4};
+  std::vector<TestFixedLayoutType> storage(4);
+  ArrayWrapper<TestFixedLayoutType> w1(storage.data(), storage.size());
+  error = Deserialize(&w1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  ASSERT_EQ(2u, w1.size());
+  EXPECT_EQ((TestFixedLayoutType{3, 4}), w1[1]);
+
+  buffer = {ENCODING_TYPE_BIN8, 0};
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_TRUE(v1.empty());
+
+  // The payload must hold a whole number of elements.
+  buffer = {ENCODING_TYPE_BIN8, 3, 1, 2, 3};
+  error = Deserialize(&v1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_TYPE_SIZE, error);
+  buffer = {ENCODING_TYPE_BIN8, 3, 1, 2, 3};
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_TYPE_SIZE, error);
+
+  // std::array requires the exact number of elements.
+  buffer = {ENCODING_TYPE_BIN8, 2, 1, 2};
+  error = Deserialize(&a1, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_DESTINATION_SIZE, error);
+
+  // Fixed layout types are not encoded as arrays.
+  buffer = {ENCODING_TYPE_FIXARRAY_MIN + 2, 1, 2};
+  error = Deserialize(&t1, &buffer);
+  EXPECT_EQ(ErrorCode::UNEXPECTED_ENCODING, error);
+}
+
 TEST(DeserializationTest, Variant) {
   Payload buffer;
   ErrorType error;
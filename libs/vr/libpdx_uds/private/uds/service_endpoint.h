@@ -2,6 +2,7 @@
 #define ANDROID_PDX_UDS_SERVICE_ENDPOINT_H_
 
 #include <sys/stat.h>
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -36,6 +37,13 @@ class Endpoint : public pdx::Endpoint {
     kDefaultMode = 0,
   };
 
+  // Maximum number of ready channels collected by a single epoll_wait(). The
+  // channels beyond the first are queued and handed out by the following calls
+  // to MessageReceive() without waiting again.
+  enum : int {
+    kMaxEventsPerWait = 16,
+  };
+
   ~Endpoint() override = default;
 
   uint32_t GetIpcTag() const override { return kIpcTag; }
@@ -138,6 +146,8 @@ class Endpoint : public pdx::Endpoint {
       LocalHandle channel_fd, Channel* channel_state);
   Status<void> CloseChannelLocked(int32_t channel_id);
   Status<void> ReenableEpollEvent(const BorrowedHandle& channel_fd);
+  Status<int> GetNextReadyFd();
+  void UpdateReadyEventLocked();
   Channel* GetChannelState(int32_t channel_id);
   BorrowedHandle GetChannelSocketFd(int32_t channel_id);
   Status<std::pair<BorrowedHandle, BorrowedHandle>> GetChannelEventFd(
@@ -157,6 +167,15 @@ class Endpoint : public pdx::Endpoint {
   std::map<int, int32_t> channel_fd_to_id_;
   int32_t last_channel_id_{0};
 
+  // Fds returned by epoll_wait() that have not been received from yet. Their
+  // events are one-shot, so no other thread sees them until they are handled.
+  // |ready_event_fd_| is signaled while the queue is not empty, which keeps
+  // |epoll_fd_| readable for dispatchers polling it and wakes up the other
+  // threads blocked in MessageReceive(). Guarded by |channel_mutex_|.
+  std::deque<int> ready_fds_;
+  LocalHandle ready_event_fd_;
+  bool ready_event_signaled_{false};
+
   Service* service_{nullptr};
   std::atomic<uint32_t> next_message_id_;
 };
@@ -1,5 +1,6 @@
 #include "uds/service_endpoint.h"
 
+#include <alloca.h>
 #include <poll.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -103,25 +104,53 @@ struct MessageState {
     return size;
   }
 
-  Status<size_t> ReadData(const iovec* vector, size_t vector_length) {
-    size_t size_remaining = request_data.size() - request_data_read_pos;
+  // The request payload is left in the channel socket until the service reads
+  // it, and is then received directly into the caller's buffers. The channel is
+  // not polled until the message is replied to, so nothing else reads from the
+  // socket in the meantime.
+  Status<size_t> ReadData(const BorrowedHandle& channel_fd, const iovec* vector,
+                          size_t vector_length) {
+    iovec* read_vector =
+        static_cast<iovec*>(alloca(sizeof(iovec) * vector_length));
+    size_t read_vector_length = 0;
     size_t size = 0;
-    for (size_t i = 0; i < vector_length && size_remaining > 0; i++) {
-      size_t size_to_copy = std::min(size_remaining, vector[i].iov_len);
-      memcpy(vector[i].iov_base, request_data.data() + request_data_read_pos,
-             size_to_copy);
-      size += size_to_copy;
-      request_data_read_pos += size_to_copy;
-      size_remaining -= size_to_copy;
+    for (size_t i = 0; i < vector_length && size < request_data_remaining;
+         i++) {
+      read_vector[read_vector_length].iov_base = vector[i].iov_base;
+      read_vector[read_vector_length].iov_len =
+          std::min(request_data_remaining - size, vector[i].iov_len);
+      size += read_vector[read_vector_length++].iov_len;
     }
+    if (size == 0)
+      return 0;
+
+    auto status =
+        android::pdx::uds::ReceiveDataVector(channel_fd, read_vector,
+                                             read_vector_length);
+    if (!status)
+      return status.error_status();
+    request_data_remaining -= size;
     return size;
   }
 
+  // Drops the part of the request payload the service did not read, so that
+  // the next message on the channel is received from its start.
+  Status<void> DiscardData(const BorrowedHandle& channel_fd) {
+    uint8_t scratch[4096];
+    while (request_data_remaining > 0) {
+      const size_t size = std::min(request_data_remaining, sizeof(scratch));
+      auto status = android::pdx::uds::ReceiveData(channel_fd, scratch, size);
+      if (!status)
+        return status;
+      request_data_remaining -= size;
+    }
+    return {};
+  }
+
   android::pdx::uds::RequestHeader<LocalHandle> request;
   android::pdx::uds::ResponseHeader<BorrowedHandle> response;
   std::vector<LocalHandle> sockets_to_close;
-  std::vector<uint8_t> request_data;
-  size_t request_data_read_pos{0};
+  size_t request_data_remaining{0};
   std::vector<uint8_t> response_data;
 };
 
@@ -179,6 +208,10 @@ void Endpoint::Init(LocalHandle socket_fd) {
   CHECK(cancel_event_fd_.IsValid())
       << "Endpoint::Endpoint: Failed to create event fd: " << strerror(errno);
 
+  ready_event_fd_.Reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  CHECK(ready_event_fd_.IsValid())
+      << "Endpoint::Endpoint: Failed to create event fd: " << strerror(errno);
+
   epoll_fd_.Reset(epoll_create1(EPOLL_CLOEXEC));
   CHECK(epoll_fd_.IsValid())
       << "Endpoint::Endpoint: Failed to create epoll fd: " << strerror(errno);
@@ -203,6 +236,16 @@ void Endpoint::Init(LocalHandle socket_fd) {
   CHECK_EQ(ret, 0)
       << "Endpoint::Endpoint: Failed to add cancel event fd to epoll fd: "
       << strerror(errno);
+
+  epoll_event ready_event;
+  ready_event.events = EPOLLIN;
+  ready_event.data.fd = ready_event_fd_.Get();
+
+  ret = epoll_ctl(epoll_fd_.Get(), EPOLL_CTL_ADD, ready_event_fd_.Get(),
+                  &ready_event);
+  CHECK_EQ(ret, 0)
+      << "Endpoint::Endpoint: Failed to add ready event fd to epoll fd: "
+      << strerror(errno);
   socket_fd_ = std::move(socket_fd);
 }
 
@@ -345,6 +388,11 @@ Status<void> Endpoint::CloseChannelLocked(int32_t channel_id) {
     status.SetValue();
   }
 
+  // Forget any pending event of the channel, its fd may be reused right away.
+  ready_fds_.erase(std::remove(ready_fds_.begin(), ready_fds_.end(), channel_fd),
+                   ready_fds_.end());
+  UpdateReadyEventLocked();
+
   channel_fd_to_id_.erase(channel_fd);
   channels_.erase(iter);
   return status;
@@ -535,13 +583,9 @@ Status<void> Endpoint::ReceiveMessageForChannel(
   *message = Message{info};
   auto* state = static_cast<MessageState*>(message->GetState());
   state->request = std::move(request);
-  if (state->request.send_len > 0 && !state->request.is_impulse) {
-    state->request_data.resize(state->request.send_len);
-    status = ReceiveData(channel_fd, state->request_data.data(),
-                         state->request_data.size());
-  }
-
-  if (status && state->request.is_impulse)
+  if (!state->request.is_impulse)
+    state->request_data_remaining = state->request.send_len;
+  else
     status = ReenableEpollEvent(channel_fd);
 
   if (!status) {
@@ -576,26 +620,81 @@ void Endpoint::BuildCloseMessage(int32_t channel_id, Message* message) {
   *message = Message{info};
 }
 
-Status<void> Endpoint::MessageReceive(Message* message) {
-  // Receive at most one event from the epoll set. This should prevent multiple
-  // dispatch threads from attempting to handle messages on the same socket at
-  // the same time.
-  epoll_event event;
-  int count = RETRY_EINTR(
-      epoll_wait(epoll_fd_.Get(), &event, 1, is_blocking_ ? -1 : 0));
-  if (count < 0) {
-    ALOGE("Endpoint::MessageReceive: Failed to wait for epoll events: %s\n",
-          strerror(errno));
-    return ErrorStatus{errno};
-  } else if (count == 0) {
-    return ErrorStatus{ETIMEDOUT};
+void Endpoint::UpdateReadyEventLocked() {
+  const bool pending = !ready_fds_.empty();
+  if (pending == ready_event_signaled_)
+    return;
+
+  if (pending) {
+    eventfd_write(ready_event_fd_.Get(), 1);
+  } else {
+    eventfd_t value;
+    eventfd_read(ready_event_fd_.Get(), &value);
   }
+  ready_event_signaled_ = pending;
+}
 
-  if (event.data.fd == cancel_event_fd_.Get()) {
-    return ErrorStatus{ESHUTDOWN};
+Status<int> Endpoint::GetNextReadyFd() {
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> autolock(channel_mutex_);
+      if (!ready_fds_.empty()) {
+        const int fd = ready_fds_.front();
+        ready_fds_.pop_front();
+        UpdateReadyEventLocked();
+        return fd;
+      }
+    }
+
+    epoll_event events[kMaxEventsPerWait];
+    int count = RETRY_EINTR(epoll_wait(epoll_fd_.Get(), events,
+                                       kMaxEventsPerWait,
+                                       is_blocking_ ? -1 : 0));
+    if (count < 0) {
+      ALOGE("Endpoint::GetNextReadyFd: Failed to wait for epoll events: %s\n",
+            strerror(errno));
+      return ErrorStatus{errno};
+    } else if (count == 0) {
+      return ErrorStatus{ETIMEDOUT};
+    }
+
+    // Channel events are one-shot, so each ready fd is returned by exactly one
+    // epoll_wait() and queued once. This keeps multiple dispatch threads from
+    // handling messages on the same socket at the same time.
+    std::lock_guard<std::mutex> autolock(channel_mutex_);
+    bool canceled = false;
+    for (int i = 0; i < count; i++) {
+      const int fd = events[i].data.fd;
+      if (fd == cancel_event_fd_.Get())
+        canceled = true;
+      else if (fd != ready_event_fd_.Get())
+        ready_fds_.push_back(fd);
+    }
+
+    if (!canceled && !ready_fds_.empty()) {
+      const int fd = ready_fds_.front();
+      ready_fds_.pop_front();
+      UpdateReadyEventLocked();
+      return fd;
+    }
+
+    // Either canceled, or woken up by the ready event after another thread
+    // took the queued fds.
+    UpdateReadyEventLocked();
+    if (canceled)
+      return ErrorStatus{ESHUTDOWN};
+    else if (!is_blocking_)
+      return ErrorStatus{ETIMEDOUT};
   }
+}
+
+Status<void> Endpoint::MessageReceive(Message* message) {
+  auto fd_status = GetNextReadyFd();
+  if (!fd_status)
+    return fd_status.error_status();
 
-  if (socket_fd_ && event.data.fd == socket_fd_.Get()) {
+  const int fd = fd_status.get();
+  if (socket_fd_ && fd == socket_fd_.Get()) {
     auto status = AcceptConnection(message);
     auto reenable_status = ReenableEpollEvent(socket_fd_.Borrow());
     if (!reenable_status)
@@ -603,7 +702,7 @@ Status<void> Endpoint::MessageReceive(Message* message) {
     return status;
   }
 
-  BorrowedHandle channel_fd{event.data.fd};
+  BorrowedHandle channel_fd{fd};
   return ReceiveMessageForChannel(channel_fd, message);
 }
 
@@ -643,9 +742,16 @@ Status<void> Endpoint::MessageReply(Message* message, int return_code) {
       break;
   }
 
+  auto status = state->DiscardData(channel_socket);
+  if (!status) {
+    // Poll the channel again so that its hangup is received.
+    ReenableEpollEvent(channel_socket);
+    return status;
+  }
+
   state->response.ret_code = return_code;
   state->response.recv_len = state->response_data.size();
-  auto status = SendData(channel_socket, state->response);
+  status = SendData(channel_socket, state->response);
   if (status && !state->response_data.empty()) {
     status = SendData(channel_socket, state->response_data.data(),
                       state->response_data.size());
@@ -691,7 +797,13 @@ Status<void> Endpoint::MessageReplyChannelHandle(
 Status<size_t> Endpoint::ReadMessageData(Message* message, const iovec* vector,
                                          size_t vector_length) {
   auto* state = static_cast<MessageState*>(message->GetState());
-  return state->ReadData(vector, vector_length);
+  if (state->request_data_remaining == 0)
+    return 0;
+
+  auto channel_socket = GetChannelSocketFd(message->GetChannelId());
+  if (!channel_socket)
+    return ErrorStatus{EBADF};
+  return state->ReadData(channel_socket, vector, vector_length);
 }
 
 Status<size_t> Endpoint::WriteMessageData(Message* message, const iovec* vector,
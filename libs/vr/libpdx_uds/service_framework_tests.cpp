@@ -11,6 +11,7 @@
 #include <numeric>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <pdx/channel_handle.h>
@@ -65,6 +66,7 @@ enum test_op_codes {
   TEST_OP_POLLHUP_FROM_SERVICE,
   TEST_OP_POLLIN_FROM_SERVICE,
   TEST_OP_SEND_LARGE_DATA_RETURN_SUM,
+  TEST_OP_SEND_LARGE_DATA_RETURN_FIRST,
 };
 
 using ImpulsePayload = std::array<std::uint8_t, sizeof(MessageInfo::impulse)>;
@@ -222,6 +224,15 @@ class TestService : public ServiceBase<TestService> {
         REPLY_MESSAGE_RETURN(message, sum, {});
       }
 
+      case TEST_OP_SEND_LARGE_DATA_RETURN_FIRST: {
+        // Leave the rest of the payload unread.
+        int first = 0;
+        if (!message.ReadAll(&first, sizeof(first))) {
+          REPLY_ERROR_RETURN(message, EIO, {});
+        }
+        REPLY_MESSAGE_RETURN(message, first, {});
+      }
+
       default:
         return Service::DefaultHandleMessage(message);
     }
@@ -381,6 +392,14 @@ class TestClient : public ClientBase<TestClient> {
                         data_array.size() * sizeof(int), nullptr, 0));
   }
 
+  int SendLargeDataReturnFirst(
+      const std::array<int, kLargeDataSize>& data_array) {
+    Transaction trans{*this};
+    return ReturnStatusOrError(
+        trans.Send<int>(TEST_OP_SEND_LARGE_DATA_RETURN_FIRST, data_array.data(),
+                        data_array.size() * sizeof(int), nullptr, 0));
+  }
+
   Status<int> GetEventMask(int events) {
     if (auto* client_channel = GetChannel()) {
       return client_channel->GetEventMask(events);
@@ -695,6 +714,57 @@ TEST_F(ServiceFrameworkTest, LargeDataSum) {
   ASSERT_EQ(expected_sum, sum);
 }
 
+TEST_F(ServiceFrameworkTest, LargeDataPartialRead) {
+  // Create a test service and add it to the dispatcher.
+  auto service = TestService::Create(kTestService1);
+  ASSERT_NE(nullptr, service);
+  ASSERT_EQ(0, dispatcher_->AddService(service));
+
+  // Create a client to service.
+  auto client = TestClient::Create(kTestService1);
+  ASSERT_NE(nullptr, client);
+
+  const int channel_id = client->GetThisChannelId();
+  EXPECT_LE(0, channel_id);
+
+  std::array<int, kLargeDataSize> data_array;
+  std::iota(data_array.begin(), data_array.end(), 42);
+  EXPECT_EQ(42, client->SendLargeDataReturnFirst(data_array));
+
+  // The unread part of the payload must not be taken for the next message.
+  EXPECT_EQ(channel_id, client->GetThisChannelId());
+  EXPECT_EQ(42, client->SendLargeDataReturnFirst(data_array));
+}
+
+// Test impulses sent on many channels at once, which are received in batches.
+TEST_F(ServiceFrameworkTest, ImpulseBurst) {
+  // Create a test service and add it to the dispatcher.
+  auto service = TestService::Create(kTestService1);
+  ASSERT_NE(nullptr, service);
+  ASSERT_EQ(0, dispatcher_->AddService(service));
+
+  const size_t kClientCount = 2 * Endpoint::kMaxEventsPerWait + 1;
+  std::vector<std::unique_ptr<TestClient>> clients;
+  std::vector<int> channel_ids;
+  for (size_t i = 0; i < kClientCount; i++) {
+    clients.push_back(TestClient::Create(kTestService1));
+    ASSERT_NE(nullptr, clients.back());
+    channel_ids.push_back(clients.back()->GetThisChannelId());
+  }
+
+  const int kImpulsesPerClient = 8;
+  ImpulsePayload payload = {{'a', 'b', 'c'}};
+  for (int i = 0; i < kImpulsesPerClient; i++) {
+    for (auto& client : clients)
+      EXPECT_EQ(0, client->SendAsync(payload.data(), 3));
+  }
+
+  // Every channel must still be served after its queued impulses.
+  for (size_t i = 0; i < kClientCount; i++)
+    EXPECT_EQ(channel_ids[i], clients[i]->GetThisChannelId());
+  EXPECT_EQ(payload, service->GetImpulsePayload());
+}
+
 TEST_F(ServiceFrameworkTest, Cancel) {
   // Create a test service and add it to the dispatcher.
   auto service = TestService::Create(kTestService1, nullptr, true);
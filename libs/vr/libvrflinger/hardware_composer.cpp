@@ -50,6 +50,7 @@ const char kDvrPerformanceProperty[] = "sys.dvr.performance";
 const char kDvrStandaloneProperty[] = "ro.boot.vr";
 
 const char kRightEyeOffsetProperty[] = "dvr.right_eye_offset_ns";
+const char kLateLatchProperty[] = "dvr.late_latch";
 
 // Surface flinger uses "VSYNC-sf" and "VSYNC-app" for its version of these
 // events. Name ours similarly.
@@ -64,6 +65,12 @@ constexpr int64_t kDefaultVsyncPeriodNs = 16666667;
 // Hardware composer reports dpi as dots per thousand inches (dpi * 1000).
 constexpr int kDefaultDpi = 400000;
 
+// Late latching waits for this many measured frames before it moves the post
+// thread wakeup, and then keeps this much slack for scheduling jitter beyond
+// the longest recent post duration.
+constexpr size_t kMinPostDurationsForLateLatch = 10;
+constexpr int64_t kLateLatchMarginNs = 1000000;
+
 // Get time offset from a vsync to when the pose for that vsync should be
 // predicted out to. For example, if scanout gets halfway through the frame
 // at the halfway point between vsyncs, then this could be half the period.
@@ -704,8 +711,9 @@ int HardwareComposer::PostThreadPollInterruptible(
 // Sleep until the next predicted vsync, returning the predicted vsync
 // timestamp.
 Status<int64_t> HardwareComposer::WaitForPredictedVSync() {
-  const int64_t predicted_vsync_time = last_vsync_timestamp_ +
-      (target_display_->vsync_period_ns * vsync_prediction_interval_);
+  const int64_t predicted_vsync_time = vsync_model_.Predict(
+      last_vsync_timestamp_ +
+      vsync_model_.period_ns() * vsync_prediction_interval_);
   const int error = SleepUntil(predicted_vsync_time);
   if (error < 0) {
     ALOGE("HardwareComposer::WaifForVSync:: Failed to sleep: %s",
@@ -734,6 +742,26 @@ int HardwareComposer::SleepUntil(int64_t wakeup_timestamp) {
                                      /*timeout_ms*/ -1);
 }
 
+int64_t HardwareComposer::GetFramePostOffsetNs() const {
+  if (!late_latch_enabled_ ||
+      post_duration_count_ < kMinPostDurationsForLateLatch) {
+    return post_thread_config_.frame_post_offset_ns;
+  }
+
+  const int64_t longest_post_duration_ns = *std::max_element(
+      post_durations_ns_.begin(),
+      post_durations_ns_.begin() + post_duration_count_);
+  return std::min<int64_t>(longest_post_duration_ns + kLateLatchMarginNs,
+                           target_display_->vsync_period_ns);
+}
+
+void HardwareComposer::RecordPostDurationNs(int64_t duration_ns) {
+  post_durations_ns_[next_post_duration_] = duration_ns;
+  next_post_duration_ = (next_post_duration_ + 1) % kPostDurationHistory;
+  if (post_duration_count_ < kPostDurationHistory)
+    ++post_duration_count_;
+}
+
 void HardwareComposer::PostThread() {
   // NOLINTNEXTLINE(runtime/int)
   prctl(PR_SET_NAME, reinterpret_cast<unsigned long>("VrHwcPost"), 0, 0, 0);
@@ -772,6 +800,7 @@ void HardwareComposer::PostThread() {
   };
 
   VsyncEyeOffsets vsync_eye_offsets = get_vsync_eye_offsets();
+  late_latch_enabled_ = property_get_bool(kLateLatchProperty, true);
 
   if (is_standalone_device_) {
     // First, wait until boot finishes.
@@ -857,6 +886,9 @@ void HardwareComposer::PostThread() {
       // predictor will sync up with the real vsync.
       last_vsync_timestamp_ = GetSystemClockNs();
       vsync_prediction_interval_ = 1;
+      vsync_model_.Reset(target_display_->vsync_period_ns);
+      post_duration_count_ = 0;
+      next_post_duration_ = 0;
       retire_fence_fds_.clear();
     }
 
@@ -905,20 +937,25 @@ void HardwareComposer::PostThread() {
       vsync_ring_->Publish(vsync);
     }
 
+    // Set when the post thread slept until its wakeup time, so that the time
+    // it took from there to present the frame can be measured.
+    int64_t wakeup_time_ns = 0;
     {
-      // Sleep until shortly before vsync.
+      // Sleep until shortly before vsync, as late as we can still latch and
+      // present a frame in time to minimize latency.
       ATRACE_NAME("sleep");
 
       const int64_t display_time_est_ns =
-          vsync_timestamp + target_display_->vsync_period_ns;
+          vsync_model_.Predict(vsync_timestamp + vsync_model_.period_ns());
+      const int64_t frame_post_offset_ns = GetFramePostOffsetNs();
       const int64_t now_ns = GetSystemClockNs();
-      const int64_t sleep_time_ns = display_time_est_ns - now_ns -
-                                    post_thread_config_.frame_post_offset_ns;
-      const int64_t wakeup_time_ns =
-          display_time_est_ns - post_thread_config_.frame_post_offset_ns;
+      const int64_t sleep_time_ns =
+          display_time_est_ns - now_ns - frame_post_offset_ns;
 
+      ATRACE_INT64("frame_post_offset_ns", frame_post_offset_ns);
       ATRACE_INT64("sleep_time_ns", sleep_time_ns);
       if (sleep_time_ns > 0) {
+        wakeup_time_ns = display_time_est_ns - frame_post_offset_ns;
         int error = SleepUntil(wakeup_time_ns);
         ALOGE_IF(error < 0 && error != kPostThreadInterrupted,
                  "HardwareComposer::PostThread: Failed to sleep: %s",
@@ -927,6 +964,8 @@ void HardwareComposer::PostThread() {
         // we still go through and present this frame because we may have set
         // layers earlier and we want to flush the Composer's internal command
         // buffer by continuing through to validate and present.
+        if (error != 0)
+          wakeup_time_ns = 0;
       }
     }
 
@@ -955,10 +994,16 @@ void HardwareComposer::PostThread() {
         // We have an updated vsync timestamp, reset the prediction interval.
         last_vsync_timestamp_ = current_vsync_timestamp;
         vsync_prediction_interval_ = 1;
+        vsync_model_.AddVsync(current_vsync_timestamp);
       }
     }
 
     PostLayers(target_display_->id);
+
+    // The measurement includes how late the timer woke us up, which late
+    // latching has to leave room for as well.
+    if (wakeup_time_ns != 0)
+      RecordPostDurationNs(GetSystemClockNs() - wakeup_time_ns);
   }
 }
 
@@ -28,6 +28,7 @@
 #include "DisplayHardware/DisplayIdentification.h"
 #include "acquired_buffer.h"
 #include "display_surface.h"
+#include "vsync_model.h"
 
 // Hardware composer HAL doesn't define HWC_TRANSFORM_NONE as of this writing.
 #ifndef HWC_TRANSFORM_NONE
@@ -451,6 +452,13 @@ class HardwareComposer {
   pdx::Status<int64_t> WaitForPredictedVSync();
   int SleepUntil(int64_t wakeup_timestamp);
 
+  // Returns how long before vsync the post thread should wake up to latch and
+  // present a frame. With late latching this is the longest recent time from
+  // wakeup to present plus a margin; otherwise, or until enough frames were
+  // measured, it is the frame post offset from the config.
+  int64_t GetFramePostOffsetNs() const;
+  void RecordPostDurationNs(int64_t duration_ns);
+
   // Initialize any newly connected displays, and set target_display_ to the
   // display we should render to. Returns true if target_display_
   // changed. Called only from the post thread.
@@ -537,6 +545,20 @@ class HardwareComposer {
   // The number of vsync intervals to predict since the last vsync.
   int vsync_prediction_interval_ = 1;
 
+  // Fit of the recent hardware vsyncs, used to predict the next ones.
+  VsyncModel vsync_model_{0};
+
+  // Whether to wake the post thread as late as the measured post durations
+  // allow, rather than at the configured frame post offset.
+  bool late_latch_enabled_ = true;
+
+  // Ring buffer of the durations from post thread wakeup to present return of
+  // the most recent frames.
+  static constexpr size_t kPostDurationHistory = 60;
+  std::array<int64_t, kPostDurationHistory> post_durations_ns_;
+  size_t post_duration_count_ = 0;
+  size_t next_post_duration_ = 0;
+
   // Vsync count since display on.
   uint32_t vsync_count_ = 0;
 
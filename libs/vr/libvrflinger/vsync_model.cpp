@@ -0,0 +1,74 @@
+#include "vsync_model.h"
+
+#include <stdlib.h>
+
+#include <cmath>
+
+namespace android {
+namespace dvr {
+
+void VsyncModel::Reset(int64_t nominal_period_ns) {
+  nominal_period_ns_ = nominal_period_ns;
+  period_ns_ = nominal_period_ns;
+  anchor_ns_ = 0;
+  vsync_count_ = 0;
+  next_vsync_ = 0;
+}
+
+void VsyncModel::AddVsync(int64_t timestamp_ns) {
+  vsyncs_ns_[next_vsync_] = timestamp_ns;
+  next_vsync_ = (next_vsync_ + 1) % kMaxVsyncs;
+  if (vsync_count_ < kMaxVsyncs)
+    ++vsync_count_;
+
+  // Stay anchored at the newest vsync until the fit below replaces it.
+  anchor_ns_ = timestamp_ns;
+  period_ns_ = nominal_period_ns_;
+  if (vsync_count_ >= kMinVsyncsForFit)
+    Fit();
+}
+
+void VsyncModel::Fit() {
+  const size_t oldest = (next_vsync_ + kMaxVsyncs - vsync_count_) % kMaxVsyncs;
+  const int64_t origin_ns = vsyncs_ns_[oldest];
+
+  // Least squares over (ordinal, time since the oldest vsync). Missed vsyncs
+  // just leave a gap in the ordinals.
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (size_t i = 0; i < vsync_count_; ++i) {
+    const int64_t y = vsyncs_ns_[(oldest + i) % kMaxVsyncs] - origin_ns;
+    const double x = std::round(static_cast<double>(y) / nominal_period_ns_);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+
+  const double n = vsync_count_;
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  if (denominator <= 0)
+    return;
+
+  const double slope = (n * sum_xy - sum_x * sum_y) / denominator;
+  const double intercept = (sum_y - slope * sum_x) / n;
+  const int64_t period_ns = static_cast<int64_t>(std::round(slope));
+  const int64_t max_error_ns =
+      nominal_period_ns_ * kMaxPeriodErrorPercent / 100;
+  if (std::abs(period_ns - nominal_period_ns_) > max_error_ns)
+    return;
+
+  period_ns_ = period_ns;
+  anchor_ns_ = origin_ns + static_cast<int64_t>(std::round(intercept));
+}
+
+int64_t VsyncModel::Predict(int64_t time_ns) const {
+  if (vsync_count_ == 0)
+    return time_ns;
+
+  const double periods =
+      std::round(static_cast<double>(time_ns - anchor_ns_) / period_ns_);
+  return anchor_ns_ + static_cast<int64_t>(periods) * period_ns_;
+}
+
+}  // namespace dvr
+}  // namespace android
@@ -0,0 +1,59 @@
+#ifndef ANDROID_DVR_SERVICES_DISPLAYD_VSYNC_MODEL_H_
+#define ANDROID_DVR_SERVICES_DISPLAYD_VSYNC_MODEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+namespace android {
+namespace dvr {
+
+// Models the hardware vsync as a line through the recent vsync timestamps, so
+// that future vsyncs can be predicted with more precision than the nominal
+// period and a single, jittery, timestamp allow.
+//
+// The period and phase are fit with least squares over the last few vsyncs,
+// each placed at its vsync ordinal relative to the oldest one. Until enough
+// vsyncs were seen, or if the fit strays too far from the nominal period, the
+// model falls back to the nominal period anchored at the newest vsync.
+class VsyncModel {
+ public:
+  explicit VsyncModel(int64_t nominal_period_ns) { Reset(nominal_period_ns); }
+
+  // Forgets all vsyncs, e.g. when the display or its mode changed.
+  void Reset(int64_t nominal_period_ns);
+
+  // Adds a hardware vsync timestamp to the model.
+  void AddVsync(int64_t timestamp_ns);
+
+  // Returns the modeled vsync closest to |time_ns|. Returns |time_ns| if no
+  // vsync was added yet.
+  int64_t Predict(int64_t time_ns) const;
+
+  int64_t period_ns() const { return period_ns_; }
+
+ private:
+  // Enough vsyncs to average out timestamp jitter, few enough to follow drift.
+  static constexpr size_t kMaxVsyncs = 20;
+  static constexpr size_t kMinVsyncsForFit = 6;
+
+  // Fits with a period more than this many percent off nominal are rejected.
+  static constexpr int64_t kMaxPeriodErrorPercent = 10;
+
+  void Fit();
+
+  int64_t nominal_period_ns_ = 0;
+  int64_t period_ns_ = 0;
+  int64_t anchor_ns_ = 0;
+
+  // Ring buffer of the most recent vsync timestamps.
+  std::array<int64_t, kMaxVsyncs> vsyncs_ns_;
+  size_t vsync_count_ = 0;
+  size_t next_vsync_ = 0;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_SERVICES_DISPLAYD_VSYNC_MODEL_H_
@@ -23,7 +23,8 @@
 
 #include <android-base/properties.h>
 #include <log/log.h>
-#include <chrono>
+
+#include <algorithm>
 
 namespace android {
 
@@ -40,16 +41,8 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
+        mTotalSize(0),
+        mUseCount(0) {
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
@@ -101,7 +94,8 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            index = mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            index->setLastUse(++mUseCount);
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
                     keySize, valueSize);
@@ -123,6 +117,7 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
                 }
             }
             index->setValue(valueBlob);
+            index->setLastUse(++mUseCount);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
@@ -148,6 +143,7 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
 
     // The key was found. Return the value if the caller's buffer is large
     // enough.
+    index->setLastUse(++mUseCount);
     std::shared_ptr<Blob> valueBlob(index->getValue());
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
@@ -190,12 +186,21 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = buildId.size();
     memcpy(header->mBuildId, buildId.c_str(), header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries from the least to the most recently used
+    std::vector<const CacheEntry*> entries;
+    entries.reserve(mCacheEntries.size());
+    for (const CacheEntry& e : mCacheEntries) {
+        entries.push_back(&e);
+    }
+    std::sort(entries.begin(), entries.end(), [](const CacheEntry* lhs, const CacheEntry* rhs) {
+        return lhs->getLastUse() < rhs->getLastUse();
+    });
+
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
+    for (const CacheEntry* e : entries) {
+        std::shared_ptr<Blob> const& keyBlob = e->getKey();
+        std::shared_ptr<Blob> const& valueBlob = e->getValue();
         size_t keySize = keyBlob->getSize();
         size_t valueSize = valueBlob->getSize();
 
@@ -227,7 +232,7 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -254,7 +259,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -267,7 +272,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -281,23 +286,28 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
-}
-
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
-    while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+    // Remove the least recently used cache entries until the total cache size
+    // gets below half the maximum total cache size.
+    std::vector<std::pair<uint64_t, size_t>> uses;
+    uses.reserve(mCacheEntries.size());
+    for (const CacheEntry& e : mCacheEntries) {
+        uses.emplace_back(e.getLastUse(), e.getKey()->getSize() + e.getValue()->getSize());
     }
+    std::sort(uses.begin(), uses.end());
+
+    // Every entry last used at or before evictBefore gets evicted.
+    uint64_t evictBefore = 0;
+    for (auto use = uses.begin(); mTotalSize > mMaxTotalSize / 2 && use != uses.end(); ++use) {
+        evictBefore = use->first;
+        mTotalSize -= use->second;
+    }
+
+    mCacheEntries.erase(std::remove_if(mCacheEntries.begin(), mCacheEntries.end(),
+                                       [evictBefore](const CacheEntry& e) {
+                                           return e.getLastUse() <= evictBefore;
+                                       }),
+                        mCacheEntries.end());
 }
 
 bool BlobCache::isCleanable() const {
@@ -335,18 +345,21 @@ size_t BlobCache::Blob::getSize() const {
     return mSize;
 }
 
-BlobCache::CacheEntry::CacheEntry() {
+BlobCache::CacheEntry::CacheEntry() :
+        mLastUse(0) {
 }
 
 BlobCache::CacheEntry::CacheEntry(
         const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value):
         mKey(key),
-        mValue(value) {
+        mValue(value),
+        mLastUse(0) {
 }
 
 BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
         mKey(ce.mKey),
-        mValue(ce.mValue) {
+        mValue(ce.mValue),
+        mLastUse(ce.mLastUse) {
 }
 
 bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
@@ -356,6 +369,7 @@ bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
 const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
     mKey = rhs.mKey;
     mValue = rhs.mValue;
+    mLastUse = rhs.mLastUse;
     return *this;
 }
 
@@ -371,4 +385,12 @@ void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
     mValue = value;
 }
 
+uint64_t BlobCache::CacheEntry::getLastUse() const {
+    return mLastUse;
+}
+
+void BlobCache::CacheEntry::setLastUse(uint64_t lastUse) {
+    mLastUse = lastUse;
+}
+
 } // namespace android
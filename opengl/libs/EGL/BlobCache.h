@@ -18,6 +18,7 @@
 #define ANDROID_BLOB_CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <memory>
 #include <vector>
@@ -83,7 +84,9 @@ public:
     // flatten serializes the current contents of the cache into the memory
     // pointed to by 'buffer'.  The serialized cache contents can later be
     // loaded into a BlobCache object using the unflatten method.  The contents
-    // of the BlobCache object will not be modified.
+    // of the BlobCache object will not be modified.  Entries are written from
+    // the least to the most recently used, so that unflatten restores the
+    // order in which they will be evicted.
     //
     // Preconditions:
     //   size >= this.getFlattenedSize()
@@ -99,7 +102,10 @@ public:
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear() {
+        mCacheEntries.clear();
+        mTotalSize = 0;
+    }
 
 protected:
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
@@ -114,10 +120,7 @@ private:
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -167,6 +170,9 @@ private:
 
         void setValue(const std::shared_ptr<Blob>& value);
 
+        uint64_t getLastUse() const;
+        void setLastUse(uint64_t lastUse);
+
     private:
 
         // mKey is the key that identifies the cache entry.
@@ -174,6 +180,10 @@ private:
 
         // mValue is the cached data associated with the key.
         std::shared_ptr<Blob> mValue;
+
+        // mLastUse is the value of BlobCache::mUseCount when the entry was
+        // last set or retrieved.
+        uint64_t mLastUse;
     };
 
     // A Header is the header for the entire BlobCache serialization format. No
@@ -236,9 +246,9 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mUseCount is incremented each time an entry is set or retrieved, and
+    // orders the entries from the least to the most recently used.
+    uint64_t mUseCount;
 
     // mCacheEntries stores all the cache entries that are resident in memory.
     // Cache entries are added to it by the 'set' method.
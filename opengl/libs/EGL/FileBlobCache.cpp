@@ -21,6 +21,7 @@
 #include <log/log.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 
 // Cache file header
@@ -114,73 +115,109 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
     }
 }
 
-void FileBlobCache::writeToFile() {
+FileBlobCache::Snapshot FileBlobCache::takeSnapshot() const {
+    Snapshot snapshot;
     if (mFilename.length() > 0) {
         size_t cacheSize = getFlattenedSize();
         size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
 
+        std::vector<uint8_t> data(headerSize + cacheSize);
+        int err = flatten(data.data() + headerSize, cacheSize);
+        if (err < 0) {
+            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
+                    -err);
+            return snapshot;
+        }
+
+        snapshot.filename = mFilename;
+        snapshot.data = std::move(data);
+    }
+    return snapshot;
+}
+
+// fileHasCrc returns true if the cache file exists and its header holds the
+// given CRC.
+static bool fileHasCrc(const char* fname, uint32_t crc) {
+    int fd = open(fname, O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+
+    uint8_t header[cacheFileHeaderSize];
+    ssize_t nread = read(fd, header, cacheFileHeaderSize);
+    close(fd);
+    return nread == static_cast<ssize_t>(cacheFileHeaderSize) &&
+            memcmp(header, cacheFileMagic, 4) == 0 &&
+            memcmp(header + 4, &crc, sizeof(crc)) == 0;
+}
+
+void FileBlobCache::writeSnapshot(Snapshot snapshot) {
+    if (snapshot.filename.length() > 0 && !snapshot.data.empty()) {
+        size_t headerSize = cacheFileHeaderSize;
+        size_t fileSize = snapshot.data.size();
+        size_t cacheSize = fileSize - headerSize;
+        uint8_t* buf = snapshot.data.data();
+        const char* fname = snapshot.filename.c_str();
+
+        // Write the file magic and CRC
+        memcpy(buf, cacheFileMagic, 4);
+        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
+        *crc = crc32c(buf + headerSize, cacheSize);
+
+        // Nothing to do if the file already holds these contents, including
+        // the order in which the entries were used.
+        if (fileHasCrc(fname, *crc)) {
+            ALOGV("cache file %s is up to date", fname);
+            return;
+        }
+
+        // Write the new contents next to the file and rename it over the old
+        // one, so that an interrupted write never loses the previous cache.
         // Try to create the file with no permissions so we can write it
         // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+        std::string tmpFilename = snapshot.filename + ".tmp";
+        const char* tmpName = tmpFilename.c_str();
+        int fd = open(tmpName, O_CREAT | O_EXCL | O_RDWR, 0);
         if (fd == -1) {
             if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
+                // A previous write was interrupted, delete it and try again.
+                if (unlink(tmpName) == -1) {
                     // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
+                    ALOGE("error unlinking cache file %s: %s (%d)", tmpName,
                             strerror(errno), errno);
                     return;
                 }
                 // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+                fd = open(tmpName, O_CREAT | O_EXCL | O_RDWR, 0);
             }
             if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
+                ALOGE("error creating cache file %s: %s (%d)", tmpName,
                         strerror(errno), errno);
                 return;
             }
         }
 
-        size_t fileSize = headerSize + cacheSize;
-
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
-        }
-
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
-
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
-
-        if (write(fd, buf, fileSize) == -1) {
+        if (write(fd, buf, fileSize) != static_cast<ssize_t>(fileSize)) {
             ALOGE("error writing cache file: %s (%d)", strerror(errno),
                     errno);
-            delete [] buf;
             close(fd);
-            unlink(fname);
+            unlink(tmpName);
             return;
         }
 
-        delete [] buf;
         fchmod(fd, S_IRUSR);
         close(fd);
+
+        if (rename(tmpName, fname) == -1) {
+            ALOGE("error renaming cache file %s: %s (%d)", tmpName,
+                    strerror(errno), errno);
+            unlink(tmpName);
+        }
     }
 }
 
+void FileBlobCache::writeToFile() {
+    writeSnapshot(takeSnapshot());
+}
+
 }
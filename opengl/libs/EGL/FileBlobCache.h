@@ -19,6 +19,7 @@
 
 #include "BlobCache.h"
 #include <string>
+#include <vector>
 
 namespace android {
 
@@ -29,6 +30,27 @@ public:
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
 
+    // A Snapshot holds the contents of a FileBlobCache serialized by
+    // takeSnapshot, so that they can be saved to disk without accessing the
+    // cache, and without holding the lock that guards it.
+    struct Snapshot {
+        // filename is the name of the file for storing cache contents.  It is
+        // empty if the cache is not saved to disk.
+        std::string filename;
+
+        // data is the cache file contents, with room left for the CRC.
+        std::vector<uint8_t> data;
+    };
+
+    // takeSnapshot serializes the current contents of BlobCache.  This only
+    // copies the entries; the CRC is computed by writeSnapshot.
+    Snapshot takeSnapshot() const;
+
+    // writeSnapshot attempts to save a snapshot to disk.  The file is left
+    // untouched if it already holds these contents.  Concurrent calls for the
+    // same file must be serialized by the caller.
+    static void writeSnapshot(Snapshot snapshot);
+
     // writeToFile attempts to save the current contents of BlobCache to
     // disk.
     void writeToFile();
@@ -19,6 +19,7 @@
 
 #include <EGL/Loader.h>
 
+#include <atomic>
 #include <string>
 
 #include <dirent.h>
@@ -319,6 +320,59 @@ void Loader::close(egl_connection_t* cnx)
     cnx->useAngle = false;
 }
 
+typedef __eglMustCastToProperFunctionPointerType (*proc_address_func)(const char*);
+
+// Looks up the GLES entry point name in dso, falling back to getProcAddress and to the name with
+// or without the OES suffix. Entry points the driver does not implement get a stub.
+static __eglMustCastToProperFunctionPointerType resolve_api(void* dso, char const* name,
+                                                            proc_address_func getProcAddress) {
+    const ssize_t SIZE = 256;
+    char scrap[SIZE];
+    __eglMustCastToProperFunctionPointerType f =
+        (__eglMustCastToProperFunctionPointerType)dlsym(dso, name);
+    if (f == nullptr) {
+        // couldn't find the entry-point, use eglGetProcAddress()
+        f = getProcAddress(name);
+    }
+    if (f == nullptr) {
+        // Try without the OES postfix
+        ssize_t index = ssize_t(strlen(name)) - 3;
+        if ((index>0 && (index<SIZE-1)) && (!strcmp(name+index, "OES"))) {
+            strncpy(scrap, name, index);
+            scrap[index] = 0;
+            f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
+            //ALOGD_IF(f, "found <%s> instead", scrap);
+        }
+    }
+    if (f == nullptr) {
+        // Try with the OES postfix
+        ssize_t index = ssize_t(strlen(name)) - 3;
+        if (index>0 && strcmp(name+index, "OES")) {
+            snprintf(scrap, SIZE, "%sOES", name);
+            f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
+            //ALOGD_IF(f, "found <%s> instead", scrap);
+        }
+    }
+    if (f == nullptr) {
+        //ALOGD("%s", name);
+        f = (__eglMustCastToProperFunctionPointerType)gl_unimplemented;
+
+        /*
+         * GL_EXT_debug_label is special, we always report it as
+         * supported, it's handled by GLES_trace. If GLES_trace is not
+         * enabled, then these are no-ops.
+         */
+        if (!strcmp(name, "glInsertEventMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
+        } else if (!strcmp(name, "glPushGroupMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
+        } else if (!strcmp(name, "glPopGroupMarkerEXT")) {
+            f = (__eglMustCastToProperFunctionPointerType)gl_noop;
+        }
+    }
+    return f;
+}
+
 void Loader::init_api(void* dso,
         char const * const * api,
         char const * const * ref_api,
@@ -327,8 +381,6 @@ void Loader::init_api(void* dso,
 {
     ATRACE_CALL();
 
-    const ssize_t SIZE = 256;
-    char scrap[SIZE];
     while (*api) {
         char const * name = *api;
         if (ref_api) {
@@ -340,54 +392,135 @@ void Loader::init_api(void* dso,
             }
         }
 
-        __eglMustCastToProperFunctionPointerType f =
-            (__eglMustCastToProperFunctionPointerType)dlsym(dso, name);
-        if (f == nullptr) {
-            // couldn't find the entry-point, use eglGetProcAddress()
-            f = getProcAddress(name);
-        }
-        if (f == nullptr) {
-            // Try without the OES postfix
-            ssize_t index = ssize_t(strlen(name)) - 3;
-            if ((index>0 && (index<SIZE-1)) && (!strcmp(name+index, "OES"))) {
-                strncpy(scrap, name, index);
-                scrap[index] = 0;
-                f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
-                //ALOGD_IF(f, "found <%s> instead", scrap);
-            }
-        }
-        if (f == nullptr) {
-            // Try with the OES postfix
-            ssize_t index = ssize_t(strlen(name)) - 3;
-            if (index>0 && strcmp(name+index, "OES")) {
-                snprintf(scrap, SIZE, "%sOES", name);
-                f = (__eglMustCastToProperFunctionPointerType)dlsym(dso, scrap);
-                //ALOGD_IF(f, "found <%s> instead", scrap);
-            }
-        }
-        if (f == nullptr) {
-            //ALOGD("%s", name);
-            f = (__eglMustCastToProperFunctionPointerType)gl_unimplemented;
-
-            /*
-             * GL_EXT_debug_label is special, we always report it as
-             * supported, it's handled by GLES_trace. If GLES_trace is not
-             * enabled, then these are no-ops.
-             */
-            if (!strcmp(name, "glInsertEventMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            } else if (!strcmp(name, "glPushGroupMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            } else if (!strcmp(name, "glPopGroupMarkerEXT")) {
-                f = (__eglMustCastToProperFunctionPointerType)gl_noop;
-            }
+        *curr++ = resolve_api(dso, name, getProcAddress);
+        api++;
+        if (ref_api) ref_api++;
+    }
+}
+
+/*
+ * Lazy binding of the GLES entry points.
+ *
+ * When ro.egl.lazy_binding is set, the GLES tables start out pointing at trampolines instead of
+ * the driver's functions. The first call to an entry point resolves it, patches the table and
+ * forwards the call, so apps only pay for the entry points they use.
+ */
+
+// The number of entry points in a GLES table, laid out like gl_names.
+static constexpr size_t GL_API_COUNT =
+        sizeof(gl_hooks_t::gl_t) / sizeof(__eglMustCastToProperFunctionPointerType);
+
+// What is needed to resolve the entry points of one GLES table on their first call.
+struct lazy_api_t {
+    void* dso;
+    proc_address_func getProcAddress;
+    __eglMustCastToProperFunctionPointerType* table;
+    std::atomic<__eglMustCastToProperFunctionPointerType> resolved[GL_API_COUNT];
+};
+
+// Indexed by egl_connection_t::GLESv1_INDEX and GLESv2_INDEX.
+static lazy_api_t sLazyApis[2];
+
+static __eglMustCastToProperFunctionPointerType resolve_lazy_entry(size_t index);
+
+template <size_t Index, typename Signature>
+struct lazy_entry;
+
+template <size_t Index, typename R, typename... Args>
+struct lazy_entry<Index, R(Args...)> {
+    static R call(Args... args) {
+        return reinterpret_cast<R (*)(Args...)>(resolve_lazy_entry(Index))(args...);
+    }
+};
+
+#define GL_ENTRY(_r, _api, ...)                                                               \
+    reinterpret_cast<__eglMustCastToProperFunctionPointerType>(                               \
+            &lazy_entry<offsetof(gl_hooks_t::gl_t, _api) /                                    \
+                                sizeof(__eglMustCastToProperFunctionPointerType),             \
+                        _r(__VA_ARGS__)>::call),
+static const __eglMustCastToProperFunctionPointerType lazy_entries[] = {
+    #include "../entries.in"
+};
+#undef GL_ENTRY
+
+static_assert(NELEM(lazy_entries) == GL_API_COUNT, "lazy_entries must match gl_hooks_t::gl_t");
+
+static __eglMustCastToProperFunctionPointerType resolve_lazy_entry(size_t index) {
+    // The GLESv1_CM table is only current in GLES 1.x contexts. Layers route every other call
+    // through the GLESv2 table.
+    lazy_api_t& lazy = getGlThreadSpecific() == &gHooks[egl_connection_t::GLESv1_INDEX]
+            ? sLazyApis[egl_connection_t::GLESv1_INDEX]
+            : sLazyApis[egl_connection_t::GLESv2_INDEX];
+
+    __eglMustCastToProperFunctionPointerType f =
+            lazy.resolved[index].load(std::memory_order_acquire);
+    if (f == nullptr) {
+        f = resolve_api(lazy.dso, gl_names[index], lazy.getProcAddress);
+        lazy.resolved[index].store(f, std::memory_order_release);
+
+        // Patch the table so that later calls skip the trampoline, unless a layer replaced the
+        // entry, in which case the layer keeps calling the trampoline.
+        __eglMustCastToProperFunctionPointerType expected = lazy_entries[index];
+        __atomic_compare_exchange_n(&lazy.table[index], &expected, f, false, __ATOMIC_RELEASE,
+                                    __ATOMIC_RELAXED);
+    }
+    return f;
+}
+
+// Fills the table for api like init_api does, with trampolines instead of the entry points.
+static void init_lazy_api(int apiIndex, void* dso, char const* const* api,
+                          char const* const* ref_api,
+                          __eglMustCastToProperFunctionPointerType* curr,
+                          proc_address_func getProcAddress) {
+    ATRACE_CALL();
+
+    lazy_api_t& lazy = sLazyApis[apiIndex];
+    lazy.dso = dso;
+    lazy.getProcAddress = getProcAddress;
+    lazy.table = curr;
+    for (auto& f : lazy.resolved) {
+        f.store(nullptr, std::memory_order_relaxed);
+    }
+
+    size_t index = 0;
+    while (*api) {
+        if (ref_api && std::strcmp(*api, *ref_api) != 0) {
+            curr[index++] = nullptr;
+            ref_api++;
+            continue;
         }
-        *curr++ = f;
+        curr[index] = lazy_entries[index];
+        index++;
         api++;
         if (ref_api) ref_api++;
     }
 }
 
+static bool use_lazy_binding() {
+    static const bool lazy = base::GetBoolProperty("ro.egl.lazy_binding", false);
+    return lazy;
+}
+
+// Fills the table for api, laid out like ref_api, with the entry points already resolved in
+// ref_curr for ref_api. api must be a subsequence of ref_api, and both tables must come from the
+// same driver library.
+static void copy_api(char const* const* api, char const* const* ref_api,
+                     const __eglMustCastToProperFunctionPointerType* ref_curr,
+                     __eglMustCastToProperFunctionPointerType* curr) {
+    ATRACE_CALL();
+
+    while (*api) {
+        if (std::strcmp(*api, *ref_api) != 0) {
+            *curr++ = nullptr;
+        } else {
+            *curr++ = *ref_curr;
+            api++;
+        }
+        ref_curr++;
+        ref_api++;
+    }
+}
+
 static void* load_system_driver(const char* kind, const char* suffix, const bool exact) {
     ATRACE_CALL();
     class MatchFile {
@@ -662,17 +795,35 @@ void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
         }
     }
 
-    if (mask & GLESv1_CM) {
-        init_api(dso, gl_names_1, gl_names,
-            (__eglMustCastToProperFunctionPointerType*)
-                &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
-            getProcAddress);
+    const bool lazy = use_lazy_binding();
+    if (mask & GLESv2) {
+        __eglMustCastToProperFunctionPointerType* curr = (__eglMustCastToProperFunctionPointerType*)
+                &cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl;
+        if (lazy) {
+            init_lazy_api(egl_connection_t::GLESv2_INDEX, dso, gl_names, nullptr, curr,
+                          getProcAddress);
+        } else {
+            init_api(dso, gl_names, nullptr, curr, getProcAddress);
+        }
     }
 
-    if (mask & GLESv2) {
-        init_api(dso, gl_names, nullptr,
-            (__eglMustCastToProperFunctionPointerType*)
+    if (lazy && (mask & GLESv1_CM)) {
+        init_lazy_api(egl_connection_t::GLESv1_INDEX, dso, gl_names_1, gl_names,
+                      (__eglMustCastToProperFunctionPointerType*)
+                          &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
+                      getProcAddress);
+    } else if ((mask & GLESv1_CM) && (mask & GLESv2)) {
+        // Both APIs come from the same library, and the GLESv1_CM entry points are a subset of
+        // the GLESv2 ones, so reuse them rather than looking every name up a second time.
+        copy_api(gl_names_1, gl_names,
+            (const __eglMustCastToProperFunctionPointerType*)
                 &cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl,
+            (__eglMustCastToProperFunctionPointerType*)
+                &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl);
+    } else if (mask & GLESv1_CM) {
+        init_api(dso, gl_names_1, gl_names,
+            (__eglMustCastToProperFunctionPointerType*)
+                &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
             getProcAddress);
     }
 }
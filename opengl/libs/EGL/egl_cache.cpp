@@ -26,12 +26,18 @@
 
 #include <thread>
 
+#include <android-base/properties.h>
 #include <log/log.h>
 
 // Cache size limits.
 static const size_t maxKeySize = 12 * 1024;
 static const size_t maxValueSize = 64 * 1024;
-static const size_t maxTotalSize = 2 * 1024 * 1024;
+static const size_t defaultMaxTotalSize = 2 * 1024 * 1024;
+
+// The property overriding the total size of the cache of each app, in bytes.
+// Devices running games with large shader sets can raise it so that the
+// shaders are not evicted and recompiled on every launch.
+static const char* maxTotalSizeProperty = "ro.egl.blobcache.size";
 
 // The time in seconds to wait before saving newly inserted cache entries.
 static const unsigned int deferredSaveDelay = 4;
@@ -64,7 +70,9 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize,
 // egl_cache_t definition
 //
 egl_cache_t::egl_cache_t() :
-        mInitialized(false) {
+        mInitialized(false),
+        mSnapshotCount(0),
+        mWrittenSnapshotId(0) {
 }
 
 egl_cache_t::~egl_cache_t() {
@@ -115,11 +123,17 @@ void egl_cache_t::initialize(egl_display_t *display) {
 }
 
 void egl_cache_t::terminate() {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mBlobCache) {
-        mBlobCache->writeToFile();
+    FileBlobCache::Snapshot snapshot;
+    uint64_t snapshotId = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mBlobCache) {
+            snapshot = mBlobCache->takeSnapshot();
+            snapshotId = ++mSnapshotCount;
+        }
+        mBlobCache = nullptr;
     }
-    mBlobCache = nullptr;
+    writeSnapshot(std::move(snapshot), snapshotId);
 }
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
@@ -139,11 +153,17 @@ void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
             mSavePending = true;
             std::thread deferredSaveThread([this]() {
                 sleep(deferredSaveDelay);
-                std::lock_guard<std::mutex> lock(mMutex);
-                if (mInitialized && mBlobCache) {
-                    mBlobCache->writeToFile();
+                FileBlobCache::Snapshot snapshot;
+                uint64_t snapshotId = 0;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (mInitialized && mBlobCache) {
+                        snapshot = mBlobCache->takeSnapshot();
+                        snapshotId = ++mSnapshotCount;
+                    }
+                    mSavePending = false;
                 }
-                mSavePending = false;
+                writeSnapshot(std::move(snapshot), snapshotId);
             });
             deferredSaveThread.detach();
         }
@@ -171,8 +191,20 @@ void egl_cache_t::setCacheFilename(const char* filename) {
     mFilename = filename;
 }
 
+void egl_cache_t::writeSnapshot(FileBlobCache::Snapshot snapshot, uint64_t snapshotId) {
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    if (snapshotId <= mWrittenSnapshotId) {
+        // A newer snapshot was written while this one waited for the lock.
+        return;
+    }
+    FileBlobCache::writeSnapshot(std::move(snapshot));
+    mWrittenSnapshotId = snapshotId;
+}
+
 BlobCache* egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
+        const size_t maxTotalSize =
+                base::GetUintProperty<size_t>(maxTotalSizeProperty, defaultMaxTotalSize);
         mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
     }
     return mBlobCache.get();
@@ -82,6 +82,12 @@ private:
     // possible.
     BlobCache* getBlobCacheLocked();
 
+    // writeSnapshot saves a snapshot of the cache contents to disk, unless a
+    // more recent snapshot was already saved.  It must be called without
+    // mMutex held, so that computing the CRC and writing the file never block
+    // the threads calling setBlob and getBlob.
+    void writeSnapshot(FileBlobCache::Snapshot snapshot, uint64_t snapshotId);
+
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
     // true when initialize is called.  It is set back to false when terminate
@@ -113,6 +119,18 @@ private:
     // variables. It must be locked whenever the member variables are accessed.
     mutable std::mutex mMutex;
 
+    // mSnapshotCount is the number of snapshots taken, which identifies the
+    // most recent one.  It is guarded by mMutex.
+    uint64_t mSnapshotCount;
+
+    // mWriteMutex serializes the writes of snapshots to disk.  It must never
+    // be locked while mMutex is held.
+    std::mutex mWriteMutex;
+
+    // mWrittenSnapshotId identifies the last snapshot written to disk.  It is
+    // guarded by mWriteMutex.
+    uint64_t mWrittenSnapshotId;
+
     // sCache is the singleton egl_cache_t object.
     static egl_cache_t sCache;
 };
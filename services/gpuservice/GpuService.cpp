@@ -24,6 +24,7 @@
 #include <binder/Parcel.h>
 #include <binder/PermissionCache.h>
 #include <cutils/properties.h>
+#include <gpumem/GpuMem.h>
 #include <gpustats/GpuStats.h>
 #include <private/android_filesystem_config.h>
 #include <utils/String8.h>
@@ -31,6 +32,8 @@
 
 #include <vkjson.h>
 
+#include <thread>
+
 namespace android {
 
 using base::StringAppendF;
@@ -45,7 +48,13 @@ const String16 sDump("android.permission.DUMP");
 
 const char* const GpuService::SERVICE_NAME = "gpu";
 
-GpuService::GpuService() : mGpuStats(std::make_unique<GpuStats>()){};
+GpuService::GpuService()
+      : mGpuMem(std::make_shared<GpuMem>()), mGpuStats(std::make_unique<GpuStats>()) {
+    // Attaching to the tracepoint waits for the bpf programs and the GPU driver, so it must not
+    // hold up publishing the service.
+    std::thread asyncInitThread([gpuMem = mGpuMem]() { gpuMem->initialize(); });
+    asyncInitThread.detach();
+};
 
 void GpuService::setGpuStats(const std::string& driverPackageName,
                              const std::string& driverVersionName, uint64_t driverVersionCode,
@@ -82,6 +91,21 @@ std::string GpuService::getUpdatableDriverPath() {
     return mDeveloperDriverPath;
 }
 
+uint64_t GpuService::getGpuMemoryTotal(int32_t pid) {
+    IPCThreadState* ipc = IPCThreadState::self();
+    const int callingPid = ipc->getCallingPid();
+    const int uid = ipc->getCallingUid();
+
+    // apps may only query themselves, while system_server looks at all of them for the lmkd
+    if (uid != AID_SYSTEM && callingPid != pid) {
+        ALOGE("Permission Denial: can't get GPU memory of pid=%d from pid=%d, uid=%d\n", pid,
+              callingPid, uid);
+        return 0;
+    }
+
+    return mGpuMem->getProcessTotal(static_cast<uint32_t>(pid));
+}
+
 status_t GpuService::shellCommand(int /*in*/, int out, int err, std::vector<String16>& args) {
     ATRACE_CALL();
 
@@ -110,6 +134,7 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
     } else {
         bool dumpAll = true;
         bool dumpDriverInfo = false;
+        bool dumpMem = false;
         bool dumpStats = false;
         size_t numArgs = args.size();
 
@@ -119,15 +144,21 @@ status_t GpuService::doDump(int fd, const Vector<String16>& args, bool /*asProto
                     dumpStats = true;
                 } else if (args[index] == String16("--gpudriverinfo")) {
                     dumpDriverInfo = true;
+                } else if (args[index] == String16("--gpumem")) {
+                    dumpMem = true;
                 }
             }
-            dumpAll = !(dumpDriverInfo || dumpStats);
+            dumpAll = !(dumpDriverInfo || dumpMem || dumpStats);
         }
 
         if (dumpAll || dumpDriverInfo) {
             dumpGameDriverInfo(&result);
             result.append("\n");
         }
+        if (dumpAll || dumpMem) {
+            mGpuMem->dump(args, &result);
+            result.append("\n");
+        }
         if (dumpAll || dumpStats) {
             mGpuStats->dump(args, &result);
             result.append("\n");
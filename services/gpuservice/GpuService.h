@@ -28,6 +28,7 @@
 
 namespace android {
 
+class GpuMem;
 class GpuStats;
 
 class GpuService : public BnGpuService, public PriorityDumper {
@@ -52,6 +53,7 @@ private:
                         const GpuStatsInfo::Stats stats, const uint64_t value) override;
     void setUpdatableDriverPath(const std::string& driverPath) override;
     std::string getUpdatableDriverPath() override;
+    uint64_t getGpuMemoryTotal(int32_t pid) override;
 
     /*
      * IBinder interface
@@ -74,6 +76,7 @@ private:
     /*
      * Attributes
      */
+    std::shared_ptr<GpuMem> mGpuMem;
     std::unique_ptr<GpuStats> mGpuStats;
     std::mutex mLock;
     std::string mDeveloperDriverPath;
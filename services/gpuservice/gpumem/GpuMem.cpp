@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "GpuMem"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "gpumem/GpuMem.h"
+
+#include <android-base/stringprintf.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <libbpf.h>
+#include <libbpf_android.h>
+#include <log/log.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace android {
+
+using base::StringAppendF;
+
+GpuMem::~GpuMem() {
+    bpf_detach_tracepoint(kGpuMemTraceGroup, kGpuMemTotal);
+}
+
+void GpuMem::initialize() {
+    // Make sure bpf programs are loaded
+    bpf::waitForProgsLoaded();
+
+    errno = 0;
+    int fd = bpf::retrieveProgram(kGpuMemTotalProgPath);
+    if (fd < 0) {
+        ALOGE("Failed to retrieve pinned program from %s [%d(%s)]", kGpuMemTotalProgPath, errno,
+              strerror(errno));
+        return;
+    }
+
+    // Attach the program to the tracepoint, and the tracepoint is automatically enabled here.
+    errno = 0;
+    int count = 0;
+    while (bpf_attach_tracepoint(fd, kGpuMemTraceGroup, kGpuMemTotal) < 0) {
+        if (++count > kGpuWaitTimeout) {
+            ALOGE("Failed to attach bpf program to %s/%s tracepoint [%d(%s)]", kGpuMemTraceGroup,
+                  kGpuMemTotal, errno, strerror(errno));
+            return;
+        }
+        // Retry until GPU driver loaded or timeout.
+        sleep(1);
+    }
+
+    // The map is only ever read here; the bpf program is its only writer.
+    errno = 0;
+    bpf::BpfMap<uint64_t, uint64_t> map(bpf::mapRetrieveRO(kGpuMemTotalMapPath));
+    if (!map.isValid()) {
+        ALOGE("Failed to create bpf map from %s [%d(%s)]", kGpuMemTotalMapPath, errno,
+              strerror(errno));
+        return;
+    }
+    setGpuMemTotalMap(map);
+
+    ALOGI("Initialized GPU memory tracking");
+}
+
+void GpuMem::setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map) {
+    mGpuMemTotalMap = std::move(map);
+    mInitialized.store(true);
+}
+
+void GpuMem::traverseGpuMemTotals(
+        const std::function<void(uint32_t gpuId, uint32_t pid, uint64_t size)>& callback) {
+    // The upper 32 bits of the key are the gpu id, and the lower 32 bits are the pid.
+    const auto visit = [&callback](const uint64_t& key, const uint64_t& value,
+                                   const bpf::BpfMap<uint64_t, uint64_t>&) {
+        callback(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), value);
+        return netdutils::status::ok;
+    };
+    mGpuMemTotalMap.iterateWithValue(visit);
+}
+
+uint64_t GpuMem::getProcessTotal(uint32_t pid) {
+    ATRACE_CALL();
+
+    if (!mInitialized.load() || !mGpuMemTotalMap.isValid() || pid == 0) {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    traverseGpuMemTotals([pid, &total](uint32_t, uint32_t entryPid, uint64_t size) {
+        if (entryPid == pid) {
+            total += size;
+        }
+    });
+    return total;
+}
+
+void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
+    ATRACE_CALL();
+
+    if (!mInitialized.load() || !mGpuMemTotalMap.isValid()) {
+        result->append("Failed to initialize GPU memory eBPF\n");
+        return;
+    }
+
+    // gpu id -> global total (if reported), and [pid, size] of each process
+    std::map<uint32_t, std::pair<int64_t, std::vector<std::pair<uint32_t, uint64_t>>>> dumpMap;
+    traverseGpuMemTotals([&dumpMap](uint32_t gpuId, uint32_t pid, uint64_t size) {
+        auto& gpu = dumpMap.try_emplace(gpuId, -1, std::vector<std::pair<uint32_t, uint64_t>>())
+                            .first->second;
+        if (pid == 0) {
+            gpu.first = static_cast<int64_t>(size);
+        } else {
+            gpu.second.emplace_back(pid, size);
+        }
+    });
+
+    if (dumpMap.empty()) {
+        result->append("GPU memory total usage map is empty\n");
+        return;
+    }
+
+    for (auto& [gpuId, totals] : dumpMap) {
+        StringAppendF(result, "Memory snapshot for GPU %u:\n", gpuId);
+        if (totals.first < 0) {
+            result->append("Global total: N/A\n");
+        } else {
+            StringAppendF(result, "Global total: %" PRId64 "\n", totals.first);
+        }
+
+        // Largest first, since the processes using the most memory are the ones to look at.
+        auto& procs = totals.second;
+        std::sort(procs.begin(), procs.end(),
+                  [](const auto& l, const auto& r) { return l.second > r.second; });
+        for (const auto& [pid, size] : procs) {
+            StringAppendF(result, "Proc %u total: %" PRIu64 "\n", pid, size);
+        }
+    }
+}
+
+} // namespace android
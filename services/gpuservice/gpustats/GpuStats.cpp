@@ -91,7 +91,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
@@ -107,35 +106,43 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
-        GpuStatsGlobalInfo globalInfo;
-        addLoadingCount(driver, isDriverLoaded, &globalInfo);
-        globalInfo.driverPackageName = driverPackageName;
-        globalInfo.driverVersionName = driverVersionName;
-        globalInfo.driverVersionCode = driverVersionCode;
-        globalInfo.driverBuildTime = driverBuildTime;
-        globalInfo.vulkanVersion = vulkanVersion;
-        mGlobalStats.insert({driverVersionCode, globalInfo});
-    } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
+    {
+        std::lock_guard<std::mutex> lock(mGlobalLock);
+        auto it = mGlobalStats.find(driverVersionCode);
+        if (it == mGlobalStats.end()) {
+            GpuStatsGlobalInfo globalInfo;
+            addLoadingCount(driver, isDriverLoaded, &globalInfo);
+            globalInfo.driverPackageName = driverPackageName;
+            globalInfo.driverVersionName = driverVersionName;
+            globalInfo.driverVersionCode = driverVersionCode;
+            globalInfo.driverBuildTime = driverBuildTime;
+            globalInfo.vulkanVersion = vulkanVersion;
+            mGlobalStats.insert({driverVersionCode, std::move(globalInfo)});
+        } else {
+            addLoadingCount(driver, isDriverLoaded, &it->second);
+        }
     }
 
     const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
-        if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
-            ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
-            return;
-        }
-
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
+    AppStatsShard& shard = appStatsShard(appStatsKey);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (GpuStatsAppInfo* appInfo = findAppStatsLocked(shard, appStatsKey)) {
+        addLoadingTime(driver, driverLoadingTime, appInfo);
         return;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    if (shard.records.size() >= MAX_NUM_APP_RECORDS_PER_SHARD) {
+        ALOGV("GpuStatsAppInfo has reached maximum size. Evict the least recently updated.");
+        shard.index.erase(shard.records.front().first);
+        shard.records.pop_front();
+    }
+
+    GpuStatsAppInfo appInfo;
+    addLoadingTime(driver, driverLoadingTime, &appInfo);
+    appInfo.appPackageName = appPackageName;
+    appInfo.driverVersionCode = driverVersionCode;
+    shard.records.emplace_back(appStatsKey, std::move(appInfo));
+    shard.index.insert({appStatsKey, std::prev(shard.records.end())});
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -145,27 +152,44 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
 
     const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
 
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
-    if (!mAppStats.count(appStatsKey)) {
+    AppStatsShard& shard = appStatsShard(appStatsKey);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    GpuStatsAppInfo* appInfo = findAppStatsLocked(shard, appStatsKey);
+    if (!appInfo) {
         return;
     }
 
     switch (stats) {
         case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
+            appInfo->cpuVulkanInUse = true;
             break;
         case GpuStatsInfo::Stats::FALSE_PREROTATION:
-            mAppStats[appStatsKey].falsePrerotation = true;
+            appInfo->falsePrerotation = true;
             break;
         case GpuStatsInfo::Stats::GLES_1_IN_USE:
-            mAppStats[appStatsKey].gles1InUse = true;
+            appInfo->gles1InUse = true;
             break;
         default:
             break;
     }
 }
 
+GpuStats::AppStatsShard& GpuStats::appStatsShard(const std::string& appStatsKey) {
+    return mAppStats[std::hash<std::string>{}(appStatsKey) % NUM_APP_STATS_SHARDS];
+}
+
+GpuStatsAppInfo* GpuStats::findAppStatsLocked(AppStatsShard& shard,
+                                              const std::string& appStatsKey) {
+    auto it = shard.index.find(appStatsKey);
+    if (it == shard.index.end()) {
+        return nullptr;
+    }
+
+    shard.records.splice(shard.records.end(), shard.records, it->second);
+    return &it->second->second;
+}
+
 void GpuStats::interceptSystemDriverStatsLocked() {
     // Append cpuVulkanVersion and glesVersion to system driver stats
     if (!mGlobalStats.count(0) || mGlobalStats[0].glesVersion) {
@@ -177,13 +201,13 @@ void GpuStats::interceptSystemDriverStatsLocked() {
 }
 
 void GpuStats::registerStatsdCallbacksIfNeeded() {
-    if (!mStatsdRegistered) {
+    std::call_once(mStatsdRegisterOnce, [this] {
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_GLOBAL_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_APP_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         mStatsdRegistered = true;
-    }
+    });
 }
 
 void GpuStats::dump(const Vector<String16>& args, std::string* result) {
@@ -194,47 +218,33 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(mLock);
-    bool dumpAll = true;
-
     std::unordered_set<std::string> argsSet;
     for (size_t i = 0; i < args.size(); i++) {
         argsSet.insert(String8(args[i]).c_str());
     }
 
     const bool dumpGlobal = argsSet.count("--global") != 0;
-    if (dumpGlobal) {
-        dumpGlobalLocked(result);
-        dumpAll = false;
-    }
-
     const bool dumpApp = argsSet.count("--app") != 0;
-    if (dumpApp) {
-        dumpAppLocked(result);
-        dumpAll = false;
-    }
+    const bool dumpAll = !dumpGlobal && !dumpApp;
+    // Without --global or --app, --clear clears everything.
+    const bool clear = argsSet.count("--clear") != 0;
 
-    if (dumpAll) {
+    if (dumpGlobal || dumpAll) {
+        std::lock_guard<std::mutex> lock(mGlobalLock);
         dumpGlobalLocked(result);
-        dumpAppLocked(result);
-    }
-
-    if (argsSet.count("--clear")) {
-        bool clearAll = true;
-
-        if (dumpGlobal) {
+        if (clear) {
             mGlobalStats.clear();
-            clearAll = false;
-        }
-
-        if (dumpApp) {
-            mAppStats.clear();
-            clearAll = false;
         }
+    }
 
-        if (clearAll) {
-            mGlobalStats.clear();
-            mAppStats.clear();
+    if (dumpApp || dumpAll) {
+        for (AppStatsShard& shard : mAppStats) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            dumpAppLocked(shard, result);
+            if (clear) {
+                shard.records.clear();
+                shard.index.clear();
+            }
         }
     }
 }
@@ -248,8 +258,8 @@ void GpuStats::dumpGlobalLocked(std::string* result) {
     }
 }
 
-void GpuStats::dumpAppLocked(std::string* result) {
-    for (const auto& ele : mAppStats) {
+void GpuStats::dumpAppLocked(const AppStatsShard& shard, std::string* result) {
+    for (const auto& ele : shard.records) {
         result->append(ele.second.toString());
         result->append("\n");
     }
@@ -287,10 +297,21 @@ static std::string int64VectorToProtoByteString(const std::vector<int64_t>& valu
 AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
+    for (AppStatsShard& shard : mAppStats) {
+        // Take the records out of the shard so that the atoms are serialized without blocking
+        // the apps that report stats meanwhile.
+        std::list<std::pair<std::string, GpuStatsAppInfo>> records;
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            records.swap(shard.records);
+            shard.index.clear();
+        }
 
-    if (data) {
-        for (const auto& ele : mAppStats) {
+        if (!data) {
+            continue;
+        }
+
+        for (const auto& ele : records) {
             AStatsEvent* event = AStatsEventList_addStatsEvent(data);
             AStatsEvent_setAtomId(event, android::util::GPU_STATS_APP_INFO);
             AStatsEvent_writeString(event, ele.second.appPackageName.c_str());
@@ -312,20 +333,22 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
         }
     }
 
-    mAppStats.clear();
-
     return AStatsManager_PULL_SUCCESS;
 }
 
 AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
-    // flush cpuVulkanVersion and glesVersion to builtin driver stats
-    interceptSystemDriverStatsLocked();
+    std::unordered_map<uint64_t, GpuStatsGlobalInfo> globalStats;
+    {
+        std::lock_guard<std::mutex> lock(mGlobalLock);
+        // flush cpuVulkanVersion and glesVersion to builtin driver stats
+        interceptSystemDriverStatsLocked();
+        globalStats.swap(mGlobalStats);
+    }
 
     if (data) {
-        for (const auto& ele : mGlobalStats) {
+        for (const auto& ele : globalStats) {
             AStatsEvent* event = AStatsEventList_addStatsEvent(data);
             AStatsEvent_setAtomId(event, android::util::GPU_STATS_GLOBAL_INFO);
             AStatsEvent_writeString(event, ele.second.driverPackageName.c_str());
@@ -345,8 +368,6 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventLis
         }
     }
 
-    mGlobalStats.clear();
-
     return AStatsManager_PULL_SUCCESS;
 }
 
@@ -22,6 +22,9 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <array>
+#include <atomic>
+#include <list>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -59,26 +62,48 @@ private:
     AStatsManager_PullAtomCallbackReturn pullGlobalInfoAtom(AStatsEventList* data);
     // Pull app into into app atom.
     AStatsManager_PullAtomCallbackReturn pullAppInfoAtom(AStatsEventList* data);
+    // Below limits the memory usage of GpuStats to be less than 10KB. This is
+    // the preferred number for statsd while maintaining nice data quality.
+    static const size_t MAX_NUM_APP_RECORDS = 100;
+    // App stats are split by key into shards with a lock of their own, so that apps loading
+    // their drivers at the same time rarely wait for each other or for a pull.
+    static const size_t NUM_APP_STATS_SHARDS = 4;
+    static const size_t MAX_NUM_APP_RECORDS_PER_SHARD = MAX_NUM_APP_RECORDS / NUM_APP_STATS_SHARDS;
+
+    struct AppStatsShard {
+        // Guards the members below.
+        std::mutex lock;
+        // Records paired with their key, least recently updated first. The least recently
+        // updated record is evicted when the shard is full.
+        std::list<std::pair<std::string, GpuStatsAppInfo>> records;
+        // Key is <app package name>+<driver version code>.
+        std::unordered_map<std::string, decltype(records)::iterator> index;
+    };
+
+    // Returns the shard holding the app stats for appStatsKey.
+    AppStatsShard& appStatsShard(const std::string& appStatsKey);
+    // Returns the app stats for appStatsKey and marks them as the most recently updated, or
+    // nullptr if there are none. The shard lock must be held.
+    static GpuStatsAppInfo* findAppStatsLocked(AppStatsShard& shard,
+                                               const std::string& appStatsKey);
     // Dump global stats
     void dumpGlobalLocked(std::string* result);
-    // Dump app stats
-    void dumpAppLocked(std::string* result);
+    // Dump app stats of one shard
+    static void dumpAppLocked(const AppStatsShard& shard, std::string* result);
     // Append cpuVulkanVersion and glesVersion to system driver stats
     void interceptSystemDriverStatsLocked();
     // Registers statsd callbacks if they have not already been registered
     void registerStatsdCallbacksIfNeeded();
 
-    // Below limits the memory usage of GpuStats to be less than 10KB. This is
-    // the preferred number for statsd while maintaining nice data quality.
-    static const size_t MAX_NUM_APP_RECORDS = 100;
-    // GpuStats access should be guarded by mLock.
-    std::mutex mLock;
+    // Guards the registration of the statsd callbacks.
+    std::once_flag mStatsdRegisterOnce;
     // True if statsd callbacks have been registered.
-    bool mStatsdRegistered = false;
+    std::atomic<bool> mStatsdRegistered{false};
+    // Global stats access should be guarded by mGlobalLock.
+    std::mutex mGlobalLock;
     // Key is driver version code.
     std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
-    // Key is <app package name>+<driver version code>.
-    std::unordered_map<std::string, GpuStatsAppInfo> mAppStats;
+    std::array<AppStatsShard, NUM_APP_STATS_SHARDS> mAppStats;
 };
 
 } // namespace android
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "gpuservice_unittest"
+
+#include <android-base/stringprintf.h>
+#include <bpf/BpfMap.h>
+#include <gmock/gmock.h>
+#include <gpumem/GpuMem.h>
+#include <gtest/gtest.h>
+#include <inttypes.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
+
+#include "TestableGpuMem.h"
+
+namespace android {
+namespace {
+
+using base::StringPrintf;
+using testing::HasSubstr;
+
+constexpr uint32_t TEST_MAP_SIZE = 10;
+constexpr uint64_t TEST_GLOBAL_KEY = 0;
+constexpr uint64_t TEST_GLOBAL_VAL = 123;
+constexpr uint64_t TEST_PROC_KEY_1 = 1;
+constexpr uint64_t TEST_PROC_VAL_1 = 234;
+constexpr uint64_t TEST_PROC_KEY_2 = 4294967298; // (1 << 32) + 2
+constexpr uint64_t TEST_PROC_VAL_2 = 345;
+constexpr uint64_t TEST_PROC_KEY_3 = 4294967297; // (1 << 32) + 1
+constexpr uint64_t TEST_PROC_VAL_3 = 300;
+
+class GpuMemTest : public testing::Test {
+public:
+    void SetUp() override {
+        mGpuMem = std::make_unique<GpuMem>();
+        mTestableGpuMem = TestableGpuMem(mGpuMem.get());
+
+        mTestMap = bpf::BpfMap<uint64_t, uint64_t>(BPF_MAP_TYPE_HASH, TEST_MAP_SIZE,
+                                                   BPF_F_NO_PREALLOC);
+        EXPECT_TRUE(mTestMap.isValid());
+    }
+
+    std::string dumpsys() {
+        std::string result;
+        Vector<String16> args;
+        mGpuMem->dump(args, &result);
+        return result;
+    }
+
+    std::unique_ptr<GpuMem> mGpuMem;
+    TestableGpuMem mTestableGpuMem;
+    bpf::BpfMap<uint64_t, uint64_t> mTestMap;
+};
+
+TEST_F(GpuMemTest, validGpuMemTotalBpfPaths) {
+    EXPECT_EQ(mTestableGpuMem.getGpuMemTraceGroup(), "gpu_mem");
+    EXPECT_EQ(mTestableGpuMem.getGpuMemTotalTracepoint(), "gpu_mem_total");
+    EXPECT_EQ(mTestableGpuMem.getGpuMemTotalProgPath(),
+              "/sys/fs/bpf/prog_gpu_mem_tracepoint_gpu_mem_gpu_mem_total");
+    EXPECT_EQ(mTestableGpuMem.getGpuMemTotalMapPath(), "/sys/fs/bpf/map_gpu_mem_gpu_mem_total_map");
+}
+
+TEST_F(GpuMemTest, bpfInitializationFailed) {
+    EXPECT_EQ(dumpsys(), "Failed to initialize GPU memory eBPF\n");
+    EXPECT_EQ(mGpuMem->getProcessTotal(1), 0);
+}
+
+TEST_F(GpuMemTest, gpuMemTotalMapEmpty) {
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    EXPECT_EQ(dumpsys(), "GPU memory total usage map is empty\n");
+}
+
+TEST_F(GpuMemTest, globalMemTotal) {
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_GLOBAL_KEY, TEST_GLOBAL_VAL, BPF_ANY)));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    EXPECT_THAT(dumpsys(), HasSubstr(StringPrintf("Global total: %" PRIu64 "\n", TEST_GLOBAL_VAL)));
+}
+
+TEST_F(GpuMemTest, missingGlobalMemTotal) {
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY)));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    EXPECT_THAT(dumpsys(), HasSubstr("Global total: N/A"));
+}
+
+TEST_F(GpuMemTest, procMemTotal) {
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY)));
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_2, TEST_PROC_VAL_2, BPF_ANY)));
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_3, TEST_PROC_VAL_3, BPF_ANY)));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    const std::string result = dumpsys();
+    EXPECT_THAT(result, HasSubstr("Memory snapshot for GPU 0:"));
+    EXPECT_THAT(result,
+                HasSubstr(StringPrintf("Proc %u total: %" PRIu64 "\n",
+                                       static_cast<uint32_t>(TEST_PROC_KEY_1), TEST_PROC_VAL_1)));
+    EXPECT_THAT(result, HasSubstr("Memory snapshot for GPU 1:"));
+
+    // Processes are listed largest first.
+    const size_t proc1 = result.find(StringPrintf("Proc 1 total: %" PRIu64, TEST_PROC_VAL_3));
+    const size_t proc2 = result.find(StringPrintf("Proc 2 total: %" PRIu64, TEST_PROC_VAL_2));
+    ASSERT_NE(proc1, std::string::npos);
+    ASSERT_NE(proc2, std::string::npos);
+    EXPECT_LT(proc2, proc1);
+}
+
+TEST_F(GpuMemTest, procTotalSumsAllGpus) {
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_GLOBAL_KEY, TEST_GLOBAL_VAL, BPF_ANY)));
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY)));
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_2, TEST_PROC_VAL_2, BPF_ANY)));
+    ASSERT_TRUE(netdutils::isOk(mTestMap.writeValue(TEST_PROC_KEY_3, TEST_PROC_VAL_3, BPF_ANY)));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    EXPECT_EQ(mGpuMem->getProcessTotal(1), TEST_PROC_VAL_1 + TEST_PROC_VAL_3);
+    EXPECT_EQ(mGpuMem->getProcessTotal(2), TEST_PROC_VAL_2);
+    EXPECT_EQ(mGpuMem->getProcessTotal(3), 0);
+    // pid 0 holds the global totals, which are not a process.
+    EXPECT_EQ(mGpuMem->getProcessTotal(0), 0);
+}
+
+} // namespace
+} // namespace android
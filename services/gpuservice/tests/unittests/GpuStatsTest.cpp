@@ -26,6 +26,9 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <thread>
+#include <vector>
+
 #include "TestableGpuStats.h"
 
 namespace android {
@@ -33,6 +36,14 @@ namespace {
 
 using testing::HasSubstr;
 
+size_t countSubstr(const std::string& str, const std::string& sub) {
+    size_t count = 0;
+    for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
 // clang-format off
 #define BUILTIN_DRIVER_PKG_NAME   "system"
 #define BUILTIN_DRIVER_VER_NAME   "0"
@@ -303,5 +314,55 @@ TEST_F(GpuStatsTest, canPullAppAtom) {
     EXPECT_TRUE(inputCommand(InputCommand::DUMP_APP).empty());
 }
 
+TEST_F(GpuStatsTest, evictsLeastRecentlyUpdatedAppStats) {
+    const size_t maxNumAppRecords = TestableGpuStats::maxNumAppRecords();
+    mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                 BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME, APP_PKG_NAME_1,
+                                 VULKAN_VERSION, GpuStatsInfo::Driver::GL, true,
+                                 DRIVER_LOADING_TIME_1);
+    for (size_t i = 0; i < 2 * maxNumAppRecords; i++) {
+        mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                     BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME,
+                                     APP_PKG_NAME_2 + std::to_string(i), VULKAN_VERSION,
+                                     GpuStatsInfo::Driver::GL, true, DRIVER_LOADING_TIME_2);
+        // Keep the first app the most recently updated.
+        mGpuStats->insertTargetStats(APP_PKG_NAME_1, BUILTIN_DRIVER_VER_CODE,
+                                     GpuStatsInfo::Stats::GLES_1_IN_USE, 0);
+    }
+
+    const std::string dump = inputCommand(InputCommand::DUMP_APP);
+    EXPECT_LE(countSubstr(dump, "appPackageName = "), maxNumAppRecords);
+    EXPECT_THAT(dump, HasSubstr("appPackageName = " APP_PKG_NAME_1 "\n"));
+    EXPECT_THAT(dump, HasSubstr("appPackageName = " APP_PKG_NAME_2 "199\n"));
+}
+
+TEST_F(GpuStatsTest, canInsertDriverStatsConcurrently) {
+    constexpr size_t kNumThreads = 8;
+    constexpr size_t kNumAppsPerThread = 10;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([this, t] {
+            for (size_t i = 0; i < kNumAppsPerThread; i++) {
+                const std::string appPackageName =
+                        APP_PKG_NAME_1 + std::to_string(t * kNumAppsPerThread + i);
+                mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                             BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME,
+                                             appPackageName, VULKAN_VERSION,
+                                             GpuStatsInfo::Driver::GL, true,
+                                             DRIVER_LOADING_TIME_1);
+                mGpuStats->insertTargetStats(appPackageName, BUILTIN_DRIVER_VER_CODE,
+                                             GpuStatsInfo::Stats::CPU_VULKAN_IN_USE, 0);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_THAT(inputCommand(InputCommand::DUMP_GLOBAL),
+                HasSubstr("glLoadingCount = " + std::to_string(kNumThreads * kNumAppsPerThread)));
+    EXPECT_GT(countSubstr(inputCommand(InputCommand::DUMP_APP), "cpuVulkanInUse = 1"), 0u);
+}
+
 } // namespace
 } // namespace android
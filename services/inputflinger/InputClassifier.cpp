@@ -179,8 +179,10 @@ void MotionClassifier::processEvents() {
                 NotifyMotionArgs* motionArgs = static_cast<NotifyMotionArgs*>(event.args.get());
                 common::V1_0::MotionEvent motionEvent =
                         notifyMotionArgsToHalMotionEvent(*motionArgs);
+                const nsecs_t startTime = beginHalCall();
                 Return<common::V1_0::Classification> response = mService->classify(motionEvent);
                 halResponseOk = response.isOk();
+                endHalCall(startTime, halResponseOk, true /*isClassify*/);
                 if (halResponseOk) {
                     common::V1_0::Classification halClassification = response;
                     updateClassification(motionArgs->deviceId, motionArgs->eventTime,
@@ -190,12 +192,16 @@ void MotionClassifier::processEvents() {
             }
             case ClassifierEventType::DEVICE_RESET: {
                 const int32_t deviceId = *(event.getDeviceId());
+                const nsecs_t startTime = beginHalCall();
                 halResponseOk = mService->resetDevice(deviceId).isOk();
+                endHalCall(startTime, halResponseOk, false /*isClassify*/);
                 clearDeviceState(deviceId);
                 break;
             }
             case ClassifierEventType::HAL_RESET: {
+                const nsecs_t startTime = beginHalCall();
                 halResponseOk = mService->reset().isOk();
+                endHalCall(startTime, halResponseOk, false /*isClassify*/);
                 clearClassifications();
                 break;
             }
@@ -213,11 +219,33 @@ void MotionClassifier::processEvents() {
     }
 }
 
+nsecs_t MotionClassifier::beginHalCall() {
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::scoped_lock lock(mLock);
+    mHalCallStartTime = startTime;
+    return startTime;
+}
+
+void MotionClassifier::endHalCall(nsecs_t startTime, bool responseOk, bool isClassify) {
+    const nsecs_t endTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::scoped_lock lock(mLock);
+    mHalCallStartTime = 0;
+    if (!responseOk) {
+        mHalResponseOk = false;
+    } else if (isClassify) {
+        mHalLatency.addValue(endTime - startTime);
+    }
+}
+
 void MotionClassifier::enqueueEvent(ClassifierEvent&& event) {
     bool eventAdded = mEvents.push(std::move(event));
     if (!eventAdded) {
         // If the queue is full, suspect the HAL is slow in processing the events.
         ALOGE("Could not add the event to the queue. Resetting");
+        {
+            std::scoped_lock lock(mLock);
+            mQueueOverflowCount++;
+        }
         reset();
     }
 }
@@ -239,6 +267,7 @@ void MotionClassifier::updateClassification(int32_t deviceId, nsecs_t eventTime,
         return;
     }
     mClassifications[deviceId] = classification;
+    mClassificationDelay.addValue(systemTime(SYSTEM_TIME_MONOTONIC) - eventTime);
 }
 
 void MotionClassifier::setClassification(int32_t deviceId, MotionClassification classification) {
@@ -301,7 +330,7 @@ const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
     if (!mService) {
         return "null";
     }
-    if (mService->ping().isOk()) {
+    if (mHalResponseOk) {
         return "running";
     }
     return "not responding";
@@ -310,8 +339,15 @@ const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
 void MotionClassifier::dump(std::string& dump) {
     std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mService status: %s\n", getServiceStatus());
-    dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu)\n",
-            mEvents.size(), MAX_EVENTS);
+    if (mHalCallStartTime != 0) {
+        dump += StringPrintf(INDENT2 "HAL call in progress for %.1fms\n",
+                             (systemTime(SYSTEM_TIME_MONOTONIC) - mHalCallStartTime) * 0.000001f);
+    }
+    dump += StringPrintf(INDENT2 "HAL classify latency: %s\n", mHalLatency.dump().c_str());
+    dump += StringPrintf(INDENT2 "Classification delay: %s\n",
+                         mClassificationDelay.dump().c_str());
+    dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu), %zu overflow(s)\n",
+            mEvents.size(), MAX_EVENTS, mQueueOverflowCount);
     dump += INDENT2 "mClassifications, mLastDownTimes:\n";
     dump += INDENT3 "Device Id\tClassification\tLast down time";
     // Combine mClassifications and mLastDownTimes into a single table.
@@ -18,6 +18,7 @@
 #define _UI_INPUT_CLASSIFIER_H
 
 #include <android-base/thread_annotations.h>
+#include <input/LatencyHistogram.h>
 #include <utils/RefBase.h>
 #include <thread>
 #include <unordered_map>
@@ -204,13 +205,32 @@ private:
 
     void clearDeviceState(int32_t deviceId);
 
+    /**
+     * Start time of the HAL call in progress, or 0 if the InputClassifier thread is not waiting
+     * on the HAL.
+     */
+    nsecs_t mHalCallStartTime GUARDED_BY(mLock) = 0;
+    // Whether all of the HAL calls so far have succeeded.
+    bool mHalResponseOk GUARDED_BY(mLock) = true;
+    // Duration of the classify calls to the HAL.
+    LatencyHistogram mHalLatency GUARDED_BY(mLock);
+    // Time from the event time until its classification is available to the following events.
+    LatencyHistogram mClassificationDelay GUARDED_BY(mLock);
+    // Number of times the HAL was reset because mEvents was full.
+    size_t mQueueOverflowCount GUARDED_BY(mLock) = 0;
+
+    nsecs_t beginHalCall();
+    void endHalCall(nsecs_t startTime, bool responseOk, bool isClassify);
+
     /**
      * Exit the InputClassifier HAL thread.
      * Useful for tests to ensure proper cleanup.
      */
     void requestExit();
     /**
-     * Return string status of mService
+     * Return string status of mService.
+     * The HAL is not pinged, so that dump never waits on the HAL while holding mLock, which
+     * would block notifyMotion.
      */
     const char* getServiceStatus() REQUIRES(mLock);
 };
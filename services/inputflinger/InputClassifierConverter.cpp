@@ -309,7 +309,9 @@ static common::V1_0::VideoFrame getHalVideoFrame(const TouchVideoFrame& frame) {
     common::V1_0::VideoFrame out;
     out.width = frame.getWidth();
     out.height = frame.getHeight();
-    out.data = frame.getData();
+    // Reference the frame data instead of copying it, see notifyMotionArgsToHalMotionEvent.
+    const std::vector<int16_t>& data = frame.getData();
+    out.data.setToExternal(const_cast<int16_t*>(data.data()), data.size(), false /*shouldOwn*/);
     struct timeval timestamp = frame.getTimestamp();
     out.timestamp = seconds_to_nanoseconds(timestamp.tv_sec) +
              microseconds_to_nanoseconds(timestamp.tv_usec);
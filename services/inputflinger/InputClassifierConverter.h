@@ -25,6 +25,8 @@ namespace android {
 
 /**
  * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent
+ * The video frames of the event reference the data of the args' frames, so the
+ * event must not outlive the args.
  */
 ::android::hardware::input::common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(
         const NotifyMotionArgs& args);
@@ -26,6 +26,7 @@
 
 #include <log/log.h>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <private/android_filesystem_config.h>
 
@@ -106,12 +107,86 @@ void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
         const sp<ISetInputWindowsListener>& setInputWindowsListener) {
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
 
-    std::vector<sp<InputWindowHandle>> handles;
-    for (const auto& info : infos) {
-        handlesPerDisplay.emplace(info.displayId, std::vector<sp<InputWindowHandle>>());
-        handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+    { // acquire lock
+        std::scoped_lock _l(mInputWindowsLock);
+        mInputWindowInfos.clear();
+        mWindowIdsByDisplay.clear();
+        for (const auto& info : infos) {
+            handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+            mWindowIdsByDisplay[info.displayId].push_back(info.id);
+            mInputWindowInfos[info.id] = info;
+        }
+        mDispatcher->setInputWindows(handlesPerDisplay);
+    } // release lock
+
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
     }
-    mDispatcher->setInputWindows(handlesPerDisplay);
+}
+
+void InputManager::updateInputWindows(const std::vector<InputWindowInfo>& changedInfos,
+        const std::vector<int32_t>& windowIds,
+        const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    { // acquire lock
+        std::scoped_lock _l(mInputWindowsLock);
+
+        std::unordered_set<int32_t> changedDisplays;
+        for (const auto& info : changedInfos) {
+            changedDisplays.insert(info.displayId);
+            mInputWindowInfos[info.id] = info;
+        }
+
+        std::unordered_map<int32_t, std::vector<int32_t>> windowIdsByDisplay;
+        std::unordered_set<int32_t> presentIds;
+        for (int32_t id : windowIds) {
+            auto it = mInputWindowInfos.find(id);
+            if (it == mInputWindowInfos.end()) {
+                ALOGE("updateInputWindows: unknown input window id %d", id);
+                continue;
+            }
+            windowIdsByDisplay[it->second.displayId].push_back(id);
+            presentIds.insert(id);
+        }
+
+        // A display also needs an update when windows were removed from it or reordered,
+        // including when it lost all of its windows.
+        for (const auto& [displayId, ids] : mWindowIdsByDisplay) {
+            auto it = windowIdsByDisplay.find(displayId);
+            if (it == windowIdsByDisplay.end() || it->second != ids) {
+                changedDisplays.insert(displayId);
+            }
+        }
+        for (const auto& [displayId, ids] : windowIdsByDisplay) {
+            if (mWindowIdsByDisplay.find(displayId) == mWindowIdsByDisplay.end()) {
+                changedDisplays.insert(displayId);
+            }
+        }
+
+        for (auto it = mInputWindowInfos.begin(); it != mInputWindowInfos.end();) {
+            if (presentIds.find(it->first) == presentIds.end()) {
+                it = mInputWindowInfos.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        mWindowIdsByDisplay = std::move(windowIdsByDisplay);
+
+        if (!changedDisplays.empty()) {
+            std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+            for (int32_t displayId : changedDisplays) {
+                // An empty list removes all the windows of the display.
+                std::vector<sp<InputWindowHandle>>& handles = handlesPerDisplay[displayId];
+                auto it = mWindowIdsByDisplay.find(displayId);
+                if (it == mWindowIdsByDisplay.end()) {
+                    continue;
+                }
+                for (int32_t id : it->second) {
+                    handles.push_back(new BinderWindowHandle(mInputWindowInfos.at(id)));
+                }
+            }
+            mDispatcher->setInputWindows(handlesPerDisplay);
+        }
+    } // release lock
 
     if (setInputWindowsListener) {
         setInputWindowsListener->onSetInputWindowsFinished();
@@ -30,12 +30,17 @@
 #include <input/Input.h>
 #include <input/InputTransport.h>
 
+#include <android-base/thread_annotations.h>
 #include <input/IInputFlinger.h>
 #include <utils/Errors.h>
 #include <utils/Vector.h>
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace android {
 class InputChannel;
 class InputDispatcherThread;
@@ -96,6 +101,9 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& handles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener);
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedInfos,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener);
 
     virtual void registerInputChannel(const sp<InputChannel>& channel);
     virtual void unregisterInputChannel(const sp<InputChannel>& channel);
@@ -108,6 +116,15 @@ private:
     sp<InputClassifierInterface> mClassifier;
 
     sp<InputDispatcherInterface> mDispatcher;
+
+    // The last window state received from setInputWindows or updateInputWindows. Incremental
+    // updates are applied on top of it, and only displays whose windows changed are passed on
+    // to the dispatcher.
+    std::mutex mInputWindowsLock;
+    std::unordered_map<int32_t /*id*/, InputWindowInfo> mInputWindowInfos
+            GUARDED_BY(mInputWindowsLock);
+    std::unordered_map<int32_t /*displayId*/, std::vector<int32_t /*id*/>> mWindowIdsByDisplay
+            GUARDED_BY(mInputWindowsLock);
 };
 
 } // namespace android
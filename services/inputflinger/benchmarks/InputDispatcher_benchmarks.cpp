@@ -17,8 +17,12 @@
 #include <benchmark/benchmark.h>
 
 #include <binder/Binder.h>
+#include <linux/input.h>
 #include "../dispatcher/InputDispatcher.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace android::inputdispatcher {
 
 // An arbitrary device id.
@@ -35,6 +39,36 @@ static nsecs_t now() {
     return systemTime(SYSTEM_TIME_MONOTONIC);
 }
 
+// Records the duration of each iteration and reports latency percentiles as counters, since
+// the mean reported by the benchmark library hides the slow events that users notice.
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(benchmark::State& state) : mState(state) {}
+
+    ~LatencyRecorder() {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        mState.counters["p50_ns"] = percentile(0.50);
+        mState.counters["p90_ns"] = percentile(0.90);
+        mState.counters["p99_ns"] = percentile(0.99);
+    }
+
+    void start() { mStart = now(); }
+    void stop() { mSamples.push_back(now() - mStart); }
+
+private:
+    double percentile(double fraction) const {
+        const size_t index = static_cast<size_t>(fraction * mSamples.size());
+        return static_cast<double>(mSamples[std::min(index, mSamples.size() - 1)]);
+    }
+
+    benchmark::State& mState;
+    std::vector<nsecs_t> mSamples;
+    nsecs_t mStart = 0;
+};
+
 // --- FakeInputDispatcherPolicy ---
 
 class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
@@ -105,7 +139,8 @@ public:
 
 class FakeInputReceiver {
 public:
-    void consumeEvent() {
+    // Returns the consumed event, valid until the next call, or nullptr if none arrived.
+    const InputEvent* consumeEvent() {
         uint32_t consumeSeq;
         InputEvent* event;
 
@@ -122,11 +157,32 @@ public:
         }
         if (result != OK) {
             ALOGE("Received result = %d from consume()", result);
+            return nullptr;
         }
         result = mConsumer->sendFinishedSignal(consumeSeq, true);
         if (result != OK) {
             ALOGE("Received result = %d from sendFinishedSignal", result);
         }
+        return event;
+    }
+
+    // Consumes events until one of the given type arrives, and for motion events, with the
+    // given masked action. Moves may be batched by the consumer, so their count varies.
+    void consumeUntil(int32_t type, int32_t action) {
+        for (const InputEvent* event = consumeEvent(); event != nullptr; event = consumeEvent()) {
+            if (event->getType() != type) {
+                continue;
+            }
+            if (type == AINPUT_EVENT_TYPE_MOTION &&
+                static_cast<const MotionEvent*>(event)->getActionMasked() != action) {
+                continue;
+            }
+            if (type == AINPUT_EVENT_TYPE_KEY &&
+                static_cast<const KeyEvent*>(event)->getAction() != action) {
+                continue;
+            }
+            return;
+        }
     }
 
 protected:
@@ -150,8 +206,11 @@ public:
     static const int32_t HEIGHT = 200;
 
     FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
-                     const sp<InputDispatcher>& dispatcher, const std::string name)
-          : FakeInputReceiver(dispatcher, name), mFrame(Rect(0, 0, WIDTH, HEIGHT)) {
+                     const sp<InputDispatcher>& dispatcher, const std::string name,
+                     const Rect& frame = Rect(0, 0, WIDTH, HEIGHT), int32_t layoutParamsFlags = 0)
+          : FakeInputReceiver(dispatcher, name),
+            mFrame(frame),
+            mLayoutParamsFlags(layoutParamsFlags) {
         mDispatcher->registerInputChannel(mServerChannel);
 
         inputApplicationHandle->updateInfo();
@@ -161,7 +220,7 @@ public:
     virtual bool updateInfo() override {
         mInfo.token = mServerChannel->getConnectionToken();
         mInfo.name = "FakeWindowHandle";
-        mInfo.layoutParamsFlags = 0;
+        mInfo.layoutParamsFlags = mLayoutParamsFlags;
         mInfo.layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
         mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT.count();
         mInfo.frameLeft = mFrame.left;
@@ -173,7 +232,7 @@ public:
         mInfo.addTouchableRegion(mFrame);
         mInfo.visible = true;
         mInfo.canReceiveKeys = true;
-        mInfo.hasFocus = true;
+        mInfo.hasFocus = mHasFocus;
         mInfo.hasWallpaper = false;
         mInfo.paused = false;
         mInfo.ownerPid = INJECTOR_PID;
@@ -184,8 +243,21 @@ public:
         return true;
     }
 
+    void setFocus(bool hasFocus) { mHasFocus = hasFocus; }
+
 protected:
     Rect mFrame;
+    int32_t mLayoutParamsFlags;
+    bool mHasFocus = true;
+};
+
+class FakeMonitorReceiver : public FakeInputReceiver {
+public:
+    FakeMonitorReceiver(const sp<InputDispatcher>& dispatcher, const std::string name)
+          : FakeInputReceiver(dispatcher, name) {
+        mDispatcher->registerInputMonitor(mServerChannel, ADISPLAY_ID_DEFAULT,
+                                          true /*isGestureMonitor*/);
+    }
 };
 
 static MotionEvent generateMotionEvent() {
@@ -215,6 +287,13 @@ static MotionEvent generateMotionEvent() {
     return event;
 }
 
+static NotifyKeyArgs generateKeyArgs(int32_t action) {
+    const nsecs_t currentTime = now();
+    return NotifyKeyArgs(/* id */ 0, currentTime, DEVICE_ID, AINPUT_SOURCE_KEYBOARD,
+                         ADISPLAY_ID_DEFAULT, POLICY_FLAG_PASS_TO_USER, action, /* flags */ 0,
+                         AKEYCODE_A, KEY_A, AMETA_NONE, currentTime);
+}
+
 static NotifyMotionArgs generateMotionArgs() {
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
@@ -310,8 +389,210 @@ static void benchmarkInjectMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+// Touches the bottom-most of state.range(0) windows. The windows above it are not touch modal
+// and do not contain the touch, so every one of them has to be ruled out by hit testing.
+static void benchmarkNotifyMotionManyWindows(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int64_t i = 1; i < state.range(0); i++) {
+        const int32_t offset = static_cast<int32_t>(FakeWindowHandle::WIDTH * i);
+        windows.push_back(new FakeWindowHandle(application, dispatcher, "Overlay",
+                                               Rect(offset, offset,
+                                                    offset + FakeWindowHandle::WIDTH,
+                                                    offset + FakeWindowHandle::HEIGHT),
+                                               InputWindowInfo::FLAG_NOT_TOUCH_MODAL));
+        static_cast<FakeWindowHandle*>(windows.back().get())->setFocus(false);
+    }
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    windows.push_back(window);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+    window->consumeUntil(AINPUT_EVENT_TYPE_FOCUS, 0);
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    LatencyRecorder latency(state);
+
+    for (auto _ : state) {
+        latency.start();
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+        latency.stop();
+    }
+
+    dispatcher->stop();
+}
+
+// A two finger gesture split across two side by side windows, with a stream of moves.
+static void benchmarkSplitMotion(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    const int32_t flags = InputWindowInfo::FLAG_NOT_TOUCH_MODAL | InputWindowInfo::FLAG_SPLIT_TOUCH;
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> leftWindow =
+            new FakeWindowHandle(application, dispatcher, "Left Window",
+                                 Rect(0, 0, FakeWindowHandle::WIDTH, FakeWindowHandle::HEIGHT),
+                                 flags);
+    sp<FakeWindowHandle> rightWindow =
+            new FakeWindowHandle(application, dispatcher, "Right Window",
+                                 Rect(FakeWindowHandle::WIDTH, 0, 2 * FakeWindowHandle::WIDTH,
+                                      FakeWindowHandle::HEIGHT),
+                                 flags);
+    rightWindow->setFocus(false);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {leftWindow, rightWindow}}});
+    leftWindow->consumeUntil(AINPUT_EVENT_TYPE_FOCUS, 0);
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    motionArgs.pointerCount = 2;
+    motionArgs.pointerProperties[1] = motionArgs.pointerProperties[0];
+    motionArgs.pointerProperties[1].id = 1;
+    motionArgs.pointerCoords[1] = motionArgs.pointerCoords[0];
+    motionArgs.pointerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_X, FakeWindowHandle::WIDTH + 100);
+    const int32_t secondPointerShift = 1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+    LatencyRecorder latency(state);
+
+    for (auto _ : state) {
+        latency.start();
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        motionArgs.pointerCount = 1;
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.pointerCount = 2;
+        motionArgs.action = AMOTION_EVENT_ACTION_POINTER_DOWN | secondPointerShift;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        for (int i = 0; i < 8; i++) {
+            motionArgs.eventTime = now();
+            dispatcher->notifyMotion(&motionArgs);
+        }
+
+        motionArgs.action = AMOTION_EVENT_ACTION_POINTER_UP | secondPointerShift;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.pointerCount = 1;
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        dispatcher->notifyMotion(&motionArgs);
+
+        rightWindow->consumeUntil(AINPUT_EVENT_TYPE_MOTION, AMOTION_EVENT_ACTION_UP);
+        leftWindow->consumeUntil(AINPUT_EVENT_TYPE_MOTION, AMOTION_EVENT_ACTION_UP);
+        latency.stop();
+    }
+
+    dispatcher->stop();
+}
+
+// Touches a window while state.range(0) gesture monitors watch the display.
+static void benchmarkNotifyMotionWithGestureMonitors(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    std::vector<std::unique_ptr<FakeMonitorReceiver>> monitors;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        monitors.push_back(std::make_unique<FakeMonitorReceiver>(dispatcher, "Gesture Monitor"));
+    }
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+    window->consumeUntil(AINPUT_EVENT_TYPE_FOCUS, 0);
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    LatencyRecorder latency(state);
+
+    for (auto _ : state) {
+        latency.start();
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+        for (const std::unique_ptr<FakeMonitorReceiver>& monitor : monitors) {
+            monitor->consumeEvent();
+            monitor->consumeEvent();
+        }
+        latency.stop();
+    }
+
+    dispatcher->stop();
+}
+
+// Moves focus between two windows, then sends a key to the newly focused one. This covers
+// the focus events and the wait for them to be handled before the key is dispatched.
+static void benchmarkNotifyKeyWithFocusChange(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    dispatcher->setFocusedApplication(ADISPLAY_ID_DEFAULT, application);
+    sp<FakeWindowHandle> windows[] = {
+            new FakeWindowHandle(application, dispatcher, "First Window"),
+            new FakeWindowHandle(application, dispatcher, "Second Window"),
+    };
+    windows[0]->setFocus(true);
+    windows[1]->setFocus(false);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windows[0], windows[1]}}});
+    windows[0]->consumeUntil(AINPUT_EVENT_TYPE_FOCUS, 0);
+
+    NotifyKeyArgs keyDown = generateKeyArgs(AKEY_EVENT_ACTION_DOWN);
+    NotifyKeyArgs keyUp = generateKeyArgs(AKEY_EVENT_ACTION_UP);
+    size_t focusedIndex = 0;
+    LatencyRecorder latency(state);
+
+    for (auto _ : state) {
+        latency.start();
+        windows[focusedIndex]->setFocus(false);
+        focusedIndex = 1 - focusedIndex;
+        windows[focusedIndex]->setFocus(true);
+        dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windows[0], windows[1]}}});
+
+        keyDown.downTime = keyDown.eventTime = now();
+        dispatcher->notifyKey(&keyDown);
+        keyUp.downTime = keyDown.downTime;
+        keyUp.eventTime = now();
+        dispatcher->notifyKey(&keyUp);
+
+        windows[1 - focusedIndex]->consumeUntil(AINPUT_EVENT_TYPE_FOCUS, 0);
+        windows[focusedIndex]->consumeUntil(AINPUT_EVENT_TYPE_KEY, AKEY_EVENT_ACTION_UP);
+        latency.stop();
+    }
+
+    dispatcher->stop();
+}
+
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotionManyWindows)->Arg(1)->Arg(8)->Arg(32)->Arg(64);
+BENCHMARK(benchmarkSplitMotion);
+BENCHMARK(benchmarkNotifyMotionWithGestureMonitors)->Arg(1)->Arg(4);
+BENCHMARK(benchmarkNotifyKeyWithFocusChange);
 
 } // namespace android::inputdispatcher
 
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <EventHub.h>
+#include <InputReader.h>
+#include <linux/input.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace android {
+
+// An arbitrary device id.
+static const int32_t DEVICE_ID = 1;
+
+// The size of the fake display, which is also the range of the touch panel axes.
+static const int32_t DISPLAY_WIDTH = 1920;
+static const int32_t DISPLAY_HEIGHT = 1080;
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// Records the duration of each iteration and reports latency percentiles as counters, since
+// the mean reported by the benchmark library hides the slow events that users notice.
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(benchmark::State& state) : mState(state) {}
+
+    ~LatencyRecorder() {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        mState.counters["p50_ns"] = percentile(0.50);
+        mState.counters["p90_ns"] = percentile(0.90);
+        mState.counters["p99_ns"] = percentile(0.99);
+    }
+
+    void start() { mStart = now(); }
+    void stop() { mSamples.push_back(now() - mStart); }
+
+private:
+    double percentile(double fraction) const {
+        const size_t index = static_cast<size_t>(fraction * mSamples.size());
+        return static_cast<double>(mSamples[std::min(index, mSamples.size() - 1)]);
+    }
+
+    benchmark::State& mState;
+    std::vector<nsecs_t> mSamples;
+    nsecs_t mStart = 0;
+};
+
+// --- FakeEventHub ---
+
+// Reports a single multi-touch screen using the slots protocol, and hands the reader whatever
+// raw events were queued since the last call to getEvents. It never blocks.
+class FakeEventHub : public EventHubInterface {
+public:
+    FakeEventHub() {
+        addAxis(ABS_MT_SLOT, 0, MAX_POINTERS - 1);
+        addAxis(ABS_MT_TRACKING_ID, 0, MAX_POINTER_ID);
+        addAxis(ABS_MT_POSITION_X, 0, DISPLAY_WIDTH - 1);
+        addAxis(ABS_MT_POSITION_Y, 0, DISPLAY_HEIGHT - 1);
+        addAxis(ABS_MT_TOUCH_MAJOR, 0, 255);
+        addAxis(ABS_MT_PRESSURE, 0, 255);
+
+        enqueue(EventHubInterface::DEVICE_ADDED, 0, 0);
+        enqueue(EventHubInterface::FINISHED_DEVICE_SCAN, 0, 0);
+    }
+
+    void enqueue(int32_t type, int32_t code, int32_t value) {
+        mEvents.push_back({now(), DEVICE_ID, type, code, value});
+    }
+
+    uint32_t getDeviceClasses(int32_t) const override {
+        return INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT;
+    }
+
+    InputDeviceIdentifier getDeviceIdentifier(int32_t) const override {
+        InputDeviceIdentifier identifier;
+        identifier.name = "Fake Touchscreen";
+        return identifier;
+    }
+
+    int32_t getDeviceControllerNumber(int32_t) const override { return 0; }
+
+    void getConfiguration(int32_t, PropertyMap*) const override {}
+
+    status_t getAbsoluteAxisInfo(int32_t, int axis,
+                                 RawAbsoluteAxisInfo* outAxisInfo) const override {
+        outAxisInfo->clear();
+        auto it = mAxes.find(axis);
+        if (it == mAxes.end()) {
+            return -1;
+        }
+        *outAxisInfo = it->second;
+        return OK;
+    }
+
+    bool hasRelativeAxis(int32_t, int) const override { return false; }
+
+    bool hasInputProperty(int32_t, int property) const override {
+        return property == INPUT_PROP_DIRECT;
+    }
+
+    status_t mapKey(int32_t, int32_t, int32_t, int32_t, int32_t*, int32_t*,
+                    uint32_t*) const override {
+        return NAME_NOT_FOUND;
+    }
+
+    status_t mapAxis(int32_t, int32_t, AxisInfo*) const override { return NAME_NOT_FOUND; }
+
+    void setExcludedDevices(const std::vector<std::string>&) override {}
+
+    size_t getEvents(int, RawEvent* buffer, size_t bufferSize) override {
+        const size_t count = std::min(bufferSize, mEvents.size());
+        std::copy(mEvents.begin(), mEvents.begin() + count, buffer);
+        mEvents.erase(mEvents.begin(), mEvents.begin() + count);
+        return count;
+    }
+
+    std::vector<TouchVideoFrame> getVideoFrames(int32_t) override { return {}; }
+
+    int32_t getScanCodeState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+    int32_t getKeyCodeState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+    int32_t getSwitchState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+
+    status_t getAbsoluteAxisValue(int32_t, int32_t, int32_t* outValue) const override {
+        *outValue = 0;
+        return OK;
+    }
+
+    bool markSupportedKeyCodes(int32_t, size_t, const int32_t*, uint8_t*) const override {
+        return false;
+    }
+
+    bool hasScanCode(int32_t, int32_t) const override { return false; }
+
+    bool hasLed(int32_t, int32_t) const override { return false; }
+    void setLedState(int32_t, int32_t, bool) override {}
+
+    void getVirtualKeyDefinitions(int32_t, std::vector<VirtualKeyDefinition>&) const override {}
+
+    sp<KeyCharacterMap> getKeyCharacterMap(int32_t) const override { return nullptr; }
+    bool setKeyboardLayoutOverlay(int32_t, const sp<KeyCharacterMap>&) override { return false; }
+
+    void vibrate(int32_t, nsecs_t) override {}
+    void cancelVibrate(int32_t) override {}
+
+    void requestReopenDevices() override {}
+    void wake() override {}
+    void dump(std::string&) override {}
+    void monitor() override {}
+
+    bool isDeviceEnabled(int32_t) override { return true; }
+    status_t enableDevice(int32_t) override { return OK; }
+    status_t disableDevice(int32_t) override { return OK; }
+
+private:
+    void addAxis(int axis, int32_t minValue, int32_t maxValue) {
+        RawAbsoluteAxisInfo info;
+        info.clear();
+        info.valid = true;
+        info.minValue = minValue;
+        info.maxValue = maxValue;
+        mAxes[axis] = info;
+    }
+
+    std::map<int, RawAbsoluteAxisInfo> mAxes;
+    std::vector<RawEvent> mEvents;
+};
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = ADISPLAY_ID_DEFAULT;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalRight = viewport.physicalRight = viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.logicalBottom = viewport.physicalBottom = viewport.deviceHeight =
+                DISPLAY_HEIGHT;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::VIEWPORT_INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+protected:
+    virtual ~FakeInputReaderPolicy() {}
+
+    void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    sp<PointerControllerInterface> obtainPointerController(int32_t) override { return nullptr; }
+
+    void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) override {}
+
+    sp<KeyCharacterMap> getKeyboardLayoutOverlay(const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+
+    std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+
+    TouchAffineTransformation getTouchAffineTransformation(const std::string&,
+                                                           int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+private:
+    InputReaderConfiguration mConfig;
+};
+
+// --- FakeInputListener ---
+
+class FakeInputListener : public InputListenerInterface {
+public:
+    size_t getMotionCount() const { return mMotionCount; }
+
+protected:
+    virtual ~FakeInputListener() {}
+
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    void notifyKey(const NotifyKeyArgs*) override {}
+    void notifyMotion(const NotifyMotionArgs*) override { mMotionCount++; }
+    void notifySwitch(const NotifySwitchArgs*) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+
+private:
+    size_t mMotionCount = 0;
+};
+
+// --- BenchmarkInputReader ---
+
+class BenchmarkInputReader : public InputReader {
+public:
+    BenchmarkInputReader(std::shared_ptr<EventHubInterface> eventHub,
+                         const sp<InputReaderPolicyInterface>& policy,
+                         const sp<InputListenerInterface>& listener)
+          : InputReader(eventHub, policy, listener) {}
+
+    // Make the protected loopOnce method accessible to the benchmarks.
+    using InputReader::loopOnce;
+};
+
+// Queues one sync of the given number of fingers. Each finger alternates between two positions
+// every frame, so that every sync produces a move.
+static void enqueueTouchFrame(FakeEventHub& eventHub, int32_t pointerCount, size_t frame) {
+    const int32_t offset = frame % 2 == 0 ? 0 : 1;
+    for (int32_t slot = 0; slot < pointerCount; slot++) {
+        eventHub.enqueue(EV_ABS, ABS_MT_SLOT, slot);
+        eventHub.enqueue(EV_ABS, ABS_MT_TRACKING_ID, slot);
+        eventHub.enqueue(EV_ABS, ABS_MT_POSITION_X, 100 + slot * 150 + offset);
+        eventHub.enqueue(EV_ABS, ABS_MT_POSITION_Y, 500 + offset);
+        eventHub.enqueue(EV_ABS, ABS_MT_TOUCH_MAJOR, 10);
+        eventHub.enqueue(EV_ABS, ABS_MT_PRESSURE, 128);
+    }
+    eventHub.enqueue(EV_SYN, SYN_REPORT, 0);
+}
+
+// Measures one touchscreen sync from the first raw event to the motion handed to the listener,
+// which covers the multi-touch accumulator, pointer id assignment and cookPointerData.
+static void benchmarkTouchscreenSync(benchmark::State& state) {
+    const int32_t pointerCount = static_cast<int32_t>(state.range(0));
+
+    std::shared_ptr<FakeEventHub> eventHub = std::make_shared<FakeEventHub>();
+    sp<FakeInputReaderPolicy> policy = new FakeInputReaderPolicy();
+    sp<FakeInputListener> listener = new FakeInputListener();
+    BenchmarkInputReader reader(eventHub, policy, listener);
+
+    // Add the device, then put all of the fingers down outside of the measured syncs.
+    reader.loopOnce();
+    enqueueTouchFrame(*eventHub, pointerCount, 0);
+    reader.loopOnce();
+    if (listener->getMotionCount() == 0) {
+        state.SkipWithError("Touchscreen did not produce any motion");
+        return;
+    }
+
+    LatencyRecorder latency(state);
+    size_t frame = 1;
+    for (auto _ : state) {
+        state.PauseTiming();
+        enqueueTouchFrame(*eventHub, pointerCount, frame++);
+        state.ResumeTiming();
+
+        latency.start();
+        reader.loopOnce();
+        latency.stop();
+    }
+}
+
+BENCHMARK(benchmarkTouchscreenSync)->Arg(1)->Arg(5)->Arg(10);
+
+} // namespace android
+
+BENCHMARK_MAIN();
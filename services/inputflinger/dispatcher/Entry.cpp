@@ -22,12 +22,66 @@
 #include <android-base/stringprintf.h>
 #include <cutils/atomic.h>
 #include <inttypes.h>
+#include <mutex>
+#include <vector>
 
 using android::base::GetBoolProperty;
 using android::base::StringPrintf;
 
 namespace android::inputdispatcher {
 
+/**
+ * Keeps the memory of recently freed entries of type T for reuse. Every input event allocates a
+ * few entries (one per target when a motion is split), so at high sampling rates going through
+ * the general purpose allocator each time is measurable on the dispatcher thread.
+ * At most Capacity blocks are kept, so a burst of events does not pin memory forever.
+ *
+ * Entries are created both by the dispatcher and by the threads calling notify* and
+ * injectInputEvent, so the pool has its own lock.
+ */
+template <typename T, size_t Capacity>
+class EntryPool {
+public:
+    EntryPool() { mFreeBlocks.reserve(Capacity); }
+
+    void* allocate(size_t size) {
+        if (size == sizeof(T)) {
+            std::scoped_lock lock(mLock);
+            if (!mFreeBlocks.empty()) {
+                void* block = mFreeBlocks.back();
+                mFreeBlocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* block, size_t size) {
+        if (size == sizeof(T)) {
+            std::scoped_lock lock(mLock);
+            if (mFreeBlocks.size() < Capacity) {
+                mFreeBlocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+    // Never destroyed, since entries may still be freed by other threads during exit.
+    static EntryPool& getInstance() {
+        static EntryPool* sInstance = new EntryPool();
+        return *sInstance;
+    }
+
+private:
+    std::mutex mLock;
+    std::vector<void*> mFreeBlocks;
+};
+
+using KeyEntryPool = EntryPool<KeyEntry, 16>;
+using MotionEntryPool = EntryPool<MotionEntry, 64>;
+using DispatchEntryPool = EntryPool<DispatchEntry, 64>;
+
 VerifiedKeyEvent verifiedKeyEventFromKeyEntry(const KeyEntry& entry) {
     return {{VerifiedInputEvent::Type::KEY, entry.deviceId, entry.eventTime, entry.source,
              entry.displayId},
@@ -64,6 +118,7 @@ EventEntry::EventEntry(int32_t id, Type type, nsecs_t eventTime, uint32_t policy
         eventTime(eventTime),
         policyFlags(policyFlags),
         injectionState(nullptr),
+        enqueueTime(0),
         dispatchInProgress(false) {}
 
 EventEntry::~EventEntry() {
@@ -172,6 +227,14 @@ void KeyEntry::recycle() {
     interceptKeyWakeupTime = 0;
 }
 
+void* KeyEntry::operator new(size_t size) {
+    return KeyEntryPool::getInstance().allocate(size);
+}
+
+void KeyEntry::operator delete(void* ptr, size_t size) {
+    KeyEntryPool::getInstance().deallocate(ptr, size);
+}
+
 // --- MotionEntry ---
 
 MotionEntry::MotionEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32_t source,
@@ -236,6 +299,14 @@ void MotionEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("]), policyFlags=0x%08x", policyFlags);
 }
 
+void* MotionEntry::operator new(size_t size) {
+    return MotionEntryPool::getInstance().allocate(size);
+}
+
+void MotionEntry::operator delete(void* ptr, size_t size) {
+    MotionEntryPool::getInstance().deallocate(ptr, size);
+}
+
 // --- DispatchEntry ---
 
 volatile int32_t DispatchEntry::sNextSeqAtomic;
@@ -270,6 +341,14 @@ uint32_t DispatchEntry::nextSeq() {
     return seq;
 }
 
+void* DispatchEntry::operator new(size_t size) {
+    return DispatchEntryPool::getInstance().allocate(size);
+}
+
+void DispatchEntry::operator delete(void* ptr, size_t size) {
+    DispatchEntryPool::getInstance().deallocate(ptr, size);
+}
+
 // --- CommandEntry ---
 
 CommandEntry::CommandEntry(Command command)
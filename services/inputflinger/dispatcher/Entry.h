@@ -59,6 +59,9 @@ struct EventEntry {
     nsecs_t eventTime;
     uint32_t policyFlags;
     InjectionState* injectionState;
+    // Time when the dispatcher received the event from InputReader, or 0 for events that did not
+    // come from InputReader. Only these events are tracked by LatencyTracker.
+    nsecs_t enqueueTime;
 
     bool dispatchInProgress; // initially false, set to true while dispatching
 
@@ -149,6 +152,10 @@ struct KeyEntry : EventEntry {
     virtual void appendDescription(std::string& msg) const;
     void recycle();
 
+    // Key entries are allocated from a pool, see EntryPool in Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 protected:
     virtual ~KeyEntry();
 };
@@ -183,6 +190,10 @@ struct MotionEntry : EventEntry {
                 float xOffset, float yOffset);
     virtual void appendDescription(std::string& msg) const;
 
+    // Motion entries are allocated from a pool, see EntryPool in Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 protected:
     virtual ~MotionEntry();
 };
@@ -217,6 +228,10 @@ struct DispatchEntry {
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
 
+    // Dispatch entries are allocated from a pool, see EntryPool in Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 private:
     static volatile int32_t sNextSeqAtomic;
 
@@ -54,6 +54,7 @@ static constexpr bool DEBUG_FOCUS = false;
 #include <stddef.h>
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <queue>
 #include <sstream>
 
@@ -103,6 +104,9 @@ constexpr std::chrono::nanoseconds KEY_WAITING_FOR_EVENTS_TIMEOUT = 500ms;
 // Number of recent events to keep for debugging purposes.
 constexpr size_t RECENT_QUEUE_MAX_SIZE = 10;
 
+// Maximum number of pending motion events written to a connection with one system call.
+constexpr size_t MAX_MOTION_BATCH_SIZE = 16;
+
 static inline nsecs_t now() {
     return systemTime(SYSTEM_TIME_MONOTONIC);
 }
@@ -312,6 +316,7 @@ static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inp
                             motionEntry.pointerProperties, pointerCoords, 0 /* xOffset */,
                             0 /* yOffset */);
 
+    combinedMotionEntry->enqueueTime = motionEntry.enqueueTime;
     if (motionEntry.injectionState) {
         combinedMotionEntry->injectionState = motionEntry.injectionState;
         combinedMotionEntry->injectionState->refCount += 1;
@@ -752,6 +757,7 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
             // If the application takes too long to catch up then we drop all events preceding
             // the app switch key.
             const KeyEntry& keyEntry = static_cast<const KeyEntry&>(*entry);
+            trackInboundLatencyLocked(*entry, keyEntry.deviceId);
             if (isAppSwitchKeyEvent(keyEntry)) {
                 if (keyEntry.action == AKEY_EVENT_ACTION_DOWN) {
                     mAppSwitchSawKeyDown = true;
@@ -770,6 +776,7 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
         }
 
         case EventEntry::Type::MOTION: {
+            trackInboundLatencyLocked(*entry, static_cast<const MotionEntry&>(*entry).deviceId);
             if (shouldPruneInboundQueueLocked(static_cast<MotionEntry&>(*entry))) {
                 mNextUnblockedEvent = entry;
                 needWake = true;
@@ -790,6 +797,14 @@ bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
     return needWake;
 }
 
+void InputDispatcher::trackInboundLatencyLocked(EventEntry& entry, int32_t deviceId) {
+    if (entry.isSynthesized()) {
+        return;
+    }
+    entry.enqueueTime = now();
+    mLatencyTracker.trackInbound(deviceId, entry.eventTime, entry.enqueueTime);
+}
+
 void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
     entry->refCount += 1;
     mRecentQueue.push_back(entry);
@@ -807,43 +822,56 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    auto windowsIt = mWindowHandlesByDisplay.find(displayId);
+    if (windowsIt == mWindowHandlesByDisplay.end()) {
+        return nullptr;
+    }
+    const std::vector<sp<InputWindowHandle>>& windowHandles = windowsIt->second;
+
+    // Traverse windows from front to back to find touched window. The index skips the windows
+    // that cannot be hit at this point.
+    sp<InputWindowHandle> touchedWindow;
+    int32_t portalToDisplayId = ADISPLAY_ID_NONE;
+    mWindowHitTestIndexByDisplay.at(displayId).forEachCandidate(x, y, [&](size_t index) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[index];
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
-        if (windowInfo->displayId == displayId) {
-            int32_t flags = windowInfo->layoutParamsFlags;
-
-            if (windowInfo->visible) {
-                if (!(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
-                    bool isTouchModal = (flags &
-                                         (InputWindowInfo::FLAG_NOT_FOCUSABLE |
-                                          InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
-                    if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
-                        int32_t portalToDisplayId = windowInfo->portalToDisplayId;
-                        if (portalToDisplayId != ADISPLAY_ID_NONE &&
-                            portalToDisplayId != displayId) {
-                            if (addPortalWindows) {
-                                // For the monitoring channels of the display.
-                                touchState->addPortalWindow(windowHandle);
-                            }
-                            return findTouchedWindowAtLocked(portalToDisplayId, x, y, touchState,
-                                                             addOutsideTargets, addPortalWindows);
-                        }
-                        // Found window.
-                        return windowHandle;
+        if (windowInfo->displayId != displayId) {
+            return true;
+        }
+        int32_t flags = windowInfo->layoutParamsFlags;
+
+        if (!(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
+            bool isTouchModal = (flags &
+                                 (InputWindowInfo::FLAG_NOT_FOCUSABLE |
+                                  InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+            if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
+                if (windowInfo->portalToDisplayId != ADISPLAY_ID_NONE &&
+                    windowInfo->portalToDisplayId != displayId) {
+                    if (addPortalWindows) {
+                        // For the monitoring channels of the display.
+                        touchState->addPortalWindow(windowHandle);
                     }
+                    portalToDisplayId = windowInfo->portalToDisplayId;
+                    return false;
                 }
-
-                if (addOutsideTargets && (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
-                    touchState->addOrUpdateWindow(windowHandle,
-                                                  InputTarget::FLAG_DISPATCH_AS_OUTSIDE,
-                                                  BitSet32(0));
-                }
+                // Found window.
+                touchedWindow = windowHandle;
+                return false;
             }
         }
+
+        if (addOutsideTargets && (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            touchState->addOrUpdateWindow(windowHandle, InputTarget::FLAG_DISPATCH_AS_OUTSIDE,
+                                          BitSet32(0));
+        }
+        return true;
+    });
+
+    if (portalToDisplayId != ADISPLAY_ID_NONE) {
+        return findTouchedWindowAtLocked(portalToDisplayId, x, y, touchState, addOutsideTargets,
+                                         addPortalWindows);
     }
-    return nullptr;
+    return touchedWindow;
 }
 
 std::vector<TouchedMonitor> InputDispatcher::findTouchedGestureMonitorsLocked(
@@ -2103,18 +2131,30 @@ static bool canBeObscuredBy(const sp<InputWindowHandle>& windowHandle,
 bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>& windowHandle,
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
-            break; // All future windows are below us. Exit early.
+    auto windowsIt = mWindowHandlesByDisplay.find(displayId);
+    if (windowsIt == mWindowHandlesByDisplay.end()) {
+        return false;
+    }
+    const std::vector<sp<InputWindowHandle>>& windowHandles = windowsIt->second;
+    // All windows from this one on are below us.
+    const size_t windowIndex = static_cast<size_t>(
+            std::find(windowHandles.begin(), windowHandles.end(), windowHandle) -
+            windowHandles.begin());
+
+    bool obscured = false;
+    mWindowHitTestIndexByDisplay.at(displayId).forEachCandidate(x, y, [&](size_t index) {
+        if (index >= windowIndex) {
+            return false;
         }
-        const InputWindowInfo* otherInfo = otherHandle->getInfo();
-          if (canBeObscuredBy(windowHandle, otherHandle) &&
-            otherInfo->frameContainsPoint(x, y)) {
-            return true;
+        const sp<InputWindowHandle>& otherHandle = windowHandles[index];
+        if (canBeObscuredBy(windowHandle, otherHandle) &&
+            otherHandle->getInfo()->frameContainsPoint(x, y)) {
+            obscured = true;
+            return false;
         }
-    }
-    return false;
+        return true;
+    });
+    return obscured;
 }
 
 bool InputDispatcher::isWindowObscuredLocked(const sp<InputWindowHandle>& windowHandle) const {
@@ -2464,8 +2504,27 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
     ALOGD("channel '%s' ~ startDispatchCycle", connection->getInputChannelName().c_str());
 #endif
 
+    // When several motion events are pending, e.g. because the app fell behind a high rate touch
+    // or stylus stream, they are published as a batch and written with a single system call.
+    std::vector<DispatchEntry*> batchedEntries;
     while (connection->status == Connection::STATUS_NORMAL && !connection->outboundQueue.empty()) {
         DispatchEntry* dispatchEntry = connection->outboundQueue.front();
+        const bool isMotion = dispatchEntry->eventEntry->type == EventEntry::Type::MOTION;
+        if (!batchedEntries.empty() &&
+            (!isMotion || batchedEntries.size() == MAX_MOTION_BATCH_SIZE)) {
+            if (!flushMotionBatchLocked(currentTime, connection, batchedEntries)) {
+                return;
+            }
+            continue;
+        }
+        const bool batchEntry = isMotion &&
+                (!batchedEntries.empty() ||
+                 (connection->outboundQueue.size() > 1 &&
+                  connection->outboundQueue[1]->eventEntry->type == EventEntry::Type::MOTION));
+        if (batchEntry && batchedEntries.empty()) {
+            connection->inputPublisher.beginMotionBatch();
+        }
+
         dispatchEntry->deliveryTime = currentTime;
         const nsecs_t timeout =
                 getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
@@ -2474,6 +2533,11 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
         // Publish the event.
         status_t status;
         EventEntry* eventEntry = dispatchEntry->eventEntry;
+        if (eventEntry->enqueueTime != 0) {
+            mLatencyTracker.trackPublish(connection->inputChannel->getConnectionToken(),
+                                         connection->getInputChannelName(),
+                                         eventEntry->enqueueTime, currentTime);
+        }
         switch (eventEntry->type) {
             case EventEntry::Type::KEY: {
                 const KeyEntry* keyEntry = static_cast<KeyEntry*>(eventEntry);
@@ -2573,29 +2637,12 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
 
         // Check the result.
         if (status) {
-            if (status == WOULD_BLOCK) {
-                if (connection->waitQueue.empty()) {
-                    ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
-                          "This is unexpected because the wait queue is empty, so the pipe "
-                          "should be empty and we shouldn't have any problems writing an "
-                          "event to it, status=%d",
-                          connection->getInputChannelName().c_str(), status);
-                    abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
-                } else {
-                    // Pipe is full and we are waiting for the app to finish process some events
-                    // before sending more events to it.
-#if DEBUG_DISPATCH_CYCLE
-                    ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
-                          "waiting for the application to catch up",
-                          connection->getInputChannelName().c_str());
-#endif
-                }
-            } else {
-                ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
-                      "status=%d",
-                      connection->getInputChannelName().c_str(), status);
-                abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+            // Send the events batched so far before handling the failure of this one.
+            if (!batchedEntries.empty() &&
+                !flushMotionBatchLocked(currentTime, connection, batchedEntries)) {
+                return;
             }
+            handlePublishFailureLocked(currentTime, connection, status);
             return;
         }
 
@@ -2610,6 +2657,77 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
                                connection->inputChannel->getConnectionToken());
         }
         traceWaitQueueLength(connection);
+        if (batchEntry) {
+            batchedEntries.push_back(dispatchEntry);
+        }
+    }
+
+    if (!batchedEntries.empty()) {
+        flushMotionBatchLocked(currentTime, connection, batchedEntries);
+    }
+}
+
+/**
+ * Sends the motion events published since the batch was started. The batched entries have
+ * already been moved to the wait queue; the ones that could not be sent are moved back to the
+ * front of the outbound queue, to be published again later.
+ *
+ * Returns false if the dispatch cycle cannot continue.
+ */
+bool InputDispatcher::flushMotionBatchLocked(nsecs_t currentTime,
+                                             const sp<Connection>& connection,
+                                             std::vector<DispatchEntry*>& batchedEntries) {
+    size_t publishedCount;
+    const status_t status = connection->inputPublisher.flushMotionBatch(&publishedCount);
+    if (status == OK) {
+        batchedEntries.clear();
+        return true;
+    }
+
+    // The entries that were not sent are the most recent ones on the wait queue.
+    for (size_t i = batchedEntries.size(); i > publishedCount; i--) {
+        DispatchEntry* dispatchEntry = batchedEntries[i - 1];
+        ALOG_ASSERT(connection->waitQueue.back() == dispatchEntry);
+        connection->waitQueue.pop_back();
+        if (connection->responsive) {
+            mAnrTracker.erase(dispatchEntry->timeoutTime,
+                              connection->inputChannel->getConnectionToken());
+        }
+        connection->outboundQueue.push_front(dispatchEntry);
+    }
+    traceOutboundQueueLength(connection);
+    traceWaitQueueLength(connection);
+    batchedEntries.clear();
+
+    handlePublishFailureLocked(currentTime, connection, status);
+    return false;
+}
+
+void InputDispatcher::handlePublishFailureLocked(nsecs_t currentTime,
+                                                 const sp<Connection>& connection,
+                                                 status_t status) {
+    if (status == WOULD_BLOCK) {
+        if (connection->waitQueue.empty()) {
+            ALOGE("channel '%s' ~ Could not publish event because the pipe is full. "
+                  "This is unexpected because the wait queue is empty, so the pipe "
+                  "should be empty and we shouldn't have any problems writing an "
+                  "event to it, status=%d",
+                  connection->getInputChannelName().c_str(), status);
+            abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
+        } else {
+            // Pipe is full and we are waiting for the app to finish process some events
+            // before sending more events to it.
+#if DEBUG_DISPATCH_CYCLE
+            ALOGD("channel '%s' ~ Could not publish event because the pipe is full, "
+                  "waiting for the application to catch up",
+                  connection->getInputChannelName().c_str());
+#endif
+        }
+    } else {
+        ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
+              "status=%d",
+              connection->getInputChannelName().c_str(), status);
+        abortBrokenDispatchCycleLocked(currentTime, connection, true /*notify*/);
     }
 }
 
@@ -3008,6 +3126,7 @@ MotionEntry* InputDispatcher::splitMotionEvent(const MotionEntry& originalMotion
                             originalMotionEntry.yCursorPosition, originalMotionEntry.downTime,
                             splitPointerCount, splitPointerProperties, splitPointerCoords, 0, 0);
 
+    splitMotionEntry->enqueueTime = originalMotionEntry.enqueueTime;
     if (originalMotionEntry.injectionState) {
         splitMotionEntry->injectionState = originalMotionEntry.injectionState;
         splitMotionEntry->injectionState->refCount += 1;
@@ -3616,6 +3735,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mWindowHitTestIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -3667,6 +3787,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
 
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
+    mWindowHitTestIndexByDisplay[displayId].rebuild(newHandles);
 }
 
 void InputDispatcher::setInputWindows(
@@ -4280,6 +4401,8 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         dump += INDENT "AppSwitch: not pending\n";
     }
 
+    mLatencyTracker.dump(dump);
+
     dump += INDENT "Configuration:\n";
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %" PRId64 "ms\n", ns2ms(mConfig.keyRepeatDelay));
     dump += StringPrintf(INDENT2 "KeyRepeatTimeout: %" PRId64 "ms\n",
@@ -4387,6 +4510,7 @@ status_t InputDispatcher::unregisterInputChannelLocked(const sp<InputChannel>& i
 
     removeConnectionLocked(connection);
     mInputChannelsByToken.erase(inputChannel->getConnectionToken());
+    mLatencyTracker.eraseToken(inputChannel->getConnectionToken());
 
     if (connection->monitor) {
         removeMonitorChannelLocked(inputChannel);
@@ -4765,7 +4889,7 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(CommandEntry* c
         ALOGI("%s spent %" PRId64 "ms processing %s", connection->getWindowName().c_str(),
               ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
     }
-    reportDispatchStatistics(std::chrono::nanoseconds(eventDuration), *connection, handled);
+    reportDispatchStatisticsLocked(*dispatchEntry, *connection, finishTime, handled);
 
     bool restartEvent;
     if (dispatchEntry->eventEntry->type == EventEntry::Type::KEY) {
@@ -5005,9 +5129,14 @@ KeyEvent InputDispatcher::createKeyEvent(const KeyEntry& entry) {
     return event;
 }
 
-void InputDispatcher::reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                               const Connection& connection, bool handled) {
-    // TODO Write some statistics about how long we spend waiting.
+void InputDispatcher::reportDispatchStatisticsLocked(const DispatchEntry& dispatchEntry,
+                                                     const Connection& connection,
+                                                     nsecs_t finishTime, bool handled) {
+    const EventEntry& eventEntry = *dispatchEntry.eventEntry;
+    if (eventEntry.enqueueTime != 0) {
+        mLatencyTracker.trackFinish(connection.inputChannel->getConnectionToken(),
+                                    eventEntry.eventTime, dispatchEntry.deliveryTime, finishTime);
+    }
 }
 
 /**
@@ -27,9 +27,11 @@
 #include "InputState.h"
 #include "InputTarget.h"
 #include "InputThread.h"
+#include "LatencyTracker.h"
 #include "Monitor.h"
 #include "TouchState.h"
 #include "TouchedWindow.h"
+#include "WindowHitTestIndex.h"
 
 #include <input/Input.h>
 #include <input/InputApplication.h>
@@ -293,6 +295,10 @@ private:
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // Hit testing index over mWindowHandlesByDisplay, rebuilt whenever a display's windows
+    // are updated.
+    std::unordered_map<int32_t, WindowHitTestIndex> mWindowHitTestIndexByDisplay
+            GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get window handles by display, return an empty vector if not found.
@@ -435,6 +441,10 @@ private:
             REQUIRES(mLock);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
+    bool flushMotionBatchLocked(nsecs_t currentTime, const sp<Connection>& connection,
+                                std::vector<DispatchEntry*>& batchedEntries) REQUIRES(mLock);
+    void handlePublishFailureLocked(nsecs_t currentTime, const sp<Connection>& connection,
+                                    status_t status) REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                    uint32_t seq, bool handled) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
@@ -522,8 +532,13 @@ private:
     LatencyStatistics mTouchStatistics{TOUCH_STATS_REPORT_PERIOD};
 
     void reportTouchEventForStatistics(const MotionEntry& entry);
-    void reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                  const Connection& connection, bool handled);
+    void reportDispatchStatisticsLocked(const DispatchEntry& dispatchEntry,
+                                        const Connection& connection, nsecs_t finishTime,
+                                        bool handled) REQUIRES(mLock);
+
+    // Per-stage latency of the events received from InputReader.
+    LatencyTracker mLatencyTracker GUARDED_BY(mLock);
+    void trackInboundLatencyLocked(EventEntry& entry, int32_t deviceId) REQUIRES(mLock);
     void traceInboundQueueLengthLocked() REQUIRES(mLock);
     void traceOutboundQueueLength(const sp<Connection>& connection);
     void traceWaitQueueLength(const sp<Connection>& connection);
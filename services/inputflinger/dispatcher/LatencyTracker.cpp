@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LatencyTracker.h"
+
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+
+#define INDENT "  "
+#define INDENT2 "    "
+#define INDENT3 "      "
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+void LatencyTracker::trackInbound(int32_t deviceId, nsecs_t eventTime, nsecs_t enqueueTime) {
+    mInboundByDevice[deviceId].addValue(enqueueTime - eventTime);
+}
+
+void LatencyTracker::trackPublish(const sp<IBinder>& token, const std::string& name,
+                                  nsecs_t enqueueTime, nsecs_t publishTime) {
+    ConnectionLatency& latency = mLatencyByConnection[token];
+    if (latency.name.empty()) {
+        latency.name = name;
+    }
+    latency.dispatch.addValue(publishTime - enqueueTime);
+}
+
+void LatencyTracker::trackFinish(const sp<IBinder>& token, nsecs_t eventTime, nsecs_t publishTime,
+                                 nsecs_t finishTime) {
+    auto it = mLatencyByConnection.find(token);
+    if (it == mLatencyByConnection.end()) {
+        return;
+    }
+    it->second.consume.addValue(finishTime - publishTime);
+    it->second.total.addValue(finishTime - eventTime);
+}
+
+void LatencyTracker::eraseToken(const sp<IBinder>& token) {
+    mLatencyByConnection.erase(token);
+}
+
+void LatencyTracker::dump(std::string& dump) const {
+    dump += INDENT "InputLatency:\n";
+    if (mInboundByDevice.empty() && mLatencyByConnection.empty()) {
+        dump += INDENT2 "<none>\n";
+        return;
+    }
+    for (const auto& [deviceId, inbound] : mInboundByDevice) {
+        dump += StringPrintf(INDENT2 "Device %" PRId32 ": inbound: %s\n", deviceId,
+                             inbound.dump().c_str());
+    }
+    for (const auto& [token, latency] : mLatencyByConnection) {
+        dump += StringPrintf(INDENT2 "'%s':\n", latency.name.c_str());
+        dump += StringPrintf(INDENT3 "dispatch: %s\n", latency.dispatch.dump().c_str());
+        dump += StringPrintf(INDENT3 "consume: %s\n", latency.consume.dump().c_str());
+        dump += StringPrintf(INDENT3 "total: %s\n", latency.total.dump().c_str());
+    }
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+#define _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+
+#include <binder/IBinder.h>
+#include <input/LatencyHistogram.h>
+#include <utils/Timers.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace android::inputdispatcher {
+
+/**
+ * Keeps latency histograms for each stage that an input event goes through:
+ * - inbound: from the kernel timestamp of the event until the dispatcher receives it, which
+ *   covers InputReader and InputClassifier. Tracked per input device.
+ * - dispatch: from the dispatcher receiving the event until it is published to a connection.
+ * - consume: from the event being published until the connection reports it as finished.
+ * - total: from the kernel timestamp of the event until the connection finishes it.
+ * The last three are tracked per connection, while the connection is registered.
+ */
+class LatencyTracker {
+public:
+    void trackInbound(int32_t deviceId, nsecs_t eventTime, nsecs_t enqueueTime);
+    void trackPublish(const sp<IBinder>& token, const std::string& name, nsecs_t enqueueTime,
+                      nsecs_t publishTime);
+    void trackFinish(const sp<IBinder>& token, nsecs_t eventTime, nsecs_t publishTime,
+                     nsecs_t finishTime);
+    void eraseToken(const sp<IBinder>& token);
+
+    void dump(std::string& dump) const;
+
+private:
+    struct ConnectionLatency {
+        std::string name;
+        LatencyHistogram dispatch;
+        LatencyHistogram consume;
+        LatencyHistogram total;
+    };
+
+    std::unordered_map<int32_t /*deviceId*/, LatencyHistogram> mInboundByDevice;
+    std::map<sp<IBinder>, ConnectionLatency> mLatencyByConnection;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WindowHitTestIndex.h"
+
+#include <algorithm>
+
+namespace android::inputdispatcher {
+
+static Rect unionOf(const Rect& a, const Rect& b) {
+    if (a.isEmpty()) {
+        return b;
+    }
+    if (b.isEmpty()) {
+        return a;
+    }
+    return Rect(std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+                std::max(a.bottom, b.bottom));
+}
+
+/**
+ * The area in which a window can receive a touch, or obscure a window below it.
+ */
+static Rect getHitBounds(const InputWindowInfo& info) {
+    return unionOf(Rect(info.frameLeft, info.frameTop, info.frameRight, info.frameBottom),
+                   info.touchableRegion.getBounds());
+}
+
+void WindowHitTestIndex::rebuild(const std::vector<sp<InputWindowHandle>>& windowHandles) {
+    mBounds = Rect::EMPTY_RECT;
+    for (std::vector<uint32_t>& cell : mCells) {
+        cell.clear();
+    }
+    mHitAnywhere.clear();
+
+    std::vector<Rect> hitBounds(windowHandles.size(), Rect::EMPTY_RECT);
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const InputWindowInfo* info = windowHandles[i]->getInfo();
+        if (!info->visible) {
+            continue;
+        }
+        const int32_t flags = info->layoutParamsFlags;
+        const bool isTouchModal = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE) &&
+                (flags &
+                 (InputWindowInfo::FLAG_NOT_FOCUSABLE | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) ==
+                        0;
+        if (isTouchModal || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            mHitAnywhere.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+        hitBounds[i] = getHitBounds(*info);
+        mBounds = unionOf(mBounds, hitBounds[i]);
+    }
+
+    for (size_t i = 0; i < hitBounds.size(); i++) {
+        const Rect& bounds = hitBounds[i];
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        const int32_t firstColumn = getCellCoordinate(bounds.left, mBounds.left, mBounds.right);
+        const int32_t lastColumn =
+                getCellCoordinate(bounds.right - 1, mBounds.left, mBounds.right);
+        const int32_t firstRow = getCellCoordinate(bounds.top, mBounds.top, mBounds.bottom);
+        const int32_t lastRow = getCellCoordinate(bounds.bottom - 1, mBounds.top, mBounds.bottom);
+        for (int32_t row = firstRow; row <= lastRow; row++) {
+            for (int32_t column = firstColumn; column <= lastColumn; column++) {
+                mCells[static_cast<size_t>(row * GRID_SIZE + column)].push_back(
+                        static_cast<uint32_t>(i));
+            }
+        }
+    }
+}
+
+const std::vector<uint32_t>& WindowHitTestIndex::getCell(int32_t x, int32_t y) const {
+    static const std::vector<uint32_t> EMPTY;
+    if (x < mBounds.left || x >= mBounds.right || y < mBounds.top || y >= mBounds.bottom) {
+        return EMPTY;
+    }
+    const int32_t column = getCellCoordinate(x, mBounds.left, mBounds.right);
+    const int32_t row = getCellCoordinate(y, mBounds.top, mBounds.bottom);
+    return mCells[static_cast<size_t>(row * GRID_SIZE + column)];
+}
+
+/**
+ * Maps a position in [start, end) to one of the GRID_SIZE cells along that axis. The arithmetic
+ * is done in 64 bits, since touchable regions may span the whole int32_t range.
+ */
+int32_t WindowHitTestIndex::getCellCoordinate(int32_t position, int32_t start, int32_t end) {
+    const int64_t extent = static_cast<int64_t>(end) - start;
+    const int64_t offset = static_cast<int64_t>(position) - start;
+    return static_cast<int32_t>(std::clamp<int64_t>(offset * GRID_SIZE / extent, 0,
+                                                    GRID_SIZE - 1));
+}
+
+} // namespace android::inputdispatcher
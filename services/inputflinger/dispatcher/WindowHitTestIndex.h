@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_WINDOWHITTESTINDEX_H
+#define _UI_INPUT_INPUTDISPATCHER_WINDOWHITTESTINDEX_H
+
+#include <input/InputWindow.h>
+#include <ui/Rect.h>
+
+#include <array>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Spatial index over the windows of one display, used to hit test touches without visiting
+ * every window. The display area covered by the windows is split into a fixed grid, and each
+ * cell lists the windows whose frame or touchable region intersects it. Windows that can be hit
+ * anywhere (touch modal windows, and windows watching outside touches) are listed separately.
+ *
+ * Windows are identified by their position in the z-ordered vector the index was built from,
+ * and candidates are always visited front to back. The index has to be rebuilt whenever the
+ * window list or the window infos change.
+ */
+class WindowHitTestIndex {
+public:
+    void rebuild(const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+    /**
+     * Calls visitor(index) for each window that may receive or obscure a touch at (x, y), in
+     * front to back order, until the visitor returns false. Invisible windows are never visited.
+     */
+    template <typename Visitor>
+    void forEachCandidate(int32_t x, int32_t y, Visitor visitor) const {
+        const std::vector<uint32_t>& cell = getCell(x, y);
+        auto cellIt = cell.begin();
+        auto anywhereIt = mHitAnywhere.begin();
+        while (cellIt != cell.end() || anywhereIt != mHitAnywhere.end()) {
+            uint32_t index;
+            if (anywhereIt == mHitAnywhere.end() ||
+                (cellIt != cell.end() && *cellIt < *anywhereIt)) {
+                index = *cellIt++;
+            } else {
+                index = *anywhereIt++;
+            }
+            if (!visitor(static_cast<size_t>(index))) {
+                return;
+            }
+        }
+    }
+
+private:
+    static constexpr int32_t GRID_SIZE = 8;
+
+    const std::vector<uint32_t>& getCell(int32_t x, int32_t y) const;
+    static int32_t getCellCoordinate(int32_t position, int32_t start, int32_t end);
+
+    // Union of the bounds of the windows listed in mCells.
+    Rect mBounds;
+    std::array<std::vector<uint32_t>, GRID_SIZE * GRID_SIZE> mCells;
+    std::vector<uint32_t> mHitAnywhere;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_WINDOWHITTESTINDEX_H
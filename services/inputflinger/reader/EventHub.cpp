@@ -30,6 +30,7 @@
 #include <sys/ioctl.h>
 #include <sys/limits.h>
 #include <unistd.h>
+#include <algorithm>
 
 #define LOG_TAG "EventHub"
 
@@ -974,8 +975,15 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
             // This must be an input event
             if (eventItem.events & EPOLLIN) {
+                // When other devices are also ready, share the remaining buffer between them, so
+                // that a device reporting at a high rate cannot fill it and push the events of
+                // the others, e.g. a touch screen, behind all of its own. Whatever is left unread
+                // stays queued in the kernel, and is read on the next call since the fd stays
+                // readable. The order of each device's events is unchanged.
+                const size_t readyDeviceCount = mPendingEventCount - mPendingEventIndex + 1;
+                const size_t readCapacity = std::max<size_t>(1, capacity / readyDeviceCount);
                 int32_t readSize =
-                        read(device->fd, readBuffer, sizeof(struct input_event) * capacity);
+                        read(device->fd, readBuffer, sizeof(struct input_event) * readCapacity);
                 if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
                     // Device was removed before INotify noticed.
                     ALOGW("could not get event, removed? (fd: %d size: %" PRId32
@@ -26,6 +26,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <iostream>
+#include <mutex>
 
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
@@ -36,6 +37,53 @@ using android::base::unique_fd;
 
 namespace android {
 
+/**
+ * Frames are queued, rotated and passed to the input classifier on another thread, so they
+ * can't reference the v4l2 buffers, which must be returned to the driver right away. Instead,
+ * each frame is copied once into a buffer from this pool, which gets the buffer back when the
+ * last frame referencing it is destroyed. Frames may outlive the device, so the buffers keep
+ * the pool alive rather than the other way around.
+ */
+class TouchVideoDevice::BufferPool : public std::enable_shared_from_this<BufferPool> {
+public:
+    explicit BufferPool(size_t bufferSize) : mBufferSize(bufferSize) {}
+
+    std::shared_ptr<std::vector<int16_t>> acquire() {
+        std::unique_ptr<std::vector<int16_t>> buffer;
+        {
+            std::scoped_lock lock(mLock);
+            if (!mFreeBuffers.empty()) {
+                buffer = std::move(mFreeBuffers.back());
+                mFreeBuffers.pop_back();
+            }
+        }
+        if (!buffer) {
+            buffer = std::make_unique<std::vector<int16_t>>(mBufferSize);
+        }
+        return std::shared_ptr<std::vector<int16_t>>(buffer.release(),
+                                                     [pool = shared_from_this()](
+                                                             std::vector<int16_t>* released) {
+                                                         pool->release(released);
+                                                     });
+    }
+
+private:
+    // Enough for a full frame queue, plus the frames that are on their way to the classifier.
+    static constexpr size_t MAX_FREE_BUFFERS = 2 * MAX_QUEUE_SIZE;
+
+    const size_t mBufferSize;
+    std::mutex mLock;
+    std::vector<std::unique_ptr<std::vector<int16_t>>> mFreeBuffers; // guarded by mLock
+
+    void release(std::vector<int16_t>* buffer) {
+        std::unique_ptr<std::vector<int16_t>> owned(buffer);
+        std::scoped_lock lock(mLock);
+        if (mFreeBuffers.size() < MAX_FREE_BUFFERS) {
+            mFreeBuffers.push_back(std::move(owned));
+        }
+    }
+};
+
 TouchVideoDevice::TouchVideoDevice(int fd, std::string&& name, std::string&& devicePath,
                                    uint32_t height, uint32_t width,
                                    const std::array<const int16_t*, NUM_BUFFERS>& readLocations)
@@ -44,7 +92,8 @@ TouchVideoDevice::TouchVideoDevice(int fd, std::string&& name, std::string&& dev
         mPath(std::move(devicePath)),
         mHeight(height),
         mWidth(width),
-        mReadLocations(readLocations) {
+        mReadLocations(readLocations),
+        mBufferPool(std::make_shared<BufferPool>(height * width)) {
     mFrames.reserve(MAX_QUEUE_SIZE);
 };
 
@@ -200,10 +249,11 @@ std::optional<TouchVideoFrame> TouchVideoDevice::readFrame() {
         ALOGW("The timestamp %ld.%ld was not acquired using CLOCK_MONOTONIC", buf.timestamp.tv_sec,
               buf.timestamp.tv_usec);
     }
-    std::vector<int16_t> data(mHeight * mWidth);
+    std::shared_ptr<std::vector<int16_t>> data = mBufferPool->acquire();
     const int16_t* readFrom = mReadLocations[buf.index];
-    std::copy(readFrom, readFrom + mHeight * mWidth, data.begin());
-    TouchVideoFrame frame(mHeight, mWidth, std::move(data), buf.timestamp);
+    std::copy(readFrom, readFrom + mHeight * mWidth, data->begin());
+    TouchVideoFrame frame =
+            TouchVideoFrame::fromSharedData(mHeight, mWidth, std::move(data), buf.timestamp);
 
     result = ioctl(mFd.get(), VIDIOC_QBUF, &buf);
     if (result == -1) {
@@ -468,8 +468,10 @@ private:
     int mInputWd;
     int mVideoWd;
 
-    // Maximum number of signalled FDs to handle at a time.
-    static const int EPOLL_MAX_EVENTS = 16;
+    // Maximum number of signalled FDs to handle at a time. This is large enough for every device
+    // that is ready after a wakeup to be harvested by a single epoll_wait, even with touch video
+    // devices and many external peripherals attached.
+    static const int EPOLL_MAX_EVENTS = 64;
 
     // The array of pending epoll events and the index of the next event to be handled.
     struct epoll_event mPendingEventItems[EPOLL_MAX_EVENTS];
@@ -21,6 +21,7 @@
 #include <input/TouchVideoFrame.h>
 #include <stdint.h>
 #include <array>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -104,6 +105,11 @@ private:
      */
     static constexpr size_t MAX_QUEUE_SIZE = 20;
     std::vector<TouchVideoFrame> mFrames;
+    /**
+     * Recycles the buffers that frames are read into, once the frames are gone.
+     */
+    class BufferPool;
+    std::shared_ptr<BufferPool> mBufferPool;
 
     /**
      * The constructor is private because opening a v4l2 device requires many checks.
@@ -71,6 +71,10 @@ int32_t JoystickInputMapper::getCompatAxis(int32_t axis) {
 void JoystickInputMapper::dump(std::string& dump) {
     dump += INDENT2 "Joystick Input Mapper:\n";
 
+    if (mMinReportInterval > 0) {
+        dump += StringPrintf(INDENT3 "MinReportInterval: %0.3fms\n", mMinReportInterval * 1e-6);
+    }
+
     dump += INDENT3 "Axes:\n";
     size_t numAxes = mAxes.size();
     for (size_t i = 0; i < numAxes; i++) {
@@ -111,6 +115,12 @@ void JoystickInputMapper::configure(nsecs_t when, const InputReaderConfiguration
     InputMapper::configure(when, config, changes);
 
     if (!changes) { // first time only
+        // High rate gamepads report at up to 1kHz, far more often than apps can use.
+        float maxReportRate = 0;
+        getDeviceContext().getConfiguration().tryGetProperty(String8("joystick.maxReportRate"),
+                                                             maxReportRate);
+        mMinReportInterval = maxReportRate > 0 ? static_cast<nsecs_t>(1e9 / maxReportRate) : 0;
+
         // Collect all axes.
         for (int32_t abs = 0; abs <= ABS_MAX; abs++) {
             if (!(getAbsAxisUsage(abs, getDeviceContext().getDeviceClasses()) &
@@ -248,6 +258,8 @@ void JoystickInputMapper::reset(nsecs_t when) {
         Axis& axis = mAxes.editValueAt(i);
         axis.resetValue();
     }
+    mPendingReportTime.reset();
+    mNextReportTime = 0;
 
     InputMapper::reset(when);
 }
@@ -301,11 +313,39 @@ void JoystickInputMapper::process(const RawEvent* rawEvent) {
     }
 }
 
+void JoystickInputMapper::timeoutExpired(nsecs_t when) {
+    if (!mPendingReportTime) {
+        return;
+    }
+    if (when >= mNextReportTime) {
+        notifyMotion(*mPendingReportTime);
+    } else {
+        // Woken up for another device's timeout.
+        getContext()->requestTimeoutAtTime(mNextReportTime);
+    }
+}
+
 void JoystickInputMapper::sync(nsecs_t when, bool force) {
-    if (!filterAxes(force)) {
+    if (filterAxes(force)) {
+        mPendingReportTime = when;
+    }
+    if (!mPendingReportTime) {
         return;
     }
 
+    if (!force && when < mNextReportTime) {
+        // Report the latest values once the interval is over, unless the device reports again
+        // by then.
+        getContext()->requestTimeoutAtTime(mNextReportTime);
+        return;
+    }
+    notifyMotion(when);
+}
+
+void JoystickInputMapper::notifyMotion(nsecs_t when) {
+    mNextReportTime = when + mMinReportInterval;
+    mPendingReportTime.reset();
+
     int32_t metaState = getContext()->getGlobalMetaState();
     int32_t buttonState = 0;
 
@@ -17,6 +17,8 @@
 #ifndef _UI_INPUTREADER_JOYSTICK_INPUT_MAPPER_H
 #define _UI_INPUTREADER_JOYSTICK_INPUT_MAPPER_H
 
+#include <optional>
+
 #include "InputMapper.h"
 
 namespace android {
@@ -33,6 +35,7 @@ public:
                            uint32_t changes) override;
     virtual void reset(nsecs_t when) override;
     virtual void process(const RawEvent* rawEvent) override;
+    virtual void timeoutExpired(nsecs_t when) override;
 
 private:
     struct Axis {
@@ -89,7 +92,16 @@ private:
     // Axes indexed by raw ABS_* axis index.
     KeyedVector<int32_t, Axis> mAxes;
 
+    // Minimum time between motion events, from the joystick.maxReportRate property.
+    // Changes within the interval are coalesced into the next event. Zero if not limited.
+    nsecs_t mMinReportInterval = 0;
+    // Earliest time of the next motion event.
+    nsecs_t mNextReportTime = 0;
+    // Time of the latest axis values that were not reported yet, if any.
+    std::optional<nsecs_t> mPendingReportTime;
+
     void sync(nsecs_t when, bool force);
+    void notifyMotion(nsecs_t when);
 
     bool haveAxis(int32_t axisId);
     void pruneAxes(bool ignoreExplicitlyMappedAxes);
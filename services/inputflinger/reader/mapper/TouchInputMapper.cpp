@@ -2030,8 +2030,20 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
-    // Walk through the the active pointers and map device coordinates onto
-    // surface coordinates and adjust for display orientation.
+    // Map the device coordinates of all pointers onto surface coordinates up front. Keeping the
+    // coordinates in their own arrays lets the transforms run as tight loops over every pointer.
+    float xTransformed[MAX_POINTERS], yTransformed[MAX_POINTERS];
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        xTransformed[i] = mCurrentRawState.rawPointerData.pointers[i].x;
+        yTransformed[i] = mCurrentRawState.rawPointerData.pointers[i].y;
+    }
+    applyAffineTransform(xTransformed, yTransformed, currentPointerCount);
+    rotateAndScale(xTransformed, yTransformed, currentPointerCount);
+
+    const uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
+
+    // Walk through the the active pointers and compute the remaining axes, adjusting them for
+    // display orientation.
     for (uint32_t i = 0; i < currentPointerCount; i++) {
         const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
 
@@ -2073,7 +2085,6 @@ void TouchInputMapper::cookPointerData() {
                 }
 
                 if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                    uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
                     if (touchingCount > 1) {
                         touchMajor /= touchingCount;
                         touchMinor /= touchingCount;
@@ -2185,13 +2196,8 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
-        // Adjust X,Y coords for device calibration
-        // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
-        rotateAndScale(xTransformed, yTransformed);
-
-        // Adjust X, Y, and coverage coords for surface orientation.
+        // Adjust coverage coords for surface orientation.
+        // TODO: Adjust coverage coords for device calibration?
         float left, top, right, bottom;
 
         switch (mSurfaceOrientation) {
@@ -2240,25 +2246,30 @@ void TouchInputMapper::cookPointerData() {
         }
 
         // Write output coords.
+        // The axes are set in ascending order so that each value is appended to the packed
+        // values array instead of shifting the values that were already set.
+        const bool coverageIsBox =
+                mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX;
         PointerCoords& out = mCurrentCookedState.cookedPointerData.pointerCoords[i];
         out.clear();
-        out.setAxisValue(AMOTION_EVENT_AXIS_X, xTransformed);
-        out.setAxisValue(AMOTION_EVENT_AXIS_Y, yTransformed);
+        out.setAxisValue(AMOTION_EVENT_AXIS_X, xTransformed[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_Y, yTransformed[i]);
         out.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pressure);
         out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor);
+        if (!coverageIsBox) {
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
+        }
         out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
         out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
-        if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
+        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
+        if (coverageIsBox) {
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom);
-        } else {
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
         }
 
         // Write output properties.
@@ -3619,33 +3630,54 @@ void TouchInputMapper::cancelTouch(nsecs_t when) {
     abortTouches(when, 0 /* policyFlags*/);
 }
 
-// Transform raw coordinate to surface coordinate
-void TouchInputMapper::rotateAndScale(float& x, float& y) {
-    // Scale to surface coordinate.
-    const float xScaled = float(x - mRawPointerAxes.x.minValue) * mXScale;
-    const float yScaled = float(y - mRawPointerAxes.y.minValue) * mYScale;
+// Apply the device calibration to raw coordinates
+void TouchInputMapper::applyAffineTransform(float* x, float* y, uint32_t count) const {
+    const TouchAffineTransformation& t = mAffineTransform;
+    for (uint32_t i = 0; i < count; i++) {
+        const float newX = x[i] * t.x_scale + y[i] * t.x_ymix + t.x_offset;
+        const float newY = x[i] * t.y_xmix + y[i] * t.y_scale + t.y_offset;
+        x[i] = newX;
+        y[i] = newY;
+    }
+}
+
+// Transform raw coordinates to surface coordinates
+void TouchInputMapper::rotateAndScale(float* x, float* y, uint32_t count) const {
+    const float xMin = mRawPointerAxes.x.minValue;
+    const float yMin = mRawPointerAxes.y.minValue;
 
-    // Rotate to surface coordinate.
+    // Scale to surface coordinate, then rotate to surface coordinate.
     // 0 - no swap and reverse.
     // 90 - swap x/y and reverse y.
     // 180 - reverse x, y.
     // 270 - swap x/y and reverse x.
+    // The orientation is resolved once per call so that each case is a branchless loop.
     switch (mSurfaceOrientation) {
         case DISPLAY_ORIENTATION_0:
-            x = xScaled + mXTranslate;
-            y = yScaled + mYTranslate;
+            for (uint32_t i = 0; i < count; i++) {
+                x[i] = (x[i] - xMin) * mXScale + mXTranslate;
+                y[i] = (y[i] - yMin) * mYScale + mYTranslate;
+            }
             break;
         case DISPLAY_ORIENTATION_90:
-            y = mSurfaceRight - xScaled;
-            x = yScaled + mYTranslate;
+            for (uint32_t i = 0; i < count; i++) {
+                const float xScaled = (x[i] - xMin) * mXScale;
+                x[i] = (y[i] - yMin) * mYScale + mYTranslate;
+                y[i] = mSurfaceRight - xScaled;
+            }
             break;
         case DISPLAY_ORIENTATION_180:
-            x = mSurfaceRight - xScaled;
-            y = mSurfaceBottom - yScaled;
+            for (uint32_t i = 0; i < count; i++) {
+                x[i] = mSurfaceRight - (x[i] - xMin) * mXScale;
+                y[i] = mSurfaceBottom - (y[i] - yMin) * mYScale;
+            }
             break;
         case DISPLAY_ORIENTATION_270:
-            y = xScaled + mXTranslate;
-            x = mSurfaceBottom - yScaled;
+            for (uint32_t i = 0; i < count; i++) {
+                const float xScaled = (x[i] - xMin) * mXScale;
+                x[i] = mSurfaceBottom - (y[i] - yMin) * mYScale;
+                y[i] = xScaled + mXTranslate;
+            }
             break;
         default:
             assert(false);
@@ -761,7 +761,8 @@ private:
     static void assignPointerIds(const RawState* last, RawState* current);
 
     const char* modeToString(DeviceMode deviceMode);
-    void rotateAndScale(float& x, float& y);
+    void applyAffineTransform(float* x, float* y, uint32_t count) const;
+    void rotateAndScale(float* x, float* y, uint32_t count) const;
 };
 
 } // namespace android
@@ -272,4 +272,14 @@ TEST_F(MotionClassifierTest, DeviceReset_DoesNotCrash) {
     ASSERT_NO_FATAL_FAILURE(mMotionClassifier->reset(args));
 }
 
+/**
+ * The HAL latency statistics are part of the dump, even before any event was classified.
+ */
+TEST_F(MotionClassifierTest, Dump_ReportsHalLatency) {
+    std::string dump;
+    mMotionClassifier->dump(dump);
+    ASSERT_NE(std::string::npos, dump.find("HAL classify latency: count="));
+    ASSERT_NE(std::string::npos, dump.find("Classification delay: count="));
+}
+
 } // namespace android
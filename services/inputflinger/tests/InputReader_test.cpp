@@ -20,6 +20,7 @@
 #include <InputReader.h>
 #include <InputReaderBase.h>
 #include <InputReaderFactory.h>
+#include <JoystickInputMapper.h>
 #include <KeyboardInputMapper.h>
 #include <MultiTouchInputMapper.h>
 #include <SingleTouchInputMapper.h>
@@ -3015,6 +3016,45 @@ TEST_F(KeyboardInputMapperTest_ExternalDevice, DoNotWakeByDefaultBehavior) {
     ASSERT_EQ(POLICY_FLAG_WAKE, args.policyFlags);
 }
 
+// --- JoystickInputMapperTest ---
+
+class JoystickInputMapperTest : public InputMapperTest {
+protected:
+    void SetUp() override {
+        InputMapperTest::SetUp(INPUT_DEVICE_CLASS_JOYSTICK);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_X, -100, 100, 0, 0);
+    }
+};
+
+TEST_F(JoystickInputMapperTest, Process_MaxReportRate_CoalescesMotion) {
+    addConfigurationProperty("joystick.maxReportRate", "100");
+    JoystickInputMapper& mapper = addMapperAndConfigure<JoystickInputMapper>();
+
+    NotifyMotionArgs args;
+    process(mapper, ARBITRARY_TIME, EV_ABS, ABS_X, 50);
+    process(mapper, ARBITRARY_TIME, EV_SYN, SYN_REPORT, 0);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    ASSERT_EQ(ARBITRARY_TIME, args.eventTime);
+
+    // Within 10ms of the last report, so held back.
+    process(mapper, ARBITRARY_TIME + ms2ns(1), EV_ABS, ABS_X, 60);
+    process(mapper, ARBITRARY_TIME + ms2ns(1), EV_SYN, SYN_REPORT, 0);
+    process(mapper, ARBITRARY_TIME + ms2ns(2), EV_ABS, ABS_X, 70);
+    process(mapper, ARBITRARY_TIME + ms2ns(2), EV_SYN, SYN_REPORT, 0);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
+
+    // Only the latest values are reported once the interval is over.
+    mapper.timeoutExpired(ARBITRARY_TIME + ms2ns(10));
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    ASSERT_EQ(ARBITRARY_TIME + ms2ns(2), args.eventTime);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
+
+    process(mapper, ARBITRARY_TIME + ms2ns(25), EV_ABS, ABS_X, 80);
+    process(mapper, ARBITRARY_TIME + ms2ns(25), EV_SYN, SYN_REPORT, 0);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    ASSERT_EQ(ARBITRARY_TIME + ms2ns(25), args.eventTime);
+}
+
 // --- CursorInputMapperTest ---
 
 class CursorInputMapperTest : public InputMapperTest {
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/WindowHitTestIndex.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- WindowHitTestIndexTest ---
+
+class TestWindowHandle : public InputWindowHandle {
+public:
+    TestWindowHandle(const Rect& frame, int32_t flags) {
+        mInfo.visible = true;
+        mInfo.layoutParamsFlags = flags;
+        mInfo.frameLeft = frame.left;
+        mInfo.frameTop = frame.top;
+        mInfo.frameRight = frame.right;
+        mInfo.frameBottom = frame.bottom;
+        mInfo.touchableRegion = Region(frame);
+    }
+
+    bool updateInfo() override { return true; }
+
+    InputWindowInfo* editInfo() { return &mInfo; }
+};
+
+static constexpr int32_t NOT_TOUCH_MODAL = InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+
+static std::vector<size_t> getCandidates(const WindowHitTestIndex& index, int32_t x, int32_t y) {
+    std::vector<size_t> candidates;
+    index.forEachCandidate(x, y, [&](size_t i) {
+        candidates.push_back(i);
+        return true;
+    });
+    return candidates;
+}
+
+TEST(WindowHitTestIndexTest, OnlyVisitsWindowsAtPoint) {
+    std::vector<sp<InputWindowHandle>> windows = {
+            new TestWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+            new TestWindowHandle(Rect(900, 900, 1000, 1000), NOT_TOUCH_MODAL),
+            new TestWindowHandle(Rect(0, 0, 1000, 1000), NOT_TOUCH_MODAL),
+    };
+    WindowHitTestIndex index;
+    index.rebuild(windows);
+
+    EXPECT_EQ((std::vector<size_t>{0, 2}), getCandidates(index, 50, 50));
+    EXPECT_EQ((std::vector<size_t>{1, 2}), getCandidates(index, 950, 950));
+    EXPECT_EQ((std::vector<size_t>{2}), getCandidates(index, 500, 500));
+    EXPECT_TRUE(getCandidates(index, 2000, 2000).empty());
+}
+
+TEST(WindowHitTestIndexTest, TouchModalAndOutsideWatchersAreVisitedInOrder) {
+    std::vector<sp<InputWindowHandle>> windows = {
+            new TestWindowHandle(Rect(0, 0, 10, 10),
+                                 NOT_TOUCH_MODAL | InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH),
+            new TestWindowHandle(Rect(500, 500, 600, 600), NOT_TOUCH_MODAL),
+            new TestWindowHandle(Rect(0, 0, 10, 10), 0),
+    };
+    WindowHitTestIndex index;
+    index.rebuild(windows);
+
+    EXPECT_EQ((std::vector<size_t>{0, 1, 2}), getCandidates(index, 550, 550));
+    EXPECT_EQ((std::vector<size_t>{0, 2}), getCandidates(index, 5000, 5000));
+}
+
+TEST(WindowHitTestIndexTest, SkipsInvisibleWindows) {
+    sp<TestWindowHandle> hidden = new TestWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL);
+    hidden->editInfo()->visible = false;
+    std::vector<sp<InputWindowHandle>> windows = {
+            hidden,
+            new TestWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+    };
+    WindowHitTestIndex index;
+    index.rebuild(windows);
+
+    EXPECT_EQ((std::vector<size_t>{1}), getCandidates(index, 50, 50));
+}
+
+TEST(WindowHitTestIndexTest, HandlesUnboundedTouchableRegion) {
+    sp<TestWindowHandle> window = new TestWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL);
+    window->editInfo()->touchableRegion =
+            Region(Rect(INT32_MIN / 2, INT32_MIN / 2, INT32_MAX / 2, INT32_MAX / 2));
+    std::vector<sp<InputWindowHandle>> windows = {
+            window,
+            new TestWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+    };
+    WindowHitTestIndex index;
+    index.rebuild(windows);
+
+    EXPECT_EQ((std::vector<size_t>{0, 1}), getCandidates(index, 50, 50));
+    EXPECT_EQ((std::vector<size_t>{0}), getCandidates(index, -100000, 100000));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
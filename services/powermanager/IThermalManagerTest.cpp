@@ -17,6 +17,7 @@
 #define LOG_TAG "ThermalManagerTest"
 //#define LOG_NDEBUG 0
 
+#include <cmath>
 #include <thread>
 
 #include <android/os/BnThermalStatusListener.h>
@@ -27,6 +28,7 @@
 #include <condition_variable>
 #include <gtest/gtest.h>
 #include <powermanager/PowerManager.h>
+#include <powermanager/ThermalHeadroom.h>
 #include <utils/Log.h>
 
 using namespace android;
@@ -145,6 +147,17 @@ INSTANTIATE_TEST_SUITE_P(TestStatusLevels, IThermalLevelTest, testing::Range(
         static_cast<int>(ThermalStatus::THERMAL_STATUS_SHUTDOWN)),
         IThermalLevelTest::PrintParam);
 
+TEST(ThermalHeadroomTest, CachesHeadroom) {
+    ThermalHeadroom& thermalHeadroom = ThermalHeadroom::getInstance();
+    float headroom = thermalHeadroom.getHeadroom();
+    if (std::isnan(headroom)) {
+        GTEST_SKIP() << "Thermal headroom not supported";
+    }
+    EXPECT_GE(headroom, 0.f);
+    // Queried again within the cache duration, so the same value is returned.
+    EXPECT_EQ(headroom, thermalHeadroom.getHeadroom());
+}
+
 int main(int argc, char **argv) {
     std::unique_ptr<std::thread> binderLoop;
     binderLoop = std::make_unique<std::thread>(
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThermalHeadroom"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <cmath>
+#include <limits>
+
+#include <android/os/IThermalService.h>
+#include <binder/IServiceManager.h>
+
+#include <powermanager/ThermalHeadroom.h>
+
+namespace android {
+
+ThermalHeadroom& ThermalHeadroom::getInstance() {
+    static ThermalHeadroom instance;
+    return instance;
+}
+
+sp<os::IThermalService> ThermalHeadroom::getThermalServiceLocked() {
+    if (mThermalService == nullptr) {
+        // Don't block callers if the thermal service is not up yet.
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16("thermalservice"));
+        if (binder != nullptr) {
+            mThermalService = interface_cast<os::IThermalService>(binder);
+        }
+    }
+    return mThermalService;
+}
+
+float ThermalHeadroom::getHeadroom(int forecastSeconds) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (forecastSeconds == mForecastSeconds && now - mUpdateTime < CACHE_DURATION) {
+        return mHeadroom;
+    }
+
+    // Failures are cached as well, so that a missing service is not looked up on every call.
+    float headroom = std::numeric_limits<float>::quiet_NaN();
+    sp<os::IThermalService> service = getThermalServiceLocked();
+    if (service != nullptr) {
+        binder::Status status = service->getThermalHeadroom(forecastSeconds, &headroom);
+        if (!status.isOk()) {
+            ALOGV("Failed to get thermal headroom: %s", status.toString8().c_str());
+            headroom = std::numeric_limits<float>::quiet_NaN();
+            // Look the service up again next time, in case it restarted.
+            mThermalService = nullptr;
+        }
+    }
+
+    mForecastSeconds = forecastSeconds;
+    mHeadroom = headroom;
+    mUpdateTime = now;
+    return headroom;
+}
+
+bool ThermalHeadroom::shouldDeferBackgroundWork(int forecastSeconds) {
+    const float headroom = getHeadroom(forecastSeconds);
+    return !std::isnan(headroom) && headroom >= BACKGROUND_WORK_THRESHOLD;
+}
+
+}; // namespace android
@@ -465,9 +465,10 @@ void Fusion::predict(const vec3_t& w, float dT) {
     const mat33_t I33dT(dT);
     const mat33_t wx(crossMatrix(we, 0));
     const mat33_t wx2(wx*wx);
-    const float lwedT = length(we)*dT;
+    const float lwe = length(we);
+    const float lwedT = lwe*dT;
     const float hlwedT = 0.5f*lwedT;
-    const float ilwe = 1.f/length(we);
+    const float ilwe = 1.f/lwe;
     const float k0 = (1-cosf(lwedT))*(ilwe*ilwe);
     const float k1 = sinf(lwedT);
     const float k2 = cosf(hlwedT);
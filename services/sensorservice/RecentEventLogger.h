@@ -24,6 +24,7 @@
 #include <utils/String8.h>
 
 #include <mutex>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -53,11 +54,15 @@ public:
 
 protected:
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
+        SensorEventLog(const sensors_event_t& e, const timespec& wallTime);
         timespec mWallTime;
         sensors_event_t mEvent;
     };
 
+    // Copies the recorded events, most recent first. mLock is only held for the copy, so that
+    // formatting a dump never blocks addEvent on the sensor thread.
+    std::vector<SensorEventLog> copyRecentEvents() const;
+
     const int mSensorType;
     const size_t mEventSize;
 
@@ -176,6 +176,8 @@ void SensorDevice::initializeSensorList() {
                     }
                     mSensorList.push_back(sensor);
 
+                    model.isWakeUpSensor = (sensor.flags & SENSOR_FLAG_WAKE_UP) != 0;
+                    model.fifoMaxEventCount = sensor.fifoMaxEventCount;
                     mActivationCount.add(list[i].sensorHandle, model);
 
                     // Only disable all sensors on HAL 1.0 since HAL 2.0
@@ -1124,6 +1126,19 @@ void SensorDevice::Info::selectBatchParams() {
         }
         bestParams.merge(batchParams[i]);
     }
+    if (isWakeUpSensor) {
+        // Every expiry of the batch latency of a wake-up sensor wakes up the AP. A latency longer
+        // than the FIFO can hold would wake it up anyway when the FIFO fills, at a time that is
+        // not aligned with the other sensors, so cap it first. Rounding the latency down keeps
+        // every client's requested latency.
+        if (fifoMaxEventCount > 0 && bestParams.mTSample < INT64_MAX / fifoMaxEventCount) {
+            bestParams.mTBatch =
+                    std::min(bestParams.mTBatch, bestParams.mTSample * fifoMaxEventCount);
+        }
+        if (bestParams.mTBatch >= BATCH_LATENCY_ALIGNMENT) {
+            bestParams.mTBatch -= bestParams.mTBatch % BATCH_LATENCY_ALIGNMENT;
+        }
+    }
     // if mTBatch <= mTSample, it is in streaming mode. set mTbatch to 0 to demand this explicitly.
     if (bestParams.mTBatch <= bestParams.mTSample) {
         bestParams.mTBatch = 0;
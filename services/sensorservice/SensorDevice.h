@@ -136,6 +136,9 @@ private:
     std::unordered_map<int32_t, sensor_t*> mConnectedDynamicSensors;
 
     static const nsecs_t MINIMUM_EVENTS_PERIOD =   1000000; // 1000 Hz
+    // Batch latencies of wake-up sensors are rounded down to a multiple of this, so that the
+    // sensors batching for similar latencies wake up the AP together.
+    static const nsecs_t BATCH_LATENCY_ALIGNMENT = 1000000000; // 1 s
     mutable Mutex mLock; // protect mActivationCount[].batchParams
     // fixed-size array after construction
 
@@ -172,6 +175,10 @@ private:
         // Flag to track if the sensor is active
         bool isActive = false;
 
+        // Properties of the sensor used to select the batch latency.
+        bool isWakeUpSensor = false;
+        uint32_t fifoMaxEventCount = 0;
+
         // Sets batch parameters for this ident. Returns error if this ident is not already present
         // in the KeyedVector above.
         status_t setBatchParamsForIdent(void* ident, int flags, int64_t samplingPeriodNs,
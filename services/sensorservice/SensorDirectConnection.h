@@ -34,6 +34,13 @@ namespace android {
 class SensorService;
 class BitTube;
 
+// A direct report channel into memory supplied by the client.
+//
+// Every connection registers its own HAL channel. The HAL writes events straight into the
+// client's memory, and the client reads them back with its own cursor, so connections that
+// request the same sensor at the same rate cannot share a channel: the memory belongs to,
+// and is only mapped by, one client. Sharing would need memory owned by the service and
+// handed out read-only, which the createSensorDirectConnection API does not allow for.
 class SensorService::SensorDirectConnection: public BnSensorEventConnection {
 public:
     SensorDirectConnection(const sp<SensorService>& service, uid_t uid,
@@ -29,6 +29,14 @@
 
 namespace android {
 
+// Returns true if the event is a regular event of the sensor, or a flush complete event for it.
+static bool isEventOfSensor(const sensors_event_t& event, int32_t sensorHandle) {
+    if (event.type == SENSOR_TYPE_META_DATA) {
+        return event.meta_data.sensor == sensorHandle;
+    }
+    return event.sensor == sensorHandle;
+}
+
 SensorService::SensorEventConnection::SensorEventConnection(
         const sp<SensorService>& service, uid_t uid, String8 packageName, bool isDataInjectionMode,
         const String16& opPackageName)
@@ -293,6 +301,10 @@ status_t SensorService::SensorEventConnection::sendEvents(
 
     std::unique_ptr<sensors_event_t[]> sanitizedBuffer;
 
+    // Checking the access looks up the uid state and the sensor privacy policy, so do it once for
+    // the whole buffer rather than for every event.
+    const bool hasAccess = hasSensorAccess();
+
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
     if (scratch) {
@@ -308,14 +320,17 @@ status_t SensorService::SensorEventConnection::sendEvents(
                 sensor_handle = buffer[i].meta_data.sensor;
             }
 
-            // Check if this connection has registered for this sensor. If not continue to the
-            // next sensor_event.
-            if (mSensorInfo.count(sensor_handle) == 0) {
-                ++i;
+            // Check if this connection has registered for this sensor. If not, skip all of the
+            // consecutive events of this sensor at once.
+            auto sensorInfo = mSensorInfo.find(sensor_handle);
+            if (sensorInfo == mSensorInfo.end()) {
+                do {
+                    i++;
+                } while (i < numEvents && isEventOfSensor(buffer[i], sensor_handle));
                 continue;
             }
 
-            FlushInfo& flushInfo = mSensorInfo[sensor_handle];
+            FlushInfo& flushInfo = sensorInfo->second;
             // Check if there is a pending flush_complete event for this sensor on this connection.
             if (buffer[i].type == SENSOR_TYPE_META_DATA && flushInfo.mFirstFlushPending == true &&
                     mapFlushEventsToConnections[i] == this) {
@@ -345,18 +360,15 @@ status_t SensorService::SensorEventConnection::sendEvents(
                 } else {
                     // Regular sensor event, just copy it to the scratch buffer after checking
                     // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
+                    if (hasAccess && noteOpIfRequired(buffer[i])) {
                         scratch[count++] = buffer[i];
                     }
                 }
                 i++;
-            } while ((i<numEvents) && ((buffer[i].sensor == sensor_handle &&
-                                        buffer[i].type != SENSOR_TYPE_META_DATA) ||
-                                       (buffer[i].type == SENSOR_TYPE_META_DATA  &&
-                                        buffer[i].meta_data.sensor == sensor_handle)));
+            } while ((i<numEvents) && isEventOfSensor(buffer[i], sensor_handle));
         }
     } else {
-        if (hasSensorAccess()) {
+        if (hasAccess) {
             scratch = const_cast<sensors_event_t *>(buffer);
             count = numEvents;
         } else {
@@ -387,7 +399,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
     }
 
     int index_wake_up_event = -1;
-    if (hasSensorAccess()) {
+    if (hasAccess) {
         index_wake_up_event = findWakeUpSensorEventLocked(scratch, count);
         if (index_wake_up_event >= 0) {
             scratch[index_wake_up_event].flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
@@ -461,9 +473,9 @@ bool SensorService::SensorEventConnection::noteOpIfRequired(const sensors_event_
 }
 
 void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t const* scratch,
-                                                                 int count) {
+                                                                 int count,
+                                                                 int new_cache_size) {
     sensors_event_t *eventCache_new;
-    const int new_cache_size = computeMaxCacheSizeLocked();
     // Allocate new cache, copy over events from the old cache & scratch, free up memory.
     eventCache_new = new sensors_event_t[new_cache_size];
     memcpy(eventCache_new, mEventCache, mCacheSize * sizeof(sensors_event_t));
@@ -486,9 +498,15 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
         // The events fit within the current cache: add them
         memcpy(&mEventCache[mCacheSize], events, count * sizeof(sensors_event_t));
         mCacheSize += count;
-    } else if (mCacheSize + count <= computeMaxCacheSizeLocked()) {
+        return;
+    }
+
+    // Computing the max cache size looks up every registered sensor, so only do it once per call.
+    // While a client is not reading, this runs for every batch of events sent to it.
+    const int maxCacheSize = computeMaxCacheSizeLocked();
+    if (mCacheSize + count <= maxCacheSize) {
         // The events fit within a resized cache: resize the cache and add the events
-        reAllocateCacheLocked(events, count);
+        reAllocateCacheLocked(events, count, maxCacheSize);
     } else {
         // The events do not fit within the cache: drop the oldest events.
         int freeSpace = mMaxCacheSize - mCacheSize;
@@ -103,9 +103,10 @@ private:
     // amongst wake-up sensors and non-wake up sensors.
     int computeMaxCacheSizeLocked() const;
 
-    // When more sensors register, the maximum cache size desired may change.  Compute max cache
-    // size, reallocate memory and copy over events from the older cache.
-    void reAllocateCacheLocked(sensors_event_t const* scratch, int count);
+    // When more sensors register, the maximum cache size desired may change. Reallocate memory
+    // for the new max cache size, as returned by computeMaxCacheSizeLocked, and copy over events
+    // from the older cache.
+    void reAllocateCacheLocked(sensors_event_t const* scratch, int count, int new_cache_size);
 
     // Add the events to the cache. If the cache would be exceeded, drop events at the beginning of
     // the cache.
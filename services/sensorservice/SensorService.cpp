@@ -50,6 +50,7 @@
 #include "SensorRecord.h"
 #include "SensorRegistrationInfo.h"
 
+#include <algorithm>
 #include <ctime>
 #include <inttypes.h>
 #include <math.h>
@@ -377,6 +378,16 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
         if (args.size() > 2) {
            return INVALID_OPERATION;
         }
+        if (args.size() == 1 && args[0] == String16("--proto")) {
+            // Only hold mLock while collecting the state. Writing to fd waits on the reader,
+            // which must not stall sensor delivery.
+            util::ProtoOutputStream proto;
+            {
+                ConnectionSafeAutolock connLock = mConnectionHolder.lock(mLock);
+                dumpProtoLocked(&connLock, &proto);
+            }
+            return proto.flush(fd) ? OK : UNKNOWN_ERROR;
+        }
         ConnectionSafeAutolock connLock = mConnectionHolder.lock(mLock);
         SensorDevice& dev(SensorDevice::getInstance());
         if (args.size() == 2 && args[0] == String16("restrict")) {
@@ -425,8 +436,6 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
                 // Transition to data injection mode supported only from NORMAL mode.
                 return INVALID_OPERATION;
             }
-        } else if (args.size() == 1 && args[0] == String16("--proto")) {
-            return dumpProtoLocked(fd, &connLock);
         } else if (!mSensors.hasAnySensor()) {
             result.append("No Sensors on the device\n");
             result.appendFormat("devInitCheck : %d\n", SensorDevice::getInstance().initCheck());
@@ -536,12 +545,13 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
  * See proto definition and some notes about ProtoOutputStream in
  * frameworks/base/core/proto/android/service/sensor_service.proto
  */
-status_t SensorService::dumpProtoLocked(int fd, ConnectionSafeAutolock* connLock) const {
+void SensorService::dumpProtoLocked(ConnectionSafeAutolock* connLock,
+                                    util::ProtoOutputStream* outProto) const {
     using namespace service::SensorServiceProto;
-    util::ProtoOutputStream proto;
+    util::ProtoOutputStream& proto = *outProto;
     proto.write(INIT_STATUS, int(SensorDevice::getInstance().initCheck()));
     if (!mSensors.hasAnySensor()) {
-        return proto.flush(fd) ? OK : UNKNOWN_ERROR;
+        return;
     }
     const bool privileged = IPCThreadState::self()->getCallingUid() == 0;
 
@@ -647,8 +657,6 @@ status_t SensorService::dumpProtoLocked(int fd, ConnectionSafeAutolock* connLock
         proto.end(token);
         curr = (curr + 1 + SENSOR_REGISTRATIONS_BUF_SIZE) % SENSOR_REGISTRATIONS_BUF_SIZE;
     } while (startIndex != curr);
-
-    return proto.flush(fd) ? OK : UNKNOWN_ERROR;
 }
 
 void SensorService::disableAllSensors() {
@@ -901,8 +909,20 @@ bool SensorService::threadLoop() {
                         fusion.process(event[i]);
                     }
                 }
+                // Look the virtual sensors up once for the whole buffer, rather than once per
+                // event and virtual sensor. Each lookup takes the SensorList lock.
+                std::vector<sp<SensorInterface>> virtualSensors;
+                virtualSensors.reserve(mActiveVirtualSensors.size());
+                for (int handle : mActiveVirtualSensors) {
+                    sp<SensorInterface> si = mSensors.getInterface(handle);
+                    if (si == nullptr) {
+                        ALOGE("handle %d is not an valid virtual sensor", handle);
+                        continue;
+                    }
+                    virtualSensors.push_back(std::move(si));
+                }
                 for (size_t i=0 ; i<size_t(count) && k<minBufferSize ; i++) {
-                    for (int handle : mActiveVirtualSensors) {
+                    for (const sp<SensorInterface>& si : virtualSensors) {
                         if (count + k >= minBufferSize) {
                             ALOGE("buffer too small to hold all events: "
                                     "count=%zd, k=%zu, size=%zu",
@@ -910,12 +930,6 @@ bool SensorService::threadLoop() {
                             break;
                         }
                         sensors_event_t out;
-                        sp<SensorInterface> si = mSensors.getInterface(handle);
-                        if (si == nullptr) {
-                            ALOGE("handle %d is not an valid virtual sensor", handle);
-                            continue;
-                        }
-
                         if (si->process(&out, event[i])) {
                             mSensorEventBuffer[count + k] = out;
                             k++;
@@ -1093,14 +1107,15 @@ void SensorService::recordLastValueLocked(
 }
 
 void SensorService::sortEventBuffer(sensors_event_t* buffer, size_t count) {
-    struct compar {
-        static int cmp(void const* lhs, void const* rhs) {
-            sensors_event_t const* l = static_cast<sensors_event_t const*>(lhs);
-            sensors_event_t const* r = static_cast<sensors_event_t const*>(rhs);
-            return l->timestamp - r->timestamp;
-        }
+    // Comparing the timestamps directly: their difference does not fit in an int.
+    auto byTimestamp = [](const sensors_event_t& lhs, const sensors_event_t& rhs) {
+        return lhs.timestamp < rhs.timestamp;
     };
-    qsort(buffer, count, sizeof(sensors_event_t), compar::cmp);
+    sensors_event_t* end = buffer + count;
+    if (std::is_sorted(buffer, end, byTimestamp)) {
+        return;
+    }
+    std::sort(buffer, end, byTimestamp);
 }
 
 String8 SensorService::getSensorName(int handle) const {
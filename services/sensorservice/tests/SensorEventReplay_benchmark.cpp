@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "../Fusion.h"
+#include "../RecentEventLogger.h"
+
+#include <hardware/sensors.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+constexpr nsecs_t ONE_SECOND = 1000000000LL;
+
+// Events read from the file passed with --replay, if any.
+std::vector<sensors_event_t> gRecordedEvents;
+
+sensors_event_t makeEvent(int32_t type, nsecs_t timestamp, float x, float y, float z) {
+    sensors_event_t event = {};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = type;
+    event.type = type;
+    event.timestamp = timestamp;
+    event.data[0] = x;
+    event.data[1] = y;
+    event.data[2] = z;
+    return event;
+}
+
+// One second of a device slowly turning around its z axis, with the gyroscope and the
+// accelerometer reporting at gyroRateHz and the magnetometer at a quarter of that rate.
+std::vector<sensors_event_t> makeSyntheticStream(int64_t gyroRateHz) {
+    const nsecs_t period = ONE_SECOND / gyroRateHz;
+    std::vector<sensors_event_t> events;
+    for (nsecs_t t = period; t <= ONE_SECOND; t += period) {
+        events.push_back(makeEvent(SENSOR_TYPE_GYROSCOPE, t, 0.01f, -0.02f, 0.5f));
+        events.push_back(makeEvent(SENSOR_TYPE_ACCELEROMETER, t + period / 2, 0.1f, 0.2f, 9.8f));
+        if ((t / period) % 4 == 0) {
+            events.push_back(makeEvent(SENSOR_TYPE_MAGNETIC_FIELD, t + period / 2, 0, 22, -40));
+        }
+    }
+    return events;
+}
+
+// Reads events written one per line as "<sensor type> <timestamp ns> <x> <y> <z>", in
+// timestamp order. Lines that do not parse are ignored.
+std::vector<sensors_event_t> loadRecordedStream(const std::string& filename) {
+    std::vector<sensors_event_t> events;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        int32_t type;
+        int64_t timestamp;
+        float x, y, z;
+        if (fields >> type >> timestamp >> x >> y >> z) {
+            events.push_back(makeEvent(type, timestamp, x, y, z));
+        }
+    }
+    return events;
+}
+
+// Feeds events to a Fusion the way SensorFusion::process does, without the SensorDevice that
+// SensorFusion needs.
+class FusionReplayer {
+public:
+    explicit FusionReplayer(int mode) { mFusion.init(mode); }
+
+    void process(const sensors_event_t& event) {
+        if (event.type == SENSOR_TYPE_GYROSCOPE) {
+            const nsecs_t delta = event.timestamp - mGyroTime;
+            if (delta > 0 && delta < 50000000LL) {
+                mFusion.handleGyro(vec3_t(event.data), delta / 1000000000.0f);
+            }
+            mGyroTime = event.timestamp;
+        } else if (event.type == SENSOR_TYPE_MAGNETIC_FIELD) {
+            mFusion.handleMag(vec3_t(event.data));
+        } else if (event.type == SENSOR_TYPE_ACCELEROMETER) {
+            const nsecs_t delta = event.timestamp - mAccTime;
+            if (delta > 0 && delta < 100000000LL) {
+                mFusion.handleAcc(vec3_t(event.data), delta / 1000000000.0f);
+                benchmark::DoNotOptimize(mFusion.getAttitude());
+            }
+            mAccTime = event.timestamp;
+        }
+    }
+
+private:
+    Fusion mFusion;
+    nsecs_t mGyroTime = 0;
+    nsecs_t mAccTime = 0;
+};
+
+void replayThroughFusion(benchmark::State& state, const std::vector<sensors_event_t>& events,
+                         int mode) {
+    if (events.empty()) {
+        state.SkipWithError("No events to replay");
+        return;
+    }
+    FusionReplayer replayer(mode);
+    for (auto _ : state) {
+        for (const sensors_event_t& event : events) {
+            replayer.process(event);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * events.size());
+}
+
+// One second of events at range(0) Hz through the fusion in mode range(1). Items per second is
+// the number of events the sensor thread can fuse per second of CPU.
+void BM_FusionReplay(benchmark::State& state) {
+    replayThroughFusion(state, makeSyntheticStream(state.range(0)),
+                        static_cast<int>(state.range(1)));
+}
+BENCHMARK(BM_FusionReplay)
+        ->Args({200, FUSION_9AXIS})
+        ->Args({200, FUSION_NOMAG})
+        ->Args({200, FUSION_NOGYRO})
+        ->Args({400, FUSION_9AXIS});
+
+void BM_FusionReplayRecorded(benchmark::State& state) {
+    replayThroughFusion(state, gRecordedEvents, static_cast<int>(state.range(0)));
+}
+
+// Records the events of one second at 400 Hz in the history kept for dumpsys, while range(0)
+// threads dump it continuously like repeated bugreports.
+void BM_RecentEventLoggerAddEvent(benchmark::State& state) {
+    const std::vector<sensors_event_t> events = makeSyntheticStream(400);
+    SensorServiceUtil::RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> dumpers;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        dumpers.emplace_back([&logger, &stop] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                benchmark::DoNotOptimize(logger.dump());
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        for (const sensors_event_t& event : events) {
+            logger.addEvent(event);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * events.size());
+
+    stop = true;
+    for (std::thread& dumper : dumpers) {
+        dumper.join();
+    }
+}
+BENCHMARK(BM_RecentEventLoggerAddEvent)->Arg(0)->Arg(1)->Arg(4)->UseRealTime();
+
+} // namespace
+} // namespace android
+
+// Accepts --replay=<file> on top of the benchmark library flags, to also replay a recorded
+// stream through each fusion mode.
+int main(int argc, char** argv) {
+    const std::string replayFlag = "--replay=";
+    int remaining = 1;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, replayFlag.size(), replayFlag) == 0) {
+            android::gRecordedEvents = android::loadRecordedStream(arg.substr(replayFlag.size()));
+        } else {
+            argv[remaining++] = argv[i];
+        }
+    }
+    argc = remaining;
+
+    if (!android::gRecordedEvents.empty()) {
+        benchmark::RegisterBenchmark("BM_FusionReplayRecorded", android::BM_FusionReplayRecorded)
+                ->Arg(android::FUSION_9AXIS)
+                ->Arg(android::FUSION_NOMAG)
+                ->Arg(android::FUSION_NOGYRO);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -111,15 +111,15 @@ hardware::Return<void> StatsHal::reportSpeechDspStat(
     return hardware::Void();
 }
 
-hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom) {
+static void writeVendorAtom(const VendorAtom& vendorAtom) {
     std::string reverseDomainName = (std::string) vendorAtom.reverseDomainName;
     if (vendorAtom.atomId < 100000 || vendorAtom.atomId >= 200000) {
         ALOGE("Atom ID %ld is not a valid vendor atom ID", (long) vendorAtom.atomId);
-        return hardware::Void();
+        return;
     }
     if (reverseDomainName.length() > 50) {
         ALOGE("Vendor atom reverse domain name %s is too long.", reverseDomainName.c_str());
-        return hardware::Void();
+        return;
     }
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, vendorAtom.atomId);
@@ -143,6 +143,19 @@ hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom)
     AStatsEvent_build(event);
     AStatsEvent_write(event);
     AStatsEvent_release(event);
+}
+
+hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom) {
+    writeVendorAtom(vendorAtom);
+
+    return hardware::Void();
+}
+
+hardware::Return<void> StatsHal::reportVendorAtoms(
+        const hardware::hidl_vec<VendorAtom>& vendorAtoms) {
+    for (const VendorAtom& vendorAtom : vendorAtoms) {
+        writeVendorAtom(vendorAtom);
+    }
 
     return hardware::Void();
 }
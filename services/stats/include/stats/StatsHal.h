@@ -90,6 +90,15 @@ public:
      * Binder call to get vendor atom.
      */
     virtual Return<void> reportVendorAtom(const VendorAtom& vendorAtom) override;
+
+    /**
+     * Writes several vendor atoms, each as if passed to reportVendorAtom, so that a daemon
+     * logging many atoms makes one call instead of one per atom. Invalid atoms are dropped
+     * without affecting the others.
+     *
+     * Not part of IStats 1.0, so only reachable in process until a later HAL version adds it.
+     */
+    Return<void> reportVendorAtoms(const hardware::hidl_vec<VendorAtom>& vendorAtoms);
 };
 
 }  // namespace implementation
@@ -304,9 +304,8 @@ void BufferLayer::preparePerFrameCompositionState() {
     }
 
     compositionState->buffer = mBufferInfo.mBuffer;
-    compositionState->bufferSlot = (mBufferInfo.mBufferSlot == BufferQueue::INVALID_BUFFER_SLOT)
-            ? 0
-            : mBufferInfo.mBufferSlot;
+    // Buffers without a slot are assigned one by the output layer's HWC buffer cache.
+    compositionState->bufferSlot = mBufferInfo.mBufferSlot;
     compositionState->acquireFence = mBufferInfo.mFence;
 }
 
@@ -831,6 +830,7 @@ void BufferLayer::updateCloneBufferInfo() {
     mDrawingState.zOrderRelativeOf = tmpZOrderRelativeOf;
     mDrawingState.zOrderRelatives = tmpZOrderRelatives;
     mDrawingState.inputInfo = tmpInputInfo;
+    invalidateInheritedState();
 }
 
 void BufferLayer::setTransformHint(ui::Transform::RotationFlags displayTransformHint) {
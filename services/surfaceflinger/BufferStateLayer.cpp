@@ -577,8 +577,8 @@ status_t BufferStateLayer::updateTexImage(bool& /*recomputeVisibleRegions*/, nse
         }
     }
 
-    mFlinger->mTimeStats->setAcquireFence(layerId, mDrawingState.frameNumber,
-                                          std::make_shared<FenceTime>(mDrawingState.acquireFence));
+    mAcquireFenceTime = std::make_shared<FenceTime>(mDrawingState.acquireFence);
+    mFlinger->mTimeStats->setAcquireFence(layerId, mDrawingState.frameNumber, mAcquireFenceTime);
     mFlinger->mTimeStats->setLatchTime(layerId, mDrawingState.frameNumber, latchTime);
 
     mCurrentStateModified = false;
@@ -620,6 +620,18 @@ void BufferStateLayer::HwcSlotGenerator::bufferErased(const client_cache_t& clie
     eraseBufferLocked(clientCacheId);
 }
 
+void BufferStateLayer::HwcSlotGenerator::buffersErased(
+        const std::vector<client_cache_t>& clientCacheIds) {
+    std::lock_guard lock(mMutex);
+    for (const auto& clientCacheId : clientCacheIds) {
+        if (!clientCacheId.isValid()) {
+            ALOGE("invalid process, failed to erase buffer");
+            continue;
+        }
+        eraseBufferLocked(clientCacheId);
+    }
+}
+
 uint32_t BufferStateLayer::HwcSlotGenerator::getHwcCacheSlot(const client_cache_t& clientCacheId) {
     std::lock_guard<std::mutex> lock(mMutex);
     auto itr = mCachedBuffers.find(clientCacheId);
@@ -689,7 +701,9 @@ void BufferStateLayer::gatherBufferInfo() {
 
     const State& s(getDrawingState());
     mBufferInfo.mDesiredPresentTime = s.desiredPresentTime;
-    mBufferInfo.mFenceTime = std::make_shared<FenceTime>(s.acquireFence);
+    mBufferInfo.mFenceTime = mAcquireFenceTime != nullptr
+            ? std::move(mAcquireFenceTime)
+            : std::make_shared<FenceTime>(s.acquireFence);
     mBufferInfo.mFence = s.acquireFence;
     mBufferInfo.mTransform = s.transform;
     mBufferInfo.mDataspace = translateDataspace(s.dataspace);
@@ -162,6 +162,10 @@ private:
     bool mReleasePreviousBuffer = false;
     nsecs_t mCallbackHandleAcquireTime = -1;
 
+    // The acquire fence of the buffer being latched, handed to both TimeStats and mBufferInfo so
+    // that its signal time is only queried once.
+    std::shared_ptr<FenceTime> mAcquireFenceTime;
+
     // TODO(marissaw): support sticky transform for LEGACY camera mode
 
     class HwcSlotGenerator : public ClientCache::ErasedRecipient {
@@ -173,6 +177,7 @@ private:
         }
 
         void bufferErased(const client_cache_t& clientCacheId);
+        void buffersErased(const std::vector<client_cache_t>& clientCacheIds) override;
 
         uint32_t getHwcCacheSlot(const client_cache_t& clientCacheId);
 
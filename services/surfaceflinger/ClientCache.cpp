@@ -20,6 +20,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <cinttypes>
+#include <utility>
 
 #include "ClientCache.h"
 
@@ -29,30 +30,32 @@ ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
 ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
 
-bool ClientCache::getBuffer(const client_cache_t& cacheId,
-                            ClientCacheBuffer** outClientCacheBuffer) {
-    auto& [processToken, id] = cacheId;
+std::shared_ptr<ClientCache::ProcessBuffers> ClientCache::getProcess(
+        const wp<IBinder>& processToken) {
     if (processToken == nullptr) {
         ALOGE("failed to get buffer, invalid (nullptr) process token");
-        return false;
+        return nullptr;
     }
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
+    std::shared_lock lock(mMutex);
+    auto it = mProcesses.find(processToken);
+    if (it == mProcesses.end()) {
         ALOGE("failed to get buffer, invalid process token");
-        return false;
+        return nullptr;
     }
+    return it->second;
+}
 
-    auto& processBuffers = it->second.second;
-
-    auto bufItr = processBuffers.find(id);
-    if (bufItr == processBuffers.end()) {
+ClientCache::ClientCacheBuffer* ClientCache::getBuffer(ProcessBuffers& process, uint64_t id) {
+    if (process.removed) {
+        ALOGE("failed to get buffer, process was removed");
+        return nullptr;
+    }
+    auto bufItr = process.buffers.find(id);
+    if (bufItr == process.buffers.end()) {
         ALOGE("failed to get buffer, invalid buffer id");
-        return false;
+        return nullptr;
     }
-
-    ClientCacheBuffer& buf = bufItr->second;
-    *outClientCacheBuffer = &buf;
-    return true;
+    return &bufItr->second;
 }
 
 bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer) {
@@ -67,50 +70,73 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    std::lock_guard lock(mMutex);
-    sp<IBinder> token;
+    std::shared_ptr<ProcessBuffers> process;
+    {
+        std::shared_lock lock(mMutex);
+        auto it = mProcesses.find(processToken);
+        if (it != mProcesses.end()) {
+            process = it->second;
+        }
+    }
 
     // If this is a new process token, set a death recipient. If the client process dies, we will
     // get a callback through binderDied.
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        token = processToken.promote();
-        if (!token) {
-            ALOGE("failed to cache buffer: invalid token");
-            return false;
+    if (!process) {
+        std::lock_guard lock(mMutex);
+        auto it = mProcesses.find(processToken);
+        if (it == mProcesses.end()) {
+            sp<IBinder> token = processToken.promote();
+            if (!token) {
+                ALOGE("failed to cache buffer: invalid token");
+                return false;
+            }
+
+            status_t err = token->linkToDeath(mDeathRecipient);
+            if (err != NO_ERROR) {
+                ALOGE("failed to cache buffer: could not link to death");
+                return false;
+            }
+            auto [itr, success] =
+                    mProcesses.emplace(processToken, std::make_shared<ProcessBuffers>(token));
+            LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
+            it = itr;
         }
+        process = it->second;
+    }
 
-        status_t err = token->linkToDeath(mDeathRecipient);
-        if (err != NO_ERROR) {
-            ALOGE("failed to cache buffer: could not link to death");
+    sp<GraphicBuffer> replacedBuffer;
+    {
+        std::lock_guard lock(process->mutex);
+        if (process->removed) {
+            ALOGE("failed to cache buffer: process was removed");
             return false;
         }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
-        LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
-        it = itr;
-    }
 
-    auto& processBuffers = it->second.second;
+        if (process->buffers.size() > BUFFER_CACHE_MAX_SIZE) {
+            ALOGE("failed to cache buffer: cache is full");
+            return false;
+        }
 
-    if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
-        ALOGE("failed to cache buffer: cache is full");
-        return false;
+        // Release a replaced buffer outside of the lock.
+        replacedBuffer = std::exchange(process->buffers[id].buffer, buffer);
     }
-
-    processBuffers[id].buffer = buffer;
     return true;
 }
 
 void ClientCache::erase(const client_cache_t& cacheId) {
     auto& [processToken, id] = cacheId;
     std::vector<sp<ErasedRecipient>> pendingErase;
+    ClientCacheBuffer erasedBuffer;
     {
-        std::lock_guard lock(mMutex);
-        ClientCacheBuffer* buf = nullptr;
-        if (!getBuffer(cacheId, &buf)) {
+        std::shared_ptr<ProcessBuffers> process = getProcess(processToken);
+        if (!process) {
+            ALOGE("failed to erase buffer, could not retrieve buffer");
+            return;
+        }
+
+        std::lock_guard lock(process->mutex);
+        ClientCacheBuffer* buf = getBuffer(*process, id);
+        if (!buf) {
             ALOGE("failed to erase buffer, could not retrieve buffer");
             return;
         }
@@ -122,7 +148,8 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             }
         }
 
-        mBuffers[processToken].second.erase(id);
+        erasedBuffer = std::move(*buf);
+        process->buffers.erase(id);
     }
 
     for (auto& recipient : pendingErase) {
@@ -131,10 +158,15 @@ void ClientCache::erase(const client_cache_t& cacheId) {
 }
 
 sp<GraphicBuffer> ClientCache::get(const client_cache_t& cacheId) {
-    std::lock_guard lock(mMutex);
+    std::shared_ptr<ProcessBuffers> process = getProcess(cacheId.token);
+    if (!process) {
+        ALOGE("failed to get buffer, could not retrieve buffer");
+        return nullptr;
+    }
 
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    std::lock_guard lock(process->mutex);
+    ClientCacheBuffer* buf = getBuffer(*process, cacheId.id);
+    if (!buf) {
         ALOGE("failed to get buffer, could not retrieve buffer");
         return nullptr;
     }
@@ -144,10 +176,15 @@ sp<GraphicBuffer> ClientCache::get(const client_cache_t& cacheId) {
 
 bool ClientCache::registerErasedRecipient(const client_cache_t& cacheId,
                                           const wp<ErasedRecipient>& recipient) {
-    std::lock_guard lock(mMutex);
+    std::shared_ptr<ProcessBuffers> process = getProcess(cacheId.token);
+    if (!process) {
+        ALOGE("failed to register erased recipient, could not retrieve buffer");
+        return false;
+    }
 
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    std::lock_guard lock(process->mutex);
+    ClientCacheBuffer* buf = getBuffer(*process, cacheId.id);
+    if (!buf) {
         ALOGE("failed to register erased recipient, could not retrieve buffer");
         return false;
     }
@@ -157,10 +194,15 @@ bool ClientCache::registerErasedRecipient(const client_cache_t& cacheId,
 
 void ClientCache::unregisterErasedRecipient(const client_cache_t& cacheId,
                                             const wp<ErasedRecipient>& recipient) {
-    std::lock_guard lock(mMutex);
+    std::shared_ptr<ProcessBuffers> process = getProcess(cacheId.token);
+    if (!process) {
+        ALOGE("failed to unregister erased recipient");
+        return;
+    }
 
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    std::lock_guard lock(process->mutex);
+    ClientCacheBuffer* buf = getBuffer(*process, cacheId.id);
+    if (!buf) {
         ALOGE("failed to unregister erased recipient");
         return;
     }
@@ -169,33 +211,45 @@ void ClientCache::unregisterErasedRecipient(const client_cache_t& cacheId,
 }
 
 void ClientCache::removeProcess(const wp<IBinder>& processToken) {
-    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
+    if (processToken == nullptr) {
+        ALOGE("failed to remove process, invalid (nullptr) process token");
+        return;
+    }
+
+    std::shared_ptr<ProcessBuffers> process;
     {
-        if (processToken == nullptr) {
-            ALOGE("failed to remove process, invalid (nullptr) process token");
-            return;
-        }
         std::lock_guard lock(mMutex);
-        auto itr = mBuffers.find(processToken);
-        if (itr == mBuffers.end()) {
+        auto itr = mProcesses.find(processToken);
+        if (itr == mProcesses.end()) {
             ALOGE("failed to remove process, could not find process");
             return;
         }
+        process = std::move(itr->second);
+        mProcesses.erase(itr);
+    }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
-            client_cache_t cacheId = {processToken, id};
-            for (auto& recipient : clientCacheBuffer.recipients) {
-                sp<ErasedRecipient> erasedRecipient = recipient.promote();
-                if (erasedRecipient) {
-                    pendingErase.emplace_back(erasedRecipient, cacheId);
-                }
+    std::unordered_map<uint64_t, ClientCacheBuffer> buffers;
+    {
+        std::lock_guard lock(process->mutex);
+        process->removed = true;
+        buffers = std::move(process->buffers);
+        process->buffers.clear();
+    }
+
+    // Notify each recipient once with all of its buffers, rather than once per buffer.
+    std::map<sp<ErasedRecipient>, std::vector<client_cache_t>> pendingErase;
+    for (auto& [id, clientCacheBuffer] : buffers) {
+        client_cache_t cacheId = {processToken, id};
+        for (auto& recipient : clientCacheBuffer.recipients) {
+            sp<ErasedRecipient> erasedRecipient = recipient.promote();
+            if (erasedRecipient) {
+                pendingErase[erasedRecipient].push_back(cacheId);
             }
         }
-        mBuffers.erase(itr);
     }
 
-    for (auto& [recipient, cacheId] : pendingErase) {
-        recipient->bufferErased(cacheId);
+    for (auto& [recipient, cacheIds] : pendingErase) {
+        recipient->buffersErased(cacheIds);
     }
 }
 
@@ -24,9 +24,12 @@
 #include <utils/Singleton.h>
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 #define BUFFER_CACHE_MAX_SIZE 64
 
@@ -46,6 +49,13 @@ public:
     class ErasedRecipient : public virtual RefBase {
     public:
         virtual void bufferErased(const client_cache_t& clientCacheId) = 0;
+
+        // Called once with all the buffers of a process that went away.
+        virtual void buffersErased(const std::vector<client_cache_t>& clientCacheIds) {
+            for (const auto& clientCacheId : clientCacheIds) {
+                bufferErased(clientCacheId);
+            }
+        }
     };
 
     bool registerErasedRecipient(const client_cache_t& cacheId,
@@ -54,16 +64,27 @@ public:
                                    const wp<ErasedRecipient>& recipient);
 
 private:
-    std::mutex mMutex;
-
     struct ClientCacheBuffer {
         sp<GraphicBuffer> buffer;
         std::set<wp<ErasedRecipient>> recipients;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+
+    // The buffers cached by one process. Each process has its own lock, so a client caching
+    // buffers does not block lookups of the buffers of other processes.
+    struct ProcessBuffers {
+        explicit ProcessBuffers(const sp<IBinder>& token) : token(token) {}
+
+        const sp<IBinder> token; // strong ref to caching process
+        std::mutex mutex;
+        std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer> buffers GUARDED_BY(mutex);
+        // Set once the process is removed, so that late calls do not add to a dead process.
+        bool removed GUARDED_BY(mutex) = false;
+    };
+
+    // Only guards the set of processes. The buffers are guarded by ProcessBuffers::mutex.
+    std::shared_mutex mMutex;
+    std::map<wp<IBinder> /*caching process*/, std::shared_ptr<ProcessBuffers>> mProcesses
+            GUARDED_BY(mMutex);
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -72,8 +93,8 @@ private:
 
     sp<CacheDeathRecipient> mDeathRecipient;
 
-    bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
-            REQUIRES(mMutex);
+    std::shared_ptr<ProcessBuffers> getProcess(const wp<IBinder>& processToken) EXCLUDES(mMutex);
+    ClientCacheBuffer* getBuffer(ProcessBuffers& process, uint64_t id) REQUIRES(process.mutex);
 };
 
 }; // namespace android
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/DisplayColorProfileCreationArgs.h>
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/DisplayColorProfile.h>
+#include <compositionengine/impl/Output.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/mock/CompositionEngine.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::NiceMock;
+using testing::ReturnRef;
+
+constexpr uint32_t kLayerStack = 1;
+const Rect kDisplayBounds{1080, 1920};
+
+// A front-end layer with fixed state, so that the benchmarks only measure the
+// CompositionEngine side of each stage.
+class BenchmarkLayerFE : public LayerFE {
+public:
+    const LayerFECompositionState* getCompositionState() const override { return &state; }
+    bool onPreComposition(nsecs_t) override { return false; }
+    void prepareCompositionState(StateSubset) override {}
+
+    std::vector<LayerSettings> prepareClientCompositionList(
+            ClientCompositionTargetSettings& targetSettings) override {
+        std::vector<LayerSettings> results;
+        if (state.shadowRadius > 0.f) {
+            LayerSettings shadow;
+            shadow.geometry.boundaries = state.geomLayerBounds;
+            shadow.geometry.positionTransform = state.geomLayerTransform.asMatrix4();
+            shadow.shadow.length = state.shadowRadius;
+            results.push_back(shadow);
+        }
+        if (targetSettings.realContentIsVisible) {
+            LayerSettings layer;
+            layer.geometry.boundaries = state.geomLayerBounds;
+            layer.geometry.positionTransform = state.geomLayerTransform.asMatrix4();
+            layer.geometry.roundedCornersRadius = cornerRadius;
+            layer.geometry.roundedCornersCrop = state.geomLayerBounds;
+            layer.source.solidColor = half3(state.color.r, state.color.g, state.color.b);
+            layer.alpha = state.alpha;
+            layer.backgroundBlurRadius = state.backgroundBlurRadius;
+            results.push_back(layer);
+        }
+        return results;
+    }
+
+    void onLayerDisplayed(const sp<Fence>&) override {}
+    const char* getDebugName() const override { return "BenchmarkLayerFE"; }
+
+    LayerFECompositionState state;
+    float cornerRadius = 0.f;
+};
+
+// Exposes the stages of Output::present() that are not public.
+class BenchmarkOutput : public impl::Output {
+public:
+    using impl::Output::generateClientCompositionRequests;
+};
+
+// A stack of layers laid out like a typical app window with decorations, with
+// overlapping translucent layers, rounded corners, shadows, a background blur
+// and a mix of transforms. Layers are in back to front order.
+std::vector<sp<BenchmarkLayerFE>> createLayerStack(int count) {
+    std::vector<sp<BenchmarkLayerFE>> layers;
+    for (int i = 0; i < count; i++) {
+        sp<BenchmarkLayerFE> layer = new BenchmarkLayerFE();
+        auto& state = layer->state;
+        state.layerStackId = kLayerStack;
+        state.isOpaque = i % 4 == 0;
+        state.alpha = state.isOpaque ? 1.f : 0.5f;
+        state.color = half4(0.25f, 0.5f, 0.75f, 1.f);
+        state.dataspace = ui::Dataspace::V0_SRGB;
+        state.shadowRadius = 0.f;
+
+        // Staggered, overlapping windows of different sizes.
+        const float width = static_cast<float>(kDisplayBounds.getWidth() - (i % 8) * 40);
+        const float height = static_cast<float>(kDisplayBounds.getHeight() / 2 - (i % 5) * 60);
+        state.geomLayerBounds = FloatRect(0.f, 0.f, width, height);
+        switch (i % 5) {
+            case 1:
+                state.geomLayerTransform.set(0.5f, 0.f, 0.f, 0.5f);
+                break;
+            case 3:
+                state.geomLayerTransform.set(ui::Transform::ROT_90, width, height);
+                break;
+            default:
+                break;
+        }
+        state.geomLayerTransform.set(static_cast<float>((i * 37) % 200),
+                                     static_cast<float>((i * 53) % 900));
+        state.geomInverseLayerTransform = state.geomLayerTransform.inverse();
+        if (!state.isOpaque) {
+            state.transparentRegionHint = Region(Rect(0, 0, static_cast<int>(width), 40));
+        }
+
+        if (i % 3 == 0) {
+            layer->cornerRadius = 32.f;
+        }
+        if (i % 8 == 7) {
+            state.shadowRadius = 24.f;
+        }
+        if (i == count / 2) {
+            state.backgroundBlurRadius = 60;
+        }
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
+// Sets up an output showing a synthetic layer stack, with a stub
+// RenderEngine. The output has no HWC, so the layers are composited by the
+// client and writing the state to the HWC is a no-op.
+class OutputFixture {
+public:
+    explicit OutputFixture(int layerCount) {
+        ON_CALL(mCompositionEngine, getRenderEngine()).WillByDefault(ReturnRef(mRenderEngine));
+
+        mOutput->setDisplayColorProfileForTest(impl::createDisplayColorProfile(
+                DisplayColorProfileCreationArgsBuilder().setHasWideColorGamut(false).Build()));
+        auto& outputState = mOutput->editState();
+        outputState.isEnabled = true;
+        outputState.bounds = kDisplayBounds;
+        outputState.viewport = kDisplayBounds;
+        outputState.sourceClip = kDisplayBounds;
+        outputState.destinationClip = kDisplayBounds;
+        outputState.layerStackId = kLayerStack;
+        outputState.layerStackInternal = true;
+
+        mLayers = createLayerStack(layerCount);
+        for (const auto& layer : mLayers) {
+            mRefreshArgs.layers.push_back(layer);
+        }
+        mRefreshArgs.updatingGeometryThisFrame = true;
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    }
+
+    void collectVisibleLayers() {
+        LayerFESet latchedLayers;
+        compositionengine::Output::CoverageState coverage{latchedLayers};
+        mOutput->collectVisibleLayers(mRefreshArgs, coverage);
+    }
+
+    // Moves the top layer, which invalidates the coverage of the layers below it.
+    void moveTopLayer(int offset) {
+        auto& state = mLayers.back()->state;
+        state.geomLayerTransform.set(static_cast<float>(offset % 100), 0.f);
+        state.geomInverseLayerTransform = state.geomLayerTransform.inverse();
+    }
+
+    NiceMock<mock::CompositionEngine> mCompositionEngine;
+    NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    std::shared_ptr<BenchmarkOutput> mOutput =
+            impl::createOutputTemplated<BenchmarkOutput>(mCompositionEngine);
+    std::vector<sp<BenchmarkLayerFE>> mLayers;
+    CompositionRefreshArgs mRefreshArgs;
+};
+
+// Visibility with unchanged geometry, where the coverage of every layer can be
+// reused from the previous frame.
+void BM_CollectVisibleLayers(benchmark::State& state) {
+    OutputFixture fixture(static_cast<int>(state.range(0)));
+    fixture.collectVisibleLayers();
+    for (auto _ : state) {
+        fixture.collectVisibleLayers();
+    }
+}
+
+// Visibility when the top layer moves every frame, so the coverage of every
+// layer is computed again.
+void BM_CollectVisibleLayersGeometryChanged(benchmark::State& state) {
+    OutputFixture fixture(static_cast<int>(state.range(0)));
+    int frame = 0;
+    for (auto _ : state) {
+        fixture.moveTopLayer(frame++);
+        fixture.collectVisibleLayers();
+    }
+}
+
+void BM_UpdateAndWriteCompositionState(benchmark::State& state) {
+    OutputFixture fixture(static_cast<int>(state.range(0)));
+    fixture.collectVisibleLayers();
+    for (auto _ : state) {
+        fixture.mOutput->updateAndWriteCompositionState(fixture.mRefreshArgs);
+    }
+}
+
+void BM_GenerateClientCompositionRequests(benchmark::State& state) {
+    OutputFixture fixture(static_cast<int>(state.range(0)));
+    fixture.collectVisibleLayers();
+    fixture.mOutput->updateAndWriteCompositionState(fixture.mRefreshArgs);
+    for (auto _ : state) {
+        Region clearRegion;
+        auto requests = fixture.mOutput->generateClientCompositionRequests(false, clearRegion,
+                                                                         ui::Dataspace::V0_SRGB);
+        benchmark::DoNotOptimize(requests);
+    }
+}
+
+BENCHMARK(BM_CollectVisibleLayers)->Arg(8)->Arg(32)->Arg(128);
+BENCHMARK(BM_CollectVisibleLayersGeometryChanged)->Arg(8)->Arg(32)->Arg(128);
+BENCHMARK(BM_UpdateAndWriteCompositionState)->Arg(8)->Arg(32)->Arg(128);
+BENCHMARK(BM_GenerateClientCompositionRequests)->Arg(8)->Arg(32)->Arg(128);
+
+} // namespace
+} // namespace android::compositionengine
+
+BENCHMARK_MAIN();
@@ -17,11 +17,13 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <optional>
 #include <vector>
 
 #include <compositionengine/Display.h>
 #include <compositionengine/LayerFE.h>
+#include <compositionengine/LayerFEGeometrySnapshot.h>
 #include <compositionengine/OutputColorSetting.h>
 #include <math/mat4.h>
 #include <ui/Transform.h>
@@ -64,14 +66,18 @@ struct CompositionRefreshArgs {
     // If true, GPU clocks will be increased when rendering blurs
     bool blursAreExpensive{false};
 
+    // The time available to compose a frame, used to judge how expensive
+    // client composition is. 0 if unknown.
+    nsecs_t frameBudget{0};
+
     // If true, the complete output geometry needs to be recomputed this frame
     bool updatingOutputGeometryThisFrame{false};
 
     // If true, there was a geometry update this frame
     bool updatingGeometryThisFrame{false};
 
-    // The color matrix to use for this
-    // frame. Only set if the color transform is changing this frame.
+    // The color matrix to use for this frame. Outputs only update their
+    // color transform if it differs from the one they already use.
     std::optional<mat4> colorTransformMatrix;
 
     // If true, client composition is always used.
@@ -79,6 +85,23 @@ struct CompositionRefreshArgs {
 
     // If set, causes the dirty regions to flash with the delay
     std::optional<std::chrono::microseconds> devOptFlashDirtyRegionsDelay;
+
+    // If set, used to compute the composition state of several outputs
+    // concurrently. It must call work(i) for each i in [0, count), and return
+    // once all the calls have completed.
+    std::function<void(size_t count, const std::function<void(size_t)>& work)> parallelFor;
+
+    // Set by CompositionEngine once the composition state of every output has
+    // been computed for the frame, so that presenting only writes it out.
+    bool outputCompositionStateUpdated{false};
+
+    // Set by CompositionEngine when the output geometry is being updated. It
+    // holds the basic geometry state of |layers|, in the same order.
+    LayerFEGeometrySnapshot layerGeometrySnapshot;
+
+    // If true, displays may start client composition with the composition
+    // strategy of the previous frame while the HWC validates the current one.
+    bool predictCompositionStrategy{false};
 };
 
 } // namespace android::compositionengine
@@ -56,6 +56,18 @@ public:
     // similar requests if needed.
     virtual void createClientCompositionCache(uint32_t cacheSize) = 0;
 
+    // Creates a cache that pre-renders the unchanged bottom-most client
+    // composited layers, so that only the layers above them are redrawn.
+    virtual void createClientCompositionLayerSetCache() = 0;
+
+    // Creates a history of client target damage, so that client composition
+    // only redraws the part of the client target that is out of date.
+    virtual void createClientTargetDamageHistory() = 0;
+
+    // Creates a flattener that presents runs of unchanged device composited
+    // layers from a single buffer, to free HWC overlay planes.
+    virtual void createLayerFlattener() = 0;
+
 protected:
     ~Display() = default;
 };
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace android::compositionengine {
+
+struct LayerFECompositionState;
+
+// A compact copy of the front-end state that decides which outputs a layer can
+// be visible on, stored as parallel arrays indexed like
+// CompositionRefreshArgs::layers. It is built once per frame, after the basic
+// geometry of every layer has been latched, so that each output can skip the
+// layers it cannot show with a linear scan rather than by reading the full
+// LayerFECompositionState of every layer.
+class LayerFEGeometrySnapshot {
+public:
+    void clear();
+    void reserve(size_t count);
+
+    // Appends the state of the next layer. A null state is never visible.
+    void add(const LayerFECompositionState* state);
+
+    size_t size() const { return mFlags.size(); }
+
+    // Returns true if the layer at the given index is visible and belongs on
+    // an output with the given layer stack filter. See Output::belongsInOutput.
+    bool isVisibleOn(size_t index, uint32_t layerStackId, bool internalOutput) const {
+        const uint8_t flags = mFlags[index];
+        return (flags & kVisible) && mLayerStackIds[index] == layerStackId &&
+                (!(flags & kInternalOnly) || internalOutput);
+    }
+
+private:
+    enum : uint8_t {
+        // Set if the layer is visible and on a layer stack.
+        kVisible = 1 << 0,
+        kInternalOnly = 1 << 1,
+    };
+
+    std::vector<uint32_t> mLayerStackIds;
+    std::vector<uint8_t> mFlags;
+};
+
+} // namespace android::compositionengine
@@ -33,6 +33,7 @@
 #include <utils/StrongPointer.h>
 
 #include "DisplayHardware/DisplayIdentification.h"
+#include "DisplayHardware/PowerAdvisor.h"
 
 namespace android {
 
@@ -253,6 +254,14 @@ public:
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
+    // Chooses the color profile to use for the frame
+    virtual void updateColorProfile(const CompositionRefreshArgs&) = 0;
+
+    // Computes the composition state of each output layer, without writing it
+    // to the HWC. This only reads front-end layer state and writes state owned
+    // by this output, so it may run concurrently for several outputs.
+    virtual void updateCompositionState(const CompositionRefreshArgs&) = 0;
+
 protected:
     virtual void setDisplayColorProfile(std::unique_ptr<DisplayColorProfile>) = 0;
     virtual void setRenderSurface(std::unique_ptr<RenderSurface>) = 0;
@@ -264,9 +273,15 @@ protected:
 
     virtual void updateAndWriteCompositionState(const CompositionRefreshArgs&) = 0;
     virtual void setColorTransform(const CompositionRefreshArgs&) = 0;
-    virtual void updateColorProfile(const CompositionRefreshArgs&) = 0;
     virtual void beginFrame() = 0;
     virtual void prepareFrame() = 0;
+    // Whether the composition strategy chosen for the previous frame is likely
+    // to be chosen again, so that client composition can start before the HWC
+    // has confirmed it.
+    virtual bool canPredictCompositionStrategy(const CompositionRefreshArgs&) = 0;
+    // Like prepareFrame(), but composes the client target with the predicted
+    // composition strategy while the actual one is being chosen.
+    virtual void prepareFrameAsync(const CompositionRefreshArgs&) = 0;
     virtual void devOptRepaintFlash(const CompositionRefreshArgs&) = 0;
     virtual void finishFrame(const CompositionRefreshArgs&) = 0;
     virtual std::optional<base::unique_fd> composeSurfaces(
@@ -281,7 +296,13 @@ protected:
             const Region& flashRegion,
             std::vector<LayerFE::LayerSettings>& clientCompositionLayers) = 0;
     virtual void setExpensiveRenderingExpected(bool enabled) = 0;
+    virtual void notifyClientCompositionStarted(const Hwc2::ClientCompositionWorkload&) = 0;
+    virtual void notifyClientCompositionSubmitted(nsecs_t startTime,
+                                                  const std::shared_ptr<FenceTime>& readyFence) = 0;
     virtual void cacheClientCompositionRequests(uint32_t cacheSize) = 0;
+    virtual void cacheClientCompositionLayerSets(bool enable) = 0;
+    virtual void trackClientTargetDamage(bool enable) = 0;
+    virtual void flattenStaticLayers(bool enable) = 0;
 };
 
 } // namespace compositionengine
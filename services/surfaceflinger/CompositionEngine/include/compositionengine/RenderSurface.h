@@ -21,6 +21,7 @@
 
 #include <ui/Fence.h>
 #include <ui/GraphicTypes.h>
+#include <ui/Region.h>
 #include <ui/Size.h>
 #include <utils/Errors.h>
 #include <utils/StrongPointer.h>
@@ -82,6 +83,14 @@ public:
     // Allocates a buffer as scratch space for GPU composition
     virtual sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) = 0;
 
+    // Returns how many frames ago the contents of the last dequeued buffer
+    // were queued, or 0 if its contents are undefined.
+    virtual int getBufferAge() const = 0;
+
+    // Sets the part of the next queued buffer that differs from the buffer
+    // queued before it. An empty region damages the whole buffer.
+    virtual void setSurfaceDamage(const Region& damage) = 0;
+
     // Queues the drawn buffer for consumption by HWC. readyFence is the fence
     // which will fire when the buffer is ready for consumption.
     virtual void queueBuffer(base::unique_fd readyFence) = 0;
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
+namespace android {
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine::impl {
+
+// The cache keeps the bottom-most client composited layers that have not changed for a few
+// frames pre-rendered into an offscreen buffer. While they stay unchanged, client composition
+// draws that buffer as a single opaque-blended layer and only blends the layers above it.
+//
+// This complements ClientCompositionRequestCache, which can only skip a frame whose whole
+// request is unchanged. The cached buffer is drawn 1:1 onto the client target, so the cache is
+// only used when the display settings do not scale, rotate or color transform the output.
+class ClientCompositionLayerSetCache {
+public:
+    explicit ClientCompositionLayerSetCache(renderengine::RenderEngine& renderEngine);
+    ~ClientCompositionLayerSetCache();
+
+    ClientCompositionLayerSetCache(const ClientCompositionLayerSetCache&) = delete;
+    ClientCompositionLayerSetCache& operator=(const ClientCompositionLayerSetCache&) = delete;
+
+    // Replaces the cached bottom-most layers in |layers| with a single layer that samples the
+    // offscreen buffer. |target| is the buffer the layers will be drawn into. This may render
+    // the offscreen buffer, when a larger set of layers has become stable.
+    void apply(const renderengine::DisplaySettings& display, const sp<GraphicBuffer>& target,
+               std::vector<LayerFE::LayerSettings>& layers);
+
+    // Number of layers currently held in the offscreen buffer.
+    size_t getCachedLayerCount() const { return mCachedLayerCount; }
+
+private:
+    // Only layer sets with at least this many layers are worth an extra draw.
+    static constexpr size_t kMinCachedLayers = 2;
+    // Number of consecutive frames a layer set must be unchanged before it is cached.
+    static constexpr uint32_t kStableFramesBeforeCaching = 2;
+
+    bool canCache(const renderengine::DisplaySettings& display,
+                  const sp<GraphicBuffer>& target) const;
+    bool render(const renderengine::DisplaySettings& display, const sp<GraphicBuffer>& target,
+                const std::vector<LayerFE::LayerSettings>& layers, size_t count);
+    LayerFE::LayerSettings getCachedLayerSettings(
+            const renderengine::DisplaySettings& display) const;
+    void reset();
+
+    renderengine::RenderEngine& mRenderEngine;
+    uint32_t mTextureName = 0;
+
+    sp<GraphicBuffer> mBuffer;
+    sp<Fence> mReadyFence;
+    // Incremented each time the offscreen buffer is rendered.
+    uint64_t mGeneration = 0;
+    size_t mCachedLayerCount = 0;
+
+    // Snapshot of the previous frame's request, used to find the unchanged bottom layers.
+    renderengine::DisplaySettings mPreviousDisplay;
+    std::vector<LayerFE::LayerSettings> mPreviousLayers;
+    size_t mStableLayerCount = 0;
+    uint32_t mStableFrameCount = 0;
+};
+
+} // namespace compositionengine::impl
+} // namespace android
@@ -27,6 +27,13 @@ namespace android {
 
 namespace compositionengine::impl {
 
+// Returns a copy of the settings without strong references to the client buffer and fence.
+LayerFE::LayerSettings getLayerSettingsSnapshot(const LayerFE::LayerSettings& settings);
+
+// Returns true if both settings render the same content. Buffers are compared by id and frame
+// number, so snapshots can be compared against live settings.
+bool layerSettingsAreEqual(const LayerFE::LayerSettings& lhs, const LayerFE::LayerSettings& rhs);
+
 // The cache is used to skip duplicate client composition requests. We do so by keeping track
 // of every composition request and the buffer that the request is rendered into. During the
 // next composition request, if the request matches what was rendered into the buffer, then
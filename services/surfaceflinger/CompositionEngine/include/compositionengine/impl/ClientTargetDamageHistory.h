@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <renderengine/DisplaySettings.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+namespace android::compositionengine {
+
+class LayerFE;
+
+namespace impl {
+
+// The history keeps the damage of the last few client targets queued to the display, so that
+// client composition only has to redraw the part of a dequeued buffer that is out of date.
+//
+// The damage of a client target is the part of the display where it differs from the client
+// target queued before it. A buffer of age N holds the client target queued N frames ago, so it
+// is current everywhere but in the damage of the client targets queued after it and of the one
+// being composed.
+//
+// Damage is taken from the dirty region of the output, which covers content changes only. A
+// client target composed with other display settings or with other layers composited by the
+// client is damaged as a whole.
+class ClientTargetDamageHistory {
+public:
+    // What, besides the layer contents, a client target is composed from.
+    struct Signature {
+        struct Layer {
+            const LayerFE* layerFE = nullptr;
+            bool clientComposition = false;
+            bool clearClientTarget = false;
+
+            bool operator==(const Layer& other) const {
+                return layerFE == other.layerFE && clientComposition == other.clientComposition &&
+                        clearClientTarget == other.clearClientTarget;
+            }
+        };
+
+        renderengine::DisplaySettings display;
+        std::vector<Layer> layers;
+
+        bool operator==(const Signature& other) const {
+            return display == other.display && layers == other.layers;
+        }
+    };
+
+    // Adds display space damage for the next client target to cover. Damage of frames that do
+    // not queue a client target carries over to the next one that does.
+    void addDamage(const Region& damage);
+
+    // Returns the damage of a client target composed with |signature|, where |frameDamage| is
+    // the damage of the current frame that has not been added yet.
+    Region getDamage(const Rect& bounds, const Signature& signature,
+                     const Region& frameDamage) const;
+
+    // Returns the part of a buffer of age |bufferAge| to redraw for a client target with
+    // |damage|. This is all of |bounds| when the buffer contents are not known.
+    Region getRedrawRegion(const Rect& bounds, int bufferAge, const Region& damage) const;
+
+    // Records the client target of this frame as queued. |drawn| is false if the buffer does
+    // not hold the composition of |signature|, as when it was queued without being drawn.
+    void onClientTargetQueued(const Region& damage, Signature signature, bool drawn);
+
+    // Forgets the history, so that the next client target is drawn whole.
+    void reset();
+
+    void dump(std::string& result) const;
+
+private:
+    // Buffer ages beyond this are drawn whole. This covers triple buffering with some margin.
+    static constexpr size_t kMaxQueuedTargets = 4;
+
+    struct QueuedTarget {
+        Region damage;
+        bool drawn = false;
+    };
+
+    // The client targets queued most recently, the last one at the back.
+    std::deque<QueuedTarget> mQueuedTargets;
+    // Signature of the last queued client target, if it was drawn.
+    std::optional<Signature> mSignature;
+    // Damage added since the last client target was queued.
+    Region mPendingDamage;
+};
+
+} // namespace impl
+} // namespace android::compositionengine
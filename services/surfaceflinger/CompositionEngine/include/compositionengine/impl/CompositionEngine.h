@@ -57,6 +57,9 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    void updateOutputCompositionStateConcurrently(CompositionRefreshArgs&);
+    void snapshotLayerGeometry(CompositionRefreshArgs&, LayerFESet& latchedLayers);
+
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
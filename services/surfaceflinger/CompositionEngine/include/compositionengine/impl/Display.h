@@ -17,11 +17,15 @@
 #pragma once
 
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include <compositionengine/Display.h>
 #include <compositionengine/DisplayColorProfile.h>
 #include <compositionengine/DisplayCreationArgs.h>
 #include <compositionengine/RenderSurface.h>
+#include <compositionengine/impl/HwcAsyncWorker.h>
 #include <compositionengine/impl/Output.h>
 #include <ui/PixelFormat.h>
 #include <ui/Size.h>
@@ -51,9 +55,14 @@ public:
     void setColorTransform(const CompositionRefreshArgs&) override;
     void setColorProfile(const ColorProfile&) override;
     void chooseCompositionStrategy() override;
+    bool canPredictCompositionStrategy(const CompositionRefreshArgs&) override;
+    void prepareFrameAsync(const CompositionRefreshArgs&) override;
     bool getSkipColorTransform() const override;
     compositionengine::Output::FrameFences presentAndGetFrameFences() override;
     void setExpensiveRenderingExpected(bool) override;
+    void notifyClientCompositionStarted(const Hwc2::ClientCompositionWorkload&) override;
+    void notifyClientCompositionSubmitted(nsecs_t startTime,
+                                          const std::shared_ptr<FenceTime>& readyFence) override;
     void finishFrame(const CompositionRefreshArgs&) override;
 
     // compositionengine::Display overrides
@@ -65,18 +74,25 @@ public:
             const compositionengine::DisplayColorProfileCreationArgs&) override;
     void createRenderSurface(const compositionengine::RenderSurfaceCreationArgs&) override;
     void createClientCompositionCache(uint32_t cacheSize) override;
+    void createClientCompositionLayerSetCache() override;
+    void createClientTargetDamageHistory() override;
+    void createLayerFlattener() override;
 
     // Internal helpers used by chooseCompositionStrategy()
     using ChangedTypes = android::HWComposer::DeviceRequestedChanges::ChangedTypes;
     using DisplayRequests = android::HWComposer::DeviceRequestedChanges::DisplayRequests;
     using LayerRequests = android::HWComposer::DeviceRequestedChanges::LayerRequests;
     using ClientTargetProperty = android::HWComposer::DeviceRequestedChanges::ClientTargetProperty;
+    using DeviceRequestedChanges = android::HWComposer::DeviceRequestedChanges;
+    using RequestedCompositionTypes = std::vector<std::pair<HWC2::Layer*, hal::Composition>>;
     virtual bool anyLayersRequireClientComposition() const;
     virtual bool allLayersRequireClientComposition() const;
     virtual void applyChangedTypesToLayers(const ChangedTypes&);
     virtual void applyDisplayRequests(const DisplayRequests&);
     virtual void applyLayerRequestsToLayers(const LayerRequests&);
     virtual void applyClientTargetRequests(const ClientTargetProperty&);
+    virtual void applyCompositionStrategy(const std::optional<DeviceRequestedChanges>&);
+    RequestedCompositionTypes getRequestedCompositionTypes() const;
 
     // Internal
     virtual void setConfiguration(const compositionengine::DisplayCreationArgs&);
@@ -92,6 +108,17 @@ private:
     std::optional<DisplayId> mId;
     Hwc2::PowerAdvisor* mPowerAdvisor = nullptr;
     bool mHasScreenshot = false;
+
+    void updateScreenshotAnimationState();
+    void rememberCompositionStrategy(status_t result, RequestedCompositionTypes&& requestedTypes,
+                                     const std::optional<DeviceRequestedChanges>& changes);
+
+    // The composition types requested from the HWC for the last successfully
+    // validated frame, and the changes it made to them. Empty if there is no
+    // strategy to predict the next frame's from.
+    RequestedCompositionTypes mPreviousRequestedTypes;
+    std::optional<DeviceRequestedChanges> mPreviousChanges;
+    std::unique_ptr<HwcAsyncWorker> mHwcAsyncWorker;
 };
 
 // This template factory function standardizes the implementation details of the
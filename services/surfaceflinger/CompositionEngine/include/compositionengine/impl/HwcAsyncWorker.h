@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <android-base/thread_annotations.h>
+#include <utils/Errors.h>
+
+namespace android::compositionengine::impl {
+
+// Runs HWC calls for a single display off the main thread, so that the main
+// thread can do other work while waiting for the HWC. Only one task may be in
+// flight at a time, and the caller must not use the HWC display until the
+// returned future is ready.
+class HwcAsyncWorker final {
+public:
+    HwcAsyncWorker();
+    ~HwcAsyncWorker();
+
+    HwcAsyncWorker(const HwcAsyncWorker&) = delete;
+    HwcAsyncWorker& operator=(const HwcAsyncWorker&) = delete;
+
+    std::future<status_t> send(std::function<status_t()> task);
+
+private:
+    void run();
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    bool mDone GUARDED_BY(mMutex) = false;
+    bool mTaskRequested GUARDED_BY(mMutex) = false;
+    std::packaged_task<status_t()> mTask GUARDED_BY(mMutex);
+    std::thread mThread;
+};
+
+} // namespace android::compositionengine::impl
@@ -45,9 +45,35 @@ namespace compositionengine::impl {
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
 // use HWComposerBufferCache to mirror the cache in SF.
+//
+// Buffers that come with a BufferQueue slot use that slot. Buffers without
+// one, e.g. those of BufferStateLayer clients that do not use the client
+// cache, are assigned the slot that already holds the same buffer id, or else
+// the least recently used of the first kMaxSlotlessBuffers slots.
+//
+// The HAL keeps a reference to every buffer in its cache until the slot is
+// overwritten. Slots whose buffer has since been freed in SurfaceFlinger, e.g.
+// because it was erased from the ClientCache or its BufferQueue slot was
+// freed, are reported by takeFreedSlots() so that the caller can release them.
 class HwcBufferCache {
 public:
-    HwcBufferCache();
+    struct Stats {
+        // Number of buffers that were found in the HWC cache.
+        uint64_t hits = 0;
+        // Number of buffers that had to be sent to the HWC.
+        uint64_t misses = 0;
+    };
+
+    // Number of slots shared by buffers that come without a slot. Such
+    // buffers have no BufferQueue telling us how many of them the producer
+    // cycles through, so this covers a triple-buffered producer plus the
+    // buffer being replaced; more only pins more freed buffers in the HAL.
+    static constexpr uint32_t kMaxSlotlessBuffers = 4;
+
+    // |capacity| is the number of HWC cache slots to use, at most
+    // BufferQueue::NUM_BUFFER_SLOTS, which is the size of the HAL's cache.
+    explicit HwcBufferCache(uint32_t capacity = BufferQueue::NUM_BUFFER_SLOTS);
+
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
     //
@@ -56,11 +82,28 @@ public:
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                       sp<GraphicBuffer>* outBuffer);
 
+    // Forgets the slots whose buffer has been freed since it was cached and
+    // returns them. The HAL still holds those buffers until something else
+    // is written to the slots.
+    std::vector<uint32_t> takeFreedSlots();
+
+    const Stats& getStats() const { return mStats; }
+
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
-    wp<GraphicBuffer> mBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+    struct Slot {
+        wp<GraphicBuffer> buffer;
+        uint64_t bufferId = 0;
+        // The value of mUseCounter when the slot was last used, or 0 if it
+        // never was.
+        uint64_t lastUsed = 0;
+    };
+
+    uint32_t findSlotForBuffer(const sp<GraphicBuffer>& buffer) const;
+
+    // Indexed by HWC cache slot.
+    std::vector<Slot> mSlots;
+    uint64_t mUseCounter = 0;
+    Stats mStats;
 };
 
 } // namespace compositionengine::impl
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+#include <math/vec4.h>
+#include <renderengine/DisplaySettings.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
+namespace android {
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine {
+
+class LayerFE;
+
+namespace impl {
+
+struct OutputCompositionState;
+
+// The flattener renders a run of adjacent device composited layers that have
+// not changed for a number of frames into a single buffer, and has the HWC
+// present that buffer in place of the layers until one of them changes. This
+// frees overlay planes for the layers that do change, such as video, and keeps
+// the HWC from falling back to client composition when it runs out of planes.
+//
+// The buffer is set as the override of the bottom-most layer of the run, the
+// other layers of the run are skipped. See OutputLayerCompositionState.
+class LayerFlattener {
+public:
+    explicit LayerFlattener(renderengine::RenderEngine& renderEngine);
+    ~LayerFlattener();
+
+    LayerFlattener(const LayerFlattener&) = delete;
+    LayerFlattener& operator=(const LayerFlattener&) = delete;
+
+    // Sets the override state of |layers|, ordered by z, for this frame. The
+    // run of layers is rendered with |display|, which must map the layer stack
+    // onto the whole output. Returns true if the override state of any layer
+    // changed, in which case the layer geometry has to be written to the HWC
+    // again.
+    bool flatten(const renderengine::DisplaySettings& display,
+                 const OutputCompositionState& outputState,
+                 const std::vector<compositionengine::OutputLayer*>& layers,
+                 bool updatingGeometry);
+
+    // Number of layers currently presented from the flattened buffer.
+    size_t getFlattenedLayerCount() const { return mFlattenedLayers.size(); }
+
+    void dump(std::string& result) const;
+
+private:
+    // Only runs of at least this many layers are worth an extra draw.
+    static constexpr size_t kMinFlattenedLayers = 2;
+    // Number of consecutive frames a layer must be unchanged before it is flattened.
+    static constexpr uint32_t kStableFramesBeforeFlattening = 10;
+
+    // What a layer is presented from, as far as the HWC is concerned.
+    struct LayerState {
+        uint64_t bufferId = 0;
+        sp<Fence> acquireFence;
+        half4 color;
+        float alpha = 1.0f;
+        Hwc2::IComposerClient::BlendMode blendMode = Hwc2::IComposerClient::BlendMode::INVALID;
+        Hwc2::IComposerClient::Composition compositionType =
+                Hwc2::IComposerClient::Composition::INVALID;
+        Rect displayFrame;
+        FloatRect sourceCrop;
+        Hwc2::Transform bufferTransform = static_cast<Hwc2::Transform>(0);
+        ui::Dataspace dataspace = ui::Dataspace::UNKNOWN;
+        Region visibleRegion;
+
+        bool isSameAs(const LayerState& other) const;
+    };
+
+    struct TrackedLayer {
+        LayerState state;
+        // Consecutive frames the layer is unchanged, including this one.
+        uint32_t stableFrames = 0;
+    };
+
+    static LayerState getLayerState(const compositionengine::OutputLayer& layer);
+    static bool canFlatten(const compositionengine::OutputLayer& layer);
+    bool isFlattenedRunIntact(const renderengine::DisplaySettings& display,
+                              const std::vector<compositionengine::OutputLayer*>& layers) const;
+    bool render(const renderengine::DisplaySettings& display,
+                const OutputCompositionState& outputState,
+                const std::vector<compositionengine::OutputLayer*>& layers, size_t first,
+                size_t count);
+
+    renderengine::RenderEngine& mRenderEngine;
+
+    std::unordered_map<const LayerFE*, TrackedLayer> mTrackedLayers;
+
+    // The buffers are rendered in turn, so that a new run is never drawn into
+    // the buffer the HWC may still be scanning out.
+    std::array<sp<GraphicBuffer>, 2> mBuffers;
+    size_t mBufferIndex = 0;
+    uint32_t mFramesSinceRender = 0;
+
+    // The run presented from mBuffers[mBufferIndex], bottom-most layer first.
+    std::vector<const LayerFE*> mFlattenedLayers;
+    renderengine::DisplaySettings mFlattenedDisplay;
+    sp<Fence> mReadyFence;
+    Rect mDisplayFrame;
+    Region mVisibleRegion;
+
+    // A run the HWC composited by the client anyway, which is not flattened
+    // again until its layers change.
+    std::vector<const LayerFE*> mRejectedLayers;
+};
+
+} // namespace impl
+} // namespace compositionengine
+} // namespace android
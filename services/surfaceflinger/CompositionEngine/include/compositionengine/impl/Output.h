@@ -18,16 +18,22 @@
 
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/Output.h>
+#include <compositionengine/impl/ClientCompositionLayerSetCache.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <compositionengine/impl/ClientTargetDamageHistory.h>
+#include <compositionengine/impl/LayerFlattener.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
 namespace android::compositionengine::impl {
 
+struct OutputLayerCompositionState;
+
 // The implementation class contains the common implementation, but does not
 // actually contain the final output state.
 class Output : public virtual compositionengine::Output {
@@ -78,15 +84,21 @@ public:
 
     void updateLayerStateFromFE(const CompositionRefreshArgs&) const override;
     void updateAndWriteCompositionState(const compositionengine::CompositionRefreshArgs&) override;
+    void updateCompositionState(const compositionengine::CompositionRefreshArgs&) override;
     void updateColorProfile(const compositionengine::CompositionRefreshArgs&) override;
     void beginFrame() override;
     void prepareFrame() override;
+    bool canPredictCompositionStrategy(const CompositionRefreshArgs&) override;
+    void prepareFrameAsync(const CompositionRefreshArgs&) override;
     void devOptRepaintFlash(const CompositionRefreshArgs&) override;
     void finishFrame(const CompositionRefreshArgs&) override;
     std::optional<base::unique_fd> composeSurfaces(
             const Region&, const compositionengine::CompositionRefreshArgs& refreshArgs) override;
     void postFramebuffer() override;
     void cacheClientCompositionRequests(uint32_t) override;
+    void cacheClientCompositionLayerSets(bool enable) override;
+    void trackClientTargetDamage(bool enable) override;
+    void flattenStaticLayers(bool enable) override;
 
     // Testing
     const ReleasedLayers& getReleasedLayersForTest() const;
@@ -105,6 +117,9 @@ protected:
             ui::Dataspace outputDataspace) override;
     void appendRegionFlashRequests(const Region&, std::vector<LayerFE::LayerSettings>&) override;
     void setExpensiveRenderingExpected(bool enabled) override;
+    void notifyClientCompositionStarted(const Hwc2::ClientCompositionWorkload&) override;
+    void notifyClientCompositionSubmitted(nsecs_t startTime,
+                                          const std::shared_ptr<FenceTime>& readyFence) override;
     void dumpBase(std::string&) const;
 
     // Implemented by the final implementation for the final state it uses.
@@ -115,10 +130,33 @@ protected:
     virtual const compositionengine::CompositionEngine& getCompositionEngine() const = 0;
     virtual void dumpState(std::string& out) const = 0;
 
+    // Client composition done ahead of finishFrame() with a predicted
+    // composition strategy.
+    struct PredictedComposition {
+        // Set while composing with the predicted strategy.
+        bool inProgress = false;
+        // The client target that was composed with the predicted strategy. If
+        // the prediction was wrong, it is composed again instead of dequeuing
+        // another buffer.
+        sp<GraphicBuffer> clientTarget;
+        // Set if the prediction was right, so finishFrame() only has to queue
+        // the client target.
+        std::optional<base::unique_fd> readyFence;
+    };
+    PredictedComposition mPredictedComposition;
+
 private:
     void dirtyEntireOutput();
+    bool canReuseCoverage(const LayerFECompositionState&, const OutputLayerCompositionState&,
+                          const compositionengine::Output::CoverageState&) const;
+    void reuseCoverage(std::optional<size_t>, sp<compositionengine::LayerFE>&,
+                       const LayerFECompositionState&, compositionengine::Output::CoverageState&);
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
+    ClientTargetDamageHistory::Signature getClientTargetSignature(
+            const renderengine::DisplaySettings&) const;
+    void updateClientTargetDamageHistory();
+    renderengine::DisplaySettings getFlattenedLayerDisplaySettings() const;
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
 
@@ -130,6 +168,18 @@ private:
     ReleasedLayers mReleasedLayers;
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
+    std::unique_ptr<ClientCompositionLayerSetCache> mClientCompositionLayerSetCache;
+    std::unique_ptr<ClientTargetDamageHistory> mClientTargetDamageHistory;
+    std::unique_ptr<LayerFlattener> mLayerFlattener;
+
+    // The client target composed this frame, to be added to the damage
+    // history once it has been queued.
+    struct ComposedClientTarget {
+        Region damage;
+        ClientTargetDamageHistory::Signature signature;
+        bool drawn = false;
+    };
+    std::optional<ComposedClientTarget> mComposedClientTarget;
 };
 
 // This template factory function standardizes the implementation details of the
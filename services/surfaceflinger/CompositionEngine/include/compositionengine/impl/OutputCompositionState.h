@@ -32,6 +32,7 @@
 #include <ui/Rect.h>
 #include <ui/Region.h>
 #include <ui/Transform.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -57,6 +58,10 @@ struct OutputCompositionState {
     // If true, the current frame reused the buffer from a previous client composition
     bool reusedClientComposition{false};
 
+    // Main thread time spent in RenderEngine::drawLayers this frame, or -1 if
+    // client composition did not draw anything
+    nsecs_t renderEngineDuration{-1};
+
     // If true, this output displays layers that are internal-only
     bool layerStackInternal{false};
 
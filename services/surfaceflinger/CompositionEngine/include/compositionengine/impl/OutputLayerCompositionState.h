@@ -22,10 +22,13 @@
 
 #include <compositionengine/impl/HwcBufferCache.h>
 #include <renderengine/Mesh.h>
+#include <ui/Fence.h>
 #include <ui/FloatRect.h>
+#include <ui/GraphicBuffer.h>
 #include <ui/GraphicTypes.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
+#include <ui/Transform.h>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
@@ -62,6 +65,26 @@ struct OutputLayerCompositionState {
     // Region cast by the layer's shadow
     Region shadowRegion;
 
+    // The inputs and resulting coverage of the last visible region computation
+    // for this layer. If none of the inputs changed, the regions above are
+    // still valid and do not need to be recomputed.
+    struct CoverageCache {
+        bool valid{false};
+        ui::Transform geomLayerTransform;
+        FloatRect geomLayerBounds;
+        float shadowRadius{0.f};
+        bool isOpaque{false};
+        Region transparentRegionHint;
+        ui::Transform outputTransform;
+        Rect outputBounds;
+        Rect outputViewport;
+        Region aboveCoveredLayersIn;
+        Region aboveOpaqueLayersIn;
+        Region aboveCoveredLayersOut;
+        Region aboveOpaqueLayersOut;
+    };
+    CoverageCache coverageCache;
+
     // If true, client composition will be used on this output
     bool forceClientComposition{false};
 
@@ -83,6 +106,24 @@ struct OutputLayerCompositionState {
     // The Z order index of this layer on this output
     uint32_t z{0};
 
+    // Overrides the state the HWC presents this layer from, when the layer is
+    // part of a run of layers flattened into a single buffer by LayerFlattener.
+    struct OverrideInfo {
+        // The buffer holding the flattened run, set on the bottom-most layer
+        // of the run only. It is in output space, and presented 1:1.
+        sp<GraphicBuffer> buffer;
+        sp<Fence> acquireFence;
+        Rect displayFrame;
+        ui::Dataspace dataspace{ui::Dataspace::UNKNOWN};
+        Region visibleRegion;
+        // The whole buffer on the frame it is first presented, empty after.
+        Region surfaceDamage;
+
+        // Set on the other layers of the run, whose content is in the buffer.
+        bool skip{false};
+    };
+    OverrideInfo overrideInfo;
+
     /*
      * HWC state
      */
@@ -55,6 +55,8 @@ public:
     status_t beginFrame(bool mustRecompose) override;
     void prepareFrame(bool usesClientComposition, bool usesDeviceComposition) override;
     sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) override;
+    int getBufferAge() const override { return mBufferAge; }
+    void setSurfaceDamage(const Region& damage) override;
     void queueBuffer(base::unique_fd readyFence) override;
     void onPresentDisplayCompleted() override;
     void flip() override;
@@ -79,6 +81,10 @@ private:
     const sp<ANativeWindow> mNativeWindow;
     // Current buffer being rendered into
     sp<GraphicBuffer> mGraphicBuffer;
+    // Age of mGraphicBuffer when it was dequeued
+    int mBufferAge{0};
+    // Damage of the next queued buffer, or empty for the whole buffer
+    Region mSurfaceDamage;
     const sp<DisplaySurface> mDisplaySurface;
     ui::Size mSize;
     bool mProtected{false};
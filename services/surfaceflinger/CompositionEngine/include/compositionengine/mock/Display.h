@@ -41,6 +41,9 @@ public:
     MOCK_METHOD1(createDisplayColorProfile, void(const DisplayColorProfileCreationArgs&));
     MOCK_METHOD1(createRenderSurface, void(const RenderSurfaceCreationArgs&));
     MOCK_METHOD1(createClientCompositionCache, void(uint32_t));
+    MOCK_METHOD0(createClientCompositionLayerSetCache, void());
+    MOCK_METHOD0(createClientTargetDamageHistory, void());
+    MOCK_METHOD0(createLayerFlattener, void());
 };
 
 } // namespace android::compositionengine::mock
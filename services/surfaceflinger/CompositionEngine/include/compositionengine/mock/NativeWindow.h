@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <system/window.h>
 #include <ui/ANativeObjectBase.h>
@@ -46,6 +48,7 @@ public:
     MOCK_METHOD1(setBuffersFormat, int(PixelFormat));
     MOCK_METHOD1(setBuffersDataSpace, int(ui::Dataspace));
     MOCK_METHOD1(setUsage, int(uint64_t));
+    MOCK_METHOD1(setSurfaceDamage, int(std::vector<android_native_rect_t>));
 };
 
 } // namespace android::compositionengine::mock
@@ -87,11 +87,15 @@ public:
 
     MOCK_CONST_METHOD1(updateLayerStateFromFE, void(const CompositionRefreshArgs&));
     MOCK_METHOD1(updateAndWriteCompositionState, void(const CompositionRefreshArgs&));
+    MOCK_METHOD1(updateCompositionState, void(const CompositionRefreshArgs&));
     MOCK_METHOD1(updateColorProfile, void(const compositionengine::CompositionRefreshArgs&));
 
     MOCK_METHOD0(beginFrame, void());
 
     MOCK_METHOD0(prepareFrame, void());
+    MOCK_METHOD1(canPredictCompositionStrategy,
+                 bool(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(prepareFrameAsync, void(const compositionengine::CompositionRefreshArgs&));
     MOCK_METHOD0(chooseCompositionStrategy, void());
 
     MOCK_METHOD1(devOptRepaintFlash, void(const compositionengine::CompositionRefreshArgs&));
@@ -112,7 +116,13 @@ public:
     MOCK_METHOD2(appendRegionFlashRequests,
                  void(const Region&, std::vector<LayerFE::LayerSettings>&));
     MOCK_METHOD1(setExpensiveRenderingExpected, void(bool));
+    MOCK_METHOD1(notifyClientCompositionStarted, void(const Hwc2::ClientCompositionWorkload&));
+    MOCK_METHOD2(notifyClientCompositionSubmitted,
+                 void(nsecs_t, const std::shared_ptr<FenceTime>&));
     MOCK_METHOD1(cacheClientCompositionRequests, void(uint32_t));
+    MOCK_METHOD1(cacheClientCompositionLayerSets, void(bool));
+    MOCK_METHOD1(trackClientTargetDamage, void(bool));
+    MOCK_METHOD1(flattenStaticLayers, void(bool));
 };
 
 } // namespace android::compositionengine::mock
@@ -40,6 +40,8 @@ public:
     MOCK_METHOD1(beginFrame, status_t(bool mustRecompose));
     MOCK_METHOD2(prepareFrame, void(bool, bool));
     MOCK_METHOD1(dequeueBuffer, sp<GraphicBuffer>(base::unique_fd*));
+    MOCK_CONST_METHOD0(getBufferAge, int());
+    MOCK_METHOD1(setSurfaceDamage, void(const Region&));
     MOCK_METHOD1(queueBuffer, void(base::unique_fd));
     MOCK_METHOD1(flipClientTarget, void(bool flip));
     MOCK_METHOD0(onPresentDisplayCompleted, void());
@@ -77,6 +77,13 @@ static int forwardPerform(ANativeWindow* window, int operation, ...) {
             result = static_cast<NativeWindow*>(window)->disconnect(api);
             break;
         }
+        case NATIVE_WINDOW_SET_SURFACE_DAMAGE: {
+            const auto* rects = va_arg(args, const android_native_rect_t*);
+            const size_t count = va_arg(args, size_t);
+            result = static_cast<NativeWindow*>(window)->setSurfaceDamage(
+                    std::vector<android_native_rect_t>(rects, rects + count));
+            break;
+        }
         default:
             LOG_ALWAYS_FATAL("Unexpected operation %d", operation);
             break;
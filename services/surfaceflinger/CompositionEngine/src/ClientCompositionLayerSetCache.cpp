@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <android-base/unique_fd.h>
+#include <compositionengine/impl/ClientCompositionLayerSetCache.h>
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <log/log.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+ClientCompositionLayerSetCache::ClientCompositionLayerSetCache(
+        renderengine::RenderEngine& renderEngine)
+      : mRenderEngine(renderEngine) {
+    mRenderEngine.genTextures(1, &mTextureName);
+}
+
+ClientCompositionLayerSetCache::~ClientCompositionLayerSetCache() {
+    if (mBuffer) {
+        mRenderEngine.unbindExternalTextureBuffer(mBuffer->getId());
+    }
+    mRenderEngine.deleteTextures(1, &mTextureName);
+}
+
+void ClientCompositionLayerSetCache::apply(const renderengine::DisplaySettings& display,
+                                           const sp<GraphicBuffer>& target,
+                                           std::vector<LayerFE::LayerSettings>& layers) {
+    if (!canCache(display, target)) {
+        reset();
+        return;
+    }
+
+    // Count the bottom-most layers that are unchanged since the previous frame.
+    size_t stableLayerCount = 0;
+    if (display == mPreviousDisplay) {
+        const size_t maxCount = std::min(layers.size(), mPreviousLayers.size());
+        while (stableLayerCount < maxCount &&
+               layerSettingsAreEqual(layers[stableLayerCount], mPreviousLayers[stableLayerCount])) {
+            stableLayerCount++;
+        }
+    }
+
+    mPreviousDisplay = display;
+    mPreviousLayers.clear();
+    mPreviousLayers.reserve(layers.size());
+    for (const LayerFE::LayerSettings& settings : layers) {
+        mPreviousLayers.push_back(getLayerSettingsSnapshot(settings));
+    }
+
+    if (stableLayerCount == mStableLayerCount) {
+        mStableFrameCount++;
+    } else {
+        mStableLayerCount = stableLayerCount;
+        mStableFrameCount = 0;
+    }
+
+    // One of the cached layers changed, so the offscreen buffer is stale.
+    if (stableLayerCount < mCachedLayerCount) {
+        mCachedLayerCount = 0;
+    }
+
+    if (stableLayerCount > mCachedLayerCount && stableLayerCount >= kMinCachedLayers &&
+        mStableFrameCount >= kStableFramesBeforeCaching) {
+        mCachedLayerCount = render(display, target, layers, stableLayerCount) ? stableLayerCount
+                                                                              : 0;
+    }
+
+    if (mCachedLayerCount == 0) {
+        return;
+    }
+
+    layers.erase(layers.begin(), layers.begin() + static_cast<ptrdiff_t>(mCachedLayerCount - 1));
+    layers.front() = getCachedLayerSettings(display);
+}
+
+bool ClientCompositionLayerSetCache::canCache(const renderengine::DisplaySettings& display,
+                                              const sp<GraphicBuffer>& target) const {
+    // Protected content must never be copied into an unprotected buffer.
+    if (target == nullptr || mRenderEngine.isProtected()) {
+        return false;
+    }
+
+    // The offscreen buffer has to map 1:1 onto the client target.
+    const Rect targetBounds(target->getWidth(), target->getHeight());
+    return display.physicalDisplay == targetBounds && display.clip == targetBounds &&
+            display.orientation == ui::Transform::ROT_0 && display.colorTransform == mat4();
+}
+
+bool ClientCompositionLayerSetCache::render(const renderengine::DisplaySettings& display,
+                                            const sp<GraphicBuffer>& target,
+                                            const std::vector<LayerFE::LayerSettings>& layers,
+                                            size_t count) {
+    ATRACE_CALL();
+
+    if (mBuffer == nullptr || mBuffer->getWidth() != target->getWidth() ||
+        mBuffer->getHeight() != target->getHeight() ||
+        mBuffer->getPixelFormat() != target->getPixelFormat()) {
+        if (mBuffer) {
+            mRenderEngine.unbindExternalTextureBuffer(mBuffer->getId());
+        }
+        mBuffer = new GraphicBuffer(target->getWidth(), target->getHeight(),
+                                    target->getPixelFormat(), 1,
+                                    GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE,
+                                    "ClientCompositionLayerSetCache");
+        if (mBuffer->initCheck() != NO_ERROR) {
+            ALOGE("Failed to allocate the client composition layer set buffer");
+            mBuffer = nullptr;
+            return false;
+        }
+    }
+
+    std::vector<const renderengine::LayerSettings*> layerPointers;
+    layerPointers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        layerPointers.push_back(&layers[i]);
+    }
+
+    base::unique_fd readyFence;
+    const status_t status =
+            mRenderEngine.drawLayers(display, layerPointers, mBuffer->getNativeBuffer(),
+                                     /*useFramebufferCache=*/true, base::unique_fd(), &readyFence);
+    if (status != NO_ERROR) {
+        return false;
+    }
+
+    mReadyFence = readyFence.ok() ? new Fence(readyFence.release()) : Fence::NO_FENCE;
+    mGeneration++;
+    return true;
+}
+
+LayerFE::LayerSettings ClientCompositionLayerSetCache::getCachedLayerSettings(
+        const renderengine::DisplaySettings& display) const {
+    LayerFE::LayerSettings settings;
+    settings.geometry.boundaries = display.physicalDisplay.toFloatRect();
+    settings.source.buffer.buffer = mBuffer;
+    settings.source.buffer.fence = mReadyFence;
+    settings.source.buffer.textureName = mTextureName;
+    settings.sourceDataspace = display.outputDataspace;
+    settings.alpha = half(1.0f);
+    // Keep the transparent holes punched for device composited layers.
+    settings.disableBlending = true;
+    settings.bufferId = mBuffer->getId();
+    settings.frameNumber = mGeneration;
+    return settings;
+}
+
+void ClientCompositionLayerSetCache::reset() {
+    mCachedLayerCount = 0;
+    mPreviousLayers.clear();
+    mStableLayerCount = 0;
+    mStableFrameCount = 0;
+}
+
+} // namespace android::compositionengine::impl
@@ -23,12 +23,6 @@
 namespace android::compositionengine::impl {
 
 namespace {
-LayerFE::LayerSettings getLayerSettingsSnapshot(const LayerFE::LayerSettings& settings) {
-    LayerFE::LayerSettings snapshot = settings;
-    snapshot.source.buffer.buffer = nullptr;
-    snapshot.source.buffer.fence = nullptr;
-    return snapshot;
-}
 
 inline bool equalIgnoringSource(const renderengine::LayerSettings& lhs,
                                 const renderengine::LayerSettings& rhs) {
@@ -61,13 +55,20 @@ inline bool equalIgnoringBuffer(const renderengine::LayerSettings& lhs,
             equalIgnoringBuffer(lhs.source.buffer, rhs.source.buffer);
 }
 
+} // namespace
+
+LayerFE::LayerSettings getLayerSettingsSnapshot(const LayerFE::LayerSettings& settings) {
+    LayerFE::LayerSettings snapshot = settings;
+    snapshot.source.buffer.buffer = nullptr;
+    snapshot.source.buffer.fence = nullptr;
+    return snapshot;
+}
+
 bool layerSettingsAreEqual(const LayerFE::LayerSettings& lhs, const LayerFE::LayerSettings& rhs) {
     return lhs.bufferId == rhs.bufferId && lhs.frameNumber == rhs.frameNumber &&
             equalIgnoringBuffer(lhs, rhs);
 }
 
-} // namespace
-
 ClientCompositionRequestCache::ClientCompositionRequest::ClientCompositionRequest(
         const renderengine::DisplaySettings& initDisplay,
         const std::vector<LayerFE::LayerSettings>& initLayerSettings)
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/stringprintf.h>
+#include <compositionengine/impl/ClientTargetDamageHistory.h>
+
+namespace android::compositionengine::impl {
+
+void ClientTargetDamageHistory::addDamage(const Region& damage) {
+    mPendingDamage.orSelf(damage);
+}
+
+Region ClientTargetDamageHistory::getDamage(const Rect& bounds, const Signature& signature,
+                                            const Region& frameDamage) const {
+    if (!mSignature || !(*mSignature == signature)) {
+        return Region(bounds);
+    }
+    return mPendingDamage.merge(frameDamage).intersect(bounds);
+}
+
+Region ClientTargetDamageHistory::getRedrawRegion(const Rect& bounds, int bufferAge,
+                                                  const Region& damage) const {
+    if (bufferAge <= 0 || static_cast<size_t>(bufferAge) > mQueuedTargets.size()) {
+        return Region(bounds);
+    }
+
+    const auto buffer = mQueuedTargets.end() - bufferAge;
+    if (!buffer->drawn) {
+        return Region(bounds);
+    }
+
+    Region redraw = damage;
+    for (auto target = buffer + 1; target != mQueuedTargets.end(); ++target) {
+        redraw.orSelf(target->damage);
+    }
+    return redraw.intersect(bounds);
+}
+
+void ClientTargetDamageHistory::onClientTargetQueued(const Region& damage, Signature signature,
+                                                     bool drawn) {
+    if (mQueuedTargets.size() == kMaxQueuedTargets) {
+        mQueuedTargets.pop_front();
+    }
+    mQueuedTargets.push_back({damage, drawn});
+
+    if (drawn) {
+        mSignature = std::move(signature);
+    } else {
+        mSignature.reset();
+    }
+    mPendingDamage.clear();
+}
+
+void ClientTargetDamageHistory::reset() {
+    mQueuedTargets.clear();
+    mSignature.reset();
+    mPendingDamage.clear();
+}
+
+void ClientTargetDamageHistory::dump(std::string& result) const {
+    base::StringAppendF(&result, "   Client target damage history (oldest first):");
+    for (const auto& target : mQueuedTargets) {
+        const Rect bounds = target.damage.getBounds();
+        base::StringAppendF(&result, " [%d %d %d %d]%s", bounds.left, bounds.top, bounds.right,
+                            bounds.bottom, target.drawn ? "" : " (not drawn)");
+    }
+    result.append("\n");
+}
+
+} // namespace android::compositionengine::impl
@@ -14,12 +14,15 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <compositionengine/CompositionRefreshArgs.h>
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
+#include <compositionengine/impl/OutputCompositionState.h>
 
 #include <renderengine/RenderEngine.h>
 #include <utils/Trace.h>
@@ -100,6 +103,10 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
         // needed for anything else.
         LayerFESet latchedLayers;
 
+        if (args.updatingOutputGeometryThisFrame) {
+            snapshotLayerGeometry(args, latchedLayers);
+        }
+
         for (const auto& output : args.outputs) {
             output->prepare(args, latchedLayers);
         }
@@ -107,11 +114,61 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    if (args.parallelFor && args.outputs.size() > 1) {
+        updateOutputCompositionStateConcurrently(args);
+    }
+
+    // Outputs are presented one at a time. The composer client encodes the
+    // commands for all displays into one command queue, and reads the present
+    // and release fences back from the results of the last execute, so presents
+    // can't be issued concurrently without losing fences. The HAL serializes
+    // executeCommands as well, and RenderEngine composes on a single context.
     for (const auto& output : args.outputs) {
         output->present(args);
     }
 }
 
+void CompositionEngine::snapshotLayerGeometry(CompositionRefreshArgs& args,
+                                              LayerFESet& latchedLayers) {
+    ATRACE_CALL();
+
+    args.layerGeometrySnapshot.clear();
+
+    // The outputs only latch the layers if they rebuild their layer stack.
+    const bool anyOutputEnabled =
+            std::any_of(args.outputs.cbegin(), args.outputs.cend(),
+                        [](const auto& output) { return output->getState().isEnabled; });
+    if (!anyOutputEnabled) {
+        return;
+    }
+
+    // Every output would latch every layer before checking whether it belongs
+    // on it, so latch them all once here.
+    args.layerGeometrySnapshot.reserve(args.layers.size());
+    latchedLayers.reserve(args.layers.size());
+    for (const auto& layer : args.layers) {
+        layer->prepareCompositionState(LayerFE::StateSubset::BasicGeometry);
+        latchedLayers.insert(layer);
+        args.layerGeometrySnapshot.add(layer->getCompositionState());
+    }
+}
+
+void CompositionEngine::updateOutputCompositionStateConcurrently(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // The color profile is pushed to the HWC, so it is picked on this thread.
+    // The per-layer state only depends on it and on the latched front-end
+    // state. HWC and RenderEngine work still happens in present(), one output
+    // at a time.
+    for (const auto& output : args.outputs) {
+        output->updateColorProfile(args);
+    }
+
+    args.parallelFor(args.outputs.size(),
+                     [&args](size_t i) { args.outputs[i]->updateCompositionState(args); });
+    args.outputCompositionStateUpdated = true;
+}
+
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
     std::unordered_map<compositionengine::LayerFE*, compositionengine::LayerFECompositionState*>
             uniqueVisibleLayers;
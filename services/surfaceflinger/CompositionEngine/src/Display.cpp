@@ -126,9 +126,12 @@ void Display::disconnect() {
 }
 
 void Display::setColorTransform(const compositionengine::CompositionRefreshArgs& args) {
+    const bool changed = args.colorTransformMatrix &&
+            *args.colorTransformMatrix != getState().colorTransformMatrix;
     Output::setColorTransform(args);
 
-    if (!mId || CC_LIKELY(!args.colorTransformMatrix)) {
+    // The HWC starts out with an identity transform, same as the state.
+    if (!mId || CC_LIKELY(!changed)) {
         return;
     }
 
@@ -193,6 +196,18 @@ void Display::createClientCompositionCache(uint32_t cacheSize) {
     cacheClientCompositionRequests(cacheSize);
 }
 
+void Display::createClientCompositionLayerSetCache() {
+    cacheClientCompositionLayerSets(true);
+}
+
+void Display::createClientTargetDamageHistory() {
+    trackClientTargetDamage(true);
+}
+
+void Display::createLayerFlattener() {
+    flattenStaticLayers(true);
+}
+
 std::unique_ptr<compositionengine::OutputLayer> Display::createOutputLayer(
         const sp<compositionengine::LayerFE>& layerFE) const {
     auto result = impl::createOutputLayer(*this, layerFE);
@@ -273,8 +288,106 @@ void Display::chooseCompositionStrategy() {
     // Get any composition changes requested by the HWC device, and apply them.
     std::optional<android::HWComposer::DeviceRequestedChanges> changes;
     auto& hwc = getCompositionEngine().getHwComposer();
+    RequestedCompositionTypes requestedTypes = getRequestedCompositionTypes();
+
+    updateScreenshotAnimationState();
+    status_t result =
+            hwc.getDeviceCompositionChanges(*mId, anyLayersRequireClientComposition(), &changes);
+    rememberCompositionStrategy(result, std::move(requestedTypes), changes);
+    if (result != NO_ERROR) {
+        ALOGE("chooseCompositionStrategy failed for %s: %d (%s)", getName().c_str(), result,
+              strerror(-result));
+        return;
+    }
+
+    applyCompositionStrategy(changes);
+}
+
+bool Display::canPredictCompositionStrategy(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    if (!refreshArgs.predictCompositionStrategy || !mId || mIsVirtual || !getState().isEnabled ||
+        refreshArgs.devOptFlashDirtyRegionsDelay || refreshArgs.updatingGeometryThisFrame) {
+        return false;
+    }
+
+    // Frames without client composition go through presentOrValidate(), which
+    // already lets the HWC skip validation. With client composition the HWC
+    // has to validate, but that can overlap with client composition.
+    if (!anyLayersRequireClientComposition()) {
+        return false;
+    }
+
+    // The HWC is expected to make the same changes as for the last validated
+    // frame if it is asked for the same composition types on the same layers,
+    // e.g. when only buffer contents have changed.
+    return !mPreviousRequestedTypes.empty() &&
+            getRequestedCompositionTypes() == mPreviousRequestedTypes;
+}
+
+void Display::prepareFrameAsync(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    Output::chooseCompositionStrategy();
+    updateScreenshotAnimationState();
+
+    RequestedCompositionTypes requestedTypes = getRequestedCompositionTypes();
+    const bool flipClientTarget = getState().flipClientTarget;
+
+    if (!mHwcAsyncWorker) {
+        mHwcAsyncWorker = std::make_unique<HwcAsyncWorker>();
+    }
+
+    // The layer state is not touched by the worker, as the main thread changes
+    // it while composing with the predicted strategy.
+    std::optional<android::HWComposer::DeviceRequestedChanges> changes;
+    auto& hwc = getCompositionEngine().getHwComposer();
+    const DisplayId id = *mId;
+    auto validate = mHwcAsyncWorker->send([&hwc, id, &changes]() {
+        return hwc.getDeviceCompositionChanges(id, /*frameUsesClientComposition=*/true, &changes);
+    });
+
+    applyCompositionStrategy(mPreviousChanges);
+    mPredictedComposition.inProgress = true;
+    auto readyFence = composeSurfaces(Region::INVALID_REGION, refreshArgs);
+    mPredictedComposition.inProgress = false;
+
+    const status_t result = validate.get();
+    if (result == NO_ERROR && changes == mPreviousChanges) {
+        ATRACE_NAME("CompositionStrategyPredicted");
+        mPredictedComposition.clientTarget = nullptr;
+        mPredictedComposition.readyFence = std::move(readyFence);
+    } else {
+        ATRACE_NAME("CompositionStrategyMispredicted");
+        // Undo the predicted strategy. finishFrame() composes the client
+        // target again, with the strategy the HWC actually chose.
+        auto requestedType = requestedTypes.cbegin();
+        for (auto* layer : getOutputLayersOrderedByZ()) {
+            layer->prepareForDeviceLayerRequests();
+            if (auto& hwcState = layer->editState().hwc) {
+                hwcState->hwcCompositionType = (requestedType++)->second;
+            }
+        }
+        editState().flipClientTarget = flipClientTarget;
+        getRenderSurface()->setBufferDataspace(getState().dataspace);
+
+        Output::chooseCompositionStrategy();
+        if (result == NO_ERROR) {
+            applyCompositionStrategy(changes);
+        } else {
+            ALOGE("prepareFrameAsync failed for %s: %d (%s)", getName().c_str(), result,
+                  strerror(-result));
+        }
+    }
+    rememberCompositionStrategy(result, std::move(requestedTypes), changes);
 
+    const auto& state = getState();
+    getRenderSurface()->prepareFrame(state.usesClientComposition, state.usesDeviceComposition);
+}
+
+void Display::updateScreenshotAnimationState() {
 #ifdef QTI_DISPLAY_CONFIG_ENABLED
+    auto& hwc = getCompositionEngine().getHwComposer();
     auto layers = getOutputLayersOrderedByZ();
     bool hasScreenshot = std::any_of(layers.begin(), layers.end(), [](auto* layer) {
          return layer->getLayerFE().getCompositionState()->isScreenshot;
@@ -288,13 +401,22 @@ void Display::chooseCompositionStrategy() {
         }
     }
 #endif
-    if (status_t result = hwc.getDeviceCompositionChanges(*mId, anyLayersRequireClientComposition(),
-                                                          &changes);
-        result != NO_ERROR) {
-        ALOGE("chooseCompositionStrategy failed for %s: %d (%s)", getName().c_str(), result,
-              strerror(-result));
+}
+
+void Display::rememberCompositionStrategy(
+        status_t result, RequestedCompositionTypes&& requestedTypes,
+        const std::optional<DeviceRequestedChanges>& changes) {
+    if (result != NO_ERROR) {
+        mPreviousRequestedTypes.clear();
+        mPreviousChanges.reset();
         return;
     }
+
+    mPreviousRequestedTypes = std::move(requestedTypes);
+    mPreviousChanges = changes;
+}
+
+void Display::applyCompositionStrategy(const std::optional<DeviceRequestedChanges>& changes) {
     if (changes) {
         applyChangedTypesToLayers(changes->changedTypes);
         applyDisplayRequests(changes->displayRequests);
@@ -308,6 +430,16 @@ void Display::chooseCompositionStrategy() {
     state.usesDeviceComposition = !allLayersRequireClientComposition();
 }
 
+Display::RequestedCompositionTypes Display::getRequestedCompositionTypes() const {
+    RequestedCompositionTypes types;
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        if (const auto& hwcState = layer->getState().hwc) {
+            types.emplace_back(hwcState->hwcLayer.get(), hwcState->hwcCompositionType);
+        }
+    }
+    return types;
+}
+
 bool Display::getSkipColorTransform() const {
     const auto& hwc = getCompositionEngine().getHwComposer();
     return mId ? hwc.hasDisplayCapability(*mId, hal::DisplayCapability::SKIP_CLIENT_COLOR_TRANSFORM)
@@ -412,6 +544,19 @@ void Display::setExpensiveRenderingExpected(bool enabled) {
     }
 }
 
+void Display::notifyClientCompositionStarted(const Hwc2::ClientCompositionWorkload& workload) {
+    if (mPowerAdvisor && mId) {
+        mPowerAdvisor->notifyClientCompositionStarted(*mId, workload);
+    }
+}
+
+void Display::notifyClientCompositionSubmitted(nsecs_t startTime,
+                                               const std::shared_ptr<FenceTime>& readyFence) {
+    if (mPowerAdvisor && mId) {
+        mPowerAdvisor->notifyClientCompositionSubmitted(*mId, startTime, readyFence);
+    }
+}
+
 void Display::finishFrame(const compositionengine::CompositionRefreshArgs& refreshArgs) {
     // We only need to actually compose the display if:
     // 1) It is being handled by hardware composer, which may need this to
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/HwcAsyncWorker.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <log/log.h>
+
+namespace android::compositionengine::impl {
+
+HwcAsyncWorker::HwcAsyncWorker() {
+    mThread = std::thread(&HwcAsyncWorker::run, this);
+    pthread_setname_np(mThread.native_handle(), "HwcAsyncWorker");
+}
+
+HwcAsyncWorker::~HwcAsyncWorker() {
+    {
+        std::lock_guard lock(mMutex);
+        mDone = true;
+    }
+    mCv.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+std::future<status_t> HwcAsyncWorker::send(std::function<status_t()> task) {
+    std::future<status_t> result;
+    {
+        std::lock_guard lock(mMutex);
+        LOG_ALWAYS_FATAL_IF(mTaskRequested, "HwcAsyncWorker already has a task in flight");
+        mTask = std::packaged_task<status_t()>(std::move(task));
+        result = mTask.get_future();
+        mTaskRequested = true;
+    }
+    mCv.notify_one();
+    return result;
+}
+
+void HwcAsyncWorker::run() {
+    // The main thread waits on this thread, so it must not be starved by it.
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        ALOGW("Couldn't set SCHED_FIFO for HwcAsyncWorker");
+    }
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCv.wait(lock, [this]() REQUIRES(mMutex) { return mDone || mTaskRequested; });
+        if (mDone) {
+            break;
+        }
+        mTask();
+        mTaskRequested = false;
+    }
+}
+
+} // namespace android::compositionengine::impl
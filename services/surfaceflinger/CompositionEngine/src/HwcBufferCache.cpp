@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
 #include <compositionengine/impl/HwcBufferCache.h>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -28,31 +30,66 @@
 
 namespace android::compositionengine::impl {
 
-HwcBufferCache::HwcBufferCache() {
-    std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
-}
+HwcBufferCache::HwcBufferCache(uint32_t capacity)
+      : mSlots(std::clamp<uint32_t>(capacity, 1, BufferQueue::NUM_BUFFER_SLOTS)) {}
 
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
-    // default is 0
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        slot >= BufferQueue::NUM_BUFFER_SLOTS) {
-        *outSlot = 0;
-    } else {
+    if (slot >= 0 && static_cast<size_t>(slot) < mSlots.size()) {
         *outSlot = static_cast<uint32_t>(slot);
+    } else {
+        *outSlot = findSlotForBuffer(buffer);
     }
 
-    auto& currentBuffer = mBuffers[*outSlot];
+    Slot& currentSlot = mSlots[*outSlot];
+    currentSlot.lastUsed = ++mUseCounter;
+
     wp<GraphicBuffer> weakCopy(buffer);
-    if (currentBuffer == weakCopy) {
+    if (currentSlot.buffer == weakCopy) {
         // already cached in HWC, skip sending the buffer
         *outBuffer = nullptr;
+        mStats.hits++;
     } else {
         *outBuffer = buffer;
+        mStats.misses++;
 
         // update cache
-        currentBuffer = buffer;
+        currentSlot.buffer = buffer;
+        currentSlot.bufferId = buffer ? buffer->getId() : 0;
+    }
+}
+
+uint32_t HwcBufferCache::findSlotForBuffer(const sp<GraphicBuffer>& buffer) const {
+    if (buffer == nullptr) {
+        return 0;
+    }
+
+    const uint64_t bufferId = buffer->getId();
+    const wp<GraphicBuffer> weakCopy(buffer);
+    const uint32_t slotCount = std::min<uint32_t>(mSlots.size(), kMaxSlotlessBuffers);
+    uint32_t leastRecentlyUsed = 0;
+    for (uint32_t i = 0; i < slotCount; i++) {
+        const Slot& slot = mSlots[i];
+        if (slot.bufferId == bufferId && slot.buffer == weakCopy) {
+            return i;
+        }
+        if (slot.lastUsed < mSlots[leastRecentlyUsed].lastUsed) {
+            leastRecentlyUsed = i;
+        }
+    }
+    return leastRecentlyUsed;
+}
+
+std::vector<uint32_t> HwcBufferCache::takeFreedSlots() {
+    std::vector<uint32_t> freedSlots;
+    for (uint32_t i = 0; i < mSlots.size(); i++) {
+        Slot& slot = mSlots[i];
+        if (slot.bufferId != 0 && slot.buffer.promote() == nullptr) {
+            slot = Slot();
+            freedSlots.push_back(i);
+        }
     }
+    return freedSlots;
 }
 
 } // namespace android::compositionengine::impl
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/LayerFEGeometrySnapshot.h>
+
+namespace android::compositionengine {
+
+void LayerFEGeometrySnapshot::clear() {
+    mLayerStackIds.clear();
+    mFlags.clear();
+}
+
+void LayerFEGeometrySnapshot::reserve(size_t count) {
+    mLayerStackIds.reserve(count);
+    mFlags.reserve(count);
+}
+
+void LayerFEGeometrySnapshot::add(const LayerFECompositionState* state) {
+    uint8_t flags = 0;
+    uint32_t layerStackId = 0;
+    if (state && state->isVisible && state->layerStackId) {
+        flags |= kVisible;
+        layerStackId = *state->layerStackId;
+    }
+    if (state && state->internalOnly) {
+        flags |= kInternalOnly;
+    }
+
+    mLayerStackIds.push_back(layerStackId);
+    mFlags.push_back(flags);
+}
+
+} // namespace android::compositionengine
@@ -0,0 +1,334 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <compositionengine/FodExtension.h>
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/LayerFlattener.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <log/log.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+bool isHdrDataspace(ui::Dataspace dataspace) {
+    const auto transfer = static_cast<ui::Dataspace>(static_cast<int32_t>(dataspace) &
+                                                     static_cast<int32_t>(
+                                                             ui::Dataspace::TRANSFER_MASK));
+    return transfer == ui::Dataspace::TRANSFER_ST2084 || transfer == ui::Dataspace::TRANSFER_HLG;
+}
+
+} // namespace
+
+LayerFlattener::LayerFlattener(renderengine::RenderEngine& renderEngine)
+      : mRenderEngine(renderEngine) {}
+
+LayerFlattener::~LayerFlattener() = default;
+
+bool LayerFlattener::LayerState::isSameAs(const LayerState& other) const {
+    return bufferId == other.bufferId && acquireFence == other.acquireFence &&
+            color == other.color && alpha == other.alpha && blendMode == other.blendMode &&
+            compositionType == other.compositionType && displayFrame == other.displayFrame &&
+            sourceCrop == other.sourceCrop && bufferTransform == other.bufferTransform &&
+            dataspace == other.dataspace && visibleRegion.hasSameRects(other.visibleRegion);
+}
+
+bool LayerFlattener::flatten(const renderengine::DisplaySettings& display,
+                             const OutputCompositionState& outputState,
+                             const std::vector<compositionengine::OutputLayer*>& layers,
+                             bool updatingGeometry) {
+    ATRACE_CALL();
+    mFramesSinceRender++;
+
+    // Count the frames each layer has been presented unchanged. Any change to
+    // the layer state, such as its corner radius, marks its content dirty on
+    // the next geometry update.
+    std::unordered_map<const LayerFE*, TrackedLayer> trackedLayers;
+    trackedLayers.reserve(layers.size());
+    for (const auto* layer : layers) {
+        const LayerFE* layerFE = &layer->getLayerFE();
+        const auto* layerFEState = layerFE->getCompositionState();
+        TrackedLayer tracked{getLayerState(*layer), 1};
+        const bool contentDirty = updatingGeometry && layerFEState && layerFEState->contentDirty;
+        if (const auto it = mTrackedLayers.find(layerFE); it != mTrackedLayers.end() &&
+            !contentDirty && it->second.state.isSameAs(tracked.state)) {
+            tracked.stableFrames = it->second.stableFrames + 1;
+        }
+        trackedLayers.emplace(layerFE, std::move(tracked));
+    }
+    mTrackedLayers = std::move(trackedLayers);
+
+    const auto getStableFrames = [&](const compositionengine::OutputLayer* layer) -> uint32_t {
+        const auto it = mTrackedLayers.find(&layer->getLayerFE());
+        return it != mTrackedLayers.end() && canFlatten(*layer) ? it->second.stableFrames : 0;
+    };
+
+    // A run the HWC composited by the client may be flattened again once one
+    // of its layers changed.
+    if (std::any_of(mRejectedLayers.begin(), mRejectedLayers.end(), [&](const LayerFE* layerFE) {
+            const auto it = mTrackedLayers.find(layerFE);
+            return it == mTrackedLayers.end() || it->second.stableFrames == 1;
+        })) {
+        mRejectedLayers.clear();
+    }
+
+    // The HWC composited the flattened buffer by the client, so it did not
+    // save an overlay plane.
+    if (std::any_of(layers.begin(), layers.end(), [](const auto* layer) {
+            return layer->getState().overrideInfo.buffer && layer->requiresClientComposition();
+        })) {
+        mRejectedLayers = std::move(mFlattenedLayers);
+        mFlattenedLayers.clear();
+    }
+
+    // Protected content can't be rendered into the unprotected buffers.
+    const bool canRender = !mRenderEngine.isProtected();
+    if (!canRender || !isFlattenedRunIntact(display, layers)) {
+        mFlattenedLayers.clear();
+    }
+
+    // Find the longest run of adjacent layers unchanged for long enough.
+    size_t runFirst = 0;
+    size_t runCount = 0;
+    for (size_t i = 0; i < layers.size();) {
+        size_t end = i;
+        while (end < layers.size() &&
+               getStableFrames(layers[end]) >= kStableFramesBeforeFlattening) {
+            end++;
+        }
+        if (end - i > runCount) {
+            runFirst = i;
+            runCount = end - i;
+        }
+        i = std::max(end, i + 1);
+    }
+
+    const auto isRejected = [&]() {
+        return runCount == mRejectedLayers.size() &&
+                std::equal(mRejectedLayers.begin(), mRejectedLayers.end(),
+                           layers.begin() + static_cast<ptrdiff_t>(runFirst),
+                           [](const LayerFE* layerFE, const compositionengine::OutputLayer* layer) {
+                               return layerFE == &layer->getLayerFE();
+                           });
+    };
+
+    // Renders are spaced out so that the buffer drawn into has long been
+    // replaced on screen by the other one.
+    bool rendered = false;
+    if (canRender && runCount >= kMinFlattenedLayers && runCount > mFlattenedLayers.size() &&
+        mFramesSinceRender >= kStableFramesBeforeFlattening && !isRejected()) {
+        rendered = render(display, outputState, layers, runFirst, runCount);
+    }
+
+    bool overridesChanged = false;
+    for (auto* layer : layers) {
+        const LayerFE* layerFE = &layer->getLayerFE();
+        OutputLayerCompositionState::OverrideInfo overrideInfo;
+        if (!mFlattenedLayers.empty() && layerFE == mFlattenedLayers.front()) {
+            overrideInfo.buffer = mBuffers[mBufferIndex];
+            overrideInfo.acquireFence = mReadyFence;
+            overrideInfo.displayFrame = mDisplayFrame;
+            overrideInfo.dataspace = mFlattenedDisplay.outputDataspace;
+            overrideInfo.visibleRegion = mVisibleRegion;
+            overrideInfo.surfaceDamage = rendered ? Region::INVALID_REGION : Region();
+        } else {
+            overrideInfo.skip = std::find(mFlattenedLayers.begin(), mFlattenedLayers.end(),
+                                          layerFE) != mFlattenedLayers.end();
+        }
+
+        auto& state = layer->editState();
+        overridesChanged |= state.overrideInfo.buffer != overrideInfo.buffer ||
+                state.overrideInfo.skip != overrideInfo.skip;
+        state.overrideInfo = std::move(overrideInfo);
+    }
+    return overridesChanged;
+}
+
+LayerFlattener::LayerState LayerFlattener::getLayerState(
+        const compositionengine::OutputLayer& layer) {
+    LayerState result;
+    const auto& state = layer.getState();
+    result.displayFrame = state.displayFrame;
+    result.sourceCrop = state.sourceCrop;
+    result.bufferTransform = state.bufferTransform;
+    result.dataspace = state.dataspace;
+    result.visibleRegion = state.outputSpaceVisibleRegion;
+
+    if (const auto* layerFEState = layer.getLayerFE().getCompositionState()) {
+        result.bufferId = layerFEState->buffer ? layerFEState->buffer->getId() : 0;
+        result.acquireFence = layerFEState->acquireFence;
+        result.color = layerFEState->color;
+        result.alpha = layerFEState->alpha;
+        result.blendMode = layerFEState->blendMode;
+        result.compositionType = layerFEState->compositionType;
+    }
+    return result;
+}
+
+bool LayerFlattener::canFlatten(const compositionengine::OutputLayer& layer) {
+    const auto& state = layer.getState();
+    const auto* layerFEState = layer.getLayerFE().getCompositionState();
+    if (!layerFEState || !state.hwc || state.forceClientComposition ||
+        state.outputSpaceVisibleRegion.isEmpty()) {
+        return false;
+    }
+
+    if (layerFEState->compositionType != Hwc2::IComposerClient::Composition::DEVICE &&
+        layerFEState->compositionType != Hwc2::IComposerClient::Composition::SOLID_COLOR) {
+        return false;
+    }
+
+    // Protected and secure content must not be copied into another buffer.
+    if (layerFEState->hasProtectedContent || layerFEState->isSecure) {
+        return false;
+    }
+
+    // Blurs sample the layers below the run. HDR tone mapping, color
+    // transforms and metadata are applied per layer by the HWC.
+    if (layerFEState->backgroundBlurRadius > 0 || isHdrDataspace(state.dataspace) ||
+        !layerFEState->colorTransformIsIdentity || !layerFEState->metadata.empty()) {
+        return false;
+    }
+
+    // The HWC places the fingerprint layers itself.
+    const char* name = layer.getLayerFE().getDebugName();
+    return strcmp(name, FOD_LAYER_NAME) != 0 && strcmp(name, FOD_TOUCHED_LAYER_NAME) != 0;
+}
+
+bool LayerFlattener::isFlattenedRunIntact(
+        const renderengine::DisplaySettings& display,
+        const std::vector<compositionengine::OutputLayer*>& layers) const {
+    if (mFlattenedLayers.empty() || !(display == mFlattenedDisplay)) {
+        return false;
+    }
+
+    const auto first = std::find_if(layers.begin(), layers.end(), [&](const auto* layer) {
+        return &layer->getLayerFE() == mFlattenedLayers.front();
+    });
+    if (static_cast<size_t>(layers.end() - first) < mFlattenedLayers.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < mFlattenedLayers.size(); i++) {
+        const auto* layer = *(first + static_cast<ptrdiff_t>(i));
+        const auto it = mTrackedLayers.find(&layer->getLayerFE());
+        if (&layer->getLayerFE() != mFlattenedLayers[i] || !canFlatten(*layer) ||
+            it == mTrackedLayers.end() || it->second.stableFrames < 2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LayerFlattener::render(const renderengine::DisplaySettings& display,
+                            const OutputCompositionState& outputState,
+                            const std::vector<compositionengine::OutputLayer*>& layers,
+                            size_t first, size_t count) {
+    ATRACE_CALL();
+
+    const size_t bufferIndex = (mBufferIndex + 1) % mBuffers.size();
+    auto& buffer = mBuffers[bufferIndex];
+    const auto width = static_cast<uint32_t>(outputState.bounds.getWidth());
+    const auto height = static_cast<uint32_t>(outputState.bounds.getHeight());
+    if (buffer == nullptr || buffer->getWidth() != width || buffer->getHeight() != height) {
+        buffer = new GraphicBuffer(width, height, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                   GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_COMPOSER |
+                                           GRALLOC_USAGE_HW_TEXTURE,
+                                   "LayerFlattener");
+        if (buffer->initCheck() != NO_ERROR) {
+            ALOGE("Failed to allocate the flattened layer buffer");
+            buffer = nullptr;
+            return false;
+        }
+    }
+
+    const Region viewportRegion(outputState.viewport);
+    Region clearRegion;
+    Region visibleRegion;
+    std::vector<LayerFE::LayerSettings> layerSettings;
+    for (size_t i = first; i < first + count; i++) {
+        auto* layer = layers[i];
+        const auto& layerState = layer->getState();
+        const Region clip(viewportRegion.intersect(layerState.visibleRegion));
+        compositionengine::LayerFE::ClientCompositionTargetSettings targetSettings{
+                clip,
+                false, /* useIdentityTransform */
+                layer->needsFiltering() || outputState.needsFiltering,
+                outputState.isSecure,
+                false, /* supportsProtectedContent */
+                clearRegion,
+                outputState.viewport,
+                display.outputDataspace,
+                !layerState.visibleRegion.subtract(layerState.shadowRegion).isEmpty(),
+                false, /* clearContent */
+        };
+        std::vector<LayerFE::LayerSettings> results =
+                layer->getLayerFE().prepareClientCompositionList(targetSettings);
+        layerSettings.insert(layerSettings.end(), std::make_move_iterator(results.begin()),
+                             std::make_move_iterator(results.end()));
+        visibleRegion.orSelf(layerState.outputSpaceVisibleRegion);
+    }
+
+    std::vector<const renderengine::LayerSettings*> layerPointers;
+    layerPointers.reserve(layerSettings.size());
+    for (const auto& settings : layerSettings) {
+        layerPointers.push_back(&settings);
+    }
+
+    base::unique_fd readyFence;
+    const status_t status =
+            mRenderEngine.drawLayers(display, layerPointers, buffer->getNativeBuffer(),
+                                     /*useFramebufferCache=*/true, base::unique_fd(), &readyFence);
+    if (status != NO_ERROR) {
+        return false;
+    }
+
+    mBufferIndex = bufferIndex;
+    mFramesSinceRender = 0;
+    mReadyFence = readyFence.ok() ? new Fence(readyFence.release()) : Fence::NO_FENCE;
+    mFlattenedDisplay = display;
+    mVisibleRegion = visibleRegion.intersect(outputState.bounds);
+    mDisplayFrame = mVisibleRegion.getBounds();
+    mFlattenedLayers.clear();
+    for (size_t i = first; i < first + count; i++) {
+        mFlattenedLayers.push_back(&layers[i]->getLayerFE());
+    }
+    return true;
+}
+
+void LayerFlattener::dump(std::string& result) const {
+    base::StringAppendF(&result, "   Layer flattener: %zu layers flattened",
+                        mFlattenedLayers.size());
+    if (!mFlattenedLayers.empty()) {
+        base::StringAppendF(&result, " into [%d %d %d %d]", mDisplayFrame.left, mDisplayFrame.top,
+                            mDisplayFrame.right, mDisplayFrame.bottom);
+    }
+    if (!mRejectedLayers.empty()) {
+        base::StringAppendF(&result, ", %zu layers composited by the client",
+                            mRejectedLayers.size());
+    }
+    result.append("\n");
+}
+
+} // namespace android::compositionengine::impl
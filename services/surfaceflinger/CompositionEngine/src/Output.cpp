@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <cmath>
 #include <thread>
 
 #include <android-base/stringprintf.h>
@@ -52,21 +53,18 @@ namespace impl {
 
 namespace {
 
-template <typename T>
-class Reversed {
-public:
-    explicit Reversed(const T& container) : mContainer(container) {}
-    auto begin() { return mContainer.rbegin(); }
-    auto end() { return mContainer.rend(); }
-
-private:
-    const T& mContainer;
-};
-
-// Helper for enumerating over a container in reverse order
-template <typename T>
-Reversed<T> reversed(const T& c) {
-    return Reversed<T>(c);
+// Returns whether the client draws |layer|. The layers of a flattened run are
+// all drawn by the client if the HWC did not take the flattened buffer, and
+// not at all otherwise, as the buffer holds them. |flattenedRunIsClientComposited|
+// carries this from the bottom-most layer of a run to the others.
+bool requiresClientComposition(const compositionengine::OutputLayer& layer,
+                               bool& flattenedRunIsClientComposited) {
+    const auto& overrideInfo = layer.getState().overrideInfo;
+    if (overrideInfo.buffer) {
+        flattenedRunIsClientComposited = layer.requiresClientComposition();
+        return flattenedRunIsClientComposited;
+    }
+    return overrideInfo.skip ? flattenedRunIsClientComposited : layer.requiresClientComposition();
 }
 
 } // namespace
@@ -200,6 +198,14 @@ void Output::dumpBase(std::string& out) const {
         out.append("    No render surface!\n");
     }
 
+    if (mClientTargetDamageHistory) {
+        mClientTargetDamageHistory->dump(out);
+    }
+
+    if (mLayerFlattener) {
+        mLayerFlattener->dump(out);
+    }
+
     android::base::StringAppendF(&out, "\n   %zu Layers\n", getOutputLayerCount());
     for (const auto* outputLayer : getOutputLayersOrderedByZ()) {
         if (!outputLayer) {
@@ -245,6 +251,37 @@ void Output::cacheClientCompositionRequests(uint32_t cacheSize) {
     }
 };
 
+void Output::cacheClientCompositionLayerSets(bool enable) {
+    if (!enable) {
+        mClientCompositionLayerSetCache.reset();
+    } else if (!mClientCompositionLayerSetCache) {
+        mClientCompositionLayerSetCache = std::make_unique<ClientCompositionLayerSetCache>(
+                getCompositionEngine().getRenderEngine());
+    }
+}
+
+void Output::trackClientTargetDamage(bool enable) {
+    if (!enable) {
+        mClientTargetDamageHistory.reset();
+    } else if (!mClientTargetDamageHistory) {
+        mClientTargetDamageHistory = std::make_unique<ClientTargetDamageHistory>();
+    }
+    mComposedClientTarget.reset();
+}
+
+void Output::flattenStaticLayers(bool enable) {
+    if (!enable) {
+        mLayerFlattener.reset();
+        // The layers are presented on their own from the next geometry update.
+        for (auto* layer : getOutputLayersOrderedByZ()) {
+            layer->editState().overrideInfo = {};
+        }
+    } else if (!mLayerFlattener) {
+        mLayerFlattener =
+                std::make_unique<LayerFlattener>(getCompositionEngine().getRenderEngine());
+    }
+}
+
 void Output::setRenderSurfaceForTest(std::unique_ptr<compositionengine::RenderSurface> surface) {
     mRenderSurface = std::move(surface);
 }
@@ -312,7 +349,11 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     updateAndWriteCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
-    prepareFrame();
+    if (canPredictCompositionStrategy(refreshArgs)) {
+        prepareFrameAsync(refreshArgs);
+    } else {
+        prepareFrame();
+    }
     devOptRepaintFlash(refreshArgs);
     finishFrame(refreshArgs);
     postFramebuffer();
@@ -348,8 +389,19 @@ void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArg
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
-    for (auto layer : reversed(refreshArgs.layers)) {
+    const auto& outputState = getState();
+    const auto& snapshot = refreshArgs.layerGeometrySnapshot;
+    const bool hasSnapshot = snapshot.size() == refreshArgs.layers.size();
+    for (size_t i = refreshArgs.layers.size(); i-- > 0;) {
+        // Skip the layers which cannot be visible on this output without
+        // touching their front-end state.
+        if (hasSnapshot &&
+            !snapshot.isVisibleOn(i, outputState.layerStackId, outputState.layerStackInternal)) {
+            continue;
+        }
+
         // Incrementally process the coverage for each layer
+        auto layer = refreshArgs.layers[i];
         ensureOutputLayerIfVisible(layer, coverage);
 
         // TODO(b/121291683): Stop early if the output is completely covered and
@@ -393,6 +445,24 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
+    // Get coverage information for the layer as previously displayed,
+    // also taking over ownership from mOutputLayersorderedByZ.
+    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+    auto prevOutputLayer =
+            prevOutputLayerIndex ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex) : nullptr;
+
+    // If neither the layer geometry nor the coverage from the layers above it
+    // changed since the last time it was computed, the visible region
+    // computation would produce the same results. Reuse them.
+    if (prevOutputLayer && canReuseCoverage(*layerFEState, prevOutputLayer->getState(), coverage)) {
+        reuseCoverage(prevOutputLayerIndex, layerFE, *layerFEState, coverage);
+        return;
+    }
+
+    // Inputs to the computation, cached along with the results below.
+    const Region aboveCoveredLayersIn = coverage.aboveCoveredLayers;
+    const Region aboveOpaqueLayersIn = coverage.aboveOpaqueLayers;
+
     /*
      * opaqueRegion: area of a surface that is fully opaque.
      */
@@ -485,12 +555,6 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
-    // Get coverage information for the layer as previously displayed,
-    // also taking over ownership from mOutputLayersorderedByZ.
-    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
-    auto prevOutputLayer =
-            prevOutputLayerIndex ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex) : nullptr;
-
     //  Get coverage information for the layer as previously displayed
     // TODO(b/121291683): Define kEmptyRegion as a constant in Region.h
     const Region kEmptyRegion;
@@ -559,6 +623,67 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     outputLayerState.outputSpaceVisibleRegion =
             outputState.transform.transform(visibleNonShadowRegion.intersect(outputState.viewport));
     outputLayerState.shadowRegion = shadowRegion;
+
+    auto& cache = outputLayerState.coverageCache;
+    cache.valid = true;
+    cache.geomLayerTransform = tr;
+    cache.geomLayerBounds = layerFEState->geomLayerBounds;
+    cache.shadowRadius = layerFEState->shadowRadius;
+    cache.isOpaque = layerFEState->isOpaque;
+    cache.transparentRegionHint = layerFEState->transparentRegionHint;
+    cache.outputTransform = outputState.transform;
+    cache.outputBounds = outputState.bounds;
+    cache.outputViewport = outputState.viewport;
+    cache.aboveCoveredLayersIn = aboveCoveredLayersIn;
+    cache.aboveOpaqueLayersIn = aboveOpaqueLayersIn;
+    cache.aboveCoveredLayersOut = coverage.aboveCoveredLayers;
+    cache.aboveOpaqueLayersOut = coverage.aboveOpaqueLayers;
+}
+
+bool Output::canReuseCoverage(const LayerFECompositionState& layerFEState,
+                              const OutputLayerCompositionState& outputLayerState,
+                              const compositionengine::Output::CoverageState& coverage) const {
+    const auto& cache = outputLayerState.coverageCache;
+    if (!cache.valid) {
+        return false;
+    }
+
+    // Cheap comparisons first; the regions are only compared if everything
+    // else matches.
+    const auto& outputState = getState();
+    return cache.isOpaque == layerFEState.isOpaque &&
+            cache.shadowRadius == layerFEState.shadowRadius &&
+            cache.geomLayerBounds == layerFEState.geomLayerBounds &&
+            cache.geomLayerTransform == layerFEState.geomLayerTransform &&
+            cache.outputBounds == outputState.bounds &&
+            cache.outputViewport == outputState.viewport &&
+            cache.outputTransform == outputState.transform &&
+            cache.aboveOpaqueLayersIn.hasSameRects(coverage.aboveOpaqueLayers) &&
+            cache.aboveCoveredLayersIn.hasSameRects(coverage.aboveCoveredLayers) &&
+            cache.transparentRegionHint.hasSameRects(layerFEState.transparentRegionHint);
+}
+
+void Output::reuseCoverage(std::optional<size_t> prevOutputLayerIndex,
+                           sp<compositionengine::LayerFE>& layerFE,
+                           const LayerFECompositionState& layerFEState,
+                           compositionengine::Output::CoverageState& coverage) {
+    auto result = ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    const auto& outputLayerState = result->getState();
+    const auto& cache = outputLayerState.coverageCache;
+
+    // The visible and covered regions are unchanged, so this reduces the
+    // full dirty region computation to what it evaluates to in that case.
+    Region dirty;
+    if (layerFEState.contentDirty) {
+        dirty = outputLayerState.visibleRegion;
+    } else {
+        dirty = outputLayerState.visibleRegion.intersect(outputLayerState.coveredRegion);
+    }
+    dirty.subtractSelf(coverage.aboveOpaqueLayers);
+    coverage.dirtyRegion.orSelf(dirty);
+
+    coverage.aboveCoveredLayers = cache.aboveCoveredLayersOut;
+    coverage.aboveOpaqueLayers = cache.aboveOpaqueLayersOut;
 }
 
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
@@ -582,6 +707,51 @@ void Output::updateAndWriteCompositionState(
         return;
     }
 
+    if (!refreshArgs.outputCompositionStateUpdated) {
+        updateCompositionState(refreshArgs);
+    }
+
+    // Present the runs of layers that have not changed for a while from a
+    // single buffer. The geometry of the layers is written again whenever a
+    // run starts or ends.
+    bool layerOverridesChanged = false;
+    if (mLayerFlattener) {
+        auto layers = getOutputLayersOrderedByZ();
+        layerOverridesChanged =
+                mLayerFlattener->flatten(getFlattenedLayerDisplaySettings(), getState(),
+                                         {layers.begin(), layers.end()},
+                                         refreshArgs.updatingGeometryThisFrame);
+    }
+
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        // Send the updated state to the HWC, if appropriate.
+        layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame || layerOverridesChanged);
+    }
+}
+
+renderengine::DisplaySettings Output::getFlattenedLayerDisplaySettings() const {
+    const auto& outputState = getState();
+
+    // The flattened buffer is presented as a layer in the output dataspace,
+    // like the client target. The HWC applies the color transform.
+    renderengine::DisplaySettings display;
+    display.physicalDisplay = outputState.destinationClip;
+    display.clip = outputState.sourceClip;
+    display.orientation = outputState.orientation;
+    display.outputDataspace = mDisplayColorProfile->hasWideColorGamut() ? outputState.dataspace
+                                                                        : ui::Dataspace::UNKNOWN;
+    display.maxLuminance = mDisplayColorProfile->getHdrCapabilities().getDesiredMaxLuminance();
+    return display;
+}
+
+void Output::updateCompositionState(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    if (!getState().isEnabled) {
+        return;
+    }
+
     mLayerRequestingBackgroundBlur = findLayerRequestingBackgroundComposition();
     bool forceClientComposition = mLayerRequestingBackgroundBlur != nullptr;
 
@@ -594,9 +764,6 @@ void Output::updateAndWriteCompositionState(
         if (mLayerRequestingBackgroundBlur == layer) {
             forceClientComposition = false;
         }
-
-        // Send the updated state to the HWC, if appropriate.
-        layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame);
     }
 }
 
@@ -733,6 +900,7 @@ compositionengine::Output::ColorProfile Output::pickColorProfile(
 
 void Output::beginFrame() {
     auto& outputState = editState();
+    outputState.renderEngineDuration = -1;
     const bool dirty = !getDirtyRegion(false).isEmpty();
     const bool empty = getOutputLayerCount() == 0;
     const bool wasEmpty = !outputState.lastCompositionHadVisibleLayers;
@@ -775,6 +943,15 @@ void Output::prepareFrame() {
                                  outputState.usesDeviceComposition);
 }
 
+bool Output::canPredictCompositionStrategy(const compositionengine::CompositionRefreshArgs&) {
+    // The base output implementation has no composition strategy to predict.
+    return false;
+}
+
+void Output::prepareFrameAsync(const compositionengine::CompositionRefreshArgs&) {
+    prepareFrame();
+}
+
 void Output::devOptRepaintFlash(const compositionengine::CompositionRefreshArgs& refreshArgs) {
     if (CC_LIKELY(!refreshArgs.devOptFlashDirtyRegionsDelay)) {
         return;
@@ -808,8 +985,12 @@ void Output::finishFrame(const compositionengine::CompositionRefreshArgs& refres
     }
 
     // Repaint the framebuffer (if needed), getting the optional fence for when
-    // the composition completes.
-    auto optReadyFence = composeSurfaces(Region::INVALID_REGION, refreshArgs);
+    // the composition completes. The framebuffer may already have been
+    // repainted while the composition strategy was chosen.
+    auto optReadyFence = std::exchange(mPredictedComposition.readyFence, std::nullopt);
+    if (!optReadyFence) {
+        optReadyFence = composeSurfaces(Region::INVALID_REGION, refreshArgs);
+    }
     if (!optReadyFence) {
         return;
     }
@@ -859,18 +1040,29 @@ std::optional<base::unique_fd> Output::composeSurfaces(
 
     base::unique_fd fd;
     sp<GraphicBuffer> buf;
+    bool recomposingPredictedTarget = false;
+    mComposedClientTarget.reset();
 
     // If we aren't doing client composition on this output, but do have a
     // flipClientTarget request for this frame on this output, we still need to
     // dequeue a buffer.
     if (hasClientComposition || outputState.flipClientTarget) {
-        buf = mRenderSurface->dequeueBuffer(&fd);
+        // A client target composed with a mispredicted composition strategy
+        // is still dequeued, and is composed again.
+        buf = std::exchange(mPredictedComposition.clientTarget, nullptr);
+        recomposingPredictedTarget = buf != nullptr;
+        if (buf == nullptr) {
+            buf = mRenderSurface->dequeueBuffer(&fd);
+        }
         if (buf == nullptr) {
             ALOGW("Dequeuing buffer for display [%s] failed, bailing out of "
                   "client composition for this frame",
                   mName.c_str());
             return {};
         }
+        if (mPredictedComposition.inProgress) {
+            mPredictedComposition.clientTarget = buf;
+        }
     }
 
     base::unique_fd readyFence;
@@ -906,6 +1098,19 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                               clientCompositionDisplay.outputDataspace);
     appendRegionFlashRequests(debugRegion, clientCompositionLayers);
 
+    // Find how the client target differs from the one queued last. The flash
+    // of the dirty regions presents client targets in between that are not
+    // tracked, so it turns damage tracking off.
+    std::optional<ComposedClientTarget> composedClientTarget;
+    if (mClientTargetDamageHistory && !refreshArgs.devOptFlashDirtyRegionsDelay) {
+        composedClientTarget = ComposedClientTarget{};
+        composedClientTarget->signature = getClientTargetSignature(clientCompositionDisplay);
+        composedClientTarget->damage = mClientTargetDamageHistory->getDamage(
+                outputState.bounds, composedClientTarget->signature,
+                outputState.transform.transform(getDirtyRegion(refreshArgs.repaintEverything)));
+        mRenderSurface->setSurfaceDamage(composedClientTarget->damage);
+    }
+
     // Check if the client composition requests were rendered into the provided graphic buffer. If
     // so, we can reuse the buffer and avoid client composition.
     if (mClientCompositionRequestCache) {
@@ -913,12 +1118,33 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                                    clientCompositionLayers)) {
             outputCompositionState.reusedClientComposition = true;
             setExpensiveRenderingExpected(false);
+            if (composedClientTarget) {
+                composedClientTarget->drawn = true;
+                mComposedClientTarget = std::move(composedClientTarget);
+            }
             return readyFence;
         }
         mClientCompositionRequestCache->add(buf->getId(), clientCompositionDisplay,
                                             clientCompositionLayers);
     }
 
+    // Draw the bottom-most layers from a pre-rendered buffer if they have not changed.
+    if (mClientCompositionLayerSetCache) {
+        mClientCompositionLayerSetCache->apply(clientCompositionDisplay, buf,
+                                               clientCompositionLayers);
+    }
+
+    // The parts of the buffer that are still current are not drawn again. The
+    // first composition of a mispredicted client target has overwritten them.
+    if (composedClientTarget) {
+        const int bufferAge = recomposingPredictedTarget ? 0 : mRenderSurface->getBufferAge();
+        clientCompositionDisplay.damage =
+                mClientTargetDamageHistory
+                        ->getRedrawRegion(outputState.bounds, bufferAge,
+                                          composedClientTarget->damage)
+                        .getBounds();
+    }
+
     // We boost GPU frequency here because there will be color spaces conversion
     // or complex GPU shaders and it's expensive. We boost the GPU frequency so that
     // GPU composition can finish in time. We must reset GPU frequency afterwards,
@@ -939,24 +1165,50 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                        return &settings;
                    });
 
+    // Let the power advisor predict the cost of this frame before RenderEngine starts on it.
+    Hwc2::ClientCompositionWorkload workload;
+    workload.layerCount = clientCompositionLayers.size();
+    for (const auto& settings : clientCompositionLayers) {
+        const auto& geometry = settings.geometry;
+        const mat4& transform = geometry.positionTransform;
+        const float area = geometry.boundaries.getWidth() * geometry.boundaries.getHeight() *
+                std::abs(transform[0][0] * transform[1][1] - transform[0][1] * transform[1][0]);
+        workload.area += area;
+        if (settings.backgroundBlurRadius > 0) {
+            workload.blurArea += area;
+        }
+    }
+    workload.frameBudget = refreshArgs.frameBudget;
+    notifyClientCompositionStarted(workload);
+
     const nsecs_t renderEngineStart = systemTime();
     status_t status =
             renderEngine.drawLayers(clientCompositionDisplay, clientCompositionLayerPointers,
                                     buf->getNativeBuffer(), /*useFramebufferCache=*/true,
                                     std::move(fd), &readyFence);
+    outputCompositionState.renderEngineDuration =
+            std::max<nsecs_t>(outputCompositionState.renderEngineDuration, 0) +
+            (systemTime() - renderEngineStart);
 
     if (status != NO_ERROR && mClientCompositionRequestCache) {
         // If rendering was not successful, remove the request from the cache.
         mClientCompositionRequestCache->remove(buf->getId());
     }
 
+    if (composedClientTarget) {
+        composedClientTarget->drawn = status == NO_ERROR;
+        mComposedClientTarget = std::move(composedClientTarget);
+    }
+
     auto& timeStats = getCompositionEngine().getTimeStats();
     if (readyFence.get() < 0) {
         timeStats.recordRenderEngineDuration(renderEngineStart, systemTime());
+        notifyClientCompositionSubmitted(renderEngineStart, nullptr);
     } else {
-        timeStats.recordRenderEngineDuration(renderEngineStart,
-                                             std::make_shared<FenceTime>(
-                                                     new Fence(dup(readyFence.get()))));
+        const auto readyFenceTime =
+                std::make_shared<FenceTime>(new Fence(dup(readyFence.get())));
+        timeStats.recordRenderEngineDuration(renderEngineStart, readyFenceTime);
+        notifyClientCompositionSubmitted(renderEngineStart, readyFenceTime);
     }
 
     return readyFence;
@@ -973,6 +1225,7 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
     bool firstLayer = true;
     // Used when a layer clears part of the buffer.
     Region dummyRegion;
+    bool flattenedRunIsClientComposited = false;
 
     for (auto* layer : getOutputLayersOrderedByZ()) {
         const auto& layerState = layer->getState();
@@ -987,7 +1240,8 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
             continue;
         }
 
-        const bool clientComposition = layer->requiresClientComposition();
+        const bool clientComposition =
+                requiresClientComposition(*layer, flattenedRunIsClientComposited);
 
         // We clear the client target for non-client composed layers if
         // requested by the HWC. We skip this if the layer is not an opaque
@@ -1056,6 +1310,14 @@ void Output::setExpensiveRenderingExpected(bool) {
     // The base class does nothing with this call.
 }
 
+void Output::notifyClientCompositionStarted(const Hwc2::ClientCompositionWorkload&) {
+    // The base class does nothing with this call.
+}
+
+void Output::notifyClientCompositionSubmitted(nsecs_t, const std::shared_ptr<FenceTime>&) {
+    // The base class does nothing with this call.
+}
+
 void Output::postFramebuffer() {
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
@@ -1064,6 +1326,10 @@ void Output::postFramebuffer() {
         return;
     }
 
+    if (mClientTargetDamageHistory) {
+        updateClientTargetDamageHistory();
+    }
+
     auto& outputState = editState();
     outputState.dirtyRegion.clear();
     mRenderSurface->flip();
@@ -1111,6 +1377,37 @@ void Output::postFramebuffer() {
     mReleasedLayers.clear();
 }
 
+ClientTargetDamageHistory::Signature Output::getClientTargetSignature(
+        const renderengine::DisplaySettings& display) const {
+    ClientTargetDamageHistory::Signature signature;
+    signature.display = display;
+    bool flattenedRunIsClientComposited = false;
+    for (const auto* layer : getOutputLayersOrderedByZ()) {
+        signature.layers.push_back({&layer->getLayerFE(),
+                                    requiresClientComposition(*layer,
+                                                              flattenedRunIsClientComposited),
+                                    layer->getState().clearClientTarget});
+    }
+    return signature;
+}
+
+void Output::updateClientTargetDamageHistory() {
+    const auto& outputState = getState();
+    // The dirty region of frames that do not queue a client target carries
+    // over to the next one.
+    mClientTargetDamageHistory->addDamage(
+            outputState.transform.transform(getDirtyRegion(/*repaintEverything=*/false)));
+
+    if (auto composedClientTarget = std::exchange(mComposedClientTarget, std::nullopt)) {
+        mClientTargetDamageHistory->onClientTargetQueued(composedClientTarget->damage,
+                                                         std::move(composedClientTarget->signature),
+                                                         composedClientTarget->drawn);
+    } else if (outputState.usesClientComposition || outputState.flipClientTarget) {
+        // A client target was queued with contents that are not tracked.
+        mClientTargetDamageHistory->reset();
+    }
+}
+
 void Output::dirtyEntireOutput() {
     auto& outputState = editState();
     outputState.dirtyRegion.set(outputState.bounds);
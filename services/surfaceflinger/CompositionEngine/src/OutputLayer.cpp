@@ -49,6 +49,14 @@ FloatRect reduce(const FloatRect& win, const Region& exclude) {
     return Region(Rect{win}).subtract(exclude).getBounds().toFloatRect();
 }
 
+// Written to HWC cache slots whose buffer has been freed, so that the HAL drops its reference.
+const sp<GraphicBuffer>& getPlaceholderBuffer() {
+    static const sp<GraphicBuffer> buffer =
+            new GraphicBuffer(1, 1, PIXEL_FORMAT_RGBA_8888, 1, GraphicBuffer::USAGE_HW_COMPOSER,
+                              "HwcBufferCache placeholder");
+    return buffer;
+}
+
 } // namespace
 
 std::unique_ptr<OutputLayer> createOutputLayer(const compositionengine::Output& output,
@@ -332,7 +340,10 @@ void OutputLayer::writeStateToHWC(bool includeGeometry) {
         return;
     }
 
-    auto requestedCompositionType = outputIndependentState->compositionType;
+    // A flattened run of layers is presented from a buffer of its own.
+    auto requestedCompositionType = state.overrideInfo.buffer
+            ? hal::Composition::DEVICE
+            : outputIndependentState->compositionType;
 
     if (includeGeometry) {
         writeOutputDependentGeometryStateToHWC(hwcLayer.get(), requestedCompositionType);
@@ -351,24 +362,26 @@ void OutputLayer::writeStateToHWC(bool includeGeometry) {
 void OutputLayer::writeOutputDependentGeometryStateToHWC(
         HWC2::Layer* hwcLayer, hal::Composition requestedCompositionType) {
     const auto& outputDependentState = getState();
+    const auto& overrideInfo = outputDependentState.overrideInfo;
 
-    if (auto error = hwcLayer->setDisplayFrame(outputDependentState.displayFrame);
-        error != hal::Error::NONE) {
+    // The override buffer is in output space, so it maps 1:1 onto the display.
+    const Rect displayFrame =
+            overrideInfo.buffer ? overrideInfo.displayFrame : outputDependentState.displayFrame;
+    const FloatRect sourceCrop = overrideInfo.buffer ? overrideInfo.displayFrame.toFloatRect()
+                                                     : outputDependentState.sourceCrop;
+
+    if (auto error = hwcLayer->setDisplayFrame(displayFrame); error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set display frame [%d, %d, %d, %d]: %s (%d)",
-              getLayerFE().getDebugName(), outputDependentState.displayFrame.left,
-              outputDependentState.displayFrame.top, outputDependentState.displayFrame.right,
-              outputDependentState.displayFrame.bottom, to_string(error).c_str(),
+              getLayerFE().getDebugName(), displayFrame.left, displayFrame.top,
+              displayFrame.right, displayFrame.bottom, to_string(error).c_str(),
               static_cast<int32_t>(error));
     }
 
-    if (auto error = hwcLayer->setSourceCrop(outputDependentState.sourceCrop);
-        error != hal::Error::NONE) {
+    if (auto error = hwcLayer->setSourceCrop(sourceCrop); error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set source crop [%.3f, %.3f, %.3f, %.3f]: "
               "%s (%d)",
-              getLayerFE().getDebugName(), outputDependentState.sourceCrop.left,
-              outputDependentState.sourceCrop.top, outputDependentState.sourceCrop.right,
-              outputDependentState.sourceCrop.bottom, to_string(error).c_str(),
-              static_cast<int32_t>(error));
+              getLayerFE().getDebugName(), sourceCrop.left, sourceCrop.top, sourceCrop.right,
+              sourceCrop.bottom, to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
     uint32_t z = outputDependentState.z;
@@ -384,7 +397,8 @@ void OutputLayer::writeOutputDependentGeometryStateToHWC(
     }
 
     // Solid-color layers should always use an identity transform.
-    const auto bufferTransform = requestedCompositionType != hal::Composition::SOLID_COLOR
+    const auto bufferTransform =
+            requestedCompositionType != hal::Composition::SOLID_COLOR && !overrideInfo.buffer
             ? outputDependentState.bufferTransform
             : static_cast<hal::Transform>(0);
     if (auto error = hwcLayer->setTransform(static_cast<hal::Transform>(bufferTransform));
@@ -397,17 +411,27 @@ void OutputLayer::writeOutputDependentGeometryStateToHWC(
 
 void OutputLayer::writeOutputIndependentGeometryStateToHWC(
         HWC2::Layer* hwcLayer, const LayerFECompositionState& outputIndependentState) {
-    if (auto error = hwcLayer->setBlendMode(outputIndependentState.blendMode);
-        error != hal::Error::NONE) {
+    const auto& overrideInfo = getState().overrideInfo;
+
+    // The override buffer holds premultiplied content with the layer alphas
+    // already applied. Layers whose content is in it are made transparent.
+    const auto blendMode =
+            overrideInfo.buffer ? hal::BlendMode::PREMULTIPLIED : outputIndependentState.blendMode;
+    float alpha = outputIndependentState.alpha;
+    if (overrideInfo.buffer) {
+        alpha = 1.0f;
+    } else if (overrideInfo.skip) {
+        alpha = 0.0f;
+    }
+
+    if (auto error = hwcLayer->setBlendMode(blendMode); error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set blend mode %s: %s (%d)", getLayerFE().getDebugName(),
-              toString(outputIndependentState.blendMode).c_str(), to_string(error).c_str(),
-              static_cast<int32_t>(error));
+              toString(blendMode).c_str(), to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
-    if (auto error = hwcLayer->setPlaneAlpha(outputIndependentState.alpha);
-        error != hal::Error::NONE) {
-        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(),
-              outputIndependentState.alpha, to_string(error).c_str(), static_cast<int32_t>(error));
+    if (auto error = hwcLayer->setPlaneAlpha(alpha); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(), alpha,
+              to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
     if (auto error = hwcLayer->setInfo(static_cast<uint32_t>(outputIndependentState.type),
@@ -428,21 +452,24 @@ void OutputLayer::writeOutputIndependentGeometryStateToHWC(
 
 void OutputLayer::writeOutputDependentPerFrameStateToHWC(HWC2::Layer* hwcLayer) {
     const auto& outputDependentState = getState();
+    const auto& overrideInfo = outputDependentState.overrideInfo;
 
     // TODO(lpique): b/121291683 outputSpaceVisibleRegion is output-dependent geometry
     // state and should not change every frame.
-    if (auto error = hwcLayer->setVisibleRegion(outputDependentState.outputSpaceVisibleRegion);
-        error != hal::Error::NONE) {
+    const Region& visibleRegion = overrideInfo.buffer
+            ? overrideInfo.visibleRegion
+            : outputDependentState.outputSpaceVisibleRegion;
+    if (auto error = hwcLayer->setVisibleRegion(visibleRegion); error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set visible region: %s (%d)", getLayerFE().getDebugName(),
               to_string(error).c_str(), static_cast<int32_t>(error));
-        outputDependentState.outputSpaceVisibleRegion.dump(LOG_TAG);
+        visibleRegion.dump(LOG_TAG);
     }
 
-    if (auto error = hwcLayer->setDataspace(outputDependentState.dataspace);
-        error != hal::Error::NONE) {
-        ALOGE("[%s] Failed to set dataspace %d: %s (%d)", getLayerFE().getDebugName(),
-              outputDependentState.dataspace, to_string(error).c_str(),
-              static_cast<int32_t>(error));
+    const auto dataspace =
+            overrideInfo.buffer ? overrideInfo.dataspace : outputDependentState.dataspace;
+    if (auto error = hwcLayer->setDataspace(dataspace); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set dataspace %d: %s (%d)", getLayerFE().getDebugName(), dataspace,
+              to_string(error).c_str(), static_cast<int32_t>(error));
     }
 }
 
@@ -459,6 +486,21 @@ void OutputLayer::writeOutputIndependentPerFrameStateToHWC(
                   to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
+    if (getState().overrideInfo.buffer) {
+        writeOverrideBufferStateToHWC(hwcLayer);
+    } else {
+        writeContentStateToHWC(hwcLayer, outputIndependentState);
+    }
+
+    if (auto error = hwcLayer->setType(outputIndependentState.layerClass);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set layer class: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+}
+
+void OutputLayer::writeContentStateToHWC(HWC2::Layer* hwcLayer,
+                                         const LayerFECompositionState& outputIndependentState) {
     if (auto error = hwcLayer->setSurfaceDamage(outputIndependentState.surfaceDamage);
         error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set surface damage: %s (%d)", getLayerFE().getDebugName(),
@@ -483,17 +525,12 @@ void OutputLayer::writeOutputIndependentPerFrameStateToHWC(
             // Ignored
             break;
     }
-
-    if (auto error = hwcLayer->setType(outputIndependentState.layerClass);
-        error != hal::Error::NONE) {
-        ALOGE("[%s] Failed to set layer class: %s (%d)", getLayerFE().getDebugName(),
-              to_string(error).c_str(), static_cast<int32_t>(error));
-    }
 }
 
 void OutputLayer::writeSolidColorStateToHWC(HWC2::Layer* hwcLayer,
                                             const LayerFECompositionState& outputIndependentState) {
-    if (outputIndependentState.compositionType != hal::Composition::SOLID_COLOR) {
+    if (outputIndependentState.compositionType != hal::Composition::SOLID_COLOR ||
+        getState().overrideInfo.buffer) {
         return;
     }
 
@@ -529,6 +566,8 @@ void OutputLayer::writeBufferStateToHWC(HWC2::Layer* hwcLayer,
               to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
+    clearFreedHwcSlots(hwcLayer);
+
     uint32_t hwcSlot = 0;
     sp<GraphicBuffer> hwcBuffer;
     // We need access to the output-dependent state for the buffer cache there,
@@ -545,6 +584,42 @@ void OutputLayer::writeBufferStateToHWC(HWC2::Layer* hwcLayer,
     }
 }
 
+void OutputLayer::writeOverrideBufferStateToHWC(HWC2::Layer* hwcLayer) {
+    const auto& overrideInfo = getState().overrideInfo;
+
+    clearFreedHwcSlots(hwcLayer);
+
+    uint32_t hwcSlot = 0;
+    sp<GraphicBuffer> hwcBuffer;
+    // The override buffer has no slot of its own, so the cache picks one.
+    editState().hwc->hwcBufferCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT,
+                                                 overrideInfo.buffer, &hwcSlot, &hwcBuffer);
+
+    if (auto error = hwcLayer->setSurfaceDamage(overrideInfo.surfaceDamage);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set surface damage: %s (%d)", getLayerFE().getDebugName(),
+              to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setBuffer(hwcSlot, hwcBuffer, overrideInfo.acquireFence);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override buffer %p: %s (%d)", getLayerFE().getDebugName(),
+              overrideInfo.buffer->handle, to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+}
+
+void OutputLayer::clearFreedHwcSlots(HWC2::Layer* hwcLayer) {
+    // Must be followed by setting the layer's actual buffer, which replaces the placeholder.
+    for (uint32_t slot : editState().hwc->hwcBufferCache.takeFreedSlots()) {
+        if (auto error = hwcLayer->setBuffer(slot, getPlaceholderBuffer(), Fence::NO_FENCE);
+            error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to clear buffer slot %u: %s (%d)", getLayerFE().getDebugName(),
+                  slot, to_string(error).c_str(), static_cast<int32_t>(error));
+        }
+    }
+}
+
 void OutputLayer::writeCompositionTypeToHWC(HWC2::Layer* hwcLayer,
                                             hal::Composition requestedCompositionType) {
     auto& outputDependentState = editState();
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <cinttypes>
+
+#include <android-base/stringprintf.h>
 #include <compositionengine/impl/DumpHelpers.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
 
@@ -40,6 +43,10 @@ void dumpHwc(const OutputLayerCompositionState::Hwc& hwc, std::string& out) {
     }
 
     dumpVal(out, "composition", toString(hwc.hwcCompositionType), hwc.hwcCompositionType);
+
+    const auto& stats = hwc.hwcBufferCache.getStats();
+    base::StringAppendF(&out, "bufferCache=[hits=%" PRIu64 " misses=%" PRIu64 "] ", stats.hits,
+                        stats.misses);
 }
 
 } // namespace
@@ -69,6 +76,15 @@ void OutputLayerCompositionState::dump(std::string& out) const {
     dumpVal(out, "dataspace", toString(dataspace), dataspace);
     dumpVal(out, "z-index", z);
 
+    if (overrideInfo.buffer) {
+        out.append("\n      override: ");
+        dumpVal(out, "buffer", overrideInfo.buffer.get());
+        dumpVal(out, "displayFrame", overrideInfo.displayFrame);
+        dumpVal(out, "dataspace", toString(overrideInfo.dataspace), overrideInfo.dataspace);
+    } else if (overrideInfo.skip) {
+        out.append("\n      override: skipped ");
+    }
+
     if (hwc) {
         dumpHwc(*hwc, out);
     }
@@ -164,11 +164,20 @@ sp<GraphicBuffer> RenderSurface::dequeueBuffer(base::unique_fd* bufferFence) {
              mGraphicBuffer->getNativeBuffer()->handle);
     mGraphicBuffer = GraphicBuffer::from(buffer);
 
+    if (mNativeWindow->query(mNativeWindow.get(), NATIVE_WINDOW_BUFFER_AGE, &mBufferAge) !=
+        NO_ERROR) {
+        mBufferAge = 0;
+    }
+
     *bufferFence = base::unique_fd(fd);
 
     return mGraphicBuffer;
 }
 
+void RenderSurface::setSurfaceDamage(const Region& damage) {
+    mSurfaceDamage = damage;
+}
+
 void RenderSurface::queueBuffer(base::unique_fd readyFence) {
     auto& state = mDisplay.getState();
 
@@ -192,6 +201,16 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
         if (mGraphicBuffer == nullptr) {
             ALOGE("No buffer is ready for display [%s]", mDisplay.getName().c_str());
         } else {
+            if (!mSurfaceDamage.isEmpty()) {
+                // The damage is passed with the origin in the bottom-left corner, as in GLES.
+                std::vector<android_native_rect_t> rects;
+                for (const Rect& rect : mSurfaceDamage) {
+                    rects.push_back({rect.left, mSize.height - rect.top, rect.right,
+                                     mSize.height - rect.bottom});
+                }
+                native_window_set_surface_damage(mNativeWindow.get(), rects.data(), rects.size());
+            }
+
             status_t result =
                     mNativeWindow->queueBuffer(mNativeWindow.get(),
                                                mGraphicBuffer->getNativeBuffer(),
@@ -213,6 +232,7 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
             mGraphicBuffer = nullptr;
         }
     }
+    mSurfaceDamage.clear();
 
     status_t result = mDisplaySurface->advanceFrame();
     if (result != NO_ERROR) {
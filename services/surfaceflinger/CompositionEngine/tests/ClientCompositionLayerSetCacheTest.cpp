@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientCompositionLayerSetCache.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <ui/GraphicBuffer.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::SizeIs;
+
+constexpr uint32_t kTextureName = 7;
+
+class ClientCompositionLayerSetCacheTest : public testing::Test {
+public:
+    ClientCompositionLayerSetCacheTest() {
+        ON_CALL(mRenderEngine, genTextures(1, _))
+                .WillByDefault([](size_t, uint32_t* names) { *names = kTextureName; });
+        ON_CALL(mRenderEngine, isProtected()).WillByDefault(Return(false));
+        ON_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).WillByDefault(Return(NO_ERROR));
+
+        mDisplay.physicalDisplay = Rect(1, 1);
+        mDisplay.clip = Rect(1, 1);
+
+        for (uint64_t i = 0; i < 3; i++) {
+            LayerFE::LayerSettings settings;
+            settings.bufferId = i + 1;
+            settings.frameNumber = 1;
+            settings.alpha = half(1.0f);
+            mLayers.push_back(settings);
+        }
+    }
+
+    // Applies the cache to a copy of mLayers, as composeSurfaces() would for one frame.
+    std::vector<LayerFE::LayerSettings> applyFrame() {
+        std::vector<LayerFE::LayerSettings> layers = mLayers;
+        mCache.apply(mDisplay, mTarget, layers);
+        return layers;
+    }
+
+    NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    sp<GraphicBuffer> mTarget{new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0)};
+    renderengine::DisplaySettings mDisplay;
+    std::vector<LayerFE::LayerSettings> mLayers;
+    impl::ClientCompositionLayerSetCache mCache{mRenderEngine};
+};
+
+TEST_F(ClientCompositionLayerSetCacheTest, cachesUnchangedBottomLayersAfterAFewFrames) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, SizeIs(2), _, _, _, _)).Times(1);
+
+    // The top layer changes every frame; the rest is stable.
+    for (int frame = 0; frame < 3; frame++) {
+        mLayers[2].frameNumber++;
+        EXPECT_THAT(applyFrame(), SizeIs(3));
+    }
+
+    mLayers[2].frameNumber++;
+    std::vector<LayerFE::LayerSettings> layers = applyFrame();
+    ASSERT_THAT(layers, SizeIs(2));
+    EXPECT_EQ(kTextureName, layers[0].source.buffer.textureName);
+    EXPECT_TRUE(layers[0].disableBlending);
+    EXPECT_EQ(mLayers[2].frameNumber, layers[1].frameNumber);
+    EXPECT_EQ(2u, mCache.getCachedLayerCount());
+
+    // The cached buffer keeps being used without rendering it again.
+    mLayers[2].frameNumber++;
+    EXPECT_THAT(applyFrame(), SizeIs(2));
+}
+
+TEST_F(ClientCompositionLayerSetCacheTest, dropsCacheWhenCachedLayerChanges) {
+    for (int frame = 0; frame < 4; frame++) {
+        mLayers[2].frameNumber++;
+        applyFrame();
+    }
+    ASSERT_EQ(2u, mCache.getCachedLayerCount());
+
+    mLayers[0].frameNumber++;
+    EXPECT_THAT(applyFrame(), SizeIs(3));
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+TEST_F(ClientCompositionLayerSetCacheTest, doesNotCacheIfDisplayIsRotated) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+
+    mDisplay.orientation = ui::Transform::ROT_90;
+    for (int frame = 0; frame < 5; frame++) {
+        EXPECT_THAT(applyFrame(), SizeIs(3));
+    }
+}
+
+TEST_F(ClientCompositionLayerSetCacheTest, doesNotCacheProtectedContent) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    ON_CALL(mRenderEngine, isProtected()).WillByDefault(Return(true));
+
+    for (int frame = 0; frame < 5; frame++) {
+        EXPECT_THAT(applyFrame(), SizeIs(3));
+    }
+}
+
+} // namespace
+} // namespace android::compositionengine
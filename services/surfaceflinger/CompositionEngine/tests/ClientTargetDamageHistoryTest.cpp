@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientTargetDamageHistory.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+using Signature = impl::ClientTargetDamageHistory::Signature;
+
+const Rect kBounds(1080, 1920);
+
+class ClientTargetDamageHistoryTest : public testing::Test {
+public:
+    ClientTargetDamageHistoryTest() {
+        mSignature.display.physicalDisplay = kBounds;
+        mSignature.display.clip = kBounds;
+        mSignature.layers.push_back({nullptr, true, false});
+    }
+
+    // Queues a drawn client target for a frame with |frameDamage|, and returns its damage.
+    Region queueFrame(const Region& frameDamage) {
+        const Region damage = mHistory.getDamage(kBounds, mSignature, frameDamage);
+        mHistory.onClientTargetQueued(damage, mSignature, /*drawn=*/true);
+        return damage;
+    }
+
+    impl::ClientTargetDamageHistory mHistory;
+    Signature mSignature;
+};
+
+TEST_F(ClientTargetDamageHistoryTest, firstClientTargetIsDamagedWhole) {
+    EXPECT_TRUE(mHistory.getDamage(kBounds, mSignature, Region()).hasSameRects(Region(kBounds)));
+}
+
+TEST_F(ClientTargetDamageHistoryTest, redrawsDamageSinceBufferWasQueued) {
+    const Rect damage1(0, 0, 100, 100);
+    const Rect damage2(200, 200, 300, 300);
+    const Rect damage3(500, 500, 600, 600);
+    queueFrame(Region());
+    queueFrame(Region(damage1));
+    queueFrame(Region(damage2));
+
+    const Region damage = mHistory.getDamage(kBounds, mSignature, Region(damage3));
+    EXPECT_TRUE(damage.hasSameRects(Region(damage3)));
+
+    // A buffer of age 1 was queued last, one of age 3 misses the two frames after it.
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 1, damage).hasSameRects(Region(damage3)));
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 3, damage)
+                        .hasSameRects(Region(damage1).merge(damage2).merge(damage3)));
+}
+
+TEST_F(ClientTargetDamageHistoryTest, redrawsWholeBufferWithUnknownContents) {
+    queueFrame(Region());
+    queueFrame(Region());
+    const Region damage(Rect(10, 10));
+
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 0, damage).hasSameRects(Region(kBounds)));
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 3, damage).hasSameRects(Region(kBounds)));
+
+    // A client target queued without being drawn does not hold the last composition.
+    mHistory.onClientTargetQueued(damage, mSignature, /*drawn=*/false);
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 1, damage).hasSameRects(Region(kBounds)));
+    EXPECT_TRUE(mHistory.getDamage(kBounds, mSignature, damage).hasSameRects(Region(kBounds)));
+}
+
+TEST_F(ClientTargetDamageHistoryTest, damagesWholeClientTargetWhenSignatureChanges) {
+    queueFrame(Region());
+    const Region damage(Rect(10, 10));
+
+    Signature signature = mSignature;
+    signature.layers.front().clientComposition = false;
+    EXPECT_TRUE(mHistory.getDamage(kBounds, signature, damage).hasSameRects(Region(kBounds)));
+
+    signature = mSignature;
+    signature.display.colorTransform = mat4::scale(vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    EXPECT_TRUE(mHistory.getDamage(kBounds, signature, damage).hasSameRects(Region(kBounds)));
+}
+
+TEST_F(ClientTargetDamageHistoryTest, carriesDamageOverFramesWithoutClientTarget) {
+    queueFrame(Region());
+    const Rect damage1(0, 0, 100, 100);
+    const Rect damage2(200, 200, 300, 300);
+    mHistory.addDamage(Region(damage1));
+
+    const Region damage = queueFrame(Region(damage2));
+    EXPECT_TRUE(damage.hasSameRects(Region(damage1).merge(damage2)));
+
+    // The damage carried over belongs to the queued client target only.
+    EXPECT_TRUE(mHistory.getDamage(kBounds, mSignature, Region()).isEmpty());
+}
+
+TEST_F(ClientTargetDamageHistoryTest, resetRedrawsWholeClientTarget) {
+    queueFrame(Region());
+    queueFrame(Region());
+    mHistory.reset();
+
+    const Region damage = mHistory.getDamage(kBounds, mSignature, Region());
+    EXPECT_TRUE(damage.hasSameRects(Region(kBounds)));
+    EXPECT_TRUE(mHistory.getRedrawRegion(kBounds, 1, damage).hasSameRects(Region(kBounds)));
+}
+
+} // namespace
+} // namespace android::compositionengine
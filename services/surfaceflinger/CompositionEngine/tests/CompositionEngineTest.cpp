@@ -122,6 +122,38 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, updatesOutputCompositionStateWithParallelFor) {
+    InSequence seq;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+
+    // The color profiles are chosen before any output computes its layer state.
+    EXPECT_CALL(*mOutput1, updateColorProfile(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateColorProfile(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, updateCompositionState(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateCompositionState(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs)));
+
+    size_t parallelForCount = 0;
+    mRefreshArgs.parallelFor = [&](size_t count, const std::function<void(size_t)>& work) {
+        parallelForCount = count;
+        for (size_t i = 0; i < count; i++) work(i);
+    };
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_EQ(2u, parallelForCount);
+    EXPECT_TRUE(mRefreshArgs.outputCompositionStateUpdated);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
@@ -46,6 +46,7 @@ namespace hal = android::hardware::graphics::composer::hal;
 using testing::_;
 using testing::DoAll;
 using testing::Eq;
+using testing::Field;
 using testing::InSequence;
 using testing::NiceMock;
 using testing::Pointee;
@@ -398,10 +399,10 @@ TEST_F(DisplaySetColorTransformTest, setsTransform) {
     refreshArgs.colorTransformMatrix = std::nullopt;
     mDisplay->setColorTransform(refreshArgs);
 
-    // Identity matrix sets an identity state value
+    // The identity matrix matches the initial state, so is not sent to the HWC
     const mat4 kIdentity;
 
-    EXPECT_CALL(mHwComposer, setColorTransform(DEFAULT_DISPLAY_ID, kIdentity)).Times(1);
+    EXPECT_CALL(mHwComposer, setColorTransform(DEFAULT_DISPLAY_ID, _)).Times(0);
 
     refreshArgs.colorTransformMatrix = kIdentity;
     mDisplay->setColorTransform(refreshArgs);
@@ -413,6 +414,16 @@ TEST_F(DisplaySetColorTransformTest, setsTransform) {
 
     refreshArgs.colorTransformMatrix = kNonIdentity;
     mDisplay->setColorTransform(refreshArgs);
+    EXPECT_EQ(kNonIdentity, mDisplay->getState().colorTransformMatrix);
+
+    // Sending the same matrix again does nothing
+    mDisplay->setColorTransform(refreshArgs);
+
+    // Going back to identity is sent
+    EXPECT_CALL(mHwComposer, setColorTransform(DEFAULT_DISPLAY_ID, kIdentity)).Times(1);
+
+    refreshArgs.colorTransformMatrix = kIdentity;
+    mDisplay->setColorTransform(refreshArgs);
 }
 
 /*
@@ -682,6 +693,43 @@ TEST_F(DisplayChooseCompositionStrategyTest, normalOperationWithChanges) {
     EXPECT_TRUE(state.usesDeviceComposition);
 }
 
+/*
+ * Display::canPredictCompositionStrategy()
+ */
+
+struct DisplayCanPredictCompositionStrategyTest : public PartialMockDisplayTestCommon {
+    DisplayCanPredictCompositionStrategyTest() {
+        mDisplay->editState().isEnabled = true;
+        mRefreshArgs.predictCompositionStrategy = true;
+    }
+
+    CompositionRefreshArgs mRefreshArgs;
+};
+
+TEST_F(DisplayCanPredictCompositionStrategyTest, falseIfNotRequested) {
+    mRefreshArgs.predictCompositionStrategy = false;
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayCanPredictCompositionStrategyTest, falseIfGeometryChanges) {
+    mRefreshArgs.updatingGeometryThisFrame = true;
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayCanPredictCompositionStrategyTest, falseWithoutClientComposition) {
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillOnce(Return(false));
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayCanPredictCompositionStrategyTest, falseWithoutPreviouslyValidatedFrame) {
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillOnce(Return(true));
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
 /*
  * Display::getSkipColorTransform()
  */
@@ -889,6 +937,30 @@ TEST_F(DisplaySetExpensiveRenderingExpectedTest, forwardsToPowerAdvisor) {
     mDisplay->setExpensiveRenderingExpected(false);
 }
 
+/*
+ * Display::notifyClientCompositionStarted()
+ * Display::notifyClientCompositionSubmitted()
+ */
+
+using DisplayNotifyClientCompositionTest = DisplayWithLayersTestCommon;
+
+TEST_F(DisplayNotifyClientCompositionTest, forwardsToPowerAdvisor) {
+    Hwc2::ClientCompositionWorkload workload;
+    workload.layerCount = 3;
+    EXPECT_CALL(mPowerAdvisor,
+                notifyClientCompositionStarted(DEFAULT_DISPLAY_ID,
+                                               Field(&Hwc2::ClientCompositionWorkload::layerCount,
+                                                     3u)))
+            .Times(1);
+    mDisplay->notifyClientCompositionStarted(workload);
+
+    const auto readyFence = std::make_shared<FenceTime>(Fence::NO_FENCE);
+    EXPECT_CALL(mPowerAdvisor,
+                notifyClientCompositionSubmitted(DEFAULT_DISPLAY_ID, 1000, readyFence))
+            .Times(1);
+    mDisplay->notifyClientCompositionSubmitted(1000, readyFence);
+}
+
 /*
  * Display::finishFrame()
  */
@@ -78,8 +78,86 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
-TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
-    testSlot(-123, 0);
+TEST_F(HwcBufferCacheTest, cacheAssignsSlotsByBufferIdForNegativeSlots) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(-123, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer2, outBuffer);
+
+    // Both buffers stay cached while they are cycled.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    EXPECT_EQ(2u, mCache.getStats().hits);
+    EXPECT_EQ(2u, mCache.getStats().misses);
+}
+
+TEST_F(HwcBufferCacheTest, cacheEvictsLeastRecentlyUsedBuffer) {
+    impl::HwcBufferCache cache(2);
+    sp<GraphicBuffer> buffer3{new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0)};
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+
+    // mBuffer2 is the least recently used, so its slot is reused.
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffer3, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(buffer3, outBuffer);
+
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+}
+
+TEST_F(HwcBufferCacheTest, cacheLimitsSlotlessBuffers) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (uint32_t i = 0; i <= impl::HwcBufferCache::kMaxSlotlessBuffers; i++) {
+        buffers.push_back(new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0));
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers.back(), &outSlot,
+                            &outBuffer);
+        EXPECT_GT(impl::HwcBufferCache::kMaxSlotlessBuffers, outSlot);
+    }
+
+    // The last buffer took the slot of the first one.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers.front(), &outSlot, &outBuffer);
+    EXPECT_EQ(buffers.front(), outBuffer);
+}
+
+TEST_F(HwcBufferCacheTest, cacheReportsFreedSlots) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+    sp<GraphicBuffer> buffer3{new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0)};
+
+    mCache.getHwcBuffer(0, mBuffer1, &outSlot, &outBuffer);
+    mCache.getHwcBuffer(5, buffer3, &outSlot, &outBuffer);
+    outBuffer = nullptr;
+    EXPECT_TRUE(mCache.takeFreedSlots().empty());
+
+    buffer3 = nullptr;
+    EXPECT_EQ(std::vector<uint32_t>{5}, mCache.takeFreedSlots());
+    EXPECT_TRUE(mCache.takeFreedSlots().empty());
+
+    // The slot was forgotten, so a buffer using it again is sent.
+    mCache.getHwcBuffer(5, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(mBuffer2, outBuffer);
+    mCache.getHwcBuffer(0, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(nullptr, outBuffer.get());
 }
 
 } // namespace
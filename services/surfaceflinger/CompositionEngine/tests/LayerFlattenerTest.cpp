@@ -0,0 +1,170 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/LayerFlattener.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <compositionengine/mock/OutputLayer.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SizeIs;
+
+constexpr int kFramesBeforeFlattening = 10;
+
+struct Layer {
+    Layer() {
+        EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(*layerFE));
+        EXPECT_CALL(outputLayer, getState()).WillRepeatedly(ReturnRef(outputLayerState));
+        EXPECT_CALL(outputLayer, editState()).WillRepeatedly(ReturnRef(outputLayerState));
+        EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+        EXPECT_CALL(*layerFE, getDebugName()).WillRepeatedly(Return("layer"));
+        EXPECT_CALL(*layerFE, prepareClientCompositionList(_))
+                .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>(1)));
+
+        outputLayerState.hwc = impl::OutputLayerCompositionState::Hwc(nullptr);
+        outputLayerState.displayFrame = Rect(1, 1);
+        outputLayerState.outputSpaceVisibleRegion = Region(Rect(1, 1));
+        layerFEState.compositionType = Hwc2::IComposerClient::Composition::DEVICE;
+        layerFEState.acquireFence = new Fence();
+    }
+
+    // Latches a new frame.
+    void update() { layerFEState.acquireFence = new Fence(); }
+
+    NiceMock<mock::OutputLayer> outputLayer;
+    sp<NiceMock<mock::LayerFE>> layerFE = new NiceMock<mock::LayerFE>();
+    impl::OutputLayerCompositionState outputLayerState;
+    LayerFECompositionState layerFEState;
+};
+
+class LayerFlattenerTest : public testing::Test {
+public:
+    LayerFlattenerTest() {
+        ON_CALL(mRenderEngine, isProtected()).WillByDefault(Return(false));
+        ON_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).WillByDefault(Return(NO_ERROR));
+
+        mDisplay.physicalDisplay = Rect(1, 1);
+        mDisplay.clip = Rect(1, 1);
+        mOutputState.bounds = Rect(1, 1);
+        mOutputState.viewport = Rect(1, 1);
+
+        for (auto& layer : mLayers) {
+            mOutputLayers.push_back(&layer.outputLayer);
+        }
+    }
+
+    // Flattens a frame in which the top layer has a new buffer.
+    bool flattenFrame() {
+        mLayers[2].update();
+        return mFlattener.flatten(mDisplay, mOutputState, mOutputLayers, false);
+    }
+
+    NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    renderengine::DisplaySettings mDisplay;
+    impl::OutputCompositionState mOutputState;
+    Layer mLayers[3];
+    std::vector<OutputLayer*> mOutputLayers;
+    impl::LayerFlattener mFlattener{mRenderEngine};
+};
+
+TEST_F(LayerFlattenerTest, flattensUnchangedLayersAfterAFewFrames) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, SizeIs(2), _, _, _, _)).Times(1);
+
+    for (int frame = 1; frame < kFramesBeforeFlattening; frame++) {
+        EXPECT_FALSE(flattenFrame());
+        EXPECT_EQ(0u, mFlattener.getFlattenedLayerCount());
+    }
+
+    EXPECT_TRUE(flattenFrame());
+    EXPECT_EQ(2u, mFlattener.getFlattenedLayerCount());
+    const auto& overrideInfo = mLayers[0].outputLayerState.overrideInfo;
+    ASSERT_NE(nullptr, overrideInfo.buffer);
+    EXPECT_EQ(Rect(1, 1), overrideInfo.displayFrame);
+    EXPECT_TRUE(overrideInfo.surfaceDamage.hasSameRects(Region::INVALID_REGION));
+    EXPECT_TRUE(mLayers[1].outputLayerState.overrideInfo.skip);
+    EXPECT_EQ(nullptr, mLayers[2].outputLayerState.overrideInfo.buffer);
+    EXPECT_FALSE(mLayers[2].outputLayerState.overrideInfo.skip);
+
+    // The flattened buffer keeps being presented without rendering it again.
+    EXPECT_FALSE(flattenFrame());
+    EXPECT_NE(nullptr, mLayers[0].outputLayerState.overrideInfo.buffer);
+    EXPECT_TRUE(mLayers[0].outputLayerState.overrideInfo.surfaceDamage.isEmpty());
+}
+
+TEST_F(LayerFlattenerTest, presentsLayersOnTheirOwnWhenOneOfThemChanges) {
+    for (int frame = 0; frame < kFramesBeforeFlattening; frame++) {
+        flattenFrame();
+    }
+    ASSERT_EQ(2u, mFlattener.getFlattenedLayerCount());
+
+    mLayers[1].update();
+    EXPECT_TRUE(flattenFrame());
+    EXPECT_EQ(0u, mFlattener.getFlattenedLayerCount());
+    EXPECT_EQ(nullptr, mLayers[0].outputLayerState.overrideInfo.buffer);
+    EXPECT_FALSE(mLayers[1].outputLayerState.overrideInfo.skip);
+}
+
+TEST_F(LayerFlattenerTest, changedContentIsDetectedOnGeometryUpdates) {
+    for (int frame = 0; frame < kFramesBeforeFlattening; frame++) {
+        flattenFrame();
+    }
+    ASSERT_EQ(2u, mFlattener.getFlattenedLayerCount());
+
+    // The corner radius of the bottom layer changed, say.
+    mLayers[0].layerFEState.contentDirty = true;
+    EXPECT_TRUE(mFlattener.flatten(mDisplay, mOutputState, mOutputLayers, true));
+    EXPECT_EQ(0u, mFlattener.getFlattenedLayerCount());
+}
+
+TEST_F(LayerFlattenerTest, doesNotFlattenAgainWhatTheHwcCompositesByTheClient) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(1);
+
+    for (int frame = 0; frame < kFramesBeforeFlattening; frame++) {
+        flattenFrame();
+    }
+    ASSERT_EQ(2u, mFlattener.getFlattenedLayerCount());
+
+    EXPECT_CALL(mLayers[0].outputLayer, requiresClientComposition()).WillOnce(Return(true));
+    EXPECT_TRUE(flattenFrame());
+    EXPECT_EQ(0u, mFlattener.getFlattenedLayerCount());
+
+    for (int frame = 0; frame < 2 * kFramesBeforeFlattening; frame++) {
+        flattenFrame();
+        EXPECT_EQ(0u, mFlattener.getFlattenedLayerCount());
+    }
+}
+
+TEST_F(LayerFlattenerTest, doesNotFlattenProtectedContent) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+
+    mLayers[1].layerFEState.hasProtectedContent = true;
+    for (int frame = 0; frame < 2 * kFramesBeforeFlattening; frame++) {
+        EXPECT_FALSE(flattenFrame());
+    }
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -44,6 +44,7 @@ public:
     MOCK_CONST_METHOD1(hasCapability, bool(hal::Capability));
     MOCK_CONST_METHOD2(hasDisplayCapability, bool(DisplayId, hal::DisplayCapability));
 
+    MOCK_CONST_METHOD2(canAllocateVirtualDisplay, bool(uint32_t, uint32_t));
     MOCK_METHOD3(allocateVirtualDisplay,
                  std::optional<DisplayId>(uint32_t, uint32_t, ui::PixelFormat*));
     MOCK_METHOD2(allocatePhysicalDisplay, void(hal::HWDisplayId, DisplayId));
@@ -52,9 +53,9 @@ public:
     MOCK_METHOD3(getDeviceCompositionChanges,
                  status_t(DisplayId, bool,
                           std::optional<android::HWComposer::DeviceRequestedChanges>*));
-    MOCK_METHOD5(setClientTarget,
+    MOCK_METHOD6(setClientTarget,
                  status_t(DisplayId, uint32_t, const sp<Fence>&, const sp<GraphicBuffer>&,
-                          ui::Dataspace));
+                          ui::Dataspace, const Region&));
     MOCK_METHOD1(presentAndGetReleaseFences, status_t(DisplayId));
     MOCK_METHOD2(setPowerMode, status_t(DisplayId, hal::PowerMode));
     MOCK_METHOD2(setActiveConfig, status_t(DisplayId, size_t));
@@ -971,6 +971,66 @@ TEST_F(OutputLayerWriteStateToHWCTest, perFrameStateDoesNotIncludeMetadataIfPres
     mOutputLayer.writeStateToHWC(false);
 }
 
+TEST_F(OutputLayerWriteStateToHWCTest, presentsOverrideBufferOfFlattenedRun) {
+    const sp<GraphicBuffer> overrideBuffer = new GraphicBuffer();
+    const sp<Fence> overrideFence = new Fence();
+    const Rect overrideDisplayFrame{0, 0, 1080, 1920};
+    const Region overrideVisibleRegion{Rect{0, 100, 1080, 1920}};
+    const ui::Dataspace overrideDataspace = ui::Dataspace::V0_SRGB;
+
+    auto& overrideInfo = mOutputLayer.editState().overrideInfo;
+    overrideInfo.buffer = overrideBuffer;
+    overrideInfo.acquireFence = overrideFence;
+    overrideInfo.displayFrame = overrideDisplayFrame;
+    overrideInfo.dataspace = overrideDataspace;
+    overrideInfo.visibleRegion = overrideVisibleRegion;
+    overrideInfo.surfaceDamage = Region::INVALID_REGION;
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::SOLID_COLOR;
+
+    EXPECT_CALL(*mHwcLayer, setDisplayFrame(overrideDisplayFrame)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSourceCrop(overrideDisplayFrame.toFloatRect()))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setZOrder(kZOrder)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setTransform(static_cast<Hwc2::Transform>(0)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBlendMode(Hwc2::IComposerClient::BlendMode::PREMULTIPLIED))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setPlaneAlpha(1.0f)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setInfo(kType, kAppId)).WillOnce(Return(kError));
+
+    EXPECT_CALL(*mHwcLayer, setVisibleRegion(RegionEq(overrideVisibleRegion)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setDataspace(overrideDataspace)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setColorTransform(kColorTransform)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSurfaceDamage(RegionEq(Region::INVALID_REGION)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBuffer(_, overrideBuffer, overrideFence));
+
+    // The run is presented from the buffer, not as a solid color.
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(true);
+}
+
+TEST_F(OutputLayerWriteStateToHWCTest, skippedLayerOfFlattenedRunIsTransparent) {
+    mOutputLayer.editState().overrideInfo.skip = true;
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::DEVICE;
+
+    EXPECT_CALL(*mHwcLayer, setDisplayFrame(kDisplayFrame)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSourceCrop(kSourceCrop)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setZOrder(kZOrder)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setTransform(kBufferTransform)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBlendMode(kBlendMode)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setPlaneAlpha(0.0f)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setInfo(kType, kAppId)).WillOnce(Return(kError));
+
+    expectPerFrameCommonCalls();
+    expectSetHdrMetadataAndBufferCalls();
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(true);
+}
+
 /*
  * OutputLayer::writeCursorPositionToHWC()
  */
@@ -45,6 +45,7 @@ using testing::DoAll;
 using testing::ElementsAre;
 using testing::ElementsAreArray;
 using testing::Eq;
+using testing::Field;
 using testing::InSequence;
 using testing::Invoke;
 using testing::IsEmpty;
@@ -764,6 +765,26 @@ TEST_F(OutputUpdateAndWriteCompositionStateTest, forcesClientCompositionForAllLa
     mOutput->updateAndWriteCompositionState(args);
 }
 
+TEST_F(OutputUpdateAndWriteCompositionStateTest, onlyWritesStateIfAlreadyUpdated) {
+    InjectedLayer layer1;
+    InjectedLayer layer2;
+
+    EXPECT_CALL(*layer1.outputLayer, updateCompositionState(_, _, _)).Times(0);
+    EXPECT_CALL(*layer1.outputLayer, writeStateToHWC(true));
+    EXPECT_CALL(*layer2.outputLayer, updateCompositionState(_, _, _)).Times(0);
+    EXPECT_CALL(*layer2.outputLayer, writeStateToHWC(true));
+
+    injectOutputLayer(layer1);
+    injectOutputLayer(layer2);
+
+    mOutput->editState().isEnabled = true;
+
+    CompositionRefreshArgs args;
+    args.updatingGeometryThisFrame = true;
+    args.outputCompositionStateUpdated = true;
+    mOutput->updateAndWriteCompositionState(args);
+}
+
 /*
  * Output::prepareFrame()
  */
@@ -1046,6 +1067,30 @@ TEST_F(OutputCollectVisibleLayersTest, processesCandidateLayersReversedAndSetsOu
     EXPECT_EQ(2u, mLayer3.outputLayerState.z);
 }
 
+TEST_F(OutputCollectVisibleLayersTest, skipsLayersThatTheGeometrySnapshotRulesOut) {
+    constexpr uint32_t kLayerStackId = 1u;
+    mOutput.editState().layerStackId = kLayerStackId;
+    mOutput.editState().layerStackInternal = false;
+
+    LayerFECompositionState visibleState;
+    visibleState.layerStackId = kLayerStackId;
+    LayerFECompositionState otherLayerStackState;
+    otherLayerStackState.layerStackId = kLayerStackId + 1;
+    LayerFECompositionState internalOnlyState;
+    internalOnlyState.layerStackId = kLayerStackId;
+    internalOnlyState.internalOnly = true;
+
+    mRefreshArgs.layerGeometrySnapshot.add(&visibleState);
+    mRefreshArgs.layerGeometrySnapshot.add(&otherLayerStackState);
+    mRefreshArgs.layerGeometrySnapshot.add(&internalOnlyState);
+
+    EXPECT_CALL(mOutput, ensureOutputLayerIfVisible(Eq(mLayer1.layerFE), Ref(mCoverageState)));
+    EXPECT_CALL(mOutput, setReleasedLayers(Ref(mRefreshArgs)));
+    EXPECT_CALL(mOutput, finalizePendingOutputLayers());
+
+    mOutput.collectVisibleLayers(mRefreshArgs, mCoverageState);
+}
+
 /*
  * Output::ensureOutputLayerIfVisible()
  */
@@ -1534,6 +1579,69 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesNotSoEarlyOutifLayerWithShadow
     ensureOutputLayerIfVisible();
 }
 
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, reusesCachedCoverageIfInputsUnchanged) {
+    mLayer.layerFEState.isOpaque = true;
+    mLayer.layerFEState.contentDirty = false;
+
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+    ASSERT_TRUE(mLayer.outputLayerState.coverageCache.valid);
+
+    // A second frame with identical inputs should not recompute the regions.
+    const Region sentinel(Rect(1, 2, 3, 4));
+    mLayer.outputLayerState.visibleNonTransparentRegion = sentinel;
+    Output::CoverageState secondCoverage{mGeomSnapshots};
+    sp<LayerFE> layerFE(mLayer.layerFE);
+    mOutput.ensureOutputLayerIfVisible(layerFE, secondCoverage);
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleNonTransparentRegion, RegionEq(sentinel));
+    EXPECT_THAT(secondCoverage.aboveCoveredLayers, RegionEq(kFullBoundsNoRotation));
+    EXPECT_THAT(secondCoverage.aboveOpaqueLayers, RegionEq(kFullBoundsNoRotation));
+    EXPECT_THAT(secondCoverage.dirtyRegion, RegionEq(kEmptyRegion));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, recomputesCoverageIfGeometryChanged) {
+    mLayer.layerFEState.isOpaque = true;
+    mLayer.layerFEState.contentDirty = false;
+
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    mLayer.layerFEState.geomLayerBounds = FloatRect{0, 0, 100, 100};
+    Output::CoverageState secondCoverage{mGeomSnapshots};
+    sp<LayerFE> layerFE(mLayer.layerFE);
+    mOutput.ensureOutputLayerIfVisible(layerFE, secondCoverage);
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleRegion, RegionEq(Region(Rect(0, 0, 100, 100))));
+    EXPECT_THAT(secondCoverage.aboveOpaqueLayers, RegionEq(Region(Rect(0, 0, 100, 100))));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, recomputesCoverageIfLayersAboveChanged) {
+    mLayer.layerFEState.isOpaque = true;
+    mLayer.layerFEState.contentDirty = false;
+
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .Times(2)
+            .WillRepeatedly(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    Output::CoverageState secondCoverage{mGeomSnapshots};
+    secondCoverage.aboveOpaqueLayers = Region(Rect(0, 0, 100, 100));
+    secondCoverage.aboveCoveredLayers = Region(Rect(0, 0, 100, 100));
+    sp<LayerFE> layerFE(mLayer.layerFE);
+    mOutput.ensureOutputLayerIfVisible(layerFE, secondCoverage);
+
+    EXPECT_THAT(mLayer.outputLayerState.visibleRegion, RegionEq(kRightHalfBoundsNoRotation));
+    EXPECT_THAT(mLayer.outputLayerState.coveredRegion, RegionEq(Region(Rect(0, 0, 100, 100))));
+}
+
 /*
  * Output::present()
  */
@@ -1548,6 +1656,9 @@ struct OutputPresentTest : public testing::Test {
         MOCK_METHOD1(setColorTransform, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD0(beginFrame, void());
         MOCK_METHOD0(prepareFrame, void());
+        MOCK_METHOD1(canPredictCompositionStrategy,
+                     bool(const compositionengine::CompositionRefreshArgs&));
+        MOCK_METHOD1(prepareFrameAsync, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD1(devOptRepaintFlash, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD1(finishFrame, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD0(postFramebuffer, void());
@@ -1564,6 +1675,7 @@ TEST_F(OutputPresentTest, justInvokesChildFunctionsInSequence) {
     EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
     EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
     EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, canPredictCompositionStrategy(Ref(args))).WillOnce(Return(false));
     EXPECT_CALL(mOutput, prepareFrame());
     EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
     EXPECT_CALL(mOutput, finishFrame(Ref(args)));
@@ -1572,6 +1684,23 @@ TEST_F(OutputPresentTest, justInvokesChildFunctionsInSequence) {
     mOutput.present(args);
 }
 
+TEST_F(OutputPresentTest, preparesFrameAsyncIfCompositionStrategyCanBePredicted) {
+    CompositionRefreshArgs args;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+    EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, canPredictCompositionStrategy(Ref(args))).WillOnce(Return(true));
+    EXPECT_CALL(mOutput, prepareFrameAsync(Ref(args)));
+    EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+    EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+    EXPECT_CALL(mOutput, postFramebuffer());
+
+    mOutput.present(args);
+}
+
 /*
  * Output::updateColorProfile()
  */
@@ -2926,6 +3055,48 @@ TEST_F(OutputComposeSurfacesTest, handlesZeroCompositionRequests) {
     verify().execute().expectAFenceWasReturned();
 }
 
+TEST_F(OutputComposeSurfacesTest, onlyRedrawsClientTargetDamage) {
+    const Rect bounds(100, 200);
+    const sp<Fence> clientTargetAcquireFence = Fence::NO_FENCE;
+    mOutput.cacheClientCompositionRequests(0);
+    mOutput.trackClientTargetDamage(true);
+    mOutput.mState.isEnabled = true;
+    mOutput.mState.bounds = bounds;
+    mOutput.mState.viewport = bounds;
+    mOutput.mState.transform = ui::Transform();
+
+    EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(0u));
+    EXPECT_CALL(mOutput, getSkipColorTransform()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mDisplayColorProfile, hasWideColorGamut()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mRenderEngine, supportsProtectedContent()).WillRepeatedly(Return(false));
+    EXPECT_CALL(mOutput, generateClientCompositionRequests(_, _, _))
+            .WillRepeatedly(Return(std::vector<LayerFE::LayerSettings>{}));
+    EXPECT_CALL(mOutput, appendRegionFlashRequests(_, _)).WillRepeatedly(Return());
+    EXPECT_CALL(*mRenderSurface, dequeueBuffer(_)).WillRepeatedly(Return(mOutputBuffer));
+    EXPECT_CALL(*mRenderSurface, getBufferAge()).WillRepeatedly(Return(1));
+    EXPECT_CALL(*mRenderSurface, getClientTargetAcquireFence())
+            .WillRepeatedly(ReturnRef(clientTargetAcquireFence));
+    EXPECT_CALL(*mRenderSurface, flip());
+    EXPECT_CALL(*mRenderSurface, onPresentDisplayCompleted());
+
+    // Nothing is known about the first client target.
+    EXPECT_CALL(*mRenderSurface, setSurfaceDamage(RegionEq(Region(bounds))));
+    EXPECT_CALL(mRenderEngine,
+                drawLayers(Field(&renderengine::DisplaySettings::damage, bounds), _, _, true, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(Region::INVALID_REGION, kDefaultRefreshArgs));
+    mOutput.postFramebuffer();
+
+    // The next one is drawn over it, and only where it is dirty.
+    const Rect dirty(10, 20, 30, 40);
+    mOutput.mState.dirtyRegion = Region(dirty);
+    EXPECT_CALL(*mRenderSurface, setSurfaceDamage(RegionEq(Region(dirty))));
+    EXPECT_CALL(mRenderEngine,
+                drawLayers(Field(&renderengine::DisplaySettings::damage, dirty), _, _, true, _, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_TRUE(mOutput.composeSurfaces(Region::INVALID_REGION, kDefaultRefreshArgs));
+}
+
 TEST_F(OutputComposeSurfacesTest, buildsAndRendersRequestList) {
     LayerFE::LayerSettings r1;
     LayerFE::LayerSettings r2;
@@ -37,8 +37,11 @@ constexpr std::optional<DisplayId> DEFAULT_DISPLAY_ID = std::make_optional(Displ
 const std::string DEFAULT_DISPLAY_NAME = "Mock Display";
 
 using testing::_;
+using testing::AllOf;
 using testing::ByMove;
 using testing::DoAll;
+using testing::ElementsAre;
+using testing::Field;
 using testing::Ref;
 using testing::Return;
 using testing::ReturnRef;
@@ -223,11 +226,29 @@ TEST_F(RenderSurfaceTest, dequeueBufferObtainsABuffer) {
     EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
             .WillOnce(
                     DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(2), Return(NO_ERROR)));
 
     base::unique_fd fence;
     EXPECT_EQ(buffer.get(), mSurface.dequeueBuffer(&fence).get());
 
     EXPECT_EQ(buffer.get(), mSurface.mutableGraphicBufferForTest().get());
+    EXPECT_EQ(2, mSurface.getBufferAge());
+}
+
+TEST_F(RenderSurfaceTest, dequeueBufferHasNoAgeIfQueryFails) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+
+    EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
+            .WillOnce(
+                    DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(Return(INVALID_OPERATION));
+
+    base::unique_fd fence;
+    EXPECT_EQ(buffer.get(), mSurface.dequeueBuffer(&fence).get());
+
+    EXPECT_EQ(0, mSurface.getBufferAge());
 }
 
 /*
@@ -297,6 +318,7 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesFlipClientTargetRequestWithNoBufferY
     EXPECT_CALL(*mNativeWindow, dequeueBuffer(_, _))
             .WillOnce(
                     DoAll(SetArgPointee<0>(buffer.get()), SetArgPointee<1>(-1), Return(NO_ERROR)));
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _)).WillOnce(Return(NO_ERROR));
     EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
             .WillOnce(Return(NO_ERROR));
     EXPECT_CALL(*mDisplaySurface, advanceFrame()).Times(1);
@@ -306,6 +328,39 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesFlipClientTargetRequestWithNoBufferY
     EXPECT_EQ(nullptr, mSurface.mutableGraphicBufferForTest().get());
 }
 
+TEST_F(RenderSurfaceTest, queueBufferSetsSurfaceDamage) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+    mSurface.mutableGraphicBufferForTest() = buffer;
+
+    impl::OutputCompositionState state;
+    state.usesClientComposition = true;
+
+    // The damage is passed on with a bottom-left origin.
+    mSurface.setSurfaceDamage(Region(Rect(10, 20, 110, 220)));
+
+    EXPECT_CALL(mDisplay, getState()).WillRepeatedly(ReturnRef(state));
+    EXPECT_CALL(*mNativeWindow,
+                setSurfaceDamage(ElementsAre(AllOf(Field(&android_native_rect_t::left, 10),
+                                                   Field(&android_native_rect_t::top,
+                                                         DEFAULT_DISPLAY_HEIGHT - 20),
+                                                   Field(&android_native_rect_t::right, 110),
+                                                   Field(&android_native_rect_t::bottom,
+                                                         DEFAULT_DISPLAY_HEIGHT - 220)))))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplaySurface, advanceFrame()).Times(2);
+
+    mSurface.queueBuffer(base::unique_fd());
+
+    // The damage only applies to one buffer.
+    mSurface.mutableGraphicBufferForTest() = buffer;
+    EXPECT_CALL(*mNativeWindow, queueBuffer(buffer->getNativeBuffer(), -1))
+            .WillOnce(Return(NO_ERROR));
+
+    mSurface.queueBuffer(base::unique_fd());
+}
+
 TEST_F(RenderSurfaceTest, queueBufferHandlesNativeWindowQueueBufferFailureOnVirtualDisplay) {
     sp<GraphicBuffer> buffer = new GraphicBuffer();
     mSurface.mutableGraphicBufferForTest() = buffer;
@@ -77,6 +77,18 @@ DisplayDevice::DisplayDevice(DisplayDeviceCreationArgs& args)
                 static_cast<uint32_t>(SurfaceFlinger::maxFrameBufferAcquiredBuffers));
     }
 
+    if (mFlinger->mEnableClientCompositionLayerSetCache) {
+        mCompositionDisplay->createClientCompositionLayerSetCache();
+    }
+
+    if (mFlinger->mEnablePartialClientComposition) {
+        mCompositionDisplay->createClientTargetDamageHistory();
+    }
+
+    if (mFlinger->mEnableLayerFlattening) {
+        mCompositionDisplay->createLayerFlattener();
+    }
+
     mCompositionDisplay->createDisplayColorProfile(
             compositionengine::DisplayColorProfileCreationArgs{args.hasWideColorGamut,
                                                                std::move(args.hdrCapabilities),
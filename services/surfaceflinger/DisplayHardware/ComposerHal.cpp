@@ -119,6 +119,30 @@ Error unwrapRet(Return<Error>& ret)
 
 namespace impl {
 
+void Composer::SelectionCachingCommandWriter::selectDisplay(Display display) {
+    if (mSelectedDisplay == display) {
+        return;
+    }
+    CommandWriterBase::selectDisplay(display);
+    mSelectedDisplay = display;
+    // Layers are selected relative to the display.
+    mSelectedLayer.reset();
+}
+
+void Composer::SelectionCachingCommandWriter::selectLayer(Layer layer) {
+    if (mSelectedLayer == layer) {
+        return;
+    }
+    CommandWriterBase::selectLayer(layer);
+    mSelectedLayer = layer;
+}
+
+void Composer::SelectionCachingCommandWriter::reset() {
+    CommandWriterBase::reset();
+    mSelectedDisplay.reset();
+    mSelectedLayer.reset();
+}
+
 void Composer::CommandWriter::setLayerType(uint32_t type)
 {
     constexpr uint16_t kSetLayerTypeLength = 1;
@@ -131,7 +155,7 @@ void Composer::CommandWriter::setLayerType(uint32_t type)
 
 #if defined(USE_VR_COMPOSER) && USE_VR_COMPOSER
 Composer::CommandWriter::CommandWriter(uint32_t initialMaxSize)
-    : CommandWriterBase(initialMaxSize) {}
+    : SelectionCachingCommandWriter(initialMaxSize) {}
 
 Composer::CommandWriter::~CommandWriter()
 {
@@ -18,6 +18,7 @@
 #define ANDROID_SF_COMPOSER_HAL_H
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -494,8 +495,27 @@ public:
             IComposerClient::ClientTargetProperty* outClientTargetProperty) override;
 
 private:
+    // Drops the select commands that would not change the display or layer
+    // that the following commands apply to. Most commands are written one
+    // layer at a time, so this avoids two extra commands per layer property.
+    // The selection is forgotten when the queued commands are reset, as each
+    // batch has to start with its own select commands.
+    class SelectionCachingCommandWriter : public CommandWriterBase {
+    public:
+        explicit SelectionCachingCommandWriter(uint32_t initialMaxSize)
+              : CommandWriterBase(initialMaxSize) {}
+
+        void selectDisplay(Display display);
+        void selectLayer(Layer layer);
+        void reset();
+
+    private:
+        std::optional<Display> mSelectedDisplay;
+        std::optional<Layer> mSelectedLayer;
+    };
+
 #if defined(USE_VR_COMPOSER) && USE_VR_COMPOSER
-    class CommandWriter : public CommandWriterBase {
+    class CommandWriter : public SelectionCachingCommandWriter {
     public:
         explicit CommandWriter(uint32_t initialMaxSize);
         ~CommandWriter() override;
@@ -513,9 +533,10 @@ private:
                 const IVrComposerClient::BufferMetadata& metadata);
     };
 #else
-    class CommandWriter : public CommandWriterBase {
+    class CommandWriter : public SelectionCachingCommandWriter {
     public:
-        explicit CommandWriter(uint32_t initialMaxSize) : CommandWriterBase(initialMaxSize) {}
+        explicit CommandWriter(uint32_t initialMaxSize)
+              : SelectionCachingCommandWriter(initialMaxSize) {}
         ~CommandWriter() override {}
 
         void setDisplayElapseTime(uint64_t time);
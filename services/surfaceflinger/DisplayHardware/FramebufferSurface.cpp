@@ -148,7 +148,8 @@ status_t FramebufferSurface::nextBuffer(uint32_t& outSlot,
     outFence = item.mFence;
     mHwcBufferCache.getHwcBuffer(mCurrentBufferSlot, mCurrentBuffer, &outSlot, &outBuffer);
     outDataspace = static_cast<Dataspace>(item.mDataSpace);
-    status_t result = mHwc.setClientTarget(mDisplayId, outSlot, outFence, outBuffer, outDataspace);
+    status_t result = mHwc.setClientTarget(mDisplayId, outSlot, outFence, outBuffer, outDataspace,
+                                           item.mSurfaceDamage);
     if (result != NO_ERROR) {
         ALOGE("error posting framebuffer: %d", result);
         return result;
@@ -64,6 +64,17 @@ inline bool hasMetadataKey(const std::set<Hwc2::PerFrameMetadataKey>& keys,
     return keys.find(key) != keys.end();
 }
 
+// Remembers a layer property once the HWC has accepted it, so that the same
+// value is not sent again. The HWC state is unknown after an error.
+template <typename T>
+void cacheOnSuccess(Error error, std::optional<T>& cached, const T& value) {
+    if (error == Error::NONE) {
+        cached = value;
+    } else {
+        cached.reset();
+    }
+}
+
 } // namespace anonymous
 
 // Display methods
@@ -540,12 +551,20 @@ Error Display::setActiveConfig(const std::shared_ptr<const Config>& config)
 }
 
 Error Display::setClientTarget(uint32_t slot, const sp<GraphicBuffer>& target,
-        const sp<Fence>& acquireFence, Dataspace dataspace)
+        const sp<Fence>& acquireFence, Dataspace dataspace, const Region& damage)
 {
-    // TODO: Properly encode client target surface damage
+    // We encode default full-screen damage as INVALID_RECT upstream, but as 0
+    // rects for HWC
+    std::vector<Hwc2::IComposerClient::Rect> hwcRects;
+    if (!(damage.isRect() && damage.getBounds() == Rect::INVALID_RECT)) {
+        for (const Rect& rect : damage) {
+            hwcRects.push_back({rect.left, rect.top, rect.right, rect.bottom});
+        }
+    }
+
     int32_t fenceFd = acquireFence->dup();
     auto intError = mComposer.setClientTarget(mId, slot, target,
-            fenceFd, dataspace, std::vector<Hwc2::IComposerClient::Rect>());
+            fenceFd, dataspace, hwcRects);
     return static_cast<Error>(intError);
 }
 
@@ -829,17 +848,27 @@ Error Layer::setSurfaceDamage(const Region& damage)
 
 Error Layer::setBlendMode(BlendMode mode)
 {
+    if (mBlendMode == mode) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerBlendMode(mDisplayId, mId, mode);
+    cacheOnSuccess(intError, mBlendMode, mode);
     return static_cast<Error>(intError);
 }
 
 Error Layer::setColor(Color color) {
+    if (mColor == color) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerColor(mDisplayId, mId, color);
+    cacheOnSuccess(intError, mColor, color);
     return static_cast<Error>(intError);
 }
 
 Error Layer::setCompositionType(Composition type)
 {
+    // The color must be set after the composition type, so send it again with the next frame.
+    mColor.reset();
     auto intError = mComposer.setLayerCompositionType(mDisplayId, mId, type);
     return static_cast<Error>(intError);
 }
@@ -918,15 +947,23 @@ Error Layer::setPerFrameMetadata(const int32_t supportedPerFrameMetadata,
 
 Error Layer::setDisplayFrame(const Rect& frame)
 {
+    if (mDisplayFrame == frame) {
+        return Error::NONE;
+    }
     Hwc2::IComposerClient::Rect hwcRect{frame.left, frame.top,
         frame.right, frame.bottom};
     auto intError = mComposer.setLayerDisplayFrame(mDisplayId, mId, hwcRect);
+    cacheOnSuccess(intError, mDisplayFrame, frame);
     return static_cast<Error>(intError);
 }
 
 Error Layer::setPlaneAlpha(float alpha)
 {
+    if (mPlaneAlpha == alpha) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerPlaneAlpha(mDisplayId, mId, alpha);
+    cacheOnSuccess(intError, mPlaneAlpha, alpha);
     return static_cast<Error>(intError);
 }
 
@@ -943,16 +980,24 @@ Error Layer::setSidebandStream(const native_handle_t* stream)
 
 Error Layer::setSourceCrop(const FloatRect& crop)
 {
+    if (mSourceCrop == crop) {
+        return Error::NONE;
+    }
     Hwc2::IComposerClient::FRect hwcRect{
         crop.left, crop.top, crop.right, crop.bottom};
     auto intError = mComposer.setLayerSourceCrop(mDisplayId, mId, hwcRect);
+    cacheOnSuccess(intError, mSourceCrop, crop);
     return static_cast<Error>(intError);
 }
 
 Error Layer::setTransform(Transform transform)
 {
+    if (mTransform == transform) {
+        return Error::NONE;
+    }
     auto intTransform = static_cast<Hwc2::Transform>(transform);
     auto intError = mComposer.setLayerTransform(mDisplayId, mId, intTransform);
+    cacheOnSuccess(intError, mTransform, transform);
     return static_cast<Error>(intError);
 }
 
@@ -979,14 +1024,23 @@ Error Layer::setVisibleRegion(const Region& region)
 
 Error Layer::setZOrder(uint32_t z)
 {
+    if (mZOrder == z) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerZOrder(mDisplayId, mId, z);
+    cacheOnSuccess(intError, mZOrder, z);
     return static_cast<Error>(intError);
 }
 
 Error Layer::setInfo(uint32_t type, uint32_t appId)
 {
-  auto intError = mComposer.setLayerInfo(mDisplayId, mId, type, appId);
-  return static_cast<Error>(intError);
+    const auto info = std::make_pair(type, appId);
+    if (mInfo == info) {
+        return Error::NONE;
+    }
+    auto intError = mComposer.setLayerInfo(mDisplayId, mId, type, appId);
+    cacheOnSuccess(intError, mInfo, info);
+    return static_cast<Error>(intError);
 }
 
 Error Layer::setType(uint32_t type)
@@ -1020,7 +1074,16 @@ Error Layer::setColorTransform(const android::mat4& matrix) {
 // Composer HAL 2.4
 Error Layer::setLayerGenericMetadata(const std::string& name, bool mandatory,
                                      const std::vector<uint8_t>& value) {
+    if (const auto it = mGenericMetadata.find(name); it != mGenericMetadata.end() &&
+        it->second.first == mandatory && it->second.second == value) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerGenericMetadata(mDisplayId, mId, name, mandatory, value);
+    if (static_cast<Error>(intError) == Error::NONE) {
+        mGenericMetadata[name] = std::make_pair(mandatory, value);
+    } else {
+        mGenericMetadata.erase(name);
+    }
     return static_cast<Error>(intError);
 }
 
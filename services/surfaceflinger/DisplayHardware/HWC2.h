@@ -20,6 +20,7 @@
 #include <gui/HdrMetadata.h>
 #include <math/mat4.h>
 #include <ui/DisplayInfo.h>
+#include <ui/FloatRect.h>
 #include <ui/HdrCapabilities.h>
 #include <ui/Region.h>
 #include <utils/Log.h>
@@ -28,9 +29,11 @@
 
 #include <functional>
 #include <future>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "Hal.h"
@@ -207,7 +210,8 @@ public:
             const std::shared_ptr<const Config>& config) = 0;
     [[clang::warn_unused_result]] virtual hal::Error setClientTarget(
             uint32_t slot, const android::sp<android::GraphicBuffer>& target,
-            const android::sp<android::Fence>& acquireFence, hal::Dataspace dataspace) = 0;
+            const android::sp<android::Fence>& acquireFence, hal::Dataspace dataspace,
+            const android::Region& damage) = 0;
     [[clang::warn_unused_result]] virtual hal::Error setColorMode(
             hal::ColorMode mode, hal::RenderIntent renderIntent) = 0;
     [[clang::warn_unused_result]] virtual hal::Error setColorTransform(
@@ -287,7 +291,7 @@ public:
     hal::Error setActiveConfig(const std::shared_ptr<const HWC2::Display::Config>& config) override;
     hal::Error setClientTarget(uint32_t slot, const android::sp<android::GraphicBuffer>& target,
                                const android::sp<android::Fence>& acquireFence,
-                               hal::Dataspace dataspace) override;
+                               hal::Dataspace dataspace, const android::Region& damage) override;
     hal::Error setColorMode(hal::ColorMode mode, hal::RenderIntent renderIntent) override;
     hal::Error setColorTransform(const android::mat4& matrix, hal::ColorTransform hint) override;
     hal::Error setOutputBuffer(const android::sp<android::GraphicBuffer>& buffer,
@@ -454,6 +458,15 @@ private:
     android::mat4 mColorMatrix;
     uint32_t mBufferSlot;
     uint32_t mType{0};
+    std::optional<hal::BlendMode> mBlendMode;
+    std::optional<hal::Color> mColor;
+    std::optional<std::pair<uint32_t, uint32_t>> mInfo;
+    std::unordered_map<std::string, std::pair<bool, std::vector<uint8_t>>> mGenericMetadata;
+    std::optional<android::Rect> mDisplayFrame;
+    std::optional<float> mPlaneAlpha;
+    std::optional<android::FloatRect> mSourceCrop;
+    std::optional<hal::Transform> mTransform;
+    std::optional<uint32_t> mZOrder;
 };
 
 } // namespace impl
@@ -242,6 +242,13 @@ bool HWComposer::onVsync(hal::HWDisplayId hwcDisplayId, int64_t timestamp) {
     return true;
 }
 
+bool HWComposer::canAllocateVirtualDisplay(uint32_t width, uint32_t height) const {
+    return mRemainingHwcVirtualDisplays > 0 &&
+            (SurfaceFlinger::maxVirtualDisplaySize == 0 ||
+             (width <= SurfaceFlinger::maxVirtualDisplaySize &&
+              height <= SurfaceFlinger::maxVirtualDisplaySize));
+}
+
 std::optional<DisplayId> HWComposer::allocateVirtualDisplay(uint32_t width, uint32_t height,
                                                             ui::PixelFormat* format) {
     if (mRemainingHwcVirtualDisplays == 0) {
@@ -476,12 +483,12 @@ void HWComposer::setVsyncEnabled(DisplayId displayId, hal::Vsync enabled) {
 
 status_t HWComposer::setClientTarget(DisplayId displayId, uint32_t slot,
                                      const sp<Fence>& acquireFence, const sp<GraphicBuffer>& target,
-                                     ui::Dataspace dataspace) {
+                                     ui::Dataspace dataspace, const Region& damage) {
     RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
 
     ALOGV("%s for display %s", __FUNCTION__, to_string(displayId).c_str());
     auto& hwcDisplay = mDisplayData[displayId].hwcDisplay;
-    auto error = hwcDisplay->setClientTarget(slot, target, acquireFence, dataspace);
+    auto error = hwcDisplay->setClientTarget(slot, target, acquireFence, dataspace, damage);
     RETURN_IF_HWC_ERROR(error, displayId, BAD_VALUE);
     return NO_ERROR;
 }
@@ -76,6 +76,13 @@ public:
         DisplayRequests displayRequests;
         LayerRequests layerRequests;
         ClientTargetProperty clientTargetProperty;
+
+        bool operator==(const DeviceRequestedChanges& other) const {
+            return changedTypes == other.changedTypes &&
+                    displayRequests == other.displayRequests &&
+                    layerRequests == other.layerRequests &&
+                    clientTargetProperty == other.clientTargetProperty;
+        }
     };
 
     virtual ~HWComposer();
@@ -89,6 +96,10 @@ public:
     virtual bool hasDisplayCapability(DisplayId displayId,
                                       hal::DisplayCapability capability) const = 0;
 
+    // Returns whether the HWC device has a virtual display to spare that can write back a
+    // width x height output.
+    virtual bool canAllocateVirtualDisplay(uint32_t width, uint32_t height) const = 0;
+
     // Attempts to allocate a virtual display and returns its ID if created on the HWC device.
     virtual std::optional<DisplayId> allocateVirtualDisplay(uint32_t width, uint32_t height,
                                                             ui::PixelFormat* format) = 0;
@@ -111,9 +122,10 @@ public:
             DisplayId, bool frameUsesClientComposition,
             std::optional<DeviceRequestedChanges>* outChanges) = 0;
 
+    // An INVALID_REGION damage covers the whole client target.
     virtual status_t setClientTarget(DisplayId displayId, uint32_t slot,
                                      const sp<Fence>& acquireFence, const sp<GraphicBuffer>& target,
-                                     ui::Dataspace dataspace) = 0;
+                                     ui::Dataspace dataspace, const Region& damage) = 0;
 
     // Present layers to the display and read releaseFences.
     virtual status_t presentAndGetReleaseFences(DisplayId displayId) = 0;
@@ -244,6 +256,8 @@ public:
     bool hasDisplayCapability(DisplayId displayId,
                               hal::DisplayCapability capability) const override;
 
+    bool canAllocateVirtualDisplay(uint32_t width, uint32_t height) const override;
+
     // Attempts to allocate a virtual display and returns its ID if created on the HWC device.
     std::optional<DisplayId> allocateVirtualDisplay(uint32_t width, uint32_t height,
                                                     ui::PixelFormat* format) override;
@@ -261,7 +275,8 @@ public:
             std::optional<DeviceRequestedChanges>* outChanges) override;
 
     status_t setClientTarget(DisplayId displayId, uint32_t slot, const sp<Fence>& acquireFence,
-                             const sp<GraphicBuffer>& target, ui::Dataspace dataspace) override;
+                             const sp<GraphicBuffer>& target, ui::Dataspace dataspace,
+                             const Region& damage) override;
 
     // Present layers to the display and read releaseFences.
     status_t presentAndGetReleaseFences(DisplayId displayId) override;
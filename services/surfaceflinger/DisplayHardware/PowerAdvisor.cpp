@@ -19,7 +19,9 @@
 #undef LOG_TAG
 #define LOG_TAG "PowerAdvisor"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
 
 #include <android-base/properties.h>
 #include <utils/Log.h>
@@ -59,8 +61,71 @@ int32_t getUpdateTimeout() {
     return timeout;
 }
 
+// How much the measurement of a frame counts relative to the one after it.
+constexpr double kCostModelDecay = 0.9;
+// Keeps the fit well defined while a feature does not vary, e.g. nothing is blurred.
+constexpr double kCostModelRegularization = 1e-3;
+
 } // namespace
 
+ClientCompositionCostModel::Features ClientCompositionCostModel::getFeatures(
+        const ClientCompositionWorkload& workload) {
+    return {1.0, static_cast<double>(workload.layerCount), workload.area / 1e6,
+            workload.blurArea / 1e6};
+}
+
+void ClientCompositionCostModel::addSample(const ClientCompositionWorkload& workload,
+                                           nsecs_t duration) {
+    const Features x = getFeatures(workload);
+    const double durationMs = duration / 1e6;
+    for (size_t i = 0; i < kFeatureCount; i++) {
+        for (size_t j = 0; j < kFeatureCount; j++) {
+            mCovariance[i][j] = kCostModelDecay * mCovariance[i][j] + x[i] * x[j];
+        }
+        mCorrelation[i] = kCostModelDecay * mCorrelation[i] + x[i] * durationMs;
+    }
+    mSampleCount++;
+    fit();
+}
+
+void ClientCompositionCostModel::fit() {
+    // Solve (covariance + regularization) * coefficients = correlation by Gaussian elimination.
+    // The regularized covariance is positive definite, so no pivoting is needed.
+    std::array<Features, kFeatureCount> a = mCovariance;
+    Features b = mCorrelation;
+    for (size_t i = 0; i < kFeatureCount; i++) {
+        a[i][i] += kCostModelRegularization;
+    }
+    for (size_t i = 0; i < kFeatureCount; i++) {
+        for (size_t j = i + 1; j < kFeatureCount; j++) {
+            const double factor = a[j][i] / a[i][i];
+            for (size_t k = i; k < kFeatureCount; k++) {
+                a[j][k] -= factor * a[i][k];
+            }
+            b[j] -= factor * b[i];
+        }
+    }
+    for (size_t i = kFeatureCount; i-- > 0;) {
+        double sum = b[i];
+        for (size_t k = i + 1; k < kFeatureCount; k++) {
+            sum -= a[i][k] * mCoefficients[k];
+        }
+        mCoefficients[i] = sum / a[i][i];
+    }
+}
+
+nsecs_t ClientCompositionCostModel::predict(const ClientCompositionWorkload& workload) const {
+    if (!isReady()) {
+        return -1;
+    }
+    const Features x = getFeatures(workload);
+    double durationMs = 0.0;
+    for (size_t i = 0; i < kFeatureCount; i++) {
+        durationMs += mCoefficients[i] * x[i];
+    }
+    return static_cast<nsecs_t>(std::max(durationMs, 0.0) * 1e6);
+}
+
 PowerAdvisor::PowerAdvisor()
       : mUseUpdateImminentTimer(getUpdateTimeout() > 0),
         mUpdateImminentTimer(
@@ -81,9 +146,28 @@ void PowerAdvisor::setExpensiveRenderingExpected(DisplayId displayId, bool expec
         mExpensiveDisplays.insert(displayId);
     } else {
         mExpensiveDisplays.erase(displayId);
+
+        // Nothing is composed for the display this frame.
+        if (const auto it = mDisplayLoads.find(displayId); it != mDisplayLoads.end()) {
+            relax(it->second);
+        }
+    }
+
+    updateExpensiveRendering();
+}
+
+void PowerAdvisor::updateExpensiveRendering() {
+    // Once the cost of a display can be predicted, the prediction replaces the expectation of
+    // the caller, so that cheap frames in an expensive color space do not boost the GPU.
+    bool expectsExpensiveRendering = false;
+    for (const auto& [displayId, load] : mDisplayLoads) {
+        expectsExpensiveRendering |= load.heavy;
+    }
+    for (const DisplayId displayId : mExpensiveDisplays) {
+        const auto it = mDisplayLoads.find(displayId);
+        expectsExpensiveRendering |= it == mDisplayLoads.end() || !it->second.model.isReady();
     }
 
-    const bool expectsExpensiveRendering = !mExpensiveDisplays.empty();
     if (mNotifiedExpensiveRendering != expectsExpensiveRendering) {
         std::lock_guard lock(mPowerHalMutex);
         HalWrapper* const halWrapper = getPowerHal();
@@ -135,6 +219,111 @@ bool PowerAdvisor::canNotifyDisplayUpdateImminent() {
     return canNotify;
 }
 
+PowerAdvisor::CompositionLoad PowerAdvisor::getCompositionLoad(nsecs_t predictedDuration,
+                                                              nsecs_t frameBudget) {
+    // Composition starts well into the frame, so half of the budget is already a lot.
+    if (predictedDuration * 2 >= frameBudget) {
+        return CompositionLoad::Heavy;
+    }
+    if (predictedDuration * 4 >= frameBudget) {
+        return CompositionLoad::Moderate;
+    }
+    return CompositionLoad::Light;
+}
+
+void PowerAdvisor::notifyClientCompositionStarted(DisplayId displayId,
+                                                  const ClientCompositionWorkload& workload) {
+    DisplayLoad& load = mDisplayLoads[displayId];
+    load.startedWorkload = workload;
+    measurePendingFrames(load);
+
+    const nsecs_t predictedDuration = load.model.predict(workload);
+    if (predictedDuration < 0) {
+        return;
+    }
+
+    // Default to 60 Hz if the refresh rate is unknown.
+    const nsecs_t frameBudget = workload.frameBudget > 0 ? workload.frameBudget : ms2ns(16);
+    switch (getCompositionLoad(predictedDuration, frameBudget)) {
+        case CompositionLoad::Heavy:
+            load.heavy = true;
+            load.lightFrames = 0;
+            break;
+        case CompositionLoad::Moderate:
+            relax(load);
+            if (!load.heavy) {
+                boostComposition(frameBudget);
+            }
+            break;
+        case CompositionLoad::Light:
+            relax(load);
+            break;
+    }
+    updateExpensiveRendering();
+}
+
+void PowerAdvisor::notifyClientCompositionSubmitted(DisplayId displayId, nsecs_t startTime,
+                                                    const std::shared_ptr<FenceTime>& readyFence) {
+    DisplayLoad& load = mDisplayLoads[displayId];
+    if (load.pendingFrames.size() == kMaxPendingFrames) {
+        load.pendingFrames.pop_front();
+    }
+    load.pendingFrames.push_back({load.startedWorkload, startTime, readyFence,
+                                  readyFence ? -1 : systemTime()});
+}
+
+void PowerAdvisor::measurePendingFrames(DisplayLoad& load) {
+    // Frames complete in order, and the ones still rendering are measured later on.
+    while (!load.pendingFrames.empty()) {
+        const PendingFrame& frame = load.pendingFrames.front();
+        nsecs_t endTime = frame.endTime;
+        if (frame.readyFence) {
+            endTime = frame.readyFence->getSignalTime();
+            if (endTime == Fence::SIGNAL_TIME_PENDING) {
+                return;
+            }
+        }
+        if (endTime != Fence::SIGNAL_TIME_INVALID && endTime >= frame.startTime) {
+            load.model.addSample(frame.workload, endTime - frame.startTime);
+        }
+        load.pendingFrames.pop_front();
+    }
+}
+
+void PowerAdvisor::relax(DisplayLoad& load) {
+    if (load.heavy && ++load.lightFrames >= kLightFramesToRelax) {
+        load.heavy = false;
+        load.lightFrames = 0;
+    }
+}
+
+void PowerAdvisor::boostComposition(nsecs_t frameBudget) {
+    // Same as notifyDisplayUpdateImminent()
+    if (!mBootFinished.load()) {
+        return;
+    }
+
+    const nsecs_t now = systemTime();
+    if (now < mBoostEndTime) {
+        return;
+    }
+    const nsecs_t duration = kBoostFrames * frameBudget;
+    mBoostEndTime = now + duration;
+
+    std::lock_guard lock(mPowerHalMutex);
+    HalWrapper* const halWrapper = getPowerHal();
+    if (halWrapper == nullptr) {
+        return;
+    }
+
+    if (!halWrapper->boostComposition(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::nanoseconds(duration)))) {
+        // The HAL has become unavailable; attempt to reconnect later
+        mReconnectPowerHal = true;
+    }
+}
+
 class HidlPowerHalWrapper : public PowerAdvisor::HalWrapper {
 public:
     HidlPowerHalWrapper(sp<V1_3::IPower> powerHal) : mPowerHal(std::move(powerHal)) {}
@@ -177,6 +366,12 @@ public:
         return true;
     }
 
+    bool boostComposition(std::chrono::milliseconds) override {
+        // Power HAL 1.x only has EXPENSIVE_RENDERING for composition
+        ALOGV("HIDL boostComposition received but can't send");
+        return true;
+    }
+
 private:
     const sp<V1_3::IPower> mPowerHal = nullptr;
 };
@@ -231,6 +426,18 @@ public:
         return ret.isOk();
     }
 
+    bool boostComposition(std::chrono::milliseconds duration) override {
+        ALOGV("AIDL boostComposition %" PRId64 "ms", static_cast<int64_t>(duration.count()));
+        if (!mHasDisplayUpdateImminent) {
+            ALOGV("Skipped sending DISPLAY_UPDATE_IMMINENT because HAL doesn't support it");
+            return true;
+        }
+
+        auto ret = mPowerHal->setBoost(Boost::DISPLAY_UPDATE_IMMINENT,
+                                       static_cast<int32_t>(duration.count()));
+        return ret.isOk();
+    }
+
 private:
     const sp<IPower> mPowerHal = nullptr;
     bool mHasExpensiveRendering = false;
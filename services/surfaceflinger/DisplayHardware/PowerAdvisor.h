@@ -16,10 +16,17 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
+#include <ui/FenceTime.h>
 #include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 #include "../Scheduler/OneShotTimer.h"
 #include "DisplayIdentification.h"
@@ -27,6 +34,18 @@
 namespace android {
 namespace Hwc2 {
 
+// The RenderEngine work of one frame of client composition on a display.
+struct ClientCompositionWorkload {
+    // The number of layers drawn by RenderEngine.
+    size_t layerCount = 0;
+    // The area drawn by RenderEngine, in pixels. Overlapping layers count once each.
+    float area = 0.0f;
+    // The part of |area| covered by layers that blur what is behind them.
+    float blurArea = 0.0f;
+    // The time available to compose a frame, or 0 if unknown.
+    nsecs_t frameBudget = 0;
+};
+
 class PowerAdvisor {
 public:
     virtual ~PowerAdvisor();
@@ -35,10 +54,50 @@ public:
     virtual void setExpensiveRenderingExpected(DisplayId displayId, bool expected) = 0;
     virtual void notifyDisplayUpdateImminent() = 0;
     virtual bool canNotifyDisplayUpdateImminent() = 0;
+
+    // Called before RenderEngine composes a frame for a display, so the cost of the frame can be
+    // predicted and hinted ahead of time.
+    virtual void notifyClientCompositionStarted(DisplayId displayId,
+                                                const ClientCompositionWorkload& workload) = 0;
+    // Called once RenderEngine has been given the work announced by
+    // notifyClientCompositionStarted(). readyFence signals when the work completes, and is null
+    // if it already has.
+    virtual void notifyClientCompositionSubmitted(DisplayId displayId, nsecs_t startTime,
+                                                  const std::shared_ptr<FenceTime>& readyFence) = 0;
 };
 
 namespace impl {
 
+// Predicts how long RenderEngine takes to compose a frame from its workload. The cost is modelled
+// as a fixed overhead plus a cost per layer, per pixel and per blurred pixel, fitted to the
+// measured durations of recent frames by exponentially weighted least squares.
+class ClientCompositionCostModel {
+public:
+    // The number of frames measured before predictions are made.
+    static constexpr size_t kMinSamples = 8;
+
+    void addSample(const ClientCompositionWorkload& workload, nsecs_t duration);
+
+    // Returns the predicted duration of the workload, or -1 if too few frames were measured.
+    nsecs_t predict(const ClientCompositionWorkload& workload) const;
+
+    bool isReady() const { return mSampleCount >= kMinSamples; }
+
+private:
+    static constexpr size_t kFeatureCount = 4;
+    using Features = std::array<double, kFeatureCount>;
+
+    static Features getFeatures(const ClientCompositionWorkload& workload);
+    void fit();
+
+    // Weighted sums of x * x^T and x * duration over the measured frames.
+    std::array<Features, kFeatureCount> mCovariance{};
+    Features mCorrelation{};
+    // Duration in milliseconds per unit of each feature.
+    Features mCoefficients{};
+    size_t mSampleCount = 0;
+};
+
 // PowerAdvisor is a wrapper around IPower HAL which takes into account the
 // full state of the system when sending out power hints to things like the GPU.
 class PowerAdvisor final : public Hwc2::PowerAdvisor {
@@ -49,8 +108,13 @@ public:
 
         virtual bool setExpensiveRendering(bool enabled) = 0;
         virtual bool notifyDisplayUpdateImminent() = 0;
+        virtual bool boostComposition(std::chrono::milliseconds duration) = 0;
     };
 
+    // How expensive the next frames of a display are expected to be, relative to the frame
+    // budget.
+    enum class CompositionLoad { Light, Moderate, Heavy };
+
     PowerAdvisor();
     ~PowerAdvisor() override;
 
@@ -58,8 +122,47 @@ public:
     void setExpensiveRenderingExpected(DisplayId displayId, bool expected) override;
     void notifyDisplayUpdateImminent() override;
     bool canNotifyDisplayUpdateImminent() override;
+    void notifyClientCompositionStarted(DisplayId displayId,
+                                        const ClientCompositionWorkload& workload) override;
+    void notifyClientCompositionSubmitted(DisplayId displayId, nsecs_t startTime,
+                                          const std::shared_ptr<FenceTime>& readyFence) override;
+
+    static CompositionLoad getCompositionLoad(nsecs_t predictedDuration, nsecs_t frameBudget);
 
 private:
+    // A frame given to RenderEngine, until its duration is known.
+    struct PendingFrame {
+        ClientCompositionWorkload workload;
+        nsecs_t startTime = -1;
+        std::shared_ptr<FenceTime> readyFence;
+        nsecs_t endTime = -1;
+    };
+
+    struct DisplayLoad {
+        ClientCompositionCostModel model;
+        ClientCompositionWorkload startedWorkload;
+        std::deque<PendingFrame> pendingFrames;
+        // Set while the predicted cost keeps EXPENSIVE_RENDERING on.
+        bool heavy = false;
+        // The number of frames in a row that were not predicted to be heavy.
+        int lightFrames = 0;
+    };
+
+    static void measurePendingFrames(DisplayLoad& load);
+    void relax(DisplayLoad& load);
+    void updateExpensiveRendering();
+    void boostComposition(nsecs_t frameBudget);
+
+    // Frames still rendering when this many more are submitted are not measured.
+    static constexpr size_t kMaxPendingFrames = 4;
+    // Heavy load is relaxed after this many lighter frames in a row.
+    static constexpr int kLightFramesToRelax = 4;
+    // Moderate load boosts the GPU for this many frames.
+    static constexpr int kBoostFrames = 4;
+
+    std::unordered_map<DisplayId, DisplayLoad> mDisplayLoads;
+    nsecs_t mBoostEndTime = 0;
+
     HalWrapper* getPowerHal() REQUIRES(mPowerHalMutex);
     bool mReconnectPowerHal GUARDED_BY(mPowerHalMutex) = false;
     std::mutex mPowerHalMutex;
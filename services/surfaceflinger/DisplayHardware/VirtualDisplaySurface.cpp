@@ -86,7 +86,10 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
         mMustRecompose(false),
         mForceHwcCopy(SurfaceFlinger::useHwcForRgbToYuv),
         mSecure(secure),
-        mSinkUsage(0) {
+        mSinkUsage(0),
+        mRequestedCompositionType(COMPOSITION_UNKNOWN),
+        mPrepareTime(0),
+        mComposeTime(0) {
     mSource[SOURCE_SINK] = sink;
     mSource[SOURCE_SCRATCH] = bqProducer;
 
@@ -115,6 +118,13 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
     }
     mOutputFormat = mDefaultOutputFormat;
 
+    // The forced HWC copy is only there to convert to YUV, so sinks that take
+    // RGB are given the GPU output directly.
+    if (mForceHwcCopy && isRgbFormat(mDefaultOutputFormat)) {
+        VDS_LOGV("Sink consumes RGB, not forcing HWC copies");
+        mForceHwcCopy = false;
+    }
+
     ConsumerBase::mName = String8::format("VDS: %s", mDisplayName.c_str());
     mConsumer->setConsumerName(ConsumerBase::mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
@@ -155,6 +165,8 @@ status_t VirtualDisplaySurface::prepareFrame(CompositionType compositionType) {
             "Unexpected prepareFrame() in %s state", dbgStateStr());
     mDbgState = DBG_STATE_PREPARED;
 
+    mPrepareTime = systemTime();
+    mRequestedCompositionType = compositionType;
     mCompositionType = compositionType;
     if (mForceHwcCopy && mCompositionType == COMPOSITION_GPU) {
         // Some hardware can do RGB->YUV conversion more efficiently in hardware
@@ -208,6 +220,7 @@ status_t VirtualDisplaySurface::advanceFrame() {
                     "Unexpected advanceFrame() in %s state on GPU/MIXED frame", dbgStateStr());
     }
     mDbgState = DBG_STATE_HWC;
+    mComposeTime = systemTime() - mPrepareTime;
 
     if (mOutputProducerSlot < 0 ||
             (mCompositionType != COMPOSITION_HWC && mFbProducerSlot < 0)) {
@@ -239,7 +252,7 @@ status_t VirtualDisplaySurface::advanceFrame() {
 
         // TODO: Correctly propagate the dataspace from GL composition
         result = mHwc.setClientTarget(*mDisplayId, hwcSlot, mFbFence, hwcBuffer,
-                                      ui::Dataspace::UNKNOWN);
+                                      ui::Dataspace::UNKNOWN, Region::INVALID_REGION);
     }
 
     return result;
@@ -254,6 +267,15 @@ void VirtualDisplaySurface::onFrameCommitted() {
             "Unexpected onFrameCommitted() in %s state", dbgStateStr());
     mDbgState = DBG_STATE_IDLE;
 
+    {
+        Mutex::Autolock lock(mMutex);
+        mStats.frames[mCompositionType]++;
+        mStats.composeTime[mCompositionType] += mComposeTime;
+        if (mCompositionType != mRequestedCompositionType) {
+            mStats.forcedHwcCopies++;
+        }
+    }
+
     sp<Fence> retireFence = mHwc.getPresentFence(*mDisplayId);
     if (mCompositionType == COMPOSITION_MIXED && mFbProducerSlot >= 0) {
         // release the scratch buffer back to the pool
@@ -293,7 +315,26 @@ void VirtualDisplaySurface::onFrameCommitted() {
     resetPerFrameState();
 }
 
-void VirtualDisplaySurface::dumpAsString(String8& /* result */) const {
+void VirtualDisplaySurface::dumpAsString(String8& result) const {
+    Mutex::Autolock lock(mMutex);
+    if (!mDisplayId) {
+        result.appendFormat("  VirtualDisplaySurface: no HWC writeback, %" PRIu64
+                            " frames composed by GPU into the sink\n",
+                            mStats.gpuOnlyFrames);
+        return;
+    }
+
+    result.appendFormat("  VirtualDisplaySurface: HWC writeback%s\n",
+                        mForceHwcCopy ? ", GPU frames copied by HWC for YUV" : "");
+    for (const CompositionType type : {COMPOSITION_GPU, COMPOSITION_HWC, COMPOSITION_MIXED}) {
+        const uint64_t frames = mStats.frames[type];
+        result.appendFormat("    %-5s %" PRIu64 " frames, %.3f ms mean compose time\n",
+                            dbgCompositionTypeStr(type), frames,
+                            frames ? mStats.composeTime[type] / 1e6 / frames : 0.0);
+    }
+    result.appendFormat("    %" PRIu64 " GPU frames copied through the scratch queue for YUV\n",
+                        mStats.forcedHwcCopies);
+    ConsumerBase::dumpLocked(result, "   ");
 }
 
 void VirtualDisplaySurface::resizeBuffers(const uint32_t w, const uint32_t h) {
@@ -473,6 +514,10 @@ status_t VirtualDisplaySurface::attachBuffer(int* /* outSlot */,
 status_t VirtualDisplaySurface::queueBuffer(int pslot,
         const QueueBufferInput& input, QueueBufferOutput* output) {
     if (!mDisplayId) {
+        {
+            Mutex::Autolock lock(mMutex);
+            mStats.gpuOnlyFrames++;
+        }
         return mSource[SOURCE_SINK]->queueBuffer(pslot, input, output);
     }
 
@@ -635,6 +680,8 @@ void VirtualDisplaySurface::updateQueueBufferOutput(
 
 void VirtualDisplaySurface::resetPerFrameState() {
     mCompositionType = COMPOSITION_UNKNOWN;
+    mRequestedCompositionType = COMPOSITION_UNKNOWN;
+    mComposeTime = 0;
     mFbFence = Fence::NO_FENCE;
     mOutputFence = Fence::NO_FENCE;
     mOutputProducerSlot = -1;
@@ -686,6 +733,21 @@ VirtualDisplaySurface::fbSourceForCompositionType(CompositionType type) {
     return type == COMPOSITION_MIXED ? SOURCE_SCRATCH : SOURCE_SINK;
 }
 
+bool VirtualDisplaySurface::isRgbFormat(uint32_t format) {
+    switch (format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_RGB_888:
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+        case HAL_PIXEL_FORMAT_RGBA_FP16:
+        case HAL_PIXEL_FORMAT_RGBA_1010102:
+            return true;
+        default:
+            return false;
+    }
+}
+
 const char* VirtualDisplaySurface::dbgStateStr() const {
     switch (mDbgState) {
         case DBG_STATE_IDLE:
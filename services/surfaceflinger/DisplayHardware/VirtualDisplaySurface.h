@@ -17,6 +17,7 @@
 #ifndef ANDROID_SF_VIRTUAL_DISPLAY_SURFACE_H
 #define ANDROID_SF_VIRTUAL_DISPLAY_SURFACE_H
 
+#include <array>
 #include <optional>
 #include <string>
 
@@ -72,6 +73,10 @@ class IProducerListener;
  * buffer for HWC, and a separate buffer is dequeued from the sink and used as
  * the HWC output buffer. When HWC composition is complete, the scratch buffer
  * is released and the output buffer is queued to the sink.
+ *
+ * When the HWC is forced to copy GPU-only frames to convert them to YUV, the
+ * copy is skipped for sinks that consume RGB, and the GPU renders straight
+ * into the sink buffer.
  */
 class VirtualDisplaySurface : public compositionengine::DisplaySurface,
                               public BnGraphicBufferProducer,
@@ -138,6 +143,7 @@ private:
     // Utility methods
     //
     static Source fbSourceForCompositionType(CompositionType type);
+    static bool isRgbFormat(uint32_t format);
     status_t dequeueBuffer(Source source, PixelFormat format, uint64_t usage,
             int* sslot, sp<Fence>* fence);
     void updateQueueBufferOutput(QueueBufferOutput&& qbo);
@@ -260,6 +266,25 @@ private:
     bool mForceHwcCopy;
     bool mSecure;
     int mSinkUsage;
+
+    // Composition cost, reported in dumpAsString(). Guarded by mMutex.
+    struct CompositionStats {
+        // Frames by composition type, indexed by CompositionType.
+        std::array<uint64_t, 4> frames{};
+        // Time from prepareFrame() to advanceFrame(), by composition type.
+        std::array<nsecs_t, 4> composeTime{};
+        // GPU-only frames the HWC copied to convert them to YUV.
+        uint64_t forcedHwcCopies = 0;
+        // Frames the sink was given without a HWC display, composed by GPU.
+        uint64_t gpuOnlyFrames = 0;
+    };
+    CompositionStats mStats;
+
+    // The composition type requested for the current frame, before any
+    // forced HWC copy, and when prepareFrame() was called.
+    CompositionType mRequestedCompositionType;
+    nsecs_t mPrepareTime;
+    nsecs_t mComposeTime;
 };
 
 // ---------------------------------------------------------------------------
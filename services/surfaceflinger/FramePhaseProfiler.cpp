@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FramePhaseProfiler.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+
+namespace android {
+
+using base::StringAppendF;
+
+namespace {
+
+double toMs(nsecs_t duration) {
+    return static_cast<double>(duration) / 1e6;
+}
+
+// Nearest-rank percentile of a sorted, non-empty vector.
+nsecs_t percentile(const std::vector<nsecs_t>& sorted, size_t percent) {
+    const size_t rank = (sorted.size() * percent + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+} // namespace
+
+FramePhaseProfiler::FramePhaseProfiler() : mFrames(kNumFrames) {
+    mCurrentFrame.fill(-1);
+}
+
+void FramePhaseProfiler::setEnabled(bool enabled) {
+    mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void FramePhaseProfiler::startFrame() {
+    if (mFrameInProgress) {
+        std::lock_guard lock(mMutex);
+        mFrames[mNextFrame] = mCurrentFrame;
+        mNextFrame = (mNextFrame + 1) % kNumFrames;
+        mNumFrames = std::min(mNumFrames + 1, kNumFrames);
+    }
+
+    mCurrentFrame.fill(-1);
+    mFrameInProgress = isEnabled();
+}
+
+void FramePhaseProfiler::recordPhase(Phase phase, nsecs_t duration) {
+    if (!mFrameInProgress) return;
+
+    nsecs_t& total = mCurrentFrame[static_cast<size_t>(phase)];
+    // A phase may run more than once per frame, e.g. composition on several outputs.
+    total = std::max<nsecs_t>(total, 0) + duration;
+}
+
+void FramePhaseProfiler::clear() {
+    std::lock_guard lock(mMutex);
+    mNextFrame = 0;
+    mNumFrames = 0;
+}
+
+const char* FramePhaseProfiler::phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Invalidate:
+            return "onMessageInvalidate";
+        case Phase::Transaction:
+            return "handleMessageTransaction";
+        case Phase::PageFlip:
+            return "handlePageFlip";
+        case Phase::Refresh:
+            return "onMessageRefresh";
+        case Phase::CompositionPresent:
+            return "CompositionEngine::present";
+        case Phase::PostComposition:
+            return "postComposition";
+        case Phase::RenderEngineDraw:
+            return "RenderEngine::drawLayers";
+        case Phase::Count:
+            break;
+    }
+    return "unknown";
+}
+
+void FramePhaseProfiler::dump(std::string& result) const {
+    std::array<std::vector<nsecs_t>, kNumPhases> samples;
+    size_t numFrames;
+    {
+        std::lock_guard lock(mMutex);
+        numFrames = mNumFrames;
+        for (size_t i = 0; i < mNumFrames; i++) {
+            const FrameRecord& frame = mFrames[i];
+            for (size_t phase = 0; phase < kNumPhases; phase++) {
+                if (frame[phase] >= 0) samples[phase].push_back(frame[phase]);
+            }
+        }
+    }
+
+    StringAppendF(&result, "Frame phases (%s, last %zu frames, durations in ms):\n",
+                  isEnabled() ? "enabled" : "disabled", numFrames);
+    StringAppendF(&result, "  %-28s %7s %9s %9s %9s %9s\n", "phase", "count", "p50", "p90", "p99",
+                  "max");
+
+    for (size_t phase = 0; phase < kNumPhases; phase++) {
+        std::vector<nsecs_t>& durations = samples[phase];
+        const char* name = phaseName(static_cast<Phase>(phase));
+        if (durations.empty()) {
+            StringAppendF(&result, "  %-28s %7d %9s %9s %9s %9s\n", name, 0, "-", "-", "-", "-");
+            continue;
+        }
+
+        std::sort(durations.begin(), durations.end());
+        StringAppendF(&result, "  %-28s %7zu %9.3f %9.3f %9.3f %9.3f\n", name, durations.size(),
+                      toMs(percentile(durations, 50)), toMs(percentile(durations, 90)),
+                      toMs(percentile(durations, 99)), toMs(durations.back()));
+    }
+}
+
+} // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+// FramePhaseProfiler records how long the main thread spends in each phase of
+// a frame, for the most recent kNumFrames frames. A frame starts with each
+// invalidate message. Phases nest (e.g. Transaction runs inside Invalidate),
+// and every duration is inclusive of the phases it contains.
+//
+// Phases must only be recorded from the main thread. Dumping and clearing may
+// happen from any thread.
+class FramePhaseProfiler {
+public:
+    enum class Phase : size_t {
+        Invalidate,
+        Transaction,
+        PageFlip,
+        Refresh,
+        CompositionPresent,
+        PostComposition,
+        RenderEngineDraw,
+        Count,
+    };
+
+    static constexpr size_t kNumFrames = 1024;
+
+    // Measures the lifetime of the object as the duration of a phase.
+    class ScopedPhase {
+    public:
+        ScopedPhase(FramePhaseProfiler& profiler, Phase phase)
+              : mProfiler(profiler),
+                mPhase(phase),
+                mStart(profiler.isEnabled() ? systemTime() : 0) {}
+        ~ScopedPhase() {
+            if (mStart != 0) mProfiler.recordPhase(mPhase, systemTime() - mStart);
+        }
+
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    private:
+        FramePhaseProfiler& mProfiler;
+        const Phase mPhase;
+        const nsecs_t mStart;
+    };
+
+    FramePhaseProfiler();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    // Commits the frame in progress, if any, and starts a new one.
+    void startFrame();
+    // Adds |duration| to |phase| of the frame in progress.
+    void recordPhase(Phase phase, nsecs_t duration);
+
+    void clear();
+    // Summarizes the recorded frames as per-phase percentiles.
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t kNumPhases = static_cast<size_t>(Phase::Count);
+    // A phase that did not run during a frame is recorded as -1.
+    using FrameRecord = std::array<nsecs_t, kNumPhases>;
+
+    static const char* phaseName(Phase phase);
+
+    std::atomic<bool> mEnabled{true};
+
+    // Only touched by the main thread.
+    FrameRecord mCurrentFrame;
+    bool mFrameInProgress = false;
+
+    mutable std::mutex mMutex;
+    std::vector<FrameRecord> mFrames GUARDED_BY(mMutex);
+    size_t mNextFrame GUARDED_BY(mMutex) = 0;
+    size_t mNumFrames GUARDED_BY(mMutex) = 0;
+};
+
+} // namespace android
@@ -28,6 +28,7 @@
 #include <perfetto/trace/clock_snapshot.pbzero.h>
 
 #include <algorithm>
+#include <iterator>
 #include <mutex>
 
 PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::FrameTracer::FrameTracerDataSource);
@@ -35,6 +36,18 @@ PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::FrameTracer::FrameTracerData
 namespace android {
 
 using Clock = perfetto::protos::pbzero::ClockSnapshot::Clock;
+
+FrameTracer::~FrameTracer() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mDone = true;
+    }
+    mQueueCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
 void FrameTracer::initialize() {
     std::call_once(mInitializationFlag, [this]() {
         perfetto::TracingInitArgs args;
@@ -50,59 +63,140 @@ void FrameTracer::registerDataSource() {
     FrameTracerDataSource::Register(dsd);
 }
 
+bool FrameTracer::isTracing() {
+    bool tracing = false;
+    FrameTracerDataSource::Trace(
+            [&tracing](FrameTracerDataSource::TraceContext) { tracing = true; });
+    return tracing;
+}
+
 void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
-    FrameTracerDataSource::Trace([this, layerId, &layerName](FrameTracerDataSource::TraceContext) {
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            mTraceTracker[layerId].layerName = layerName;
-        }
-    });
+    if (isTracing()) {
+        enqueue({.kind = QueuedEvent::Kind::NewLayer, .layerId = layerId, .layerName = layerName});
+    }
 }
 
 void FrameTracer::traceTimestamp(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                                  nsecs_t timestamp, FrameEvent::BufferEventType type,
                                  nsecs_t duration) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, timestamp, type,
-                                  duration](FrameTracerDataSource::TraceContext ctx) {
-        std::lock_guard<std::mutex> lock(mTraceMutex);
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-            return;
-        }
-
-        // Handle any pending fences for this buffer.
-        tracePendingFencesLocked(ctx, layerId, bufferID);
-
-        // Complete current trace.
-        traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
-    });
+    if (isTracing()) {
+        enqueue({.kind = QueuedEvent::Kind::Timestamp,
+                 .layerId = layerId,
+                 .bufferID = bufferID,
+                 .frameNumber = frameNumber,
+                 .timestamp = timestamp,
+                 .type = type,
+                 .duration = duration});
+    }
 }
 
 void FrameTracer::traceFence(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                              const std::shared_ptr<FenceTime>& fence,
                              FrameEvent::BufferEventType type, nsecs_t startTime) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, &fence, type,
-                                  startTime](FrameTracerDataSource::TraceContext ctx) {
-        const nsecs_t signalTime = fence->getSignalTime();
-        if (signalTime != Fence::SIGNAL_TIME_INVALID) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+    if (isTracing()) {
+        enqueue({.kind = QueuedEvent::Kind::Fence,
+                 .layerId = layerId,
+                 .bufferID = bufferID,
+                 .frameNumber = frameNumber,
+                 .timestamp = startTime,
+                 .type = type,
+                 .fence = fence});
+    }
+}
+
+void FrameTracer::enqueue(QueuedEvent&& event) {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (!mThread.joinable()) {
+            mThread = std::thread(&FrameTracer::threadMain, this);
+        }
+        mQueue.push_back(std::move(event));
+    }
+    mQueueCondition.notify_one();
+}
+
+void FrameTracer::threadMain() {
+    std::vector<QueuedEvent> events;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mHandlingEvents = false;
+            mFlushCondition.notify_all();
+            mQueueCondition.wait(lock, [this] { return mDone || !mQueue.empty(); });
+            if (mQueue.empty()) {
                 return;
             }
+            events.swap(mQueue);
+            mHandlingEvents = true;
+        }
 
-            // Handle any pending fences for this buffer.
-            tracePendingFencesLocked(ctx, layerId, bufferID);
-
-            if (signalTime != Fence::SIGNAL_TIME_PENDING) {
-                traceSpanLocked(ctx, layerId, bufferID, frameNumber, type, startTime, signalTime);
-            } else {
-                mTraceTracker[layerId].pendingFences[bufferID].push_back(
-                        {.frameNumber = frameNumber,
-                         .type = type,
-                         .fence = fence,
-                         .startTime = startTime});
+        std::lock_guard<std::mutex> lock(mTraceMutex);
+        bool traced = false;
+        FrameTracerDataSource::Trace([&](FrameTracerDataSource::TraceContext ctx) {
+            traced = true;
+            for (const QueuedEvent& event : events) {
+                handleEventLocked(ctx, event);
+            }
+        });
+        if (!traced) {
+            // Tracing stopped since the events were queued; only the cleanup still matters.
+            for (const QueuedEvent& event : events) {
+                if (event.kind == QueuedEvent::Kind::Destroy) {
+                    mTraceTracker.erase(event.layerId);
+                }
             }
         }
-    });
+        events.clear();
+    }
+}
+
+void FrameTracer::handleEventLocked(FrameTracerDataSource::TraceContext& ctx,
+                                    const QueuedEvent& event) {
+    const int32_t layerId = event.layerId;
+    switch (event.kind) {
+        case QueuedEvent::Kind::NewLayer:
+            if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+                mTraceTracker[layerId].layerName = event.layerName;
+            }
+            return;
+        case QueuedEvent::Kind::Destroy:
+            mTraceTracker.erase(layerId);
+            return;
+        case QueuedEvent::Kind::Timestamp:
+        case QueuedEvent::Kind::Fence:
+            break;
+    }
+
+    nsecs_t signalTime = Fence::SIGNAL_TIME_INVALID;
+    if (event.kind == QueuedEvent::Kind::Fence) {
+        signalTime = event.fence->getSignalTime();
+        if (signalTime == Fence::SIGNAL_TIME_INVALID) {
+            return;
+        }
+    }
+
+    if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
+        return;
+    }
+
+    // Handle any pending fences for this buffer.
+    tracePendingFencesLocked(ctx, layerId, event.bufferID);
+
+    if (event.kind == QueuedEvent::Kind::Timestamp) {
+        // Complete current trace.
+        traceLocked(ctx, layerId, event.bufferID, event.frameNumber, event.timestamp, event.type,
+                    event.duration);
+        recordJourneyLocked(layerId, event.frameNumber, event.type, event.timestamp);
+    } else if (signalTime != Fence::SIGNAL_TIME_PENDING) {
+        traceSpanLocked(ctx, layerId, event.bufferID, event.frameNumber, event.type,
+                        event.timestamp, signalTime);
+    } else {
+        mTraceTracker[layerId].pendingFences[event.bufferID].push_back(
+                {.frameNumber = event.frameNumber,
+                 .type = event.type,
+                 .fence = event.fence,
+                 .startTime = event.timestamp});
+    }
 }
 
 void FrameTracer::tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx,
@@ -167,14 +261,95 @@ void FrameTracer::traceSpanLocked(FrameTracerDataSource::TraceContext& ctx, int3
         duration = endTime - startTime;
     }
     traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
+    recordJourneyLocked(layerId, frameNumber, type, endTime);
+}
+
+void FrameTracer::recordJourneyLocked(int32_t layerId, uint64_t frameNumber,
+                                      FrameEvent::BufferEventType type, nsecs_t time) {
+    auto recordIt = mTraceTracker.find(layerId);
+    if (recordIt == mTraceTracker.end() || frameNumber == UNSPECIFIED_FRAME_NUMBER) {
+        return;
+    }
+    TraceRecord& record = recordIt->second;
+
+    switch (type) {
+        case FrameEvent::QUEUE:
+            record.journeys[frameNumber].queueTime = time;
+            if (record.journeys.size() > kMaxPendingJourneys) {
+                record.journeys.erase(record.journeys.begin());
+            }
+            return;
+        case FrameEvent::ACQUIRE_FENCE: {
+            // Only frames whose queue was traced are tracked.
+            auto it = record.journeys.find(frameNumber);
+            if (it != record.journeys.end()) {
+                it->second.gpuDoneTime = time;
+            }
+            return;
+        }
+        case FrameEvent::LATCH: {
+            auto it = record.journeys.find(frameNumber);
+            if (it != record.journeys.end()) {
+                it->second.latchTime = time;
+            }
+            return;
+        }
+        case FrameEvent::PRESENT_FENCE:
+            break;
+        default:
+            return;
+    }
+
+    auto it = record.journeys.find(frameNumber);
+    if (it == record.journeys.end()) {
+        return;
+    }
+    const FrameJourney& journey = it->second;
+    if (journey.gpuDoneTime > 0 && journey.latchTime > 0) {
+        const nsecs_t gpuTime = std::max<nsecs_t>(journey.gpuDoneTime - journey.queueTime, 0);
+        const nsecs_t latchDelay = std::max<nsecs_t>(journey.latchTime - journey.gpuDoneTime, 0);
+        const nsecs_t compositionTime = std::max<nsecs_t>(time - journey.latchTime, 0);
+
+        JourneySummary& summary = record.journeySummary;
+        summary.frames++;
+        summary.totalGpuTime += gpuTime;
+        summary.maxGpuTime = std::max(summary.maxGpuTime, gpuTime);
+        summary.totalLatchDelay += latchDelay;
+        summary.maxLatchDelay = std::max(summary.maxLatchDelay, latchDelay);
+        summary.totalCompositionTime += compositionTime;
+        summary.maxCompositionTime = std::max(summary.maxCompositionTime, compositionTime);
+    }
+    // Earlier frames that are still pending were dropped.
+    record.journeys.erase(record.journeys.begin(), std::next(it));
 }
 
 void FrameTracer::onDestroy(int32_t layerId) {
-    std::lock_guard<std::mutex> traceLock(mTraceMutex);
-    mTraceTracker.erase(layerId);
+    // Queued even when not tracing, so that it is handled after the layer's earlier trace calls.
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    if (!mThread.joinable()) {
+        // Nothing was ever queued, so the tracker is only touched here.
+        std::lock_guard<std::mutex> traceLock(mTraceMutex);
+        mTraceTracker.erase(layerId);
+        return;
+    }
+    mQueue.push_back({.kind = QueuedEvent::Kind::Destroy, .layerId = layerId});
+    mQueueCondition.notify_one();
+}
+
+void FrameTracer::flush() {
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    mFlushCondition.wait(lock, [this] { return mQueue.empty() && !mHandlingEvents; });
+}
+
+FrameTracer::JourneySummary FrameTracer::getJourneySummary(int32_t layerId) {
+    flush();
+    std::lock_guard<std::mutex> lock(mTraceMutex);
+    auto it = mTraceTracker.find(layerId);
+    return it == mTraceTracker.end() ? JourneySummary{} : it->second.journeySummary;
 }
 
 std::string FrameTracer::miniDump() {
+    flush();
     std::string result = "FrameTracer miniDump:\n";
     std::lock_guard<std::mutex> lock(mTraceMutex);
     android::base::StringAppendF(&result, "Number of layers currently being traced is %zu\n",
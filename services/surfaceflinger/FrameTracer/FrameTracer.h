@@ -20,8 +20,13 @@
 #include <perfetto/tracing.h>
 #include <ui/FenceTime.h>
 
+#include <condition_variable>
+#include <map>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -37,7 +42,23 @@ public:
 
     using FrameEvent = perfetto::protos::pbzero::GraphicsFrameEvent;
 
-    ~FrameTracer() = default;
+    // Where the time of a layer's frames went, from the app queueing the buffer until it was
+    // presented. Only frames that had their QUEUE, ACQUIRE_FENCE, LATCH and PRESENT_FENCE events
+    // traced are counted; stages that overlap, e.g. when latching unsignaled buffers, count as 0.
+    struct JourneySummary {
+        uint64_t frames = 0;
+        // Queue until the acquire fence signalled, i.e. the app's GPU work.
+        nsecs_t totalGpuTime = 0;
+        nsecs_t maxGpuTime = 0;
+        // Acquire fence signal until latch, i.e. the frame was ready but waited for SurfaceFlinger.
+        nsecs_t totalLatchDelay = 0;
+        nsecs_t maxLatchDelay = 0;
+        // Latch until the present fence signalled, i.e. composition and scanout.
+        nsecs_t totalCompositionTime = 0;
+        nsecs_t maxCompositionTime = 0;
+    };
+
+    ~FrameTracer();
 
     // Sets up the perfetto tracing backend and data source.
     void initialize();
@@ -63,6 +84,13 @@ public:
     // Takes care of cleanup when a layer is destroyed.
     void onDestroy(int32_t layerId);
 
+    // Blocks until every trace call made so far has been handled by the tracing thread.
+    void flush();
+
+    // Returns the journey summary of a layer since it started being traced. Empty if the layer is
+    // not traced.
+    JourneySummary getJourneySummary(int32_t layerId);
+
     std::string miniDump();
 
     static constexpr char kFrameTracerDataSource[] = "android.surfaceflinger.frame";
@@ -72,6 +100,10 @@ public:
     // Public for testing.
     static constexpr nsecs_t kFenceSignallingDeadline = 60'000'000'000; // 60 seconds
 
+    // The maximum number of frames per layer whose journey is still being assembled. Older frames
+    // were dropped or never presented, and are discarded.
+    static constexpr size_t kMaxPendingJourneys = 32;
+
 private:
     struct PendingFence {
         uint64_t frameNumber;
@@ -80,12 +112,45 @@ private:
         nsecs_t startTime;
     };
 
+    // The times a frame reached each stage, 0 until it did.
+    struct FrameJourney {
+        nsecs_t queueTime = 0;
+        nsecs_t gpuDoneTime = 0;
+        nsecs_t latchTime = 0;
+    };
+
     struct TraceRecord {
         std::string layerName;
         using BufferID = uint64_t;
         std::unordered_map<BufferID, std::vector<PendingFence>> pendingFences;
+        using FrameNumber = uint64_t;
+        std::map<FrameNumber, FrameJourney> journeys;
+        JourneySummary journeySummary;
     };
 
+    // A trace call handed from the calling thread to the tracing thread. Fence signal times are
+    // only queried on the tracing thread.
+    struct QueuedEvent {
+        enum class Kind { NewLayer, Timestamp, Fence, Destroy };
+        Kind kind;
+        int32_t layerId;
+        std::string layerName;
+        uint64_t bufferID = 0;
+        uint64_t frameNumber = 0;
+        // The time of a Timestamp event, or the start time of a Fence event.
+        nsecs_t timestamp = 0;
+        FrameEvent::BufferEventType type = FrameEvent::UNSPECIFIED;
+        nsecs_t duration = 0;
+        std::shared_ptr<FenceTime> fence;
+    };
+
+    // Returns whether any tracing session has the data source enabled.
+    static bool isTracing();
+    // Queues an event for the tracing thread, starting the thread on first use.
+    void enqueue(QueuedEvent&& event);
+    void threadMain();
+    void handleEventLocked(FrameTracerDataSource::TraceContext& ctx, const QueuedEvent& event);
+
     // Checks if any pending fences for a layer and buffer have signalled and, if they have, creates
     // trace points for them.
     void tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
@@ -99,10 +164,24 @@ private:
     void traceLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId, uint64_t bufferID,
                      uint64_t frameNumber, nsecs_t timestamp, FrameEvent::BufferEventType type,
                      nsecs_t duration = 0);
+    // Adds a traced event to the journey of its frame, and folds the journey into the layer's
+    // summary once the frame is presented.
+    void recordJourneyLocked(int32_t layerId, uint64_t frameNumber,
+                             FrameEvent::BufferEventType type, nsecs_t time);
 
     std::mutex mTraceMutex;
     std::unordered_map<int32_t, TraceRecord> mTraceTracker;
     std::once_flag mInitializationFlag;
+
+    // Callers only hold mQueueMutex to append to mQueue. The tracing thread swaps the whole queue
+    // out and handles it under mTraceMutex, so the callers never wait on fences or packet writes.
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    std::condition_variable mFlushCondition;
+    std::vector<QueuedEvent> mQueue;
+    bool mHandlingEvents = false;
+    bool mDone = false;
+    std::thread mThread;
 };
 
 } // namespace android
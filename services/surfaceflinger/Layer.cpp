@@ -42,6 +42,7 @@
 #include <renderengine/RenderEngine.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <ui/DebugUtils.h>
 #include <ui/GraphicBuffer.h>
@@ -84,6 +85,7 @@ namespace android {
 using base::StringAppendF;
 
 std::atomic<int32_t> Layer::sSequence{1};
+std::atomic<uint64_t> Layer::sInheritedStateGeneration{1};
 
 Layer::Layer(const LayerCreationArgs& args)
       : mFlinger(args.flinger),
@@ -157,6 +159,9 @@ void Layer::onFirstRef() {
 }
 
 Layer::~Layer() {
+    // Children that still point at this layer now have no drawing parent.
+    invalidateInheritedState();
+
     sp<Client> c(mClientRef.promote());
     if (c != 0) {
         c->detachLayer(this);
@@ -851,7 +856,9 @@ void Layer::pushPendingState() {
 
 void Layer::popPendingState(State* stateToCommit) {
     ATRACE_CALL();
-    *stateToCommit = mPendingStates[0];
+    // The front state is removed right after, so it can give up its callbacks and references
+    // instead of copying them.
+    *stateToCommit = std::move(mPendingStates.editItemAt(0));
 
     mPendingStates.removeAt(0);
     ATRACE_INT(mTransactionName.c_str(), mPendingStates.size());
@@ -1008,7 +1015,10 @@ uint32_t Layer::doTransaction(uint32_t flags) {
     }
 
     pushPendingState();
-    State c = getCurrentState();
+    // Every pending state is a full copy of the current state, so the state to commit is only
+    // valid once applyPendingStates has popped one into it. Starting from a copy of the current
+    // state would only be overwritten.
+    State c;
     if (!applyPendingStates(&c)) {
         return flags;
     }
@@ -1038,15 +1048,16 @@ uint32_t Layer::doTransaction(uint32_t flags) {
     }
 
     // Commit the transaction
-    commitTransaction(c);
+    commitTransaction(std::move(c));
     mPendingStatesSnapshot = mPendingStates;
     mCurrentState.callbackHandles = {};
 
     return flags;
 }
 
-void Layer::commitTransaction(const State& stateToCommit) {
-    mDrawingState = stateToCommit;
+void Layer::commitTransaction(State stateToCommit) {
+    mDrawingState = std::move(stateToCommit);
+    invalidateInheritedState();
 }
 
 uint32_t Layer::getTransactionFlags(uint32_t flags) {
@@ -1054,7 +1065,11 @@ uint32_t Layer::getTransactionFlags(uint32_t flags) {
 }
 
 uint32_t Layer::setTransactionFlags(uint32_t flags) {
-    return mTransactionFlags.fetch_or(flags);
+    const uint32_t oldFlags = mTransactionFlags.fetch_or(flags);
+    if ((flags & eTransactionNeeded) && !(oldFlags & eTransactionNeeded)) {
+        mFlinger->onLayerTransactionNeeded(this);
+    }
+    return oldFlags;
 }
 
 bool Layer::setPosition(float x, float y) {
@@ -1507,20 +1522,44 @@ void Layer::deferTransactionUntil_legacy(const sp<IBinder>& barrierHandle, uint6
 // ----------------------------------------------------------------------------
 
 bool Layer::isHiddenByPolicy() const {
+    return getInheritedState().hiddenByPolicy;
+}
+
+Layer::InheritedState Layer::getInheritedState() const {
+    static_assert(sizeof(half) == sizeof(uint16_t));
+    constexpr uint64_t kHiddenBit = 1ull << 16;
+    constexpr int kGenerationShift = 17;
+
+    const uint64_t generation = sInheritedStateGeneration.load(std::memory_order_relaxed);
+    const uint64_t cached = mInheritedStateCache.load(std::memory_order_relaxed);
+    if ((cached >> kGenerationShift) == generation) {
+        InheritedState state{0.0_hf, (cached & kHiddenBit) != 0};
+        const uint16_t alphaBits = static_cast<uint16_t>(cached);
+        memcpy(&state.alpha, &alphaBits, sizeof(alphaBits));
+        return state;
+    }
+
     const State& s(mDrawingState);
     const auto& parent = mDrawingParent.promote();
-    if (parent != nullptr && parent->isHiddenByPolicy()) {
-        return true;
-    }
-    if (usingRelativeZ(LayerVector::StateSet::Drawing)) {
+    const InheritedState parentState =
+            parent != nullptr ? parent->getInheritedState() : InheritedState{1.0_hf, false};
+
+    InheritedState state{parentState.alpha * s.color.a, parentState.hiddenByPolicy};
+    if (!state.hiddenByPolicy && usingRelativeZ(LayerVector::StateSet::Drawing)) {
         auto zOrderRelativeOf = mDrawingState.zOrderRelativeOf.promote();
         if (zOrderRelativeOf != nullptr) {
-            if (zOrderRelativeOf->isHiddenByPolicy()) {
-                return true;
-            }
+            state.hiddenByPolicy = zOrderRelativeOf->isHiddenByPolicy();
         }
     }
-    return s.flags & layer_state_t::eLayerHidden;
+    if (!state.hiddenByPolicy) {
+        state.hiddenByPolicy = s.flags & layer_state_t::eLayerHidden;
+    }
+
+    const uint16_t alphaBits = state.alpha.getBits();
+    mInheritedStateCache.store((generation << kGenerationShift) |
+                                       (state.hiddenByPolicy ? kHiddenBit : 0) | alphaBits,
+                               std::memory_order_relaxed);
+    return state;
 }
 
 uint32_t Layer::getEffectiveUsage(uint32_t usage) const {
@@ -1838,6 +1877,7 @@ void Layer::setChildrenDrawingParent(const sp<Layer>& newParent) {
                              newParent->getTransformWithScale(newParent->getBufferScaleTransform()),
                              newParent->mEffectiveShadowRadius);
     }
+    invalidateInheritedState();
 }
 
 bool Layer::reparent(const sp<IBinder>& newParentHandle) {
@@ -2168,10 +2208,7 @@ ui::Transform Layer::getTransform() const {
 }
 
 half Layer::getAlpha() const {
-    const auto& p = mDrawingParent.promote();
-
-    half parentAlpha = (p != nullptr) ? p->getAlpha() : 1.0_hf;
-    return parentAlpha * getDrawingState().color.a;
+    return getInheritedState().alpha;
 }
 
 ui::Transform::RotationFlags Layer::getFixedTransformHint() const {
@@ -2236,6 +2273,7 @@ void Layer::commitChildList() {
     }
     mDrawingChildren = mCurrentChildren;
     mDrawingParent = mCurrentParent;
+    invalidateInheritedState();
 }
 
 static wp<Layer> extractLayerFromBinder(const wp<IBinder>& weakBinderHandle) {
@@ -2548,6 +2586,7 @@ void Layer::setInitialValuesForClone(const sp<Layer>& clonedFrom) {
     // copy drawing state from cloned layer
     mDrawingState = clonedFrom->mDrawingState;
     mClonedFrom = clonedFrom;
+    invalidateInheritedState();
 }
 
 void Layer::updateMirrorInfo() {
@@ -2583,6 +2622,7 @@ void Layer::updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayer
         sp<Layer> clonedFrom = getClonedFrom();
         mDrawingState = clonedFrom->mDrawingState;
         clonedLayersMap.emplace(clonedFrom, this);
+        invalidateInheritedState();
     }
 
     // The clone layer may have children in drawingState since they may have been created and
@@ -2596,15 +2636,38 @@ void Layer::updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayer
     }
 }
 
+bool Layer::hasClonesOfChildren(const sp<Layer>& clonedFrom, const sp<Layer>& mirrorRoot) {
+    size_t i = 0;
+    for (const sp<Layer>& child : clonedFrom->mDrawingChildren) {
+        if (child == mirrorRoot) {
+            continue;
+        }
+        if (i == mDrawingChildren.size() || mDrawingChildren[i]->getClonedFrom() != child) {
+            return false;
+        }
+        i++;
+    }
+    return i == mDrawingChildren.size();
+}
+
 void Layer::updateClonedChildren(const sp<Layer>& mirrorRoot,
                                  std::map<sp<Layer>, sp<Layer>>& clonedLayersMap) {
-    mDrawingChildren.clear();
-
     if (!isClonedFromAlive()) {
+        mDrawingChildren.clear();
         return;
     }
 
+    // The hierarchy rarely changes between commits, so keep the cloned children as long as they
+    // still match the real ones, in the same order, and only descend into them.
     sp<Layer> clonedFrom = getClonedFrom();
+    if (hasClonesOfChildren(clonedFrom, mirrorRoot)) {
+        for (const sp<Layer>& clonedChild : mDrawingChildren) {
+            clonedChild->updateClonedChildren(mirrorRoot, clonedLayersMap);
+        }
+        return;
+    }
+
+    mDrawingChildren.clear();
     for (sp<Layer>& child : clonedFrom->mDrawingChildren) {
         if (child == mirrorRoot) {
             // This is to avoid cyclical mirroring.
@@ -2640,6 +2703,7 @@ void Layer::updateClonedInputInfo(const std::map<sp<Layer>, sp<Layer>>& clonedLa
 void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLayersMap) {
     mDrawingState.zOrderRelativeOf = nullptr;
     mDrawingState.zOrderRelatives.clear();
+    invalidateInheritedState();
 
     if (!isClonedFromAlive()) {
         return;
@@ -2663,6 +2727,7 @@ void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLa
     if (clonedLayersMap.count(relativeOf) > 0) {
         const sp<Layer>& clonedRelativeOf = clonedLayersMap.at(relativeOf);
         mDrawingState.zOrderRelativeOf = clonedRelativeOf;
+        invalidateInheritedState();
     }
 
     updateClonedInputInfo(clonedLayersMap);
@@ -2675,6 +2740,7 @@ void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLa
 void Layer::addChildToDrawing(const sp<Layer>& layer) {
     mDrawingChildren.add(layer);
     layer->mDrawingParent = this;
+    invalidateInheritedState();
 }
 
 Layer::FrameRateCompatibility Layer::FrameRate::convertCompatibility(int8_t compatibility) {
@@ -35,6 +35,7 @@
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 
+#include <atomic>
 #include <cstdint>
 #include <list>
 #include <optional>
@@ -94,6 +95,9 @@ struct LayerCreationArgs {
 
 class Layer : public virtual RefBase, compositionengine::LayerFE {
     static std::atomic<int32_t> sSequence;
+    // Bumped whenever a drawing state or a drawing parent changes, which invalidates the inherited
+    // state cached by every layer.
+    static std::atomic<uint64_t> sInheritedStateGeneration;
     // The following constants represent priority of the window. SF uses this information when
     // deciding which window has a priority when deciding about the refresh rate of the screen.
     // Priority 0 is considered the highest priority. -1 means that the priority is unset.
@@ -593,6 +597,9 @@ protected:
     void updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayersMap);
     void updateClonedChildren(const sp<Layer>& mirrorRoot,
                               std::map<sp<Layer>, sp<Layer>>& clonedLayersMap);
+    // Returns whether the drawing children of this clone are clones of the drawing children of
+    // clonedFrom, in the same order.
+    bool hasClonesOfChildren(const sp<Layer>& clonedFrom, const sp<Layer>& mirrorRoot);
     void updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLayersMap);
     void addChildToDrawing(const sp<Layer>& layer);
     void updateClonedInputInfo(const std::map<sp<Layer>, sp<Layer>>& clonedLayersMap);
@@ -870,7 +877,13 @@ protected:
     friend class RefreshRateSelectionTest;
     friend class SetFrameRateTest;
 
-    virtual void commitTransaction(const State& stateToCommit);
+    // Takes the state by value so that doTransaction can move the state it built into
+    // mDrawingState instead of copying every region, callback and reference again.
+    virtual void commitTransaction(State stateToCommit);
+
+    // Must be called after changing a drawing state or a drawing parent outside of
+    // commitTransaction, so that getAlpha and isHiddenByPolicy do not return stale values.
+    static void invalidateInheritedState() { sInheritedStateGeneration++; }
 
     uint32_t getEffectiveUsage(uint32_t usage) const;
 
@@ -1089,6 +1102,18 @@ private:
 
     void setZOrderRelativeOf(const wp<Layer>& relativeOf);
 
+    // State inherited from the drawing parents. getAlpha and isHiddenByPolicy are called several
+    // times per layer and per frame, and each call used to walk up to the root.
+    struct InheritedState {
+        half alpha;
+        bool hiddenByPolicy;
+    };
+    InheritedState getInheritedState() const;
+
+    // The InheritedState packed with the generation it was computed for, so that it can be read
+    // and updated from the tracing thread as well as the main thread.
+    mutable std::atomic<uint64_t> mInheritedStateCache{0};
+
     bool mGetHandleCalled = false;
 
     void removeRemoteSyncPoints();
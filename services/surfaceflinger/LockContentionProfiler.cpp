@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockContentionProfiler.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+namespace android {
+
+using base::StringAppendF;
+
+namespace {
+
+double toMs(nsecs_t duration) {
+    return static_cast<double>(duration) / 1e6;
+}
+
+} // namespace
+
+void LockContentionProfiler::recordWait(const char* function, int line, nsecs_t wait) {
+    std::lock_guard lock(mMutex);
+    SiteStats& stats = mSites[{function, line}];
+    stats.count++;
+    stats.totalWait += wait;
+    stats.maxWait = std::max(stats.maxWait, wait);
+}
+
+void LockContentionProfiler::clear() {
+    std::lock_guard lock(mMutex);
+    mSites.clear();
+    mUncontended.store(0, std::memory_order_relaxed);
+}
+
+void LockContentionProfiler::dump(std::string& result) const {
+    std::vector<std::pair<std::string, SiteStats>> sites;
+    {
+        std::lock_guard lock(mMutex);
+        for (const auto& [site, stats] : mSites) {
+            sites.emplace_back(std::string(site.first) + ":" + std::to_string(site.second), stats);
+        }
+    }
+    std::sort(sites.begin(), sites.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.totalWait > rhs.second.totalWait;
+    });
+
+    uint64_t contended = 0;
+    for (const auto& [name, stats] : sites) {
+        contended += stats.count;
+    }
+
+    StringAppendF(&result, "%s (%s): %" PRIu64 " uncontended, %" PRIu64 " contended acquisitions\n",
+                  mLockName, isEnabled() ? "enabled" : "disabled",
+                  mUncontended.load(std::memory_order_relaxed), contended);
+    if (sites.empty()) {
+        return;
+    }
+
+    StringAppendF(&result, "  %-48s %9s %11s %9s %9s\n", "call site", "count", "total ms",
+                  "avg ms", "max ms");
+    for (const auto& [name, stats] : sites) {
+        StringAppendF(&result, "  %-48s %9" PRIu64 " %11.3f %9.3f %9.3f\n", name.c_str(),
+                      stats.count, toMs(stats.totalWait),
+                      toMs(stats.totalWait) / static_cast<double>(stats.count),
+                      toMs(stats.maxWait));
+    }
+}
+
+} // namespace android
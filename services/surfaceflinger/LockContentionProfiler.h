@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace android {
+
+// LockContentionProfiler records, for one lock, how long each call site waited
+// to acquire it. Uncontended acquisitions are only counted, so the cost of
+// profiling is a tryLock() and an atomic increment unless the caller would
+// have blocked anyway.
+class LockContentionProfiler {
+public:
+    explicit LockContentionProfiler(const char* lockName) : mLockName(lockName) {}
+
+    void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    void recordUncontended() { mUncontended.fetch_add(1, std::memory_order_relaxed); }
+    // Records that |function| at |line| waited |wait| for the lock.
+    void recordWait(const char* function, int line, nsecs_t wait);
+
+    void clear();
+    // Lists the call sites that waited for the lock, longest total wait first.
+    void dump(std::string& result) const;
+
+private:
+    struct SiteStats {
+        uint64_t count = 0;
+        nsecs_t totalWait = 0;
+        nsecs_t maxWait = 0;
+    };
+
+    const char* const mLockName;
+    std::atomic<bool> mEnabled{true};
+    std::atomic<uint64_t> mUncontended{0};
+
+    mutable std::mutex mMutex;
+    // Call sites are identified by the address of their function name literal and their line.
+    std::map<std::pair<const char*, int>, SiteStats> mSites GUARDED_BY(mMutex);
+};
+
+// Acquires |mutex| for the lifetime of the object, reporting any wait for it
+// to |profiler| under the given call site.
+class SCOPED_CAPABILITY ProfiledLock {
+public:
+    ProfiledLock(Mutex& mutex, LockContentionProfiler& profiler, const char* function, int line)
+          ACQUIRE(mutex)
+          : mMutex(mutex) {
+        if (!profiler.isEnabled()) {
+            mMutex.lock();
+        } else if (mMutex.tryLock() == NO_ERROR) {
+            profiler.recordUncontended();
+        } else {
+            const nsecs_t start = systemTime();
+            mMutex.lock();
+            profiler.recordWait(function, line, systemTime() - start);
+        }
+    }
+
+    ~ProfiledLock() RELEASE() { mMutex.unlock(); }
+
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+private:
+    Mutex& mMutex;
+};
+
+} // namespace android
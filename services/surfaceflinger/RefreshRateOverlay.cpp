@@ -51,11 +51,11 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawRect(const Rect& r, const half4
     }
 }
 
-void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int left,
+void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int left, int top,
                                                          const half4& color,
                                                          const sp<GraphicBuffer>& buffer,
                                                          uint8_t* pixels) {
-    const Rect rect = [&]() {
+    Rect rect = [&]() {
         switch (segment) {
             case Segment::Upper:
                 return Rect(left, 0, left + DIGIT_WIDTH, DIGIT_SPACE);
@@ -77,66 +77,57 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int le
         }
     }();
 
-    drawRect(rect, color, buffer, pixels);
+    drawRect(rect.offsetBy(0, top), color, buffer, pixels);
 }
 
-void RefreshRateOverlay::SevenSegmentDrawer::drawDigit(int digit, int left, const half4& color,
+void RefreshRateOverlay::SevenSegmentDrawer::drawDigit(int digit, int left, int top,
+                                                       const half4& color,
                                                        const sp<GraphicBuffer>& buffer,
                                                        uint8_t* pixels) {
     if (digit < 0 || digit > 9) return;
 
     if (digit == 0 || digit == 2 || digit == 3 || digit == 5 || digit == 6 || digit == 7 ||
         digit == 8 || digit == 9)
-        drawSegment(Segment::Upper, left, color, buffer, pixels);
+        drawSegment(Segment::Upper, left, top, color, buffer, pixels);
     if (digit == 0 || digit == 4 || digit == 5 || digit == 6 || digit == 8 || digit == 9)
-        drawSegment(Segment::UpperLeft, left, color, buffer, pixels);
+        drawSegment(Segment::UpperLeft, left, top, color, buffer, pixels);
     if (digit == 0 || digit == 1 || digit == 2 || digit == 3 || digit == 4 || digit == 7 ||
         digit == 8 || digit == 9)
-        drawSegment(Segment::UpperRight, left, color, buffer, pixels);
+        drawSegment(Segment::UpperRight, left, top, color, buffer, pixels);
     if (digit == 2 || digit == 3 || digit == 4 || digit == 5 || digit == 6 || digit == 8 ||
         digit == 9)
-        drawSegment(Segment::Middle, left, color, buffer, pixels);
+        drawSegment(Segment::Middle, left, top, color, buffer, pixels);
     if (digit == 0 || digit == 2 || digit == 6 || digit == 8)
-        drawSegment(Segment::LowerLeft, left, color, buffer, pixels);
+        drawSegment(Segment::LowerLeft, left, top, color, buffer, pixels);
     if (digit == 0 || digit == 1 || digit == 3 || digit == 4 || digit == 5 || digit == 6 ||
         digit == 7 || digit == 8 || digit == 9)
-        drawSegment(Segment::LowerRight, left, color, buffer, pixels);
+        drawSegment(Segment::LowerRight, left, top, color, buffer, pixels);
     if (digit == 0 || digit == 2 || digit == 3 || digit == 5 || digit == 6 || digit == 8 ||
         digit == 9)
-        drawSegment(Segment::Buttom, left, color, buffer, pixels);
+        drawSegment(Segment::Buttom, left, top, color, buffer, pixels);
 }
 
-sp<GraphicBuffer> RefreshRateOverlay::SevenSegmentDrawer::drawNumber(int number,
-                                                                     const half4& color) {
-    if (number < 0 || number > 1000) return nullptr;
+void RefreshRateOverlay::SevenSegmentDrawer::drawNumber(int number, const half4& color, int top,
+                                                        const sp<GraphicBuffer>& buffer,
+                                                        uint8_t* pixels) {
+    if (number < 0 || number > 1000) return;
 
     const auto hundreds = number / 100;
     const auto tens = (number / 10) % 10;
     const auto ones = number % 10;
 
-    sp<GraphicBuffer> buffer =
-            new GraphicBuffer(BUFFER_WIDTH, BUFFER_HEIGHT, HAL_PIXEL_FORMAT_RGBA_8888, 1,
-                              GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
-                                      GRALLOC_USAGE_HW_TEXTURE,
-                              "RefreshRateOverlayBuffer");
-    uint8_t* pixels;
-    buffer->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels));
-    // Clear buffer content
-    drawRect(Rect(BUFFER_WIDTH, BUFFER_HEIGHT), half4(0), buffer, pixels);
     int left = 0;
     if (hundreds != 0) {
-        drawDigit(hundreds, left, color, buffer, pixels);
+        drawDigit(hundreds, left, top, color, buffer, pixels);
         left += DIGIT_WIDTH + DIGIT_SPACE;
     }
 
     if (tens != 0) {
-        drawDigit(tens, left, color, buffer, pixels);
+        drawDigit(tens, left, top, color, buffer, pixels);
         left += DIGIT_WIDTH + DIGIT_SPACE;
     }
 
-    drawDigit(ones, left, color, buffer, pixels);
-    buffer->unlock();
-    return buffer;
+    drawDigit(ones, left, top, color, buffer, pixels);
 }
 
 RefreshRateOverlay::RefreshRateOverlay(SurfaceFlinger& flinger)
@@ -173,31 +164,55 @@ bool RefreshRateOverlay::createLayer() {
 
 void RefreshRateOverlay::primeCache() {
     auto& allRefreshRates = mFlinger.mRefreshRateConfigs->getAllRefreshRates();
-    if (allRefreshRates.size() == 1) {
-        auto fps = allRefreshRates.begin()->second->getFps();
-        half4 color = {LOW_FPS_COLOR, ALPHA};
-        mBufferCache.emplace(fps, SevenSegmentDrawer::drawNumber(fps, color));
-        return;
-    }
 
-    std::vector<uint32_t> supportedFps;
+    std::vector<int> supportedFps;
     supportedFps.reserve(allRefreshRates.size());
     for (auto& [ignored, refreshRate] : allRefreshRates) {
         supportedFps.push_back(refreshRate->getFps());
     }
 
     std::sort(supportedFps.begin(), supportedFps.end());
-    const auto mLowFps = supportedFps[0];
-    const auto mHighFps = supportedFps[supportedFps.size() - 1];
-    for (auto fps : supportedFps) {
-        const auto fpsScale = float(fps - mLowFps) / (mHighFps - mLowFps);
+    supportedFps.erase(std::unique(supportedFps.begin(), supportedFps.end()), supportedFps.end());
+
+    const uint32_t rowHeight = SevenSegmentDrawer::getHeight();
+    mAtlas = new GraphicBuffer(SevenSegmentDrawer::getWidth(), rowHeight * supportedFps.size(),
+                               HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                               GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
+                                       GRALLOC_USAGE_HW_TEXTURE,
+                               "RefreshRateOverlayAtlas");
+    uint8_t* pixels;
+    if (mAtlas->initCheck() != NO_ERROR ||
+        mAtlas->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels)) !=
+                NO_ERROR) {
+        ALOGE("failed to draw the refresh rate atlas");
+        mAtlas = nullptr;
+        return;
+    }
+
+    // Clear buffer content
+    const Rect bounds = mAtlas->getBounds();
+    for (int32_t j = 0; j < bounds.bottom; j++) {
+        memset(pixels + 4 * mAtlas->getStride() * j, 0, 4 * bounds.right);
+    }
+
+    const auto lowFps = supportedFps.front();
+    const auto highFps = supportedFps.back();
+    for (size_t i = 0; i < supportedFps.size(); i++) {
+        const auto fps = supportedFps[i];
+        const auto fpsScale = lowFps == highFps ? 0.0f : float(fps - lowFps) / (highFps - lowFps);
         half4 color;
         color.r = HIGH_FPS_COLOR.r * fpsScale + LOW_FPS_COLOR.r * (1 - fpsScale);
         color.g = HIGH_FPS_COLOR.g * fpsScale + LOW_FPS_COLOR.g * (1 - fpsScale);
         color.b = HIGH_FPS_COLOR.b * fpsScale + LOW_FPS_COLOR.b * (1 - fpsScale);
         color.a = ALPHA;
-        mBufferCache.emplace(fps, SevenSegmentDrawer::drawNumber(fps, color));
+
+        const int top = rowHeight * i;
+        SevenSegmentDrawer::drawNumber(fps, color, top, mAtlas, pixels);
+        mAtlasCrops.emplace(fps, Rect(0, top, bounds.right, top + rowHeight));
     }
+    mAtlas->unlock();
+
+    mLayer->setBuffer(mAtlas, Fence::NO_FENCE, 0, 0, {});
 }
 
 void RefreshRateOverlay::setViewport(ui::Size viewport) {
@@ -209,8 +224,8 @@ void RefreshRateOverlay::setViewport(ui::Size viewport) {
 }
 
 void RefreshRateOverlay::changeRefreshRate(const RefreshRate& refreshRate) {
-    auto buffer = mBufferCache[refreshRate.getFps()];
-    mLayer->setBuffer(buffer, Fence::NO_FENCE, 0, 0, {});
+    const auto crop = mAtlasCrops.find(refreshRate.getFps());
+    if (crop == mAtlasCrops.end() || !mLayer->setCrop(crop->second)) return;
 
     mFlinger.mTransactionFlags.fetch_or(eTransactionMask);
 }
@@ -46,7 +46,9 @@ public:
 private:
     class SevenSegmentDrawer {
     public:
-        static sp<GraphicBuffer> drawNumber(int number, const half4& color);
+        // Draws |number| into the row of |buffer| that starts at |top|.
+        static void drawNumber(int number, const half4& color, int top,
+                               const sp<GraphicBuffer>& buffer, uint8_t* pixels);
         static uint32_t getHeight() { return BUFFER_HEIGHT; }
         static uint32_t getWidth() { return BUFFER_WIDTH; }
 
@@ -55,9 +57,9 @@ private:
 
         static void drawRect(const Rect& r, const half4& color, const sp<GraphicBuffer>& buffer,
                              uint8_t* pixels);
-        static void drawSegment(Segment segment, int left, const half4& color,
+        static void drawSegment(Segment segment, int left, int top, const half4& color,
                                 const sp<GraphicBuffer>& buffer, uint8_t* pixels);
-        static void drawDigit(int digit, int left, const half4& color,
+        static void drawDigit(int digit, int left, int top, const half4& color,
                               const sp<GraphicBuffer>& buffer, uint8_t* pixels);
 
         static constexpr uint32_t DIGIT_HEIGHT = 100;
@@ -77,7 +79,11 @@ private:
     sp<IBinder> mIBinder;
     sp<IGraphicBufferProducer> mGbp;
 
-    std::unordered_map<int, sp<GraphicBuffer>> mBufferCache;
+    // Every refresh rate is drawn once into its own row of the atlas, and the
+    // layer crop selects the row to show. Changing the refresh rate then only
+    // changes the source crop of the HWC layer, not its buffer.
+    sp<GraphicBuffer> mAtlas;
+    std::unordered_map<int, Rect> mAtlasCrops;
 
     static constexpr float ALPHA = 0.8f;
     const half3 LOW_FPS_COLOR = half3(1.0f, 0.0f, 0.0f);
@@ -32,6 +32,7 @@
 #include <ui/DisplayStatInfo.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <string>
 
 #include "DisplayDevice.h"
@@ -62,6 +63,7 @@ constexpr auto maxRegionSamplingSkips = 10;
 constexpr auto defaultRegionSamplingOffset = -3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
+constexpr int32_t defaultRegionSamplingDownscale = 2;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -168,6 +170,9 @@ RegionSamplingThread::RegionSamplingThread(SurfaceFlinger& flinger, Scheduler& s
       : mFlinger(flinger),
         mScheduler(scheduler),
         mTunables(tunables),
+        mDownscale(std::max(property_get_int32("debug.sf.region_sampling_downscale",
+                                               defaultRegionSamplingDownscale),
+                            1)),
         mIdleTimer(std::chrono::duration_cast<std::chrono::milliseconds>(
                            mTunables.mSamplingTimerTimeout),
                    [] {}, [this] { checkForStaleLuma(); }),
@@ -307,9 +312,17 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return accumulatedLuma / (255.0f * pixelCount);
 }
 
+Rect scaleSampleArea(const Rect& area, int32_t downscale) {
+    if (downscale <= 1) return area;
+    return Rect(area.left / downscale, area.top / downscale,
+                (area.right + downscale - 1) / downscale,
+                (area.bottom + downscale - 1) / downscale);
+}
+
 std::vector<float> RegionSamplingThread::sampleBuffer(
         const sp<GraphicBuffer>& buffer, const Point& leftTop,
-        const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
+        const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation,
+        int32_t downscale) {
     void* data_raw = nullptr;
     buffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &data_raw);
     std::shared_ptr<uint32_t> data(reinterpret_cast<uint32_t*>(data_raw),
@@ -323,7 +336,7 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
                    [&](auto const& descriptor) {
                        return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
+                                         scaleSampleArea(descriptor.area - leftTop, downscale));
                    });
     return lumas;
 }
@@ -347,6 +360,11 @@ void RegionSamplingThread::captureSample() {
     }
 
     const Rect sampledArea = sampleRegion.bounds();
+    // All listeners share a single capture of the union of their areas, which the GPU renders
+    // downscaled so that the CPU only has to read back and sum a fraction of the pixels.
+    const Rect captureBounds = scaleSampleArea(Rect(sampledArea.getWidth(),
+                                                    sampledArea.getHeight()),
+                                               mDownscale);
 
     auto dx = 0;
     auto dy = 0;
@@ -368,8 +386,8 @@ void RegionSamplingThread::captureSample() {
     ui::Transform t(orientation);
     auto screencapRegion = t.transform(sampleRegion);
     screencapRegion = screencapRegion.translate(dx, dy);
-    DisplayRenderArea renderArea(device, screencapRegion.bounds(), sampledArea.getWidth(),
-                                 sampledArea.getHeight(), ui::Dataspace::V0_SRGB, orientation);
+    DisplayRenderArea renderArea(device, screencapRegion.bounds(), captureBounds.getWidth(),
+                                 captureBounds.getHeight(), ui::Dataspace::V0_SRGB, orientation);
 
     std::unordered_set<sp<IRegionSamplingListener>, SpHash<IRegionSamplingListener>> listeners;
 
@@ -415,12 +433,12 @@ void RegionSamplingThread::captureSample() {
     };
 
     sp<GraphicBuffer> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getWidth() == sampledArea.getWidth() &&
-        mCachedBuffer->getHeight() == sampledArea.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getWidth() == captureBounds.getWidth() &&
+        mCachedBuffer->getHeight() == captureBounds.getHeight()) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER;
-        buffer = new GraphicBuffer(sampledArea.getWidth(), sampledArea.getHeight(),
+        buffer = new GraphicBuffer(captureBounds.getWidth(), captureBounds.getHeight(),
                                    PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
     }
 
@@ -437,7 +455,7 @@ void RegionSamplingThread::captureSample() {
 
     ALOGV("Sampling %zu descriptors", activeDescriptors.size());
     std::vector<float> lumas =
-            sampleBuffer(buffer, sampledArea.leftTop(), activeDescriptors, orientation);
+            sampleBuffer(buffer, sampledArea.leftTop(), activeDescriptors, orientation, mDownscale);
     if (lumas.size() != activeDescriptors.size()) {
         ALOGW("collected %zu median luma values for %zu descriptors", lumas.size(),
               activeDescriptors.size());
@@ -39,6 +39,9 @@ struct SamplingOffsetCallback;
 
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
+// Maps a sampling area onto a capture that was downscaled by |downscale| in each dimension,
+// rounding outwards so that the area never collapses.
+Rect scaleSampleArea(const Rect& area, int32_t downscale);
 
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
@@ -95,7 +98,8 @@ private:
     };
     std::vector<float> sampleBuffer(
             const sp<GraphicBuffer>& buffer, const Point& leftTop,
-            const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation);
+            const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation,
+            int32_t downscale);
 
     void doSample();
     void binderDied(const wp<IBinder>& who) override;
@@ -107,6 +111,10 @@ private:
     SurfaceFlinger& mFlinger;
     Scheduler& mScheduler;
     const TimingTunables mTunables;
+    // debug.sf.region_sampling_downscale
+    // Factor by which the sampled region is downscaled on the GPU before the luma is computed on
+    // the CPU. At 2, the linear filter averages each 2x2 block exactly.
+    const int32_t mDownscale;
     scheduler::OneShotTimer mIdleTimer;
 
     std::unique_ptr<SamplingOffsetCallback> const mPhaseCallback;
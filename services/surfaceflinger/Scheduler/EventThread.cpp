@@ -23,16 +23,23 @@
 #include <dlfcn.h>
 #include <pthread.h>
 #include <sched.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 
 #include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include <optional>
 #include <type_traits>
 
 #include <android-base/stringprintf.h>
 
+#include <binder/IPCThreadState.h>
+
+#include <cutils/ashmem.h>
 #include <cutils/compiler.h>
+#include <cutils/properties.h>
 #include <cutils/sched_policy.h>
 
 #include <gui/DisplayEventReceiver.h>
@@ -68,8 +75,9 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
-    return StringPrintf("Connection{%p, %s}", &connection,
-                        toString(connection.vsyncRequest).c_str());
+    return StringPrintf("Connection{%p, uid=%d, %s%s}", &connection, connection.mOwnerUid,
+                        toString(connection.vsyncRequest).c_str(),
+                        connection.timestampOnly ? ", timestampOnly" : "");
 }
 
 std::string toString(const DisplayEventReceiver::Event& event) {
@@ -120,13 +128,15 @@ DisplayEventReceiver::Event makeConfigChanged(PhysicalDisplayId displayId,
 
 } // namespace
 
-EventThreadConnection::EventThreadConnection(EventThread* eventThread,
+EventThreadConnection::EventThreadConnection(EventThread* eventThread, uid_t callingUid,
                                              ResyncCallback resyncCallback,
-                                             ISurfaceComposer::ConfigChanged configChanged)
+                                             ISurfaceComposer::ConfigChanged configChanged,
+                                             gui::BitTube::Type channelType)
       : resyncCallback(std::move(resyncCallback)),
         mConfigChanged(configChanged),
+        mOwnerUid(callingUid),
         mEventThread(eventThread),
-        mChannel(gui::BitTube(8 * 1024 /* default size is 4KB, double it */)) {}
+        mChannel(gui::BitTube(channelType, 8 * 1024 /* default size is 4KB, double it */)) {}
 
 EventThreadConnection::~EventThreadConnection() {
     // do nothing here -- clean-up will happen automatically
@@ -139,9 +149,7 @@ void EventThreadConnection::onFirstRef() {
 }
 
 status_t EventThreadConnection::stealReceiveChannel(gui::BitTube* outChannel) {
-    outChannel->setReceiveFd(mChannel.moveReceiveFd());
-    outChannel->setSendFd(base::unique_fd(dup(mChannel.getSendFd())));
-    return NO_ERROR;
+    return mChannel.moveReceiveEnd(outChannel);
 }
 
 status_t EventThreadConnection::setVsyncRate(uint32_t rate) {
@@ -154,6 +162,15 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::getVsyncTimestamps(sp<NativeHandle>* outHandle) {
+    return mEventThread->getVsyncTimestamps(outHandle);
+}
+
+status_t EventThreadConnection::setTimestampOnly(bool timestampOnly) {
+    mEventThread->setTimestampOnly(timestampOnly, this);
+    return NO_ERROR;
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     ssize_t size = DisplayEventReceiver::sendEvents(&mChannel, &event, 1);
     return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -169,7 +186,10 @@ EventThread::EventThread(std::unique_ptr<VSyncSource> vsyncSource,
                          InterceptVSyncsCallback interceptVSyncsCallback)
       : mVSyncSource(std::move(vsyncSource)),
         mInterceptVSyncsCallback(std::move(interceptVSyncsCallback)),
-        mThreadName(mVSyncSource->getName()) {
+        mThreadName(mVSyncSource->getName()),
+        mChannelType(property_get_bool("debug.sf.shared_ring_event_channels", false)
+                             ? gui::BitTube::Type::SharedRing
+                             : gui::BitTube::Type::Socket) {
     mVSyncSource->setCallback(this);
 
     mThread = std::thread([this]() NO_THREAD_SAFETY_ANALYSIS {
@@ -211,6 +231,10 @@ EventThread::~EventThread() {
         mCondition.notify_all();
     }
     mThread.join();
+
+    if (mVsyncTimestamps) {
+        munmap(mVsyncTimestamps, sizeof(gui::VsyncTimestamps));
+    }
 }
 
 void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
@@ -220,8 +244,9 @@ void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
 
 sp<EventThreadConnection> EventThread::createEventConnection(
         ResyncCallback resyncCallback, ISurfaceComposer::ConfigChanged configChanged) const {
-    return new EventThreadConnection(const_cast<EventThread*>(this), std::move(resyncCallback),
-                                     configChanged);
+    return new EventThreadConnection(const_cast<EventThread*>(this),
+                                     IPCThreadState::self()->getCallingUid(),
+                                     std::move(resyncCallback), configChanged, mChannelType);
 }
 
 status_t EventThread::registerDisplayEventConnection(const sp<EventThreadConnection>& connection) {
@@ -276,6 +301,45 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
     }
 }
 
+void EventThread::setTimestampOnly(bool timestampOnly,
+                                   const sp<EventThreadConnection>& connection) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    connection->timestampOnly = timestampOnly;
+}
+
+status_t EventThread::getVsyncTimestamps(sp<NativeHandle>* outHandle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    status_t err = NO_ERROR;
+    if (!mVsyncTimestamps) {
+        base::unique_fd fd(ashmem_create_region(mThreadName, sizeof(gui::VsyncTimestamps)));
+        void* data = MAP_FAILED;
+        if (fd.ok()) {
+            data = mmap(nullptr, sizeof(gui::VsyncTimestamps), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd.get(), 0);
+        }
+        // Mappings made from now on, i.e. those of the clients, can only be read-only.
+        if (data == MAP_FAILED || ashmem_set_prot_region(fd.get(), PROT_READ) != 0) {
+            err = -errno;
+            ALOGE("Failed to create the vsync timestamps of %s: %s", mThreadName, strerror(errno));
+            if (data != MAP_FAILED) {
+                munmap(data, sizeof(gui::VsyncTimestamps));
+            }
+        } else {
+            mVsyncTimestampsFd = std::move(fd);
+            mVsyncTimestamps = new (data) gui::VsyncTimestamps{};
+        }
+    }
+
+    // The handle is parceled even on failure, so always return one.
+    native_handle_t* handle = native_handle_create(mVsyncTimestamps ? 1 : 0, 0);
+    if (mVsyncTimestamps) {
+        handle->data[0] = dup(mVsyncTimestampsFd.get());
+    }
+    *outHandle = NativeHandle::create(handle, true);
+    return err;
+}
+
 void EventThread::onScreenReleased() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mVSyncState || mVSyncState->synthetic) {
@@ -325,6 +389,16 @@ size_t EventThread::getEventThreadConnectionCount() {
     return mDisplayEventConnections.size();
 }
 
+void EventThread::setFrameRateOverride(uid_t uid, float frameRate) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (frameRate <= 0.0f) {
+        mFrameRateOverridePeriods.erase(uid);
+    } else {
+        mFrameRateOverridePeriods[uid] = static_cast<nsecs_t>(1e9f / frameRate);
+    }
+    mCondition.notify_all();
+}
+
 void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
     DisplayEventConsumers consumers;
 
@@ -347,6 +421,10 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                     break;
 
                 case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+                    if (mVsyncTimestamps) {
+                        mVsyncTimestamps->publish(event->vsync.count, event->header.timestamp,
+                                                  event->vsync.expectedVSyncTimestamp);
+                    }
                     if (mInterceptVSyncsCallback) {
                         mInterceptVSyncsCallback(event->header.timestamp);
                     }
@@ -391,7 +469,13 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
         }
 
         if (!consumers.empty()) {
+            // Write to the connections without holding the lock, so that the vsync source and
+            // clients requesting the next vsync aren't blocked behind one socket write per
+            // connection. The state computed below is refreshed by the next iteration, which
+            // always runs after an event was dispatched.
+            lock.unlock();
             dispatchEvent(*event, consumers);
+            lock.lock();
             consumers.clear();
         }
 
@@ -459,18 +543,44 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
             return connection->mConfigChanged == ISurfaceComposer::eConfigChangedDispatch;
         }
 
-        case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+        case DisplayEventReceiver::DISPLAY_EVENT_VSYNC: {
+            if (connection->vsyncRequest == VSyncRequest::None) {
+                return false;
+            }
+
+            // Hold the request of a throttled connection until enough time has passed since the
+            // last vsync it received. The tolerance absorbs vsync jitter, so that the connection
+            // receives every Nth vsync rather than occasionally skipping one more.
+            if (const auto it = mFrameRateOverridePeriods.find(connection->mOwnerUid);
+                it != mFrameRateOverridePeriods.end()) {
+                const nsecs_t minPeriod = it->second - it->second / 10;
+                if (event.header.timestamp - connection->lastThrottledVsyncTime < minPeriod) {
+                    return false;
+                }
+            }
+
+            bool consume;
             switch (connection->vsyncRequest) {
                 case VSyncRequest::None:
                     return false;
                 case VSyncRequest::Single:
                     connection->vsyncRequest = VSyncRequest::None;
-                    return true;
+                    consume = true;
+                    break;
                 case VSyncRequest::Periodic:
-                    return true;
+                    consume = true;
+                    break;
                 default:
-                    return event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
+                    consume = event.vsync.count % vsyncPeriod(connection->vsyncRequest) == 0;
+                    break;
+            }
+            if (consume) {
+                connection->lastThrottledVsyncTime = event.header.timestamp;
             }
+            // The request is still consumed above, so that a timestamp-only connection keeps
+            // vsync running exactly as long as if it received the events.
+            return consume && !connection->timestampOnly;
+        }
 
         default:
             return false;
@@ -489,15 +599,20 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                     break;
 
                 case -EAGAIN:
-                    ALOGW("Failed dispatching %s for %s. attempt %d", toString(event).c_str(),
-                          toString(*consumer).c_str(), attempt+1);
+                    // mMutex is not held here, so only log the connection's immutable fields;
+                    // toString(*consumer) would read its vsync request while it may change.
+                    ALOGW("Failed dispatching %s for Connection{%p, uid=%d}. attempt %d",
+                          toString(event).c_str(), consumer.get(), consumer->mOwnerUid,
+                          attempt + 1);
                     needs_retry = true;
                     break;
 
-                default:
+                default: {
                     // Treat EPIPE and other errors as fatal.
+                    std::lock_guard<std::mutex> lock(mMutex);
                     removeDisplayEventConnectionLocked(consumer);
                     needs_retry = false;
+                }
             }
         }
     }
@@ -526,6 +641,13 @@ void EventThread::dump(std::string& result) const {
             StringAppendF(&result, "    %s\n", toString(*connection).c_str());
         }
     }
+
+    StringAppendF(&result, "  frame rate overrides (count=%zu):\n",
+                  mFrameRateOverridePeriods.size());
+    for (const auto& [uid, period] : mFrameRateOverridePeriods) {
+        StringAppendF(&result, "    uid=%d period=%.2fms\n", uid,
+                      static_cast<double>(period) / 1e6);
+    }
 }
 
 const char* EventThread::toCString(State state) {
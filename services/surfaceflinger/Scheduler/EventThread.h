@@ -20,6 +20,7 @@
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimestamps.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
 
@@ -29,6 +30,7 @@
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "HwcStrongTypes.h"
@@ -72,8 +74,9 @@ public:
 
 class EventThreadConnection : public BnDisplayEventConnection {
 public:
-    EventThreadConnection(EventThread*, ResyncCallback,
-                          ISurfaceComposer::ConfigChanged configChanged);
+    EventThreadConnection(EventThread*, uid_t callingUid, ResyncCallback,
+                          ISurfaceComposer::ConfigChanged configChanged,
+                          gui::BitTube::Type channelType = gui::BitTube::Type::Socket);
     virtual ~EventThreadConnection();
 
     virtual status_t postEvent(const DisplayEventReceiver::Event& event);
@@ -81,14 +84,23 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t getVsyncTimestamps(sp<NativeHandle>* outHandle) override;
+    status_t setTimestampOnly(bool timestampOnly) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
 
     VSyncRequest vsyncRequest = VSyncRequest::None;
+    // Whether vsync events are withheld because the client reads the shared vsync timestamps.
+    bool timestampOnly = false;
     const ISurfaceComposer::ConfigChanged mConfigChanged =
             ISurfaceComposer::ConfigChanged::eConfigChangedSuppress;
 
+    // The uid of the process that created the connection.
+    const uid_t mOwnerUid;
+    // Timestamp of the last vsync delivered to a connection with a frame rate override.
+    nsecs_t lastThrottledVsyncTime = 0;
+
 private:
     virtual void onFirstRef();
     EventThread* const mEventThread;
@@ -123,9 +135,20 @@ public:
     virtual void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) = 0;
     // Requests the next vsync. If resetIdleTimer is set to true, it resets the idle timer.
     virtual void requestNextVsync(const sp<EventThreadConnection>& connection) = 0;
+    virtual void setTimestampOnly(bool timestampOnly,
+                                  const sp<EventThreadConnection>& connection) = 0;
+
+    // Returns a handle to the read-only shared memory in which the latest vsync is published.
+    virtual status_t getVsyncTimestamps(sp<NativeHandle>* outHandle) = 0;
 
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
+
+    // Throttles the vsync events delivered to the connections owned by |uid| to at most
+    // |frameRate|, while other connections keep receiving every vsync. With a display rate
+    // that is a multiple of |frameRate|, the connections receive every Nth vsync. A
+    // |frameRate| of 0 removes the override.
+    virtual void setFrameRateOverride(uid_t uid, float frameRate) = 0;
 };
 
 namespace impl {
@@ -143,6 +166,10 @@ public:
     status_t registerDisplayEventConnection(const sp<EventThreadConnection>& connection) override;
     void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) override;
     void requestNextVsync(const sp<EventThreadConnection>& connection) override;
+    void setTimestampOnly(bool timestampOnly,
+                          const sp<EventThreadConnection>& connection) override;
+
+    status_t getVsyncTimestamps(sp<NativeHandle>* outHandle) override;
 
     // called before the screen is turned off from main thread
     void onScreenReleased() override;
@@ -161,6 +188,8 @@ public:
 
     size_t getEventThreadConnectionCount() override;
 
+    void setFrameRateOverride(uid_t uid, float frameRate) override;
+
 private:
     friend EventThreadTest;
 
@@ -170,8 +199,9 @@ private:
 
     bool shouldConsumeEvent(const DisplayEventReceiver::Event& event,
                             const sp<EventThreadConnection>& connection) const REQUIRES(mMutex);
+    // Called without mMutex held, see threadMain.
     void dispatchEvent(const DisplayEventReceiver::Event& event,
-                       const DisplayEventConsumers& consumers) REQUIRES(mMutex);
+                       const DisplayEventConsumers& consumers);
 
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
@@ -183,6 +213,8 @@ private:
 
     const InterceptVSyncsCallback mInterceptVSyncsCallback;
     const char* const mThreadName;
+    // The transport of the event channels of new connections.
+    const gui::BitTube::Type mChannelType;
 
     std::thread mThread;
     mutable std::mutex mMutex;
@@ -191,6 +223,13 @@ private:
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
 
+    // Shared memory in which every vsync is published, created on the first request for it.
+    base::unique_fd mVsyncTimestampsFd GUARDED_BY(mMutex);
+    gui::VsyncTimestamps* mVsyncTimestamps GUARDED_BY(mMutex) = nullptr;
+
+    // Minimum time between the vsync events delivered to the connections of a uid.
+    std::unordered_map<uid_t, nsecs_t> mFrameRateOverridePeriods GUARDED_BY(mMutex);
+
     // VSYNC state of connected display.
     struct VSyncState {
         explicit VSyncState(PhysicalDisplayId displayId) : displayId(displayId) {}
@@ -144,6 +144,11 @@ LayerHistoryV2::Summary LayerHistoryV2::summarize(nsecs_t now) {
 
         const float layerArea = transformed.getWidth() * transformed.getHeight();
         float weight = mDisplayArea ? layerArea / mDisplayArea : 0.0f;
+        // A heuristic rate calculated from an irregular cadence should have less impact on the
+        // selected refresh rate than the votes of other layers.
+        if (type == LayerHistory::LayerVoteType::Heuristic) {
+            weight *= info->getHeuristicConfidence();
+        }
         summary.push_back({strong->getName(), type, refreshRate, weight, layerFocused});
 
         if (CC_UNLIKELY(mTraceEnabled)) {
@@ -20,6 +20,7 @@
 #include "LayerInfoV2.h"
 
 #include <algorithm>
+#include <numeric>
 #include <utility>
 
 #include <cutils/compiler.h>
@@ -120,9 +121,62 @@ bool LayerInfoV2::hasEnoughDataForHeuristic() const {
     return true;
 }
 
-std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
+LayerInfoV2::FrameCadence LayerInfoV2::detectCadence(
+        const std::vector<nsecs_t>& frameTimeDeltas) {
+    FrameCadence bestCadence;
+    std::vector<nsecs_t> sums;
+    std::vector<nsecs_t> sortedSums;
+    // Prefer the shortest pattern, as any multiple of it repeats as well.
+    for (size_t length = 1; length <= MAX_CADENCE_LENGTH && 2 * length <= frameTimeDeltas.size();
+         length++) {
+        // The sums of every |length| consecutive deltas are equal if the pattern repeats every
+        // |length| frames.
+        sums.clear();
+        const auto first = frameTimeDeltas.begin();
+        nsecs_t sum = std::accumulate(first, first + static_cast<ptrdiff_t>(length),
+                                      static_cast<nsecs_t>(0));
+        sums.push_back(sum);
+        for (size_t i = length; i < frameTimeDeltas.size(); i++) {
+            sum += frameTimeDeltas[i] - frameTimeDeltas[i - length];
+            sums.push_back(sum);
+        }
+
+        sortedSums = sums;
+        const auto median = sortedSums.begin() + static_cast<ptrdiff_t>(sortedSums.size() / 2);
+        std::nth_element(sortedSums.begin(), median, sortedSums.end());
+        const auto tolerance =
+                static_cast<nsecs_t>(static_cast<float>(*median) * CADENCE_TOLERANCE);
+
+        nsecs_t totalInliers = 0;
+        size_t numInliers = 0;
+        for (const auto s : sums) {
+            if (std::abs(s - *median) <= tolerance) {
+                totalInliers += s;
+                numInliers++;
+            }
+        }
+
+        const float confidence =
+                static_cast<float>(numInliers) / static_cast<float>(sums.size());
+        if (confidence > bestCadence.confidence) {
+            bestCadence = {.frameTime = totalInliers / static_cast<nsecs_t>(numInliers * length),
+                           .length = length,
+                           .confidence = confidence};
+        }
+        if (confidence >= MIN_CADENCE_CONFIDENCE) {
+            break;
+        }
+    }
+    return bestCadence;
+}
+
+std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime(float* outConfidence) const {
     nsecs_t totalPresentTimeDeltas = 0;
     nsecs_t totalQueueTimeDeltas = 0;
+    std::vector<nsecs_t> presentTimeDeltas;
+    std::vector<nsecs_t> queueTimeDeltas;
+    presentTimeDeltas.reserve(mFrameTimes.size());
+    queueTimeDeltas.reserve(mFrameTimes.size());
     bool missingPresentTime = false;
     int numFrames = 0;
     for (auto it = mFrameTimes.begin(); it != mFrameTimes.end() - 1; ++it) {
@@ -131,8 +185,9 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
             return std::nullopt;
         }
 
-        totalQueueTimeDeltas +=
-                std::max(((it + 1)->queueTime - it->queueTime), mHighRefreshRatePeriod);
+        queueTimeDeltas.push_back(
+                std::max(((it + 1)->queueTime - it->queueTime), mHighRefreshRatePeriod));
+        totalQueueTimeDeltas += queueTimeDeltas.back();
         numFrames++;
 
         if (!missingPresentTime && (it->presetTime == 0 || (it + 1)->presetTime == 0)) {
@@ -145,8 +200,9 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
             continue;
         }
 
-        totalPresentTimeDeltas +=
-                std::max(((it + 1)->presetTime - it->presetTime), mHighRefreshRatePeriod);
+        presentTimeDeltas.push_back(
+                std::max(((it + 1)->presetTime - it->presetTime), mHighRefreshRatePeriod));
+        totalPresentTimeDeltas += presentTimeDeltas.back();
     }
 
     // Calculate the average frame time based on presentation timestamps. If those
@@ -156,6 +212,17 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
     // when implementing render ahead for specific refresh rates. When hwui no longer provides
     // presentation timestamps we look at the queue time to see if the current refresh rate still
     // matches the content.
+    //
+    // If most frames follow a repeating cadence, the frames that don't are outliers (e.g.
+    // dropped or late frames) and the average is taken over the frames that do.
+    const auto cadence = detectCadence(missingPresentTime ? queueTimeDeltas : presentTimeDeltas);
+    // Too few frames to tell the cadence apart don't lower the confidence.
+    *outConfidence = cadence.length > 0 ? cadence.confidence : 1.0f;
+    if (cadence.confidence >= MIN_CADENCE_CONFIDENCE) {
+        ALOGV("%s cadence of %zu frames, %.2f%% confidence", mName.c_str(), cadence.length,
+              cadence.confidence * 100);
+        return cadence.frameTime;
+    }
 
     const auto averageFrameTime =
             static_cast<float>(missingPresentTime ? totalQueueTimeDeltas : totalPresentTimeDeltas) /
@@ -170,8 +237,10 @@ std::optional<float> LayerInfoV2::calculateRefreshRateIfPossible(nsecs_t now) {
         return std::nullopt;
     }
 
-    const auto averageFrameTime = calculateAverageFrameTime();
+    float confidence = 1.0f;
+    const auto averageFrameTime = calculateAverageFrameTime(&confidence);
     if (averageFrameTime.has_value()) {
+        mLastRefreshRate.confidence = confidence;
         const auto refreshRate = 1e9f / *averageFrameTime;
         const bool refreshRateConsistent = mRefreshRateHistory.add(refreshRate, now);
         if (refreshRateConsistent) {
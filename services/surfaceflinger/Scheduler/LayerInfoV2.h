@@ -88,6 +88,10 @@ public:
 
     std::pair<LayerHistory::LayerVoteType, float> getRefreshRate(nsecs_t now);
 
+    // Returns how well the layer's recent frames fit the frame rate last calculated by the
+    // heuristic, in the range of [0, 1]. Layers with an irregular cadence get a low confidence.
+    float getHeuristicConfidence() const { return mLastRefreshRate.confidence; }
+
     // Return the last updated time. If the present time is farther in the future than the
     // updated time, the updated time is the present time.
     nsecs_t getLastUpdatedTime() const { return mLastUpdatedTime; }
@@ -128,6 +132,19 @@ private:
         // Whether the last reported rate for LayerInfoV2::getRefreshRate()
         // was due to animation or infrequent updates
         bool animatingOrInfrequent = false;
+        // Fraction of frames that follow the cadence of the last calculated rate
+        float confidence = 1.0f;
+    };
+
+    // A repeating pattern of frame time deltas, e.g. 24fps content on a 60Hz display alternates
+    // between 2 and 3 vsyncs per frame.
+    struct FrameCadence {
+        // Average frame time of the frames that follow the cadence
+        nsecs_t frameTime = 0;
+        // Number of frame time deltas in one repetition of the pattern
+        size_t length = 0;
+        // Fraction of frame time deltas that follow the pattern, in the range of [0, 1]
+        float confidence = 0.0f;
     };
 
     // Holds information about the layer vote
@@ -185,7 +202,8 @@ private:
     bool isAnimating(nsecs_t now) const;
     bool hasEnoughDataForHeuristic() const;
     std::optional<float> calculateRefreshRateIfPossible(nsecs_t now);
-    std::optional<nsecs_t> calculateAverageFrameTime() const;
+    std::optional<nsecs_t> calculateAverageFrameTime(float* outConfidence) const;
+    static FrameCadence detectCadence(const std::vector<nsecs_t>& frameTimeDeltas);
     bool isFrameTimeValid(const FrameTimeData&) const;
 
     const std::string mName;
@@ -208,6 +226,14 @@ private:
     static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
     static constexpr std::chrono::nanoseconds HISTORY_DURATION = 1s;
 
+    // Longest repeating pattern of frame time deltas that is detected as a cadence
+    static constexpr size_t MAX_CADENCE_LENGTH = 4;
+    // Relative deviation from the cadence for a frame time to still follow it
+    static constexpr float CADENCE_TOLERANCE = 0.1f;
+    // Fraction of frame times that have to follow a cadence for it to be used instead of the
+    // plain average. Frame times that don't are treated as outliers, e.g. dropped frames.
+    static constexpr float MIN_CADENCE_CONFIDENCE = 0.9f;
+
     RefreshRateHistory mRefreshRateHistory;
 
     mutable std::unordered_map<LayerHistory::LayerVoteType, std::string> mTraceTags;
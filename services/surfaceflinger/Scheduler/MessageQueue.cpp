@@ -46,15 +46,39 @@ void MessageQueue::Handler::dispatchInvalidate(nsecs_t expectedVSyncTimestamp) {
     }
 }
 
+void MessageQueue::Handler::dispatchTasks() {
+    if ((android_atomic_or(eventMaskTasks, &mEventMask) & eventMaskTasks) == 0) {
+        mQueue.mLooper->sendMessage(this, Message(MessageQueue::RUN_TASKS));
+    }
+}
+
+bool MessageQueue::Handler::isFramePending() const {
+    return android_atomic_acquire_load(&mEventMask) & (eventMaskInvalidate | eventMaskRefresh);
+}
+
 void MessageQueue::Handler::handleMessage(const Message& message) {
     switch (message.what) {
         case INVALIDATE:
             android_atomic_and(~eventMaskInvalidate, &mEventMask);
             mQueue.mFlinger->onMessageReceived(message.what, mExpectedVSyncTime);
+            // The frame ends here unless the invalidate led to a refresh.
+            if (!isFramePending()) {
+                mQueue.runTasks();
+            }
             break;
         case REFRESH:
             android_atomic_and(~eventMaskRefresh, &mEventMask);
             mQueue.mFlinger->onMessageReceived(message.what, mExpectedVSyncTime);
+            if (!isFramePending()) {
+                mQueue.runTasks();
+            }
+            break;
+        case RUN_TASKS:
+            android_atomic_and(~eventMaskTasks, &mEventMask);
+            // Otherwise the tasks run once the pending frame is done.
+            if (!isFramePending()) {
+                mQueue.runTasks();
+            }
             break;
     }
 }
@@ -101,7 +125,33 @@ void MessageQueue::waitMessage() {
 }
 
 void MessageQueue::postMessage(sp<MessageHandler>&& handler) {
-    mLooper->sendMessage(handler, Message());
+    {
+        std::lock_guard lock(mTaskLock);
+        mTasks.push_back(std::move(handler));
+    }
+    mHandler->dispatchTasks();
+}
+
+void MessageQueue::runTasks() {
+    const nsecs_t deadline = systemTime() + kTaskBudget;
+    do {
+        sp<MessageHandler> task;
+        {
+            std::lock_guard lock(mTaskLock);
+            if (mTasks.empty()) {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task->handleMessage(Message());
+    } while (systemTime() < deadline);
+
+    // Out of budget. The Looper gets to dispatch the next vsync before the remaining tasks.
+    std::lock_guard lock(mTaskLock);
+    if (!mTasks.empty()) {
+        mHandler->dispatchTasks();
+    }
 }
 
 void MessageQueue::invalidate() {
@@ -17,10 +17,13 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <future>
+#include <mutex>
 #include <type_traits>
 #include <utility>
 
+#include <android-base/thread_annotations.h>
 #include <utils/Looper.h>
 #include <utils/Timers.h>
 #include <utils/threads.h>
@@ -74,18 +77,35 @@ public:
 
 namespace impl {
 
+// Tasks posted with postMessage() are not frame critical, so they yield to frames: while an
+// INVALIDATE or REFRESH is pending, tasks wait until that frame is done. Tasks then run in the
+// order they were posted, for up to kTaskBudget at a time, so that a burst of tasks can't
+// hold off the next vsync either.
 class MessageQueue final : public android::MessageQueue {
+    // Message posted to the Looper to run tasks, next to INVALIDATE and REFRESH.
+    enum { RUN_TASKS = 2 };
+
+    static constexpr nsecs_t kTaskBudget = ms2ns(4);
+
     class Handler : public MessageHandler {
-        enum { eventMaskInvalidate = 0x1, eventMaskRefresh = 0x2, eventMaskTransaction = 0x4 };
+        enum {
+            eventMaskInvalidate = 0x1,
+            eventMaskRefresh = 0x2,
+            eventMaskTransaction = 0x4,
+            eventMaskTasks = 0x8
+        };
         MessageQueue& mQueue;
         int32_t mEventMask;
         std::atomic<nsecs_t> mExpectedVSyncTime;
 
+        bool isFramePending() const;
+
     public:
         explicit Handler(MessageQueue& queue) : mQueue(queue), mEventMask(0) {}
         virtual void handleMessage(const Message& message);
         void dispatchRefresh();
         void dispatchInvalidate(nsecs_t expectedVSyncTimestamp);
+        void dispatchTasks();
     };
 
     friend class Handler;
@@ -96,8 +116,12 @@ class MessageQueue final : public android::MessageQueue {
     gui::BitTube mEventTube;
     sp<Handler> mHandler;
 
+    std::mutex mTaskLock;
+    std::deque<sp<MessageHandler>> mTasks GUARDED_BY(mTaskLock);
+
     static int cb_eventReceiver(int fd, int events, void* data);
     int eventReceiver(int fd, int events);
+    void runTasks();
 
 public:
     ~MessageQueue() override = default;
@@ -105,6 +129,7 @@ public:
     void setEventConnection(const sp<EventThreadConnection>& connection) override;
 
     void waitMessage() override;
+    // Runs the task on the main thread, after any pending frame
     void postMessage(sp<MessageHandler>&&) override;
 
     // sends INVALIDATE message at next VSYNC
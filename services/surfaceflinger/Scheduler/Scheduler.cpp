@@ -63,38 +63,31 @@
 namespace android {
 
 std::unique_ptr<DispSync> createDispSync(bool supportKernelTimer) {
-    // TODO (140302863) remove this and use the vsync_reactor system.
-    if (property_get_bool("debug.sf.vsync_reactor", true)) {
-        // TODO (144707443) tune Predictor tunables.
-        static constexpr int defaultRate = 60;
-        static constexpr auto initialPeriod =
-                std::chrono::duration<nsecs_t, std::ratio<1, defaultRate>>(1);
-        static constexpr size_t vsyncTimestampHistorySize = 20;
-        static constexpr size_t minimumSamplesForPrediction = 6;
-        static constexpr uint32_t discardOutlierPercent = 20;
-        auto tracker = std::make_unique<
-                scheduler::VSyncPredictor>(std::chrono::duration_cast<std::chrono::nanoseconds>(
-                                                   initialPeriod)
-                                                   .count(),
-                                           vsyncTimestampHistorySize, minimumSamplesForPrediction,
-                                           discardOutlierPercent);
-
-        static constexpr auto vsyncMoveThreshold =
-                std::chrono::duration_cast<std::chrono::nanoseconds>(3ms);
-        static constexpr auto timerSlack =
-                std::chrono::duration_cast<std::chrono::nanoseconds>(500us);
-        auto dispatch = std::make_unique<
-                scheduler::VSyncDispatchTimerQueue>(std::make_unique<scheduler::Timer>(), *tracker,
-                                                    timerSlack.count(), vsyncMoveThreshold.count());
-
-        static constexpr size_t pendingFenceLimit = 20;
-        return std::make_unique<scheduler::VSyncReactor>(std::make_unique<scheduler::SystemClock>(),
-                                                         std::move(dispatch), std::move(tracker),
-                                                         pendingFenceLimit, supportKernelTimer);
-    } else {
-        return std::make_unique<impl::DispSync>("SchedulerDispSync",
-                                                sysprop::running_without_sync_framework(true));
-    }
+    // TODO (144707443) tune Predictor tunables.
+    static constexpr int defaultRate = 60;
+    static constexpr auto initialPeriod =
+            std::chrono::duration<nsecs_t, std::ratio<1, defaultRate>>(1);
+    static constexpr size_t vsyncTimestampHistorySize = 20;
+    static constexpr size_t minimumSamplesForPrediction = 6;
+    static constexpr uint32_t discardOutlierPercent = 20;
+    auto tracker = std::make_unique<
+            scheduler::VSyncPredictor>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                               initialPeriod)
+                                               .count(),
+                                       vsyncTimestampHistorySize, minimumSamplesForPrediction,
+                                       discardOutlierPercent);
+
+    static constexpr auto vsyncMoveThreshold =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(3ms);
+    static constexpr auto timerSlack = std::chrono::duration_cast<std::chrono::nanoseconds>(500us);
+    auto dispatch = std::make_unique<
+            scheduler::VSyncDispatchTimerQueue>(std::make_unique<scheduler::Timer>(), *tracker,
+                                                timerSlack.count(), vsyncMoveThreshold.count());
+
+    static constexpr size_t pendingFenceLimit = 20;
+    return std::make_unique<scheduler::VSyncReactor>(std::make_unique<scheduler::SystemClock>(),
+                                                     std::move(dispatch), std::move(tracker),
+                                                     pendingFenceLimit, supportKernelTimer);
 }
 
 Scheduler::Scheduler(impl::EventControlThread::SetVSyncEnabledFunction function,
@@ -277,6 +270,11 @@ void Scheduler::setPhaseOffset(ConnectionHandle handle, nsecs_t phaseOffset) {
     mConnections[handle].thread->setPhaseOffset(phaseOffset);
 }
 
+void Scheduler::setFrameRateOverride(ConnectionHandle handle, uid_t uid, float frameRate) {
+    RETURN_IF_INVALID_HANDLE(handle);
+    mConnections[handle].thread->setFrameRateOverride(uid, frameRate);
+}
+
 void Scheduler::getDisplayStatInfo(DisplayStatInfo* stats) {
     stats->vsyncTime = mPrimaryDispSync->computeNextRefresh(0, systemTime());
     stats->vsyncPeriod = mPrimaryDispSync->getPeriod();
@@ -498,6 +496,14 @@ void Scheduler::resetIdleTimer() {
     }
 }
 
+bool Scheduler::isIdle() {
+    if (!mIdleTimer) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mFeatureStateLock);
+    return mFeatures.idleTimer == TimerState::Expired;
+}
+
 void Scheduler::notifyTouchEvent() {
     if (!mTouchTimer) return;
 
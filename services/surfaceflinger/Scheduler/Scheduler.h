@@ -102,6 +102,8 @@ public:
 
     // Modifies phase offset in the event thread.
     void setPhaseOffset(ConnectionHandle, nsecs_t phaseOffset) override;
+    // Throttles the vsync events delivered to connections owned by |uid|. See EventThread.
+    void setFrameRateOverride(ConnectionHandle, uid_t uid, float frameRate);
 
     void getDisplayStatInfo(DisplayStatInfo* stats);
 
@@ -140,6 +142,8 @@ public:
 
     bool isIdleTimerEnabled() const { return mIdleTimer.has_value(); }
     void resetIdleTimer();
+    // Returns true if the idle timer has expired, i.e. no layer has updated for its duration.
+    bool isIdle();
 
     // Function that resets the touch timer.
     void notifyTouchEvent();
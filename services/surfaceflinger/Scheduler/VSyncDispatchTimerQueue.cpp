@@ -185,6 +185,7 @@ void VSyncDispatchTimerQueue::setTimer(nsecs_t targetTime, nsecs_t /*now*/) {
     mTimeKeeper->alarmAt(std::bind(&VSyncDispatchTimerQueue::timerCallback, this),
                          mIntendedWakeupTime);
     mLastTimerSchedule = mTimeKeeper->now();
+    mWakeupStats.timerArms++;
 }
 
 void VSyncDispatchTimerQueue::rearmTimer(nsecs_t now) {
@@ -260,6 +261,12 @@ void VSyncDispatchTimerQueue::timerCallback() {
             }
         }
 
+        mWakeupStats.wakeups++;
+        mWakeupStats.callbacks += invocations.size();
+        if (invocations.size() > 1) {
+            mWakeupStats.coalescedCallbacks += invocations.size() - 1;
+        }
+
         mIntendedWakeupTime = kInvalidTime;
         rearmTimer(mTimeKeeper->now());
     }
@@ -364,6 +371,11 @@ void VSyncDispatchTimerQueue::dump(std::string& result) const {
     StringAppendF(&result, "\tmLastTimerCallback: %.2fms ago mLastTimerSchedule: %.2fms ago\n",
                   (mTimeKeeper->now() - mLastTimerCallback) / 1e6f,
                   (mTimeKeeper->now() - mLastTimerSchedule) / 1e6f);
+    StringAppendF(&result,
+                  "\tWakeups: %" PRIu64 " for %" PRIu64 " callbacks (%" PRIu64
+                  " coalesced), timer armed %" PRIu64 " times\n",
+                  mWakeupStats.wakeups, mWakeupStats.callbacks, mWakeupStats.coalescedCallbacks,
+                  mWakeupStats.timerArms);
     StringAppendF(&result, "\tCallbacks:\n");
     for (const auto& [token, entry] : mCallbacks) {
         entry->dump(result);
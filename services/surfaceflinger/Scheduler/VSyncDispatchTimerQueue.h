@@ -169,6 +169,18 @@ private:
     // For debugging purposes
     nsecs_t mLastTimerCallback GUARDED_BY(mMutex) = kInvalidTime;
     nsecs_t mLastTimerSchedule GUARDED_BY(mMutex) = kInvalidTime;
+
+    // Counts how well callbacks are grouped into wakeups, for dump().
+    struct WakeupStats {
+        // Number of times the timer fired
+        uint64_t wakeups = 0;
+        // Number of callbacks dispatched
+        uint64_t callbacks = 0;
+        // Number of callbacks dispatched in a wakeup armed for another callback
+        uint64_t coalescedCallbacks = 0;
+        // Number of times the timer was armed
+        uint64_t timerArms = 0;
+    } mWakeupStats GUARDED_BY(mMutex);
 };
 
 } // namespace android::scheduler
@@ -88,6 +88,15 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    if (CC_UNLIKELY(mTraceOn) && !mTimestamps.empty()) {
+        // How far the model was off, before the timestamp is used to refit it.
+        auto const [slope, intercept] = getVSyncPredictionModel(lk);
+        auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+        auto const sinceZeroPoint = timestamp - (oldest + intercept);
+        auto const ordinal = (sinceZeroPoint + slope / 2) / slope;
+        ATRACE_INT64("VSP-error", sinceZeroPoint - ordinal * slope);
+    }
+
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
         mLastTimestampIndex = next(mLastTimestampIndex);
@@ -96,8 +105,12 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         mTimestamps[mLastTimestampIndex] = timestamp;
     }
 
+    auto it = mRateMap.find(mIdealPeriod);
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
-        mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        // Until there are enough samples for a new fit, keep the period last fitted for this
+        // rate, if any, and anchor it to the new samples.
+        auto const period = hasFittedModel() ? std::get<0>(it->second) : mIdealPeriod;
+        it->second = {period, 0};
         return true;
     }
 
@@ -116,12 +129,12 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(mTimestamps.size());
-    std::vector<nsecs_t> ordinals(mTimestamps.size());
-
+    // The sums are accumulated in a single pass over the ring buffer, and the centered sums
+    // above are expanded from them. The expansion is exact in integer arithmetic, so this
+    // matches computing the deviations from the (truncated) means explicitly.
+    //
     // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
     auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
     auto const currentPeriod = std::get<0>(it->second);
     // TODO (b/144707443): its important that there's some precision in the mean of the ordinals
     //                     for the intercept calculation, so scale the ordinals by 1000 to continue
@@ -129,29 +142,32 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //                     scheduler::utils::calculate_mean to have a fixed point fractional part.
     static constexpr int64_t kScalingFactor = 1000;
 
-    for (auto i = 0u; i < mTimestamps.size(); i++) {
-        traceInt64If("VSP-ts", mTimestamps[i]);
-
-        vsyncTS[i] = mTimestamps[i] - oldest_ts;
-        ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
-    }
-
-    auto meanTS = scheduler::calculate_mean(vsyncTS);
-    auto meanOrdinal = scheduler::calculate_mean(ordinals);
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
+    int64_t sumTS = 0;
+    int64_t sumOrdinals = 0;
+    int64_t sumProducts = 0;
+    int64_t sumSquaredOrdinals = 0;
+    for (auto const rawTimestamp : mTimestamps) {
+        traceInt64If("VSP-ts", rawTimestamp);
+
+        auto const vsyncTS = rawTimestamp - oldest_ts;
+        auto const ordinal = ((vsyncTS + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
+        sumTS += vsyncTS;
+        sumOrdinals += ordinal;
+        sumProducts += vsyncTS * ordinal;
+        sumSquaredOrdinals += ordinal * ordinal;
     }
 
-    auto top = 0ll;
-    auto bottom = 0ll;
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
-    }
+    auto const count = static_cast<int64_t>(mTimestamps.size());
+    auto const meanTS = sumTS / count;
+    auto const meanOrdinal = sumOrdinals / count;
+    auto const top = sumProducts - meanOrdinal * sumTS - meanTS * sumOrdinals +
+            count * meanTS * meanOrdinal;
+    auto const bottom = sumSquaredOrdinals - 2 * meanOrdinal * sumOrdinals +
+            count * meanOrdinal * meanOrdinal;
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
+        mFittedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
@@ -162,6 +178,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
     if (percent >= kOutlierTolerancePercent) {
         it->second = {mIdealPeriod, 0};
+        mFittedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
@@ -170,6 +187,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     traceInt64If("VSP-intercept", intercept);
 
     it->second = {anticipatedPeriod, intercept};
+    mFittedPeriods.insert(mIdealPeriod);
 
     ALOGV("model update ts: %" PRId64 " slope: %" PRId64 " intercept: %" PRId64, timestamp,
           anticipatedPeriod, intercept);
@@ -183,9 +201,11 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
 
     if (mTimestamps.empty()) {
         traceInt64If("VSP-mode", 1);
+        // A period fitted earlier for this rate is a better guess than the ideal one.
+        auto const period = hasFittedModel() ? slope : mIdealPeriod;
         auto const knownTimestamp = mKnownTimestamp ? *mKnownTimestamp : timePoint;
-        auto const numPeriodsOut = ((timePoint - knownTimestamp) / mIdealPeriod) + 1;
-        return knownTimestamp + numPeriodsOut * mIdealPeriod;
+        auto const numPeriodsOut = ((timePoint - knownTimestamp) / period) + 1;
+        return knownTimestamp + numPeriodsOut * period;
     }
 
     auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
@@ -230,6 +250,7 @@ void VSyncPredictor::setPeriod(nsecs_t period) {
     std::lock_guard<std::mutex> lk(mMutex);
     static constexpr size_t kSizeLimit = 30;
     if (CC_UNLIKELY(mRateMap.size() == kSizeLimit)) {
+        mFittedPeriods.erase(mRateMap.begin()->first);
         mRateMap.erase(mRateMap.begin());
     }
 
@@ -255,14 +276,24 @@ void VSyncPredictor::clearTimestamps() {
     }
 }
 
+bool VSyncPredictor::hasFittedModel() const {
+    return mFittedPeriods.count(mIdealPeriod) > 0;
+}
+
 bool VSyncPredictor::needsMoreSamples() const {
     std::lock_guard<std::mutex> lk(mMutex);
-    return mTimestamps.size() < kMinimumSamplesForPrediction;
+    // When returning to a rate that was fitted before, only the phase has to be re-learned,
+    // which takes fewer samples than fitting the period from scratch.
+    auto const minimumSamples = hasFittedModel()
+            ? std::max<size_t>(kMinimumSamplesForPrediction / 2, 1)
+            : kMinimumSamplesForPrediction;
+    return mTimestamps.size() < minimumSamples;
 }
 
 void VSyncPredictor::resetModel() {
     std::lock_guard<std::mutex> lk(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+    mFittedPeriods.erase(mIdealPeriod);
     clearTimestamps();
 }
 
@@ -19,6 +19,7 @@
 #include <android-base/thread_annotations.h>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "SchedulerUtils.h"
 #include "VSyncTracker.h"
@@ -76,6 +77,9 @@ private:
     std::mutex mutable mMutex;
     size_t next(int i) const REQUIRES(mMutex);
     bool validate(nsecs_t timestamp) const REQUIRES(mMutex);
+    // Whether the model for the current ideal period was fitted from samples, rather than
+    // being the ideal period itself.
+    bool hasFittedModel() const REQUIRES(mMutex);
     std::tuple<nsecs_t, nsecs_t> getVSyncPredictionModel(std::lock_guard<std::mutex> const&) const
             REQUIRES(mMutex);
 
@@ -83,6 +87,7 @@ private:
     std::optional<nsecs_t> mKnownTimestamp GUARDED_BY(mMutex);
 
     std::unordered_map<nsecs_t, std::tuple<nsecs_t, nsecs_t>> mutable mRateMap GUARDED_BY(mMutex);
+    std::unordered_set<nsecs_t> mFittedPeriods GUARDED_BY(mMutex);
 
     int mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
@@ -142,6 +142,10 @@ class ClientInterface;
 
 #define MAIN_THREAD ACQUIRE(mStateLock) RELEASE(mStateLock)
 
+// Locks mStateLock for the rest of the scope, attributing any wait for it to the enclosing
+// function and line. See dumpsys SurfaceFlinger --lock-stats.
+#define STATE_LOCK(name) ProfiledLock name(mStateLock, mStateLockProfiler, __FUNCTION__, __LINE__)
+
 #define ON_MAIN_THREAD(expr)                                       \
     [&] {                                                          \
         LOG_FATAL_IF(std::this_thread::get_id() != mMainThreadId); \
@@ -514,6 +518,10 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     mUseHwcVirtualDisplays = atoi(value);
     ALOGI_IF(mUseHwcVirtualDisplays, "Enabling HWC virtual displays");
 
+    property_get("debug.sf.enable_hwc_vds_for_encoders", value, "1");
+    mUseHwcWritebackForEncoders = atoi(value);
+    ALOGI_IF(mUseHwcWritebackForEncoders, "Enabling HWC virtual displays for video encoders");
+
     property_get("ro.sf.disable_triple_buffer", value, "0");
     mLayerTripleBufferingDisabled = atoi(value);
     ALOGI_IF(mLayerTripleBufferingDisabled, "Disabling Triple Buffering");
@@ -542,6 +550,49 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
+    mEnableClientCompositionLayerSetCache =
+            property_get_bool("debug.sf.client_composition_layer_set_cache", false);
+
+    mEnablePartialClientComposition =
+            property_get_bool("debug.sf.enable_partial_client_composition", false);
+
+    mEnableLayerFlattening = property_get_bool("debug.sf.enable_layer_flattening", false);
+
+    mMergeQueuedTransactions = property_get_bool("debug.sf.merge_queued_transactions", true);
+    mTrackLayersNeedingTransaction =
+            property_get_bool("debug.sf.track_layers_needing_transaction", true);
+
+    mFramePhaseProfiler.setEnabled(property_get_bool("debug.sf.frame_phase_profiler", true));
+    mStateLockProfiler.setEnabled(property_get_bool("debug.sf.lock_profiler", true));
+
+    // Number of extra threads used to compute layer bounds; 0 keeps the traversal serial.
+    const auto layerBoundsWorkers = property_get_int32("debug.sf.parallel_layer_bounds", 0);
+    if (layerBoundsWorkers > 0) {
+        mLayerBoundsWorkerPool =
+                std::make_unique<WorkerPool>(static_cast<size_t>(layerBoundsWorkers), "sfBounds");
+        mParallelLayerBoundsMinRoots = static_cast<size_t>(
+                std::max(2, property_get_int32("debug.sf.parallel_layer_bounds_min_roots", 4)));
+    }
+
+    // Number of extra threads used to compute the composition state of secondary displays.
+    const auto outputCompositionWorkers =
+            property_get_int32("debug.sf.parallel_output_composition", 0);
+    if (outputCompositionWorkers > 0) {
+        mOutputCompositionWorkerPool =
+                std::make_unique<WorkerPool>(static_cast<size_t>(outputCompositionWorkers),
+                                             "sfComposition");
+    }
+
+    mPredictCompositionStrategy =
+            property_get_bool("debug.sf.predict_composition_strategy", false);
+
+    mIdleCompositionBypass = property_get_bool("debug.sf.idle_composition_bypass", false);
+
+    const auto bufferPoolKb = property_get_int32("debug.sf.graphic_buffer_pool_kb", 0);
+    if (bufferPoolKb > 0) {
+        GraphicBufferAllocator::get().setPoolCapacity(static_cast<size_t>(bufferPoolKb) * 1024);
+    }
+
     char property[PROPERTY_VALUE_MAX] = {0};
     if((property_get("vendor.display.vsync_reliable_on_doze", property, "0") > 0) &&
         (!strncmp(property, "1", PROPERTY_VALUE_MAX ) ||
@@ -685,7 +736,7 @@ sp<IBinder> SurfaceFlinger::createDisplay(const String8& displayName, bool secur
 
     sp<BBinder> token = new DisplayToken(this);
 
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     // Display ID is assigned when virtual display is allocated by HWC.
     DisplayDeviceState state;
     state.isSecure = secure;
@@ -696,7 +747,7 @@ sp<IBinder> SurfaceFlinger::createDisplay(const String8& displayName, bool secur
 }
 
 void SurfaceFlinger::destroyDisplay(const sp<IBinder>& displayToken) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const ssize_t index = mCurrentState.displays.indexOfKey(displayToken);
     if (index < 0) {
@@ -715,7 +766,7 @@ void SurfaceFlinger::destroyDisplay(const sp<IBinder>& displayToken) {
 }
 
 std::vector<PhysicalDisplayId> SurfaceFlinger::getPhysicalDisplayIds() const {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto internalDisplayId = getInternalDisplayIdLocked();
     if (!internalDisplayId) {
@@ -736,7 +787,7 @@ std::vector<PhysicalDisplayId> SurfaceFlinger::getPhysicalDisplayIds() const {
 }
 
 sp<IBinder> SurfaceFlinger::getPhysicalDisplayToken(PhysicalDisplayId displayId) const {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     return getPhysicalDisplayTokenLocked(DisplayId{displayId});
 }
 
@@ -813,7 +864,7 @@ void SurfaceFlinger::bootFinished()
             enableRefreshRateOverlay(true);
         }
         if (mUseFbScaling) {
-            Mutex::Autolock _l(mStateLock);
+            STATE_LOCK(_l);
             ssize_t index = mCurrentState.displays.indexOfKey(getInternalDisplayTokenLocked());
             if (index < 0) {
                 ALOGE("Invalid token %p", getInternalDisplayTokenLocked().get());
@@ -865,7 +916,17 @@ void SurfaceFlinger::deleteTextureAsync(uint32_t texture) {
 void SurfaceFlinger::init() {
     ALOGI(  "SurfaceFlinger's main thread ready to run. "
             "Initializing graphics H/W...");
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
+
+    const nsecs_t initStartTime = systemTime();
+
+    // Connecting to the composer HAL blocks until the HAL is up, so do it while RenderEngine is
+    // created. RenderEngine stays on this thread, which its context is made current on.
+    LOG_ALWAYS_FATAL_IF(mVrFlingerRequestsDisplay,
+            "Starting with vr flinger active is not currently supported.");
+    auto hwComposerFuture = std::async(std::launch::async, [this] {
+        return getFactory().createHWComposer(getBE().mHwcServiceName);
+    });
 
     // Get a RenderEngine for the given display / config (can't fail)
     // TODO(b/77156734): We need to stop casting and use HAL types when possible.
@@ -883,10 +944,10 @@ void SurfaceFlinger::init() {
                         : renderengine::RenderEngine::ContextPriority::MEDIUM)
                 .build()));
     mCompositionEngine->setTimeStats(mTimeStats);
+    const nsecs_t renderEngineTime = systemTime();
 
-    LOG_ALWAYS_FATAL_IF(mVrFlingerRequestsDisplay,
-            "Starting with vr flinger active is not currently supported.");
-    mCompositionEngine->setHwComposer(getFactory().createHWComposer(getBE().mHwcServiceName));
+    mCompositionEngine->setHwComposer(hwComposerFuture.get());
+    const nsecs_t hwComposerTime = systemTime();
     mCompositionEngine->getHwComposer().setConfiguration(this, getBE().mComposerSequenceId);
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
@@ -933,12 +994,20 @@ void SurfaceFlinger::init() {
 
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
+    const nsecs_t displaysTime = systemTime();
 
     char primeShaderCache[PROPERTY_VALUE_MAX];
     property_get("service.sf.prime_shader_cache", primeShaderCache, "1");
     if (atoi(primeShaderCache)) {
         getRenderEngine().primeCache();
     }
+    const nsecs_t primeCacheTime = systemTime();
+    ALOGI("Graphics H/W initialized in %" PRId64 " ms: RenderEngine %" PRId64
+          " ms, waiting for HWC %" PRId64 " ms, displays %" PRId64 " ms, shader cache %" PRId64
+          " ms",
+          ns2ms(primeCacheTime - initStartTime), ns2ms(renderEngineTime - initStartTime),
+          ns2ms(hwComposerTime - renderEngineTime), ns2ms(displaysTime - hwComposerTime),
+          ns2ms(primeCacheTime - displaysTime));
 
     // Inform native graphics APIs whether the present timestamp is supported:
 
@@ -1004,7 +1073,7 @@ void SurfaceFlinger::init() {
 }
 
 void SurfaceFlinger::readPersistentProperties() {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
 
     char value[PROPERTY_VALUE_MAX];
 
@@ -1047,7 +1116,7 @@ size_t SurfaceFlinger::getMaxViewportDims() const {
 
 bool SurfaceFlinger::authenticateSurfaceTexture(
         const sp<IGraphicBufferProducer>& bufferProducer) const {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     return authenticateSurfaceTextureLocked(bufferProducer);
 }
 
@@ -1082,7 +1151,7 @@ status_t SurfaceFlinger::getDisplayState(const sp<IBinder>& displayToken, ui::Di
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto display = getDisplayDeviceLocked(displayToken);
     if (!display) {
@@ -1103,7 +1172,7 @@ status_t SurfaceFlinger::getDisplayInfo(const sp<IBinder>& displayToken, Display
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto display = getDisplayDeviceLocked(displayToken);
     if (!display) {
@@ -1137,7 +1206,7 @@ status_t SurfaceFlinger::getDisplayConfigs(const sp<IBinder>& displayToken,
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1216,7 +1285,7 @@ int SurfaceFlinger::getActiveConfig(const sp<IBinder>& displayToken) {
     bool isPrimary;
 
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         if (const auto display = getDisplayDeviceLocked(displayToken)) {
             activeConfig = display->getActiveConfig().value();
@@ -1466,7 +1535,7 @@ status_t SurfaceFlinger::getDisplayNativePrimaries(const sp<IBinder>& displayTok
 }
 
 ColorMode SurfaceFlinger::getActiveColorMode(const sp<IBinder>& displayToken) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     if (const auto display = getDisplayDeviceLocked(displayToken)) {
         return display->getCompositionDisplay()->getState().colorMode;
@@ -1508,7 +1577,7 @@ status_t SurfaceFlinger::getAutoLowLatencyModeSupport(const sp<IBinder>& display
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1536,7 +1605,7 @@ status_t SurfaceFlinger::getGameContentTypeSupport(const sp<IBinder>& displayTok
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1563,20 +1632,20 @@ void SurfaceFlinger::setGameContentType(const sp<IBinder>& displayToken, bool on
 }
 
 status_t SurfaceFlinger::clearAnimationFrameStats() {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     mAnimFrameTracker.clearStats();
     return NO_ERROR;
 }
 
 status_t SurfaceFlinger::getAnimationFrameStats(FrameStats* outStats) const {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     mAnimFrameTracker.getStats(outStats);
     return NO_ERROR;
 }
 
 status_t SurfaceFlinger::getHdrCapabilities(const sp<IBinder>& displayToken,
                                             HdrCapabilities* outCapabilities) const {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto display = getDisplayDeviceLocked(displayToken);
     if (!display) {
@@ -1628,7 +1697,7 @@ status_t SurfaceFlinger::getDisplayedContentSamplingAttributes(const sp<IBinder>
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1673,7 +1742,7 @@ status_t SurfaceFlinger::setDisplayElapseTime(const sp<DisplayDevice>& display)
 status_t SurfaceFlinger::getDisplayedContentSample(const sp<IBinder>& displayToken,
                                                    uint64_t maxFrames, uint64_t timestamp,
                                                    DisplayedFrameStats* outStats) const {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1697,7 +1766,7 @@ status_t SurfaceFlinger::isWideColorDisplay(const sp<IBinder>& displayToken,
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     const auto display = getDisplayDeviceLocked(displayToken);
     if (!display) {
         return NAME_NOT_FOUND;
@@ -1710,7 +1779,7 @@ status_t SurfaceFlinger::isWideColorDisplay(const sp<IBinder>& displayToken,
 
 status_t SurfaceFlinger::enableVSyncInjections(bool enable) {
     schedule([=] {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         if (const auto handle = mScheduler->enableVSyncInjection(enable)) {
             mEventQueue->setEventConnection(
@@ -1722,7 +1791,7 @@ status_t SurfaceFlinger::enableVSyncInjections(bool enable) {
 }
 
 status_t SurfaceFlinger::injectVSync(nsecs_t when) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     return mScheduler->injectVSync(when, calculateExpectedPresentTime(when)) ? NO_ERROR : BAD_VALUE;
 }
 
@@ -1774,7 +1843,7 @@ status_t SurfaceFlinger::getDisplayBrightnessSupport(const sp<IBinder>& displayT
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     const auto displayId = getPhysicalDisplayIdLocked(displayToken);
     if (!displayId) {
@@ -1859,7 +1928,7 @@ void SurfaceFlinger::onVsyncReceived(int32_t sequenceId, hal::HWDisplayId hwcDis
                                      std::optional<hal::VsyncPeriodNanos> vsyncPeriod) {
     ATRACE_NAME("SF onVsync");
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     // Ignore any vsyncs from a previous hardware composer.
     if (sequenceId != getBE().mComposerSequenceId) {
         return;
@@ -1962,7 +2031,7 @@ void SurfaceFlinger::onHotplugReceived(int32_t sequenceId, hal::HWDisplayId hwcD
 void SurfaceFlinger::onVsyncPeriodTimingChangedReceived(
         int32_t sequenceId, hal::HWDisplayId /*display*/,
         const hal::VsyncPeriodChangeTimeline& updatedTimeline) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     if (sequenceId != getBE().mComposerSequenceId) {
         return;
     }
@@ -1975,7 +2044,7 @@ void SurfaceFlinger::onSeamlessPossible(int32_t /*sequenceId*/, hal::HWDisplayId
 }
 
 void SurfaceFlinger::onRefreshReceived(int sequenceId, hal::HWDisplayId /*hwcDisplayId*/) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     if (sequenceId != getBE().mComposerSequenceId) {
         return;
     }
@@ -2053,7 +2122,7 @@ void SurfaceFlinger::updateVrFlinger() {
         return;
     }
 
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
 
     sp<DisplayDevice> display = getDefaultDisplayDeviceLocked();
     LOG_ALWAYS_FATAL_IF(!display);
@@ -2213,6 +2282,10 @@ void SurfaceFlinger::onMessageReceived(int32_t what, nsecs_t expectedVSyncTime)
 void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     ATRACE_CALL();
 
+    mFramePhaseProfiler.startFrame();
+    FramePhaseProfiler::ScopedPhase phase(mFramePhaseProfiler,
+                                          FramePhaseProfiler::Phase::Invalidate);
+
     const nsecs_t frameStart = systemTime();
     // calculate the expected present time once and use the cached
     // value throughout this frame to make sure all layers are
@@ -2286,6 +2359,11 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
         ON_MAIN_THREAD(setActiveConfigInternal());
     }
 
+    if (canBypassComposition()) {
+        ATRACE_NAME("IdleCompositionBypass");
+        return;
+    }
+
     if (framePending && mPropagateBackpressure) {
         if ((hwcFrameMissed && !gpuFrameMissed) || mPropagateBackpressureClientComposition) {
             signalLayerUpdate();
@@ -2392,7 +2470,7 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     // Hold mStateLock as chooseRefreshRateForContent promotes wp<Layer> to sp<Layer>
     // and may eventually call to ~Layer() if it holds the last reference
     {
-        Mutex::Autolock _l(mStateLock);
+        STATE_LOCK(_l);
         mScheduler->chooseRefreshRateForContent();
     }
 
@@ -2423,8 +2501,26 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     }
 }
 
+bool SurfaceFlinger::canBypassComposition() {
+    if (!mIdleCompositionBypass || !mScheduler->isIdle()) {
+        return false;
+    }
+
+    // The idle timer is reset asynchronously, so check for pending work directly.
+    if (mRepaintEverything || mForceTraversal || mVisibleRegionsDirty || peekTransactionFlags() ||
+        transactionFlushNeeded()) {
+        return false;
+    }
+
+    bool frameQueued = false;
+    mDrawingState.traverse([&](Layer* layer) { frameQueued |= layer->hasReadyFrame(); });
+    return !frameQueued;
+}
+
 bool SurfaceFlinger::handleMessageTransaction() {
     ATRACE_CALL();
+    FramePhaseProfiler::ScopedPhase phase(mFramePhaseProfiler,
+                                          FramePhaseProfiler::Phase::Transaction);
     uint32_t transactionFlags = peekTransactionFlags();
 
     bool flushedATransaction = flushTransactionQueues();
@@ -2449,6 +2545,7 @@ bool SurfaceFlinger::handleMessageTransaction() {
 
 void SurfaceFlinger::onMessageRefresh() {
     ATRACE_CALL();
+    FramePhaseProfiler::ScopedPhase phase(mFramePhaseProfiler, FramePhaseProfiler::Phase::Refresh);
 
     mRefreshPending = false;
 
@@ -2478,12 +2575,13 @@ void SurfaceFlinger::onMessageRefresh() {
     refreshArgs.updatingOutputGeometryThisFrame = mVisibleRegionsDirty;
     refreshArgs.updatingGeometryThisFrame = mGeometryInvalid || mVisibleRegionsDirty;
     refreshArgs.blursAreExpensive = mBlursAreExpensive;
+    refreshArgs.frameBudget = getVsyncPeriod();
     refreshArgs.internalDisplayRotationFlags = DisplayDevice::getPrimaryDisplayRotationFlags();
 
-    if (CC_UNLIKELY(mDrawingState.colorMatrixChanged)) {
-        refreshArgs.colorTransformMatrix = mDrawingState.colorMatrix;
-        mDrawingState.colorMatrixChanged = false;
-    }
+    // Sent every frame, as each output only applies it if it differs from its own. Outputs
+    // created after the last change would otherwise never get it.
+    refreshArgs.colorTransformMatrix = mDrawingState.colorMatrix;
+    mDrawingState.colorMatrixChanged = false;
 
     refreshArgs.devOptForceClientComposition = mDebugDisableHWC || mDebugRegion;
 
@@ -2492,6 +2590,13 @@ void SurfaceFlinger::onMessageRefresh() {
                 std::chrono::milliseconds(mDebugRegion > 1 ? mDebugRegion : 0);
     }
 
+    if (mOutputCompositionWorkerPool) {
+        refreshArgs.parallelFor = [this](size_t count, const std::function<void(size_t)>& work) {
+            mOutputCompositionWorkerPool->parallelFor(count, work);
+        };
+    }
+    refreshArgs.predictCompositionStrategy = mPredictCompositionStrategy;
+
     mGeometryInvalid = false;
 
     // Store the present time just before calling to the composition engine so we could notify
@@ -2499,13 +2604,32 @@ void SurfaceFlinger::onMessageRefresh() {
     const auto presentTime = systemTime();
 
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         for (const auto& [_, display] : mDisplays) {
             setDisplayElapseTime(display);
         }
     }
 
-    mCompositionEngine->present(refreshArgs);
+    {
+        FramePhaseProfiler::ScopedPhase presentPhase(mFramePhaseProfiler,
+                                                     FramePhaseProfiler::Phase::CompositionPresent);
+        mCompositionEngine->present(refreshArgs);
+    }
+
+    if (mFramePhaseProfiler.isEnabled()) {
+        nsecs_t renderEngineDuration = -1;
+        for (const auto& [_, display] : displays) {
+            const auto& state = display->getCompositionDisplay()->getState();
+            if (state.isEnabled && state.renderEngineDuration >= 0) {
+                renderEngineDuration = std::max<nsecs_t>(renderEngineDuration, 0) +
+                        state.renderEngineDuration;
+            }
+        }
+        if (renderEngineDuration >= 0) {
+            mFramePhaseProfiler.recordPhase(FramePhaseProfiler::Phase::RenderEngineDraw,
+                                            renderEngineDuration);
+        }
+    }
 
     mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
     // Reset the frame start time now that we've recorded this frame.
@@ -2630,6 +2754,8 @@ void SurfaceFlinger::setCompositorTimingSnapped(const DisplayStatInfo& stats,
 void SurfaceFlinger::postComposition()
 {
     ATRACE_CALL();
+    FramePhaseProfiler::ScopedPhase phase(mFramePhaseProfiler,
+                                          FramePhaseProfiler::Phase::PostComposition);
     ALOGV("postComposition");
 
     nsecs_t dequeueReadyTime = systemTime();
@@ -2796,7 +2922,7 @@ void SurfaceFlinger::postComposition()
 
     if (mSmoMo) {
         ATRACE_NAME("SmoMoUpdateState");
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         uint32_t fps = 0;
         std::vector<smomo::SmomoLayerStats> layers;
@@ -2858,17 +2984,34 @@ void SurfaceFlinger::forceResyncModel() NO_THREAD_SAFETY_ANALYSIS {
 }
 
 void SurfaceFlinger::computeLayerBounds() {
+    std::vector<Layer*> roots;
     for (const auto& pair : ON_MAIN_THREAD(mDisplays)) {
         const auto& displayDevice = pair.second;
         const auto display = displayDevice->getCompositionDisplay();
+        const FloatRect clipBounds = getLayerClipBoundsForDisplay(*displayDevice);
+
+        roots.clear();
         for (const auto& layer : mDrawingState.layersSortedByZ) {
             // only consider the layers on the given layer stack
             if (!display->belongsInOutput(layer->getLayerStack(), layer->getPrimaryDisplayOnly())) {
                 continue;
             }
+            roots.push_back(layer.get());
+        }
 
-            layer->computeBounds(getLayerClipBoundsForDisplay(*displayDevice), ui::Transform(),
-                                 0.f /* shadowRadius */);
+        // Each root layer owns a disjoint subtree, so the subtrees can be computed concurrently.
+        // Displays are still handled one after the other so that a layer shared between displays
+        // ends up with the same bounds as in the serial traversal.
+        const auto computeRoot = [&](size_t i) {
+            roots[i]->computeBounds(clipBounds, ui::Transform(), 0.f /* shadowRadius */);
+        };
+        if (mLayerBoundsWorkerPool && roots.size() >= mParallelLayerBoundsMinRoots) {
+            ATRACE_NAME("computeLayerBounds parallel");
+            mLayerBoundsWorkerPool->parallelFor(roots.size(), computeRoot);
+        } else {
+            for (size_t i = 0; i < roots.size(); i++) {
+                computeRoot(i);
+            }
         }
     }
 }
@@ -2958,7 +3101,7 @@ void SurfaceFlinger::handleTransaction(uint32_t transactionFlags)
     // don't happen with mStateLock held (which can cause deadlocks).
     State drawingState(mDrawingState);
 
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     mDebugInTransaction = systemTime();
 
     // Here we're guaranteed that some transaction flags are set
@@ -3169,6 +3312,16 @@ void SurfaceFlinger::processDisplayAdded(const wp<IBinder>& displayToken,
                    canAllocateHwcForVDS = true;
                }
             }
+        } else if (mUseHwcWritebackForEncoders &&
+                   getHwComposer().canAllocateVirtualDisplay(static_cast<uint32_t>(width),
+                                                             static_cast<uint32_t>(height))) {
+            // Sinks feeding a video encoder, e.g. screen recording, are written back by the
+            // HWC when it has a virtual display to spare, rather than composed by GPU.
+            uint64_t usage = 0;
+            status = state.surface->getConsumerUsage(&usage);
+            ALOGW_IF(status != NO_ERROR, "Unable to query usage (%d)", status);
+            canAllocateHwcForVDS =
+                    status == NO_ERROR && (usage & GRALLOC_USAGE_HW_VIDEO_ENCODER) != 0;
         }
 
     } else {
@@ -3187,8 +3340,7 @@ void SurfaceFlinger::processDisplayAdded(const wp<IBinder>& displayToken,
     builder.setIsSecure(state.isSecure);
     builder.setLayerStackId(state.layerStack);
     builder.setPowerAdvisor(&mPowerAdvisor);
-    builder.setUseHwcVirtualDisplays((mUseHwcVirtualDisplays && canAllocateHwcForVDS) ||
-                                     getHwComposer().isUsingVrComposer());
+    builder.setUseHwcVirtualDisplays(canAllocateHwcForVDS || getHwComposer().isUsingVrComposer());
     builder.setName(state.displayName);
     const auto compositionDisplay = getCompositionEngine().createDisplay(builder.build());
 
@@ -3427,7 +3579,7 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
 
     if ((transactionFlags & eTraversalNeeded) || mForceTraversal) {
         mForceTraversal = false;
-        mCurrentState.traverse([&](Layer* layer) {
+        const auto doLayerTransaction = [&](Layer* layer) {
             uint32_t trFlags = layer->getTransactionFlags(eTransactionNeeded);
             if (!trFlags) return;
 
@@ -3438,7 +3590,39 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
             if (flags & Layer::eInputInfoChanged) {
                 mInputInfoChanged = true;
             }
-        });
+        };
+
+        if (mTrackLayersNeedingTransaction) {
+            std::vector<wp<Layer>> layers;
+            {
+                std::lock_guard lock(mLayersNeedingTransactionLock);
+                layers.swap(mLayersNeedingTransaction);
+            }
+
+            std::vector<wp<Layer>> offscreenLayers;
+            for (const auto& weakLayer : layers) {
+                const sp<Layer> layer = weakLayer.promote();
+                if (!layer) continue;
+
+                // Offscreen layers are not part of the current state traversal, so keep them
+                // pending until they are added back.
+                if (layer->isRemovedFromCurrentState()) {
+                    if (layer->getTransactionFlags() & eTransactionNeeded) {
+                        offscreenLayers.push_back(weakLayer);
+                    }
+                    continue;
+                }
+                doLayerTransaction(layer.get());
+            }
+
+            if (!offscreenLayers.empty()) {
+                std::lock_guard lock(mLayersNeedingTransactionLock);
+                mLayersNeedingTransaction.insert(mLayersNeedingTransaction.end(),
+                                                 offscreenLayers.begin(), offscreenLayers.end());
+            }
+        } else {
+            mCurrentState.traverse(doLayerTransaction);
+        }
     }
 
     /*
@@ -3566,19 +3750,39 @@ void SurfaceFlinger::updateInputFlinger() {
 }
 
 void SurfaceFlinger::updateInputWindowInfo() {
-    std::vector<InputWindowInfo> inputHandles;
+    std::vector<InputWindowInfo> changedInfos;
+    std::vector<int32_t> windowIds;
+    std::unordered_map<int32_t, InputWindowInfo> inputWindowInfos;
 
     mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
         if (layer->needsInputInfo()) {
             // When calculating the screen bounds we ignore the transparent region since it may
             // result in an unwanted offset.
-            inputHandles.push_back(layer->fillInputInfo());
+            InputWindowInfo info = layer->fillInputInfo();
+            windowIds.push_back(info.id);
+            const auto it = mInputWindowInfos.find(info.id);
+            if (it == mInputWindowInfos.end() || it->second != info) {
+                changedInfos.push_back(info);
+            }
+            inputWindowInfos.emplace(info.id, std::move(info));
         }
     });
 
-    mInputFlinger->setInputWindows(inputHandles,
-                                   mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
-                                                                         : nullptr);
+    // Only send the windows that were added or modified. Removals and reordering are conveyed
+    // by the window id list, so nothing needs to be sent if that is unchanged as well.
+    if (changedInfos.empty() && windowIds == mInputWindowIds) {
+        if (mInputWindowCommands.syncInputWindows) {
+            setInputWindowsFinished();
+        }
+        return;
+    }
+
+    mInputFlinger->updateInputWindows(changedInfos, windowIds,
+                                      mInputWindowCommands.syncInputWindows
+                                              ? mSetInputWindowsListener
+                                              : nullptr);
+    mInputWindowInfos = std::move(inputWindowInfos);
+    mInputWindowIds = std::move(windowIds);
 }
 
 void SurfaceFlinger::commitInputWindowCommands() {
@@ -3663,6 +3867,14 @@ void SurfaceFlinger::initScheduler(DisplayId primaryDisplayId) {
 void SurfaceFlinger::commitTransaction()
 {
     commitTransactionLocked();
+    if (!mPendingTransactionTimes.empty()) {
+        const nsecs_t commitTime = systemTime();
+        for (auto& times : mPendingTransactionTimes) {
+            times.commitTime = commitTime;
+            mTimeStats->recordTransaction(times);
+        }
+        mPendingTransactionTimes.clear();
+    }
     mTransactionPending = false;
     mAnimTransactionPending = false;
     mTransactionCV.broadcast();
@@ -3735,6 +3947,7 @@ void SurfaceFlinger::invalidateLayerStack(const sp<const Layer>& layer, const Re
 bool SurfaceFlinger::handlePageFlip()
 {
     ATRACE_CALL();
+    FramePhaseProfiler::ScopedPhase phase(mFramePhaseProfiler, FramePhaseProfiler::Phase::PageFlip);
     ALOGV("handlePageFlip");
 
     nsecs_t latchTime = systemTime();
@@ -3787,7 +4000,7 @@ bool SurfaceFlinger::handlePageFlip()
     if (!mLayersWithQueuedFrames.empty()) {
         // mStateLock is needed for latchBuffer as LayerRejecter::reject()
         // writes to Layer current state. See also b/119481871
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         for (auto& layer : mLayersWithQueuedFrames) {
             if (layer->latchBuffer(visibleRegions, latchTime, expectedPresentTime)) {
@@ -3833,7 +4046,7 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
                                         uint32_t* outTransformHint) {
     // add this layer to the current state list
     {
-        Mutex::Autolock _l(mStateLock);
+        STATE_LOCK(_l);
         sp<Layer> parent;
         if (parentHandle != nullptr) {
             parent = fromHandleLocked(parentHandle).promote();
@@ -3850,7 +4063,10 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
             return NO_MEMORY;
         }
 
-        mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
+        {
+            std::lock_guard lock(mLayersByLocalBinderTokenLock);
+            mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
+        }
 
         if (parent == nullptr && addToCurrentState) {
             mCurrentState.layersSortedByZ.add(lbc);
@@ -3890,7 +4106,7 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
 
 void SurfaceFlinger::removeGraphicBufferProducerAsync(const wp<IBinder>& binder) {
     static_cast<void>(schedule([=] {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         mGraphicBufferProducerList.erase(binder);
     }));
 }
@@ -3925,29 +4141,59 @@ bool SurfaceFlinger::flushTransactionQueues() {
     // to prevent onHandleDestroyed from being called while the lock is held,
     // we must keep a copy of the transactions (specifically the composer
     // states) around outside the scope of the lock
-    std::vector<const TransactionState> transactions;
+    std::vector<TransactionState> transactions;
     bool flushedATransaction = false;
+    const bool recordTransactionTimes = mTimeStats->isEnabled();
     {
-        Mutex::Autolock _l(mStateLock);
+        STATE_LOCK(_l);
 
         auto it = mTransactionQueues.begin();
         while (it != mTransactionQueues.end()) {
             auto& [applyToken, transactionQueue] = *it;
 
             while (!transactionQueue.empty()) {
-                const auto& transaction = transactionQueue.front();
-                if (!transactionIsReadyToBeApplied(transaction.desiredPresentTime,
-                                                   transaction.states)) {
+                const TransactionBlockedOn blockedOn =
+                        transactionBlockedOn(transactionQueue.front().desiredPresentTime,
+                                             transactionQueue.front().states);
+                const nsecs_t now = recordTransactionTimes ? systemTime() : 0;
+                if (recordTransactionTimes) {
+                    transactionQueue.front().setBlockedOn(blockedOn, now);
+                }
+                if (blockedOn != TransactionBlockedOn::Nothing) {
                     setTransactionFlags(eTransactionFlushNeeded);
                     break;
                 }
-                transactions.push_back(transaction);
+                transactions.push_back(transactionQueue.front());
+                transactionQueue.pop();
+                auto& transaction = transactions.back();
+                std::vector<TimeStats::TransactionTimes> transactionTimes;
+                if (recordTransactionTimes) {
+                    transaction.times.readyTime = now;
+                    transactionTimes.push_back(transaction.times);
+                }
+
+                // Fold the ready transactions that follow into this one, so that a client
+                // updating the same layers repeatedly only pays for applying them once.
+                while (mMergeQueuedTransactions && !transactionQueue.empty() &&
+                       canMergeTransactions(transaction, transactionQueue.front()) &&
+                       transactionIsReadyToBeApplied(transactionQueue.front().desiredPresentTime,
+                                                     transactionQueue.front().states)) {
+                    if (recordTransactionTimes) {
+                        auto& merged = transactionQueue.front();
+                        merged.setBlockedOn(TransactionBlockedOn::Nothing, now);
+                        merged.times.readyTime = now;
+                        transactionTimes.push_back(merged.times);
+                    }
+                    mergeTransactionState(transaction, transactionQueue.front());
+                    transactionQueue.pop();
+                }
+
                 applyTransactionState(transaction.states, transaction.displays, transaction.flags,
                                       mPendingInputWindowCommands, transaction.desiredPresentTime,
                                       transaction.buffer, transaction.postTime,
                                       transaction.privileged, transaction.hasListenerCallbacks,
-                                      transaction.listenerCallbacks, /*isMainThread*/ true);
-                transactionQueue.pop();
+                                      transaction.listenerCallbacks, transactionTimes,
+                                      /*isMainThread*/ true);
                 flushedATransaction = true;
             }
 
@@ -3962,6 +4208,62 @@ bool SurfaceFlinger::flushTransactionQueues() {
     return flushedATransaction;
 }
 
+// Layer state changes that only set a value, where applying two changes in a row is the
+// same as applying the last one. Anything involving buffers, callbacks, barriers or the
+// layer hierarchy is excluded.
+static constexpr uint64_t kMergeableLayerStateChanges = layer_state_t::ePositionChanged |
+        layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+        layer_state_t::eTransparentRegionChanged | layer_state_t::eFlagsChanged |
+        layer_state_t::eLayerStackChanged | layer_state_t::eCropChanged_legacy |
+        layer_state_t::eShadowRadiusChanged | layer_state_t::eTransformChanged |
+        layer_state_t::eTransformToDisplayInverseChanged | layer_state_t::eCropChanged |
+        layer_state_t::eColorTransformChanged | layer_state_t::eCornerRadiusChanged |
+        layer_state_t::eFrameChanged | layer_state_t::eFrameRateSelectionPriority |
+        layer_state_t::eFrameRateChanged | layer_state_t::eBackgroundBlurRadiusChanged |
+        layer_state_t::eFixedTransformHintChanged;
+
+static bool hasOnlyMergeableChanges(const Vector<ComposerState>& states) {
+    for (const ComposerState& state : states) {
+        if (!state.state.surface || (state.state.what & ~kMergeableLayerStateChanges)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SurfaceFlinger::canMergeTransactions(const TransactionState& first,
+                                          const TransactionState& second) const {
+    // Keep the interceptor trace a faithful record of what clients sent
+    if (mInterceptor->isEnabled()) {
+        return false;
+    }
+
+    const auto canMerge = [](const TransactionState& transaction) {
+        return !(transaction.flags & (eSynchronous | eAnimation)) &&
+                transaction.displays.empty() && !transaction.buffer.isValid() &&
+                !transaction.hasListenerCallbacks && transaction.listenerCallbacks.empty() &&
+                hasOnlyMergeableChanges(transaction.states);
+    };
+    return first.flags == second.flags && first.privileged == second.privileged &&
+            canMerge(first) && canMerge(second);
+}
+
+void SurfaceFlinger::mergeTransactionState(TransactionState& into, const TransactionState& from) {
+    for (const ComposerState& state : from.states) {
+        bool merged = false;
+        for (size_t i = 0; i < into.states.size(); i++) {
+            if (into.states[i].state.surface == state.state.surface) {
+                into.states.editItemAt(i).state.merge(state.state);
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) {
+            into.states.add(state);
+        }
+    }
+}
+
 bool SurfaceFlinger::transactionFlushNeeded() {
     return !mTransactionQueues.empty();
 }
@@ -3969,7 +4271,11 @@ bool SurfaceFlinger::transactionFlushNeeded() {
 
 bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
                                                    const Vector<ComposerState>& states) {
+    return transactionIsReadyToBeApplied(desiredPresentTime, acquireFencesSignaled(states));
+}
 
+bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
+                                                   bool fencesSignaled) {
     const nsecs_t expectedPresentTime = mExpectedPresentTime.load();
     // Do not present if the desiredPresentTime has not passed unless it is more than one second
     // in the future. We ignore timestamps more than 1 second in the future for stability reasons.
@@ -3978,6 +4284,19 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
         return false;
     }
 
+    return fencesSignaled;
+}
+
+SurfaceFlinger::TransactionBlockedOn SurfaceFlinger::transactionBlockedOn(
+        int64_t desiredPresentTime, const Vector<ComposerState>& states) {
+    if (!transactionIsReadyToBeApplied(desiredPresentTime, /*fencesSignaled*/ true)) {
+        return TransactionBlockedOn::DesiredPresentTime;
+    }
+    return acquireFencesSignaled(states) ? TransactionBlockedOn::Nothing
+                                         : TransactionBlockedOn::Fences;
+}
+
+bool SurfaceFlinger::acquireFencesSignaled(const Vector<ComposerState>& states) {
     for (const ComposerState& state : states) {
         const layer_state_t& s = state.state;
         if (!(s.what & layer_state_t::eAcquireFenceChanged)) {
@@ -3990,14 +4309,49 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
     return true;
 }
 
+std::vector<SurfaceFlinger::PreparedClientState> SurfaceFlinger::prepareClientStates(
+        const Vector<ComposerState>& states, const client_cache_t& uncacheBuffer) {
+    ATRACE_CALL();
+
+    // Buffers added to or removed from the cache by this transaction only take effect when it
+    // is applied, so a lookup now could return a stale buffer.
+    bool canResolveCachedBuffers = !uncacheBuffer.isValid();
+    for (const ComposerState& state : states) {
+        const uint64_t what = state.state.what;
+        if ((what & layer_state_t::eBufferChanged) && (what & layer_state_t::eCachedBufferChanged)) {
+            canResolveCachedBuffers = false;
+            break;
+        }
+    }
+
+    std::vector<PreparedClientState> prepared(states.size());
+    for (size_t i = 0; i < states.size(); i++) {
+        const layer_state_t& s = states[i].state;
+        if (s.surface) {
+            prepared[i].layer = fromHandle(s.surface);
+        }
+        if (canResolveCachedBuffers && (s.what & layer_state_t::eCachedBufferChanged)) {
+            prepared[i].cachedBuffer = ClientCache::getInstance().get(s.cachedBuffer);
+        }
+    }
+    return prepared;
+}
+
 void SurfaceFlinger::setTransactionState(
         const Vector<ComposerState>& states, const Vector<DisplayState>& displays, uint32_t flags,
         const sp<IBinder>& applyToken, const InputWindowCommands& inputWindowCommands,
-        int64_t desiredPresentTime, const client_cache_t& uncacheBuffer, bool hasListenerCallbacks,
-        const std::vector<ListenerCallbacks>& listenerCallbacks) {
+        int64_t desiredPresentTime, int64_t applyTime, const client_cache_t& uncacheBuffer,
+        bool hasListenerCallbacks, const std::vector<ListenerCallbacks>& listenerCallbacks) {
     ATRACE_CALL();
 
     const int64_t postTime = systemTime();
+    const bool recordTransactionTimes = mTimeStats->isEnabled();
+    TimeStats::TransactionTimes transactionTimes;
+    if (recordTransactionTimes) {
+        transactionTimes.uid = static_cast<int32_t>(IPCThreadState::self()->getCallingUid());
+        transactionTimes.applyTime = applyTime;
+        transactionTimes.postTime = postTime;
+    }
 
     bool privileged = callingThreadHasUnscopedSurfaceFlingerAccess();
 
@@ -4005,7 +4359,14 @@ void SurfaceFlinger::setTransactionState(
         checkVirtualDisplayHint(displays);
     }
 
-    Mutex::Autolock _l(mStateLock);
+    // Do as much of the per-state work as possible before taking mStateLock, so that the main
+    // thread is not held up by binder threads. This must outlive the lock below, so that any
+    // buffer references it drops are not released with mStateLock held.
+    const std::vector<PreparedClientState> preparedStates =
+            prepareClientStates(states, uncacheBuffer);
+    const bool fencesSignaled = acquireFencesSignaled(states);
+
+    STATE_LOCK(_l);
 
     // If its TransactionQueue already has a pending TransactionState or if it is pending
     auto itr = mTransactionQueues.find(applyToken);
@@ -4030,17 +4391,32 @@ void SurfaceFlinger::setTransactionState(
         mExpectedPresentTime = calculateExpectedPresentTime(systemTime());
     }
 
-    if (pendingTransactions || !transactionIsReadyToBeApplied(desiredPresentTime, states)) {
-        mTransactionQueues[applyToken].emplace(states, displays, flags, desiredPresentTime,
-                                               uncacheBuffer, postTime, privileged,
-                                               hasListenerCallbacks, listenerCallbacks);
+    if (pendingTransactions || !transactionIsReadyToBeApplied(desiredPresentTime, fencesSignaled)) {
+        auto& transactionQueue = mTransactionQueues[applyToken];
+        transactionQueue.emplace(states, displays, flags, desiredPresentTime, uncacheBuffer,
+                                 postTime, privileged, hasListenerCallbacks, listenerCallbacks);
+        if (recordTransactionTimes) {
+            // A transaction queued behind others is not blocked on anything of its own yet.
+            auto& transaction = transactionQueue.back();
+            transaction.times = transactionTimes;
+            transaction.setBlockedOn(pendingTransactions
+                                             ? TransactionBlockedOn::Nothing
+                                             : transactionBlockedOn(desiredPresentTime, states),
+                                     postTime);
+        }
         setTransactionFlags(eTransactionFlushNeeded);
         return;
     }
 
+    std::vector<TimeStats::TransactionTimes> readyTransactionTimes;
+    if (recordTransactionTimes) {
+        transactionTimes.readyTime = systemTime();
+        readyTransactionTimes.push_back(transactionTimes);
+    }
     applyTransactionState(states, displays, flags, inputWindowCommands, desiredPresentTime,
                           uncacheBuffer, postTime, privileged, hasListenerCallbacks,
-                          listenerCallbacks);
+                          listenerCallbacks, readyTransactionTimes, /*isMainThread*/ false,
+                          &preparedStates);
 }
 
 void SurfaceFlinger::applyTransactionState(
@@ -4048,7 +4424,8 @@ void SurfaceFlinger::applyTransactionState(
         const InputWindowCommands& inputWindowCommands, const int64_t desiredPresentTime,
         const client_cache_t& uncacheBuffer, const int64_t postTime, bool privileged,
         bool hasListenerCallbacks, const std::vector<ListenerCallbacks>& listenerCallbacks,
-        bool isMainThread) {
+        const std::vector<TimeStats::TransactionTimes>& transactionTimes, bool isMainThread,
+        const std::vector<PreparedClientState>* preparedStates) {
     uint32_t transactionFlags = 0;
 
     if (flags & eAnimation) {
@@ -4081,11 +4458,15 @@ void SurfaceFlinger::applyTransactionState(
 
     std::unordered_set<ListenerCallbacks, ListenerCallbacksHash> listenerCallbacksWithSurfaces;
     uint32_t clientStateFlags = 0;
-    for (const ComposerState& state : states) {
+    for (size_t i = 0; i < states.size(); i++) {
+        const ComposerState& state = states[i];
+        const PreparedClientState* prepared = preparedStates ? &(*preparedStates)[i] : nullptr;
         clientStateFlags |= setClientStateLocked(state, desiredPresentTime, postTime, privileged,
-                                                 listenerCallbacksWithSurfaces);
+                                                 listenerCallbacksWithSurfaces, prepared);
         if ((flags & eAnimation) && state.state.surface) {
-            if (const auto layer = fromHandleLocked(state.state.surface).promote(); layer) {
+            const auto layer =
+                    (prepared ? prepared->layer : fromHandleLocked(state.state.surface)).promote();
+            if (layer) {
                 mScheduler->recordLayerHistory(layer.get(), desiredPresentTime,
                                                LayerHistory::LayerUpdateType::AnimationTX);
             }
@@ -4118,6 +4499,14 @@ void SurfaceFlinger::applyTransactionState(
         transactionFlags = eTransactionNeeded;
     }
 
+    // Transactions that change nothing are never committed, so their latency is not recorded.
+    if (transactionFlags) {
+        for (const auto& times : transactionTimes) {
+            if (mPendingTransactionTimes.size() == MAX_PENDING_TRANSACTION_TIMES) break;
+            mPendingTransactionTimes.push_back(times);
+        }
+    }
+
     // If we are on the main thread, we are about to preform a traversal. Clear the traversal bit
     // so we don't have to wake up again next frame to preform an uneeded traversal.
     if (isMainThread && (transactionFlags & eTraversalNeeded)) {
@@ -4305,7 +4694,8 @@ bool SurfaceFlinger::callingThreadHasUnscopedSurfaceFlingerAccess(bool usePermis
 uint32_t SurfaceFlinger::setClientStateLocked(
         const ComposerState& composerState, int64_t desiredPresentTime, int64_t postTime,
         bool privileged,
-        std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& listenerCallbacks) {
+        std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& listenerCallbacks,
+        const PreparedClientState* prepared) {
     const layer_state_t& s = composerState.state;
 
     for (auto& listener : s.listeners) {
@@ -4317,7 +4707,7 @@ uint32_t SurfaceFlinger::setClientStateLocked(
 
     sp<Layer> layer = nullptr;
     if (s.surface) {
-        layer = fromHandleLocked(s.surface).promote();
+        layer = (prepared ? prepared->layer : fromHandleLocked(s.surface)).promote();
     } else {
         // The client may provide us a null handle. Treat it as if the layer was removed.
         ALOGW("Attempt to set client state with a null layer handle");
@@ -4600,7 +4990,8 @@ uint32_t SurfaceFlinger::setClientStateLocked(
             }
         }
     } else if (cacheIdChanged) {
-        buffer = ClientCache::getInstance().get(s.cachedBuffer);
+        buffer = prepared && prepared->cachedBuffer ? prepared->cachedBuffer
+                                                    : ClientCache::getInstance().get(s.cachedBuffer);
     } else if (bufferChanged) {
         buffer = s.buffer;
     }
@@ -4637,7 +5028,7 @@ status_t SurfaceFlinger::mirrorLayer(const sp<Client>& client, const sp<IBinder>
     std::string uniqueName = getUniqueLayerName("MirrorRoot");
 
     {
-        Mutex::Autolock _l(mStateLock);
+        STATE_LOCK(_l);
         mirrorFrom = fromHandleLocked(mirrorFromHandle).promote();
         if (!mirrorFrom) {
             return NAME_NOT_FOUND;
@@ -4747,26 +5138,45 @@ status_t SurfaceFlinger::createLayer(const String8& name, const sp<Client>& clie
 }
 
 std::string SurfaceFlinger::getUniqueLayerName(const char* name) {
-    unsigned dupeCounter = 0;
-
-    // Tack on our counter whether there is a hit or not, so everyone gets a tag
-    std::string uniqueName = base::StringPrintf("%s#%u", name, dupeCounter);
-
-    // Grab the state lock since we're accessing mCurrentState
-    Mutex::Autolock lock(mStateLock);
+    // Tack on our counter whether there is a hit or not, so everyone gets a tag. The counter is
+    // the lowest one not in use, found in a single pass over the layers, as this runs with the
+    // state lock held for every layer created.
+    const std::string prefix = base::StringPrintf("%s#", name);
+    std::vector<bool> countersInUse;
+    {
+        // Grab the state lock since we're accessing mCurrentState
+        STATE_LOCK(lock);
 
-    // Loop over layers until we're sure there is no matching name
-    bool matchFound = true;
-    while (matchFound) {
-        matchFound = false;
+        // The lowest unused counter is at most the number of layers, so larger ones can be
+        // ignored.
+        const size_t maxCounter = mNumLayers;
         mCurrentState.traverse([&](Layer* layer) {
-            if (layer->getName() == uniqueName) {
-                matchFound = true;
-                uniqueName = base::StringPrintf("%s#%u", name, ++dupeCounter);
+            const std::string& layerName = layer->getName();
+            if (layerName.size() <= prefix.size() ||
+                layerName.compare(0, prefix.size(), prefix) != 0) {
+                return;
+            }
+            // Only count suffixes that are formatted the way this function formats them.
+            const char* suffix = layerName.c_str() + prefix.size();
+            char* end = nullptr;
+            const unsigned long counter = strtoul(suffix, &end, 10);
+            if (*end != '\0' || !isdigit(suffix[0]) || (suffix[0] == '0' && suffix[1] != '\0') ||
+                counter > maxCounter) {
+                return;
             }
+            if (counter >= countersInUse.size()) {
+                countersInUse.resize(counter + 1);
+            }
+            countersInUse[counter] = true;
         });
     }
 
+    unsigned dupeCounter = 0;
+    while (dupeCounter < countersInUse.size() && countersInUse[dupeCounter]) {
+        dupeCounter++;
+    }
+    std::string uniqueName = prefix + std::to_string(dupeCounter);
+
     ALOGV_IF(dupeCounter > 0, "duplicate layer name: changing %s to %s", name, uniqueName.c_str());
     return uniqueName;
 }
@@ -4795,7 +5205,7 @@ status_t SurfaceFlinger::createBufferQueueLayer(const sp<Client>& client, std::s
         // Grab the SF state lock during this since it's the only safe way to access
         // RenderEngine when creating a BufferLayerConsumer
         // TODO: Check if this lock is still needed here
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         layer = getFactory().createBufferQueueLayer(args);
     }
 
@@ -4850,7 +5260,7 @@ void SurfaceFlinger::markLayerPendingRemovalLocked(const sp<Layer>& layer) {
 
 void SurfaceFlinger::onHandleDestroyed(sp<Layer>& layer)
 {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     // If a layer has a parent, we allow it to out-live it's handle
     // with the idea that the parent holds a reference and will eventually
     // be cleaned up. However no one cleans up the top-level so we do so
@@ -4860,12 +5270,15 @@ void SurfaceFlinger::onHandleDestroyed(sp<Layer>& layer)
     }
     markLayerPendingRemovalLocked(layer);
 
-    auto it = mLayersByLocalBinderToken.begin();
-    while (it != mLayersByLocalBinderToken.end()) {
-        if (it->second == layer) {
-            it = mLayersByLocalBinderToken.erase(it);
-        } else {
-            it++;
+    {
+        std::lock_guard lock(mLayersByLocalBinderTokenLock);
+        auto it = mLayersByLocalBinderToken.begin();
+        while (it != mLayersByLocalBinderToken.end()) {
+            if (it->second == layer) {
+                it = mLayersByLocalBinderToken.erase(it);
+            } else {
+                it++;
+            }
         }
     }
 
@@ -4895,8 +5308,8 @@ void SurfaceFlinger::onInitializeDisplays() {
     d.width = 0;
     d.height = 0;
     displays.add(d);
-    setTransactionState(state, displays, 0, nullptr, mPendingInputWindowCommands, -1, {}, false,
-                        {});
+    setTransactionState(state, displays, 0, nullptr, mPendingInputWindowCommands, -1, systemTime(),
+                        {}, false, {});
 
     setPowerModeInternal(display, hal::PowerMode::ON);
 
@@ -4981,6 +5394,9 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
         getHwComposer().setPowerMode(*displayId, mode);
         mVisibleRegionsDirty = true;
         // from this point on, SF will stop drawing on this display
+
+        // Buffers pooled for reuse won't be needed before the display is back on.
+        GraphicBufferAllocator::get().trimPool();
     } else if (mode == hal::PowerMode::DOZE || mode == hal::PowerMode::ON) {
         // Update display while dozing
         getHwComposer().setPowerMode(*displayId, mode);
@@ -5047,7 +5463,7 @@ void SurfaceFlinger::setPowerModeOnMainThread(const sp<IBinder>& displayToken, i
 void SurfaceFlinger::setPowerMode(const sp<IBinder>& displayToken, int mode) {
     sp<DisplayDevice> display = nullptr;
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         display = (getDisplayDeviceLocked(displayToken));
     }
     if (!display) {
@@ -5114,9 +5530,12 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                  dumper([this](std::string& s) { mScheduler->getPrimaryDispSync().dump(s); })},
                 {"--edid"s, argsDumper(&SurfaceFlinger::dumpRawDisplayIdentificationData)},
                 {"--frame-events"s, dumper(&SurfaceFlinger::dumpFrameEventsLocked)},
+                {"--frame-phases"s, dumper(&SurfaceFlinger::dumpFramePhases)},
                 {"--latency"s, argsDumper(&SurfaceFlinger::dumpStatsLocked)},
                 {"--latency-clear"s, argsDumper(&SurfaceFlinger::clearStatsLocked)},
                 {"--list"s, dumper(&SurfaceFlinger::listLayersLocked)},
+                {"--lock-stats"s, dumper(&SurfaceFlinger::dumpLockStats)},
+                {"--lock-stats-clear"s, dumper(&SurfaceFlinger::clearLockStats)},
                 {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
                 {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
@@ -5125,6 +5544,12 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
 
         const auto flag = args.empty() ? ""s : std::string(String8(args[0]));
 
+        const auto it = dumpers.find(flag);
+        const bool dumpAll = it == dumpers.end() && !asProto;
+        if (dumpAll) {
+            dumpConfiguration(args, result);
+        }
+
         bool dumpLayers = true;
         {
             TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
@@ -5133,14 +5558,18 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                               strerror(-lock.status), lock.status);
             }
 
-            if (const auto it = dumpers.find(flag); it != dumpers.end()) {
+            if (it != dumpers.end()) {
                 (it->second)(args, asProto, result);
                 dumpLayers = false;
-            } else if (!asProto) {
+            } else if (dumpAll) {
                 dumpAllLocked(args, result);
             }
         }
 
+        if (dumpAll) {
+            dumpAllocationsAndTimeStats(result);
+        }
+
         if (dumpLayers) {
             const LayersProto layersProto = dumpProtoFromMainThread();
             if (asProto) {
@@ -5276,6 +5705,18 @@ void SurfaceFlinger::dumpStaticScreenStats(std::string& result) const {
                   bucketTimeSec, percent);
 }
 
+void SurfaceFlinger::dumpFramePhases(std::string& result) const {
+    mFramePhaseProfiler.dump(result);
+}
+
+void SurfaceFlinger::dumpLockStats(std::string& result) const {
+    mStateLockProfiler.dump(result);
+}
+
+void SurfaceFlinger::clearLockStats(std::string& /*result*/) {
+    mStateLockProfiler.clear();
+}
+
 void SurfaceFlinger::recordBufferingStats(const std::string& layerName,
                                           std::vector<OccupancyTracker::Segment>&& history) {
     Mutex::Autolock lock(getBE().mBufferingStatsMutex);
@@ -5467,15 +5908,10 @@ void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
                   }).get());
 }
 
-void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
+void SurfaceFlinger::dumpConfiguration(const DumpArgs& args, std::string& result) const {
     const bool colorize = !args.empty() && args[0] == String16("--color");
     Colorizer colorizer(colorize);
 
-    // figure out if we're stuck somewhere
-    const nsecs_t now = systemTime();
-    const nsecs_t inTransaction(mDebugInTransaction);
-    nsecs_t inTransactionDuration = (inTransaction) ? now-inTransaction : 0;
-
     /*
      * Dump library configuration.
      */
@@ -5488,17 +5924,28 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     appendGuiConfigString(result);
     result.append("\n");
 
+    colorizer.bold(result);
+    result.append("Sync configuration: ");
+    colorizer.reset(result);
+    result.append(SyncFeatures::getInstance().toString());
+    result.append("\n");
+}
+
+void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
+    const bool colorize = !args.empty() && args[0] == String16("--color");
+    Colorizer colorizer(colorize);
+
+    // figure out if we're stuck somewhere
+    const nsecs_t now = systemTime();
+    const nsecs_t inTransaction(mDebugInTransaction);
+    nsecs_t inTransactionDuration = (inTransaction) ? now-inTransaction : 0;
+
     result.append("\nDisplay identification data:\n");
     dumpDisplayIdentificationData(result);
 
     result.append("\nWide-Color information:\n");
     dumpWideColorInfo(result);
-
-    colorizer.bold(result);
-    result.append("Sync configuration: ");
-    colorizer.reset(result);
-    result.append(SyncFeatures::getInstance().toString());
-    result.append("\n\n");
+    result.append("\n");
 
     colorizer.bold(result);
     result.append("Scheduler:\n");
@@ -5624,12 +6071,6 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     StringAppendF(&result, "  h/w composer %s\n", hwcDisabled ? "disabled" : "enabled");
     getHwComposer().dump(result);
 
-    /*
-     * Dump gralloc state
-     */
-    const GraphicBufferAllocator& alloc(GraphicBufferAllocator::get());
-    alloc.dump(result);
-
     /*
      * Dump VrFlinger state if in use.
      */
@@ -5638,6 +6079,14 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
         result.append(mVrFlinger->Dump());
         result.append("\n");
     }
+}
+
+void SurfaceFlinger::dumpAllocationsAndTimeStats(std::string& result) const {
+    /*
+     * Dump gralloc state. This lists every buffer, so is one of the longest sections.
+     */
+    const GraphicBufferAllocator& alloc(GraphicBufferAllocator::get());
+    alloc.dump(result);
 
     result.append(mTimeStats->miniDump());
     result.append("\n");
@@ -5750,6 +6199,7 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
         }
         case CAPTURE_LAYERS:
         case CAPTURE_SCREEN:
+        case CAPTURE_SCREEN_ASYNC:
         case ADD_REGION_SAMPLING_LISTENER:
         case REMOVE_REGION_SAMPLING_LISTENER: {
             // codes that require permission check
@@ -5781,9 +6231,9 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
         code == IBinder::SYSPROPS_TRANSACTION) {
         return OK;
     }
-    // Numbers from 1000 to 1036 and 20000 are currently used for backdoors. The code
+    // Numbers from 1000 to 1037 and 20000 are currently used for backdoors. The code
     // in onTransact verifies that the user is root, and has access to use SF.
-    if ((code >= 1000 && code <= 1036) || (code == 20000)) {
+    if ((code >= 1000 && code <= 1037) || (code == 20000)) {
         ALOGV("Accessing SurfaceFlinger through backdoor code: %u", code);
         return OK;
     }
@@ -5827,7 +6277,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 return NO_ERROR;
             }
             case 1005:{ // force transaction
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 setTransactionFlags(
                         eTransactionNeeded|
                         eDisplayTransactionNeeded|
@@ -5867,7 +6317,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 return NO_ERROR;
             }
             case 1014: {
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 // daltonize
                 n = data.readInt32();
                 switch (n % 10) {
@@ -5894,7 +6344,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 return NO_ERROR;
             }
             case 1015: {
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 // apply a color matrix
                 n = data.readInt32();
                 if (n) {
@@ -5954,7 +6404,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 return NO_ERROR;
             }
             case 1022: { // Set saturation boost
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 mGlobalSaturationFactor = std::max(0.0f, std::min(data.readFloat(), 2.0f));
 
                 updateColorMatrixLocked();
@@ -6023,7 +6473,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
             }
             // Is VrFlinger active?
             case 1028: {
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 reply->writeBool(getHwComposer().isUsingVrComposer());
                 return NO_ERROR;
             }
@@ -6052,7 +6502,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
             // to restore: adb shell service call SurfaceFlinger 1031 i32 0 && \
             // adb shell stop zygote && adb shell start zygote
             case 1031: {
-                Mutex::Autolock _l(mStateLock);
+                STATE_LOCK(_l);
                 n = data.readInt32();
                 if (n) {
                     n = data.readInt32();
@@ -6093,7 +6543,7 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                         enableRefreshRateOverlay(static_cast<bool>(n));
                         break;
                     default: {
-                        Mutex::Autolock lock(mStateLock);
+                        STATE_LOCK(lock);
                         reply->writeBool(mRefreshRateOverlay != nullptr);
                     }
                 }
@@ -6125,6 +6575,15 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 }
                 return NO_ERROR;
             }
+            // Throttle the app vsync events of a uid to a frame rate.
+            // Usage: adb shell service call SurfaceFlinger 1037 i32 <uid> f <fps>
+            // A frame rate of 0 removes the override.
+            case 1037: {
+                const auto uid = static_cast<uid_t>(data.readInt32());
+                const float frameRate = data.readFloat();
+                mScheduler->setFrameRateOverride(mAppConnectionHandle, uid, frameRate);
+                return NO_ERROR;
+            }
             case 20000: {
               uint64_t disp = data.readUint64();
               int mode = data.readInt32();
@@ -6152,7 +6611,7 @@ void SurfaceFlinger::kernelTimerChanged(bool expired) {
     static bool updateOverlay =
             property_get_bool("debug.sf.kernel_idle_timer_update_overlay", true);
     if (!updateOverlay) return;
-    if (Mutex::Autolock lock(mStateLock); !mRefreshRateOverlay) return;
+    if (STATE_LOCK(lock); !mRefreshRateOverlay) return;
 
     // Update the overlay on the main thread to avoid race conditions with
     // mRefreshRateConfigs->getCurrentRefreshRate()
@@ -6166,7 +6625,7 @@ void SurfaceFlinger::kernelTimerChanged(bool expired) {
         if (current != min) {
             const bool timerExpired = mKernelIdleTimerEnabled && expired;
 
-            if (Mutex::Autolock lock(mStateLock); mRefreshRateOverlay) {
+            if (STATE_LOCK(lock); mRefreshRateOverlay) {
                 mRefreshRateOverlay->changeRefreshRate(timerExpired ? min : current);
             }
             mEventQueue->invalidate();
@@ -6224,6 +6683,26 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& displayToken,
                                        ui::Rotation rotation, bool captureSecureLayers) {
     ATRACE_CALL();
 
+    sp<Fence> fence;
+    const status_t result =
+            captureScreenAsync(displayToken, outBuffer, &fence, outCapturedSecureLayers,
+                               reqDataspace, reqPixelFormat, sourceCrop, reqWidth, reqHeight,
+                               useIdentityTransform, rotation, captureSecureLayers);
+    if (result == NO_ERROR) {
+        fence->waitForever(__FUNCTION__);
+    }
+    return result;
+}
+
+status_t SurfaceFlinger::captureScreenAsync(const sp<IBinder>& displayToken,
+                                            sp<GraphicBuffer>* outBuffer, sp<Fence>* outFence,
+                                            bool& outCapturedSecureLayers, Dataspace reqDataspace,
+                                            ui::PixelFormat reqPixelFormat,
+                                            const Rect& sourceCrop, uint32_t reqWidth,
+                                            uint32_t reqHeight, bool useIdentityTransform,
+                                            ui::Rotation rotation, bool captureSecureLayers) {
+    ATRACE_CALL();
+
     if (!displayToken) return BAD_VALUE;
 
     auto renderAreaRotation = ui::Transform::toRotationFlags(rotation);
@@ -6234,7 +6713,7 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& displayToken,
 
     sp<DisplayDevice> display;
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         display = getDisplayDeviceLocked(displayToken);
         if (!display) return NAME_NOT_FOUND;
@@ -6252,7 +6731,7 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& displayToken,
     auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
                                     std::placeholders::_1);
     return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat,
-                               useIdentityTransform, outCapturedSecureLayers);
+                               useIdentityTransform, outCapturedSecureLayers, outFence);
 }
 
 static Dataspace pickDataspaceFromColorMode(const ColorMode colorMode) {
@@ -6313,7 +6792,7 @@ status_t SurfaceFlinger::captureScreen(uint64_t displayOrLayerStack, Dataspace*
     uint32_t height;
     ui::Transform::RotationFlags captureOrientation;
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         display = getDisplayByIdOrLayerStack(displayOrLayerStack);
         if (!display) {
             return NAME_NOT_FOUND;
@@ -6451,7 +6930,7 @@ status_t SurfaceFlinger::captureLayers(
     std::unordered_set<sp<Layer>, ISurfaceComposer::SpHash<Layer>> excludeLayers;
     Rect displayViewport;
     {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
 
         parent = fromHandleLocked(layerHandleBinder).promote();
         if (parent == nullptr || parent->isRemovedFromCurrentState()) {
@@ -6544,7 +7023,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              sp<GraphicBuffer>* outBuffer,
                                              const ui::PixelFormat reqPixelFormat,
                                              bool useIdentityTransform,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers, sp<Fence>* outFence) {
     ATRACE_CALL();
 
     // TODO(b/116112787) Make buffer usage a parameter.
@@ -6556,14 +7035,14 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              usage, "screenshot");
 
     return captureScreenCommon(renderArea, traverseLayers, *outBuffer, useIdentityTransform,
-                               false /* regionSampling */, outCapturedSecureLayers);
+                               false /* regionSampling */, outCapturedSecureLayers, outFence);
 }
 
 status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              TraverseLayersFunction traverseLayers,
                                              const sp<GraphicBuffer>& buffer,
                                              bool useIdentityTransform, bool regionSampling,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers, sp<Fence>* outFence) {
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
@@ -6581,7 +7060,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                     status_t result = NO_ERROR;
                     int fd = -1;
 
-                    Mutex::Autolock lock(mStateLock);
+                    STATE_LOCK(lock);
                     renderArea.render([&] {
                         result = captureScreenImplLocked(renderArea, traverseLayers, buffer.get(),
                                                          useIdentityTransform, forSystem, &fd,
@@ -6592,7 +7071,13 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                 }).get();
     } while (result == EAGAIN);
 
-    if (result == NO_ERROR) {
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    if (outFence) {
+        *outFence = syncFd >= 0 ? new Fence(syncFd) : Fence::NO_FENCE;
+    } else {
         sync_wait(syncFd, -1);
         close(syncFd);
     }
@@ -6728,7 +7213,7 @@ status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
 }
 
 void SurfaceFlinger::setInputWindowsFinished() {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
 
     mPendingSyncInputWindows = false;
 
@@ -6773,7 +7258,7 @@ void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& disp
 status_t SurfaceFlinger::setDesiredDisplayConfigSpecsInternal(
         const sp<DisplayDevice>& display,
         const std::optional<scheduler::RefreshRateConfigs::Policy>& policy, bool overridePolicy) {
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
 
     LOG_ALWAYS_FATAL_IF(!display->isPrimary() && overridePolicy,
                         "Can only set override policy on the primary display");
@@ -6945,7 +7430,7 @@ status_t SurfaceFlinger::getDesiredDisplayConfigSpecs(const sp<IBinder>& display
         return BAD_VALUE;
     }
 
-    Mutex::Autolock lock(mStateLock);
+    STATE_LOCK(lock);
     const auto display = getDisplayDeviceLocked(displayToken);
     if (!display) {
         return NAME_NOT_FOUND;
@@ -6981,11 +7466,6 @@ void SurfaceFlinger::SetInputWindowsListener::onSetInputWindowsFinished() {
 }
 
 wp<Layer> SurfaceFlinger::fromHandle(const sp<IBinder>& handle) {
-    Mutex::Autolock _l(mStateLock);
-    return fromHandleLocked(handle);
-}
-
-wp<Layer> SurfaceFlinger::fromHandleLocked(const sp<IBinder>& handle) {
     BBinder* b = nullptr;
     if (handle) {
         b = handle->localBinder();
@@ -6993,6 +7473,7 @@ wp<Layer> SurfaceFlinger::fromHandleLocked(const sp<IBinder>& handle) {
     if (b == nullptr) {
         return nullptr;
     }
+    std::lock_guard lock(mLayersByLocalBinderTokenLock);
     auto it = mLayersByLocalBinderToken.find(b);
     if (it != mLayersByLocalBinderToken.end()) {
         return it->second;
@@ -7000,11 +7481,20 @@ wp<Layer> SurfaceFlinger::fromHandleLocked(const sp<IBinder>& handle) {
     return nullptr;
 }
 
+wp<Layer> SurfaceFlinger::fromHandleLocked(const sp<IBinder>& handle) {
+    return fromHandle(handle);
+}
+
 void SurfaceFlinger::onLayerFirstRef(Layer* layer) {
     mNumLayers++;
     mScheduler->registerLayer(layer);
 }
 
+void SurfaceFlinger::onLayerTransactionNeeded(Layer* layer) {
+    std::lock_guard lock(mLayersNeedingTransactionLock);
+    mLayersNeedingTransaction.push_back(layer);
+}
+
 void SurfaceFlinger::onLayerDestroyed(Layer* layer) {
     mNumLayers--;
     removeFromOffscreenLayers(layer);
@@ -7031,7 +7521,7 @@ void SurfaceFlinger::bufferErased(const client_cache_t& clientCacheId) {
 status_t SurfaceFlinger::setGlobalShadowSettings(const half4& ambientColor, const half4& spotColor,
                                                  float lightPosY, float lightPosZ,
                                                  float lightRadius) {
-    Mutex::Autolock _l(mStateLock);
+    STATE_LOCK(_l);
     mCurrentState.globalShadowSettings.ambientColor = vec4(ambientColor);
     mCurrentState.globalShadowSettings.spotColor = vec4(spotColor);
     mCurrentState.globalShadowSettings.lightPos.y = lightPosY;
@@ -7066,7 +7556,7 @@ status_t SurfaceFlinger::setFrameRate(const sp<IGraphicBufferProducer>& surface,
     }
 
     static_cast<void>(schedule([=] {
-        Mutex::Autolock lock(mStateLock);
+        STATE_LOCK(lock);
         if (authenticateSurfaceTextureLocked(surface)) {
             sp<Layer> layer = (static_cast<MonitoredProducer*>(surface.get()))->getLayer();
             if (layer->setFrameRate(
@@ -7160,7 +7650,7 @@ void SurfaceFlinger::enableRefreshRateOverlay(bool enable) {
         }
 
         {
-            Mutex::Autolock lock(mStateLock);
+            STATE_LOCK(lock);
 
             // Destroy the layer of the current overlay, if any, outside the lock.
             mRefreshRateOverlay.swap(overlay);
@@ -7276,7 +7766,7 @@ void SurfaceFlinger::handlePresentationDisplaysEarlyWakeup(size_t updatingDispla
         bool singleUpdatingDisplay = (updatingDisplays == 1);
 
         if (singleUpdatingDisplay) {
-            Mutex::Autolock lock(mStateLock);
+            STATE_LOCK(lock);
             const sp<DisplayDevice> display = getDisplayByLayerStack(layerStackId);
             internalDisplay = isInternalDisplay(display) && getHwcDisplayId(display, &hwcDisplayId);
         }
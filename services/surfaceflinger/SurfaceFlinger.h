@@ -34,6 +34,7 @@
 #include <gui/LayerState.h>
 #include <gui/OccupancyTracker.h>
 #include <input/ISetInputWindowsListener.h>
+#include <input/InputWindow.h>
 #include <layerproto/LayerProtoHeader.h>
 #include <math/mat4.h>
 #include <renderengine/LayerSettings.h>
@@ -54,16 +55,20 @@
 #include "DisplayHardware/HWC2.h"
 #include "DisplayHardware/PowerAdvisor.h"
 #include "Effects/Daltonizer.h"
+#include "FramePhaseProfiler.h"
 #include "FrameTracker.h"
 #include "LayerVector.h"
+#include "LockContentionProfiler.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
 #include "Scheduler/Scheduler.h"
 #include "Scheduler/VSyncModulator.h"
 #include "SurfaceFlingerFactory.h"
 #include "SurfaceTracing.h"
+#include "TimeStats/TimeStats.h"
 #include "TracedOrdinal.h"
 #include "TransactionCompletedThread.h"
+#include "WorkerPool.h"
 
 #include <atomic>
 #include <cstdint>
@@ -388,6 +393,9 @@ public:
 
     void onLayerFirstRef(Layer*);
     void onLayerDestroyed(Layer*);
+    // Called by a layer when it sets eTransactionNeeded, so that handleTransactionLocked only
+    // needs to visit the layers that changed. May be called from any thread.
+    void onLayerTransactionNeeded(Layer*);
 
     void removeFromOffscreenLayers(Layer* layer);
 
@@ -399,7 +407,8 @@ public:
     // Returns nullptr if the handle does not point to an existing layer.
     // Otherwise, returns a weak reference so that callers off the main-thread
     // won't accidentally hold onto the last strong reference.
-    wp<Layer> fromHandle(const sp<IBinder>& handle);
+    // Does not need mStateLock, the handle map has its own lock.
+    wp<Layer> fromHandle(const sp<IBinder>& handle) EXCLUDES(mLayersByLocalBinderTokenLock);
     wp<Layer> fromHandleLocked(const sp<IBinder>& handle) REQUIRES(mStateLock);
 
     // Inherit from ClientCache::ErasedRecipient
@@ -409,6 +418,21 @@ public:
     // debug.sf.disable_client_composition_cache
     bool mDisableClientCompositionCache = false;
 
+    // If set, pre-renders unchanged bottom-most client composited layers into
+    // an offscreen buffer. This can be set by
+    // debug.sf.client_composition_layer_set_cache
+    bool mEnableClientCompositionLayerSetCache = false;
+
+    // If set, client composition only redraws the part of the client target
+    // that changed since the dequeued buffer was last drawn. This can be set by
+    // debug.sf.enable_partial_client_composition
+    bool mEnablePartialClientComposition = false;
+
+    // If set, runs of device composited layers that have not changed for a
+    // while are presented to the HWC from a single flattened buffer. This can
+    // be set by debug.sf.enable_layer_flattening
+    bool mEnableLayerFlattening = false;
+
     nsecs_t mVsyncTimeStamp = -1;
 
 private:
@@ -492,8 +516,8 @@ private:
                              const Vector<DisplayState>& displays, uint32_t flags,
                              const sp<IBinder>& applyToken,
                              const InputWindowCommands& inputWindowCommands,
-                             int64_t desiredPresentTime, const client_cache_t& uncacheBuffer,
-                             bool hasListenerCallbacks,
+                             int64_t desiredPresentTime, int64_t applyTime,
+                             const client_cache_t& uncacheBuffer, bool hasListenerCallbacks,
                              const std::vector<ListenerCallbacks>& listenerCallbacks) override;
     void bootFinished() override;
     bool authenticateSurfaceTexture(
@@ -508,6 +532,12 @@ private:
                            ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
                            uint32_t reqWidth, uint32_t reqHeight, bool useIdentityTransform,
                            ui::Rotation rotation, bool captureSecureLayers) override;
+    status_t captureScreenAsync(const sp<IBinder>& displayToken, sp<GraphicBuffer>* outBuffer,
+                                sp<Fence>* outFence, bool& outCapturedSecureLayers,
+                                ui::Dataspace reqDataspace, ui::PixelFormat reqPixelFormat,
+                                const Rect& sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
+                                bool useIdentityTransform, ui::Rotation rotation,
+                                bool captureSecureLayers) override;
     status_t captureScreen(uint64_t displayOrLayerStack, ui::Dataspace* outDataspace,
                            sp<GraphicBuffer>* outBuffer) override;
     status_t captureLayers(
@@ -667,6 +697,10 @@ private:
     // incoming transactions
     void onMessageInvalidate(nsecs_t expectedVSyncTime);
 
+    // Returns true if the screen is idle and the INVALIDATE message has no work to do, in which
+    // case the rest of the frame, including composition and the HWC present, is skipped.
+    bool canBypassComposition();
+
     // Returns whether the transaction actually modified any state
     bool handleMessageTransaction();
 
@@ -697,6 +731,21 @@ private:
     /* ------------------------------------------------------------------------
      * Transactions
      */
+    // Lookups for a ComposerState that setTransactionState() does on the calling binder
+    // thread before taking mStateLock. They are only used if the transaction is applied
+    // right away; queued transactions resolve everything when they are applied.
+    struct PreparedClientState {
+        // Weak, so that the binder thread never holds the last reference to a layer; it is
+        // promoted when the transaction is applied, just like fromHandleLocked() would.
+        wp<Layer> layer;
+        // Only set for states that reference a buffer already in the ClientCache
+        sp<GraphicBuffer> cachedBuffer;
+    };
+    std::vector<PreparedClientState> prepareClientStates(const Vector<ComposerState>& states,
+                                                         const client_cache_t& uncacheBuffer);
+    // Returns false if any acquire fence in the transaction has not signaled yet
+    static bool acquireFencesSignaled(const Vector<ComposerState>& states);
+
     void applyTransactionState(const Vector<ComposerState>& state,
                                const Vector<DisplayState>& displays, uint32_t flags,
                                const InputWindowCommands& inputWindowCommands,
@@ -704,7 +753,10 @@ private:
                                const client_cache_t& uncacheBuffer, const int64_t postTime,
                                bool privileged, bool hasListenerCallbacks,
                                const std::vector<ListenerCallbacks>& listenerCallbacks,
-                               bool isMainThread = false) REQUIRES(mStateLock);
+                               const std::vector<TimeStats::TransactionTimes>& transactionTimes,
+                               bool isMainThread = false,
+                               const std::vector<PreparedClientState>* preparedStates = nullptr)
+            REQUIRES(mStateLock);
     // Returns true if at least one transaction was flushed
     bool flushTransactionQueues();
     // Returns true if there is at least one transaction that needs to be flushed
@@ -724,6 +776,11 @@ private:
     void commitOffscreenLayers();
     bool transactionIsReadyToBeApplied(int64_t desiredPresentTime,
                                        const Vector<ComposerState>& states);
+    bool transactionIsReadyToBeApplied(int64_t desiredPresentTime, bool fencesSignaled);
+    // What keeps a transaction in its queue, if anything.
+    enum class TransactionBlockedOn { Nothing, DesiredPresentTime, Fences };
+    TransactionBlockedOn transactionBlockedOn(int64_t desiredPresentTime,
+                                              const Vector<ComposerState>& states);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     void checkVirtualDisplayHint(const Vector<DisplayState>& displays);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
@@ -733,8 +790,8 @@ protected:
     virtual uint32_t setClientStateLocked(
             const ComposerState& composerState, int64_t desiredPresentTime, int64_t postTime,
             bool privileged,
-            std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& listenerCallbacks)
-            REQUIRES(mStateLock);
+            std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& listenerCallbacks,
+            const PreparedClientState* prepared = nullptr) REQUIRES(mStateLock);
     virtual void commitTransactionLocked();
 
     // Used internally by computeLayerBounds() to gets the clip rectangle to use for the
@@ -802,12 +859,16 @@ private:
     void renderScreenImplLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                 ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                 bool regionSampling, int* outSyncFd);
+    // If outFence is set, it receives the fence that signals once the capture has been rendered,
+    // and the call returns without waiting for it.
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  sp<GraphicBuffer>* outBuffer, const ui::PixelFormat reqPixelFormat,
-                                 bool useIdentityTransform, bool& outCapturedSecureLayers);
+                                 bool useIdentityTransform, bool& outCapturedSecureLayers,
+                                 sp<Fence>* outFence = nullptr);
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  const sp<GraphicBuffer>& buffer, bool useIdentityTransform,
-                                 bool regionSampling, bool& outCapturedSecureLayers);
+                                 bool regionSampling, bool& outCapturedSecureLayers,
+                                 sp<Fence>* outFence = nullptr);
     sp<DisplayDevice> getDisplayByIdOrLayerStack(uint64_t displayOrLayerStack) REQUIRES(mStateLock);
     sp<DisplayDevice> getDisplayByLayerStack(uint64_t layerStack) REQUIRES(mStateLock);
     status_t captureScreenImplLocked(const RenderArea& renderArea,
@@ -1030,7 +1091,11 @@ private:
         return std::bind(dump, this, _1, _2, _3);
     }
 
+    // The full dump is split so that the parts that do not need mStateLock are formatted
+    // without holding it.
+    void dumpConfiguration(const DumpArgs& args, std::string& result) const;
     void dumpAllLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
+    void dumpAllocationsAndTimeStats(std::string& result) const;
 
     void appendSfConfigString(std::string& result) const;
     void listLayersLocked(std::string& result) const;
@@ -1041,6 +1106,9 @@ private:
 
     void dumpVSync(std::string& result) const REQUIRES(mStateLock);
     void dumpStaticScreenStats(std::string& result) const;
+    void dumpFramePhases(std::string& result) const;
+    void dumpLockStats(std::string& result) const;
+    void clearLockStats(std::string& result);
     // Not const because each Layer needs to query Fences and cache timestamps.
     void dumpFrameEventsLocked(std::string& result);
 
@@ -1113,6 +1181,8 @@ private:
 
     // access must be protected by mStateLock
     mutable Mutex mStateLock;
+    // Time spent waiting for mStateLock by call site, see dumpsys --lock-stats.
+    mutable LockContentionProfiler mStateLockProfiler{"mStateLock"};
     mutable Mutex mVsyncLock;
     mutable Mutex mDolphinStateLock;
     State mCurrentState{LayerVector::StateSet::Current};
@@ -1123,6 +1193,12 @@ private:
     SortedVector<sp<Layer>> mLayersPendingRemoval;
     bool mForceTraversal = false;
 
+    // Layers that have set eTransactionNeeded since the last traversal. When enabled,
+    // handleTransactionLocked visits these instead of walking the whole current state.
+    bool mTrackLayersNeedingTransaction = true;
+    std::mutex mLayersNeedingTransactionLock;
+    std::vector<wp<Layer>> mLayersNeedingTransaction GUARDED_BY(mLayersNeedingTransactionLock);
+
     // global color transform states
     Daltonizer mDaltonizer;
     float mGlobalSaturationFactor = 1.0f;
@@ -1151,6 +1227,9 @@ private:
     bool mVisibleRegionsDirty = false;
     // Set during transaction commit stage to track if the input info for a layer has changed.
     bool mInputInfoChanged = false;
+    // The input windows last sent to InputFlinger, by id and in the order they were sent.
+    std::unordered_map<int32_t, InputWindowInfo> mInputWindowInfos;
+    std::vector<int32_t> mInputWindowIds;
     bool mGeometryInvalid = false;
     bool mAnimCompositionPending = false;
     std::vector<sp<Layer>> mLayersWithQueuedFrames;
@@ -1186,7 +1265,11 @@ private:
     std::map<wp<IBinder>, sp<DisplayDevice>> mDisplays GUARDED_BY(mStateLock);
     std::unordered_map<DisplayId, sp<IBinder>> mPhysicalDisplayTokens GUARDED_BY(mStateLock);
 
-    std::unordered_map<BBinder*, wp<Layer>> mLayersByLocalBinderToken GUARDED_BY(mStateLock);
+    // Guarded by its own lock so that binder threads can resolve layer handles
+    // before taking mStateLock. Only written with mStateLock held.
+    mutable std::mutex mLayersByLocalBinderTokenLock;
+    std::unordered_map<BBinder*, wp<Layer>> mLayersByLocalBinderToken
+            GUARDED_BY(mLayersByLocalBinderTokenLock);
 
     // don't use a lock for these, we don't care
     int mDebugRegion = 0;
@@ -1209,6 +1292,8 @@ private:
     const std::shared_ptr<TimeStats> mTimeStats;
     const std::unique_ptr<FrameTracer> mFrameTracer;
     bool mUseHwcVirtualDisplays = false;
+    // If virtual displays feeding a video encoder may use HWC writeback.
+    bool mUseHwcWritebackForEncoders = false;
     // If blurs should be enabled on this device.
     bool mSupportsBlur = false;
     // Disable blurs, for debugging
@@ -1274,8 +1359,36 @@ private:
         bool privileged;
         bool hasListenerCallbacks;
         std::vector<ListenerCallbacks> listenerCallbacks;
+
+        // Only filled in while TimeStats is enabled.
+        TimeStats::TransactionTimes times;
+        // What kept the transaction in its queue when it was last checked, and since when.
+        TransactionBlockedOn blockedOn = TransactionBlockedOn::Nothing;
+        nsecs_t blockedSince = 0;
+
+        // Accounts the time since the last check to what blocked the transaction then.
+        void setBlockedOn(TransactionBlockedOn reason, nsecs_t now) {
+            if (blockedOn == TransactionBlockedOn::DesiredPresentTime) {
+                times.desiredPresentBlockedTime += now - blockedSince;
+            } else if (blockedOn == TransactionBlockedOn::Fences) {
+                times.fenceBlockedTime += now - blockedSince;
+            }
+            blockedOn = reason;
+            blockedSince = now;
+        }
     };
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash> mTransactionQueues;
+    // Transactions applied to mCurrentState, waiting to be committed. Only recorded while
+    // TimeStats is enabled.
+    static const size_t MAX_PENDING_TRANSACTION_TIMES = 256;
+    std::vector<TimeStats::TransactionTimes> mPendingTransactionTimes GUARDED_BY(mStateLock);
+
+    // Whether consecutive ready transactions from the same apply token that only set layer
+    // properties are merged before they are applied.
+    bool mMergeQueuedTransactions = true;
+    bool canMergeTransactions(const TransactionState& first,
+                              const TransactionState& second) const REQUIRES(mStateLock);
+    static void mergeTransactionState(TransactionState& into, const TransactionState& from);
 
     /* ------------------------------------------------------------------------
      * Feature prototyping
@@ -1372,6 +1485,25 @@ private:
     bool mSetActiveConfigPending = false;
 
     bool mLumaSampling = true;
+
+    // Optional pool used by computeLayerBounds to process root layer subtrees concurrently.
+    std::unique_ptr<WorkerPool> mLayerBoundsWorkerPool;
+    size_t mParallelLayerBoundsMinRoots = 0;
+
+    // Optional pool used by CompositionEngine to update several outputs concurrently.
+    std::unique_ptr<WorkerPool> mOutputCompositionWorkerPool;
+
+    // If true, client composition starts with the previous frame's composition
+    // strategy while the HWC validates the current frame.
+    bool mPredictCompositionStrategy = false;
+
+    // If true, INVALIDATE messages received while the idle timer has expired return early when
+    // there are no transactions or buffers to apply, see canBypassComposition.
+    bool mIdleCompositionBypass = false;
+
+    // Per-phase main thread timings of recent frames, see dumpsys --frame-phases.
+    FramePhaseProfiler mFramePhaseProfiler;
+
     sp<RegionSamplingThread> mRegionSamplingThread;
     ui::DisplayPrimaries mInternalDisplayPrimaries;
 
@@ -25,7 +25,7 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
-#include <fstream>
+#include <fcntl.h>
 
 #include <android-base/file.h>
 #include <log/log.h>
@@ -45,6 +45,10 @@ SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    disable();
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -52,10 +56,22 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         return;
     }
     ATRACE_CALL();
+    mOutputFd.reset(open(mOutputFileName.c_str(),
+                         O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (mOutputFd < 0) {
+        ALOGE("Could not open %s: %s", mOutputFileName.c_str(), strerror(errno));
+        return;
+    }
     mEnabled = true;
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    saveExistingDisplaysLocked(displays);
-    saveExistingSurfacesLocked(layers);
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        mStopWriter = false;
+        mDroppedIncrements = 0;
+        saveExistingDisplaysLocked(displays);
+        saveExistingSurfacesLocked(layers);
+        flushTraceLocked();
+    }
+    mWriterThread = std::thread(&SurfaceInterceptor::writerLoop, this);
 }
 
 void SurfaceInterceptor::disable() {
@@ -63,12 +79,19 @@ void SurfaceInterceptor::disable() {
         return;
     }
     ATRACE_CALL();
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        mEnabled = false;
+        mStopWriter = true;
+    }
+    mWriterCondition.notify_one();
+    // The writer writes out what is still pending before it exits.
+    mWriterThread.join();
+    mOutputFd.reset();
+
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    mEnabled = false;
-    status_t err(writeProtoFileLocked());
-    ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
-    ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
-    mTrace.Clear();
+    ALOGE_IF(mDroppedIncrements > 0, "Dropped %zu increments, the trace is incomplete",
+             mDroppedIncrements);
 }
 
 bool SurfaceInterceptor::isEnabled() {
@@ -146,21 +169,51 @@ void SurfaceInterceptor::addInitialDisplayStateLocked(Increment* increment,
                                display.viewport, display.frame);
 }
 
-status_t SurfaceInterceptor::writeProtoFileLocked() {
-    ATRACE_CALL();
-    std::string output;
-
-    if (!mTrace.IsInitialized()) {
-        return NOT_ENOUGH_DATA;
+void SurfaceInterceptor::flushTraceLocked() {
+    if (!mEnabled) {
+        // Raced with disable(), and the writer may be gone already.
+        mTrace.Clear();
+        return;
     }
-    if (!mTrace.SerializeToString(&output)) {
-        return PERMISSION_DENIED;
+    if (mTrace.increment_size() == 0) {
+        return;
     }
-    if (!android::base::WriteStringToFile(output, mOutputFileName, true)) {
-        return PERMISSION_DENIED;
+    if (!mTrace.IsInitialized()) {
+        ALOGE("Dropping increments with missing fields");
+        mDroppedIncrements += mTrace.increment_size();
+    } else if (mPendingOutput.size() >= MAX_PENDING_OUTPUT) {
+        mDroppedIncrements += mTrace.increment_size();
+    } else {
+        // Encoded Traces concatenate into a Trace with all of their increments.
+        mTrace.AppendToString(&mPendingOutput);
+        if (mPendingOutput.size() >= WRITE_THRESHOLD) {
+            mWriterCondition.notify_one();
+        }
     }
+    mTrace.Clear();
+}
+
+void SurfaceInterceptor::writerLoop() {
+    std::unique_lock<std::mutex> lock(mTraceMutex);
+    bool stop = false;
+    while (!stop) {
+        if (!mStopWriter && mPendingOutput.size() < WRITE_THRESHOLD) {
+            mWriterCondition.wait_for(lock, WRITE_INTERVAL);
+        }
+        stop = mStopWriter;
+        std::string output;
+        output.swap(mPendingOutput);
+        if (output.empty()) {
+            continue;
+        }
 
-    return NO_ERROR;
+        lock.unlock();
+        ATRACE_NAME("SurfaceInterceptor::write");
+        if (!android::base::WriteFully(mOutputFd, output.data(), output.size())) {
+            ALOGE("Could not write to %s: %s", mOutputFileName.c_str(), strerror(errno));
+        }
+        lock.lock();
+    }
 }
 
 const sp<const Layer> SurfaceInterceptor::getLayer(const wp<const IBinder>& weakHandle) const {
@@ -624,6 +677,7 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
             flags);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -633,6 +687,7 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -642,6 +697,7 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    flushTraceLocked();
 }
 
 /**
@@ -660,6 +716,7 @@ void SurfaceInterceptor::saveBufferUpdate(int32_t layerId, uint32_t width,
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, frameNumber);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
@@ -668,6 +725,7 @@ void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -677,6 +735,7 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
@@ -686,6 +745,7 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
+    flushTraceLocked();
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
@@ -695,6 +755,7 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
+    flushTraceLocked();
 }
 
 } // namespace impl
@@ -19,8 +19,14 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <string>
+#include <thread>
 
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
 #include <gui/LayerState.h>
 
 #include <utils/KeyedVector.h>
@@ -82,11 +88,16 @@ namespace impl {
 /*
  * SurfaceInterceptor intercepts and stores incoming streams of window
  * properties on SurfaceFlinger.
+ *
+ * Increments are streamed to the output file by a writer thread while the
+ * interceptor is enabled, rather than held in memory until it is disabled.
+ * Each one is written as an encoded Trace with a single increment, so the
+ * file as a whole still parses as one Trace.
  */
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -121,13 +132,15 @@ private:
     void addInitialSurfaceStateLocked(Increment* increment, const sp<const Layer>& layer);
     void addInitialDisplayStateLocked(Increment* increment, const DisplayDeviceState& display);
 
-    status_t writeProtoFileLocked();
+    // Moves the increments added to mTrace to the output of the writer thread.
+    void flushTraceLocked() REQUIRES(mTraceMutex);
+    void writerLoop();
     const sp<const Layer> getLayer(const wp<const IBinder>& weakHandle) const;
     int32_t getLayerId(const sp<const Layer>& layer) const;
     int32_t getLayerIdFromWeakRef(const wp<const Layer>& layer) const;
     int32_t getLayerIdFromHandle(const sp<const IBinder>& weakHandle) const;
 
-    Increment* createTraceIncrementLocked();
+    Increment* createTraceIncrementLocked() REQUIRES(mTraceMutex);
     void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
     void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
     void addBufferUpdateLocked(Increment* increment, int32_t layerId, uint32_t width,
@@ -183,10 +196,26 @@ private:
             const DisplayState& state, int32_t sequenceId);
 
 
+    // Output is written once this much is pending, or every WRITE_INTERVAL.
+    static constexpr size_t WRITE_THRESHOLD = 64 * 1024;
+    static constexpr std::chrono::milliseconds WRITE_INTERVAL{500};
+    // Increments are dropped rather than buffered beyond this if the writer
+    // falls behind.
+    static constexpr size_t MAX_PENDING_OUTPUT = 8 * 1024 * 1024;
+
     bool mEnabled {false};
     std::string mOutputFileName {DEFAULT_FILENAME};
     std::mutex mTraceMutex {};
-    Trace mTrace {};
+    // Increments that were not flushed yet.
+    Trace mTrace GUARDED_BY(mTraceMutex) {};
+    std::string mPendingOutput GUARDED_BY(mTraceMutex);
+    size_t mDroppedIncrements GUARDED_BY(mTraceMutex) = 0;
+    bool mStopWriter GUARDED_BY(mTraceMutex) = false;
+    std::condition_variable mWriterCondition;
+    std::thread mWriterThread;
+    // Opened by enable() and closed by disable(), only written by the writer
+    // thread in between.
+    base::unique_fd mOutputFd;
     SurfaceFlinger* const mFlinger;
 };
 
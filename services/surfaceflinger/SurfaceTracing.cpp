@@ -39,6 +39,12 @@ void SurfaceTracing::mainLoop() {
     bool enabled = addFirstEntry();
     while (enabled) {
         LayersTraceProto entry = traceWhenNotified();
+        // Compare against the previous entry once the main thread is free to run again.
+        if (mDeltaEncoding) {
+            mDeltaEncoder.encode(entry);
+        } else {
+            mDeltaEncoder.reset();
+        }
         enabled = addTraceToBuffer(entry);
     }
 }
@@ -49,6 +55,10 @@ bool SurfaceTracing::addFirstEntry() {
         std::scoped_lock lock(mSfLock);
         entry = traceLayersLocked("tracing.enable");
     }
+    mDeltaEncoder.reset();
+    if (mDeltaEncoding) {
+        mDeltaEncoder.encode(entry);
+    }
     return addTraceToBuffer(entry);
 }
 
@@ -65,10 +75,15 @@ LayersTraceProto SurfaceTracing::traceWhenNotified() {
 
 bool SurfaceTracing::addTraceToBuffer(LayersTraceProto& entry) {
     std::scoped_lock lock(mTraceLock);
-    mBuffer.emplace(std::move(entry));
+    if (!mBuffer.emplace(std::move(entry))) {
+        // Whatever this entry was a delta of is gone, so start over from a keyframe.
+        mDeltaEncoder.reset();
+    }
     if (mWriteToFile) {
         writeProtoFileLocked();
         mWriteToFile = false;
+        // The buffer is empty again, so the next entry cannot refer to this one.
+        mDeltaEncoder.reset();
     }
     return mEnabled;
 }
@@ -100,18 +115,63 @@ void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
     mUsedInBytes = 0U;
 }
 
-void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
+bool SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
     auto protoSize = proto.ByteSize();
     while (mUsedInBytes + protoSize > mSizeInBytes) {
         if (mStorage.empty()) {
-            return;
+            return false;
         }
         mUsedInBytes -= mStorage.front().ByteSize();
         mStorage.pop();
+        // Deltas cannot be decoded without the keyframe before them.
+        while (!mStorage.empty() && mStorage.front().is_delta()) {
+            mUsedInBytes -= mStorage.front().ByteSize();
+            mStorage.pop();
+        }
+    }
+    if (mStorage.empty() && proto.is_delta()) {
+        return false;
     }
     mUsedInBytes += protoSize;
     mStorage.emplace();
     mStorage.back().Swap(&proto);
+    return true;
+}
+
+void SurfaceTracing::DeltaEncoder::encode(LayersTraceProto& entry) {
+    std::unordered_map<int32_t, std::string> layers;
+    layers.reserve(entry.layers().layers_size());
+    for (const LayerProto& layer : entry.layers().layers()) {
+        layer.SerializeToString(&layers[layer.id()]);
+    }
+
+    if (!mHasKeyframe || ++mEntriesSinceKeyframe >= kKeyframeInterval) {
+        mHasKeyframe = true;
+        mEntriesSinceKeyframe = 0;
+    } else {
+        LayersProto changed;
+        for (LayerProto& layer : *entry.mutable_layers()->mutable_layers()) {
+            auto previous = mLayers.find(layer.id());
+            if (previous == mLayers.end() || previous->second != layers[layer.id()]) {
+                changed.add_layers()->Swap(&layer);
+            }
+        }
+        for (const auto& [id, unused] : mLayers) {
+            if (layers.count(id) == 0) {
+                entry.add_removed_layers(id);
+            }
+        }
+        entry.mutable_layers()->Swap(&changed);
+        entry.set_is_delta(true);
+    }
+
+    mLayers = std::move(layers);
+}
+
+void SurfaceTracing::DeltaEncoder::reset() {
+    mLayers.clear();
+    mEntriesSinceKeyframe = 0;
+    mHasKeyframe = false;
 }
 
 void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
@@ -198,6 +258,7 @@ LayersTraceProto SurfaceTracing::traceLayersLocked(const char* where) {
         entry.set_excludes_composition_state(true);
     }
     entry.set_missed_entries(mMissedTraceEntries);
+    mDeltaEncoding = flagIsSetLocked(SurfaceTracing::TRACE_DELTA);
 
     return entry;
 }
@@ -25,7 +25,9 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 using namespace android::surfaceflinger;
 
@@ -59,6 +61,9 @@ public:
         TRACE_COMPOSITION = 1 << 2,
         TRACE_EXTRA = 1 << 3,
         TRACE_HWC = 1 << 4,
+        // Only record the layers that changed since the previous entry, with a full entry
+        // every kKeyframeInterval entries.
+        TRACE_DELTA = 1 << 5,
         TRACE_ALL = 0xffffffff
     };
     void setTraceFlags(uint32_t flags);
@@ -69,6 +74,7 @@ public:
 private:
     static constexpr auto kDefaultBufferCapInByte = 5_MB;
     static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+    static constexpr uint32_t kKeyframeInterval = 32;
 
     class LayersTraceBuffer { // ring buffer
     public:
@@ -78,7 +84,8 @@ private:
 
         void setSize(size_t newSize) { mSizeInBytes = newSize; }
         void reset(size_t newSize);
-        void emplace(LayersTraceProto&& proto);
+        // Returns false if proto was dropped.
+        bool emplace(LayersTraceProto&& proto);
         void flush(LayersTraceFileProto* fileProto);
 
     private:
@@ -87,6 +94,21 @@ private:
         std::queue<LayersTraceProto> mStorage;
     };
 
+    class DeltaEncoder {
+    public:
+        // Replaces the layers of entry with the ones that changed since the previous entry,
+        // unless entry is due to be a keyframe.
+        void encode(LayersTraceProto& entry);
+        // Makes the next entry a keyframe.
+        void reset();
+
+    private:
+        // The serialized layers of the previous entry, by layer id.
+        std::unordered_map<int32_t, std::string> mLayers;
+        uint32_t mEntriesSinceKeyframe = 0;
+        bool mHasKeyframe = false;
+    };
+
     void mainLoop();
     bool addFirstEntry();
     LayersTraceProto traceWhenNotified();
@@ -107,6 +129,10 @@ private:
     uint32_t mMissedTraceEntries GUARDED_BY(mSfLock) = 0;
     bool mTracingInProgress GUARDED_BY(mSfLock) = false;
 
+    // Only accessed by the tracing thread.
+    bool mDeltaEncoding = false;
+    DeltaEncoder mDeltaEncoder;
+
     mutable std::mutex mTraceLock;
     LayersTraceBuffer mBuffer GUARDED_BY(mTraceLock);
     size_t mBufferSize GUARDED_BY(mTraceLock) = kDefaultBufferCapInByte;
@@ -123,6 +123,7 @@ AStatsManager_PullAtomCallbackReturn TimeStats::populateGlobalAtom(AStatsEventLi
 
 AStatsManager_PullAtomCallbackReturn TimeStats::populateLayerAtom(AStatsEventList* data) {
     std::lock_guard<std::mutex> lock(mMutex);
+    aggregateLayerStatsLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer const*> dumpStats;
     for (const auto& ele : mTimeStats.stats) {
@@ -238,8 +239,12 @@ std::string TimeStats::miniDump() {
 
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
-    android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
-                                 mTimeStatsTracker.size());
+    aggregateLayerStatsLocked();
+    {
+        std::shared_lock<std::shared_mutex> recordsLock(mLayerRecordsMutex);
+        android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
+                                     mTimeStatsTracker.size());
+    }
     android::base::StringAppendF(&result, "Number of layers in the stats pool is %zu\n",
                                  mTimeStats.stats.size());
     return result;
@@ -385,10 +390,9 @@ bool TimeStats::recordReadyLocked(int32_t layerId, TimeRecord* timeRecord) {
     return true;
 }
 
-void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
+void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, LayerRecord& layerRecord) {
     ATRACE_CALL();
 
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     TimeRecord& prevTimeRecord = layerRecord.prevTimeRecord;
     std::deque<TimeRecord>& timeRecords = layerRecord.timeRecords;
     while (!timeRecords.empty()) {
@@ -397,11 +401,7 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
               timeRecords[0].frameTime.frameNumber, timeRecords[0].frameTime.presentTime);
 
         if (prevTimeRecord.ready) {
-            const std::string& layerName = layerRecord.layerName;
-            if (!mTimeStats.stats.count(layerName)) {
-                mTimeStats.stats[layerName].layerName = layerName;
-            }
-            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[layerName];
+            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = layerRecord.pendingStats;
             timeStatsLayer.totalFrames++;
             timeStatsLayer.droppedFrames += layerRecord.droppedFrames;
             timeStatsLayer.lateAcquireFrames += layerRecord.lateAcquireFrames;
@@ -462,6 +462,81 @@ static bool layerNameIsValid(const std::string& layerName) {
             layerName.compare(0, kMinLenLayerName, kPopupWindowPrefix) != 0;
 }
 
+std::shared_ptr<TimeStats::LayerRecord> TimeStats::getLayerRecord(int32_t layerId) {
+    std::shared_lock<std::shared_mutex> lock(mLayerRecordsMutex);
+    const auto it = mTimeStatsTracker.find(layerId);
+    return it == mTimeStatsTracker.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<TimeStats::LayerRecord> TimeStats::createLayerRecord(
+        int32_t layerId, const std::string& layerName) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::shared_mutex> recordsLock(mLayerRecordsMutex);
+    const auto it = mTimeStatsTracker.find(layerId);
+    if (it != mTimeStatsTracker.end()) {
+        return it->second;
+    }
+    if (mTimeStatsTracker.size() >= MAX_NUM_LAYER_RECORDS) {
+        return nullptr;
+    }
+    auto layerRecord = std::make_shared<LayerRecord>();
+    layerRecord->layerName = layerName;
+    layerRecord->pendingStats.layerName = layerName;
+    mTimeStatsTracker.emplace(layerId, layerRecord);
+    return layerRecord;
+}
+
+void TimeStats::removeLayerRecord(int32_t layerId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::shared_ptr<LayerRecord> layerRecord;
+    {
+        std::unique_lock<std::shared_mutex> recordsLock(mLayerRecordsMutex);
+        const auto it = mTimeStatsTracker.find(layerId);
+        if (it == mTimeStatsTracker.end()) return;
+        layerRecord = std::move(it->second);
+        mTimeStatsTracker.erase(it);
+    }
+    std::lock_guard<std::mutex> recordLock(layerRecord->mutex);
+    mergeLayerStatsLocked(layerRecord->pendingStats);
+}
+
+void TimeStats::aggregateLayerStatsLocked() {
+    ATRACE_CALL();
+
+    std::shared_lock<std::shared_mutex> recordsLock(mLayerRecordsMutex);
+    for (const auto& [layerId, layerRecord] : mTimeStatsTracker) {
+        std::lock_guard<std::mutex> recordLock(layerRecord->mutex);
+        mergeLayerStatsLocked(layerRecord->pendingStats);
+    }
+}
+
+void TimeStats::mergeLayerStatsLocked(TimeStatsHelper::TimeStatsLayer& pendingStats) {
+    if (pendingStats.totalFrames == 0) return;
+
+    TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[pendingStats.layerName];
+    timeStatsLayer.layerName = pendingStats.layerName;
+    timeStatsLayer.totalFrames += pendingStats.totalFrames;
+    timeStatsLayer.droppedFrames += pendingStats.droppedFrames;
+    timeStatsLayer.lateAcquireFrames += pendingStats.lateAcquireFrames;
+    timeStatsLayer.badDesiredPresentFrames += pendingStats.badDesiredPresentFrames;
+    for (const auto& [name, histogram] : pendingStats.deltas) {
+        auto& merged = timeStatsLayer.deltas[name].hist;
+        for (const auto& [delta, count] : histogram.hist) {
+            merged[delta] += count;
+        }
+    }
+
+    pendingStats.totalFrames = 0;
+    pendingStats.droppedFrames = 0;
+    pendingStats.lateAcquireFrames = 0;
+    pendingStats.badDesiredPresentFrames = 0;
+    pendingStats.deltas.clear();
+}
+
 void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
                             nsecs_t postTime) {
     if (!mEnabled.load()) return;
@@ -470,20 +545,19 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
     ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
           postTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
-        return;
-    }
-    if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
-        layerNameIsValid(layerName)) {
-        mTimeStatsTracker[layerId].layerName = layerName;
+    std::shared_ptr<LayerRecord> layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) {
+        if (!layerNameIsValid(layerName)) return;
+        layerRecordPtr = createLayerRecord(layerId, layerName);
+        if (layerRecordPtr == nullptr) return;
     }
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    std::unique_lock<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
         ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
               layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
-        mTimeStatsTracker.erase(layerId);
+        lock.unlock();
+        removeLayerRecord(layerId);
         return;
     }
     // For most media content, the acquireFence is invalid because the buffer is
@@ -511,9 +585,10 @@ void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latc
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, latchTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -530,9 +605,10 @@ void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
     ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
           static_cast<std::underlying_type<LatchSkipReason>::type>(reason));
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
 
     switch (reason) {
         case LatchSkipReason::LateAcquire:
@@ -547,9 +623,10 @@ void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-BadDesiredPresent", layerId);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     layerRecord.badDesiredPresentFrames++;
 }
 
@@ -559,9 +636,10 @@ void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t de
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber, desiredTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -577,9 +655,10 @@ void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t ac
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber, acquireTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -597,9 +676,10 @@ void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
           acquireFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -615,9 +695,10 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber, presentTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -628,7 +709,7 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
         layerRecord.waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerId);
+    flushAvailableRecordsToStatsLocked(layerId, layerRecord);
 }
 
 void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
@@ -639,9 +720,10 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
           presentFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -652,14 +734,13 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
         layerRecord.waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerId);
+    flushAvailableRecordsToStatsLocked(layerId, layerRecord);
 }
 
 void TimeStats::onDestroy(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-onDestroy", layerId);
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStatsTracker.erase(layerId);
+    removeLayerRecord(layerId);
 }
 
 void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
@@ -668,9 +749,10 @@ void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerId, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    const auto layerRecordPtr = getLayerRecord(layerId);
+    if (layerRecordPtr == nullptr) return;
+    std::lock_guard<std::mutex> lock(layerRecordPtr->mutex);
+    LayerRecord& layerRecord = *layerRecordPtr;
     size_t removeAt = 0;
     for (const TimeRecord& record : layerRecord.timeRecords) {
         if (record.frameTime.frameNumber == frameNumber) break;
@@ -782,6 +864,46 @@ void TimeStats::flushAvailableGlobalRecordsToStatsLocked() {
 
         mGlobalRecord.renderEngineDurations.pop_front();
     }
+    while (!mGlobalRecord.transactions.empty()) {
+        const auto& record = mGlobalRecord.transactions.front();
+        if (record.presentFence == nullptr) break;
+
+        const nsecs_t presentTime = record.presentFence->getSignalTime();
+        if (presentTime == Fence::SIGNAL_TIME_PENDING) break;
+
+        if (presentTime != Fence::SIGNAL_TIME_INVALID) {
+            recordTransactionStatsLocked(record.times, presentTime);
+        }
+        mGlobalRecord.transactions.pop_front();
+    }
+}
+
+void TimeStats::recordTransactionStatsLocked(const TransactionTimes& times, nsecs_t presentTime) {
+    auto iter = mTimeStats.transactionStats.find(times.uid);
+    if (iter == mTimeStats.transactionStats.end()) {
+        if (mTimeStats.transactionStats.size() >= MAX_NUM_TRANSACTION_STATS) return;
+        iter = mTimeStats.transactionStats.try_emplace(times.uid).first;
+        iter->second.uid = times.uid;
+    }
+
+    TimeStatsHelper::TimeStatsTransaction& stats = iter->second;
+    stats.totalTransactions++;
+    // Clients that did not send the time they applied the transaction report 0.
+    if (times.applyTime > 0 && times.applyTime <= times.postTime) {
+        stats.deltas["apply2receive"].insert(msBetween(times.applyTime, times.postTime));
+        stats.deltas["apply2present"].insert(msBetween(times.applyTime, presentTime));
+    }
+    stats.deltas["receive2ready"].insert(msBetween(times.postTime, times.readyTime));
+    if (times.desiredPresentBlockedTime > 0) {
+        stats.deltas["desiredPresentBlocked"].insert(
+                msBetween(0, times.desiredPresentBlockedTime));
+    }
+    if (times.fenceBlockedTime > 0) {
+        stats.deltas["fenceBlocked"].insert(msBetween(0, times.fenceBlockedTime));
+    }
+    stats.deltas["ready2commit"].insert(msBetween(times.readyTime, times.commitTime));
+    stats.deltas["commit2present"].insert(msBetween(times.commitTime, presentTime));
+    stats.deltas["receive2present"].insert(msBetween(times.postTime, presentTime));
 }
 
 void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) {
@@ -789,19 +911,31 @@ void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentF
 
     ATRACE_CALL();
     std::lock_guard<std::mutex> lock(mMutex);
+    // Transactions committed since the last call are presented with this fence.
+    auto committedTransactions = std::find_if(mGlobalRecord.transactions.begin(),
+                                              mGlobalRecord.transactions.end(),
+                                              [](const TransactionRecord& record) {
+                                                  return record.presentFence == nullptr;
+                                              });
     if (presentFence == nullptr || !presentFence->isValid()) {
         mGlobalRecord.prevPresentTime = 0;
+        mGlobalRecord.transactions.erase(committedTransactions, mGlobalRecord.transactions.end());
         return;
     }
 
     if (mPowerTime.powerMode != PowerMode::ON) {
         // Try flushing the last present fence on PowerMode::ON.
+        mGlobalRecord.transactions.erase(committedTransactions, mGlobalRecord.transactions.end());
         flushAvailableGlobalRecordsToStatsLocked();
         mGlobalRecord.presentFences.clear();
         mGlobalRecord.prevPresentTime = 0;
         return;
     }
 
+    for (auto iter = committedTransactions; iter != mGlobalRecord.transactions.end(); ++iter) {
+        iter->presentFence = presentFence;
+    }
+
     if (mGlobalRecord.presentFences.size() == MAX_NUM_TIME_RECORDS) {
         // The front presentFence must be trapped in pending status in this
         // case. Try dequeuing the front one to recover.
@@ -814,6 +948,21 @@ void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentF
     flushAvailableGlobalRecordsToStatsLocked();
 }
 
+void TimeStats::recordTransaction(const TransactionTimes& times) {
+    if (!mEnabled.load()) return;
+    // Transactions queued before TimeStats was enabled carry no post time or uid.
+    if (times.postTime == 0) return;
+
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mGlobalRecord.transactions.size() == MAX_NUM_TRANSACTION_RECORDS) {
+        // The front record must be waiting on a present fence that is trapped in pending status.
+        ALOGE("Transactions are already at their maximum size[%zu]", MAX_NUM_TRANSACTION_RECORDS);
+        mGlobalRecord.transactions.pop_front();
+    }
+    mGlobalRecord.transactions.push_back({times, nullptr});
+}
+
 void TimeStats::enable() {
     if (mEnabled.load()) return;
 
@@ -842,6 +991,9 @@ void TimeStats::clearAll() {
     std::lock_guard<std::mutex> lock(mMutex);
     clearGlobalLocked();
     clearLayersLocked();
+    // Not pulled by statsd, so only cleared here.
+    mGlobalRecord.transactions.clear();
+    mTimeStats.transactionStats.clear();
 }
 
 void TimeStats::clearGlobalLocked() {
@@ -870,7 +1022,10 @@ void TimeStats::clearGlobalLocked() {
 void TimeStats::clearLayersLocked() {
     ATRACE_CALL();
 
-    mTimeStatsTracker.clear();
+    {
+        std::unique_lock<std::shared_mutex> recordsLock(mLayerRecordsMutex);
+        mTimeStatsTracker.clear();
+    }
     mTimeStats.stats.clear();
     ALOGD("Cleared layer stats");
 }
@@ -890,6 +1045,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
     mTimeStats.statsEnd = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
+    aggregateLayerStatsLocked();
 
     if (asProto) {
         ALOGD("Dumping TimeStats as proto");
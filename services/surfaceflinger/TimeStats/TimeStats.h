@@ -35,8 +35,10 @@
 #include <utils/Vector.h>
 
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <unordered_map>
 #include <variant>
 
@@ -118,6 +120,27 @@ public:
     // Source of truth is RefrehRateStats.
     virtual void recordRefreshRate(uint32_t fps, nsecs_t duration) = 0;
     virtual void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) = 0;
+
+    // Timeline of a transaction, from SurfaceComposerClient::Transaction::apply() until
+    // SurfaceFlinger commits it to the drawing state.
+    struct TransactionTimes {
+        int32_t uid = 0;
+        // When the client applied the transaction, or 0 if unknown.
+        nsecs_t applyTime = 0;
+        // When setTransactionState received the transaction.
+        nsecs_t postTime = 0;
+        // When the transaction was ready and applied to the current state.
+        nsecs_t readyTime = 0;
+        // Time the transaction was held in its queue because its desiredPresentTime was not
+        // reached, or because its acquire fences had not signaled. Both are part of
+        // readyTime - postTime.
+        nsecs_t desiredPresentBlockedTime = 0;
+        nsecs_t fenceBlockedTime = 0;
+        nsecs_t commitTime = 0;
+    };
+    // Records a committed transaction. It is considered presented by the next present fence
+    // passed to setPresentFenceGlobal.
+    virtual void recordTransaction(const TransactionTimes& times) = 0;
 };
 
 namespace impl {
@@ -142,6 +165,9 @@ class TimeStats : public android::TimeStats {
     };
 
     struct LayerRecord {
+        // Taken by every call recording a frame of this layer. Calls for different layers never
+        // wait for each other; this is only shared with a pull or dump aggregating the layer.
+        std::mutex mutex;
         std::string layerName;
         // This is the index in timeRecords, at which the timestamps for that
         // specific frame are still not fully received. This is not waiting for
@@ -152,6 +178,8 @@ class TimeStats : public android::TimeStats {
         uint32_t badDesiredPresentFrames = 0;
         TimeRecord prevTimeRecord;
         std::deque<TimeRecord> timeRecords;
+        // Stats of the frames presented since the last aggregation into mTimeStats.
+        TimeStatsHelper::TimeStatsLayer pendingStats;
     };
 
     struct PowerTime {
@@ -164,10 +192,17 @@ class TimeStats : public android::TimeStats {
         std::variant<nsecs_t, std::shared_ptr<FenceTime>> endTime;
     };
 
+    struct TransactionRecord {
+        TransactionTimes times;
+        // Null until the frame that presents the transaction is known.
+        std::shared_ptr<FenceTime> presentFence;
+    };
+
     struct GlobalRecord {
         nsecs_t prevPresentTime = 0;
         std::deque<std::shared_ptr<FenceTime>> presentFences;
         std::deque<RenderEngineDuration> renderEngineDurations;
+        std::deque<TransactionRecord> transactions;
     };
 
 public:
@@ -263,6 +298,7 @@ public:
     // Source of truth is RefrehRateStats.
     void recordRefreshRate(uint32_t fps, nsecs_t duration) override;
     void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) override;
+    void recordTransaction(const TransactionTimes& times) override;
 
     static const size_t MAX_NUM_TIME_RECORDS = 64;
 
@@ -273,9 +309,20 @@ private:
     AStatsManager_PullAtomCallbackReturn populateGlobalAtom(AStatsEventList* data);
     AStatsManager_PullAtomCallbackReturn populateLayerAtom(AStatsEventList* data);
     bool recordReadyLocked(int32_t layerId, TimeRecord* timeRecord);
-    void flushAvailableRecordsToStatsLocked(int32_t layerId);
+    // Requires layerRecord.mutex.
+    void flushAvailableRecordsToStatsLocked(int32_t layerId, LayerRecord& layerRecord);
+    // Returns nullptr if the layer is not tracked.
+    std::shared_ptr<LayerRecord> getLayerRecord(int32_t layerId);
+    // Returns nullptr if the layer cannot be tracked because the limits are reached.
+    std::shared_ptr<LayerRecord> createLayerRecord(int32_t layerId, const std::string& layerName);
+    // Stops tracking the layer, keeping the stats of the frames it already presented.
+    void removeLayerRecord(int32_t layerId);
+    // Folds the pending stats of every layer into mTimeStats. Requires mMutex.
+    void aggregateLayerStatsLocked();
+    void mergeLayerStatsLocked(TimeStatsHelper::TimeStatsLayer& pendingStats);
     void flushPowerTimeLocked();
     void flushAvailableGlobalRecordsToStatsLocked();
+    void recordTransactionStatsLocked(const TransactionTimes& times, nsecs_t presentTime);
 
     void enable();
     void disable();
@@ -285,15 +332,21 @@ private:
     void dump(bool asProto, std::optional<uint32_t> maxLayers, std::string& result);
 
     std::atomic<bool> mEnabled = false;
+    // Guards mTimeStats and the global records. When both are needed, mMutex is taken before
+    // mLayerRecordsMutex, which is taken before the mutex of a LayerRecord.
     std::mutex mMutex;
     TimeStatsHelper::TimeStatsGlobal mTimeStats;
+    // Guards the map itself; the records have their own mutex.
+    std::shared_mutex mLayerRecordsMutex;
     // Hashmap for LayerRecord with layerId as the hash key
-    std::unordered_map<int32_t, LayerRecord> mTimeStatsTracker;
+    std::unordered_map<int32_t, std::shared_ptr<LayerRecord>> mTimeStatsTracker;
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
 
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
     static const size_t MAX_NUM_LAYER_STATS = 200;
+    static const size_t MAX_NUM_TRANSACTION_RECORDS = 256;
+    static const size_t MAX_NUM_TRANSACTION_STATS = 100;
     std::unique_ptr<StatsEventDelegate> mStatsDelegate = std::make_unique<StatsEventDelegate>();
     size_t mMaxPulledLayers = 8;
     size_t mMaxPulledHistogramBuckets = 6;
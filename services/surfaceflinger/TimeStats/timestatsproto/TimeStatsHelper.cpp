@@ -99,6 +99,18 @@ std::string TimeStatsHelper::TimeStatsLayer::toString() const {
     return result;
 }
 
+std::string TimeStatsHelper::TimeStatsTransaction::toString() const {
+    std::string result = "\n";
+    StringAppendF(&result, "transactionUid = %d\n", uid);
+    StringAppendF(&result, "totalTransactions = %d\n", totalTransactions);
+    for (const auto& ele : deltas) {
+        StringAppendF(&result, "%s histogram is as below:\n", ele.first.c_str());
+        result.append(ele.second.toString());
+    }
+
+    return result;
+}
+
 std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> maxLayers) const {
     std::string result = "SurfaceFlinger TimeStats:\n";
     StringAppendF(&result, "statsStart = %" PRId64 "\n", statsStart);
@@ -132,6 +144,9 @@ std::string TimeStatsHelper::TimeStatsGlobal::toString(std::optional<uint32_t> m
     for (const auto& ele : dumpStats) {
         result.append(ele->toString());
     }
+    for (const auto& ele : transactionStats) {
+        result.append(ele.second.toString());
+    }
 
     return result;
 }
@@ -154,6 +169,22 @@ SFTimeStatsLayerProto TimeStatsHelper::TimeStatsLayer::toProto() const {
     return layerProto;
 }
 
+SFTimeStatsTransactionProto TimeStatsHelper::TimeStatsTransaction::toProto() const {
+    SFTimeStatsTransactionProto transactionProto;
+    transactionProto.set_uid(uid);
+    transactionProto.set_total_transactions(totalTransactions);
+    for (const auto& ele : deltas) {
+        SFTimeStatsDeltaProto* deltaProto = transactionProto.add_deltas();
+        deltaProto->set_delta_name(ele.first);
+        for (const auto& histEle : ele.second.hist) {
+            SFTimeStatsHistogramBucketProto* histProto = deltaProto->add_histograms();
+            histProto->set_time_millis(histEle.first);
+            histProto->set_frame_count(histEle.second);
+        }
+    }
+    return transactionProto;
+}
+
 SFTimeStatsGlobalProto TimeStatsHelper::TimeStatsGlobal::toProto(
         std::optional<uint32_t> maxLayers) const {
     SFTimeStatsGlobalProto globalProto;
@@ -190,6 +221,10 @@ SFTimeStatsGlobalProto TimeStatsHelper::TimeStatsGlobal::toProto(
         SFTimeStatsLayerProto* layerProto = globalProto.add_stats();
         layerProto->CopyFrom(ele->toProto());
     }
+    for (const auto& ele : transactionStats) {
+        SFTimeStatsTransactionProto* transactionProto = globalProto.add_transaction_stats();
+        transactionProto->CopyFrom(ele.second.toProto());
+    }
     return globalProto;
 }
 
@@ -54,6 +54,16 @@ public:
         SFTimeStatsLayerProto toProto() const;
     };
 
+    class TimeStatsTransaction {
+    public:
+        int32_t uid = 0;
+        int32_t totalTransactions = 0;
+        std::unordered_map<std::string, Histogram> deltas;
+
+        std::string toString() const;
+        SFTimeStatsTransactionProto toProto() const;
+    };
+
     class TimeStatsGlobal {
     public:
         int64_t statsStart = 0;
@@ -71,6 +81,8 @@ public:
         Histogram renderEngineTiming;
         std::unordered_map<std::string, TimeStatsLayer> stats;
         std::unordered_map<uint32_t, nsecs_t> refreshRateStats;
+        // Keyed by uid
+        std::unordered_map<int32_t, TimeStatsTransaction> transactionStats;
 
         std::string toString(std::optional<uint32_t> maxLayers) const;
         SFTimeStatsGlobalProto toProto(std::optional<uint32_t> maxLayers) const;
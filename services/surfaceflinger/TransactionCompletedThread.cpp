@@ -259,6 +259,7 @@ void TransactionCompletedThread::addPresentFence(const sp<Fence>& presentFence)
 void TransactionCompletedThread::sendCallbacks() {
     std::lock_guard lock(mMutex);
     if (mRunning) {
+        mCallbacksPending = true;
         mConditionVariable.notify_all();
     }
 }
@@ -267,7 +268,12 @@ void TransactionCompletedThread::threadMain() {
     std::lock_guard lock(mMutex);
 
     while (mKeepRunning) {
-        mConditionVariable.wait(mMutex);
+        // A request made while the previous callbacks were being delivered is not lost, since
+        // the lock is not held while delivering.
+        while (!mCallbacksPending && mKeepRunning) {
+            mConditionVariable.wait(mMutex);
+        }
+        mCallbacksPending = false;
         std::vector<ListenerStats> completedListenerStats;
 
         // For each listener
@@ -305,33 +311,19 @@ void TransactionCompletedThread::threadMain() {
                     transactionStats.presentFence = mPresentFence;
                 }
 
-                // Remove the transaction from completed to the callback
+                // Remove the transaction from completed to the callback. All the transactions
+                // that are ready for a listener go out together in a single binder call.
                 listenerStats.transactionStats.push_back(std::move(transactionStats));
                 transactionStatsItr = transactionStatsDeque.erase(transactionStatsItr);
             }
-            // If the listener has completed transactions
-            if (!listenerStats.transactionStats.empty()) {
-                // If the listener is still alive
-                if (listener->isBinderAlive()) {
-                    // Send callback.  The listener stored in listenerStats
-                    // comes from the cross-process setTransactionState call to
-                    // SF.  This MUST be an ITransactionCompletedListener.  We
-                    // keep it as an IBinder due to consistency reasons: if we
-                    // interface_cast at the IPC boundary when reading a Parcel,
-                    // we get pointers that compare unequal in the SF process.
-                    interface_cast<ITransactionCompletedListener>(listenerStats.listener)
-                            ->onTransactionCompleted(listenerStats);
-                    if (transactionStatsDeque.empty()) {
-                        listener->unlinkToDeath(mDeathRecipient);
-                        completedTransactionsItr =
-                                mCompletedTransactions.erase(completedTransactionsItr);
-                    } else {
-                        completedTransactionsItr++;
-                    }
-                } else {
-                    completedTransactionsItr =
-                            mCompletedTransactions.erase(completedTransactionsItr);
-                }
+
+            if (listenerStats.transactionStats.empty()) {
+                completedTransactionsItr++;
+            } else if (!listener->isBinderAlive()) {
+                completedTransactionsItr = mCompletedTransactions.erase(completedTransactionsItr);
+            } else if (transactionStatsDeque.empty()) {
+                listener->unlinkToDeath(mDeathRecipient);
+                completedTransactionsItr = mCompletedTransactions.erase(completedTransactionsItr);
             } else {
                 completedTransactionsItr++;
             }
@@ -343,17 +335,29 @@ void TransactionCompletedThread::threadMain() {
             mPresentFence.clear();
         }
 
-        // If everyone else has dropped their reference to a layer and its listener is dead,
-        // we are about to cause the layer to be deleted. If this happens at the wrong time and
-        // we are holding mMutex, we will cause a deadlock.
-        //
-        // The deadlock happens because this thread is holding on to mMutex and when we delete
-        // the layer, it grabs SF's mStateLock. A different SF binder thread grabs mStateLock,
-        // then call's TransactionCompletedThread::run() which tries to grab mMutex.
+        // Deliver the callbacks without holding mMutex, so that the main thread and binder
+        // threads registering new callbacks are not blocked behind the binder calls.
         //
-        // To avoid this deadlock, we need to unlock mMutex when dropping our last reference to
-        // to the layer.
+        // Dropping our references to the layers must also happen without holding mMutex. If
+        // everyone else has dropped their reference to a layer and its listener is dead, we are
+        // about to cause the layer to be deleted. Deleting the layer grabs SF's mStateLock, and
+        // a different SF binder thread may hold mStateLock while calling
+        // TransactionCompletedThread::run(), which tries to grab mMutex.
         mMutex.unlock();
+        for (const auto& listenerStats : completedListenerStats) {
+            // If the listener has completed transactions and is still alive
+            if (!listenerStats.transactionStats.empty() &&
+                listenerStats.listener->isBinderAlive()) {
+                // Send callback.  The listener stored in listenerStats
+                // comes from the cross-process setTransactionState call to
+                // SF.  This MUST be an ITransactionCompletedListener.  We
+                // keep it as an IBinder due to consistency reasons: if we
+                // interface_cast at the IPC boundary when reading a Parcel,
+                // we get pointers that compare unequal in the SF process.
+                interface_cast<ITransactionCompletedListener>(listenerStats.listener)
+                        ->onTransactionCompleted(listenerStats);
+            }
+        }
         completedListenerStats.clear();
         mMutex.lock();
     }
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkerPool.h"
+
+#include <pthread.h>
+
+#include <string>
+
+namespace android {
+
+WorkerPool::WorkerPool(size_t numWorkers, const char* name)
+      : mNumWorkers(numWorkers), mName(name) {}
+
+WorkerPool::~WorkerPool() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+        threads.swap(mThreads);
+    }
+    mWorkCondition.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::start() {
+    for (size_t i = 0; i < mNumWorkers; i++) {
+        mThreads.emplace_back(&WorkerPool::threadMain, this, i);
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& work) {
+    if (count == 0) return;
+    if (count == 1 || mNumWorkers == 0) {
+        for (size_t i = 0; i < count; i++) {
+            work(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(mMutex);
+        if (mThreads.empty()) {
+            start();
+        }
+        mWork = &work;
+        mCount = count;
+        mNextItem = 0;
+        mBusyWorkers = mNumWorkers;
+        mGeneration++;
+    }
+    mWorkCondition.notify_all();
+
+    runItems(work, count);
+
+    std::unique_lock lock(mMutex);
+    mDoneCondition.wait(lock, [this]() REQUIRES(mMutex) { return mBusyWorkers == 0; });
+    mWork = nullptr;
+}
+
+void WorkerPool::runItems(const std::function<void(size_t)>& work, size_t count) {
+    for (size_t i = mNextItem++; i < count; i = mNextItem++) {
+        work(i);
+    }
+}
+
+void WorkerPool::threadMain(size_t index) {
+    const std::string threadName = std::string(mName) + std::to_string(index);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+
+    uint64_t lastGeneration = 0;
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mWorkCondition.wait(lock, [&]() REQUIRES(mMutex) {
+            return mStopping || mGeneration != lastGeneration;
+        });
+        if (mStopping) return;
+        lastGeneration = mGeneration;
+
+        const auto* work = mWork;
+        const size_t count = mCount;
+        lock.unlock();
+        runItems(*work, count);
+        lock.lock();
+
+        if (--mBusyWorkers == 0) {
+            mDoneCondition.notify_one();
+        }
+    }
+}
+
+} // namespace android
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+// A small fixed-size pool used to fan out independent pieces of per-frame
+// work from the main thread. Indices are handed out from a shared counter, so
+// idle threads keep picking up remaining items until the range is exhausted.
+// The calling thread participates in the work as well.
+//
+// Threads are spawned lazily on first use and inherit the scheduling policy of
+// the thread that first calls parallelFor().
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t numWorkers, const char* name);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Runs work(i) for every i in [0, count) and returns once all of them are
+    // done. Items must be independent of each other. Not reentrant.
+    void parallelFor(size_t count, const std::function<void(size_t)>& work);
+
+    size_t getNumWorkers() const { return mNumWorkers; }
+
+private:
+    void start() REQUIRES(mMutex);
+    void threadMain(size_t index);
+    void runItems(const std::function<void(size_t)>& work, size_t count);
+
+    const size_t mNumWorkers;
+    const char* const mName;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+    std::vector<std::thread> mThreads GUARDED_BY(mMutex);
+    const std::function<void(size_t)>* mWork GUARDED_BY(mMutex) = nullptr;
+    size_t mCount GUARDED_BY(mMutex) = 0;
+    uint64_t mGeneration GUARDED_BY(mMutex) = 0;
+    size_t mBusyWorkers GUARDED_BY(mMutex) = 0;
+    bool mStopping GUARDED_BY(mMutex) = false;
+
+    std::atomic<size_t> mNextItem = 0;
+};
+
+} // namespace android
@@ -17,6 +17,8 @@
 #undef LOG_TAG
 #define LOG_TAG "LibSurfaceFlingerUnittests"
 
+#include <sys/mman.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <log/log.h>
@@ -57,9 +59,11 @@ class EventThreadTest : public testing::Test {
 protected:
     class MockEventThreadConnection : public EventThreadConnection {
     public:
-        MockEventThreadConnection(impl::EventThread* eventThread, ResyncCallback&& resyncCallback,
+        MockEventThreadConnection(impl::EventThread* eventThread, uid_t callingUid,
+                                  ResyncCallback&& resyncCallback,
                                   ISurfaceComposer::ConfigChanged configChanged)
-              : EventThreadConnection(eventThread, std::move(resyncCallback), configChanged) {}
+              : EventThreadConnection(eventThread, callingUid, std::move(resyncCallback),
+                                      configChanged) {}
         MOCK_METHOD1(postEvent, status_t(const DisplayEventReceiver::Event& event));
     };
 
@@ -71,7 +75,8 @@ protected:
 
     void createThread(std::unique_ptr<VSyncSource>);
     sp<MockEventThreadConnection> createConnection(ConnectionEventRecorder& recorder,
-                                                   ISurfaceComposer::ConfigChanged configChanged);
+                                                   ISurfaceComposer::ConfigChanged configChanged,
+                                                   uid_t ownerUid = 0);
 
     void expectVSyncSetEnabledCallReceived(bool expectedState);
     void expectVSyncSetPhaseOffsetCallReceived(nsecs_t expectedPhaseOffset);
@@ -145,10 +150,11 @@ void EventThreadTest::createThread(std::unique_ptr<VSyncSource> source) {
 }
 
 sp<EventThreadTest::MockEventThreadConnection> EventThreadTest::createConnection(
-        ConnectionEventRecorder& recorder, ISurfaceComposer::ConfigChanged configChanged) {
+        ConnectionEventRecorder& recorder, ISurfaceComposer::ConfigChanged configChanged,
+        uid_t ownerUid) {
     sp<MockEventThreadConnection> connection =
-            new MockEventThreadConnection(mThread.get(), mResyncCallRecorder.getInvocable(),
-                                          configChanged);
+            new MockEventThreadConnection(mThread.get(), ownerUid,
+                                          mResyncCallRecorder.getInvocable(), configChanged);
     EXPECT_CALL(*connection, postEvent(_)).WillRepeatedly(Invoke(recorder.getInvocable()));
     return connection;
 }
@@ -356,6 +362,91 @@ TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     expectVsyncEventReceivedByConnection(101112, 4u);
 }
 
+TEST_F(EventThreadTest, timestampOnlyConnectionReadsVsyncsFromSharedMemory) {
+    sp<NativeHandle> handle;
+    ASSERT_EQ(NO_ERROR, mThread->getVsyncTimestamps(&handle));
+    ASSERT_EQ(1, handle->handle()->numFds);
+    const int fd = handle->handle()->data[0];
+
+    // Clients can only map the vsync timestamps read-only.
+    EXPECT_EQ(MAP_FAILED,
+              mmap(nullptr, sizeof(gui::VsyncTimestamps), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0));
+    void* data = mmap(nullptr, sizeof(gui::VsyncTimestamps), PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(MAP_FAILED, data);
+    const auto* timestamps = static_cast<const gui::VsyncTimestamps*>(data);
+
+    uint32_t count;
+    nsecs_t timestamp;
+    nsecs_t expectedTimestamp;
+    EXPECT_FALSE(timestamps->read(&count, &timestamp, &expectedTimestamp));
+
+    mThread->setTimestampOnly(true, mConnection);
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The vsync is published, but not posted to the connection.
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+    ASSERT_TRUE(timestamps->read(&count, &timestamp, &expectedTimestamp));
+    EXPECT_EQ(1u, count);
+    EXPECT_EQ(123, timestamp);
+    EXPECT_EQ(456, expectedTimestamp);
+
+    mThread->setTimestampOnly(false, mConnection);
+    mCallback->onVSyncEvent(456, 789);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+    ASSERT_TRUE(timestamps->read(&count, &timestamp, &expectedTimestamp));
+    EXPECT_EQ(2u, count);
+    EXPECT_EQ(789, expectedTimestamp);
+
+    munmap(data, sizeof(gui::VsyncTimestamps));
+}
+
+TEST_F(EventThreadTest, frameRateOverrideThrottlesVsyncEventsOfThatUid) {
+    constexpr uid_t kThrottledUid = 10001;
+    constexpr nsecs_t kVsyncPeriod = 16'666'667;
+    constexpr nsecs_t kStart = 1'000'000'000;
+
+    ConnectionEventRecorder throttledConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> throttledConnection =
+            createConnection(throttledConnectionEventRecorder,
+                             ISurfaceComposer::eConfigChangedSuppress, kThrottledUid);
+    mThread->setFrameRateOverride(kThrottledUid, 30.0f);
+    mThread->setVsyncRate(1, throttledConnection);
+    mThread->setVsyncRate(1, mConnection);
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    // Events at 60Hz reach the throttled connection on every other vsync only, while other
+    // connections keep receiving all of them.
+    for (unsigned i = 0; i < 4; i++) {
+        const nsecs_t timestamp = kStart + i * kVsyncPeriod;
+        mCallback->onVSyncEvent(timestamp, timestamp);
+        expectInterceptCallReceived(timestamp);
+        expectVsyncEventReceivedByConnection(timestamp, i + 1);
+        if (i % 2 == 0) {
+            expectVsyncEventReceivedByConnection("throttledConnection",
+                                                 throttledConnectionEventRecorder, timestamp,
+                                                 i + 1);
+        } else {
+            EXPECT_FALSE(throttledConnectionEventRecorder.waitForUnexpectedCall().has_value());
+        }
+    }
+
+    // Once the override is removed, the connection receives every vsync again.
+    mThread->setFrameRateOverride(kThrottledUid, 0.0f);
+    const nsecs_t timestamp = kStart + 4 * kVsyncPeriod;
+    mCallback->onVSyncEvent(timestamp, timestamp);
+    expectInterceptCallReceived(timestamp);
+    expectVsyncEventReceivedByConnection(timestamp, 5u);
+    expectVsyncEventReceivedByConnection("throttledConnection", throttledConnectionEventRecorder,
+                                         timestamp, 5u);
+}
+
 TEST_F(EventThreadTest, connectionsRemovedIfInstanceDestroyed) {
     mThread->setVsyncRate(1, mConnection);
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "FramePhaseProfiler.h"
+
+using testing::HasSubstr;
+
+namespace android {
+namespace {
+
+using Phase = FramePhaseProfiler::Phase;
+
+constexpr nsecs_t kOneMs = 1'000'000;
+
+std::string dump(const FramePhaseProfiler& profiler) {
+    std::string result;
+    profiler.dump(result);
+    return result;
+}
+
+TEST(FramePhaseProfilerTest, frameIsCommittedByNextFrame) {
+    FramePhaseProfiler profiler;
+    profiler.startFrame();
+    profiler.recordPhase(Phase::Refresh, 2 * kOneMs);
+    EXPECT_THAT(dump(profiler), HasSubstr("last 0 frames"));
+
+    profiler.startFrame();
+    EXPECT_THAT(dump(profiler), HasSubstr("last 1 frames"));
+}
+
+TEST(FramePhaseProfilerTest, reportsPercentilesPerPhase) {
+    FramePhaseProfiler profiler;
+    for (nsecs_t i = 1; i <= 100; i++) {
+        profiler.startFrame();
+        profiler.recordPhase(Phase::Refresh, i * kOneMs);
+    }
+    profiler.startFrame();
+
+    const std::string result = dump(profiler);
+    EXPECT_THAT(result, HasSubstr("onMessageRefresh                 100    50.000    90.000    "
+                                  "99.000   100.000"));
+    // Phases that never ran are listed without samples.
+    EXPECT_THAT(result, HasSubstr("postComposition                    0"));
+}
+
+TEST(FramePhaseProfilerTest, accumulatesRepeatedPhases) {
+    FramePhaseProfiler profiler;
+    profiler.startFrame();
+    profiler.recordPhase(Phase::RenderEngineDraw, kOneMs);
+    profiler.recordPhase(Phase::RenderEngineDraw, 2 * kOneMs);
+    profiler.startFrame();
+
+    EXPECT_THAT(dump(profiler), HasSubstr("RenderEngine::drawLayers           1     3.000"));
+}
+
+TEST(FramePhaseProfilerTest, keepsMostRecentFrames) {
+    FramePhaseProfiler profiler;
+    for (size_t i = 0; i < FramePhaseProfiler::kNumFrames + 10; i++) {
+        profiler.startFrame();
+    }
+    EXPECT_THAT(dump(profiler),
+                HasSubstr("last " + std::to_string(FramePhaseProfiler::kNumFrames) + " frames"));
+}
+
+TEST(FramePhaseProfilerTest, disabledProfilerRecordsNothing) {
+    FramePhaseProfiler profiler;
+    profiler.setEnabled(false);
+    profiler.startFrame();
+    profiler.recordPhase(Phase::Refresh, kOneMs);
+    profiler.startFrame();
+    EXPECT_THAT(dump(profiler), HasSubstr("last 0 frames"));
+}
+
+} // namespace
+} // namespace android
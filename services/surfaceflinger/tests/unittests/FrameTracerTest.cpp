@@ -148,6 +148,7 @@ TEST_F(FrameTracerTest, canTraceAfterAddingLayer) {
         mFrameTracer->traceTimestamp(layerId, bufferID, frameNumber, timestamp, type, duration);
         // Create second trace packet to finalize the previous one.
         mFrameTracer->traceTimestamp(layerId, 0, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+        mFrameTracer->flush();
         tracingSession->StopBlocking();
 
         std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -165,6 +166,7 @@ TEST_F(FrameTracerTest, canTraceAfterAddingLayer) {
         mFrameTracer->traceTimestamp(layerId, bufferID, frameNumber, timestamp, type, duration);
         // Create second trace packet to finalize the previous one.
         mFrameTracer->traceTimestamp(layerId, 0, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+        mFrameTracer->flush();
         tracingSession->StopBlocking();
 
         std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -212,6 +214,7 @@ TEST_F(FrameTracerTest, traceFenceTriggersOnNextTraceAfterFenceFired) {
         mFrameTracer->traceFence(layerId, bufferID, frameNumber, fenceTime, type);
         // Create extra trace packet to (hopefully not) trigger and finalize the fence packet.
         mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+        mFrameTracer->flush();
         tracingSession->StopBlocking();
         std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
         EXPECT_EQ(raw_trace.size(), 0);
@@ -225,10 +228,13 @@ TEST_F(FrameTracerTest, traceFenceTriggersOnNextTraceAfterFenceFired) {
         tracingSession->ReadTraceBlocking();
         mFrameTracer->traceNewLayer(layerId, layerName);
         mFrameTracer->traceFence(layerId, bufferID, frameNumber, fenceTime, type);
+        // Let the tracing thread see the fence before it signals.
+        mFrameTracer->flush();
         const nsecs_t timestamp = systemTime();
         fenceFactory.signalAllForTest(Fence::NO_FENCE, timestamp);
         // Create extra trace packet to trigger and finalize fence trace packets.
         mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+        mFrameTracer->flush();
         tracingSession->StopBlocking();
 
         std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -282,10 +288,13 @@ TEST_F(FrameTracerTest, traceFenceWithStartTimeAfterSignalTime_ShouldHaveNoDurat
     const nsecs_t startTime2 = signalTime2 + 100000;
     auto fence2 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
     mFrameTracer->traceFence(layerId, bufferID, frameNumber, fence2, type, startTime2);
+    // Let the tracing thread see the fence before it signals.
+    mFrameTracer->flush();
     fenceFactory.signalAllForTest(Fence::NO_FENCE, signalTime2);
 
     // Create extra trace packet to trigger and finalize fence trace packets.
     mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+    mFrameTracer->flush();
     tracingSession->StopBlocking();
 
     std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -327,9 +336,12 @@ TEST_F(FrameTracerTest, traceFenceOlderThanDeadline_ShouldBeIgnored) {
     tracingSession->ReadTraceBlocking();
     mFrameTracer->traceNewLayer(layerId, layerName);
     mFrameTracer->traceFence(layerId, bufferID, frameNumber, fence, type);
+    // Let the tracing thread see the fence before it signals.
+    mFrameTracer->flush();
     fenceFactory.signalAllForTest(Fence::NO_FENCE, signalTime);
     // Create extra trace packet to trigger and finalize any previous fence packets.
     mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+    mFrameTracer->flush();
     tracingSession->StopBlocking();
 
     std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -363,10 +375,13 @@ TEST_F(FrameTracerTest, traceFenceWithValidStartTime_ShouldHaveCorrectDuration)
     const nsecs_t startTime2 = signalTime2 - duration;
     auto fence2 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
     mFrameTracer->traceFence(layerId, bufferID, frameNumber, fence2, type, startTime2);
+    // Let the tracing thread see the fence before it signals.
+    mFrameTracer->flush();
     fenceFactory.signalAllForTest(Fence::NO_FENCE, signalTime2);
 
     // Create extra trace packet to trigger and finalize fence trace packets.
     mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+    mFrameTracer->flush();
     tracingSession->StopBlocking();
 
     std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
@@ -396,6 +411,50 @@ TEST_F(FrameTracerTest, traceFenceWithValidStartTime_ShouldHaveCorrectDuration)
     EXPECT_EQ(buffer_event2.duration_ns(), duration);
 }
 
+TEST_F(FrameTracerTest, presentedFramesAreSummarizedPerStage) {
+    const std::string layerName = "co.layername#0";
+    const int32_t layerId = 5;
+    const uint32_t bufferID = 4;
+
+    auto tracingSession = getTracingSessionForTest();
+    tracingSession->StartBlocking();
+    mFrameTracer->traceNewLayer(layerId, layerName);
+
+    const nsecs_t start = systemTime();
+    for (uint64_t frameNumber = 1; frameNumber <= 2; frameNumber++) {
+        const nsecs_t queueTime = start + frameNumber * 100;
+        mFrameTracer->traceTimestamp(layerId, bufferID, frameNumber, queueTime,
+                                     FrameTracer::FrameEvent::QUEUE);
+        auto acquireFence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+        fenceFactory.signalAllForTest(Fence::NO_FENCE, queueTime + 10 * frameNumber);
+        mFrameTracer->traceFence(layerId, bufferID, frameNumber, acquireFence,
+                                 FrameTracer::FrameEvent::ACQUIRE_FENCE);
+        mFrameTracer->traceTimestamp(layerId, bufferID, frameNumber, queueTime + 20 * frameNumber,
+                                     FrameTracer::FrameEvent::LATCH);
+        mFrameTracer->traceTimestamp(layerId, bufferID, frameNumber, queueTime + 50 * frameNumber,
+                                     FrameTracer::FrameEvent::PRESENT_FENCE);
+        // Let the tracing thread read the fence before the next one is signalled.
+        mFrameTracer->flush();
+    }
+    // Never latched, so not counted.
+    mFrameTracer->traceTimestamp(layerId, bufferID, 3, start + 300, FrameTracer::FrameEvent::QUEUE);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 3, start + 350,
+                                 FrameTracer::FrameEvent::PRESENT_FENCE);
+
+    const FrameTracer::JourneySummary summary = mFrameTracer->getJourneySummary(layerId);
+    tracingSession->StopBlocking();
+
+    EXPECT_EQ(2u, summary.frames);
+    EXPECT_EQ(30, summary.totalGpuTime);
+    EXPECT_EQ(20, summary.maxGpuTime);
+    EXPECT_EQ(30, summary.totalLatchDelay);
+    EXPECT_EQ(20, summary.maxLatchDelay);
+    EXPECT_EQ(90, summary.totalCompositionTime);
+    EXPECT_EQ(60, summary.maxCompositionTime);
+
+    EXPECT_EQ(0u, mFrameTracer->getJourneySummary(layerId + 1).frames);
+}
+
 } // namespace
 } // namespace android
 
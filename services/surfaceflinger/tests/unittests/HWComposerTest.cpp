@@ -171,5 +171,40 @@ TEST_F(HWComposerLayerGenericMetadataTest, forwardsSupportedMetadata) {
     EXPECT_EQ(hal::Error::UNSUPPORTED, result);
 }
 
+TEST_F(HWComposerLayerGenericMetadataTest, skipsUnchangedMetadata) {
+    EXPECT_CALL(*mHal,
+                setLayerGenericMetadata(kDisplayId, kLayerId, kLayerGenericMetadata1Name,
+                                        kLayerGenericMetadata1Mandatory,
+                                        kLayerGenericMetadata1Value))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_EQ(hal::Error::NONE,
+              mLayer.setLayerGenericMetadata(kLayerGenericMetadata1Name,
+                                             kLayerGenericMetadata1Mandatory,
+                                             kLayerGenericMetadata1Value));
+    EXPECT_EQ(hal::Error::NONE,
+              mLayer.setLayerGenericMetadata(kLayerGenericMetadata1Name,
+                                             kLayerGenericMetadata1Mandatory,
+                                             kLayerGenericMetadata1Value));
+}
+
+struct HWComposerLayerColorTest : public HWComposerLayerTest {
+    static constexpr hal::Color kColor = {1, 2, 3, 255};
+
+    HWComposerLayerColorTest() : HWComposerLayerTest({}) {}
+};
+
+TEST_F(HWComposerLayerColorTest, skipsUnchangedColorUntilCompositionTypeChanges) {
+    EXPECT_CALL(*mHal, setLayerColor(kDisplayId, kLayerId, kColor))
+            .Times(2)
+            .WillRepeatedly(Return(hardware::graphics::composer::V2_4::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerCompositionType(kDisplayId, kLayerId, hal::Composition::SOLID_COLOR))
+            .WillOnce(Return(hardware::graphics::composer::V2_4::Error::NONE));
+
+    EXPECT_EQ(hal::Error::NONE, mLayer.setColor(kColor));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setColor(kColor));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setCompositionType(hal::Composition::SOLID_COLOR));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setColor(kColor));
+}
+
 } // namespace
 } // namespace android
@@ -70,6 +70,10 @@ protected:
                              [now](const auto& pair) { return pair.second->isAnimating(now); });
     }
 
+    static auto detectCadence(const std::vector<nsecs_t>& frameTimeDeltas) {
+        return LayerInfoV2::detectCadence(frameTimeDeltas);
+    }
+
     void setLayerInfoVote(Layer* layer,
                           LayerHistory::LayerVoteType vote) NO_THREAD_SAFETY_ANALYSIS {
         for (auto& [weak, info] : history().mLayerInfos) {
@@ -671,6 +675,47 @@ TEST_F(LayerHistoryTestV2, heuristicLayerNotOscillating) {
     recordFramesAndExpect(layer, time, 27.10f, 30.0f, PRESENT_TIME_HISTORY_SIZE);
 }
 
+TEST_F(LayerHistoryTestV2, detectsUniformCadence) {
+    const std::vector<nsecs_t> deltas(PRESENT_TIME_HISTORY_SIZE, LO_FPS_PERIOD);
+    const auto cadence = detectCadence(deltas);
+    EXPECT_EQ(1u, cadence.length);
+    EXPECT_EQ(LO_FPS_PERIOD, cadence.frameTime);
+    EXPECT_FLOAT_EQ(1.0f, cadence.confidence);
+}
+
+TEST_F(LayerHistoryTestV2, detectsPulldownCadence) {
+    // 24fps content on a 60Hz display is presented for 2 and 3 vsyncs alternately.
+    constexpr nsecs_t vsyncPeriod = 16'666'667;
+    std::vector<nsecs_t> deltas;
+    for (size_t i = 0; i < PRESENT_TIME_HISTORY_SIZE; i++) {
+        deltas.push_back(vsyncPeriod * (i % 2 == 0 ? 2 : 3));
+    }
+    const auto cadence = detectCadence(deltas);
+    EXPECT_EQ(2u, cadence.length);
+    EXPECT_EQ(vsyncPeriod * 5 / 2, cadence.frameTime);
+    EXPECT_FLOAT_EQ(1.0f, cadence.confidence);
+}
+
+TEST_F(LayerHistoryTestV2, cadenceIgnoresDroppedFrames) {
+    std::vector<nsecs_t> deltas(PRESENT_TIME_HISTORY_SIZE, LO_FPS_PERIOD);
+    deltas[10] = 2 * LO_FPS_PERIOD;
+    deltas[50] = 3 * LO_FPS_PERIOD;
+    const auto cadence = detectCadence(deltas);
+    EXPECT_EQ(1u, cadence.length);
+    EXPECT_EQ(LO_FPS_PERIOD, cadence.frameTime);
+    EXPECT_LT(cadence.confidence, 1.0f);
+    EXPECT_GE(cadence.confidence, 0.9f);
+}
+
+TEST_F(LayerHistoryTestV2, irregularCadenceHasLowConfidence) {
+    std::vector<nsecs_t> deltas;
+    for (size_t i = 0; i < PRESENT_TIME_HISTORY_SIZE; i++) {
+        // A pattern that does not repeat within a few frames
+        deltas.push_back(HI_FPS_PERIOD * static_cast<nsecs_t>(1 + (i * i) % 7));
+    }
+    EXPECT_LT(detectCadence(deltas).confidence, 0.9f);
+}
+
 class LayerHistoryTestV2Parameterized
       : public LayerHistoryTestV2,
         public testing::WithParamInterface<std::chrono::nanoseconds> {};
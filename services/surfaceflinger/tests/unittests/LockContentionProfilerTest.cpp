@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "LockContentionProfiler.h"
+
+using testing::HasSubstr;
+using testing::Not;
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kOneMs = 1'000'000;
+
+std::string dump(const LockContentionProfiler& profiler) {
+    std::string result;
+    profiler.dump(result);
+    return result;
+}
+
+TEST(LockContentionProfilerTest, countsUncontendedAcquisitions) {
+    Mutex mutex;
+    LockContentionProfiler profiler("mutex");
+    { ProfiledLock lock(mutex, profiler, __FUNCTION__, __LINE__); }
+    { ProfiledLock lock(mutex, profiler, __FUNCTION__, __LINE__); }
+
+    const std::string result = dump(profiler);
+    EXPECT_THAT(result, HasSubstr("mutex (enabled): 2 uncontended, 0 contended acquisitions"));
+    EXPECT_THAT(result, Not(HasSubstr("call site")));
+}
+
+TEST(LockContentionProfilerTest, reportsWaitsPerCallSite) {
+    LockContentionProfiler profiler("mutex");
+    const char* function = "setTransactionState";
+    profiler.recordWait(function, 10, kOneMs);
+    profiler.recordWait(function, 10, 3 * kOneMs);
+    profiler.recordWait("onMessageInvalidate", 20, 10 * kOneMs);
+
+    const std::string result = dump(profiler);
+    EXPECT_THAT(result, HasSubstr("0 uncontended, 3 contended acquisitions"));
+    EXPECT_THAT(result, HasSubstr("setTransactionState:10                                   "
+                                  "2       4.000     2.000     3.000"));
+    // The call site with the longest total wait is listed first.
+    EXPECT_LT(result.find("onMessageInvalidate:20"), result.find("setTransactionState:10"));
+}
+
+TEST(LockContentionProfilerTest, clearDropsRecordedWaits) {
+    LockContentionProfiler profiler("mutex");
+    profiler.recordUncontended();
+    profiler.recordWait("setTransactionState", 10, kOneMs);
+    profiler.clear();
+
+    EXPECT_THAT(dump(profiler), HasSubstr("0 uncontended, 0 contended acquisitions"));
+}
+
+TEST(LockContentionProfilerTest, disabledProfilerRecordsNothing) {
+    Mutex mutex;
+    LockContentionProfiler profiler("mutex");
+    profiler.setEnabled(false);
+    { ProfiledLock lock(mutex, profiler, __FUNCTION__, __LINE__); }
+
+    EXPECT_THAT(dump(profiler), HasSubstr("mutex (disabled): 0 uncontended"));
+}
+
+} // namespace
+} // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "PowerAdvisorTest"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+
+#include "DisplayHardware/PowerAdvisor.h"
+
+namespace android::Hwc2::impl {
+namespace {
+
+using CompositionLoad = PowerAdvisor::CompositionLoad;
+
+ClientCompositionWorkload makeWorkload(size_t layerCount, float area, float blurArea = 0.0f) {
+    ClientCompositionWorkload workload;
+    workload.layerCount = layerCount;
+    workload.area = area;
+    workload.blurArea = blurArea;
+    return workload;
+}
+
+// 0.5ms per draw, 0.1ms per layer, 1ms per megapixel and 4ms per blurred megapixel.
+nsecs_t getCost(const ClientCompositionWorkload& workload) {
+    return us2ns(500) + workload.layerCount * us2ns(100) +
+            static_cast<nsecs_t>(workload.area) + static_cast<nsecs_t>(workload.blurArea * 4);
+}
+
+TEST(ClientCompositionCostModelTest, doesNotPredictWithFewSamples) {
+    ClientCompositionCostModel model;
+    const auto workload = makeWorkload(4, 2e6f);
+    for (size_t i = 1; i < ClientCompositionCostModel::kMinSamples; i++) {
+        model.addSample(workload, getCost(workload));
+        EXPECT_FALSE(model.isReady());
+        EXPECT_EQ(-1, model.predict(workload));
+    }
+
+    model.addSample(workload, getCost(workload));
+    EXPECT_TRUE(model.isReady());
+    EXPECT_NEAR(getCost(workload), model.predict(workload), us2ns(50));
+}
+
+TEST(ClientCompositionCostModelTest, predictsUnseenWorkloads) {
+    ClientCompositionCostModel model;
+    const ClientCompositionWorkload workloads[] = {
+            makeWorkload(2, 1e6f),
+            makeWorkload(8, 2.5e6f),
+            makeWorkload(5, 2.5e6f, 0.5e6f),
+            makeWorkload(12, 1.5e6f, 1e6f),
+    };
+    for (int i = 0; i < 40; i++) {
+        const auto& workload = workloads[i % std::size(workloads)];
+        model.addSample(workload, getCost(workload));
+    }
+
+    const auto unseen = makeWorkload(6, 3e6f, 2e6f);
+    EXPECT_NEAR(getCost(unseen), model.predict(unseen), us2ns(250));
+}
+
+TEST(ClientCompositionCostModelTest, followsChangingCosts) {
+    ClientCompositionCostModel model;
+    const auto workload = makeWorkload(4, 2e6f);
+    for (int i = 0; i < 20; i++) {
+        model.addSample(workload, ms2ns(2));
+    }
+    EXPECT_NEAR(ms2ns(2), model.predict(workload), us2ns(50));
+
+    // The GPU clock dropped.
+    for (int i = 0; i < 40; i++) {
+        model.addSample(workload, ms2ns(6));
+    }
+    EXPECT_NEAR(ms2ns(6), model.predict(workload), us2ns(100));
+}
+
+TEST(PowerAdvisorTest, gradesPredictedCostAgainstFrameBudget) {
+    const nsecs_t budget = ms2ns(16);
+    EXPECT_EQ(CompositionLoad::Light, PowerAdvisor::getCompositionLoad(ms2ns(1), budget));
+    EXPECT_EQ(CompositionLoad::Moderate, PowerAdvisor::getCompositionLoad(ms2ns(4), budget));
+    EXPECT_EQ(CompositionLoad::Moderate, PowerAdvisor::getCompositionLoad(ms2ns(7), budget));
+    EXPECT_EQ(CompositionLoad::Heavy, PowerAdvisor::getCompositionLoad(ms2ns(8), budget));
+
+    // The same frame is heavier at a higher refresh rate.
+    EXPECT_EQ(CompositionLoad::Heavy, PowerAdvisor::getCompositionLoad(ms2ns(6), ms2ns(11)));
+}
+
+} // namespace
+} // namespace android::Hwc2::impl
@@ -106,6 +106,20 @@ TEST_F(RegionSamplingTest, bounds_checking) {
                 testing::Eq(0.0));
 }
 
+TEST_F(RegionSamplingTest, scale_sample_area) {
+    EXPECT_EQ(Rect(0, 0, 4, 4), scaleSampleArea(Rect(0, 0, 4, 4), 1));
+    EXPECT_EQ(Rect(0, 0, 2, 2), scaleSampleArea(Rect(0, 0, 4, 4), 2));
+    // Partially covered pixels of the downscaled capture are included.
+    EXPECT_EQ(Rect(1, 0, 3, 1), scaleSampleArea(Rect(3, 1, 9, 2), 3));
+
+    std::fill(buffer.begin(), buffer.end(), kWhite);
+    const Rect scaled = scaleSampleArea(whole_area, 4);
+    EXPECT_EQ(Rect(0, 0, (kWidth + 3) / 4, (kHeight + 3) / 4), scaled);
+    EXPECT_THAT(sampleArea(buffer.data(), scaled.getWidth(), scaled.getHeight(), kStride,
+                           kOrientation, scaled),
+                testing::Eq(1.0));
+}
+
 // workaround for b/133849373
 TEST_F(RegionSamplingTest, orientation_90) {
     std::generate(buffer.begin(), buffer.end(),
@@ -65,10 +65,6 @@ class Factory final : public surfaceflinger::Factory {
 public:
     ~Factory() = default;
 
-    std::unique_ptr<DispSync> createDispSync(const char*, bool) override {
-        return nullptr;
-    }
-
     std::unique_ptr<EventControlThread> createEventControlThread(
             std::function<void(bool)>) override {
         return nullptr;
@@ -359,12 +355,18 @@ public:
                              bool hasListenerCallbacks,
                              std::vector<ListenerCallbacks>& listenerCallbacks) {
         return mFlinger->setTransactionState(states, displays, flags, applyToken,
-                                             inputWindowCommands, desiredPresentTime, uncacheBuffer,
-                                             hasListenerCallbacks, listenerCallbacks);
+                                             inputWindowCommands, desiredPresentTime, systemTime(),
+                                             uncacheBuffer, hasListenerCallbacks,
+                                             listenerCallbacks);
     }
 
     auto flushTransactionQueues() { return mFlinger->flushTransactionQueues(); };
 
+    static void mergeTransactionState(SurfaceFlinger::TransactionState& into,
+                                      const SurfaceFlinger::TransactionState& from) {
+        SurfaceFlinger::mergeTransactionState(into, from);
+    }
+
     /* ------------------------------------------------------------------------
      * Read-only access to private data to assert post-conditions.
      */
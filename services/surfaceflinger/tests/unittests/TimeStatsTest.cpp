@@ -521,6 +521,80 @@ TEST_F(TimeStatsTest, canInsertGlobalRenderEngineTiming) {
     EXPECT_EQ(2, histogramProto.time_millis());
 }
 
+TEST_F(TimeStatsTest, canInsertTransactionTimeStatsPerUid) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    TimeStats::TransactionTimes times;
+    times.uid = 1000;
+    times.applyTime = std::chrono::nanoseconds(1ms).count();
+    times.postTime = std::chrono::nanoseconds(2ms).count();
+    times.readyTime = std::chrono::nanoseconds(10ms).count();
+    times.desiredPresentBlockedTime = std::chrono::nanoseconds(8ms).count();
+    times.commitTime = std::chrono::nanoseconds(12ms).count();
+    mTimeStats->recordTransaction(times);
+    times.uid = 2000;
+    times.desiredPresentBlockedTime = 0;
+    mTimeStats->recordTransaction(times);
+
+    // Transactions are only counted once the frame presenting them is known.
+    SFTimeStatsGlobalProto preFlushProto;
+    ASSERT_TRUE(preFlushProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+    ASSERT_EQ(0, preFlushProto.transaction_stats_size());
+
+    mTimeStats->setPowerMode(PowerMode::ON);
+    mTimeStats->setPresentFenceGlobal(
+            std::make_shared<FenceTime>(std::chrono::nanoseconds(20ms).count()));
+    // Committed after the last present, so not presented yet.
+    mTimeStats->recordTransaction(times);
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+    ASSERT_EQ(2, globalProto.transaction_stats_size());
+
+    for (const SFTimeStatsTransactionProto& transactionProto : globalProto.transaction_stats()) {
+        EXPECT_EQ(1, transactionProto.total_transactions());
+        std::unordered_map<std::string, int32_t> deltas;
+        for (const SFTimeStatsDeltaProto& deltaProto : transactionProto.deltas()) {
+            ASSERT_EQ(1, deltaProto.histograms_size());
+            EXPECT_EQ(1, deltaProto.histograms().Get(0).frame_count());
+            deltas[deltaProto.delta_name()] = deltaProto.histograms().Get(0).time_millis();
+        }
+        EXPECT_EQ(1, deltas["apply2receive"]);
+        EXPECT_EQ(8, deltas["receive2ready"]);
+        EXPECT_EQ(2, deltas["ready2commit"]);
+        EXPECT_EQ(8, deltas["commit2present"]);
+        EXPECT_EQ(19, deltas["apply2present"]);
+        if (transactionProto.uid() == 1000) {
+            EXPECT_EQ(8, deltas["desiredPresentBlocked"]);
+        } else {
+            EXPECT_EQ(2000, transactionProto.uid());
+            EXPECT_EQ(0u, deltas.count("desiredPresentBlocked"));
+        }
+        EXPECT_EQ(0u, deltas.count("fenceBlocked"));
+    }
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result, HasSubstr("transactionUid = 1000\ntotalTransactions = 1\n"));
+}
+
+TEST_F(TimeStatsTest, transactionQueuedWhileDisabledIsNotRecorded) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    // Only the ready and commit times are set once the transaction is flushed.
+    TimeStats::TransactionTimes times;
+    times.readyTime = std::chrono::nanoseconds(10ms).count();
+    times.commitTime = std::chrono::nanoseconds(12ms).count();
+    mTimeStats->recordTransaction(times);
+
+    mTimeStats->setPowerMode(PowerMode::ON);
+    mTimeStats->setPresentFenceGlobal(
+            std::make_shared<FenceTime>(std::chrono::nanoseconds(20ms).count()));
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+    EXPECT_EQ(0, globalProto.transaction_stats_size());
+}
+
 TEST_F(TimeStatsTest, canInsertOneLayerTimeStats) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
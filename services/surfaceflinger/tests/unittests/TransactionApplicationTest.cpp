@@ -67,13 +67,15 @@ public:
         EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
         EXPECT_CALL(*eventThread, createEventConnection(_, _))
                 .WillOnce(Return(
-                        new EventThreadConnection(eventThread.get(), ResyncCallback(),
+                        new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                  ResyncCallback(),
                                                   ISurfaceComposer::eConfigChangedSuppress)));
 
         EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
         EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
                 .WillOnce(Return(
-                        new EventThreadConnection(sfEventThread.get(), ResyncCallback(),
+                        new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                  ResyncCallback(),
                                                   ISurfaceComposer::eConfigChangedSuppress)));
 
         EXPECT_CALL(*mPrimaryDispSync, computeNextRefresh(0, _)).WillRepeatedly(Return(0));
@@ -319,6 +321,48 @@ TEST_F(TransactionApplicationTest, BlockWithPriorTransaction_SyncInputWindows) {
     BlockedByPriorTransaction(/*flags*/ 0, /*syncInputWindows*/ true);
 }
 
+TEST_F(TransactionApplicationTest, MergeTransactionState_LastWriterWins) {
+    const sp<IBinder> handleA = new BBinder();
+    const sp<IBinder> handleB = new BBinder();
+
+    ComposerState stateA;
+    stateA.state.surface = handleA;
+    stateA.state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    stateA.state.x = 1;
+    stateA.state.y = 2;
+    stateA.state.alpha = 0.5f;
+    Vector<ComposerState> firstStates;
+    firstStates.add(stateA);
+
+    ComposerState stateA2;
+    stateA2.state.surface = handleA;
+    stateA2.state.what = layer_state_t::ePositionChanged;
+    stateA2.state.x = 10;
+    stateA2.state.y = 20;
+    ComposerState stateB;
+    stateB.state.surface = handleB;
+    stateB.state.what = layer_state_t::eCornerRadiusChanged;
+    stateB.state.cornerRadius = 4.f;
+    Vector<ComposerState> secondStates;
+    secondStates.add(stateA2);
+    secondStates.add(stateB);
+
+    SurfaceFlinger::TransactionState first(firstStates, {}, 0, -1, {}, 0, false, false, {});
+    const SurfaceFlinger::TransactionState second(secondStates, {}, 0, -1, {}, 0, false, false,
+                                                  {});
+    TestableSurfaceFlinger::mergeTransactionState(first, second);
+
+    ASSERT_EQ(2u, first.states.size());
+    const layer_state_t& mergedA = first.states[0].state;
+    EXPECT_EQ(handleA, mergedA.surface);
+    EXPECT_EQ(10.f, mergedA.x);
+    EXPECT_EQ(20.f, mergedA.y);
+    EXPECT_EQ(0.5f, mergedA.alpha);
+    const layer_state_t& mergedB = first.states[1].state;
+    EXPECT_EQ(handleB, mergedB.surface);
+    EXPECT_EQ(4.f, mergedB.cornerRadius);
+}
+
 TEST_F(TransactionApplicationTest, FromHandle) {
     sp<IBinder> badHandle;
     auto ret = mFlinger.fromHandle(badHandle);
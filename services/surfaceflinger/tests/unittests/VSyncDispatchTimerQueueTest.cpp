@@ -778,6 +778,26 @@ TEST_F(VSyncDispatchTimerQueueTest, laggedTimerGroupsCallbacksWithinLag) {
     EXPECT_THAT(cb2.mWakeupTime[0], Eq(610));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, dumpsCoalescedWakeups) {
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+    CountingCallback cb2(mDispatch);
+
+    mDispatch.schedule(cb0, 400, 1000);
+    mDispatch.schedule(cb1, 400 + mDispatchGroupThreshold - 1, 1000);
+    mDispatch.schedule(cb2, 200, 1000);
+    advanceToNextCallback();
+    advanceToNextCallback();
+
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    ASSERT_THAT(cb1.mCalls.size(), Eq(1));
+    ASSERT_THAT(cb2.mCalls.size(), Eq(1));
+
+    std::string dump;
+    mDispatch.dump(dump);
+    EXPECT_THAT(dump, HasSubstr("Wakeups: 2 for 3 callbacks (1 coalesced)"));
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
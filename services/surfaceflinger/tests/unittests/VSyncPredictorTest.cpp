@@ -320,6 +320,44 @@ TEST_F(VSyncPredictorTest, willBeAccurateUsingPriorResultsForRate) {
     EXPECT_THAT(intercept, Eq(0));
 }
 
+TEST_F(VSyncPredictorTest, needsFewerSamplesWhenReturningToFittedRate) {
+    auto const idealPeriod = 100000;
+    auto const fittedPeriod = 101000;
+    auto const slowPeriod = 400000;
+
+    tracker.setPeriod(idealPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += fittedPeriod);
+    }
+    EXPECT_THAT(std::get<0>(tracker.getVSyncPredictionModel()), Eq(fittedPeriod));
+
+    tracker.setPeriod(slowPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += slowPeriod);
+    }
+
+    // Without samples, the synthetic prediction uses the previously fitted period.
+    tracker.setPeriod(idealPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow), Eq(mNow + fittedPeriod));
+
+    for (auto i = 0u; i < kMinimumSamplesForPrediction / 2; i++) {
+        EXPECT_TRUE(tracker.needsMoreSamples());
+        tracker.addVsyncTimestamp(mNow += fittedPeriod);
+        EXPECT_THAT(std::get<0>(tracker.getVSyncPredictionModel()), Eq(fittedPeriod));
+    }
+    EXPECT_FALSE(tracker.needsMoreSamples());
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow), Eq(mNow + fittedPeriod));
+
+    // After a reset the period has to be fitted from scratch again.
+    tracker.resetModel();
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow), Eq(mNow + idealPeriod));
+    for (auto i = 0u; i < kMinimumSamplesForPrediction / 2; i++) {
+        tracker.addVsyncTimestamp(mNow += idealPeriod);
+    }
+    EXPECT_TRUE(tracker.needsMoreSamples());
+}
+
 TEST_F(VSyncPredictorTest, idealModelPredictionsBeforeRegressionModelIsBuilt) {
     auto const simulatedVsyncs =
             generateVsyncTimestamps(kMinimumSamplesForPrediction + 1, mPeriod, 0);
@@ -71,9 +71,10 @@ public:
             hal::Error(std::unordered_map<Layer*, android::sp<android::Fence>>* outFences));
     MOCK_METHOD1(present, hal::Error(android::sp<android::Fence>*));
     MOCK_METHOD1(setActiveConfig, hal::Error(const std::shared_ptr<const HWC2::Display::Config>&));
-    MOCK_METHOD4(setClientTarget,
+    MOCK_METHOD5(setClientTarget,
                  hal::Error(uint32_t, const android::sp<android::GraphicBuffer>&,
-                            const android::sp<android::Fence>&, hal::Dataspace));
+                            const android::sp<android::Fence>&, hal::Dataspace,
+                            const android::Region&));
     MOCK_METHOD2(setColorMode, hal::Error(hal::ColorMode, hal::RenderIntent));
     MOCK_METHOD2(setColorTransform, hal::Error(const android::mat4&, hal::ColorTransform));
     MOCK_METHOD2(setOutputBuffer,
@@ -33,6 +33,11 @@ public:
     MOCK_METHOD2(setExpensiveRenderingExpected, void(DisplayId displayId, bool expected));
     MOCK_METHOD0(notifyDisplayUpdateImminent, void());
     MOCK_METHOD0(canNotifyDisplayUpdateImminent, bool());
+    MOCK_METHOD2(notifyClientCompositionStarted,
+                 void(DisplayId displayId, const ClientCompositionWorkload& workload));
+    MOCK_METHOD3(notifyClientCompositionSubmitted,
+                 void(DisplayId displayId, nsecs_t startTime,
+                      const std::shared_ptr<FenceTime>& readyFence));
 };
 
 } // namespace mock
@@ -40,9 +40,12 @@ public:
                  status_t(const sp<android::EventThreadConnection> &));
     MOCK_METHOD2(setVsyncRate, void(uint32_t, const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(requestNextVsync, void(const sp<android::EventThreadConnection> &));
+    MOCK_METHOD2(setTimestampOnly, void(bool, const sp<android::EventThreadConnection> &));
+    MOCK_METHOD1(getVsyncTimestamps, status_t(sp<NativeHandle> *));
     MOCK_METHOD1(requestLatestConfig, void(const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_METHOD0(getEventThreadConnectionCount, size_t());
+    MOCK_METHOD2(setFrameRateOverride, void(uid_t, float));
 };
 
 } // namespace mock
@@ -21,14 +21,19 @@
 #include <alloca.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android/dlext.h>
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <cutils/properties.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -321,14 +326,245 @@ void* LayerLibrary::GetGPA(const Layer& layer, const std::string_view gpa_name)
 
 // ----------------------------------------------------------------------------
 
+// Remembers the layers of each library found by a previous discovery, so that
+// libraries which did not change since then are not loaded just to enumerate
+// them again. It is read from and written to the path given by
+// GraphicsEnv::getLayerIndexPath(), with entries keyed by the library path and
+// validated against the modification time and size of the file holding it.
+class LayerIndex {
+   public:
+    explicit LayerIndex(const std::string& filename);
+
+    // Appends the layers of library |path| to |instance_layers| when they are
+    // in the index and the library is unchanged.
+    bool Lookup(const std::string& path,
+                size_t library_idx,
+                std::vector<Layer>& instance_layers);
+    // Records the layers just enumerated from library |path|.
+    void Insert(const std::string& path,
+                std::vector<Layer>::const_iterator begin,
+                std::vector<Layer>::const_iterator end);
+    // Keeps the entry of library |path| without looking at it, for libraries
+    // that are not discovered again.
+    void Keep(const std::string& path);
+
+    // Writes back the entries seen by this discovery if anything changed.
+    void Save() const;
+
+   private:
+    struct Entry {
+        int64_t mtime_ns;
+        int64_t size;
+        std::vector<Layer> layers;
+    };
+
+    static bool Stat(const std::string& path, Entry& entry);
+
+    const std::string filename_;
+    std::unordered_map<std::string, Entry> loaded_;
+    std::unordered_map<std::string, Entry> seen_;
+    bool dirty_;
+};
+
+constexpr uint32_t kLayerIndexMagic = 0x494c4b56;  // "VKLI"
+constexpr uint32_t kLayerIndexVersion = 1;
+
+template <typename T>
+void AppendIndexData(std::string& data, const T& value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadIndexData(const std::string& data, size_t& offset, T& value) {
+    if (data.size() - offset < sizeof(value))
+        return false;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+bool ReadIndexExtensions(const std::string& data,
+                         size_t& offset,
+                         std::vector<VkExtensionProperties>& extensions) {
+    uint32_t count;
+    if (!ReadIndexData(data, offset, count) ||
+        (data.size() - offset) / sizeof(VkExtensionProperties) < count)
+        return false;
+    extensions.resize(count);
+    for (auto& extension : extensions)
+        ReadIndexData(data, offset, extension);
+    return true;
+}
+
+void AppendIndexExtensions(
+    std::string& data,
+    const std::vector<VkExtensionProperties>& extensions) {
+    AppendIndexData(data, static_cast<uint32_t>(extensions.size()));
+    for (const auto& extension : extensions)
+        AppendIndexData(data, extension);
+}
+
+LayerIndex::LayerIndex(const std::string& filename)
+    : filename_(filename), dirty_(false) {
+    std::string data;
+    if (filename_.empty() || !android::base::ReadFileToString(filename_, &data))
+        return;
+
+    size_t offset = 0;
+    uint32_t magic, version, num_entries;
+    if (!ReadIndexData(data, offset, magic) ||
+        !ReadIndexData(data, offset, version) ||
+        !ReadIndexData(data, offset, num_entries) ||
+        magic != kLayerIndexMagic || version != kLayerIndexVersion) {
+        ALOGW("ignoring invalid layer index '%s'", filename_.c_str());
+        return;
+    }
+
+    std::unordered_map<std::string, Entry> entries;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        uint32_t path_len, num_layers;
+        Entry entry;
+        if (!ReadIndexData(data, offset, path_len) ||
+            data.size() - offset < path_len) {
+            ALOGW("ignoring truncated layer index '%s'", filename_.c_str());
+            return;
+        }
+        std::string path = data.substr(offset, path_len);
+        offset += path_len;
+        if (!ReadIndexData(data, offset, entry.mtime_ns) ||
+            !ReadIndexData(data, offset, entry.size) ||
+            !ReadIndexData(data, offset, num_layers)) {
+            ALOGW("ignoring truncated layer index '%s'", filename_.c_str());
+            return;
+        }
+        for (uint32_t j = 0; j < num_layers; j++) {
+            Layer layer;
+            uint8_t is_global;
+            if (!ReadIndexData(data, offset, layer.properties) ||
+                !ReadIndexData(data, offset, is_global) ||
+                !ReadIndexExtensions(data, offset, layer.instance_extensions) ||
+                !ReadIndexExtensions(data, offset, layer.device_extensions)) {
+                ALOGW("ignoring truncated layer index '%s'", filename_.c_str());
+                return;
+            }
+            layer.library_idx = 0;
+            layer.is_global = is_global != 0;
+            entry.layers.push_back(std::move(layer));
+        }
+        entries.emplace(std::move(path), std::move(entry));
+    }
+    loaded_ = std::move(entries);
+}
+
+bool LayerIndex::Stat(const std::string& path, Entry& entry) {
+    // Libraries loaded from an APK are as recent as the APK itself.
+    std::string file = path.substr(0, path.find("!/"));
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0)
+        return false;
+    entry.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                     st.st_mtim.tv_nsec;
+    entry.size = st.st_size;
+    return true;
+}
+
+bool LayerIndex::Lookup(const std::string& path,
+                        size_t library_idx,
+                        std::vector<Layer>& instance_layers) {
+    auto it = loaded_.find(path);
+    if (it == loaded_.end())
+        return false;
+
+    Entry current;
+    if (!Stat(path, current) || current.mtime_ns != it->second.mtime_ns ||
+        current.size != it->second.size)
+        return false;
+
+    for (Layer layer : it->second.layers) {
+        layer.library_idx = library_idx;
+        ALOGD("added %s layer '%s' from library '%s' (indexed)",
+              (layer.is_global) ? "global" : "instance",
+              layer.properties.layerName, path.c_str());
+        instance_layers.push_back(std::move(layer));
+    }
+    seen_[path] = it->second;
+    return true;
+}
+
+void LayerIndex::Insert(const std::string& path,
+                        std::vector<Layer>::const_iterator begin,
+                        std::vector<Layer>::const_iterator end) {
+    if (filename_.empty())
+        return;
+
+    Entry entry;
+    if (!Stat(path, entry))
+        return;
+    entry.layers.assign(begin, end);
+    seen_[path] = std::move(entry);
+    dirty_ = true;
+}
+
+void LayerIndex::Keep(const std::string& path) {
+    auto it = loaded_.find(path);
+    if (it != loaded_.end())
+        seen_.insert(*it);
+}
+
+void LayerIndex::Save() const {
+    if (filename_.empty() || (!dirty_ && seen_.size() == loaded_.size()))
+        return;
+
+    std::string data;
+    AppendIndexData(data, kLayerIndexMagic);
+    AppendIndexData(data, kLayerIndexVersion);
+    AppendIndexData(data, static_cast<uint32_t>(seen_.size()));
+    for (const auto& [path, entry] : seen_) {
+        AppendIndexData(data, static_cast<uint32_t>(path.size()));
+        data.append(path);
+        AppendIndexData(data, entry.mtime_ns);
+        AppendIndexData(data, entry.size);
+        AppendIndexData(data, static_cast<uint32_t>(entry.layers.size()));
+        for (const auto& layer : entry.layers) {
+            AppendIndexData(data, layer.properties);
+            AppendIndexData(data, static_cast<uint8_t>(layer.is_global));
+            AppendIndexExtensions(data, layer.instance_extensions);
+            AppendIndexExtensions(data, layer.device_extensions);
+        }
+    }
+
+    // Write to a temporary file first so that a process dying halfway, or
+    // another process discovering layers at the same time, never leaves a
+    // partial index behind.
+    std::string tmp_filename = filename_ + ".tmp";
+    if (!android::base::WriteStringToFile(data, tmp_filename) ||
+        rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+        ALOGW("failed to write layer index '%s': %s", filename_.c_str(),
+              strerror(errno));
+        unlink(tmp_filename.c_str());
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 std::vector<LayerLibrary> g_layer_libraries;
 std::vector<Layer> g_instance_layers;
 
-void AddLayerLibrary(const std::string& path, const std::string& filename) {
-    LayerLibrary library(path + "/" + filename, filename);
+void AddLayerLibrary(const std::string& path,
+                     const std::string& filename,
+                     LayerIndex& index) {
+    const std::string library_path = path + "/" + filename;
+    LayerLibrary library(library_path, filename);
+    if (index.Lookup(library_path, g_layer_libraries.size(),
+                     g_instance_layers)) {
+        g_layer_libraries.emplace_back(std::move(library));
+        return;
+    }
+
     if (!library.Open())
         return;
 
+    size_t prev_num_instance_layers = g_instance_layers.size();
     if (!library.EnumerateLayers(g_layer_libraries.size(), g_instance_layers)) {
         library.Close();
         return;
@@ -336,6 +572,9 @@ void AddLayerLibrary(const std::string& path, const std::string& filename) {
 
     library.Close();
 
+    index.Insert(library_path,
+                 g_instance_layers.cbegin() + prev_num_instance_layers,
+                 g_instance_layers.cend());
     g_layer_libraries.emplace_back(std::move(library));
 }
 
@@ -408,7 +647,7 @@ void ForEachFileInPath(const std::string& path, Functor functor) {
     }
 }
 
-void DiscoverLayersInPathList(const std::string& pathstr) {
+void DiscoverLayersInPathList(const std::string& pathstr, LayerIndex& index) {
     ATRACE_CALL();
 
     std::vector<std::string> paths = android::base::Split(pathstr, ":");
@@ -434,7 +673,9 @@ void DiscoverLayersInPathList(const std::string& pathstr) {
                 }
 
                 if (!duplicate)
-                    AddLayerLibrary(path, filename);
+                    AddLayerLibrary(path, filename, index);
+                else
+                    index.Keep(path + "/" + filename);
             }
         });
     }
@@ -461,11 +702,13 @@ void* GetLayerGetProcAddr(const Layer& layer,
 void DiscoverLayers() {
     ATRACE_CALL();
 
+    LayerIndex index(android::GraphicsEnv::getInstance().getLayerIndexPath());
     if (android::GraphicsEnv::getInstance().isDebuggable()) {
-        DiscoverLayersInPathList(kSystemLayerLibraryDir);
+        DiscoverLayersInPathList(kSystemLayerLibraryDir, index);
     }
     if (!android::GraphicsEnv::getInstance().getLayerPaths().empty())
-        DiscoverLayersInPathList(android::GraphicsEnv::getInstance().getLayerPaths());
+        DiscoverLayersInPathList(android::GraphicsEnv::getInstance().getLayerPaths(), index);
+    index.Save();
 }
 
 uint32_t GetLayerCount() {
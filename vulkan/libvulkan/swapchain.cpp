@@ -17,6 +17,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <android/hardware/graphics/common/1.0/types.h>
+#include <cutils/properties.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <graphicsenv/GraphicsEnv.h>
 #include <log/log.h>
@@ -232,7 +233,11 @@ struct Swapchain {
           acquire_next_image_timeout(-1),
           shared(present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
                  present_mode ==
-                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
+                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR),
+          low_latency(!shared &&
+                      property_get_bool("debug.vulkan.swapchain.low_latency",
+                                        false)),
+          last_present_fence(-1) {
         ANativeWindow* window = surface.window.get();
         native_window_get_refresh_cycle_duration(
             window,
@@ -256,6 +261,13 @@ struct Swapchain {
     int64_t refresh_duration;
     nsecs_t acquire_next_image_timeout;
     bool shared;
+    // In low latency mode, AcquireNextImageKHR waits for the rendering of the
+    // last presented image to complete before dequeueing the next one, so
+    // that the app never gets more than one frame ahead of the GPU.
+    bool low_latency;
+    // The release fence of the last presented image in low latency mode, or
+    // -1. We own the fd.
+    int last_present_fence;
 
     struct Image {
         Image() : image(VK_NULL_HANDLE), dequeue_fence(-1), dequeued(false) {}
@@ -1005,6 +1017,11 @@ static void DestroySwapchainInternal(VkDevice device,
         swapchain->surface.swapchain_handle = VK_NULL_HANDLE;
     }
 
+    if (swapchain->last_present_fence >= 0) {
+        close(swapchain->last_present_fence);
+        swapchain->last_present_fence = -1;
+    }
+
     if (!allocator) {
         allocator = &GetData(device).allocator;
     }
@@ -1138,29 +1155,6 @@ VkResult CreateSwapchainKHR(VkDevice device,
 
     const auto& dispatch = GetData(device).driver;
 
-    err = native_window_set_buffers_format(window, native_pixel_format);
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffers_format(%d) failed: %s (%d)",
-              native_pixel_format, strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
-    }
-    err = native_window_set_buffers_data_space(window, native_dataspace);
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffers_data_space(%d) failed: %s (%d)",
-              native_dataspace, strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
-    }
-
-    err = native_window_set_buffers_dimensions(
-        window, static_cast<int>(create_info->imageExtent.width),
-        static_cast<int>(create_info->imageExtent.height));
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffers_dimensions(%d,%d) failed: %s (%d)",
-              create_info->imageExtent.width, create_info->imageExtent.height,
-              strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
-    }
-
     // VkSwapchainCreateInfo::preTransform indicates the transformation the app
     // applied during rendering. native_window_set_transform() expects the
     // inverse: the transform the app is requesting that the compositor perform
@@ -1169,20 +1163,24 @@ VkResult CreateSwapchainKHR(VkDevice device,
     // then requesting the inverse transform, so that when the compositor does
     // it's job the two transforms cancel each other out and the compositor ends
     // up applying an identity transform to the app's buffer.
-    err = native_window_set_buffers_transform(
-        window, InvertTransformToNative(create_info->preTransform));
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffers_transform(%d) failed: %s (%d)",
-              InvertTransformToNative(create_info->preTransform),
-              strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
-    }
-
-    err = native_window_set_scaling_mode(
-        window, NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW);
+    const native_window_buffers_properties_t buffers_properties = {
+        .width = create_info->imageExtent.width,
+        .height = create_info->imageExtent.height,
+        .format = static_cast<int32_t>(native_pixel_format),
+        .dataSpace = native_dataspace,
+        .transform = static_cast<uint32_t>(
+            InvertTransformToNative(create_info->preTransform)),
+        .scalingMode = NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW,
+    };
+    err = native_window_set_buffers_properties(window, &buffers_properties);
     if (err != android::OK) {
-        ALOGE("native_window_set_scaling_mode(SCALE_TO_WINDOW) failed: %s (%d)",
-              strerror(-err), err);
+        ALOGE(
+            "native_window_set_buffers_properties(format %d, dataspace %d, "
+            "%ux%u, transform %d) failed: %s (%d)",
+            native_pixel_format, native_dataspace,
+            create_info->imageExtent.width, create_info->imageExtent.height,
+            InvertTransformToNative(create_info->preTransform), strerror(-err),
+            err);
         return VK_ERROR_SURFACE_LOST_KHR;
     }
 
@@ -1475,6 +1473,24 @@ VkResult AcquireNextImageKHR(VkDevice device,
         swapchain.acquire_next_image_timeout = acquire_next_image_timeout;
     }
 
+    if (swapchain.last_present_fence >= 0) {
+        ATRACE_BEGIN("WaitForLastPresent");
+        int wait_ms = acquire_next_image_timeout < 0
+                          ? -1
+                          : static_cast<int>(std::min<nsecs_t>(
+                                ns2ms(acquire_next_image_timeout),
+                                std::numeric_limits<int>::max()));
+        err = sync_wait(swapchain.last_present_fence, wait_ms);
+        ATRACE_END();
+        if (err != 0 && errno == ETIME) {
+            return timeout ? VK_TIMEOUT : VK_NOT_READY;
+        }
+        // Once signalled, or if the wait failed for any other reason, the
+        // fence no longer paces the app.
+        close(swapchain.last_present_fence);
+        swapchain.last_present_fence = -1;
+    }
+
     ANativeWindowBuffer* buffer;
     int fence_fd;
     err = window->dequeueBuffer(window, &buffer, &fence_fd);
@@ -1710,6 +1726,13 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     }
                 }
 
+                if (swapchain.low_latency && fence >= 0) {
+                    if (swapchain.last_present_fence >= 0) {
+                        close(swapchain.last_present_fence);
+                    }
+                    swapchain.last_present_fence = dup(fence);
+                }
+
                 err = window->queueBuffer(window, img.buffer.get(), fence);
                 // queueBuffer always closes fence, even on error
                 if (err != android::OK) {